@@ -0,0 +1,21 @@
+"""wd_cc_benchmark definition"""
+
+load("//:build/wd_cc_binary.bzl", "wd_cc_binary")
+
+def wd_cc_benchmark(
+        src,
+        deps = [],
+        tags = [],
+        **kwargs):
+    """Wrapper for a benchmark binary built on //src/workerd/tests:bench.
+
+    Benchmarks are tagged `manual` so that they are not built or run by `bazel test //...`; run one
+    with e.g. `bazel run -c opt //src/workerd/tests:async-lock-bench`.
+    """
+    wd_cc_binary(
+        name = src.removesuffix(".c++"),
+        srcs = [src],
+        deps = ["//src/workerd/tests:bench"] + deps,
+        tags = ["manual", "benchmark"] + tags,
+        **kwargs
+    )
@@ -20,6 +20,7 @@ export type SocketAddress = {
 export type SocketOptions = {
   secureTransport?: 'off' | 'on' | 'starttls'
   allowHalfOpen?: boolean
+  pooled?: boolean
 }
 
 export function connect(address: string | SocketAddress, options?: SocketOptions): Socket;
@@ -44,6 +44,7 @@ import {
 
 import {
   createHash,
+  hash,
   Hash,
   HashOptions,
 } from 'node-internal:crypto_hash';
@@ -91,6 +92,7 @@ export {
   checkPrimeSync,
   // Hash
   createHash,
+  hash,
   Hash,
   HashOptions,
   // Pbkdf2
@@ -177,6 +179,7 @@ export default {
   Hash,
   createHash,
   getHashes,
+  hash,
   // Pbkdf2
   pbkdf2,
   pbkdf2Sync,
@@ -232,6 +235,7 @@ export default {
 //   * [x] crypto.getDiffieHellman(groupName)
 // * Hash
 //   * [x] crypto.createHash(algorithm[, options])
+//   * [x] crypto.hash(algorithm, data[, outputEncoding])
 //   * [ ] crypto.createHmac(algorithm, key[, options])
 //   * [x] crypto.getHashes()
 // * Keys
@@ -31,6 +31,7 @@ import {
 import type {
   Channel as ChannelType,
   MessageCallback,
+  SubscriberState,
 } from 'node-internal:diagnostics_channel';
 
 import {
@@ -80,6 +81,19 @@ const kEnd = Symbol('kEnd');
 const kAsyncStart = Symbol('kAsyncStart');
 const kAsyncEnd = Symbol('kAsyncEnd');
 const kError = Symbol('kError');
+const kSubscriberStates = Symbol('kSubscriberStates');
+
+// The worker tracer belongs to the current request, which can't change while JavaScript is
+// running, so we only ask C++ once per turn and cache the answer until the microtask queue drains.
+let tracedCache: boolean|undefined;
+
+function isTraced(): boolean {
+  if (tracedCache === undefined) {
+    tracedCache = diagnosticsChannel.isTraced();
+    queueMicrotask(() => { tracedCache = undefined; });
+  }
+  return tracedCache;
+}
 
 export class TracingChannel {
   private [kStart]?: ChannelType;
@@ -87,6 +101,7 @@ export class TracingChannel {
   private [kAsyncStart]?: ChannelType;
   private [kAsyncEnd]?: ChannelType;
   private [kError]?: ChannelType;
+  private [kSubscriberStates]?: SubscriberState[];
 
   public constructor() {
     throw new Error('Use diagnostic_channel.tracingChannels() to create TracingChannel');
@@ -98,6 +113,24 @@ export class TracingChannel {
   public get asyncEnd(): ChannelType { return this[kAsyncEnd]!; }
   public get error(): ChannelType { return this[kError]!; }
 
+  public get hasSubscribers(): boolean {
+    // Reads the channels' cached subscriber states rather than calling their hasSubscribers()
+    // methods, which would call into C++ five times on every traced call.
+    const states = this[kSubscriberStates] ??= [
+      this[kStart]!, this[kEnd]!, this[kAsyncStart]!, this[kAsyncEnd]!, this[kError]!,
+    ].map(channel => diagnosticsChannel.getSubscriberState(channel));
+    for (const state of states) {
+      if (state.hasSubscribers) return true;
+    }
+    return false;
+  }
+
+  private get mustTrace(): boolean {
+    // The worker tracer records every published message, so tracing can only be skipped if there
+    // are no subscribers and no tracer.
+    return this.hasSubscribers || isTraced();
+  }
+
   public subscribe(subscriptions: TracingChannelSubscriptions) {
     if (subscriptions.start !== undefined)
       this[kStart]!.subscribe(subscriptions.start);
@@ -128,6 +161,10 @@ export class TracingChannel {
             context: unknown = {},
             thisArg: any = globalThis,
             ...args: any[]): any {
+    if (!this.mustTrace) {
+      return Reflect.apply(fn, thisArg, args);
+    }
+
     const { start, end, error } = this;
 
     return start.runStores(context, () => {
@@ -149,6 +186,10 @@ export class TracingChannel {
             context: unknown = {},
             thisArg: any = globalThis,
             ...args: any[]): any {
+    if (!this.mustTrace) {
+      return Reflect.apply(fn, thisArg, args);
+    }
+
     const { start, end, asyncStart, asyncEnd, error } = this;
 
     function reject(err: any) {
@@ -189,6 +230,10 @@ export class TracingChannel {
                 context: unknown = {},
                 thisArg: any = globalThis,
                 ...args: any[]): any {
+    if (!this.mustTrace) {
+      return Reflect.apply(fn, thisArg, args);
+    }
+
     const { start, end, asyncStart, asyncEnd, error } = this;
 
     function wrappedCallback(this: any, err: any, res: any) {
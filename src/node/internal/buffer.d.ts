@@ -33,5 +33,13 @@ export function write(buffer: Uint8Array,
                       offset: number,
                       length: number,
                       encoding: string): void;
-export function decode(buffer: Uint8Array, state: Uint8Array): string;
-export function flush(state: Uint8Array): string;
+
+export class StringDecoderHandle {
+  public constructor(encoding: number);
+  public write(buffer: Uint8Array): string;
+  public end(): string;
+  public reset(): void;
+  public readonly lastChar: ArrayBuffer;
+  public readonly lastNeed: number;
+  public readonly lastTotal: number;
+}
@@ -18,11 +18,14 @@ export class HashHandle {
   public digest(): ArrayBuffer;
   public copy(xofLen: number): HashHandle;
 }
+export function oneShotHash(algorithm: string, data: string | ArrayBufferView): ArrayBuffer;
 
 // pbkdf2
 export type ArrayLike = ArrayBuffer|string|Buffer|ArrayBufferView;
 export function getPbkdf(password: ArrayLike, salt: ArrayLike, iterations: number, keylen: number,
                          digest: string): ArrayBuffer;
+export function getPbkdfAsync(password: ArrayLike, salt: ArrayLike, iterations: number,
+                              keylen: number, digest: string): Promise<ArrayBuffer>;
 
 // Keys
 export function exportKey(key: CryptoKey, options?: InnerExportOptions): KeyExportResult;
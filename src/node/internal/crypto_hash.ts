@@ -42,6 +42,7 @@ import {
   ERR_CRYPTO_HASH_FINALIZED,
   ERR_CRYPTO_HASH_UPDATE_FAILED,
   ERR_INVALID_ARG_TYPE,
+  ERR_INVALID_ARG_VALUE,
 } from 'node-internal:internal_errors';
 
 import {
@@ -77,6 +78,27 @@ interface Hash extends Transform {
   [kState]: _kState;
 }
 
+export function hash(algorithm: string, input: string | ArrayBufferView,
+                     outputEncoding: string = 'hex'): Buffer | string {
+  validateString(algorithm, 'algorithm');
+  if (typeof input !== 'string' && !isArrayBufferView(input)) {
+    throw new ERR_INVALID_ARG_TYPE(
+      'input', ['Buffer', 'TypedArray', 'DataView', 'string'], input);
+  }
+  let normalized: string | undefined = outputEncoding;
+  if (outputEncoding !== 'buffer') {
+    validateString(outputEncoding, 'outputEncoding');
+    normalized = normalizeEncoding(outputEncoding);
+    if (normalized === undefined) {
+      throw new ERR_INVALID_ARG_VALUE('outputEncoding', outputEncoding);
+    }
+  }
+
+  // Unlike createHash(), this doesn't construct a Hash stream or a native handle.
+  const ret = Buffer.from(cryptoImpl.oneShotHash(algorithm, input));
+  return outputEncoding === 'buffer' ? ret : ret.toString(normalized);
+}
+
 // These helper functions are needed because the constructors can
 // use new, in which case V8 cannot inline the recursive constructor call
 export function createHash(algorithm: string, options?: HashOptions): Hash {
@@ -69,13 +69,8 @@ export function pbkdf2(password: ArrayLike, salt: ArrayLike, iterations: number,
   ({ password, salt, iterations, keylen, digest } =
     check(password, salt, iterations, keylen, digest));
 
-  new Promise<ArrayBuffer>((res, rej) => {
-    try {
-      res(cryptoImpl.getPbkdf(password, salt, iterations, keylen, digest));
-    } catch(err) {
-      rej(err);
-    }
-  }).then((val) => callback(null, Buffer.from(val)), (err) => callback(err));
+  cryptoImpl.getPbkdfAsync(password, salt, iterations, keylen, digest)
+    .then((val) => callback(null, Buffer.from(val)), (err) => callback(err));
 }
 
 function check(password: ArrayLike|ArrayBufferView, salt: ArrayLike|ArrayBufferView, iterations: number, keylen: number,
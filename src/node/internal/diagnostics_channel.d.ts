@@ -9,6 +9,10 @@ import { AsyncLocalStorage } from "node-internal:async_hooks";
 
 export type TransformCallback = (value: any) => any;
 
+export interface SubscriberState {
+  readonly hasSubscribers: boolean;
+}
+
 export abstract class Channel {
   hasSubscribers(): boolean;
   publish(message: any): void;
@@ -28,3 +32,5 @@ export function hasSubscribers(name: string|symbol) : boolean;
 export function channel(name: string|symbol) : Channel;
 export function subscribe(name: string|symbol, callback: MessageCallback) : void;
 export function unsubscribe(name: string|symbol, callback: MessageCallback) : void;
+export function getSubscriberState(channel: Channel) : SubscriberState;
+export function isTraced() : boolean;
@@ -36,13 +36,6 @@ import {
 
 import { default as bufferUtil } from 'node-internal:buffer';
 
-const kIncompleteCharactersStart = 0;
-const kIncompleteCharactersEnd = 4;
-const kMissingBytes = 4;
-const kBufferedBytes = 5;
-const kEncoding = 6;
-const kSize = 7;
-
 const encodings : Record<string,number> = {
   ascii: 0,
   latin1: 1,
@@ -68,7 +61,7 @@ export interface StringDecoder {
 }
 
 interface InternalDecoder extends StringDecoder {
-  [kNativeDecoder]: Buffer;
+  [kNativeDecoder]: bufferUtil.StringDecoderHandle;
 }
 
 export function StringDecoder(this: StringDecoder, encoding: string = 'utf8') {
@@ -76,8 +69,8 @@ export function StringDecoder(this: StringDecoder, encoding: string = 'utf8') {
   if (!isEncoding(normalizedEncoding)) {
     throw new ERR_UNKNOWN_ENCODING(encoding);
   }
-  (this as InternalDecoder)[kNativeDecoder] = Buffer.alloc(kSize);
-  (this as InternalDecoder)[kNativeDecoder][kEncoding] = encodings[normalizedEncoding!]!;
+  (this as InternalDecoder)[kNativeDecoder] =
+    new bufferUtil.StringDecoderHandle(encodings[normalizedEncoding!]!);
   this.encoding = normalizedEncoding!;
 }
 
@@ -94,7 +87,7 @@ function write(this: StringDecoder, buf: ArrayBufferView|DataView|string): strin
     ], buf);
   }
   const buffer = new Uint8Array(buf.buffer, buf.byteOffset, buf.byteLength);
-  return bufferUtil.decode(buffer, (this as InternalDecoder)[kNativeDecoder]);
+  return (this as InternalDecoder)[kNativeDecoder].write(buffer);
 }
 
 function end(this: StringDecoder, buf?: ArrayBufferView|DataView|string): string {
@@ -105,18 +98,14 @@ function end(this: StringDecoder, buf?: ArrayBufferView|DataView|string): string
   if (buf !== undefined) {
     ret = this.write(buf);
   }
-  if ((this as InternalDecoder)[kNativeDecoder][kBufferedBytes]! > 0) {
-    ret += bufferUtil.flush((this as InternalDecoder)[kNativeDecoder]);
-  }
-  return ret;
+  return ret + (this as InternalDecoder)[kNativeDecoder].end();
 }
 
 function text(this: StringDecoder, buf: ArrayBufferView|DataView|string, offset?: number) : string {
   if ((this as InternalDecoder)[kNativeDecoder] === undefined) {
     throw new ERR_INVALID_THIS('StringDecoder');
   }
-  (this as InternalDecoder)[kNativeDecoder][kMissingBytes] = 0;
-  (this as InternalDecoder)[kNativeDecoder][kBufferedBytes] = 0;
+  (this as InternalDecoder)[kNativeDecoder].reset();
   return this.write((buf as any).slice(offset));
 }
 
@@ -131,8 +120,7 @@ Object.defineProperties(StringDecoder.prototype, {
       if ((this as InternalDecoder)[kNativeDecoder] === undefined) {
         throw new ERR_INVALID_THIS('StringDecoder');
       }
-      return (this as InternalDecoder)[kNativeDecoder].subarray(
-        kIncompleteCharactersStart, kIncompleteCharactersEnd) as Buffer;
+      return Buffer.from((this as InternalDecoder)[kNativeDecoder].lastChar);
     },
   },
   lastNeed: {
@@ -141,7 +129,7 @@ Object.defineProperties(StringDecoder.prototype, {
       if ((this as InternalDecoder)[kNativeDecoder] === undefined) {
         throw new ERR_INVALID_THIS('StringDecoder');
       }
-      return (this as InternalDecoder)[kNativeDecoder][kMissingBytes]!;
+      return (this as InternalDecoder)[kNativeDecoder].lastNeed;
     },
   },
   lastTotal: {
@@ -150,8 +138,7 @@ Object.defineProperties(StringDecoder.prototype, {
       if ((this as InternalDecoder)[kNativeDecoder] === undefined) {
         throw new ERR_INVALID_THIS('StringDecoder');
       }
-      return (this as InternalDecoder)[kNativeDecoder][kBufferedBytes]! +
-        (this as InternalDecoder)[kNativeDecoder][kMissingBytes]!;
+      return (this as InternalDecoder)[kNativeDecoder].lastTotal;
     },
   },
 });
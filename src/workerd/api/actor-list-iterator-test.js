@@ -0,0 +1,74 @@
+import * as assert from 'node:assert'
+
+async function collect(iter) {
+  let result = [];
+  for await (const pair of iter) {
+    result.push(pair);
+  }
+  return result;
+}
+
+export class DurableObjectExample {
+  constructor(state, env) {
+    this.state = state;
+  }
+
+  async fetch(req) {
+    let storage = this.state.storage;
+
+    // Enough keys to span several batches.
+    let entries = {};
+    let expected = [];
+    for (let i = 0; i < 300; i++) {
+      let key = `key${String(i).padStart(3, "0")}`;
+      entries[key] = i;
+      expected.push([key, i]);
+    }
+    await storage.put(entries);
+    await storage.put("other", "x");
+
+    assert.deepStrictEqual(await collect(storage.listIterator({prefix: "key"})), expected);
+    assert.deepStrictEqual(
+        await collect(storage.listIterator({prefix: "key", reverse: true})),
+        expected.slice().reverse());
+    assert.deepStrictEqual(
+        await collect(storage.listIterator({prefix: "key", limit: 200})),
+        expected.slice(0, 200));
+    assert.deepStrictEqual(
+        await collect(storage.listIterator({startAfter: "key100", end: "key250"})),
+        expected.slice(101, 250));
+    assert.deepStrictEqual(
+        await collect(storage.listIterator({start: "key2", end: "key1"})), []);
+
+    // Results match list().
+    assert.deepStrictEqual(await collect(storage.listIterator()),
+        [...(await storage.list()).entries()]);
+
+    // Breaking out early stops the iteration.
+    let count = 0;
+    for await (const _ of storage.listIterator()) {
+      if (++count == 5) break;
+    }
+    assert.equal(count, 5);
+
+    // Steps requested without awaiting each other still resolve in order, and nothing is returned
+    // after the iterator is closed.
+    let iter = storage.listIterator({prefix: "key"});
+    let steps = await Promise.all([iter.next(), iter.next(), iter.next()]);
+    assert.deepStrictEqual(steps.map(step => step.value), expected.slice(0, 3));
+    assert.equal((await iter.return()).done, true);
+    assert.equal((await iter.next()).done, true);
+
+    return new Response("OK");
+  }
+}
+
+export default {
+  async test(ctrl, env, ctx) {
+    let id = env.ns.idFromName("A");
+    let obj = env.ns.get(id);
+    let res = await obj.fetch("http://foo/test");
+    let text = await res.text();
+    assert.equal(text, "OK");
+  }
+}
@@ -0,0 +1,41 @@
+import * as assert from 'node:assert'
+
+export class DurableObjectExample {
+  constructor(state, env) {
+    this.state = state;
+
+    // Prefetching from the constructor must not block delivery of the first event.
+    state.storage.prefetch(["a", "b", "missing"]);
+    state.storage.prefetch({prefix: "key"});
+  }
+
+  async fetch(req) {
+    let storage = this.state.storage;
+
+    await storage.put({a: 1, b: 2, key1: "x", key2: "y", other: "z"});
+
+    // Prefetching keys that are already cached, or an empty range, is harmless.
+    assert.strictEqual(storage.prefetch(["a", "b"]), undefined);
+    assert.strictEqual(storage.prefetch({start: "key2", end: "key1"}), undefined);
+    storage.prefetch({prefix: "key", reverse: true, limit: 1});
+
+    assert.deepStrictEqual(await storage.get(["a", "b", "missing"]),
+        new Map([["a", 1], ["b", 2]]));
+    assert.deepStrictEqual(await storage.list({prefix: "key"}),
+        new Map([["key1", "x"], ["key2", "y"]]));
+
+    assert.throws(() => storage.prefetch("a"), TypeError);
+
+    return new Response("OK");
+  }
+}
+
+export default {
+  async test(ctrl, env, ctx) {
+    let id = env.ns.idFromName("A");
+    let obj = env.ns.get(id);
+    let res = await obj.fetch("http://foo/test");
+    let text = await res.text();
+    assert.equal(text, "OK");
+  }
+}
@@ -82,6 +82,108 @@ KJ_TEST("we support deserializing up to v15") {
   }
 }
 
+KJ_TEST("compressed values round-trip through deserializeV8Value") {
+  jsg::test::Evaluator<ActorStateContext, ActorStateIsolate> e(v8System);
+  ActorStateIsolate &actorStateIsolate = e.getIsolate();
+  jsg::V8StackScope stackScope;
+  ActorStateIsolate::Lock isolateLock(actorStateIsolate, stackScope);
+  auto* isolate = isolateLock.v8Isolate;
+  v8::HandleScope handleScope(isolate);
+  auto v8Context = isolateLock.newContext<ActorStateContext>().getHandle(isolate);
+  v8::Context::Scope contextScope(v8Context);
+
+  kj::Vector<char> text;
+  for (uint i = 0; i < 200; i++) {
+    text.addAll("{\"name\":\"value\"},"_kj);
+  }
+  auto str = jsg::v8Str(isolate, text.asPtr());
+  auto buf = serializeV8Value(str, isolate);
+  auto rawSize = buf.size();
+
+  // Below the threshold, or with compression disabled, the value is untouched.
+  auto same = compressStorageValue(kj::mv(buf), 0);
+  KJ_EXPECT(same.size() == rawSize);
+  same = compressStorageValue(kj::mv(same), rawSize + 1);
+  KJ_EXPECT(same.size() == rawSize);
+  KJ_EXPECT(same[0] == 0xFF);
+
+  auto compressed = compressStorageValue(kj::mv(same), 64);
+  KJ_EXPECT(compressed.size() < rawSize / 4, compressed.size(), rawSize);
+  KJ_EXPECT(compressed[0] != 0xFF);
+
+  auto result = deserializeV8Value("some-key"_kj, compressed, isolate);
+  KJ_ASSERT(result->IsString());
+  KJ_EXPECT(result.As<v8::String>()->Length() == text.size());
+
+  // Values that don't compress are stored raw.
+  auto tiny = serializeV8Value(v8::True(isolate), isolate);
+  auto tinyResult = compressStorageValue(kj::mv(tiny), 1);
+  KJ_EXPECT(tinyResult[0] == 0xFF);
+}
+
+KJ_TEST("compact values round-trip through deserializeV8Value") {
+  jsg::test::Evaluator<ActorStateContext, ActorStateIsolate> e(v8System);
+  ActorStateIsolate &actorStateIsolate = e.getIsolate();
+  jsg::V8StackScope stackScope;
+  ActorStateIsolate::Lock isolateLock(actorStateIsolate, stackScope);
+  auto* isolate = isolateLock.v8Isolate;
+  v8::HandleScope handleScope(isolate);
+  auto v8Context = isolateLock.newContext<ActorStateContext>().getHandle(isolate);
+  v8::Context::Scope contextScope(v8Context);
+
+  auto eval = [&](kj::StringPtr code) {
+    auto script = jsg::check(v8::Script::Compile(v8Context, jsg::v8Str(isolate, code)));
+    return jsg::check(script->Run(v8Context));
+  };
+
+  // Values that the compact format covers come back unchanged, as V8 sees them.
+  kj::StringPtr compactCases[] = {
+    "true",
+    "-2147483648",
+    "-0",
+    "'Latin-1 ünïcödé'",
+    "'two-byte ✓'",
+    "({ a: 1, b: 'x', c: [1, 2.5, null, undefined, true, false], d: { 0: 'zero', 'ü✓': [] } })",
+    "[[[[]]], {}, '', 'a✓b']",
+  };
+  for (auto code: compactCases) {
+    auto value = eval(code);
+    auto buf = serializeV8Value(value, isolate, true);
+    KJ_EXPECT(buf[0] == 0xFE, code);
+    auto result = deserializeV8Value("some-key"_kj, buf, isolate);
+    KJ_EXPECT(serializeV8Value(result, isolate) == serializeV8Value(value, isolate), code);
+
+    auto compressed = compressStorageValue(kj::mv(buf), 1);
+    result = deserializeV8Value("some-key"_kj, compressed, isolate);
+    KJ_EXPECT(serializeV8Value(result, isolate) == serializeV8Value(value, isolate), code);
+  }
+
+  // Anything else is left to V8.
+  kj::StringPtr v8Cases[] = {
+    "({ d: new Date(0) })",
+    "[1, , 3]",
+    "Object.assign([1, 2], { extra: true })",
+    "Object.assign([1, , 3], { x: 1 })",
+    "({ a: 1, get b() { return 2; } })",
+    "Object.defineProperty([1, 2], 1, { get() { return 2; }, enumerable: true })",
+    "(() => { const o = {}; return [o, o]; })()",
+    "(() => { const o = {}; o.self = o; return o; })()",
+    "({ n: 1n })",
+    "new Uint8Array([1, 2, 3])",
+  };
+  for (auto code: v8Cases) {
+    auto buf = serializeV8Value(eval(code), isolate, true);
+    KJ_EXPECT(buf[0] == 0xFF, code);
+    deserializeV8Value("some-key"_kj, buf, isolate);
+  }
+
+  // Falling back must not call getters twice: the compact writer gives up before reading any.
+  auto counted = eval(
+      "globalThis.calls = 0; ({ a: [1, 2], b: { get c() { return ++globalThis.calls; } } })");
+  KJ_EXPECT(serializeV8Value(counted, isolate, true)[0] == 0xFF);
+  KJ_EXPECT(jsg::check(eval("globalThis.calls")->Int32Value(v8Context)) == 1);
+}
+
 // This is hacky, but we want to compare the old deserialization logic that's been in prod from when
 // actors went live through March 2022 to the new version of the deserialization logic and make sure
 // it works the same.
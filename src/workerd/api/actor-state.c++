@@ -15,6 +15,7 @@
 #include "sql.h"
 #include <workerd/api/web-socket.h>
 #include <workerd/io/hibernation-manager.h>
+#include <kj/compat/brotli.h>
 
 namespace workerd::api {
 
@@ -118,20 +119,7 @@ ActorObserver& currentActorMetrics() {
   return IoContext::current().getActorOrThrow().getMetrics();
 }
 
-jsg::Value listResultsToMap(v8::Isolate* isolate, ActorCacheOps::GetResultList value, bool completelyCached) {
-  v8::HandleScope scope(isolate);
-  auto context = isolate->GetCurrentContext();
-
-  auto map = v8::Map::New(isolate);
-  size_t cachedReadBytes = 0;
-  size_t uncachedReadBytes = 0;
-  for (auto entry: value) {
-    auto& bytesRef = entry.status == ActorCacheOps::CacheStatus::CACHED
-                   ? cachedReadBytes : uncachedReadBytes;
-    bytesRef += entry.key.size() + entry.value.size();
-    jsg::check(map->Set(context, jsg::v8Str(isolate, entry.key),
-        deserializeV8Value(entry.key, entry.value, isolate)));
-  }
+void billListBytes(size_t cachedReadBytes, size_t uncachedReadBytes, bool completelyCached) {
   auto& actorMetrics = currentActorMetrics();
   if (cachedReadBytes || uncachedReadBytes) {
     size_t totalReadBytes = cachedReadBytes + uncachedReadBytes;
@@ -150,10 +138,72 @@ jsg::Value listResultsToMap(v8::Isolate* isolate, ActorCacheOps::GetResultList v
     // We bill 1 uncached read unit if there was no results from the list.
     actorMetrics.addUncachedStorageReadUnits(1);
   }
+}
+
+void billListResults(const ActorCacheOps::GetResultList& value, bool completelyCached) {
+  size_t cachedReadBytes = 0;
+  size_t uncachedReadBytes = 0;
+  for (auto entry: value) {
+    auto& bytesRef = entry.status == ActorCacheOps::CacheStatus::CACHED
+                   ? cachedReadBytes : uncachedReadBytes;
+    bytesRef += entry.key.size() + entry.value.size();
+  }
+  billListBytes(cachedReadBytes, uncachedReadBytes, completelyCached);
+}
+
+jsg::Value listResultsToMap(v8::Isolate* isolate, ActorCacheOps::GetResultList value, bool completelyCached) {
+  v8::HandleScope scope(isolate);
+  auto context = isolate->GetCurrentContext();
+
+  auto map = v8::Map::New(isolate);
+  for (auto entry: value) {
+    jsg::check(map->Set(context, jsg::v8Str(isolate, entry.key),
+        deserializeV8Value(entry.key, entry.value, isolate)));
+  }
+  billListResults(value, completelyCached);
 
   return jsg::Value(isolate, map);
 }
 
+jsg::Value listSqliteKvToMap(v8::Isolate* isolate, SqliteKv& kv, kj::StringPtr start,
+    kj::Maybe<kj::StringPtr> end, kj::Maybe<uint> limit, SqliteKv::Order order) {
+  // Like listResultsToMap(), but reads rows straight out of SQLite as they are produced, so only
+  // the Map being built -- not a second copy of every key and value -- is held in memory.
+  v8::HandleScope scope(isolate);
+  auto context = isolate->GetCurrentContext();
+
+  auto map = v8::Map::New(isolate);
+  size_t readBytes = 0;
+  kv.list(start, end, limit, order, [&](kj::StringPtr key, kj::ArrayPtr<const kj::byte> value) {
+    jsg::check(map->Set(context, jsg::v8Str(isolate, key),
+        deserializeV8Value(key, value, isolate)));
+    readBytes += key.size() + value.size();
+  });
+
+  // Bill the same as a GetResultList built by ActorSqlite::list(), whose rows are all reported
+  // as uncached but which completes synchronously.
+  billListBytes(0, readBytes, true);
+
+  return jsg::Value(isolate, map);
+}
+
+kj::String keyAfter(kj::ArrayPtr<const char> key) {
+  // Returns the first key that sorts after `key`. This can be done simply by adding two NULL
+  // bytes. One to the end of the key and another to set the new key after it.
+  auto result = kj::heapArray<char>(key.size() + 2);
+
+  // Copy over the original string.
+  memcpy(result.begin(), key.begin(), key.size());
+  // Add one additional null byte to set the new start as the key immediately
+  // after `key`. This looks a little sketchy to be doing with strings rather
+  // than arrays, but kj::String explicitly allows for NULL bytes inside of strings.
+  result[result.size()-2] = '\0';
+  // kj::String automatically reads the last NULL as string termination, so we need to add it twice
+  // to make it stick in the final string.
+  result[result.size()-1] = '\0';
+  return kj::String(kj::mv(result));
+}
+
 kj::Function<jsg::Value(v8::Isolate*, ActorCacheOps::GetResultList)> getMultipleResultsToMap(
     size_t numInputKeys) {
   return [numInputKeys](v8::Isolate* isolate, ActorCacheOps::GetResultList value) mutable {
@@ -251,17 +301,13 @@ jsg::Promise<kj::Maybe<double>> DurableObjectStorageOperations::getAlarm(
   });
 }
 
-jsg::Promise<jsg::Value> DurableObjectStorageOperations::list(
-    jsg::Optional<ListOptions> maybeOptions, v8::Isolate* isolate) {
+kj::Maybe<DurableObjectStorageOperations::ListRange> DurableObjectStorageOperations::parseListRange(
+    jsg::Optional<ListOptions>& maybeOptions) {
   kj::String start;
   kj::Maybe<kj::String> end;
   bool reverse = false;
   kj::Maybe<uint> limit;
 
-  auto makeEmptyResult = [&]() {
-    return jsg::resolvedPromise(isolate, jsg::Value(isolate, v8::Map::New(isolate)));
-  };
-
   KJ_IF_MAYBE(o, maybeOptions) {
     KJ_IF_MAYBE(s, o->start) {
       KJ_IF_MAYBE(sa, o->startAfter) {
@@ -271,20 +317,8 @@ jsg::Promise<jsg::Value> DurableObjectStorageOperations::list(
     }
     KJ_IF_MAYBE(sks, o->startAfter) {
       // Convert an exclusive startAfter into an inclusive start key here so that the implementation
-      // doesn't need to handle both. This can be done simply by adding two NULL bytes. One to the end of
-      // the startAfter and another to set the start key after startAfter.
-      auto startAfterKey = kj::heapArray<char>(sks->size() + 2);
-
-      // Copy over the original string.
-      memcpy(startAfterKey.begin(), sks->begin(), sks->size());
-      // Add one additional null byte to set the new start as the key immediately
-      // after startAfter. This looks a little sketchy to be doing with strings rather
-      // than arrays, but kj::String explicitly allows for NULL bytes inside of strings.
-      startAfterKey[startAfterKey.size()-2] = '\0';
-      // kj::String automatically reads the last NULL as string termination, so we need to add it twice
-      // to make it stick in the final string.
-      startAfterKey[startAfterKey.size()-1] = '\0';
-      start = kj::String(kj::mv(startAfterKey));
+      // doesn't need to handle both.
+      start = keyAfter(*sks);
     }
     KJ_IF_MAYBE(e, o->end) {
       end = kj::mv(*e);
@@ -306,7 +340,7 @@ jsg::Promise<jsg::Value> DurableObjectStorageOperations::list(
           // `start` is within the prefix, so need not be modified.
         } else {
           // `start` comes after the last value with the prefix, so there's no overlap.
-          return makeEmptyResult();
+          return nullptr;
         }
 
         // Calculate the first key that sorts after all keys with the given prefix.
@@ -327,7 +361,7 @@ jsg::Promise<jsg::Value> DurableObjectStorageOperations::list(
           KJ_IF_MAYBE(e, end) {
             if (*e <= *prefix) {
               // No keys could possibly match both the end and the prefix.
-              return makeEmptyResult();
+              return nullptr;
             } else if (e->startsWith(*prefix)) {
               // `end` is within the prefix, so need not be modified.
             } else {
@@ -347,17 +381,43 @@ jsg::Promise<jsg::Value> DurableObjectStorageOperations::list(
   KJ_IF_MAYBE(e, end) {
     if (*e <= start) {
       // Key range is empty.
-      return makeEmptyResult();
+      return nullptr;
     }
   }
 
+  return ListRange {
+    .start = kj::mv(start),
+    .end = kj::mv(end),
+    .reverse = reverse,
+    .limit = limit,
+  };
+}
+
+jsg::Promise<jsg::Value> DurableObjectStorageOperations::list(
+    jsg::Optional<ListOptions> maybeOptions, v8::Isolate* isolate) {
+  auto maybeRange = parseListRange(maybeOptions);
   auto options = configureOptions(kj::mv(maybeOptions).orDefault(ListOptions{}));
-  ActorCacheOps::ReadOptions readOptions = options;
 
-  auto result = reverse
-      ? getCache(OP_LIST).listReverse(kj::mv(start), kj::mv(end), limit, readOptions)
-      : getCache(OP_LIST).list(kj::mv(start), kj::mv(end), limit, readOptions);
-  return transformCacheResultWithCacheStatus(isolate, kj::mv(result), options, &listResultsToMap);
+  KJ_IF_MAYBE(range, maybeRange) {
+    KJ_IF_MAYBE(kv, getCache(OP_LIST).getSqliteKv()) {
+      auto end = range->end.map([](kj::String& e) -> kj::StringPtr { return e; });
+      auto order = range->reverse ? SqliteKv::REVERSE : SqliteKv::FORWARD;
+      return jsg::resolvedPromise(isolate,
+          listSqliteKvToMap(isolate, *kv, range->start, end, range->limit, order));
+    }
+
+    ActorCacheOps::ReadOptions readOptions = options;
+
+    auto result = range->reverse
+        ? getCache(OP_LIST).listReverse(
+            kj::mv(range->start), kj::mv(range->end), range->limit, readOptions)
+        : getCache(OP_LIST).list(
+            kj::mv(range->start), kj::mv(range->end), range->limit, readOptions);
+    return transformCacheResultWithCacheStatus(isolate, kj::mv(result), options, &listResultsToMap);
+  } else {
+    // Key range is empty.
+    return jsg::resolvedPromise(isolate, jsg::Value(isolate, v8::Map::New(isolate)));
+  }
 }
 
 jsg::Promise<void> DurableObjectStorageOperations::put(jsg::Lock& js,
@@ -438,10 +498,11 @@ jsg::Promise<void> DurableObjectStorageOperations::putOne(
     kj::String key, v8::Local<v8::Value> value, const PutOptions& options, v8::Isolate* isolate) {
   ActorStorageLimits::checkMaxKeySize(key);
 
-  kj::Array<byte> buffer = serializeV8Value(value, isolate);
+  kj::Array<byte> buffer = serializeV8Value(value, isolate, useCompactValues());
   ActorStorageLimits::checkMaxValueSize(key, buffer);
 
   auto units = billingUnits(key.size() + buffer.size());
+  buffer = compressStorageValue(kj::mv(buffer), valueCompressionThreshold());
 
   jsg::Promise<void> maybeBackpressure = transformMaybeBackpressure(isolate, options,
       getCache(OP_PUT).put(kj::mv(key), kj::mv(buffer), options));
@@ -539,10 +600,11 @@ jsg::Promise<void> DurableObjectStorageOperations::putMultiple(
 
     ActorStorageLimits::checkMaxKeySize(field.name);
 
-    kj::Array<byte> buffer = serializeV8Value(field.value, isolate);
+    kj::Array<byte> buffer = serializeV8Value(field.value, isolate, useCompactValues());
     ActorStorageLimits::checkMaxValueSize(field.name, buffer);
 
     units += billingUnits(field.name.size() + buffer.size());
+    buffer = compressStorageValue(kj::mv(buffer), valueCompressionThreshold());
 
     kvs.add(ActorCacheOps::KeyValuePair { kj::mv(field.name), kj::mv(buffer) });
   }
@@ -578,6 +640,136 @@ ActorCacheOps& DurableObjectStorage::getCache(OpName op) {
   return *cache;
 }
 
+void DurableObjectStorage::prefetch(kj::OneOf<kj::Array<kj::String>, ListOptions> keysOrRange) {
+  if (cache->getSqliteDatabase() != nullptr) return;
+
+  auto& context = IoContext::current();
+  ActorCacheOps::ReadOptions readOptions;
+
+  kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList>> result;
+  KJ_SWITCH_ONEOF(keysOrRange) {
+    KJ_CASE_ONEOF(keys, kj::Array<kj::String>) {
+      ActorStorageLimits::checkMaxPairsCount(keys.size());
+      for (auto& key: keys) {
+        ActorStorageLimits::checkMaxKeySize(key);
+      }
+      result = getCache(OP_GET).get(kj::mv(keys), readOptions);
+    }
+    KJ_CASE_ONEOF(options, ListOptions) {
+      jsg::Optional<ListOptions> maybeOptions = kj::mv(options);
+      KJ_IF_MAYBE(range, parseListRange(maybeOptions)) {
+        result = range->reverse
+            ? getCache(OP_LIST).listReverse(
+                kj::mv(range->start), kj::mv(range->end), range->limit, readOptions)
+            : getCache(OP_LIST).list(
+                kj::mv(range->start), kj::mv(range->end), range->limit, readOptions);
+      } else {
+        return;
+      }
+    }
+  }
+
+  KJ_IF_MAYBE(promise, result.tryGet<kj::Promise<ActorCacheOps::GetResultList>>()) {
+    // Everything the cache had to fetch is billed as an uncached read now; subsequent reads of
+    // the same keys will then be billed as cached.
+    context.addTask(promise->then([&metrics = currentActorMetrics()](
+        ActorCacheOps::GetResultList results) {
+      uint32_t units = 0;
+      for (auto entry: results) {
+        if (entry.status == ActorCacheOps::CacheStatus::UNCACHED) {
+          units += billingUnits(entry.key.size() + entry.value.size());
+        }
+      }
+      metrics.addUncachedStorageReadUnits(kj::max(units, 1u));
+    }, [](kj::Exception&&) {}));
+  }
+}
+
+jsg::Ref<DurableObjectStorage::ListIterator> DurableObjectStorage::listIterator(
+    jsg::Lock& js, jsg::Optional<ListOptions> maybeOptions) {
+  auto maybeRange = parseListRange(maybeOptions);
+  auto options = configureOptions(kj::mv(maybeOptions).orDefault(ListOptions{}));
+
+  bool done = maybeRange == nullptr;
+  return jsg::alloc<ListIterator>(ListIteratorState {
+    .storage = JSG_THIS,
+    .options = kj::mv(options),
+    .range = kj::mv(maybeRange).orDefault(ListRange{}),
+    .done = done,
+  });
+}
+
+jsg::Promise<kj::Maybe<jsg::Value>> DurableObjectStorage::listIteratorNext(
+    jsg::Lock& js, ListIteratorState& state) {
+  if (state.pendingPos < state.pending.size()) {
+    return js.resolvedPromise(kj::Maybe<jsg::Value>(kj::mv(state.pending[state.pendingPos++])));
+  }
+  if (state.done) {
+    return js.resolvedPromise(kj::Maybe<jsg::Value>(nullptr));
+  }
+
+  uint batchSize = LIST_ITERATOR_BATCH_SIZE;
+  KJ_IF_MAYBE(l, state.range.limit) {
+    batchSize = kj::min(batchSize, *l);
+  }
+
+  auto& range = state.range;
+  auto& cache = state.storage->getCache(OP_LIST);
+  ActorCacheOps::ReadOptions readOptions = state.options;
+  auto end = range.end.map([](kj::String& e) { return kj::str(e); });
+  auto result = range.reverse
+      ? cache.listReverse(kj::str(range.start), kj::mv(end), batchSize, readOptions)
+      : cache.list(kj::str(range.start), kj::mv(end), batchSize, readOptions);
+
+  // It's safe to capture `state` by reference: the iterator does not call us again, or run the
+  // return function, until the promise we return has resolved, and it keeps itself alive until
+  // then.
+  return transformCacheResultWithCacheStatus(js.v8Isolate, kj::mv(result), state.options,
+      [&state, batchSize](v8::Isolate* isolate, ActorCacheOps::GetResultList batch,
+                          bool completelyCached) -> kj::Maybe<jsg::Value> {
+    v8::HandleScope scope(isolate);
+    auto& range = state.range;
+
+    auto pending = kj::heapArrayBuilder<jsg::Value>(batch.size());
+    kj::ArrayPtr<const char> lastKey;
+    for (auto entry: batch) {
+      v8::Local<v8::Value> pair[2] = {
+        jsg::v8Str(isolate, entry.key),
+        deserializeV8Value(entry.key, entry.value, isolate),
+      };
+      pending.add(isolate, v8::Array::New(isolate, pair, 2));
+      lastKey = entry.key;
+    }
+    billListResults(batch, completelyCached);
+
+    if (batch.size() < batchSize) {
+      state.done = true;
+    } else if (range.reverse) {
+      range.end = kj::heapString(lastKey);
+    } else {
+      range.start = keyAfter(lastKey);
+    }
+    KJ_IF_MAYBE(l, range.limit) {
+      *l -= batch.size();
+      if (*l == 0) state.done = true;
+    }
+
+    state.pending = pending.finish();
+    state.pendingPos = 0;
+    if (state.pending.size() == 0) {
+      return nullptr;
+    }
+    return kj::mv(state.pending[state.pendingPos++]);
+  });
+}
+
+jsg::Promise<void> DurableObjectStorage::listIteratorReturn(
+    jsg::Lock& js, ListIteratorState& state, jsg::Optional<jsg::Value> value) {
+  state.pending = nullptr;
+  state.done = true;
+  return js.resolvedPromise();
+}
+
 jsg::Promise<jsg::Value> DurableObjectStorage::transaction(jsg::Lock& js,
     jsg::Function<jsg::Promise<jsg::Value>(jsg::Ref<DurableObjectTransaction>)> callback,
     jsg::Optional<TransactionOptions> options) {
@@ -589,7 +781,8 @@ jsg::Promise<jsg::Value> DurableObjectStorage::transaction(jsg::Lock& js,
   };
 
   return context.blockConcurrencyWhile(js,
-      [callback = kj::mv(callback), &context, &cache = *cache]
+      [callback = kj::mv(callback), &context, &cache = *cache,
+       compressionThreshold = compressionThreshold, compactValues = compactValues]
       (jsg::Lock& js) mutable -> jsg::Promise<TxnResult> {
     // Note that the call to `startTransaction()` is when the SQLite-backed implementation will
     // actually invoke `BEGIN TRANSACTION`, so it's important that we're inside the
@@ -598,7 +791,8 @@ jsg::Promise<jsg::Value> DurableObjectStorage::transaction(jsg::Lock& js,
     //
     // For the ActorCache-based implementation, it doesn't matter when we call `startTransaction()`
     // as the method merely allocates an object and returns it with no side effects.
-    auto txn = jsg::alloc<DurableObjectTransaction>(context.addObject(cache.startTransaction()));
+    auto txn = jsg::alloc<DurableObjectTransaction>(
+        context.addObject(cache.startTransaction()), compressionThreshold, compactValues);
 
     return js.resolvedPromise(txn.addRef())
         .then(js, kj::mv(callback))
@@ -842,6 +1036,17 @@ kj::Array<jsg::Ref<api::WebSocket>> DurableObjectState::getWebSockets(
   return kj::Array<jsg::Ref<api::WebSocket>>();
 }
 
+void DurableObjectState::broadcast(jsg::Lock& js, kj::OneOf<kj::Array<byte>, kj::String> message,
+                                   jsg::Optional<BroadcastOptions> options) {
+  auto& a = KJ_REQUIRE_NONNULL(IoContext::current().getActor());
+  KJ_IF_MAYBE(manager, a.getHibernationManager()) {
+    auto opts = kj::mv(options).orDefault({});
+    auto except = kj::mv(opts.except).orDefault(nullptr);
+    manager->broadcast(js, kj::mv(message),
+        opts.tag.map([](kj::StringPtr t) { return t; }), except);
+  }
+}
+
 void DurableObjectState::setWebSocketAutoResponse(
       jsg::Optional<jsg::Ref<WebSocketRequestResponsePair>> maybeReqResp) {
   auto& a = KJ_REQUIRE_NONNULL(IoContext::current().getActor());
@@ -889,10 +1094,64 @@ kj::Maybe<kj::Date> DurableObjectState::getWebSocketAutoResponseTimestamp(jsg::R
   return ws->getAutoResponseTimestamp();
 }
 
-kj::Array<kj::byte> serializeV8Value(v8::Local<v8::Value> value, v8::Isolate* isolate) {
+namespace {
+
+constexpr kj::byte COMPRESSED_VALUE_TAG = 0x01;
+// Prefix of values written by compressStorageValue(), followed by a brotli stream. V8's
+// serializer starts its output with a 0xFF version header, and legacy headerless values start
+// with a V8 serialization tag, none of which are 0x01, so this can't be confused with an
+// uncompressed value.
+
+constexpr int STORAGE_COMPRESSION_QUALITY = 5;
+// Brotli quality level. Higher levels compress JSON-like data only marginally better but are
+// much slower, and compression runs synchronously on every put().
+
+kj::Array<kj::byte> decompressStorageValue(
+    kj::ArrayPtr<const char> key, kj::ArrayPtr<const kj::byte> buf) {
+  kj::ArrayInputStream compressed(buf.slice(1, buf.size()));
+  kj::BrotliInputStream decompressor(compressed);
+  kj::Vector<kj::byte> result(buf.size() * 4);
+
+  kj::byte chunk[4096];
+  for (;;) {
+    size_t n = decompressor.tryRead(chunk, 1, sizeof(chunk));
+    if (n == 0) break;
+    result.addAll(kj::arrayPtr(chunk, n));
+  }
+
+  KJ_ASSERT(result.size() > 0, "compressed storage value decompressed to nothing", key);
+  return result.releaseAsArray();
+}
+
+}  // namespace
+
+kj::Array<kj::byte> compressStorageValue(kj::Array<kj::byte> buf, uint32_t threshold) {
+  if (threshold == 0 || buf.size() < threshold) {
+    return kj::mv(buf);
+  }
+
+  kj::VectorOutputStream compressed(buf.size() / 2);
+  compressed.write(&COMPRESSED_VALUE_TAG, 1);
+  {
+    kj::BrotliOutputStream compressor(compressed, STORAGE_COMPRESSION_QUALITY);
+    compressor.write(buf.begin(), buf.size());
+    // The destructor finishes the brotli stream.
+  }
+
+  auto output = compressed.getArray();
+  if (output.size() >= buf.size()) {
+    // Incompressible (e.g. already-compressed binary data); storing it raw is cheaper to read.
+    return kj::mv(buf);
+  }
+  return kj::heapArray(output);
+}
+
+kj::Array<kj::byte> serializeV8Value(v8::Local<v8::Value> value, v8::Isolate* isolate,
+                                     bool compact) {
   jsg::Serializer serializer(isolate, jsg::Serializer::Options {
     .version = 15,
     .omitHeader = false,
+    .compact = compact,
   });
   serializer.write(value);
   auto released = serializer.release();
@@ -935,6 +1194,12 @@ v8::Local<v8::Value> deserializeV8Value(
 
   KJ_ASSERT(buf.size() > 0, "unexpectedly empty value buffer", key);
 
+  kj::Array<kj::byte> decompressed;
+  if (buf[0] == COMPRESSED_VALUE_TAG) {
+    decompressed = decompressStorageValue(key, buf);
+    buf = decompressed;
+  }
+
   jsg::Deserializer::Options options {};
   if (buf[0] != 0xFF) {
     // When Durable Objects was first released, it did not properly write headers when serializing
@@ -21,10 +21,19 @@ class SqlStorage;
 class DurableObjectId;
 class WebSocket;
 
-kj::Array<kj::byte> serializeV8Value(v8::Local<v8::Value> value, v8::Isolate* isolate);
+kj::Array<kj::byte> serializeV8Value(v8::Local<v8::Value> value, v8::Isolate* isolate,
+                                     bool compact = false);
+// If `compact` is true, uses jsg::Serializer's compact format when the value allows it.
 
 v8::Local<v8::Value> deserializeV8Value(
     kj::ArrayPtr<const char> key, kj::ArrayPtr<const kj::byte> buf, v8::Isolate* isolate);
+// Transparently decompresses values written by compressStorageValue(), and reads either format
+// written by serializeV8Value().
+
+kj::Array<kj::byte> compressStorageValue(kj::Array<kj::byte> buf, uint32_t threshold);
+// Brotli-compresses a value produced by serializeV8Value() if it is at least `threshold` bytes
+// (zero meaning never) and compression actually makes it smaller. Otherwise returns `buf`
+// unchanged.
 
 class DurableObjectStorageOperations {
   // Common implementation of DurableObjectStorage and DurableObjectTransaction. This class is
@@ -143,9 +152,27 @@ protected:
 
   virtual ActorCacheOps& getCache(OpName op) = 0;
 
+  struct ListRange {
+    kj::String start;
+    kj::Maybe<kj::String> end;
+    bool reverse = false;
+    kj::Maybe<uint> limit;
+  };
+
+  static kj::Maybe<ListRange> parseListRange(jsg::Optional<ListOptions>& options);
+  // Computes the key range to list from `options`, consuming its key strings. Returns null if the
+  // range is empty.
+
   virtual bool useDirectIo() = 0;
   // Whether to skip caching and allow concurrency on all operations.
 
+  virtual uint32_t valueCompressionThreshold() = 0;
+  // Size at or above which serialized values are compressed before being written, or zero to
+  // never compress. See compressStorageValue().
+
+  virtual bool useCompactValues() = 0;
+  // Whether to serialize values in jsg::Serializer's compact format where possible.
+
   template <typename T>
   T configureOptions(T&& options) {
     // Method that should be called at the start of each storage operation to override any of the
@@ -176,8 +203,10 @@ class DurableObjectTransaction;
 
 class DurableObjectStorage: public jsg::Object, public DurableObjectStorageOperations {
 public:
-  DurableObjectStorage(IoPtr<ActorCacheInterface> cache)
-    : cache(kj::mv(cache)) {}
+  DurableObjectStorage(IoPtr<ActorCacheInterface> cache, uint32_t compressionThreshold = 0,
+                       bool compactValues = false)
+    : cache(kj::mv(cache)), compressionThreshold(compressionThreshold),
+      compactValues(compactValues) {}
 
   ActorCacheInterface& getActorCacheInterface() { return *cache; }
 
@@ -222,6 +251,53 @@ public:
   // It is up to the caller to force a restart in order to complete the restoration, for instance
   // by calling state.abort() or by throwing from a blockConcurrencyWhile() callback.
 
+  void prefetch(kj::OneOf<kj::Array<kj::String>, ListOptions> keysOrRange);
+  // Hint that the given keys, or the given key range, will be read soon. Both forms issue a single
+  // batched read to storage in the background and populate the cache with the results, so a cold
+  // object can warm up in one round trip instead of one per key. Returns immediately -- the read
+  // doesn't hold the input gate, and errors are ignored since the eventual get() or list() will
+  // report them. Does nothing when storage is not backed by ActorCache, since reads are then
+  // local anyway.
+
+private:
+  struct ListIteratorState {
+    jsg::Ref<DurableObjectStorage> storage;
+    ListOptions options;
+    // Only `allowConcurrency` and `noCache` are used; the key range is tracked below.
+
+    ListRange range;
+    // Remaining range to list. After each batch, `start` (or `end`, if listing in reverse) is
+    // advanced past the last key returned, and `limit` is reduced by the number of rows.
+
+    kj::Array<jsg::Value> pending;
+    size_t pendingPos = 0;
+    // The current batch of [key, value] pairs that have not been yielded yet.
+
+    bool done = false;
+    // True once storage has no more rows to return in the range.
+  };
+
+  static constexpr uint LIST_ITERATOR_BATCH_SIZE = 128;
+
+  static jsg::Promise<kj::Maybe<jsg::Value>> listIteratorNext(
+      jsg::Lock& js, ListIteratorState& state);
+  static jsg::Promise<void> listIteratorReturn(
+      jsg::Lock& js, ListIteratorState& state, jsg::Optional<jsg::Value> value);
+
+public:
+  JSG_ASYNC_ITERATOR_WITH_OPTIONS(ListIterator,
+                                   listIterator,
+                                   jsg::Value,
+                                   ListIteratorState,
+                                   listIteratorNext,
+                                   listIteratorReturn,
+                                   ListOptions);
+  // Like list(), but returns an async iterator over [key, value] pairs instead of a Map. Rows are
+  // fetched from the cache (and storage) in batches of LIST_ITERATOR_BATCH_SIZE as the iterator
+  // is consumed, so the first rows are available without waiting for the whole range, and memory
+  // use is bounded by the batch size rather than the size of the range. Each batch is consistent
+  // on its own, but unlike list(), writes made between batches may be observed.
+
   JSG_RESOURCE_TYPE(DurableObjectStorage, CompatibilityFlags::Reader flags) {
     JSG_METHOD(get);
     JSG_METHOD(list);
@@ -237,6 +313,8 @@ public:
     if (flags.getWorkerdExperimental()) {
       JSG_LAZY_INSTANCE_PROPERTY(sql, getSql);
       JSG_METHOD(transactionSync);
+      JSG_METHOD(listIterator);
+      JSG_METHOD(prefetch);
 
       JSG_METHOD(getCurrentBookmark);
       JSG_METHOD(getBookmarkForTime);
@@ -267,15 +345,27 @@ protected:
     return false;
   }
 
+  uint32_t valueCompressionThreshold() override {
+    return compressionThreshold;
+  }
+
+  bool useCompactValues() override {
+    return compactValues;
+  }
+
 private:
   IoPtr<ActorCacheInterface> cache;
+  uint32_t compressionThreshold;
+  bool compactValues;
   uint transactionSyncDepth = 0;
 };
 
 class DurableObjectTransaction final: public jsg::Object, public DurableObjectStorageOperations {
 public:
-  DurableObjectTransaction(IoOwn<ActorCacheInterface::Transaction> cacheTxn)
-    : cacheTxn(kj::mv(cacheTxn)) {}
+  DurableObjectTransaction(IoOwn<ActorCacheInterface::Transaction> cacheTxn,
+                           uint32_t compressionThreshold = 0, bool compactValues = false)
+    : cacheTxn(kj::mv(cacheTxn)), compressionThreshold(compressionThreshold),
+      compactValues(compactValues) {}
 
   kj::Promise<void> maybeCommit();
   void maybeRollback();
@@ -321,10 +411,21 @@ protected:
     return false;
   }
 
+  uint32_t valueCompressionThreshold() override {
+    return compressionThreshold;
+  }
+
+  bool useCompactValues() override {
+    return compactValues;
+  }
+
 private:
   kj::Maybe<IoOwn<ActorCacheInterface::Transaction>> cacheTxn;
   // Becomes null when committed or rolled back.
 
+  uint32_t compressionThreshold;
+  bool compactValues;
+
   bool rolledBack = false;
 
   friend DurableObjectStorage;
@@ -432,6 +533,23 @@ public:
   // If no tag is provided, an array of all accepted WebSockets is returned.
   // Disconnected WebSockets are automatically removed from the list.
 
+  struct BroadcastOptions {
+    jsg::Optional<kj::String> tag;
+    // Only send to WebSockets with this tag.
+
+    jsg::Optional<kj::Array<jsg::Ref<WebSocket>>> except;
+    // WebSockets to skip, e.g. the one that sent the message being relayed.
+
+    JSG_STRUCT(tag, except);
+  };
+
+  void broadcast(jsg::Lock& js, kj::OneOf<kj::Array<byte>, kj::String> message,
+                 jsg::Optional<BroadcastOptions> options);
+  // Sends `message` to all accepted WebSockets, or to those matching `options.tag`. This behaves
+  // as if send() were called on each, except that the message is only converted from JavaScript
+  // once, hibernating WebSockets are not woken up, and sockets that can no longer send (e.g.
+  // because close() was called on them) are skipped instead of throwing.
+
   void setWebSocketAutoResponse(jsg::Optional<jsg::Ref<api::WebSocketRequestResponsePair>> maybeReqResp);
   // Sets an object-wide websocket auto response message for a specific
   // request string. All websockets belonging to the same object must
@@ -452,6 +570,9 @@ public:
     JSG_METHOD(blockConcurrencyWhile);
     JSG_METHOD(acceptWebSocket);
     JSG_METHOD(getWebSockets);
+    if (flags.getWorkerdExperimental()) {
+      JSG_METHOD(broadcast);
+    }
     JSG_METHOD(setWebSocketAutoResponse);
     JSG_METHOD(getWebSocketAutoResponse);
     JSG_METHOD(getWebSocketAutoResponseTimestamp);
@@ -483,8 +604,10 @@ private:
 #define EW_ACTOR_STATE_ISOLATE_TYPES                     \
   api::ActorState,                                       \
   api::DurableObjectState,                               \
+  api::DurableObjectState::BroadcastOptions,             \
   api::DurableObjectTransaction,                         \
   api::DurableObjectStorage,                             \
+  api::DurableObjectStorage::ListIterator,               \
   api::DurableObjectStorage::TransactionOptions,         \
   api::DurableObjectStorageOperations::ListOptions,      \
   api::DurableObjectStorageOperations::GetOptions,       \
@@ -0,0 +1,45 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "analytics-engine.h"
+#include <kj/test.h>
+#include <workerd/tests/test-fixture.h>
+
+namespace workerd::api {
+namespace {
+
+KJ_TEST("AnalyticsEngine flushes full batches at once, and the rest at the end of the turn") {
+  TestFixture fixture;
+
+  fixture.runInIoContext([&](const TestFixture::Environment& env) -> kj::Promise<void> {
+    auto dataset = jsg::alloc<AnalyticsEngine>(0, kj::str("dataset"), 1, 123);
+    for (auto i KJ_UNUSED: kj::zeroTo(130)) {
+      dataset->writeDataPoint(env.js, nullptr);
+    }
+
+    // Each batch is handed to logfwdr as soon as it's full.
+    KJ_EXPECT(fixture.logfwdrBatches.asPtr() == kj::arr(64u, 64u).asPtr());
+
+    return kj::evalLater([&]() {
+      KJ_EXPECT(fixture.logfwdrBatches.asPtr() == kj::arr(64u, 64u, 2u).asPtr());
+    });
+  });
+}
+
+KJ_TEST("AnalyticsEngine flushes data points written just before the request ends") {
+  TestFixture fixture;
+
+  fixture.runInIoContext([&](const TestFixture::Environment& env) {
+    auto dataset = jsg::alloc<AnalyticsEngine>(0, kj::str("dataset"), 1, 123);
+    for (auto i KJ_UNUSED: kj::zeroTo(3)) {
+      dataset->writeDataPoint(env.js, nullptr);
+    }
+    KJ_EXPECT(fixture.logfwdrBatches.empty());
+  });
+
+  KJ_EXPECT(fixture.logfwdrBatches.asPtr() == kj::arr(3u).asPtr());
+}
+
+}  // namespace
+}  // namespace workerd::api
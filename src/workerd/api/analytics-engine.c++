@@ -4,6 +4,7 @@
 
 #include "analytics-engine.h"
 #include <workerd/io/io-context.h>
+#include <capnp/orphan.h>
 
 namespace workerd::api {
 
@@ -13,29 +14,68 @@ void AnalyticsEngine::writeDataPoint(jsg::Lock& js,
 
   context.getLimitEnforcer().newAnalyticsEngineRequest();
 
-  context.writeLogfwdr(logfwdrChannel, [&](capnp::AnyPointer::Builder ptr) {
-    api::AnalyticsEngineEvent::Builder aeEvent = ptr.initAs<api::AnalyticsEngineEvent>();
-
-    aeEvent.setAccountId(static_cast<int64_t>(ownerId));
-    aeEvent.setTimestamp(now());
-    aeEvent.setDataset(dataset.asBytes());
-    aeEvent.setSchemaVersion(version);
-    // `index1` should default to the empty string (`""`).
-    // The optional call to `setIndexes()`below assumes defaults, if any.
-    aeEvent.setIndex1(""_kj.asBytes());
-
-    kj::StringPtr errorPrefix = "writeDataPoint(): "_kj;
-    KJ_IF_MAYBE(ev, event) {
-      KJ_IF_MAYBE(indexes, ev->indexes) {
-        setIndexes<api::AnalyticsEngineEvent::Builder>(aeEvent, *indexes, errorPrefix);
-      }
-      KJ_IF_MAYBE(blobs, ev->blobs) {
-        setBlobs<api::AnalyticsEngineEvent::Builder>(aeEvent, *blobs, errorPrefix);
-      }
-      KJ_IF_MAYBE(doubles, ev->doubles) {
-        setDoubles<api::AnalyticsEngineEvent::Builder>(aeEvent, *doubles, errorPrefix);
-      }
+  auto& batch = getBatch(context);
+  auto orphan = batch.arena.getOrphanage().newOrphan<api::AnalyticsEngineEvent>();
+  api::AnalyticsEngineEvent::Builder aeEvent = orphan.get();
+
+  aeEvent.setAccountId(static_cast<int64_t>(ownerId));
+  aeEvent.setTimestamp(now());
+  aeEvent.setDataset(dataset.asBytes());
+  aeEvent.setSchemaVersion(version);
+  // `index1` should default to the empty string (`""`).
+  // The optional call to `setIndexes()`below assumes defaults, if any.
+  aeEvent.setIndex1(""_kj.asBytes());
+
+  kj::StringPtr errorPrefix = "writeDataPoint(): "_kj;
+  KJ_IF_MAYBE(ev, event) {
+    KJ_IF_MAYBE(indexes, ev->indexes) {
+      setIndexes<api::AnalyticsEngineEvent::Builder>(aeEvent, *indexes, errorPrefix);
+    }
+    KJ_IF_MAYBE(blobs, ev->blobs) {
+      setBlobs<api::AnalyticsEngineEvent::Builder>(aeEvent, *blobs, errorPrefix);
+    }
+    KJ_IF_MAYBE(doubles, ev->doubles) {
+      setDoubles<api::AnalyticsEngineEvent::Builder>(aeEvent, *doubles, errorPrefix);
     }
+  }
+
+  // Only added once it's valid; an invalid data point throws above and is simply dropped.
+  batch.events.add(kj::mv(orphan));
+  if (batch.events.size() >= MAX_BATCH_POINTS) {
+    flush(batch);
+  }
+}
+
+AnalyticsEngine::PendingBatch& AnalyticsEngine::getBatch(IoContext& context) {
+  KJ_IF_MAYBE(batch, pending) {
+    if ((*batch)->open && &(*batch)->context == &context) {
+      return **batch;
+    }
+  }
+
+  auto batch = kj::refcounted<PendingBatch>(context, logfwdrChannel);
+  auto& result = *batch;
+
+  // Flush once the current turn is over, i.e. after any other data points written synchronously
+  // alongside this one. If the IoContext is canceled first, the task is dropped, and with it the
+  // batch, which must then stop accepting data points.
+  context.addWaitUntil(kj::evalLater([batch = kj::addRef(*batch)]() mutable {
+    if (batch->open) flush(*batch);
+  }).attach(kj::defer([batch = kj::addRef(*batch)]() mutable {
+    batch->open = false;
+  })));
+
+  pending = kj::mv(batch);
+  return result;
+}
+
+void AnalyticsEngine::flush(PendingBatch& batch) {
+  batch.open = false;
+  auto& events = batch.events;
+  if (events.empty()) return;
+  batch.context.writeLogfwdrBatch(batch.logfwdrChannel, events.size(),
+      [&](uint i, capnp::AnyPointer::Builder ptr) {
+    ptr.setAs<api::AnalyticsEngineEvent>(events[i].getReader());
   });
 }
 }  // namespace workerd::api
@@ -8,6 +8,9 @@
 #include <workerd/api/analytics-engine-impl.h>
 #include <workerd/jsg/jsg.h>
 #include <workerd/api/analytics-engine.capnp.h>
+#include <capnp/message.h>
+
+namespace workerd { class IoContext; }
 
 namespace workerd::api {
 
@@ -52,6 +55,10 @@ public:
              jsg::Optional<api::AnalyticsEngine::AnalyticsEngineEvent> event);
   // Send an Analytics Engine-compatible event to the configured logfwdr socket.
   // Like logfwdr itself, `writeDataPoint` makes no delivery guarantees.
+  //
+  // The event is validated and encoded immediately, but is held in a batch with the other data
+  // points written during the same turn of the same IoContext, and the whole batch is handed to
+  // logfwdr at once, at the end of the turn or once it reaches MAX_BATCH_POINTS.
 
   JSG_RESOURCE_TYPE(AnalyticsEngine) {
     JSG_METHOD(writeDataPoint);
@@ -60,6 +67,30 @@ public:
   }
 
 private:
+  struct PendingBatch: public kj::Refcounted {
+    PendingBatch(IoContext& context, uint logfwdrChannel)
+        : context(context), logfwdrChannel(logfwdrChannel) {}
+
+    IoContext& context;
+    // Only valid while `open`; used to tell whether a data point belongs in this batch.
+
+    uint logfwdrChannel;
+
+    capnp::MallocMessageBuilder arena;
+    kj::Vector<capnp::Orphan<api::AnalyticsEngineEvent>> events;
+
+    bool open = true;
+    // Cleared once the batch has been flushed, or its flush task has been canceled along with
+    // its IoContext; after that, data points start a new batch.
+  };
+
+  static constexpr uint MAX_BATCH_POINTS = 64;
+
+  kj::Maybe<kj::Own<PendingBatch>> pending;
+
+  PendingBatch& getBatch(IoContext& context);
+  static void flush(PendingBatch& batch);
+
   double millisToNanos(double m) {
     return m * 1000000;
   }
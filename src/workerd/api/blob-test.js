@@ -42,6 +42,31 @@ export default {
       reader.releaseLock();
     }
 
+    {
+      // Parts large enough to be shared rather than copied, with slices crossing their edges.
+      let a = new Blob(["a".repeat(2000)]);
+      let b = new Blob(["b".repeat(3000)]);
+      let big = new Blob([a, "-", b, a.slice(500, 1500)]);
+      assertEqual(big.size, 6001);
+      assertEqual(await big.slice(1998, 2004).text(), "aa-bbb");
+      assertEqual(await big.slice(4999, 5003).text(), "bbaa");
+      let nested = new Blob([big.slice(1990, 2010), big.slice(-10)]);
+      assertEqual(await nested.text(), "a".repeat(10) + "-" + "b".repeat(9) + "a".repeat(10));
+      assertEqual((await big.arrayBuffer()).byteLength, 6001);
+
+      let text = await new Response(big.stream()).text();
+      assertEqual(text, "a".repeat(2000) + "-" + "b".repeat(3000) + "a".repeat(1000));
+
+      let reader = big.slice(1999, 2002).stream().getReader();
+      let chunks = "";
+      for (;;) {
+        let readResult = await reader.read();
+        if (readResult.done) break;
+        chunks += new TextDecoder().decode(readResult.value);
+      }
+      assertEqual(chunks, "a-b");
+    }
+
     let before = Date.now();
 
     let file = new File([blob, "qux"], "filename.txt");
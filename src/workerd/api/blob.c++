@@ -8,54 +8,71 @@
 
 namespace workerd::api {
 
-static kj::Array<byte> concat(jsg::Optional<Blob::Bits> maybeBits) {
-  // Concatenate an array of segments (parameter to Blob constructor).
+static constexpr size_t MIN_SHARED_SEGMENT_SIZE = 1024;
+// Segments of a Blob passed to the Blob constructor smaller than this are copied rather than
+// shared, so that building a Blob out of many tiny pieces doesn't leave it with a long rope of
+// tiny segments.
+
+static kj::Array<Blob::Segment> concat(jsg::Optional<Blob::Bits> maybeBits) {
+  // Concatenate an array of parts (parameter to Blob constructor) into a list of segments.
   //
-  // TODO(perf): Make it so that a Blob can keep references to the input data rather than copy it.
-  //   Note that we can't keep references to ArrayBuffers since they are mutable, but we can
-  //   reference other Blobs in the input.
+  // We can't keep references to ArrayBuffers since they are mutable, so those (and strings) are
+  // copied, but we share the content of other Blobs in the input.
 
   auto bits = kj::mv(maybeBits).orDefault(nullptr);
 
-  size_t size = 0;
-  for (auto& part: bits) {
-    KJ_SWITCH_ONEOF(part) {
-      KJ_CASE_ONEOF(bytes, kj::Array<const byte>) {
-        size += bytes.size();
-      }
-      KJ_CASE_ONEOF(text, kj::String) {
-        size += text.size();
-      }
-      KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
-        size += blob->getData().size();
-      }
-    }
-  }
+  kj::Vector<Blob::Segment> segments;
+  kj::Vector<kj::ArrayPtr<const byte>> pending;
+  size_t pendingSize = 0;
 
-  if (size == 0) return nullptr;
+  auto copy = [&](kj::ArrayPtr<const byte> bytes) {
+    if (bytes.size() > 0) {
+      pending.add(bytes);
+      pendingSize += bytes.size();
+    }
+  };
+  auto flushPending = [&]() {
+    // Copy consecutive unshared parts into one new buffer.
+    if (pendingSize == 0) return;
+
+    auto copied = kj::heapArray<byte>(pendingSize);
+    byte* ptr = copied.begin();
+    for (auto bytes: pending) {
+      memcpy(ptr, bytes.begin(), bytes.size());
+      ptr += bytes.size();
+    }
+    KJ_ASSERT(ptr == copied.end());
 
-  auto result = kj::heapArray<byte>(size);
-  byte* ptr = result.begin();
+    kj::ArrayPtr<const byte> view = copied;
+    segments.add(Blob::Segment { kj::refcounted<Blob::Buffer>(kj::mv(copied)), view });
+    pending.clear();
+    pendingSize = 0;
+  };
 
   for (auto& part: bits) {
     KJ_SWITCH_ONEOF(part) {
       KJ_CASE_ONEOF(bytes, kj::Array<const byte>) {
-        memcpy(ptr, bytes.begin(), bytes.size());
-        ptr += bytes.size();
+        copy(bytes);
       }
       KJ_CASE_ONEOF(text, kj::String) {
-        memcpy(ptr, text.begin(), text.size());
-        ptr += text.size();
+        copy(text.asBytes());
       }
       KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
-        memcpy(ptr, blob->getData().begin(), blob->getData().size());
-        ptr += blob->getData().size();
+        for (auto& segment: blob->getSegments()) {
+          if (segment.bytes.size() < MIN_SHARED_SEGMENT_SIZE) {
+            // `blob` outlives `pending`, so the bytes stay valid until they're copied.
+            copy(segment.bytes);
+          } else {
+            flushPending();
+            segments.add(kj::mv(segment));
+          }
+        }
       }
     }
   }
+  flushPending();
 
-  KJ_ASSERT(ptr == result.end());
-  return result;
+  return segments.releaseAsArray();
 }
 
 static kj::String normalizeType(kj::String type) {
@@ -74,6 +91,57 @@ static kj::String normalizeType(kj::String type) {
   return kj::mv(type);
 }
 
+Blob::Blob(kj::Array<byte> data, kj::String type)
+    : size(data.size()), type(kj::mv(type)) {
+  if (size > 0) {
+    kj::ArrayPtr<const byte> view = data;
+    segments = kj::arr(Segment { kj::refcounted<Buffer>(kj::mv(data)), view });
+  }
+}
+
+Blob::Blob(kj::Own<Buffer> buffer, kj::String type)
+    : size(buffer->bytes.size()), type(kj::mv(type)) {
+  if (size > 0) {
+    kj::ArrayPtr<const byte> view = buffer->bytes;
+    segments = kj::arr(Segment { kj::mv(buffer), view });
+  }
+}
+
+Blob::Blob(kj::Array<Segment> segments, kj::String type)
+    : segments(kj::mv(segments)), size(0), type(kj::mv(type)) {
+  for (auto& segment: this->segments) {
+    size += segment.bytes.size();
+  }
+}
+
+kj::ArrayPtr<const byte> Blob::getData() const {
+  if (segments.size() > 1) {
+    auto flat = kj::heapArray<byte>(size);
+    copyTo(flat);
+    kj::ArrayPtr<const byte> view = flat;
+    segments = kj::arr(Segment { kj::refcounted<Buffer>(kj::mv(flat)), view });
+  }
+
+  if (segments.size() == 0) {
+    return nullptr;
+  } else {
+    return segments[0].bytes;
+  }
+}
+
+kj::Array<Blob::Segment> Blob::getSegments() const {
+  return KJ_MAP(segment, segments) { return segment.clone(); };
+}
+
+void Blob::copyTo(kj::ArrayPtr<byte> out) const {
+  KJ_ASSERT(out.size() == size);
+  byte* ptr = out.begin();
+  for (auto& segment: segments) {
+    memcpy(ptr, segment.bytes.begin(), segment.bytes.size());
+    ptr += segment.bytes.size();
+  }
+}
+
 jsg::Ref<Blob> Blob::constructor(jsg::Optional<Bits> bits, jsg::Optional<Options> options) {
   kj::String type;  // note: default value is intentionally empty string
   KJ_IF_MAYBE(o, options) {
@@ -88,89 +156,140 @@ jsg::Ref<Blob> Blob::constructor(jsg::Optional<Bits> bits, jsg::Optional<Options
 jsg::Ref<Blob> Blob::slice(jsg::Optional<int> maybeStart, jsg::Optional<int> maybeEnd,
                             jsg::Optional<kj::String> type) {
   int start = maybeStart.orDefault(0);
-  int end = maybeEnd.orDefault(data.size());
+  int end = maybeEnd.orDefault(size);
 
   if (start < 0) {
     // Negative value interpreted as offset from end.
-    start += data.size();
+    start += size;
   }
   // Clamp start to range.
   if (start < 0) {
     start = 0;
-  } else if (start > data.size()) {
-    start = data.size();
+  } else if (start > size) {
+    start = size;
   }
 
   if (end < 0) {
     // Negative value interpreted as offset from end.
-    end += data.size();
+    end += size;
   }
   // Clamp end to range.
   if (end < start) {
     end = start;
-  } else if (end > data.size()) {
-    end = data.size();
+  } else if (end > size) {
+    end = size;
   }
 
-  return jsg::alloc<Blob>(JSG_THIS, data.slice(start, end),
+  // Share the segments overlapping [start, end), trimming the first and last.
+  kj::Vector<Segment> result;
+  size_t offset = 0;
+  for (auto& segment: segments) {
+    size_t segmentStart = offset;
+    size_t segmentEnd = offset + segment.bytes.size();
+    offset = segmentEnd;
+
+    if (segmentEnd <= start) continue;
+    if (segmentStart >= end) break;
+
+    size_t from = kj::max(size_t(start), segmentStart) - segmentStart;
+    size_t to = kj::min(size_t(end), segmentEnd) - segmentStart;
+    result.add(Segment { kj::addRef(*segment.buffer), segment.bytes.slice(from, to) });
+  }
+
+  return jsg::alloc<Blob>(result.releaseAsArray(),
       normalizeType(kj::mv(type).orDefault(nullptr)));
 }
 
 jsg::Promise<kj::Array<kj::byte>> Blob::arrayBuffer(v8::Isolate* isolate) {
-  // TODO(perf): Find a way to avoid the copy.
-  return jsg::resolvedPromise(isolate, kj::heapArray<byte>(data));
+  // The caller gets a mutable ArrayBuffer, so this copy can't be avoided, but there's no need to
+  // flatten the Blob itself first.
+  auto result = kj::heapArray<byte>(size);
+  copyTo(result);
+  return jsg::resolvedPromise(isolate, kj::mv(result));
 }
 jsg::Promise<kj::String> Blob::text(v8::Isolate* isolate) {
-  return jsg::resolvedPromise(isolate, kj::str(data.asChars()));
+  auto result = kj::heapString(size);
+  copyTo(result.asBytes());
+  return jsg::resolvedPromise(isolate, kj::mv(result));
 }
 
 class Blob::BlobInputStream final: public ReadableStreamSource {
+  // Reads a Blob's segments in order, without flattening them. Holds its own references to the
+  // segments' buffers, so it doesn't depend on the Blob object itself.
+
 public:
-  BlobInputStream(jsg::Ref<Blob> blob)
-      : unread(blob->data),
-        blob(kj::mv(blob)) {}
+  BlobInputStream(kj::Array<Segment> segments)
+      : segments(kj::mv(segments)) {
+    for (auto& segment: this->segments) {
+      remaining += segment.bytes.size();
+    }
+    if (this->segments.size() > 0) {
+      unread = this->segments[0].bytes;
+    }
+  }
 
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
-    size_t amount = kj::min(maxBytes, unread.size());
-    memcpy(buffer, unread.begin(), amount);
-    unread = unread.slice(amount, unread.size());
-    return amount;
+    byte* out = reinterpret_cast<byte*>(buffer);
+    size_t total = 0;
+    while (total < maxBytes && remaining > 0) {
+      if (unread.size() == 0) {
+        unread = segments[++current].bytes;
+        continue;
+      }
+      size_t amount = kj::min(maxBytes - total, unread.size());
+      memcpy(out + total, unread.begin(), amount);
+      unread = unread.slice(amount, unread.size());
+      remaining -= amount;
+      total += amount;
+    }
+    return total;
   }
 
   kj::Maybe<uint64_t> tryGetLength(StreamEncoding encoding) override {
     if (encoding == StreamEncoding::IDENTITY) {
-      return unread.size();
+      return remaining;
     } else {
       return nullptr;
     }
   }
 
   kj::Promise<DeferredProxy<void>> pumpTo(WritableStreamSink& output, bool end) override {
-    if (unread.size() == 0) {
+    if (remaining == 0) {
       return addNoopDeferredProxy(kj::READY_NOW);
     }
 
-    auto promise = output.write(unread.begin(), unread.size());
+    // Write all the remaining segments in a single gathered write.
+    auto pieces = kj::heapArrayBuilder<kj::ArrayPtr<const byte>>(segments.size() - current);
+    pieces.add(unread);
+    for (auto& segment: segments.slice(current + 1, segments.size())) {
+      pieces.add(segment.bytes);
+    }
+    auto piecesArray = pieces.finish();
+    auto promise = output.write(piecesArray).attach(kj::mv(piecesArray), kj::mv(segments));
+    current = 0;
     unread = nullptr;
+    remaining = 0;
 
     if (end) {
       promise = promise.then([&output]() { return output.end(); });
     }
 
-    // We can't defer the write to the proxy stage since it depends on `blob` which lives in the
-    // isolate.
-    return addNoopDeferredProxy(kj::mv(promise));
+    // The write owns the segments' buffers, which don't depend on the Blob in the isolate, so it's
+    // eligible to be deferred past IoContext lifetime.
+    return kj::Promise<DeferredProxy<void>>(DeferredProxy<void> { kj::mv(promise) });
   }
 
 private:
+  kj::Array<Segment> segments;
+  size_t current = 0;
   kj::ArrayPtr<const byte> unread;
-  jsg::Ref<Blob> blob;
+  uint64_t remaining = 0;
 };
 
 jsg::Ref<ReadableStream> Blob::stream(v8::Isolate* isolate) {
   return jsg::alloc<ReadableStream>(
       IoContext::current(),
-      kj::heap<BlobInputStream>(JSG_THIS));
+      kj::heap<BlobInputStream>(getSegments()));
 }
 
 // =======================================================================================
@@ -12,13 +12,45 @@ namespace workerd::api {
 class ReadableStream;
 
 class Blob: public jsg::Object {
+  // A Blob's content is a rope: a list of segments, each a view into an immutable, refcounted
+  // buffer. Building a Blob out of other Blobs, or slicing one, shares their buffers rather than
+  // copying the bytes. Only parts that may still change after the constructor returns (strings
+  // and ArrayBuffers from JavaScript) are copied, and consecutive ones are coalesced into a single
+  // new buffer.
+
 public:
-  Blob(kj::Array<byte> data, kj::String type)
-      : ownData(kj::mv(data)), data(ownData.get<kj::Array<byte>>()), type(kj::mv(type)) {}
-  Blob(jsg::Ref<Blob> parent, kj::ArrayPtr<const byte> data, kj::String type)
-      : ownData(kj::mv(parent)), data(data), type(kj::mv(type)) {}
+  class Buffer final: public kj::Refcounted {
+    // Immutable bytes shared by the segments of any number of Blobs.
+  public:
+    explicit Buffer(kj::Array<const byte> bytes): bytes(kj::mv(bytes)) {}
+
+    const kj::Array<const byte> bytes;
+  };
+
+  struct Segment {
+    kj::Own<Buffer> buffer;
+    kj::ArrayPtr<const byte> bytes;
+    // Points into `buffer->bytes`.
+
+    Segment clone() const { return { kj::addRef(*buffer), bytes }; }
+  };
+
+  Blob(kj::Array<byte> data, kj::String type);
+  // Takes ownership of `data`, which must not be modified afterwards.
 
-  inline kj::ArrayPtr<const byte> getData() const KJ_LIFETIMEBOUND { return data; }
+  Blob(kj::Own<Buffer> buffer, kj::String type);
+  // Shares the whole of `buffer`, which may be, for instance, a memory-mapped file.
+
+  Blob(kj::Array<Segment> segments, kj::String type);
+
+  kj::ArrayPtr<const byte> getData() const KJ_LIFETIMEBOUND;
+  // Returns the content as one contiguous array. A Blob with more than one segment flattens
+  // itself into a single new buffer the first time this is called, so prefer getSegments() or
+  // stream() when the content doesn't need to be contiguous.
+
+  kj::Array<Segment> getSegments() const;
+  // Returns new references to this Blob's segments, e.g. to build another Blob sharing its
+  // content.
 
   // ---------------------------------------------------------------------------
   // JS API
@@ -34,7 +66,7 @@ public:
 
   static jsg::Ref<Blob> constructor(jsg::Optional<Bits> bits, jsg::Optional<Options> options);
 
-  int getSize() { return data.size(); }
+  int getSize() { return size; }
   kj::StringPtr getType() { return type; }
 
   jsg::Ref<Blob> slice(jsg::Optional<int> start, jsg::Optional<int> end,
@@ -60,15 +92,14 @@ public:
   }
 
 private:
-  kj::OneOf<kj::Array<byte>, jsg::Ref<Blob>> ownData;
-  kj::ArrayPtr<const byte> data;
+  mutable kj::Array<Segment> segments;
+  // Mutable so that getData() can flatten it.
+
+  size_t size;
   kj::String type;
 
-  void visitForGc(jsg::GcVisitor& visitor) {
-    KJ_IF_MAYBE(b, ownData.tryGet<jsg::Ref<Blob>>()) {
-      visitor.visit(*b);
-    }
-  }
+  void copyTo(kj::ArrayPtr<byte> out) const;
+  // Gathers the segments into `out`, which must be exactly `size` bytes.
 
   class BlobInputStream;
 };
@@ -78,6 +109,9 @@ public:
   File(kj::Array<byte> data, kj::String name, kj::String type, double lastModified)
       : Blob(kj::mv(data), kj::mv(type)),
         name(kj::mv(name)), lastModified(lastModified) {}
+  File(kj::Array<Segment> segments, kj::String name, kj::String type, double lastModified)
+      : Blob(kj::mv(segments), kj::mv(type)),
+        name(kj::mv(name)), lastModified(lastModified) {}
 
   struct Options {
     jsg::Optional<kj::String> type;
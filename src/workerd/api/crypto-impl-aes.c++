@@ -108,6 +108,9 @@ public:
                       bool extractable, CryptoKeyUsageSet usages)
       : CryptoKey::Impl(extractable, usages),
         keyData(kj::mv(keyData)), keyAlgorithm(kj::mv(keyAlgorithm)) {}
+  ~AesKeyBase() noexcept(false) {
+    OPENSSL_cleanse(keyData.begin(), keyData.size());
+  }
 
 protected:
   kj::StringPtr getAlgorithmName() const override final {
@@ -377,21 +380,24 @@ private:
                                 iv.begin()));
 
     int plainSize = 0;
-    auto blockSize = EVP_CIPHER_CTX_block_size(cipherCtx.get());
 
-    auto plainText = kj::heapArray<kj::byte>(cipherText.size() + ((blockSize > 1) ? blockSize : 0));
+    // The plain text is never longer than the cipher text: passed all of the input at once,
+    // EVP_DecryptUpdate() holds back the last block, and EVP_DecryptFinal_ex() writes that block
+    // minus its padding into the space left behind.
+    auto plainText = kj::heapArray<kj::byte>(cipherText.size());
 
     // Perform the actual decryption.
     OSSLCALL(EVP_DecryptUpdate(cipherCtx.get(), plainText.begin(), &plainSize,
                                cipherText.begin(), cipherText.size()));
-    KJ_ASSERT(plainSize + ((blockSize > 1) ? blockSize : 0) <= plainText.size());
+    KJ_ASSERT(plainSize <= plainText.size(), "buffer overrun");
 
     plainSize += decryptFinalHelper(getAlgorithmName(), cipherText.size(), plainSize,
         cipherCtx.get(), plainText.begin() + plainSize);
     KJ_ASSERT(plainSize <= plainText.size());
 
-    // TODO(perf): Avoid this copy, see comment in the encrypt implementation functions.
-    return kj::heapArray(plainText.begin(), plainSize);
+    // Hand back the unpadded prefix rather than copying it; the padding it strands is at most a
+    // single block.
+    return plainText.slice(0, plainSize).attach(kj::mv(plainText));
   }
 };
 
@@ -452,9 +458,9 @@ protected:
 
     const auto& cipher = lookupAesType(keyData.size());
 
-    kj::Vector<kj::byte> result;
-    // The output of AES-CTR is the same size as the input.
-    result.resize(data.size());
+    auto result = kj::heapArray<kj::byte>(data.size());
+    // The output of AES-CTR is the same size as the input. Every byte of it is written below, so
+    // it is left uninitialized.
 
     auto numCounterValues = newBignum();
     JSG_REQUIRE(BN_lshift(numCounterValues.get(), BN_value_one(), counterBitLength),
@@ -485,7 +491,7 @@ protected:
     if (BN_cmp(numBlocksUntilReset.get(), numOutputBlocks.get()) >= 0) {
       // If the counter doesn't need any wrapping, can evaluate this as a single call.
       process(&cipher, data, counter, result.asPtr());
-      return result.releaseAsArray();
+      return result;
     }
 
     // Need this to be done in 2 parts using the current counter block and then resetting the
@@ -509,7 +515,7 @@ protected:
     process(&cipher, data.slice(inputSizePart1, data.size()), counter, result.slice(
         inputSizePart1, result.size()));
 
-    return result.releaseAsArray();
+    return result;
   }
 
 private:
@@ -611,8 +617,7 @@ public:
         "Unwrapped key has length ", unwrappedKey.size(), " bytes but it should be greater than or "
         "equal to 16 and less than or equal to ", SIZE_MAX - 8);
 
-    kj::Vector<kj::byte> wrapped(unwrappedKey.size() + 8);
-    wrapped.resize(unwrappedKey.size() + 8);
+    auto wrapped = kj::heapArray<kj::byte>(unwrappedKey.size() + 8);
     // Wrapping adds 8 bytes of overhead for storing the IV which we check on decryption.
 
     AES_KEY aesKey;
@@ -624,7 +629,7 @@ public:
         unwrappedKey.begin(), unwrappedKey.size()), DOMOperationError, getAlgorithmName(),
         " key wrapping failed", tryDescribeOpensslErrors());
 
-    return wrapped.releaseAsArray();
+    return wrapped;
   }
 
   kj::Array<kj::byte> unwrapKey(SubtleCrypto::EncryptAlgorithm&& algorithm,
@@ -641,9 +646,8 @@ public:
         "Provided a wrapped key to unwrap this is ", wrappedKey.size() * 8,
         " bits that is less than the minimal length of 192 bits.");
 
-    kj::Vector<kj::byte> unwrapped(wrappedKey.size() - 8);
+    auto unwrapped = kj::heapArray<kj::byte>(wrappedKey.size() - 8);
     // Key wrap adds 8 bytes of overhead because it mixes in the IV.
-    unwrapped.resize(wrappedKey.size() - 8);
 
     AES_KEY aesKey;
     JSG_REQUIRE(0 == AES_set_decrypt_key(keyData.begin(), keyData.size() * 8, &aesKey),
@@ -656,7 +660,7 @@ public:
         wrappedKey.begin(), wrappedKey.size()), DOMOperationError, getAlgorithmName(),
         " key unwrapping failed", tryDescribeOpensslErrors());
 
-    return unwrapped.releaseAsArray();
+    return unwrapped;
   }
 };
 
@@ -985,6 +985,13 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateRsa(
     jsg::Lock& js, kj::StringPtr normalizedName,
     SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
     kj::ArrayPtr<const kj::String> keyUsages) {
+  return prepareGenerateRsa(js, normalizedName, kj::mv(algorithm), extractable, keyUsages)()();
+}
+
+kj::Function<CryptoKey::Impl::FinishGenerateFunc()> CryptoKey::Impl::prepareGenerateRsa(
+    jsg::Lock& js, kj::StringPtr normalizedName,
+    SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
+    kj::ArrayPtr<const kj::String> keyUsages) {
 
   KJ_ASSERT(normalizedName == "RSASSA-PKCS1-v1_5" || normalizedName == "RSA-PSS" ||
       normalizedName == "RSA-OAEP", "generateRsa called on non-RSA cryptoKey", normalizedName);
@@ -1016,18 +1023,10 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateRsa(
   JSG_REQUIRE(!(FeatureFlags::get(js).getStrictCrypto() && (modulusLength & 127)), DOMOperationError,
       "Can't generate key: RSA key size is required to be a multiple of 128");
 
+  // Parse the exponent here, since `publicExponent` may still be backed by a JavaScript buffer.
   auto bnExponent = OSSLCALL_OWN(BIGNUM, BN_bin2bn(publicExponent.begin(),
       publicExponent.size(), nullptr), InternalDOMOperationError, "Error setting up RSA keygen.");
 
-  auto rsaPrivateKey = OSSL_NEW(RSA);
-  OSSLCALL(RSA_generate_key_ex(rsaPrivateKey, modulusLength, bnExponent.get(), 0));
-  auto privateEvpPKey = OSSL_NEW(EVP_PKEY);
-  OSSLCALL(EVP_PKEY_set1_RSA(privateEvpPKey.get(), rsaPrivateKey.get()));
-  kj::Own<RSA> rsaPublicKey = OSSLCALL_OWN(RSA, RSAPublicKey_dup(rsaPrivateKey.get()),
-      InternalDOMOperationError, "Error finalizing RSA keygen", internalDescribeOpensslErrors());
-  auto publicEvpPKey = OSSL_NEW(EVP_PKEY);
-  OSSLCALL(EVP_PKEY_set1_RSA(publicEvpPKey.get(), rsaPublicKey));
-
   auto keyAlgorithm = CryptoKey::RsaKeyAlgorithm {
     .name = normalizedName,
     .modulusLength = static_cast<uint16_t>(modulusLength),
@@ -1035,8 +1034,27 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateRsa(
     .hash = KeyAlgorithm { normalizedHashName }
   };
 
-  return generateRsaPair(normalizedName, kj::mv(privateEvpPKey), kj::mv(publicEvpPKey),
-      kj::mv(keyAlgorithm), extractable, usages);
+  // `normalizedName` and `normalizedHashName` point into static tables, so they can be captured.
+  return [normalizedName, modulusLength, bnExponent = kj::mv(bnExponent),
+          keyAlgorithm = kj::mv(keyAlgorithm), extractable, usages]() mutable
+      -> FinishGenerateFunc {
+    auto rsaPrivateKey = OSSL_NEW(RSA);
+    OSSLCALL(RSA_generate_key_ex(rsaPrivateKey, modulusLength, bnExponent.get(), 0));
+    auto privateEvpPKey = OSSL_NEW(EVP_PKEY);
+    OSSLCALL(EVP_PKEY_set1_RSA(privateEvpPKey.get(), rsaPrivateKey.get()));
+    kj::Own<RSA> rsaPublicKey = OSSLCALL_OWN(RSA, RSAPublicKey_dup(rsaPrivateKey.get()),
+        InternalDOMOperationError, "Error finalizing RSA keygen", internalDescribeOpensslErrors());
+    auto publicEvpPKey = OSSL_NEW(EVP_PKEY);
+    OSSLCALL(EVP_PKEY_set1_RSA(publicEvpPKey.get(), rsaPublicKey));
+
+    // The CryptoKeys themselves must be allocated on the isolate's thread.
+    return [normalizedName, privateEvpPKey = kj::mv(privateEvpPKey),
+            publicEvpPKey = kj::mv(publicEvpPKey), keyAlgorithm = kj::mv(keyAlgorithm),
+            extractable, usages]() mutable -> kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> {
+      return generateRsaPair(normalizedName, kj::mv(privateEvpPKey), kj::mv(publicEvpPKey),
+          kj::mv(keyAlgorithm), extractable, usages);
+    };
+  };
 }
 
 kj::Own<EVP_PKEY> rsaJwkReader(SubtleCrypto::JsonWebKey&& keyDataJwk) {
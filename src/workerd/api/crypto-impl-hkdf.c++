@@ -15,6 +15,9 @@ public:
                    bool extractable, CryptoKeyUsageSet usages)
       : CryptoKey::Impl(extractable, usages),
         keyData(kj::mv(keyData)), keyAlgorithm(kj::mv(keyAlgorithm)) {}
+  ~HkdfKey() noexcept(false) {
+    OPENSSL_cleanse(keyData.begin(), keyData.size());
+  }
 
 private:
   kj::Array<kj::byte> deriveBits(
@@ -37,8 +40,7 @@ private:
 
     auto derivedLengthBytes = length / 8;
 
-    kj::Vector<kj::byte> result(derivedLengthBytes);
-    result.resize(derivedLengthBytes);
+    auto result = kj::heapArray<kj::byte>(derivedLengthBytes);
 
     auto operationSucceed = HKDF(result.begin(), result.size(), hashType, keyData.begin(),
         keyData.size(), salt.begin(), salt.size(), info.begin(), info.size());
@@ -47,7 +49,7 @@ private:
       JSG_FAIL_REQUIRE(DOMOperationError, "HKDF deriveBits failed.");
     }
 
-    return result.releaseAsArray();
+    return result;
   }
 
   kj::StringPtr getAlgorithmName() const override { return "HKDF"; }
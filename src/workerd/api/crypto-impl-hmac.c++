@@ -16,7 +16,16 @@ public:
   explicit HmacKey(kj::Array<kj::byte> keyData, CryptoKey::HmacKeyAlgorithm keyAlgorithm,
                    bool extractable, CryptoKeyUsageSet usages)
       : CryptoKey::Impl(extractable, usages),
-        keyData(kj::mv(keyData)), keyAlgorithm(kj::mv(keyAlgorithm)) {}
+        keyData(kj::mv(keyData)), keyAlgorithm(kj::mv(keyAlgorithm)) {
+    // HMAC_Init_ex() hashes the padded key into the inner and outer digest states. That only
+    // depends on the key, so it is done once here and each sign() or verify() starts from a copy.
+    auto type = lookupDigestAlgorithm(this->keyAlgorithm.hash.name).second;
+    OSSLCALL(HMAC_Init_ex(keyedContext.get(), this->keyData.begin(), this->keyData.size(),
+                          type, nullptr));
+  }
+  ~HmacKey() noexcept(false) {
+    OPENSSL_cleanse(keyData.begin(), keyData.size());
+  }
 
 private:
   kj::Array<kj::byte> sign(
@@ -37,14 +46,14 @@ private:
       SubtleCrypto::SignAlgorithm&& algorithm,
       kj::ArrayPtr<const kj::byte> data) const {
     // For HMAC, the hash is specified when creating the key, not at call time.
-    auto type = lookupDigestAlgorithm(keyAlgorithm.hash.name).second;
-    auto messageDigest = kj::heapArray<kj::byte>(EVP_MD_size(type));
+    auto messageDigest = kj::heapArray<kj::byte>(HMAC_size(keyedContext.get()));
 
+    bssl::ScopedHMAC_CTX ctx;
     uint messageDigestSize = 0;
-    auto ptr = HMAC(type, keyData.begin(), keyData.size(),
-                    data.begin(), data.size(),
-                    messageDigest.begin(), &messageDigestSize);
-    JSG_REQUIRE(ptr != nullptr, DOMOperationError, "HMAC computation failed.");
+    JSG_REQUIRE(HMAC_CTX_copy_ex(ctx.get(), keyedContext.get()) &&
+                HMAC_Update(ctx.get(), data.begin(), data.size()) &&
+                HMAC_Final(ctx.get(), messageDigest.begin(), &messageDigestSize),
+                DOMOperationError, "HMAC computation failed.");
 
     KJ_ASSERT(messageDigestSize == messageDigest.size());
     return kj::mv(messageDigest);
@@ -95,6 +104,9 @@ private:
 
   kj::Array<kj::byte> keyData;
   CryptoKey::HmacKeyAlgorithm keyAlgorithm;
+
+  bssl::ScopedHMAC_CTX keyedContext;
+  // Keyed with `keyData` and ready for input. Never updated itself.
 };
 
 void zeroOutTrailingKeyBits(kj::Array<kj::byte>& keyDataArray, int keyBitLength) {
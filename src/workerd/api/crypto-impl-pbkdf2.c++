@@ -14,11 +14,20 @@ public:
                      bool extractable, CryptoKeyUsageSet usages)
       : CryptoKey::Impl(extractable, usages),
         keyData(kj::mv(keyData)), keyAlgorithm(kj::mv(keyAlgorithm)) {}
+  ~Pbkdf2Key() noexcept(false) {
+    OPENSSL_cleanse(keyData.begin(), keyData.size());
+  }
 
 private:
   kj::Array<kj::byte> deriveBits(
       SubtleCrypto::DeriveKeyAlgorithm&& algorithm,
       kj::Maybe<uint32_t> maybeLength) const override {
+    return KJ_ASSERT_NONNULL(deriveBitsOffThread(algorithm, maybeLength))();
+  }
+
+  kj::Maybe<kj::Function<kj::Array<kj::byte>()>> deriveBitsOffThread(
+      SubtleCrypto::DeriveKeyAlgorithm& algorithm,
+      kj::Maybe<uint32_t> maybeLength) const override {
     kj::StringPtr hashName = api::getAlgorithmName(JSG_REQUIRE_NONNULL(algorithm.hash, TypeError,
         "Missing field \"hash\" in \"algorithm\"."));
     auto hashType = lookupDigestAlgorithm(hashName).second;
@@ -37,19 +46,25 @@ private:
     JSG_REQUIRE(iterations > 0, DOMOperationError,
         "PBKDF2 requires a positive iteration count (requested ", iterations, ").");
 
-    // Note: The user could DoS us by selecting a very high iteration count. Our dead man's switch
-    //   would kick in, resulting in a process restart. We guard against this by limiting the maximum
-    //   iteration count a user can select -- this is an intentional non-conformity. Another approach
-    //   might be to fork OpenSSL's PKCS5_PBKDF2_HMAC() function and insert a check for
-    //   v8::Isolate::IsExecutionTerminating() in the loop, but for now a hard cap seems wisest.
+    // Note: The user could DoS us by selecting a very high iteration count. Even off the isolate's
+    //   thread, the derivation ties up a crypto pool thread and is charged to the request's CPU
+    //   time, so we still guard against this by limiting the maximum iteration count a user can
+    //   select -- this is an intentional non-conformity.
     JSG_REQUIRE(iterations <= 100000, DOMNotSupportedError,
         "PBKDF2 iteration counts above 100000 are not supported (requested ", iterations, ").");
 
-    auto output = kj::heapArray<kj::byte>(length / 8);
-    OSSLCALL(PKCS5_PBKDF2_HMAC(keyData.asChars().begin(), keyData.size(),
-                               salt.begin(), salt.size(),
-                               iterations, hashType, output.size(), output.begin()));
-    return kj::mv(output);
+    // The salt may be backed by a JavaScript buffer, and the key may be destroyed by the garbage
+    // collector while the job is running, so the job works on its own copies.
+    return kj::Function<kj::Array<kj::byte>()>(
+        [keyData = kj::heapArray(keyData.asPtr()), salt = kj::heapArray(salt.asConst()),
+         hashType, iterations, length]() mutable {
+      KJ_DEFER(OPENSSL_cleanse(keyData.begin(), keyData.size()));
+      auto output = kj::heapArray<kj::byte>(length / 8);
+      OSSLCALL(PKCS5_PBKDF2_HMAC(keyData.asChars().begin(), keyData.size(),
+                                 salt.begin(), salt.size(),
+                                 iterations, hashType, output.size(), output.begin()));
+      return kj::mv(output);
+    });
   }
 
   // TODO(bug): Possibly by mistake, PBKDF2 was historically not on the allow list of
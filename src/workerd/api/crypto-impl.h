@@ -11,6 +11,9 @@
 #include <kj/encoding.h>
 #include <openssl/evp.h>
 #include <openssl/bio.h>
+#include <openssl/err.h>
+#include <workerd/io/io-context.h>
+#include <workerd/util/thread-pool.h>
 
 #define OSSLCALL(...) if ((__VA_ARGS__) != 1) \
     ::workerd::api::throwOpensslError(__FILE__, __LINE__, #__VA_ARGS__)
@@ -127,6 +130,18 @@ public:
   static GenerateFunc generateEcdh;
   static GenerateFunc generateEddsa;
 
+  using FinishGenerateFunc = kj::Function<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>()>;
+  using PrepareGenerateFunc = kj::Function<FinishGenerateFunc()>(
+      jsg::Lock& js, kj::StringPtr normalizedName,
+      SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
+      kj::ArrayPtr<const kj::String> keyUsages);
+  // Splits a GenerateFunc for algorithms whose key generation is too slow to run under the isolate
+  // lock. The prepare function validates the request and returns a job for the crypto thread pool.
+  // The job generates the key material and returns a function that wraps it into CryptoKeys back
+  // on the isolate's thread.
+
+  static PrepareGenerateFunc prepareGenerateRsa;
+
   Impl(bool extractable, CryptoKeyUsageSet usages) : extractable(extractable), usages(usages) {}
 
   bool isExtractable() const { return extractable; }
@@ -164,6 +179,14 @@ public:
         "The deriveKey and deriveBits operations are not implemented for \"",
         getAlgorithmName(), "\".");
   }
+  virtual kj::Maybe<kj::Function<kj::Array<kj::byte>()>> deriveBitsOffThread(
+      SubtleCrypto::DeriveKeyAlgorithm& algorithm, kj::Maybe<uint32_t> length) const {
+    // For algorithms whose derivation is slow enough to belong on the crypto thread pool: checks
+    // the arguments as deriveBits() would, and returns a job that derives the bits from its own
+    // copies of the key and parameters. Returns null, without touching `algorithm`, if
+    // deriveBits() should simply be called instead.
+    return nullptr;
+  }
 
   virtual kj::Array<kj::byte> wrapKey(SubtleCrypto::EncryptAlgorithm&& algorithm,
       kj::ArrayPtr<const kj::byte> unwrappedKey) const {
@@ -237,6 +260,10 @@ struct CryptoAlgorithm {
   //   template metaprogramming cannot recognize it as const). Maybe we can fix this in KJ, by
   //   making `RemoveConstOrDisable` recognize function references are inherenly const.
 
+  CryptoKey::Impl::PrepareGenerateFunc* prepareGenerateFunc = nullptr;
+  // If non-null, generateKey() uses this to generate keys on the crypto thread pool instead of
+  // calling `generateFunc`.
+
   inline bool operator==(const CryptoAlgorithm& other) const {
     return strcasecmp(name.cStr(), other.name.cStr()) == 0;
   }
@@ -307,6 +334,32 @@ struct ClearErrorOnReturn {
   KJ_DISALLOW_COPY_AND_MOVE(ClearErrorOnReturn);
 };
 
+ThreadPool& getCryptoThreadPool();
+// Process-wide pool for CPU-heavy crypto operations (key derivation, RSA key generation) that
+// would otherwise hold the isolate lock for a long time.
+
+template <typename T>
+jsg::Promise<T> runOffThread(jsg::Lock& js, kj::Function<T()> job) {
+  // Runs `job` on the crypto thread pool and resolves to its result back on the isolate's thread.
+  // The job's CPU time is charged to the current request. Outside of a request (e.g. at startup)
+  // there is nothing to charge and nowhere to await, so the job simply runs inline.
+  //
+  // `job` must own everything it uses, since it outlives neither the isolate lock nor, possibly,
+  // the request that started it.
+  if (!IoContext::hasCurrent()) {
+    return js.resolvedPromise(job());
+  }
+  auto& context = IoContext::current();
+  return context.awaitIo(js, getCryptoThreadPool().run([job = kj::mv(job)]() mutable {
+    // The OpenSSL error queue is per-thread; don't leave anything behind for the next job.
+    KJ_DEFER(ERR_clear_error());
+    return job();
+  }), [](jsg::Lock&, ThreadPool::Result<T> result) {
+    IoContext::current().getLimitEnforcer().chargeOffThreadCpu(result.cpuTime);
+    return kj::mv(result.value);
+  });
+}
+
 template <typename T>
 static inline T integerCeilDivision(T a, T b) {
   // Returns ceil(a / b) for integers (std::ceil always returns a floating point result).
@@ -5,6 +5,7 @@
 #include "crypto.h"
 #include "crypto-impl.h"
 #include <array>
+#include <thread>
 #include <openssl/crypto.h>
 #include <openssl/err.h>
 #include <workerd/jsg/jsg.h>
@@ -60,6 +61,14 @@ CryptoKeyUsageSet CryptoKeyUsageSet::validate(kj::StringPtr normalizedName, Cont
   return usages;
 }
 
+ThreadPool& getCryptoThreadPool() {
+  // Few threads: the pool only exists to get slow operations out from under the isolate lock, and
+  // each job's CPU time is charged to its request anyway. Once 64 jobs are waiting, further ones
+  // run inline under the isolate lock, which throttles whoever is submitting them.
+  static ThreadPool pool(kj::max(1u, kj::min(4u, std::thread::hardware_concurrency())), 64);
+  return pool;
+}
+
 namespace {
 
 // IMPLEMENTATION STRATEGY
@@ -81,16 +90,17 @@ namespace {
 // Note that SubtleCrypto.digest() is special. It is not a key-based operation and we only support
 // one hash family, SHA, so its implementation is non-virtual.
 //
-// NOTE(perf): The SubtleCrypto interface is asynchronous, but all of our implementations perform
-//   the crypto synchronously before returning. In theory, we could be performing bulk crypto in a
-//   separate thread, maybe improving performance. However, it's unclear what real use case would
-//   benefit from this. It's also unclear that we would want a single request to be able to use
-//   multiple cores -- certainly it would greatly complicate our implementation of request CPU
-//   limits. So, we probably shouldn't implement true asynchronous crypto.
-//
-//   Additionally, performing the crypto synchronously actually has a performance benefit: we can
-//   safely avoid copying input BufferSources -- most of our functions can take
+// NOTE(perf): The SubtleCrypto interface is asynchronous, but most of our implementations perform
+//   the crypto synchronously before returning. Bulk crypto is fast enough that moving it to
+//   another thread wouldn't pay for itself, and performing it synchronously has a performance
+//   benefit: we can safely avoid copying input BufferSources -- most of our functions can take
 //   kj::ArrayPtr<const kj::byte>s, rather than kj::Array<kj::byte>s.
+//
+//   The exceptions are operations that can take tens or hundreds of milliseconds no matter how
+//   little input they get -- PBKDF2 derivation (deriveBitsOffThread()) and RSA key generation
+//   (CryptoAlgorithm::prepareGenerateFunc). Those copy their inputs and run on a small shared
+//   thread pool (see runOffThread()), so they don't stall every other request on the isolate.
+//   Their CPU time is still charged to the request that started them.
 
 // =======================================================================================
 // OpenSSL shims
@@ -111,9 +121,12 @@ static kj::Maybe<const CryptoAlgorithm&> lookupAlgorithm(kj::StringPtr name) {
     {"HMAC"_kj,              &CryptoKey::Impl::importHmac, &CryptoKey::Impl::generateHmac},
     {"PBKDF2"_kj,            &CryptoKey::Impl::importPbkdf2},
     {"HKDF"_kj,              &CryptoKey::Impl::importHkdf},
-    {"RSASSA-PKCS1-v1_5"_kj, &CryptoKey::Impl::importRsa, &CryptoKey::Impl::generateRsa},
-    {"RSA-PSS"_kj,           &CryptoKey::Impl::importRsa, &CryptoKey::Impl::generateRsa},
-    {"RSA-OAEP"_kj,          &CryptoKey::Impl::importRsa, &CryptoKey::Impl::generateRsa},
+    {"RSASSA-PKCS1-v1_5"_kj, &CryptoKey::Impl::importRsa, &CryptoKey::Impl::generateRsa,
+                             &CryptoKey::Impl::prepareGenerateRsa},
+    {"RSA-PSS"_kj,           &CryptoKey::Impl::importRsa, &CryptoKey::Impl::generateRsa,
+                             &CryptoKey::Impl::prepareGenerateRsa},
+    {"RSA-OAEP"_kj,          &CryptoKey::Impl::importRsa, &CryptoKey::Impl::generateRsa,
+                             &CryptoKey::Impl::prepareGenerateRsa},
     {"ECDSA"_kj,             &CryptoKey::Impl::importEcdsa, &CryptoKey::Impl::generateEcdsa},
     {"ECDH"_kj,              &CryptoKey::Impl::importEcdh, &CryptoKey::Impl::generateEcdh},
     {"NODE-ED25519"_kj,      &CryptoKey::Impl::importEddsa, &CryptoKey::Impl::generateEddsa},
@@ -211,6 +224,24 @@ kj::Maybe<uint32_t> getKeyLength(const SubtleCrypto::ImportKeyAlgorithm& derived
   }
 }
 
+void checkGeneratedKeyUsages(const kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>& cryptoKeyOrPair,
+                             kj::ArrayPtr<const kj::String> keyUsages) {
+  // Helper for `generateKey()`, applying the usage checks the spec performs after generation.
+  KJ_SWITCH_ONEOF(cryptoKeyOrPair) {
+    KJ_CASE_ONEOF(cryptoKey, jsg::Ref<CryptoKey>) {
+      if (keyUsages.size() == 0) {
+        auto type = cryptoKey->getType();
+        JSG_REQUIRE(type != "secret" && type != "private", DOMSyntaxError,
+            "Secret/private CryptoKeys must have at least one usage.");
+      }
+    }
+    KJ_CASE_ONEOF(keyPair, CryptoKeyPair) {
+      JSG_REQUIRE(keyPair.privateKey->getUsageSet().size() != 0, DOMSyntaxError,
+        "Attempt to generate asymmetric keys with no valid private key usages.");
+    }
+  }
+}
+
 auto webCryptoOperationBegin(
     const char *operation, kj::StringPtr algorithm, kj::Maybe<kj::StringPtr> context = nullptr) {
   // This clears all OpenSSL errors & errno at the start & returns a deferred evaluation to make
@@ -394,22 +425,22 @@ jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>> SubtleCrypto::genera
     JSG_REQUIRE(algoImpl.generateFunc != nullptr, DOMNotSupportedError,
         "Unrecognized key generation algorithm \"", algorithm.name, "\" requested.");
 
+    if (algoImpl.prepareGenerateFunc != nullptr) {
+      auto job = algoImpl.prepareGenerateFunc(js, algoImpl.name, kj::mv(algorithm), extractable,
+                                              keyUsages);
+      return runOffThread(js, kj::mv(job))
+          .then(js, [keyUsages = kj::mv(keyUsages)]
+                    (jsg::Lock& js, CryptoKey::Impl::FinishGenerateFunc finish) {
+        auto cryptoKeyOrPair = finish();
+        checkGeneratedKeyUsages(cryptoKeyOrPair, keyUsages);
+        return cryptoKeyOrPair;
+      });
+    }
+
     auto cryptoKeyOrPair = algoImpl.generateFunc(js, algoImpl.name, kj::mv(algorithm), extractable,
                                                  keyUsages);
-    KJ_SWITCH_ONEOF(cryptoKeyOrPair) {
-      KJ_CASE_ONEOF(cryptoKey, jsg::Ref<CryptoKey>) {
-        if (keyUsages.size() == 0) {
-          auto type = cryptoKey->getType();
-          JSG_REQUIRE(type != "secret" && type != "private", DOMSyntaxError,
-              "Secret/private CryptoKeys must have at least one usage.");
-        }
-      }
-      KJ_CASE_ONEOF(keyPair, CryptoKeyPair) {
-        JSG_REQUIRE(keyPair.privateKey->getUsageSet().size() != 0, DOMSyntaxError,
-          "Attempt to generate asymmetric keys with no valid private key usages.");
-      }
-    }
-    return cryptoKeyOrPair;
+    checkGeneratedKeyUsages(cryptoKeyOrPair, keyUsages);
+    return js.resolvedPromise(kj::mv(cryptoKeyOrPair));
   });
 }
 
@@ -430,13 +461,22 @@ jsg::Promise<jsg::Ref<CryptoKey>> SubtleCrypto::deriveKey(
 
     auto length = getKeyLength(derivedKeyAlgorithm);
 
+    KJ_IF_MAYBE(job, baseKey.impl->deriveBitsOffThread(algorithm, length)) {
+      return runOffThread(js, kj::mv(*job))
+          .then(js, [self = JSG_THIS, derivedKeyAlgorithm = kj::mv(derivedKeyAlgorithm),
+                     extractable, keyUsages = kj::mv(keyUsages)]
+                    (jsg::Lock& js, kj::Array<kj::byte> secret) mutable {
+        auto checkErrorsOnFinish = webCryptoOperationBegin("deriveKey", derivedKeyAlgorithm.name);
+        return self->importKeySync(
+            js, "raw", kj::mv(secret), kj::mv(derivedKeyAlgorithm), extractable, keyUsages);
+      });
+    }
+
     auto secret = baseKey.impl->deriveBits(kj::mv(algorithm), length);
 
-    // TODO(perf): For conformance, importKey() makes a copy of `secret`. In this case we really
-    //   don't need to, but rather we ought to call the appropriate CryptoKey::Impl::import*()
-    //   function directly.
-    return importKeySync(
-        js, "raw", kj::mv(secret), kj::mv(derivedKeyAlgorithm), extractable, kj::mv(keyUsages));
+    // `secret` was just derived and nothing else refers to it, so the key can take it over as-is.
+    return js.resolvedPromise(importKeySync(
+        js, "raw", kj::mv(secret), kj::mv(derivedKeyAlgorithm), extractable, kj::mv(keyUsages)));
   });
 }
 
@@ -457,7 +497,10 @@ jsg::Promise<kj::Array<kj::byte>> SubtleCrypto::deriveBits(
 
   return js.evalNow([&] {
     validateOperation(baseKey, algorithm.name, CryptoKeyUsageSet::deriveBits());
-    return baseKey.impl->deriveBits(kj::mv(algorithm), length);
+    KJ_IF_MAYBE(job, baseKey.impl->deriveBitsOffThread(algorithm, length)) {
+      return runOffThread(js, kj::mv(*job));
+    }
+    return js.resolvedPromise(baseKey.impl->deriveBits(kj::mv(algorithm), length));
   });
 }
 
@@ -574,6 +617,11 @@ jsg::Promise<jsg::Ref<CryptoKey>> SubtleCrypto::importKey(
   auto checkErrorsOnFinish = webCryptoOperationBegin(__func__, algorithm, format.asPtr());
 
   return js.evalNow([&] {
+    KJ_IF_MAYBE(key, keyData.tryGet<kj::Array<kj::byte>>()) {
+      // The key data is a view onto a buffer that script can keep writing to, and some import
+      // functions adjust the key in place, so the key gets its own copy.
+      keyData = kj::heapArray(key->asPtr());
+    }
     return importKeySync(js, format, kj::mv(keyData), kj::mv(algorithm), extractable,
                          keyUsages);
   });
@@ -587,12 +635,9 @@ jsg::Ref<CryptoKey> SubtleCrypto::importKeySync(
     bool extractable,
     kj::ArrayPtr<const kj::String> keyUsages) {
   if (format == "raw" || format == "pkcs8" || format == "spki") {
-    auto& key = JSG_REQUIRE_NONNULL(keyData.tryGet<kj::Array<kj::byte>>(), TypeError,
+    JSG_REQUIRE(keyData.is<kj::Array<kj::byte>>(), TypeError,
         "Import data provided for \"raw\", \"pkcs8\", or \"spki\" import formats must be a buffer "
         "source.");
-
-    // Make a copy of the key import data.
-    keyData = kj::heapArray(key.asPtr());
   } else if (format == "jwk") {
     JSG_REQUIRE(keyData.is<JsonWebKey>(), TypeError,
         "Import data provided for \"jwk\" import format must be a JsonWebKey.");
@@ -726,10 +771,42 @@ kj::Promise<void> DigestStreamSink::write(const void* buffer, size_t size) {
 }
 
 kj::Promise<void> DigestStreamSink::write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) {
-  for (auto& piece : pieces) {
-    write(piece.begin(), piece.size());
+  KJ_SWITCH_ONEOF(state) {
+    KJ_CASE_ONEOF(closed, Closed) {
+      return kj::READY_NOW;
+    }
+    KJ_CASE_ONEOF(errored, Errored) {
+      return kj::cp(errored);
+    }
+    KJ_CASE_ONEOF(context, DigestContextPtr) {
+      auto checkErrorsOnFinish = webCryptoOperationBegin(__func__, algorithm.name);
+      for (auto& piece : pieces) {
+        OSSLCALL(EVP_DigestUpdate(context.get(), piece.begin(), piece.size()));
+      }
+      return kj::READY_NOW;
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
+kj::Maybe<kj::Promise<DeferredProxy<void>>> DigestStreamSink::tryPumpFrom(
+    ReadableStreamSource& input, bool end) {
+  // The generic pump would feed us through write() in 4k chunks; hash from a larger buffer
+  // instead. Hashing never needs the IoContext, but the caller still awaits `digest` through it,
+  // so there's nothing to gain from deferred proxying.
+  return addNoopDeferredProxy(pumpFrom(input, end));
+}
+
+kj::Promise<void> DigestStreamSink::pumpFrom(ReadableStreamSource& input, bool end) {
+  auto buffer = kj::heapArray<kj::byte>(PUMP_BUFFER_SIZE);
+  for (;;) {
+    size_t amount = co_await input.tryRead(buffer.begin(), 1, buffer.size());
+    if (amount == 0) break;
+    co_await write(buffer.begin(), amount);
+  }
+  if (end) {
+    co_await this->end();
   }
-  return kj::READY_NOW;
 }
 
 kj::Promise<void> DigestStreamSink::end() {
@@ -527,7 +527,8 @@ public:
       ImportKeyAlgorithm algorithm,
       bool extractable,
       kj::ArrayPtr<const kj::String> keyUsages);
-  // NOT VISIBLE TO JS: like importKey() but return the key, not a promise.
+  // NOT VISIBLE TO JS: like importKey() but return the key, not a promise. Buffer key data is
+  // taken over by the key rather than copied, so it must not be shared with script.
 
   jsg::Promise<ExportKeyData> exportKey(
       jsg::Lock& js,
@@ -590,12 +591,21 @@ public:
 
   kj::Promise<void> end() override;
 
+  kj::Maybe<kj::Promise<DeferredProxy<void>>> tryPumpFrom(
+      ReadableStreamSource& input, bool end) override;
+  // Piping a native stream (e.g. a request body) into a DigestStream hashes it without ever
+  // surfacing the chunks to JavaScript.
+
   void abort(kj::Exception reason) override;
 
 private:
   struct Closed {};
   using Errored = kj::Exception;
 
+  static constexpr size_t PUMP_BUFFER_SIZE = 64 * 1024;
+
+  kj::Promise<void> pumpFrom(ReadableStreamSource& input, bool end);
+
   SubtleCrypto::HashAlgorithm algorithm;
   kj::OneOf<DigestContextPtr, Closed, Errored> state;
   kj::Own<kj::PromiseFulfiller<kj::Array<kj::byte>>> fulfiller;
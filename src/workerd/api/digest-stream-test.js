@@ -0,0 +1,49 @@
+import {
+  deepStrictEqual,
+  rejects,
+} from 'node:assert';
+
+function makeData(size) {
+  const data = new Uint8Array(size);
+  for (let n = 0; n < size; n++) {
+    data[n] = (n * 31 + 7) & 0xff;
+  }
+  return data;
+}
+
+export const digestStreamWrites = {
+  async test() {
+    const data = makeData(1000);
+    const expected = await crypto.subtle.digest('SHA-256', data);
+
+    const stream = new crypto.DigestStream('SHA-256');
+    const writer = stream.getWriter();
+    for (let n = 0; n < data.length; n += 300) {
+      await writer.write(data.subarray(n, n + 300));
+    }
+    await writer.close();
+    deepStrictEqual(new Uint8Array(await stream.digest), new Uint8Array(expected));
+  }
+};
+
+export const digestStreamPipe = {
+  async test() {
+    // Large enough to take several reads of the native pump's buffer.
+    const data = makeData(5 * 65536 + 17);
+    const expected = await crypto.subtle.digest('SHA-1', data);
+
+    const stream = new crypto.DigestStream('SHA-1');
+    await new Blob([data]).stream().pipeTo(stream);
+    deepStrictEqual(new Uint8Array(await stream.digest), new Uint8Array(expected));
+  }
+};
+
+export const digestStreamAbort = {
+  async test() {
+    const stream = new crypto.DigestStream('SHA-256');
+    const writer = stream.getWriter();
+    await writer.write(new Uint8Array(10));
+    await writer.abort(new Error('boom'));
+    await rejects(stream.digest);
+  }
+};
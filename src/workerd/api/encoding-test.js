@@ -0,0 +1,89 @@
+function assertEqual(a, b) {
+  if (a !== b) {
+    throw new Error(JSON.stringify(a) + " !== " + JSON.stringify(b));
+  }
+}
+
+function assertThrows(fn) {
+  try {
+    fn();
+  } catch (e) {
+    return;
+  }
+  throw new Error("expected an exception");
+}
+
+function decode(bytes, options) {
+  return new TextDecoder("utf-8", options).decode(new Uint8Array(bytes));
+}
+
+export default {
+  async test(ctrl, env, ctx) {
+    const encoder = new TextEncoder();
+    for (const text of ["", "hello world", "{\"a\":1}", "café", "€100",
+                        "\u{1f600} emoji", "x".repeat(1000) + "ÿ" + "y".repeat(13)]) {
+      assertEqual(new TextDecoder().decode(encoder.encode(text)), text);
+    }
+
+    // Invalid sequences are replaced as the Encoding spec prescribes.
+    assertEqual(decode([0xe2, 0x41]), "\uFFFDA");
+    assertEqual(decode([0x80, 0xff, 0x41]), "\uFFFD\uFFFDA");
+    assertEqual(decode([0xed, 0xa0, 0x80]), "\uFFFD\uFFFD\uFFFD");
+    assertEqual(decode([0xf0, 0x9f, 0x98]), "\uFFFD");
+    assertEqual(decode([0xc0, 0xaf]), "\uFFFD\uFFFD");
+    assertThrows(() => decode([0xe2, 0x41], { fatal: true }));
+    assertThrows(() => decode([0xf0, 0x9f, 0x98], { fatal: true }));
+
+    // The BOM is stripped unless ignoreBOM is set.
+    assertEqual(decode([0xef, 0xbb, 0xbf, 0x41]), "A");
+    assertEqual(decode([0xef, 0xbb, 0xbf, 0x41], { ignoreBOM: true }), "\uFEFFA");
+
+    // Sequences split across streamed chunks are put back together.
+    const streaming = new TextDecoder();
+    const bytes = encoder.encode("a\u{1f600}bé");
+    let out = "";
+    for (const b of bytes) {
+      out += streaming.decode(new Uint8Array([b]), { stream: true });
+    }
+    out += streaming.decode();
+    assertEqual(out, "a\u{1f600}bé");
+
+    // A streamed BOM is only stripped at the start.
+    const bom = new TextDecoder();
+    assertEqual(bom.decode(new Uint8Array([0xef, 0xbb]), { stream: true }), "");
+    assertEqual(bom.decode(new Uint8Array([0xbf, 0x41]), { stream: true }), "A");
+    assertEqual(bom.decode(new Uint8Array([0xef, 0xbb, 0xbf])), "\uFEFF");
+
+    // An incomplete sequence is reported at the end of the stream.
+    const truncated = new TextDecoder();
+    assertEqual(truncated.decode(new Uint8Array([0x41, 0xe2, 0x82]), { stream: true }), "A");
+    assertEqual(truncated.decode(), "\uFFFD");
+    assertEqual(truncated.decode(new Uint8Array([0x41])), "A");
+
+    // TextEncoder copies ASCII straight out of one-byte strings, and transcodes the rest.
+    assertEqual(encoder.encode("abc").join(), "97,98,99");
+    assertEqual(encoder.encode("é").join(), "195,169");
+    assertEqual(encoder.encode("a\u20ac").join(), "97,226,130,172");
+    const into = new Uint8Array(4);
+    let r = encoder.encodeInto("abcdef", into);
+    assertEqual(r.read, 4);
+    assertEqual(r.written, 4);
+    r = encoder.encodeInto("abé", into);
+    assertEqual(r.read, 3);
+    assertEqual(r.written, 4);
+    assertEqual(into.join(), "97,98,195,169");
+    r = encoder.encodeInto("abcé", into);
+    assertEqual(r.read, 3);
+    assertEqual(r.written, 3);
+    // Bytes past `written` are left as they were.
+    assertEqual(into.join(), "97,98,99,169");
+
+    // btoa() and atob() round-trip Latin-1, and reject anything else.
+    assertEqual(btoa("hello"), "aGVsbG8=");
+    assertEqual(atob(btoa("caf\u00e9\u00ff")), "caf\u00e9\u00ff");
+    assertEqual(atob(" aGVs bG8= "), "hello");
+    assertThrows(() => btoa("\u20ac"));
+    assertThrows(() => atob("aGVsbG8\u20ac"));
+    assertThrows(() => atob("a"));
+  }
+};
@@ -6,6 +6,7 @@
 #include <unicode/ucnv.h>
 #include <unicode/utf8.h>
 #include <algorithm>
+#include <cstring>
 
 namespace workerd::api {
 
@@ -398,6 +399,150 @@ kj::Maybe<v8::Local<v8::String>> AsciiDecoder::decode(
   return jsg::v8StrFromLatin1(isolate, buffer);
 }
 
+namespace {
+size_t skipAscii(kj::ArrayPtr<const kj::byte> buffer, size_t pos) {
+  // Returns the position of the first non-ASCII byte at or after `pos`, or the end of the buffer.
+  // Checks eight bytes at a time.
+  constexpr uint64_t HIGH_BITS = 0x8080808080808080ull;
+  while (pos + sizeof(uint64_t) <= buffer.size()) {
+    uint64_t word;
+    memcpy(&word, buffer.begin() + pos, sizeof(word));
+    if (word & HIGH_BITS) break;
+    pos += sizeof(word);
+  }
+  while (pos < buffer.size() && buffer[pos] < 0x80) ++pos;
+  return pos;
+}
+}  // namespace
+
+kj::Maybe<v8::Local<v8::String>> Utf8Decoder::decode(
+    v8::Isolate* isolate,
+    kj::ArrayPtr<const kj::byte> buffer,
+    bool flush) {
+  KJ_DEFER({ if (flush) reset(); });
+
+  if (bytesNeeded == 0 && skipAscii(buffer, 0) == buffer.size()) {
+    // No partial sequence is pending and the input is entirely ASCII, which is also Latin-1, so
+    // the input is already the one-byte string we want. (It can't start with a BOM, whose bytes
+    // are > 0x7f.)
+    if (buffer.size() > 0) bomSeen = true;
+    return jsg::v8StrFromLatin1(isolate, buffer);
+  }
+
+  // Each input byte produces at most one UTF-16 code unit, except that the first byte can also
+  // complete or abort a sequence left over from the previous call, and flushing can report an
+  // incomplete sequence.
+  auto limit = buffer.size() + 2;
+  KJ_STACK_ARRAY(char16_t, result, limit, 512, 4096);
+  size_t length = 0;
+
+  char16_t nonAsciiUnits = 0;
+  // Bitwise OR of every non-ASCII code unit written, to tell whether the result is Latin-1.
+
+  const auto emit = [&](char16_t unit) {
+    result[length++] = unit;
+    nonAsciiUnits |= unit;
+  };
+
+  const auto fail = [&]() -> kj::Maybe<v8::Local<v8::String>> {
+    reset();
+    return nullptr;
+  };
+
+  // This follows https://encoding.spec.whatwg.org/#utf-8-decoder.
+  size_t pos = 0;
+  while (pos < buffer.size()) {
+    if (bytesNeeded == 0) {
+      auto asciiEnd = skipAscii(buffer, pos);
+      while (pos < asciiEnd) {
+        result[length++] = buffer[pos++];
+      }
+      if (pos == buffer.size()) break;
+
+      auto byte = buffer[pos++];
+      if (byte >= 0xc2 && byte <= 0xdf) {
+        bytesNeeded = 1;
+        codePoint = byte & 0x1f;
+      } else if (byte >= 0xe0 && byte <= 0xef) {
+        if (byte == 0xe0) lowerBoundary = 0xa0;
+        if (byte == 0xed) upperBoundary = 0x9f;
+        bytesNeeded = 2;
+        codePoint = byte & 0xf;
+      } else if (byte >= 0xf0 && byte <= 0xf4) {
+        if (byte == 0xf0) lowerBoundary = 0x90;
+        if (byte == 0xf4) upperBoundary = 0x8f;
+        bytesNeeded = 3;
+        codePoint = byte & 0x7;
+      } else {
+        if (fatal) return fail();
+        emit(0xfffd);
+      }
+      continue;
+    }
+
+    auto byte = buffer[pos];
+    if (byte < lowerBoundary || byte > upperBoundary) {
+      // The sequence is cut short. The byte is left to be processed again as the start of the
+      // next one.
+      if (fatal) return fail();
+      codePoint = 0;
+      bytesSeen = 0;
+      bytesNeeded = 0;
+      lowerBoundary = 0x80;
+      upperBoundary = 0xbf;
+      emit(0xfffd);
+      continue;
+    }
+    ++pos;
+
+    lowerBoundary = 0x80;
+    upperBoundary = 0xbf;
+    codePoint = (codePoint << 6) | (byte & 0x3f);
+    if (++bytesSeen < bytesNeeded) continue;
+
+    if (codePoint < 0x10000) {
+      emit(codePoint);
+    } else {
+      emit(0xd800 + ((codePoint - 0x10000) >> 10));
+      emit(0xdc00 + ((codePoint - 0x10000) & 0x3ff));
+    }
+    codePoint = 0;
+    bytesSeen = 0;
+    bytesNeeded = 0;
+  }
+
+  if (flush && bytesNeeded != 0) {
+    if (fatal) return fail();
+    emit(0xfffd);
+  }
+
+  auto output = result.slice(0, length);
+  if (output.size() > 0 && !bomSeen) {
+    bomSeen = true;
+    if (!ignoreBom && output[0] == 0xfeff) {
+      output = output.slice(1, output.size());
+    }
+  }
+
+  if (nonAsciiUnits <= 0xff) {
+    KJ_STACK_ARRAY(kj::byte, latin1, output.size(), 512, 4096);
+    for (auto i: kj::indices(output)) {
+      latin1[i] = output[i];
+    }
+    return jsg::v8StrFromLatin1(isolate, latin1);
+  }
+  return jsg::v8Str(isolate, output);
+}
+
+void Utf8Decoder::reset() {
+  bomSeen = false;
+  codePoint = 0;
+  bytesSeen = 0;
+  bytesNeeded = 0;
+  lowerBoundary = 0x80;
+  upperBoundary = 0xbf;
+}
+
 void IcuDecoder::reset() {
   bomSeen = false;
   return ucnv_reset(inner.get());
@@ -406,6 +551,7 @@ void IcuDecoder::reset() {
 Decoder& TextDecoder::getImpl() {
   KJ_SWITCH_ONEOF(decoder) {
     KJ_CASE_ONEOF(dec, AsciiDecoder) { return dec; }
+    KJ_CASE_ONEOF(dec, Utf8Decoder) { return dec; }
     KJ_CASE_ONEOF(dec, IcuDecoder) { return dec; }
   }
   KJ_UNREACHABLE;
@@ -435,6 +581,10 @@ TextDecoder::constructor(jsg::Optional<kj::String> maybeLabel,
     return jsg::alloc<TextDecoder>(AsciiDecoder(), options);
   }
 
+  if (encoding == Encoding::Utf8) {
+    return jsg::alloc<TextDecoder>(Utf8Decoder(options.fatal, options.ignoreBOM), options);
+  }
+
   return jsg::alloc<TextDecoder>(
       JSG_REQUIRE_NONNULL(IcuDecoder::create(encoding, options.fatal, options.ignoreBOM),
                            RangeError,
@@ -466,6 +616,9 @@ kj::Maybe<v8::Local<v8::String>> TextDecoder::decodePtr(
     KJ_CASE_ONEOF(dec, AsciiDecoder) {
       return dec.decode(isolate, buffer, flush);
     }
+    KJ_CASE_ONEOF(dec, Utf8Decoder) {
+      return dec.decode(isolate, buffer, flush);
+    }
     KJ_CASE_ONEOF(dec, IcuDecoder) {
       return dec.decode(isolate, buffer, flush);
     }
@@ -483,6 +636,23 @@ jsg::Ref<TextEncoder> TextEncoder::constructor() {
 v8::Local<v8::Uint8Array> TextEncoder::encode(jsg::Optional<v8::Local<v8::String>> input,
     v8::Isolate* isolate) {
   auto str = input.orDefault(v8::String::Empty(isolate));
+
+  if (str->IsOneByte()) {
+    // V8 stores the string as Latin-1, and it's very likely ASCII, in which case its UTF-8
+    // encoding is the same bytes. Copy those straight into the result and check, rather than
+    // measuring its UTF-8 length first and then transcoding it.
+    auto maybeBuffer = v8::ArrayBuffer::MaybeNew(isolate, str->Length());
+    JSG_ASSERT(!maybeBuffer.IsEmpty(), RangeError,
+        "Cannot allocate space for TextEncoder.encode");
+    auto buffer = maybeBuffer.ToLocalChecked();
+    auto view = v8::Uint8Array::New(buffer, 0, buffer->ByteLength());
+    auto bytes = jsg::asBytes(view.As<v8::ArrayBufferView>());
+    str->WriteOneByte(isolate, bytes.begin(), 0, bytes.size(), v8::String::NO_NULL_TERMINATION);
+    if (skipAscii(bytes, 0) == bytes.size()) {
+      return view;
+    }
+  }
+
   auto maybeBuffer = v8::ArrayBuffer::MaybeNew(isolate, str->Utf8Length(isolate));
   JSG_ASSERT(!maybeBuffer.IsEmpty(), RangeError, "Cannot allocate space for TextEncoder.encode");
   auto buffer = maybeBuffer.ToLocalChecked();
@@ -496,8 +666,33 @@ v8::Local<v8::Uint8Array> TextEncoder::encode(jsg::Optional<v8::Local<v8::String
 TextEncoder::EncodeIntoResult TextEncoder::encodeInto(
     v8::Local<v8::String> input, v8::Local<v8::Uint8Array> buffer, v8::Isolate* isolate) {
   EncodeIntoResult result{0,0};
-  auto bytes = jsg::asBytes(buffer.As<v8::ArrayBufferView>()).releaseAsChars();
-  result.written = input->WriteUtf8(isolate, bytes.begin(), bytes.size(), &result.read,
+  auto bytes = jsg::asBytes(buffer.As<v8::ArrayBufferView>());
+
+  if (input->IsOneByte()) {
+    // As in encode(), ASCII can be copied as-is. Only the prefix that fits is needed. The caller's
+    // buffer must be left untouched past the bytes we report as written, so the characters are
+    // checked in a scratch chunk and only their ASCII prefix is copied out.
+    auto length = kj::min(static_cast<size_t>(input->Length()), bytes.size());
+    kj::byte chunk[256];
+    size_t pos = 0;
+    while (pos < length) {
+      auto n = kj::min(length - pos, sizeof(chunk));
+      input->WriteOneByte(isolate, chunk, pos, n, v8::String::NO_NULL_TERMINATION);
+      auto ascii = skipAscii(kj::arrayPtr(chunk, n), 0);
+      memcpy(bytes.begin() + pos, chunk, ascii);
+      pos += ascii;
+      if (ascii < n) break;
+    }
+    if (pos == length) {
+      result.read = length;
+      result.written = length;
+      return result;
+    }
+    // Otherwise WriteUtf8() below rewrites the ASCII prefix we copied with the same bytes.
+  }
+
+  auto chars = bytes.releaseAsChars();
+  result.written = input->WriteUtf8(isolate, chars.begin(), chars.size(), &result.read,
       v8::String::NO_NULL_TERMINATION | v8::String::REPLACE_INVALID_UTF8);
   return result;
 }
@@ -91,6 +91,39 @@ public:
       bool flush = false) override;
 };
 
+class Utf8Decoder final: public Decoder {
+  // Decoder implementation for UTF-8, which is by far the most commonly decoded encoding.
+  // Implements the Encoding spec's UTF-8 decoder directly, carrying the state of a partially read
+  // sequence across streamed chunks, and skips over runs of ASCII a word at a time. Content
+  // containing only Latin-1 code points is returned as a one-byte V8 string.
+
+public:
+  Utf8Decoder(bool fatal, bool ignoreBom): fatal(fatal), ignoreBom(ignoreBom) {}
+  Utf8Decoder(Utf8Decoder&&) = default;
+  Utf8Decoder& operator=(Utf8Decoder&&) = default;
+  KJ_DISALLOW_COPY(Utf8Decoder);
+
+  Encoding getEncoding() override { return Encoding::Utf8; }
+  kj::Maybe<v8::Local<v8::String>> decode(
+      v8::Isolate* isolate,
+      kj::ArrayPtr<const kj::byte> buffer,
+      bool flush = false) override;
+
+  void reset() override;
+
+private:
+  bool fatal;
+  bool ignoreBom;
+  bool bomSeen = false;
+
+  // State of the Encoding spec's UTF-8 decoder.
+  uint32_t codePoint = 0;
+  uint bytesSeen = 0;
+  uint bytesNeeded = 0;
+  kj::byte lowerBoundary = 0x80;
+  kj::byte upperBoundary = 0xbf;
+};
+
 class IcuDecoder: public Decoder {
   // Decoder implementation that uses ICU's built-in conversion APIs.
   // ICU's decoder is fairly comprehensive, covering the full range
@@ -128,7 +161,7 @@ class TextDecoder: public jsg::Object {
   // Implements the TextDecoder interface as prescribed by:
   // https://encoding.spec.whatwg.org/#interface-textdecoder
 public:
-  using DecoderImpl = kj::OneOf<AsciiDecoder, IcuDecoder>;
+  using DecoderImpl = kj::OneOf<AsciiDecoder, Utf8Decoder, IcuDecoder>;
 
   struct ConstructorOptions {
     bool fatal = false;
@@ -0,0 +1,74 @@
+function assertEqual(a, b) {
+  if (a !== b) {
+    throw new Error(a + " !== " + b);
+  }
+}
+
+export default {
+  async test(ctrl, env, ctx) {
+    const form = new FormData();
+    form.append("text", "hello");
+    form.append("file", new Blob(["file contents"], {type: "text/plain"}), "a.txt");
+    form.append("empty", new Blob([]), "empty.bin");
+    form.append("quoted\"name", "value");
+
+    const response = new Response(form);
+    const contentType = response.headers.get("Content-Type");
+    const boundary = contentType.match(/boundary=(.*)$/)[1];
+
+    const expected =
+        `--${boundary}\r\n` +
+        `Content-Disposition: form-data; name="text"\r\n\r\n` +
+        `hello\r\n` +
+        `--${boundary}\r\n` +
+        `Content-Disposition: form-data; name="file"; filename="a.txt"\r\n` +
+        `Content-Type: text/plain\r\n\r\n` +
+        `file contents\r\n` +
+        `--${boundary}\r\n` +
+        `Content-Disposition: form-data; name="empty"; filename="empty.bin"\r\n` +
+        `Content-Type: application/octet-stream\r\n\r\n` +
+        `\r\n` +
+        `--${boundary}\r\n` +
+        `Content-Disposition: form-data; name="quoted%22name"\r\n\r\n` +
+        `value\r\n` +
+        `--${boundary}--`;
+
+    // Reading the body in small chunks crosses the boundaries between text and file pieces.
+    const clone = response.clone();
+    const reader = clone.body.getReader();
+    const chunks = [];
+    for (;;) {
+      const { done, value } = await reader.read();
+      if (done) break;
+      chunks.push(new TextDecoder().decode(value));
+    }
+    assertEqual(chunks.join(""), expected);
+
+    assertEqual(await response.text(), expected);
+
+    // The body round-trips through the parser.
+    const parsed = await new Response(form).formData();
+    assertEqual(parsed.get("text"), "hello");
+    assertEqual(await parsed.get("file").text(), "file contents");
+    assertEqual(parsed.get("file").name, "a.txt");
+    assertEqual(parsed.get("empty").size, 0);
+
+    // Parse a body with a long boundary (so the search switches to Boyer-Moore-Horspool), bare LF
+    // line endings, and near-miss boundaries inside the content.
+    const longBoundary = "----------------------------" + "x".repeat(40);
+    const filler = "-".repeat(1000) + "\n--" + longBoundary.slice(0, -1) + "y";
+    let raw = "";
+    for (let i = 0; i < 50; i++) {
+      raw += `--${longBoundary}\n` +
+             `Content-Disposition: form-data; name="part${i}"\n\n` +
+             `${filler}${i}\n`;
+    }
+    raw += `--${longBoundary}--`;
+    const many = await new Response(raw, {
+      headers: { "Content-Type": `multipart/form-data; boundary=${longBoundary}` }
+    }).formData();
+    for (let i = 0; i < 50; i++) {
+      assertEqual(many.get(`part${i}`), `${filler}${i}`);
+    }
+  }
+}
@@ -4,11 +4,11 @@
 
 #include "form-data.h"
 #include "util.h"
+#include "node/buffer-string-search.h"
 #include <kj/vector.h>
 #include <kj/encoding.h>
 #include <algorithm>
 #include <functional>
-#include <regex>
 #include <kj/parse/char.h>
 #include <kj/compat/http.h>
 
@@ -20,16 +20,56 @@ namespace workerd::api {
 
 namespace {
 
-kj::ArrayPtr<const char> splitAtSubString(
-    kj::ArrayPtr<const char>& text, kj::StringPtr subString) {
-  // Like split() in kj/compat/url.c++, but splits at a substring rather than a character.
+class DelimiterSearch {
+  // Splits text at each occurrence of a fixed delimiter, like split() in kj/compat/url.c++ but at a
+  // substring rather than a character. Uses the same string search as Node's Buffer.indexOf(),
+  // which scans for the delimiter's first byte with memchr() and switches to Boyer-Moore-Horspool
+  // once that proves unproductive. The search adapts as it goes, so reuse one DelimiterSearch for
+  // every split of the same body.
+
+public:
+  explicit DelimiterSearch(kj::ArrayPtr<const char> delimiter)
+      : delimiter(delimiter),
+        search(Vector(reinterpret_cast<const uint8_t*>(delimiter.begin()), delimiter.size(),
+                      true)) {}
+  KJ_DISALLOW_COPY_AND_MOVE(DelimiterSearch);
+  // The search object points at `delimiter`, so pin it.
+
+  kj::ArrayPtr<const char> split(kj::ArrayPtr<const char>& text) {
+    // Returns the text before the next delimiter, and advances `text` past the delimiter. If the
+    // delimiter is absent, returns all of `text` and leaves `text` empty.
+
+    size_t pos = text.size();
+    if (text.size() >= delimiter.size()) {
+      // (The search must not be given a subject shorter than the pattern.)
+      pos = search.Search(Vector(reinterpret_cast<const uint8_t*>(text.begin()), text.size(),
+                                 true), 0);
+    }
+    auto result = text.slice(0, pos);
+    text = text.slice(kj::min(text.size(), pos + delimiter.size()), text.size());
+    return result;
+  }
 
-  // TODO(perf): Use a Boyer-Moore search?
-  auto iter = std::search(text.begin(), text.end(), subString.begin(), subString.end());
-  auto result = kj::arrayPtr(text.begin(), iter - text.begin());
-  text = text.slice(kj::min(text.size(), result.end() - text.begin() + subString.size()),
-                    text.size());
-  return result;
+private:
+  using Vector = node::stringsearch::Vector<const uint8_t>;
+
+  kj::ArrayPtr<const char> delimiter;
+  node::stringsearch::StringSearch<uint8_t> search;
+};
+
+kj::Maybe<size_t> findHeaderTermination(kj::ArrayPtr<const char> text) {
+  // Returns the offset just past the blank line ending a part's headers, i.e. the end of the first
+  // match of /\r?\n\r?\n/.
+
+  const char* pos = text.begin();
+  const char* end = text.end();
+  for (;;) {
+    auto newline = reinterpret_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (newline == nullptr) return nullptr;
+    pos = newline + 1;
+    if (pos < end && *pos == '\r') ++pos;
+    if (pos < end && *pos == '\n') return pos + 1 - text.begin();
+  }
 }
 
 bool startsWith(kj::ArrayPtr<const char> bytes, kj::StringPtr prefix) {
@@ -69,15 +109,18 @@ constexpr auto contentDisposition =
                 p::discardWhitespace, p::many(contentDispositionParam));
 
 void parseFormData(kj::Vector<FormData::Entry>& data, kj::ArrayPtr<const char> boundary,
-                   kj::ArrayPtr<const char> body, bool convertFilesToStrings) {
+                   Blob::Buffer& bodyBuffer, bool convertFilesToStrings) {
+  kj::ArrayPtr<const char> body = bodyBuffer.bytes.asChars();
+
   // multipart/form-data messages are delimited by <CRLF>--<boundary>. We want to be able to handle
   // omitted carriage returns, though, so our delimiter only matches against a preceding line feed.
   const auto delimiter = kj::str("\n--", boundary);
+  DelimiterSearch delimiterSearch(delimiter);
 
   // We want to slice off the delimiter's preceding newline for the initial search, because the very
   // first instance does not require one. In every subsequent multipart message, the preceding
-  // newline is required.
-  auto message = splitAtSubString(body, delimiter.slice(1));
+  // newline is required. This only happens once, so a fresh search is fine.
+  auto message = DelimiterSearch(delimiter.slice(1, delimiter.size())).split(body);
 
   JSG_REQUIRE(body.size() > 0, TypeError,
       "No initial boundary string (or you have a truncated message).");
@@ -98,18 +141,11 @@ void parseFormData(kj::Vector<FormData::Entry>& data, kj::ArrayPtr<const char> b
     return false;
   };
 
-  constexpr auto staticRegexFlags = std::regex_constants::ECMAScript
-                                  | std::regex_constants::optimize;
-
-  static const auto headerTerminationRegex = std::regex("\r?\n\r?\n", staticRegexFlags);
-
-  std::cmatch match;
-
   auto& formDataHeaderTable = getFormDataHeaderTable();
 
   while (!done(body)) {
-    JSG_REQUIRE(std::regex_search(body.begin(), body.end(), match, headerTerminationRegex),
-                 TypeError, "No multipart message header termination found.");
+    size_t headersEnd = JSG_REQUIRE_NONNULL(findHeaderTermination(body),
+        TypeError, "No multipart message header termination found.");
 
     // TODO(cleanup): Use kj-http to parse multipart headers. Right now that API isn't public, so
     //   I'm just using a regex. For reference, multipart/form-data supports the following three
@@ -121,8 +157,8 @@ void parseFormData(kj::Vector<FormData::Entry>& data, kj::ArrayPtr<const char> b
     //
     // TODO(soon): Read the Content-Type to support files.
 
-    auto headersText = kj::str(body.slice(0, match[0].second - body.begin()));
-    body = body.slice(match[0].second - body.begin(), body.size());
+    auto headersText = kj::str(body.slice(0, headersEnd));
+    body = body.slice(headersEnd, body.size());
 
     kj::HttpHeaders headers(*formDataHeaderTable.table);
     JSG_REQUIRE(headers.tryParse(headersText), TypeError, "FormData part had invalid headers.");
@@ -155,7 +191,7 @@ void parseFormData(kj::Vector<FormData::Entry>& data, kj::ArrayPtr<const char> b
 
     kj::Maybe<kj::StringPtr> type = headers.get(kj::HttpHeaderId::CONTENT_TYPE);
 
-    message = splitAtSubString(body, delimiter);
+    message = delimiterSearch.split(body);
     JSG_REQUIRE(body.size() > 0, TypeError,
         "No subsequent boundary string after multipart message.");
 
@@ -167,9 +203,13 @@ void parseFormData(kj::Vector<FormData::Entry>& data, kj::ArrayPtr<const char> b
     if (filename == nullptr || convertFilesToStrings) {
       data.add(FormData::Entry { kj::mv(name), kj::str(message) });
     } else {
+      kj::Array<Blob::Segment> content;
+      if (message.size() > 0) {
+        content = kj::arr(Blob::Segment { kj::addRef(bodyBuffer), message.asBytes() });
+      }
       data.add(FormData::Entry {
         kj::mv(name),
-        jsg::alloc<File>(kj::heapArray(message.asBytes()), KJ_ASSERT_NONNULL(kj::mv(filename)),
+        jsg::alloc<File>(kj::mv(content), KJ_ASSERT_NONNULL(kj::mv(filename)),
                           kj::str(type.orDefault(nullptr)), dateNow())
       });
     }
@@ -186,7 +226,7 @@ blobToFile(kj::StringPtr name, kj::OneOf<jsg::Ref<File>, jsg::Ref<Blob>, kj::Str
     } else {
       fn = kj::str(name);
     }
-    return jsg::alloc<File>(kj::heapArray(blob->getData()), kj::mv(fn),
+    return jsg::alloc<File>(blob->getSegments(), kj::mv(fn),
                              kj::str(blob->getType()), dateNow());
   };
 
@@ -209,7 +249,8 @@ blobToFile(kj::StringPtr name, kj::OneOf<jsg::Ref<File>, jsg::Ref<Blob>, kj::Str
   KJ_UNREACHABLE;
 }
 
-void addEscapingQuotes(kj::Vector<char>& builder, kj::StringPtr value) {
+template <typename Builder>
+void addEscapingQuotes(Builder& builder, kj::StringPtr value) {
   // Add the chars from `value` into `builder` escaping the characters '"' and '\n' using %
   // encoding, exactly as Chrome does for Content-Disposition values.
 
@@ -240,19 +281,26 @@ void addEscapingQuotes(kj::Vector<char>& builder, kj::StringPtr value) {
   }
 }
 
-}  // namespace
+class CountingBuilder {
+  // Stands in for a kj::ArrayBuilder<char> to compute how big the builder needs to be.
 
-// =======================================================================================
-// FormData implementation
+public:
+  void add(char c) { ++count; }
+  void addAll(kj::ArrayPtr<const char> chars) { count += chars.size(); }
 
-kj::Array<kj::byte> FormData::serialize(kj::ArrayPtr<const char> boundary) {
-  // Boundary string requirement per RFC7578
-  JSG_REQUIRE(boundary.size() > 0 && boundary.size() <= 70, TypeError,
-      "Length of multipart/form-data boundary string must be in the range [1, 70].");
+  size_t size() const { return count; }
+
+private:
+  size_t count = 0;
+};
 
-  // TODO(perf): We should be able to trivially calculate the length of the serialized form data
-  //   beforehand. I tried, but apparently my math REALLY sucks and I hate memory overruns, so ...
-  auto builder = kj::Vector<char>{};
+template <typename Builder, typename Func>
+void serializeFormData(kj::ArrayPtr<FormData::Entry> data,
+                       kj::ArrayPtr<const char> boundary, Builder& builder, Func&& onFile) {
+  // Writes all the framing and text values of a multipart/form-data body into `builder`, calling
+  // `onFile(fileRef)` at each point where a file's contents belong -- the contents themselves are
+  // not written to `builder`. Run once with a CountingBuilder and once with a real builder, this
+  // lets us size the buffer exactly without keeping two copies of the arithmetic.
 
   for (auto& kv: data) {
     builder.addAll("--"_kj);
@@ -275,7 +323,7 @@ kj::Array<kj::byte> FormData::serialize(kj::ArrayPtr<const char> boundary) {
         }
         builder.addAll(type);
         builder.addAll("\r\n\r\n"_kj);
-        builder.addAll(file->getData().asChars());
+        onFile(file);
       }
     }
     builder.addAll("\r\n"_kj);
@@ -283,8 +331,54 @@ kj::Array<kj::byte> FormData::serialize(kj::ArrayPtr<const char> boundary) {
   builder.addAll("--"_kj);
   builder.addAll(boundary);
   builder.addAll("--"_kj);
+}
+
+}  // namespace
+
+// =======================================================================================
+// FormData implementation
+
+kj::Own<FormData::Serialized> FormData::serialize(kj::ArrayPtr<const char> boundary) {
+  // Boundary string requirement per RFC7578
+  JSG_REQUIRE(boundary.size() > 0 && boundary.size() <= 70, TypeError,
+      "Length of multipart/form-data boundary string must be in the range [1, 70].");
+
+  size_t fileCount = 0;
+  uint64_t fileBytes = 0;
+  CountingBuilder counter;
+  serializeFormData(data, boundary, counter, [&](jsg::Ref<File>& file) {
+    ++fileCount;
+    fileBytes += file->getData().size();
+  });
+
+  auto result = kj::refcounted<Serialized>();
+  result->size = counter.size() + fileBytes;
+
+  // Record where each file lands in the text, so we can interleave the pieces afterwards. (The
+  // text array's final address isn't known until it's finished.)
+  auto splits = kj::heapArrayBuilder<size_t>(fileCount);
+  auto files = kj::heapArrayBuilder<jsg::Ref<File>>(fileCount);
+  auto text = kj::heapArrayBuilder<char>(counter.size());
+  serializeFormData(data, boundary, text, [&](jsg::Ref<File>& file) {
+    splits.add(text.size());
+    files.add(file.addRef());
+  });
+  KJ_ASSERT(text.isFull());
+  result->text = text.finish();
+  result->files = files.finish();
+
+  auto pieces = kj::heapArrayBuilder<kj::ArrayPtr<const kj::byte>>(fileCount * 2 + 1);
+  size_t pos = 0;
+  auto textBytes = result->text.asBytes();
+  for (auto i: kj::indices(result->files)) {
+    pieces.add(textBytes.slice(pos, splits[i]));
+    pieces.add(result->files[i]->getData());
+    pos = splits[i];
+  }
+  pieces.add(textBytes.slice(pos, textBytes.size()));
+  result->pieces = pieces.finish();
 
-  return builder.releaseAsArray().releaseAsBytes();
+  return result;
 }
 
 FormData::EntryType FormData::clone(v8::Isolate* isolate, FormData::EntryType& value) {
@@ -299,14 +393,14 @@ FormData::EntryType FormData::clone(v8::Isolate* isolate, FormData::EntryType& v
   KJ_UNREACHABLE;
 }
 
-void FormData::parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType,
+void FormData::parse(kj::Own<Blob::Buffer> rawText, kj::StringPtr contentType,
                      bool convertFilesToStrings) {
   if (contentType.startsWith("multipart/form-data")) {
     auto boundary = JSG_REQUIRE_NONNULL(readContentTypeParameter(contentType, "boundary"),
         TypeError, "No boundary string in Content-Type header. The multipart/form-data MIME "
         "type requires a boundary parameter, e.g. 'Content-Type: multipart/form-data; "
         "boundary=\"abcd\"'. See RFC 7578, section 4.");
-    parseFormData(data, boundary, rawText, convertFilesToStrings);
+    parseFormData(data, boundary, *rawText, convertFilesToStrings);
   } else if (contentType.startsWith("application/x-www-form-urlencoded")) {
     // Let's read the charset so we can barf if the body isn't UTF-8.
     //
@@ -319,7 +413,7 @@ void FormData::parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType
           TypeError, "Non-utf-8 application/x-www-form-urlencoded body.");
     }
     kj::Vector<kj::Url::QueryParam> query;
-    parseQueryString(query, kj::mv(rawText));
+    parseQueryString(query, rawText->bytes.asChars());
     data.reserve(query.size());
     for (auto& param: query) {
       data.add(Entry { kj::mv(param.name), kj::mv(param.value) });
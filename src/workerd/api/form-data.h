@@ -35,14 +35,34 @@ private:
   };
 
 public:
-  kj::Array<kj::byte> serialize(kj::ArrayPtr<const char> boundary);
-  // Given a delimiter string `boundary`, serialize all fields in this form data to an array of
-  // bytes suitable for use as an HTTP message body.
+  struct Serialized final: public kj::Refcounted {
+    // A serialized multipart/form-data body, split into pieces so that file contents are sent
+    // straight out of their Blobs rather than copied.
+    //
+    // NOTE: `files` holds jsg::Refs, so this must only be destroyed under the isolate lock.
 
-  void parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType,
+    kj::Array<char> text;
+    // All the boundaries, part headers and string values, concatenated.
+
+    kj::Array<jsg::Ref<File>> files;
+
+    kj::Array<kj::ArrayPtr<const kj::byte>> pieces;
+    // The body, in order. Alternates between slices of `text` and the contents of `files`.
+
+    uint64_t size = 0;
+    // Total size of `pieces`.
+  };
+
+  kj::Own<Serialized> serialize(kj::ArrayPtr<const char> boundary);
+  // Given a delimiter string `boundary`, serialize all fields in this form data to a form suitable
+  // for use as an HTTP message body. The size is computed up front, and only the part framing
+  // and string values are copied.
+
+  void parse(kj::Own<Blob::Buffer> rawText, kj::StringPtr contentType,
              bool convertFilesToStrings);
   // Parse `rawText`, storing the results in this FormData object. `contentType` must be either
-  // multipart/form-data or application/x-www-form-urlencoded.
+  // multipart/form-data or application/x-www-form-urlencoded. Files in a multipart body share
+  // `rawText` rather than copying their content out of it.
   //
   // `convertFilesToStrings` is for backwards-compatibility. The first implementation of this
   // class in Workers incorrectly represented files as strings (of their content). Changing this
@@ -8,6 +8,7 @@
 
 #include <workerd/api/cache.h>
 #include <workerd/api/crypto.h>
+#include <workerd/api/node/buffer-base64.h>
 #include <workerd/api/scheduled.h>
 #include <workerd/api/system-streams.h>
 #include <workerd/api/trace.h>
@@ -526,6 +527,29 @@ void ServiceWorkerGlobalScope::sendHibernatableWebSocketMessage(
   }
 }
 
+void ServiceWorkerGlobalScope::sendHibernatableWebSocketMessages(
+    kj::Array<kj::OneOf<kj::String, kj::Array<byte>>> messages,
+    kj::String websocketId,
+    Worker::Lock& lock, kj::Maybe<ExportedHandler&> exportedHandler) {
+  auto event = jsg::alloc<HibernatableWebSocketEvent>();
+  // Even if no handler is exported, we need to claim the websocket so it's removed from the map.
+  auto websocket = event->claimWebSocket(lock, websocketId);
+
+  KJ_IF_MAYBE(h, exportedHandler) {
+    KJ_IF_MAYBE(handler, h->webSocketMessages) {
+      auto promise = (*handler)(lock, kj::mv(websocket), kj::mv(messages));
+      event->waitUntil(kj::mv(promise));
+    } else KJ_IF_MAYBE(handler, h->webSocketMessage) {
+      // The batch was queued for a webSocketMessages() handler that's no longer exported, e.g.
+      // because the actor was restarted with new code. Deliver the messages one at a time.
+      for (auto& message: messages) {
+        auto promise = (*handler)(lock, websocket.addRef(), kj::mv(message));
+        event->waitUntil(kj::mv(promise));
+      }
+    }
+  }
+}
+
 void ServiceWorkerGlobalScope::sendHibernatableWebSocketClose(
     HibernatableSocketParams::Close close,
     kj::String websocketId,
@@ -597,31 +621,60 @@ void ServiceWorkerGlobalScope::emitPromiseRejection(
   }
 }
 
-kj::String ServiceWorkerGlobalScope::btoa(v8::Local<v8::Value> data, v8::Isolate* isolate) {
+v8::Local<v8::String> ServiceWorkerGlobalScope::btoa(
+    v8::Local<v8::Value> data, v8::Isolate* isolate) {
   auto str = jsg::check(data->ToString(isolate->GetCurrentContext()));
 
   // We could implement btoa() by accepting a kj::String, but then we'd have to check that it
   // doesn't have any multibyte code points. Easier to perform that test using v8::String's
-  // ContainsOnlyOneByte() function.
-  JSG_REQUIRE(str->ContainsOnlyOneByte(), DOMInvalidCharacterError,
+  // ContainsOnlyOneByte() function -- or, better yet, IsOneByte(), which just checks whether V8
+  // already stores the string as Latin-1. IsOneByte() can give false negatives, though, so it
+  // can only save us the slower check.
+  JSG_REQUIRE(str->IsOneByte() || str->ContainsOnlyOneByte(), DOMInvalidCharacterError,
       "btoa() can only operate on characters in the Latin1 (ISO/IEC 8859-1) range.");
 
-  // TODO(perf): v8::String sometimes holds a char pointer rather than a uint16_t pointer, which is
-  //   why v8::String::IsOneByte() is both faster than ContainsOnlyOneByte() and prone to false
-  //   negatives. Conceivably we could take advantage of this fact to completely avoid the later
-  //   WriteOneByte() call in some cases!
-  auto buf = kj::heapArray<kj::byte>(str->Length());
-  str->WriteOneByte(isolate, buf.begin(), 0, buf.size());
+  // We share node:buffer's vectorized encoder. Its output is ASCII, so it goes straight into a
+  // one-byte string.
+  const auto encode = [&](kj::ArrayPtr<const kj::byte> bytes) {
+    KJ_STACK_ARRAY(kj::byte, out, node::base64_encoded_size(bytes.size()), 1024, 4096);
+    node::base64_encode(bytes.asChars().begin(), bytes.size(), out.asChars().begin(), out.size());
+    return jsg::v8StrFromLatin1(isolate, out);
+  };
+
+  if (str->IsExternalOneByte()) {
+    // The string's Latin-1 data lives outside the V8 heap, so we can encode it in place.
+    auto resource = str->GetExternalOneByteStringResource();
+    return encode(kj::arrayPtr(
+        reinterpret_cast<const kj::byte*>(resource->data()), resource->length()));
+  }
+
+  KJ_STACK_ARRAY(kj::byte, buf, str->Length(), 1024, 4096);
+  str->WriteOneByte(isolate, buf.begin(), 0, buf.size(), v8::String::NO_NULL_TERMINATION);
 
-  return kj::encodeBase64(buf);
+  return encode(buf);
 }
-v8::Local<v8::String> ServiceWorkerGlobalScope::atob(kj::String data, v8::Isolate* isolate) {
-  auto decoded = kj::decodeBase64(data.asArray());
+v8::Local<v8::String> ServiceWorkerGlobalScope::atob(
+    v8::Local<v8::Value> data, v8::Isolate* isolate) {
+  // Like btoa(), we take a v8::Value. Valid base64 is all ASCII, so rather than transcoding the
+  // string to UTF-8 as a kj::String parameter would, we copy out its Latin-1 bytes; anything
+  // outside that range we can reject right away.
+  auto str = jsg::check(data->ToString(isolate->GetCurrentContext()));
 
-  JSG_REQUIRE(!decoded.hadErrors, DOMInvalidCharacterError,
+  const auto errorMessage =
       "atob() called with invalid base64-encoded data. (Only whitespace, '+', '/', alphanumeric "
       "ASCII, and up to two terminal '=' signs when the input data length is divisible by 4 are "
-      "allowed.)");
+      "allowed.)"_kj;
+
+  JSG_REQUIRE(str->IsOneByte() || str->ContainsOnlyOneByte(), DOMInvalidCharacterError,
+      errorMessage);
+
+  KJ_STACK_ARRAY(char, buf, str->Length(), 1024, 4096);
+  str->WriteOneByte(isolate, reinterpret_cast<uint8_t*>(buf.begin()), 0, buf.size(),
+      v8::String::NO_NULL_TERMINATION);
+
+  auto decoded = kj::decodeBase64(buf);
+
+  JSG_REQUIRE(!decoded.hadErrors, DOMInvalidCharacterError, errorMessage);
 
   // Similar to btoa() taking a v8::Value, we return a v8::String directly, as this allows us to
   // construct a string from the non-nul-terminated array returned from decodeBase64(). This avoids
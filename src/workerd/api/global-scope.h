@@ -66,7 +66,7 @@ public:
 
   JSG_RESOURCE_TYPE(Performance) {
     JSG_READONLY_INSTANCE_PROPERTY(timeOrigin, getTimeOrigin);
-    JSG_METHOD(now);
+    JSG_FAST_METHOD(now);
   }
 };
 
@@ -190,6 +190,11 @@ struct ExportedHandler {
   typedef kj::Promise<void> HibernatableWebSocketMessageHandler(jsg::Ref<WebSocket>, kj::OneOf<kj::String, kj::Array<byte>> message);
   jsg::LenientOptional<jsg::Function<HibernatableWebSocketMessageHandler>> webSocketMessage;
 
+  typedef kj::Promise<void> HibernatableWebSocketMessagesHandler(jsg::Ref<WebSocket>, kj::Array<kj::OneOf<kj::String, kj::Array<byte>>> messages);
+  jsg::LenientOptional<jsg::Function<HibernatableWebSocketMessagesHandler>> webSocketMessages;
+  // If exported, messages that arrive on a websocket while a previous event is still running are
+  // delivered together in one call, rather than in one event each.
+
   typedef kj::Promise<void> HibernatableWebSocketCloseHandler(jsg::Ref<WebSocket>, int code, kj::String reason, bool wasClean);
   jsg::LenientOptional<jsg::Function<HibernatableWebSocketCloseHandler>> webSocketClose;
 
@@ -199,7 +204,7 @@ struct ExportedHandler {
   jsg::SelfRef self;
   // Self-ref potentially allows extracting other custom handlers from the object.
 
-  JSG_STRUCT(fetch, tail, trace, scheduled, alarm, test, webSocketMessage, webSocketClose, webSocketError, self);
+  JSG_STRUCT(fetch, tail, trace, scheduled, alarm, test, webSocketMessage, webSocketMessages, webSocketClose, webSocketError, self);
 
   JSG_STRUCT_TS_ROOT();
   // ExportedHandler isn't included in the global scope, but we still want to
@@ -221,6 +226,7 @@ struct ExportedHandler {
     scheduled?: ExportedHandlerScheduledHandler<Env>;
     alarm: never;
     webSocketMessage: never;
+    webSocketMessages: never;
     webSocketClose: never;
     webSocketError: never;
     queue?: ExportedHandlerQueueHandler<Env, QueueHandlerMessage>;
@@ -296,6 +302,12 @@ public:
       Worker::Lock& lock,
       kj::Maybe<ExportedHandler&> exportedHandler);
 
+  void sendHibernatableWebSocketMessages(
+      kj::Array<kj::OneOf<kj::String, kj::Array<byte>>> messages,
+      kj::String websocketId,
+      Worker::Lock& lock,
+      kj::Maybe<ExportedHandler&> exportedHandler);
+
   void sendHibernatableWebSocketClose(
       HibernatableSocketParams::Close close,
       kj::String websocketId,
@@ -317,8 +329,8 @@ public:
   // ---------------------------------------------------------------------------
   // JS API
 
-  kj::String btoa(v8::Local<v8::Value> data, v8::Isolate* isolate);
-  v8::Local<v8::String> atob(kj::String data, v8::Isolate* isolate);
+  v8::Local<v8::String> btoa(v8::Local<v8::Value> data, v8::Isolate* isolate);
+  v8::Local<v8::String> atob(v8::Local<v8::Value> data, v8::Isolate* isolate);
 
   void queueMicrotask(jsg::Lock& js, v8::Local<v8::Function> task);
 
@@ -603,6 +615,7 @@ public:
 
     JSG_TS_OVERRIDE({
       btoa(data: string): string;
+      atob(data: string): string;
 
       setTimeout(callback: (...args: any[]) => void, msDelay?: number): number;
       setTimeout<Args extends any[]>(callback: (...args: Args) => void, msDelay?: number, ...args: Args): number;
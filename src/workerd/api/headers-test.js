@@ -0,0 +1,33 @@
+import { strictEqual } from 'node:assert';
+
+export const copiesAreIndependent = {
+  test() {
+    const original = new Headers([['X-Foo', 'bar'], ['Set-Cookie', 'a=1'], ['Set-Cookie', 'b=2']]);
+    const copy = new Headers(original);
+    strictEqual(copy.get('x-foo'), 'bar');
+
+    // Modifying the copy must not affect the original, and vice versa.
+    copy.set('x-foo', 'baz');
+    copy.append('x-new', '1');
+    strictEqual(original.get('x-foo'), 'bar');
+    strictEqual(original.has('x-new'), false);
+    strictEqual(copy.get('x-foo'), 'baz');
+
+    original.delete('set-cookie');
+    strictEqual(copy.getSetCookie().length, 2);
+    strictEqual(original.getSetCookie().length, 0);
+  }
+};
+
+export const requestHeadersAreCopied = {
+  test() {
+    const first = new Request('https://example.com', { headers: { 'x-foo': 'bar' } });
+    const second = new Request(first);
+    second.headers.set('x-foo', 'baz');
+    strictEqual(first.headers.get('x-foo'), 'bar');
+
+    const response = new Response(null, { headers: first.headers });
+    first.headers.set('x-foo', 'qux');
+    strictEqual(response.headers.get('x-foo'), 'bar');
+  }
+};
@@ -72,8 +72,15 @@ kj::Promise<WorkerInterface::CustomEvent::Result> HibernatableWebSocketCustomEve
 
   try {
     co_await context.run(
-        [entrypointName=entrypointName, &context, eventParameters=consumeParams()]
+        [entrypointName=entrypointName, &context, &a, eventParameters=consumeParams()]
         (Worker::Lock& lock) mutable {
+      KJ_IF_MAYBE(h, lock.getExportedHandler(entrypointName, context.getActor())) {
+        // Batched delivery is opt-in: the HibernationManager starts batching once it learns that
+        // the Worker exports a webSocketMessages() handler.
+        kj::downcast<HibernationManagerImpl>(KJ_REQUIRE_NONNULL(a.getHibernationManager()))
+            .setBatchedDelivery(h->webSocketMessages != nullptr);
+      }
+
       KJ_SWITCH_ONEOF(eventParameters.eventType) {
         KJ_CASE_ONEOF(text, HibernatableSocketParams::Text) {
           return lock.getGlobalScope().sendHibernatableWebSocketMessage(
@@ -89,6 +96,13 @@ kj::Promise<WorkerInterface::CustomEvent::Result> HibernatableWebSocketCustomEve
               lock,
               lock.getExportedHandler(entrypointName, context.getActor()));
         }
+        KJ_CASE_ONEOF(batch, HibernatableSocketParams::Batch) {
+          return lock.getGlobalScope().sendHibernatableWebSocketMessages(
+              kj::mv(batch.messages),
+              kj::mv(eventParameters.websocketId),
+              lock,
+              lock.getExportedHandler(entrypointName, context.getActor()));
+        }
         KJ_CASE_ONEOF(close, HibernatableSocketParams::Close) {
           return lock.getGlobalScope().sendHibernatableWebSocketClose(
               kj::mv(close),
@@ -152,7 +166,19 @@ kj::Promise<WorkerInterface::CustomEvent::Result>
       KJ_CASE_ONEOF(e, HibernatableSocketParams::Error) {
         payload.setError(e.error.getDescription());
       }
-      KJ_UNREACHABLE;
+      KJ_CASE_ONEOF(batch, HibernatableSocketParams::Batch) {
+        auto messages = payload.initBatch(batch.messages.size());
+        for (auto i: kj::indices(batch.messages)) {
+          KJ_SWITCH_ONEOF(batch.messages[i]) {
+            KJ_CASE_ONEOF(text, kj::String) {
+              messages[i].setText(text);
+            }
+            KJ_CASE_ONEOF(data, kj::Array<byte>) {
+              messages[i].setData(data);
+            }
+          }
+        }
+      }
     }
     message.setWebsocketId(kj::mv(eventParameters.websocketId));
   }
@@ -112,6 +112,20 @@ private:
               kj::mv(websocketId));
           break;
         }
+        case rpc::HibernatableWebSocketEventMessage::Payload::BATCH: {
+          auto messages = KJ_MAP(message, payload.getBatch())
+              -> kj::OneOf<kj::String, kj::Array<byte>> {
+            switch (message.which()) {
+              case rpc::HibernatableWebSocketEventMessage::Message::TEXT:
+                return kj::str(message.getText());
+              case rpc::HibernatableWebSocketEventMessage::Message::DATA:
+                return kj::heapArray(message.getData().asBytes());
+            }
+            KJ_UNREACHABLE;
+          };
+          eventParameters.emplace(kj::mv(messages), kj::mv(websocketId));
+          break;
+        }
       }
       return kj::mv(KJ_REQUIRE_NONNULL(eventParameters));
     }
@@ -31,7 +31,11 @@ namespace workerd::api {
       kj::Exception error;
     };
 
-    kj::OneOf<Text, Data, Close, Error> eventType;
+    struct Batch {
+      kj::Array<kj::OneOf<kj::String, kj::Array<kj::byte>>> messages;
+    };
+
+    kj::OneOf<Text, Data, Close, Error, Batch> eventType;
     kj::String websocketId;
 
     explicit HibernatableSocketParams(kj::String message, kj::String id)
@@ -42,6 +46,9 @@ namespace workerd::api {
         : eventType(Close { code, kj::mv(reason), wasClean }), websocketId(kj::mv(id)) {}
     explicit HibernatableSocketParams(kj::Exception e, kj::String id)
         : eventType(Error { kj::mv(e) }), websocketId(kj::mv(id)) {}
+    explicit HibernatableSocketParams(
+        kj::Array<kj::OneOf<kj::String, kj::Array<kj::byte>>> messages, kj::String id)
+        : eventType(Batch { kj::mv(messages) }), websocketId(kj::mv(id)) {}
 
     HibernatableSocketParams(HibernatableSocketParams&& other) = default;
 
@@ -47,13 +47,26 @@ const LolHtmlDisposer<T, lolhtmlFree> LolHtmlDisposer<T, lolhtmlFree>::INSTANCE;
     kj::Own<T>(&check(__VA_ARGS__), LolHtmlDisposer<T, lolhtmlFree>::INSTANCE); \
   })
 
+v8::Local<v8::String> newJsString(jsg::Lock& js, kj::ArrayPtr<const char> chars) {
+  // Makes a JS string straight from a lol-html buffer, without an intermediate kj::String. The
+  // buffer is UTF-8, but markup is almost always ASCII, which V8 can copy verbatim into a one-byte
+  // string instead of decoding.
+  for (char c: chars) {
+    if (static_cast<kj::byte>(c) >= 0x80) {
+      return jsg::v8Str(js.v8Isolate, chars);
+    }
+  }
+  return jsg::v8StrFromLatin1(js.v8Isolate, chars.asBytes());
+}
+
 class LolString {
   // RAII helper for lol_html_str_t.
   //
   // We cannot use a kj::Own<T> because lol_html_str_t is a struct, not a pointer, so instead we
   // have this LolString RAII wrapper.
   //
-  // Use `kj::str(LolString.asChars())` to allocate your own copy of a LolString.
+  // Use `kj::str(LolString.asChars())` to allocate your own copy of a LolString, or
+  // `asJsString()` to hand it to JavaScript.
 
 public:
   explicit LolString(lol_html_str_t s): chars(s.data, s.len) {}
@@ -73,9 +86,13 @@ public:
 
   kj::ArrayPtr<const char> asChars() const { return chars; }
 
-  kj::Maybe<kj::String> asKjString() {
+  v8::Local<v8::String> asJsString(jsg::Lock& js) const {
+    return newJsString(js, chars);
+  }
+
+  kj::Maybe<v8::Local<v8::String>> asMaybeJsString(jsg::Lock& js) const {
     if (chars.begin() != nullptr) {
-      return kj::str(chars);
+      return newJsString(js, chars);
     } else {
       return nullptr;
     }
@@ -257,16 +274,16 @@ private:
     ElementCallbackFunction callback;
   };
 
-  kj::Vector<kj::Own<RegisteredHandler>> registeredHandlers;
-  // TODO(perf): Don't store Owns. We need to pass stable pointers as the userdata parameter to
-  //   lol_html_rewriter_builder_add_*_content_handlers(), but don't have a really easy way to
-  //   know precisely how many handlers we're going to register beforehand, so we need a vector. But
-  //   vectors can grow, moving their objects around, invalidating pointers into their storage.
+  kj::Vector<RegisteredHandler> registeredHandlers;
+  // We pass pointers into this vector as the userdata parameter to
+  // lol_html_rewriter_builder_add_*_content_handlers(), so they must stay stable: buildRewriter()
+  // reserves exactly enough room for every handler up front, so the vector never grows.
 
   kj::Vector<kj::Own<RegisteredHandler>> registeredEndTagHandlers;
   // This is separate from `registeredHandlers` so we can delete them more eagerly when EndTags are
-  // destroyed, and not have to look through all other handlers.
-  // TODO(perf) Don't store Owns, same as `registeredHandlers` above.
+  // destroyed, and not have to look through all other handlers. These are added and removed one
+  // at a time as the document is parsed, so unlike `registeredHandlers` we can't size them up
+  // front, and each one is individually allocated to keep its address stable.
 
   template <typename T, typename CType = typename T::CType>
   static lol_html_rewriter_directive_t thunk(CType* content, void* userdata);
@@ -318,9 +335,28 @@ kj::Own<lol_html_HtmlRewriter> Rewriter::buildRewriter(
     kj::ArrayPtr<const char> encoding, Rewriter& rewriter) {
   auto builder = LOL_HTML_OWN(rewriter_builder, lol_html_rewriter_builder_new());
 
+  size_t handlerCount = 0;
+  for (auto& handlers: unregisteredHandlers) {
+    KJ_SWITCH_ONEOF(handlers) {
+      KJ_CASE_ONEOF(elementHandlers, UnregisteredElementHandlers) {
+        handlerCount += (elementHandlers.element != nullptr) +
+                        (elementHandlers.comments != nullptr) +
+                        (elementHandlers.text != nullptr);
+      }
+      KJ_CASE_ONEOF(documentHandlers, UnregisteredDocumentHandlers) {
+        handlerCount += (documentHandlers.doctype != nullptr) +
+                        (documentHandlers.comments != nullptr) +
+                        (documentHandlers.text != nullptr) +
+                        (documentHandlers.end != nullptr);
+      }
+    }
+  }
+  rewriter.registeredHandlers.reserve(handlerCount);
+
   auto registerCallback = [&](ElementCallbackFunction& callback) {
-        auto registeredHandler = RegisteredHandler{rewriter, callback.addRef(js) };
-        return rewriter.registeredHandlers.add(kj::heap(kj::mv(registeredHandler))).get();
+    // Growing the vector would invalidate the pointers we've already handed to lol-html.
+    KJ_ASSERT(rewriter.registeredHandlers.size() < rewriter.registeredHandlers.capacity());
+    return &rewriter.registeredHandlers.add(RegisteredHandler{rewriter, callback.addRef(js)});
   };
 
   for (auto& handlers: unregisteredHandlers) {
@@ -560,7 +596,7 @@ kj::Promise<void> Rewriter::thunkPromise( CType* content, RegisteredHandler& reg
     jsg::AsyncContextFrame::Scope asyncContextScope(lock, maybeAsyncContext);
     auto jsContent = jsg::alloc<T>(*content, *this);
     auto scope = HTMLRewriter::TokenScope(jsContent);
-    auto value = registeredHandler.callback(lock, kj::mv(jsContent));
+    auto result = registeredHandler.callback(lock, kj::mv(jsContent));
 
     if constexpr (kj::isSameType<T, EndTag>()) {
       // TODO(someday): We can't unconditionally pop the top of `registeredEndTagHandlers`,
@@ -571,7 +607,12 @@ kj::Promise<void> Rewriter::thunkPromise( CType* content, RegisteredHandler& reg
       removeEndTagHandler(registeredHandler);
     }
 
-    return value.attach(kj::mv(scope));
+    KJ_IF_MAYBE(promise, result) {
+      return ioContext.awaitJs(kj::mv(*promise)).attach(kj::mv(scope));
+    }
+    // The handler finished synchronously, so its tokens are invalidated as soon as `scope` is
+    // destroyed and lol-html can continue without waiting on the event loop.
+    return kj::READY_NOW;
   });
 }
 
@@ -619,9 +660,9 @@ Element::Element(CType& element, Rewriter& rewriter) {
   impl.emplace(element, rewriter);
 }
 
-kj::String Element::getTagName() {
+v8::Local<v8::String> Element::getTagName(jsg::Lock& js) {
   auto tagName = LolString(lol_html_element_tag_name_get(&checkToken(impl).element));
-  return kj::str(tagName.asChars());
+  return tagName.asJsString(js);
 }
 
 void Element::setTagName(kj::String name) {
@@ -648,15 +689,13 @@ jsg::Ref<Element::AttributesIterator> Element::getAttributes() {
   return kj::mv(jsIter);
 }
 
-kj::Maybe<kj::String> Element::getAttribute(kj::String name) {
+kj::Maybe<v8::Local<v8::String>> Element::getAttribute(jsg::Lock& js, kj::String name) {
   // NOTE: lol_html_element_get_attribute() returns NULL for both nonexistent attributes and for
   //   errors, so we can't use check() here.
   LolString attr(lol_html_element_get_attribute(
       &checkToken(impl).element, name.cStr(), name.size()));
-    // TODO(perf): We could construct a v8::String directly here, saving a copy.
-  kj::Maybe kjAttr = attr.asKjString();
-  if (kjAttr != nullptr) {
-    return kj::mv(kjAttr);
+  KJ_IF_MAYBE(jsAttr, attr.asMaybeJsString(js)) {
+    return *jsAttr;
   }
 
   KJ_IF_MAYBE(exception, tryGetLastError()) {
@@ -737,9 +776,9 @@ void EndTag::htmlContentScopeEnd() {
   impl = nullptr;
 }
 
-kj::String EndTag::getName() {
+v8::Local<v8::String> EndTag::getName(jsg::Lock& js) {
   auto text = LolString(lol_html_end_tag_name_get(&checkToken(impl)));
-  return kj::str(text.asChars());
+  return text.asJsString(js);
 }
 
 void EndTag::setName(kj::String text) {
@@ -793,7 +832,7 @@ jsg::Ref<Element::AttributesIterator> Element::AttributesIterator::self() {
   return JSG_THIS;
 }
 
-Element::AttributesIterator::Next Element::AttributesIterator::next() {
+Element::AttributesIterator::Next Element::AttributesIterator::next(jsg::Lock& js) {
   // NOTE: lol_html_attribute_t doesn't need to be freed.
   auto* attribute = lol_html_attributes_iterator_next(checkToken(impl));
   if (attribute == nullptr) {
@@ -806,7 +845,7 @@ Element::AttributesIterator::Next Element::AttributesIterator::next() {
   auto name = LolString(lol_html_attribute_name_get(attribute));
   auto value = LolString(lol_html_attribute_value_get(attribute));
 
-  return { false, kj::arr(kj::str(name.asChars()), kj::str(value.asChars())) };
+  return { false, kj::arr(name.asJsString(js), value.asJsString(js)) };
 }
 
 void Element::AttributesIterator::htmlContentScopeEnd() {
@@ -818,9 +857,9 @@ void Element::AttributesIterator::htmlContentScopeEnd() {
 
 Comment::Comment(CType& comment, Rewriter&): impl(comment) {}
 
-kj::String Comment::getText() {
+v8::Local<v8::String> Comment::getText(jsg::Lock& js) {
   auto text = LolString(lol_html_comment_text_get(&checkToken(impl)));
-  return kj::str(text.asChars());
+  return text.asJsString(js);
 }
 
 void Comment::setText(kj::String text) {
@@ -877,9 +916,10 @@ void Comment::htmlContentScopeEnd() {
 
 Text::Text(CType& text, Rewriter&): impl(text) {}
 
-kj::String Text::getText() {
+v8::Local<v8::String> Text::getText(jsg::Lock& js) {
+  // The chunk content is borrowed from lol-html, not owned, so there's nothing to free.
   auto content = lol_html_text_chunk_content_get(&checkToken(impl));
-  return kj::heapString(content.data, content.len);
+  return newJsString(js, kj::arrayPtr(content.data, content.len));
 }
 
 bool Text::getLastInTextNode() {
@@ -937,19 +977,19 @@ void Text::htmlContentScopeEnd() {
 
 Doctype::Doctype(CType& doctype, Rewriter&): impl(doctype) {}
 
-kj::Maybe<kj::String> Doctype::getName() {
+kj::Maybe<v8::Local<v8::String>> Doctype::getName(jsg::Lock& js) {
   LolString name(lol_html_doctype_name_get(&checkToken(impl)));
-  return name.asKjString();
+  return name.asMaybeJsString(js);
 }
 
-kj::Maybe<kj::String> Doctype::getPublicId() {
+kj::Maybe<v8::Local<v8::String>> Doctype::getPublicId(jsg::Lock& js) {
   LolString publicId(lol_html_doctype_public_id_get(&checkToken(impl)));
-  return publicId.asKjString();
+  return publicId.asMaybeJsString(js);
 }
 
-kj::Maybe<kj::String> Doctype::getSystemId() {
+kj::Maybe<v8::Local<v8::String>> Doctype::getSystemId(jsg::Lock& js) {
   LolString systemId(lol_html_doctype_system_id_get(&checkToken(impl)));
-  return systemId.asKjString();
+  return systemId.asMaybeJsString(js);
 }
 
 void Doctype::htmlContentScopeEnd() {
@@ -989,7 +1029,9 @@ struct HTMLRewriter::Impl {
   //   builder which created them, lest the process deadlock.
   //
   //   In the meantime, we keep this list of handlers around and "replay" their registration, in
-  //   order, on the builder object that we create inside of .transform().
+  //   order, on the builder object that we create inside of .transform(). The expensive part of
+  //   registration, parsing the selectors, already happens only once, in on(): every transform()
+  //   shares the same lol_html_Selector objects.
 };
 
 HTMLRewriter::HTMLRewriter(): impl(kj::heap<Impl>()) {}
@@ -45,7 +45,9 @@ public:
 
   static jsg::Ref<HTMLRewriter> constructor();
 
-  using ElementCallback = kj::Promise<void>(jsg::Ref<jsg::Object> element);
+  using ElementCallback = kj::Maybe<jsg::Promise<void>>(jsg::Ref<jsg::Object> element);
+  // Handlers may return a promise to pause the rewriter until it settles, but most return
+  // undefined. Those are completed synchronously, without a round trip through the microtask queue.
   using ElementCallbackFunction = jsg::Function<ElementCallback>;
 
   struct ElementContentHandlers {
@@ -164,7 +166,7 @@ public:
 
   explicit Element(CType& element, Rewriter& wrapper);
 
-  kj::String getTagName();
+  v8::Local<v8::String> getTagName(jsg::Lock& js);
   void setTagName(kj::String tagName);
 
   class AttributesIterator;
@@ -174,7 +176,7 @@ public:
 
   kj::StringPtr getNamespaceURI();
 
-  kj::Maybe<kj::String> getAttribute(kj::String name);
+  kj::Maybe<v8::Local<v8::String>> getAttribute(jsg::Lock& js, kj::String name);
   bool hasAttribute(kj::String name);
   jsg::Ref<Element> setAttribute(kj::String name, kj::String value);
   jsg::Ref<Element> removeAttribute(kj::String name);
@@ -254,12 +256,12 @@ public:
 
   struct Next {
     bool done;
-    jsg::Optional<kj::Array<kj::String>> value;
+    jsg::Optional<kj::Array<v8::Local<v8::String>>> value;
 
     JSG_STRUCT(done, value);
   };
 
-  Next next();
+  Next next(jsg::Lock& js);
 
   jsg::Ref<AttributesIterator> self();
 
@@ -281,7 +283,7 @@ public:
 
   explicit EndTag(CType& tag, Rewriter&);
 
-  kj::String getName();
+  v8::Local<v8::String> getName(jsg::Lock& js);
   void setName(kj::String);
 
   jsg::Ref<EndTag> before(Content content, jsg::Optional<ContentOptions> options);
@@ -315,7 +317,7 @@ public:
 
   explicit Comment(CType& comment, Rewriter&);
 
-  kj::String getText();
+  v8::Local<v8::String> getText(jsg::Lock& js);
   void setText(kj::String);
 
   bool getRemoved();
@@ -355,7 +357,7 @@ public:
 
   explicit Text(CType& text, Rewriter&);
 
-  kj::String getText();
+  v8::Local<v8::String> getText(jsg::Lock& js);
 
   bool getLastInTextNode();
 
@@ -397,9 +399,9 @@ public:
 
   explicit Doctype(CType& doctype, Rewriter&);
 
-  kj::Maybe<kj::String> getName();
-  kj::Maybe<kj::String> getPublicId();
-  kj::Maybe<kj::String> getSystemId();
+  kj::Maybe<v8::Local<v8::String>> getName(jsg::Lock& js);
+  kj::Maybe<v8::Local<v8::String>> getPublicId(jsg::Lock& js);
+  kj::Maybe<v8::Local<v8::String>> getSystemId(jsg::Lock& js);
 
   JSG_RESOURCE_TYPE(Doctype) {
     JSG_READONLY_INSTANCE_PROPERTY(name, getName);
@@ -118,25 +118,38 @@ Headers::Headers(jsg::Dict<jsg::ByteString, jsg::ByteString> dict)
 }
 
 Headers::Headers(const Headers& other)
+    : guard(Guard::NONE), headers(kj::addRef(const_cast<HeaderMap&>(*other.headers))) {
+  // Casting away const is OK here: neither Headers object modifies the map while it is shared.
+}
+
+Headers::Headers(const kj::HttpHeaders& other, Guard guard)
     : guard(Guard::NONE) {
-  for (auto& header: other.headers) {
+  other.forEach([this](auto name, auto value) {
+    append(jsg::ByteString(kj::str(name)), jsg::ByteString(kj::str(value)));
+  });
+
+  this->guard = guard;
+}
+
+kj::Own<Headers::HeaderMap> Headers::HeaderMap::clone() const {
+  auto result = kj::refcounted<HeaderMap>();
+  for (auto& header: entries) {
     Header copy {
       jsg::ByteString(kj::str(header.second.key)),
       jsg::ByteString(kj::str(header.second.name)),
       KJ_MAP(value, header.second.values) { return jsg::ByteString(kj::str(value)); },
     };
     kj::StringPtr keyRef = copy.key;
-    KJ_ASSERT(headers.insert(std::make_pair(keyRef, kj::mv(copy))).second);
+    KJ_ASSERT(result->entries.insert(std::make_pair(keyRef, kj::mv(copy))).second);
   }
+  return result;
 }
 
-Headers::Headers(const kj::HttpHeaders& other, Guard guard)
-    : guard(Guard::NONE) {
-  other.forEach([this](auto name, auto value) {
-    append(jsg::ByteString(kj::str(name)), jsg::ByteString(kj::str(value)));
-  });
-
-  this->guard = guard;
+std::map<kj::StringPtr, Headers::Header>& Headers::mutableHeaders() {
+  if (headers->isShared()) {
+    headers = headers->clone();
+  }
+  return headers->entries;
 }
 
 jsg::Ref<Headers> Headers::clone() const {
@@ -149,7 +162,7 @@ void Headers::shallowCopyTo(kj::HttpHeaders& out) {
   // Fill in the given HttpHeaders with these headers. Note that strings are inserted by
   // reference, so the output must be consumed immediately.
 
-  for (auto& entry: headers) {
+  for (auto& entry: headers->entries) {
     for (auto& value: entry.second.values) {
       out.add(entry.second.name, value);
     }
@@ -162,13 +175,13 @@ bool Headers::hasLowerCase(kj::StringPtr name) {
     KJ_DREQUIRE(!('A' <= c && c <= 'Z'));
   }
 #endif
-  return headers.find(name) != headers.end();
+  return headers->entries.find(name) != headers->entries.end();
 }
 
 kj::Array<Headers::DisplayedHeader> Headers::getDisplayedHeaders(jsg::Lock& js) {
   if (FeatureFlags::get(js).getHttpHeadersGetSetCookie()) {
     kj::Vector<Headers::DisplayedHeader> copy;
-    for (auto& entry : headers) {
+    for (auto& entry : headers->entries) {
       if (entry.first == "set-cookie") {
         // For set-cookie entries, we iterate each individually without
         // combining them.
@@ -188,7 +201,7 @@ kj::Array<Headers::DisplayedHeader> Headers::getDisplayedHeaders(jsg::Lock& js)
     return copy.releaseAsArray();
   } else {
     // The old behavior before the standard getSetCookie() API was introduced...
-    auto headersCopy = KJ_MAP(mapEntry, headers) {
+    auto headersCopy = KJ_MAP(mapEntry, headers->entries) {
       const auto& header = mapEntry.second;
       return DisplayedHeader {
         jsg::ByteString(kj::str(header.key)),
@@ -246,8 +259,8 @@ jsg::Ref<Headers> Headers::constructor(jsg::Lock& js, jsg::Optional<Initializer>
 
 kj::Maybe<jsg::ByteString> Headers::get(jsg::ByteString name) {
   requireValidHeaderName(name);
-  auto iter = headers.find(toLower(kj::mv(name)));
-  if (iter == headers.end()) {
+  auto iter = headers->entries.find(toLower(kj::mv(name)));
+  if (iter == headers->entries.end()) {
     return nullptr;
   } else {
     return jsg::ByteString(kj::strArray(iter->second.values, ", "));
@@ -255,8 +268,8 @@ kj::Maybe<jsg::ByteString> Headers::get(jsg::ByteString name) {
 }
 
 kj::ArrayPtr<jsg::ByteString> Headers::getSetCookie() {
-  auto iter = headers.find("set-cookie");
-  if (iter == headers.end()) {
+  auto iter = headers->entries.find("set-cookie");
+  if (iter == headers->entries.end()) {
     return nullptr;
   } else {
     return iter->second.values.asPtr();
@@ -278,7 +291,7 @@ kj::ArrayPtr<jsg::ByteString> Headers::getAll(jsg::ByteString name) {
 
 bool Headers::has(jsg::ByteString name) {
   requireValidHeaderName(name);
-  return headers.find(toLower(kj::mv(name))) != headers.end();
+  return headers->entries.find(toLower(kj::mv(name))) != headers->entries.end();
 }
 
 void Headers::set(jsg::ByteString name, jsg::ByteString value) {
@@ -287,7 +300,8 @@ void Headers::set(jsg::ByteString name, jsg::ByteString value) {
   auto key = toLower(name);
   value = normalizeHeaderValue(kj::mv(value));
   requireValidHeaderValue(value);
-  auto [iter, emplaced] = headers.try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
+  auto [iter, emplaced] =
+      mutableHeaders().try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
   if (!emplaced) {
     // Overwrite existing value(s).
     iter->second.values.clear();
@@ -301,7 +315,8 @@ void Headers::append(jsg::ByteString name, jsg::ByteString value) {
   auto key = toLower(name);
   value = normalizeHeaderValue(kj::mv(value));
   requireValidHeaderValue(value);
-  auto [iter, emplaced] = headers.try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
+  auto [iter, emplaced] =
+      mutableHeaders().try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
   if (!emplaced) {
     iter->second.values.add(kj::mv(value));
   }
@@ -310,7 +325,7 @@ void Headers::append(jsg::ByteString name, jsg::ByteString value) {
 void Headers::delete_(jsg::ByteString name) {
   checkGuard();
   requireValidHeaderName(name);
-  headers.erase(toLower(kj::mv(name)));
+  mutableHeaders().erase(toLower(kj::mv(name)));
 }
 
 // There are a couple implementation details of the Headers iterators worth calling out.
@@ -346,7 +361,7 @@ jsg::Ref<Headers::EntryIterator> Headers::entries(jsg::Lock& js) {
 jsg::Ref<Headers::KeyIterator> Headers::keys(jsg::Lock& js) {
   if (FeatureFlags::get(js).getHttpHeadersGetSetCookie()) {
     kj::Vector<jsg::ByteString> keysCopy;
-    for (auto& entry : headers) {
+    for (auto& entry : headers->entries) {
       // Set-Cookie headers must be handled specially. They should never be combined into a
       // single value, so the values iterator must separate them. It seems a bit silly, but
       // the keys iterator can end up having multiple set-cookie instances.
@@ -360,7 +375,7 @@ jsg::Ref<Headers::KeyIterator> Headers::keys(jsg::Lock& js) {
     }
     return jsg::alloc<KeyIterator>(IteratorState<jsg::ByteString> { keysCopy.releaseAsArray() });
   } else {
-    auto keysCopy = KJ_MAP(mapEntry, headers) {
+    auto keysCopy = KJ_MAP(mapEntry, headers->entries) {
       return jsg::ByteString(kj::str(mapEntry.second.key));
     };
     return jsg::alloc<KeyIterator>(IteratorState<jsg::ByteString> { kj::mv(keysCopy) });
@@ -369,7 +384,7 @@ jsg::Ref<Headers::KeyIterator> Headers::keys(jsg::Lock& js) {
 jsg::Ref<Headers::ValueIterator> Headers::values(jsg::Lock& js) {
   if (FeatureFlags::get(js).getHttpHeadersGetSetCookie()) {
     kj::Vector<jsg::ByteString> values;
-    for (auto& entry : headers) {
+    for (auto& entry : headers->entries) {
       // Set-Cookie headers must be handled specially. They should never be combined into a
       // single value, so the values iterator must separate them.
       if (entry.first == "set-cookie") {
@@ -382,7 +397,7 @@ jsg::Ref<Headers::ValueIterator> Headers::values(jsg::Lock& js) {
     }
     return jsg::alloc<ValueIterator>(IteratorState<jsg::ByteString> { values.releaseAsArray() });
   } else {
-    auto valuesCopy = KJ_MAP(mapEntry, headers) {
+    auto valuesCopy = KJ_MAP(mapEntry, headers->entries) {
       return jsg::ByteString(kj::strArray(mapEntry.second.values, ", "));
     };
     return jsg::alloc<ValueIterator>(IteratorState<jsg::ByteString> { kj::mv(valuesCopy) });
@@ -427,18 +442,31 @@ class BodyBufferInputStream final: public ReadableStreamSource {
 public:
   BodyBufferInputStream(Body::Buffer buffer)
       : unread(buffer.view),
-        ownBytes(kj::mv(buffer.ownBytes)) {}
+        ownBytes(kj::mv(buffer.ownBytes)) {
+    KJ_IF_MAYBE(formData, ownBytes.tryGet<kj::Own<FormData::Serialized>>()) {
+      morePieces = (*formData)->pieces;
+      nextPiece();
+    }
+  }
 
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
-    size_t amount = kj::min(maxBytes, unread.size());
-    memcpy(buffer, unread.begin(), amount);
-    unread = unread.slice(amount, unread.size());
-    return amount;
+    auto out = reinterpret_cast<byte*>(buffer);
+    size_t total = 0;
+    while (total < maxBytes && unread.size() > 0) {
+      size_t amount = kj::min(maxBytes - total, unread.size());
+      memcpy(out + total, unread.begin(), amount);
+      unread = unread.slice(amount, unread.size());
+      total += amount;
+      if (unread.size() == 0) nextPiece();
+    }
+    return total;
   }
 
   kj::Maybe<uint64_t> tryGetLength(StreamEncoding encoding) override {
     if (encoding == StreamEncoding::IDENTITY) {
-      return unread.size();
+      uint64_t result = unread.size();
+      for (auto piece: morePieces) result += piece.size();
+      return result;
     } else {
       // Who knows what the compressed size will be?
       return nullptr;
@@ -450,8 +478,20 @@ public:
       return addNoopDeferredProxy(kj::READY_NOW);
     }
 
-    auto promise = output.write(unread.begin(), unread.size());
+    kj::Promise<void> promise = nullptr;
+    if (morePieces.size() == 0) {
+      promise = output.write(unread.begin(), unread.size());
+    } else {
+      // Write all the pieces in one go; they stay alive as long as `ownBytes`, i.e. as long as
+      // this stream.
+      auto pieces = kj::heapArrayBuilder<kj::ArrayPtr<const byte>>(morePieces.size() + 1);
+      pieces.add(unread);
+      pieces.addAll(morePieces);
+      auto array = pieces.finish();
+      promise = output.write(array).attach(kj::mv(array));
+    }
     unread = nullptr;
+    morePieces = nullptr;
 
     if (end) {
       promise = promise.then([&output]() { return output.end(); });
@@ -462,9 +502,90 @@ public:
 
 private:
   kj::ArrayPtr<const byte> unread;
-  kj::OneOf<kj::Own<Body::RefcountedBytes>, jsg::Ref<Blob>> ownBytes;
+  kj::ArrayPtr<const kj::ArrayPtr<const byte>> morePieces;
+  // For a multi-piece buffer, the pieces after `unread`.
+
+  kj::OneOf<kj::Own<Body::RefcountedBytes>, jsg::Ref<Blob>, kj::Own<FormData::Serialized>>
+      ownBytes;
+
+  void nextPiece() {
+    // Advance `unread` to the next non-empty piece, if any.
+    while (unread.size() == 0 && morePieces.size() > 0) {
+      unread = morePieces[0];
+      morePieces = morePieces.slice(1, morePieces.size());
+    }
+  }
+};
+
+class SpoolOutputStream final: public kj::AsyncOutputStream {
+  // Appends everything written to it to a spool file, up to `limit` bytes.
+
+public:
+  SpoolOutputStream(const kj::File& file, size_t limit): file(file), limit(limit) {}
+
+  kj::Promise<void> write(const void* buffer, size_t size) override {
+    JSG_REQUIRE(size <= limit - offset, TypeError, "Memory limit exceeded before EOF.");
+    file.write(offset, kj::arrayPtr(reinterpret_cast<const byte*>(buffer), size));
+    offset += size;
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
+    for (auto piece: pieces) {
+      // Synchronous, so the returned promise is always ready.
+      write(piece.begin(), piece.size());
+    }
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> whenWriteDisconnected() override {
+    return kj::NEVER_DONE;
+  }
+
+private:
+  const kj::File& file;
+  size_t limit;
+  uint64_t offset = 0;
 };
 
+constexpr uint64_t MIN_SPOOL_SIZE = 1024 * 1024;
+// Bodies known to be smaller than this are buffered in memory even if they could be spooled: a
+// file and a mapping per body isn't worth it for them.
+
+jsg::Promise<kj::Own<Blob::Buffer>> readAllToBuffer(jsg::Lock& js, ReadableStream& stream) {
+  // Reads all of `stream`, spooling it to a memory-mapped temporary file rather than buffering
+  // it on the heap if it's large (or of unknown length) and the Worker has a spool directory.
+
+  auto& context = IoContext::current();
+  auto limit = context.getLimitEnforcer().getBufferingLimit();
+
+  auto length = stream.tryGetLength(StreamEncoding::IDENTITY);
+  bool small = length.map([](uint64_t l) { return l < MIN_SPOOL_SIZE; }).orDefault(false);
+  if (!small) {
+    KJ_IF_MAYBE(file, context.newSpoolFile()) {
+      auto sink = newSystemStream(kj::heap<SpoolOutputStream>(**file, limit),
+                                  StreamEncoding::IDENTITY, context);
+      return context.awaitIo(js,
+          context.waitForDeferredProxy(stream.pumpTo(js, kj::mv(sink), true)),
+          [file = kj::mv(*file)](jsg::Lock& js) mutable {
+        auto size = file->stat().size;
+        kj::Array<const byte> mapping;
+        if (size > 0) {
+          // The mapping is read-only and backed by the file, so its pages are only resident once
+          // read, and can be dropped again under memory pressure.
+          mapping = file->mmap(0, size);
+        }
+        return kj::refcounted<Blob::Buffer>(kj::mv(mapping));
+      });
+    }
+  }
+
+  return stream.getController().readAllBytes(js, limit)
+      .then(js, [](jsg::Lock& js, kj::Array<byte> bytes) {
+    return kj::refcounted<Blob::Buffer>(kj::mv(bytes));
+  });
+}
+
 }  // namespace
 
 kj::String makeRandomBoundaryCharacters() {
@@ -490,10 +611,20 @@ Body::Buffer Body::Buffer::clone(jsg::Lock& js) {
     KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
       result.ownBytes = blob.addRef();
     }
+    KJ_CASE_ONEOF(formData, kj::Own<FormData::Serialized>) {
+      result.ownBytes = kj::addRef(*formData);
+    }
   }
   return result;
 }
 
+uint64_t Body::Buffer::size() const {
+  KJ_IF_MAYBE(formData, ownBytes.tryGet<kj::Own<FormData::Serialized>>()) {
+    return (*formData)->size;
+  }
+  return view.size();
+}
+
 Body::ExtractedBody::ExtractedBody(jsg::Ref<ReadableStream> stream,
                                    kj::Maybe<Buffer> buffer,
                                    kj::Maybe<kj::String> contentType)
@@ -685,11 +816,9 @@ jsg::Promise<jsg::Ref<FormData>> Body::formData(jsg::Lock& js) {
 
     KJ_IF_MAYBE(i, impl) {
       KJ_ASSERT(!i->stream->isDisturbed());
-      auto& context = IoContext::current();
-      return i->stream->getController().readAllText(js,
-          context.getLimitEnforcer().getBufferingLimit()).then(js,
+      return readAllToBuffer(js, *i->stream).then(js,
           [contentType = kj::mv(contentType), formData = kj::mv(formData)]
-          (auto& js, kj::String rawText) mutable {
+          (auto& js, kj::Own<Blob::Buffer> rawText) mutable {
         formData->parse(kj::mv(rawText), contentType,
             !FeatureFlags::get(js).getFormDataParserSupportsFiles());
         return kj::mv(formData);
@@ -699,7 +828,7 @@ jsg::Promise<jsg::Ref<FormData>> Body::formData(jsg::Lock& js) {
     // Theoretically, we already know if this will throw: the empty string is a valid
     // application/x-www-form-urlencoded body, but not multipart/form-data. However, best to let
     // FormData::parse() make the decision, to keep the logic in one place.
-    formData->parse(kj::String(), contentType,
+    formData->parse(kj::refcounted<Blob::Buffer>(nullptr), contentType,
         !FeatureFlags::get(js).getFormDataParserSupportsFiles());
     return js.resolvedPromise(kj::mv(formData));
   });
@@ -712,13 +841,26 @@ jsg::Promise<jsg::Value> Body::json(jsg::Lock& js) {
 }
 
 jsg::Promise<jsg::Ref<Blob>> Body::blob(jsg::Lock& js) {
-  return arrayBuffer(js).then([this](kj::Array<byte> buffer) {
+  auto makeBlob = [this](kj::Own<Blob::Buffer> buffer) {
     kj::String contentType =
         headersRef.get(jsg::ByteString(kj::str("Content-Type")))
             .map([](jsg::ByteString&& b) -> kj::String { return kj::mv(b); })
             .orDefault(nullptr);
     return jsg::alloc<Blob>(kj::mv(buffer), kj::mv(contentType));
-  });
+  };
+
+  KJ_IF_MAYBE(i, impl) {
+    return js.evalNow([&] {
+      JSG_REQUIRE(!i->stream->isDisturbed(), TypeError, "Body has already been used. "
+          "It can only be used once. Use tee() first if you need to read it twice.");
+      return readAllToBuffer(js, *i->stream).then(js,
+          [makeBlob](jsg::Lock&, kj::Own<Blob::Buffer> buffer) {
+        return makeBlob(kj::mv(buffer));
+      });
+    });
+  }
+
+  return js.resolvedPromise(makeBlob(kj::refcounted<Blob::Buffer>(nullptr)));
 }
 
 kj::Maybe<Body::ExtractedBody> Body::clone(jsg::Lock& js) {
@@ -1145,7 +1287,7 @@ jsg::Ref<Response> Response::constructor(
           "Response with null body status (101, 204, 205, or 304) cannot have a body.");
 
       // Fail if the body is backed by a non-zero-length buffer.
-      JSG_REQUIRE(buffer.view.size() == 0, TypeError,
+      JSG_REQUIRE(buffer.size() == 0, TypeError,
           "Response with null body status (101, 204, 205, or 304) cannot have a body.");
 
       auto& context = IoContext::current();
@@ -1330,11 +1472,13 @@ kj::Promise<DeferredProxy<void>> Response::send(
         // This allows us to `optimizedPumpTo()` `webSocket`.
         outHeaders.set(kj::HttpHeaderId::SEC_WEBSOCKET_EXTENSIONS, *config);
       } else {
-        // `webSocket` is not a WebSocketImpl, we want to support whatever valid config the client
-        // requested, so we'll just use the client's requested headers.
+        // `webSocket` is not a WebSocketImpl (e.g. it's one end of a WebSocketPair), so we accept
+        // the first permessage-deflate offer in the client's request that we can honor.
         KJ_IF_MAYBE(reqHeaders, maybeReqHeaders) {
-          KJ_IF_MAYBE(value, reqHeaders->get(kj::HttpHeaderId::SEC_WEBSOCKET_EXTENSIONS)) {
-            outHeaders.set(kj::HttpHeaderId::SEC_WEBSOCKET_EXTENSIONS, *value);
+          KJ_IF_MAYBE(offers, reqHeaders->get(kj::HttpHeaderId::SEC_WEBSOCKET_EXTENSIONS)) {
+            KJ_IF_MAYBE(agreement, selectWebSocketCompression(*offers)) {
+              outHeaders.set(kj::HttpHeaderId::SEC_WEBSOCKET_EXTENSIONS, kj::mv(*agreement));
+            }
           }
         }
       }
@@ -1494,6 +1638,163 @@ public:
   }
 };
 
+class BufferedRequestBody final: public kj::AsyncInputStream {
+  // A request body read straight out of the Request's buffer. See requestDirectly().
+public:
+  BufferedRequestBody(kj::Own<Body::RefcountedBytes> bytes, kj::ArrayPtr<const byte> view)
+      : bytes(kj::mv(bytes)), unread(view) {}
+
+  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    size_t amount = kj::min(maxBytes, unread.size());
+    memcpy(buffer, unread.begin(), amount);
+    unread = unread.slice(amount, unread.size());
+    return amount;
+  }
+
+  kj::Maybe<uint64_t> tryGetLength() override {
+    return uint64_t(unread.size());
+  }
+
+  kj::Promise<uint64_t> pumpTo(kj::AsyncOutputStream& output, uint64_t amount) override {
+    auto chunk = unread.slice(0, kj::min(amount, unread.size()));
+    unread = unread.slice(chunk.size(), unread.size());
+    return output.write(chunk.begin(), chunk.size()).then([size = chunk.size()]() -> uint64_t {
+      return size;
+    });
+  }
+
+private:
+  kj::Own<Body::RefcountedBytes> bytes;
+  kj::ArrayPtr<const byte> unread;
+};
+
+class DirectResponse final: public kj::HttpService::Response, public kj::Refcounted {
+  // Receives the response to a request made with requestDirectly(), and hands it to the caller in
+  // the same form as kj::HttpClient would.
+public:
+  DirectResponse(kj::Own<kj::PromiseFulfiller<kj::HttpClient::Response>> fulfiller)
+      : fulfiller(kj::mv(fulfiller)) {
+    // The service may send its response before request() even returns, so the task must exist
+    // before we know its promise.
+    auto paf = kj::newPromiseAndFulfiller<kj::Promise<void>>();
+    taskFulfiller = kj::mv(paf.fulfiller);
+    task = paf.promise.then([this]() {
+      if (fulfiller->isWaiting()) {
+        fulfiller->reject(KJ_EXCEPTION(FAILED, "service returned without sending a response"));
+      }
+    }, [this](kj::Exception&& exception) {
+      if (fulfiller->isWaiting()) {
+        fulfiller->reject(kj::cp(exception));
+      }
+      kj::throwFatalException(kj::mv(exception));
+    }).fork();
+  }
+
+  void setTask(kj::Promise<void> promise) {
+    // `promise` is the service's request(). It keeps running after the response is sent, for as
+    // long as the caller holds on to the response body.
+    taskFulfiller->fulfill(kj::mv(promise));
+  }
+
+  kj::Own<kj::AsyncOutputStream> send(
+      uint statusCode, kj::StringPtr statusText, const kj::HttpHeaders& headers,
+      kj::Maybe<uint64_t> expectedBodySize) override {
+    KJ_REQUIRE(fulfiller->isWaiting(), "response already sent");
+
+    auto ownStatusText = kj::str(statusText);
+    auto ownHeaders = kj::heap(headers.clone());
+    auto pipe = kj::newOneWayPipe(expectedBodySize);
+    auto body = kj::heap<ResponseBody>(kj::mv(pipe.in), task.addBranch());
+    fulfiller->fulfill(kj::HttpClient::Response {
+      statusCode, ownStatusText, ownHeaders.get(),
+      body.attach(kj::mv(ownStatusText), kj::mv(ownHeaders), kj::addRef(*this))
+    });
+    return kj::mv(pipe.out);
+  }
+
+  kj::Own<kj::WebSocket> acceptWebSocket(const kj::HttpHeaders& headers) override {
+    // requestDirectly() isn't used for WebSocket requests.
+    KJ_FAIL_REQUIRE("service accepted a WebSocket for a request that didn't ask for one");
+  }
+
+private:
+  kj::Own<kj::PromiseFulfiller<kj::HttpClient::Response>> fulfiller;
+  kj::Own<kj::PromiseFulfiller<kj::Promise<void>>> taskFulfiller;
+  kj::ForkedPromise<void> task = nullptr;
+
+  class ResponseBody final: public kj::AsyncInputStream {
+    // Reports EOF only once the service's request() has completed, so that an error it throws
+    // after writing the body still reaches the reader.
+  public:
+    ResponseBody(kj::Own<kj::AsyncInputStream> inner, kj::Promise<void> done)
+        : inner(kj::mv(inner)), done(kj::mv(done)) {}
+
+    kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+      return inner->tryRead(buffer, minBytes, maxBytes)
+          .then([this, minBytes](size_t amount) -> kj::Promise<size_t> {
+        if (amount < minBytes) {
+          KJ_IF_MAYBE(d, done) {
+            auto promise = kj::mv(*d);
+            done = nullptr;
+            return promise.then([amount]() { return amount; });
+          }
+        }
+        return amount;
+      });
+    }
+
+    kj::Maybe<uint64_t> tryGetLength() override {
+      return inner->tryGetLength();
+    }
+
+  private:
+    kj::Own<kj::AsyncInputStream> inner;
+    kj::Maybe<kj::Promise<void>> done;
+  };
+};
+
+kj::Promise<kj::HttpClient::Response> requestDirectly(
+    kj::Own<WorkerInterface> worker, kj::HttpMethod method, kj::String url,
+    kj::Own<kj::HttpHeaders> headers, kj::Own<kj::AsyncInputStream> body) {
+  // Sends a request by calling the service's request() directly. The kj::HttpClient adapter from
+  // asHttpClient() would instead hand the service one end of a pipe, and make us pump the request
+  // body into the other end from a separate task.
+  auto paf = kj::newPromiseAndFulfiller<kj::HttpClient::Response>();
+  auto responder = kj::refcounted<DirectResponse>(kj::mv(paf.fulfiller));
+  auto promise = kj::evalNow([&]() {
+    return worker->request(method, url, *headers, *body, *responder);
+  });
+  responder->setTask(promise.attach(kj::mv(worker), kj::mv(url), kj::mv(headers), kj::mv(body)));
+  return paf.promise.attach(kj::mv(responder));
+}
+
+kj::Maybe<kj::Own<kj::AsyncInputStream>> tryGetDirectRequestBody(
+    jsg::Lock& js, Request& jsRequest) {
+  // Returns the request body as a stream the service can read directly, if the request can use
+  // requestDirectly(): that is, if it's not a HEAD request (for which kj::HttpClient has special
+  // response handling) and its body is either null or backed by bytes we already hold.
+  if (jsRequest.getMethodEnum() == kj::HttpMethod::HEAD) return nullptr;
+
+  KJ_IF_MAYBE(stream, jsRequest.getBody()) {
+    if ((*stream)->isDisturbed() || (*stream)->isLocked()) {
+      // Let the regular path report the error.
+      return nullptr;
+    }
+    auto maybeBuffer = jsRequest.getBodyBuffer(js);
+    auto& buffer = KJ_UNWRAP_OR(maybeBuffer, return nullptr);
+    KJ_IF_MAYBE(bytes, buffer.ownBytes.tryGet<kj::Own<Body::RefcountedBytes>>()) {
+      // Leave the stream disturbed, as if we had read it.
+      (*stream)->detach(js);
+      return kj::Own<kj::AsyncInputStream>(
+          kj::heap<BufferedRequestBody>(kj::mv(*bytes), buffer.view));
+    }
+    // Blobs and FormData are backed by JavaScript objects, which can't leave the isolate lock.
+    return nullptr;
+  } else {
+    return kj::Own<kj::AsyncInputStream>(kj::heap<NullInputStream>());
+  }
+}
+
 constexpr auto MAX_REDIRECT_COUNT = 20;
 // Fetch spec requires (suggests?) 20: https://fetch.spec.whatwg.org/#http-redirect-fetch
 
@@ -1544,10 +1845,8 @@ jsg::Promise<jsg::Ref<Response>> fetchImplNoOutputLock(
     }
   }
 
-  // TODO(cleanup): Don't convert to HttpClient. Use the HttpService interface instead. This
-  //   requires a significant rewrite of the code below. It'll probably get simpler, though?
-  kj::Own<kj::HttpClient> client = asHttpClient(fetcher->getClient(
-      ioContext, jsRequest->serializeCfBlobJson(js), "fetch"_kjc));
+  kj::Own<WorkerInterface> worker = fetcher->getClient(
+      ioContext, jsRequest->serializeCfBlobJson(js), "fetch"_kjc);
 
   kj::HttpHeaders headers(ioContext.getHeaderTable());
   jsRequest->shallowCopyHeadersTo(headers);
@@ -1555,7 +1854,26 @@ jsg::Promise<jsg::Ref<Response>> fetchImplNoOutputLock(
   kj::String url = uriEncodeControlChars(
       urlList.back().toString(kj::Url::HTTP_PROXY_REQUEST).asBytes());
 
+  KJ_IF_MAYBE(jsBody, jsRequest->getBody()) {
+    // Note that for requests, we do not automatically handle Content-Encoding, because the fetch()
+    // standard does not say that we should. Hence, we always use StreamEncoding::IDENTITY.
+    // https://github.com/whatwg/fetch/issues/589
+    if (!headers.isWebSocket() &&
+        (*jsBody)->tryGetLength(StreamEncoding::IDENTITY).orDefault(1) == 0 &&
+        headers.get(kj::HttpHeaderId::CONTENT_LENGTH) == nullptr &&
+        headers.get(kj::HttpHeaderId::TRANSFER_ENCODING) == nullptr) {
+      // Request has a non-null but explicitly empty body, and has neither a Content-Length nor
+      // a Transfer-Encoding header. If we don't set one of those two, and the receiving end is
+      // another worker (especially within a pipeline or reached via RPC, not real HTTP), then
+      // the code in global-scope.c++ on the receiving end will decide the body should be null.
+      // We'd like to avoid this weird discontinuity, so let's set Content-Length explicitly to
+      // 0.
+      headers.set(kj::HttpHeaderId::CONTENT_LENGTH, "0"_kj);
+    }
+  }
+
   if (headers.isWebSocket()) {
+    kj::Own<kj::HttpClient> client = asHttpClient(kj::mv(worker));
     if (!FeatureFlags::get(js).getWebSocketCompression()) {
       // If we haven't enabled the websocket compression compatibility flag, strip the header from the
       // subrequest.
@@ -1596,26 +1914,27 @@ jsg::Promise<jsg::Ref<Response>> fetchImplNoOutputLock(
       }
       KJ_UNREACHABLE;
     });
+  } else KJ_IF_MAYBE(body, tryGetDirectRequestBody(js, *jsRequest)) {
+    // Most requests, e.g. those to other Workers over service bindings, carry no body or one we
+    // already hold in memory, so the service can read it directly.
+    auto response = requestDirectly(kj::mv(worker), jsRequest->getMethodEnum(), kj::mv(url),
+                                    kj::heap(headers.clone()), kj::mv(*body));
+    return ioContext.awaitIo(js,
+        AbortSignal::maybeCancelWrap(signal, kj::mv(response)),
+        [fetcher = kj::mv(fetcher), jsRequest = kj::mv(jsRequest), urlList = kj::mv(urlList)]
+        (jsg::Lock& js, kj::HttpClient::Response&& response) mutable
+            -> jsg::Promise<jsg::Ref<Response>> {
+      return handleHttpResponse(
+          js, kj::mv(fetcher), kj::mv(jsRequest), kj::mv(urlList), kj::mv(response));
+    });
   } else {
+    // TODO(cleanup): Use requestDirectly() for streamed bodies too. That requires pumping the
+    //   body into a stream the service reads from, which is what kj::HttpClient's pipe does.
+    kj::Own<kj::HttpClient> client = asHttpClient(kj::mv(worker));
     kj::Maybe<kj::HttpClient::Request> nativeRequest;
     KJ_IF_MAYBE(jsBody, jsRequest->getBody()) {
-      // Note that for requests, we do not automatically handle Content-Encoding, because the fetch()
-      // standard does not say that we should. Hence, we always use StreamEncoding::IDENTITY.
-      // https://github.com/whatwg/fetch/issues/589
       auto maybeLength = (*jsBody)->tryGetLength(StreamEncoding::IDENTITY);
 
-      if (maybeLength.orDefault(1) == 0 &&
-          headers.get(kj::HttpHeaderId::CONTENT_LENGTH) == nullptr &&
-          headers.get(kj::HttpHeaderId::TRANSFER_ENCODING) == nullptr) {
-        // Request has a non-null but explicitly empty body, and has neither a Content-Length nor
-        // a Transfer-Encoding header. If we don't set one of those two, and the receiving end is
-        // another worker (especially within a pipeline or reached via RPC, not real HTTP), then
-        // the code in global-scope.c++ on the receiving end will decide the body should be null.
-        // We'd like to avoid this weird discontinuity, so let's set Content-Length explicitly to
-        // 0.
-        headers.set(kj::HttpHeaderId::CONTENT_LENGTH, "0"_kj);
-      }
-
       nativeRequest = client->request(jsRequest->getMethodEnum(), url, headers, maybeLength);
       auto& nr = KJ_ASSERT_NONNULL(nativeRequest);
       auto stream = newSystemStream(kj::mv(nr.body), StreamEncoding::IDENTITY);
@@ -172,8 +172,21 @@ private:
     }
   };
 
+  struct HeaderMap final: public kj::Refcounted {
+    std::map<kj::StringPtr, Header> entries;
+    // Keyed by `Header::key`.
+
+    kj::Own<HeaderMap> clone() const;
+  };
+
   Guard guard;
-  std::map<kj::StringPtr, Header> headers;
+  kj::Own<HeaderMap> headers = kj::refcounted<HeaderMap>();
+  // Copying a Headers object -- which happens whenever a Request or Response is constructed from
+  // another, or passed to fetch() -- shares the map rather than copying every string in it. The
+  // map is copied only if one of the sharers then modifies it, which is rare. Always go through
+  // mutableHeaders() to modify it.
+
+  std::map<kj::StringPtr, Header>& mutableHeaders();
 
   void checkGuard() {
     JSG_REQUIRE(guard == Guard::NONE, TypeError, "Can't modify immutable headers.");
@@ -231,7 +244,7 @@ public:
     //
     // I find that confusing, so let's just call it what it is: a Body::Buffer.
 
-    kj::OneOf<kj::Own<RefcountedBytes>, jsg::Ref<Blob>> ownBytes;
+    kj::OneOf<kj::Own<RefcountedBytes>, jsg::Ref<Blob>, kj::Own<FormData::Serialized>> ownBytes;
     // In order to reconstruct buffer-backed ReadableStreams without gratuitous array copying, we
     // need to be able to tie the lifetime of the source buffer to the lifetime of the
     // ReadableStream's native stream, AND the lifetime of the Body itself. Thus we need
@@ -247,6 +260,9 @@ public:
     // (e.g. for redirects, authentication). In these cases, we need to keep an ArrayPtr view onto
     // the Array source itself, because the source may be a string, and thus have a trailing nul
     // byte.
+    //
+    // For a serialized FormData, the body isn't contiguous: `view` is empty and the body is
+    // `FormData::Serialized::pieces` instead. Use `size()` rather than `view.size()`.
 
     Buffer() = default;
     Buffer(kj::Array<kj::byte> array)
@@ -261,6 +277,10 @@ public:
     Buffer(jsg::Ref<Blob> blob)
         : ownBytes(kj::mv(blob)),
           view(ownBytes.get<jsg::Ref<Blob>>()->getData()) {}
+    Buffer(kj::Own<FormData::Serialized> formData)
+        : ownBytes(kj::mv(formData)) {}
+
+    uint64_t size() const;
 
     Buffer clone(jsg::Lock& js);
   };
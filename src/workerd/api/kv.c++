@@ -105,17 +105,51 @@ kj::Own<kj::HttpClient> KvNamespace::getHttpClient(
 
 
 jsg::Promise<KvNamespace::GetResult> KvNamespace::get(
-    jsg::Lock& js, kj::String name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options,
+    jsg::Lock& js, GetKeys name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options,
     CompatibilityFlags::Reader flags) {
   return js.evalNow([&] {
-    auto resp = getWithMetadata(js, kj::mv(name), kj::mv(options));
-    return resp.then([](KvNamespace::GetWithMetadataResult result) {
-      return kj::mv(result.value);
-    });
+    KJ_SWITCH_ONEOF(name) {
+      KJ_CASE_ONEOF(names, kj::Array<kj::String>) {
+        auto resp = getBulk(js, kj::mv(names), kj::mv(options), false);
+        return resp.then([](jsg::Value map) {
+          return KvNamespace::GetResult(kj::mv(map));
+        });
+      }
+      KJ_CASE_ONEOF(n, kj::String) {
+        auto resp = getSingle(js, kj::mv(n), kj::mv(options));
+        return resp.then([](KvNamespace::GetWithMetadataResult result) {
+          return kj::mv(result.value);
+        });
+      }
+    }
+    KJ_UNREACHABLE;
+  });
+}
+
+jsg::Promise<kj::OneOf<KvNamespace::GetWithMetadataResult, jsg::Value>>
+    KvNamespace::getWithMetadata(
+    jsg::Lock& js, GetKeys name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options) {
+  using Result = kj::OneOf<KvNamespace::GetWithMetadataResult, jsg::Value>;
+  return js.evalNow([&] {
+    KJ_SWITCH_ONEOF(name) {
+      KJ_CASE_ONEOF(names, kj::Array<kj::String>) {
+        auto resp = getBulk(js, kj::mv(names), kj::mv(options), true);
+        return resp.then([](jsg::Value map) {
+          return Result(kj::mv(map));
+        });
+      }
+      KJ_CASE_ONEOF(n, kj::String) {
+        auto resp = getSingle(js, kj::mv(n), kj::mv(options));
+        return resp.then([](KvNamespace::GetWithMetadataResult result) {
+          return Result(kj::mv(result));
+        });
+      }
+    }
+    KJ_UNREACHABLE;
   });
 }
 
-jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
+jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getSingle(
     jsg::Lock& js, kj::String name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options) {
   validateKeyName("GET", name);
 
@@ -128,6 +162,7 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
   url.query.add(kj::Url::QueryParam { kj::str("urlencoded"), kj::str("true") });
 
   kj::Maybe<kj::String> type;
+  kj::Maybe<int> cacheTtl;
   KJ_IF_MAYBE(oneOfOptions, options) {
     KJ_SWITCH_ONEOF(*oneOfOptions) {
       KJ_CASE_ONEOF(t, kj::String) {
@@ -137,8 +172,9 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
         KJ_IF_MAYBE(t, options.type) {
           type = kj::mv(*t);
         }
-        KJ_IF_MAYBE(cacheTtl, options.cacheTtl) {
-          url.query.add(kj::Url::QueryParam { kj::str("cache_ttl"), kj::str(*cacheTtl) });
+        KJ_IF_MAYBE(ttl, options.cacheTtl) {
+          url.query.add(kj::Url::QueryParam { kj::str("cache_ttl"), kj::str(*ttl) });
+          cacheTtl = *ttl;
         }
       }
     }
@@ -146,6 +182,16 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
 
   auto urlStr = url.toString(kj::Url::Context::HTTP_PROXY_REQUEST);
 
+  KJ_IF_MAYBE(c, cache) {
+    auto typeName = type.map([](kj::String& s) { return kj::mv(s); }).orDefault(kj::str("text"));
+    JSG_REQUIRE(typeName == "stream" || typeName == "text" || typeName == "arrayBuffer" ||
+                typeName == "json", TypeError,
+        "Unknown response type. Possible types are \"text\", \"arrayBuffer\", "
+        "\"json\", and \"stream\".");
+    return getWithMetadataCached(js, *c, kj::mv(url.path.back()), kj::mv(urlStr),
+                                 kj::mv(typeName), cacheTtl);
+  }
+
   auto headers = kj::HttpHeaders(context.getHeaderTable());
   auto client = getHttpClient(context, headers, LimitEnforcer::KvOpType::GET, urlStr);
 
@@ -226,6 +272,249 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
   });
 }
 
+static jsg::Value bulkResultToMap(jsg::Lock& js, v8::Local<v8::Value> response,
+                                  kj::ArrayPtr<const kj::String> names, bool withMetadata) {
+  auto isolate = js.v8Isolate;
+  v8::HandleScope handleScope(isolate);
+  auto context = js.v8Context();
+
+  JSG_REQUIRE(response->IsObject(), Error,
+      "KV GET_BULK failed: the namespace returned a malformed response.");
+  auto obj = response.As<v8::Object>();
+  auto valueName = jsg::v8StrIntern(isolate, "value"_kj);
+  auto metaName = jsg::v8StrIntern(isolate, "metadata"_kj);
+
+  auto orNull = [&](v8::Local<v8::Value> value) -> v8::Local<v8::Value> {
+    return value->IsUndefined() ? v8::Null(isolate).As<v8::Value>() : value;
+  };
+
+  // Build the Map in the order the keys were asked for, with an entry for each one, like the
+  // equivalent single-key get()s would have produced.
+  auto map = v8::Map::New(isolate);
+  for (auto& name: names) {
+    v8::HandleScope handleScope(isolate);
+    auto key = jsg::v8Str(isolate, name);
+    v8::Local<v8::Value> value = jsg::check(obj->Get(context, key));
+    if (withMetadata) {
+      // Each key that exists maps to `{ value, metadata }`; a missing one gets the same shape
+      // with both null, as getWithMetadata() of that key alone would return.
+      v8::Local<v8::Value> entryValue = v8::Null(isolate);
+      v8::Local<v8::Value> entryMeta = v8::Null(isolate);
+      if (!value->IsUndefined() && !value->IsNull()) {
+        JSG_REQUIRE(value->IsObject(), Error,
+            "KV GET_BULK failed: the namespace returned a malformed response.");
+        auto found = value.As<v8::Object>();
+        entryValue = orNull(jsg::check(found->Get(context, valueName)));
+        entryMeta = orNull(jsg::check(found->Get(context, metaName)));
+      }
+      auto entry = v8::Object::New(isolate);
+      jsg::check(entry->Set(context, valueName, entryValue));
+      jsg::check(entry->Set(context, metaName, entryMeta));
+      value = entry;
+    } else {
+      // Each key that exists maps to its value as is, which for "json" may itself be an object.
+      value = orNull(value);
+    }
+    jsg::check(map->Set(context, key, value));
+  }
+
+  return jsg::Value(isolate, map);
+}
+
+jsg::Promise<jsg::Value> KvNamespace::getBulk(
+    jsg::Lock& js, kj::Array<kj::String> names,
+    jsg::Optional<kj::OneOf<kj::String, GetOptions>> options, bool withMetadata) {
+  JSG_REQUIRE(names.size() > 0, TypeError, "KV GET_BULK failed: no keys were given.");
+  JSG_REQUIRE(names.size() <= MAX_BULK_KEYS, RangeError,
+      "KV GET_BULK failed: at most ", MAX_BULK_KEYS, " keys may be read at once.");
+  for (auto& name: names) {
+    validateKeyName("GET_BULK", name);
+  }
+
+  auto& context = IoContext::current();
+
+  kj::StringPtr type = "text";
+  kj::Maybe<int> cacheTtl;
+  KJ_IF_MAYBE(oneOfOptions, options) {
+    KJ_SWITCH_ONEOF(*oneOfOptions) {
+      KJ_CASE_ONEOF(t, kj::String) {
+        type = t;
+      }
+      KJ_CASE_ONEOF(options, GetOptions) {
+        KJ_IF_MAYBE(t, options.type) {
+          type = *t;
+        }
+        cacheTtl = options.cacheTtl;
+      }
+    }
+  }
+  JSG_REQUIRE(type == "text" || type == "json", TypeError,
+      "Bulk KV reads only support the \"text\" and \"json\" types.");
+
+  kj::String body;
+  {
+    auto isolate = js.v8Isolate;
+    v8::HandleScope handleScope(isolate);
+    auto v8Context = js.v8Context();
+    auto keys = v8::Array::New(isolate, names.size());
+    for (auto i: kj::indices(names)) {
+      jsg::check(keys->Set(v8Context, i, jsg::v8Str(isolate, names[i])));
+    }
+    auto request = v8::Object::New(isolate);
+    jsg::check(request->Set(v8Context, jsg::v8StrIntern(isolate, "keys"_kj), keys));
+    jsg::check(request->Set(v8Context, jsg::v8StrIntern(isolate, "type"_kj),
+        jsg::v8Str(isolate, type)));
+    jsg::check(request->Set(v8Context, jsg::v8StrIntern(isolate, "withMetadata"_kj),
+        v8::Boolean::New(isolate, withMetadata)));
+    KJ_IF_MAYBE(ttl, cacheTtl) {
+      jsg::check(request->Set(v8Context, jsg::v8StrIntern(isolate, "cacheTtl"_kj),
+          v8::Integer::New(isolate, *ttl)));
+    }
+    body = js.serializeJson(request);
+  }
+
+  auto urlStr = kj::str("https://fake-host/bulk/get");
+
+  auto headers = kj::HttpHeaders(context.getHeaderTable());
+  headers.set(kj::HttpHeaderId::CONTENT_TYPE, "application/json");
+  auto client = getHttpClient(context, headers, LimitEnforcer::KvOpType::GET, urlStr);
+
+  auto request = client->request(kj::HttpMethod::POST, urlStr, headers, uint64_t(body.size()));
+  auto writePromise = request.body->write(body.begin(), body.size())
+      .attach(kj::mv(body), kj::mv(request.body));
+  auto responsePromise = writePromise.then([response = kj::mv(request.response)]() mutable {
+    return kj::mv(response);
+  });
+
+  return context.awaitIo(js, kj::mv(responsePromise),
+      [&context, client = kj::mv(client), names = kj::mv(names), withMetadata,
+       urlStr = kj::mv(urlStr)]
+      (jsg::Lock& js, kj::HttpClient::Response&& response) mutable -> jsg::Promise<jsg::Value> {
+    checkForErrorStatus("GET_BULK", response);
+
+    auto stream = newSystemStream(
+        response.body.attach(kj::mv(client)), getContentEncoding(context, *response.headers,
+            Response::BodyEncoding::AUTO, FeatureFlags::get(js)));
+
+    return context.awaitIo(js,
+        stream->readAllText(context.getLimitEnforcer().getBufferingLimit())
+            .attach(kj::mv(stream)),
+        [names = kj::mv(names), withMetadata](jsg::Lock& js, kj::String text) {
+      auto result = js.parseJson(text);
+      return bulkResultToMap(js, result.getHandle(js.v8Isolate), names, withMetadata);
+    });
+  });
+}
+
+namespace {
+
+class CachedValueInputStream final: public kj::AsyncInputStream {
+  // Reads a value straight out of the cache.
+
+public:
+  explicit CachedValueInputStream(kj::Own<KvCache::Value> value)
+      : value(kj::mv(value)), remaining(KJ_ASSERT_NONNULL(this->value->body)) {}
+
+  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    size_t n = kj::min(maxBytes, remaining.size());
+    memcpy(buffer, remaining.begin(), n);
+    remaining = remaining.slice(n, remaining.size());
+    return n;
+  }
+
+  kj::Maybe<uint64_t> tryGetLength() override { return remaining.size(); }
+
+private:
+  kj::Own<KvCache::Value> value;
+  kj::ArrayPtr<const kj::byte> remaining;
+};
+
+KvNamespace::GetWithMetadataResult makeCachedResult(
+    jsg::Lock& js, kj::StringPtr typeName, kj::Own<KvCache::Value> value) {
+  kj::Maybe<jsg::Value> meta;
+  KJ_IF_MAYBE(metaStr, value->metadata) {
+    meta = js.parseJson(*metaStr);
+  }
+
+  KvNamespace::GetResult result;
+  KJ_IF_MAYBE(body, value->body) {
+    if (typeName == "stream") {
+      auto& context = IoContext::current();
+      result = jsg::alloc<ReadableStream>(context, newSystemStream(
+          kj::heap<CachedValueInputStream>(kj::mv(value)), StreamEncoding::IDENTITY, context));
+    } else if (typeName == "text") {
+      result = kj::str(body->asChars());
+    } else if (typeName == "arrayBuffer") {
+      result = kj::heapArray<kj::byte>(*body);
+    } else if (typeName == "json") {
+      result = js.parseJson(kj::str(body->asChars()));
+    } else {
+      KJ_UNREACHABLE;  // checked by getWithMetadata()
+    }
+  }
+
+  return KvNamespace::GetWithMetadataResult { kj::mv(result), kj::mv(meta) };
+}
+
+}  // namespace
+
+jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadataCached(
+    jsg::Lock& js, KvCache& cache, kj::String name, kj::String urlStr, kj::String typeName,
+    kj::Maybe<int> cacheTtl) {
+  // Unlike the uncached path, the value is always buffered in full, since it's going to be
+  // stored anyway; a "stream" result then reads from the stored copy.
+  auto& context = IoContext::current();
+  return context.awaitIo(js, cache.lookup(name),
+      [self = JSG_THIS, urlStr = kj::mv(urlStr), typeName = kj::mv(typeName), cacheTtl]
+          (jsg::Lock& js, KvCache::Lookup lookup) mutable
+          -> jsg::Promise<KvNamespace::GetWithMetadataResult> {
+    KJ_SWITCH_ONEOF(lookup) {
+      KJ_CASE_ONEOF(value, kj::Own<KvCache::Value>) {
+        return js.resolvedPromise(makeCachedResult(js, typeName, kj::mv(value)));
+      }
+      KJ_CASE_ONEOF(fill, kj::Own<KvCache::Fill>) {
+        auto& context = IoContext::current();
+        auto headers = kj::HttpHeaders(context.getHeaderTable());
+        auto client = self->getHttpClient(context, headers, LimitEnforcer::KvOpType::GET, urlStr);
+        auto request = client->request(kj::HttpMethod::GET, urlStr, headers);
+
+        auto promise = request.response.then(
+            [&context, client = kj::mv(client), flags = FeatureFlags::get(js),
+             limit = context.getLimitEnforcer().getBufferingLimit()]
+            (kj::HttpClient::Response&& response) mutable -> kj::Promise<kj::Own<KvCache::Value>> {
+          if (response.statusCode == 404 || response.statusCode == 410) {
+            return kj::refcounted<KvCache::Value>(nullptr, nullptr);
+          }
+
+          checkForErrorStatus("GET", response);
+
+          kj::Maybe<kj::String> maybeMeta;
+          KJ_IF_MAYBE(m, response.headers->get(context.getHeaderIds().cfKvMetadata)) {
+            maybeMeta = kj::str(*m);
+          }
+
+          auto stream = newSystemStream(
+              response.body.attach(kj::mv(client)), getContentEncoding(context, *response.headers,
+                  Response::BodyEncoding::AUTO, flags), context);
+          return stream->readAllBytes(limit).attach(kj::mv(stream))
+              .then([maybeMeta = kj::mv(maybeMeta)](kj::Array<kj::byte> body) mutable {
+            return kj::refcounted<KvCache::Value>(kj::mv(body), kj::mv(maybeMeta));
+          });
+        });
+
+        return context.awaitIo(js, kj::mv(promise),
+            [fill = kj::mv(fill), typeName = kj::mv(typeName), cacheTtl]
+            (jsg::Lock& js, kj::Own<KvCache::Value> value) mutable {
+          fill->fulfill(kj::addRef(*value),
+              cacheTtl.map([](int ttl) { return kj::max(ttl, 0) * kj::SECONDS; }));
+          return makeCachedResult(js, typeName, kj::mv(value));
+        });
+      }
+    }
+    KJ_UNREACHABLE;
+  });
+}
+
 jsg::Promise<jsg::Value> KvNamespace::list(jsg::Lock& js, jsg::Optional<ListOptions> options) {
   return js.evalNow([&] {
     auto& context = IoContext::current();
@@ -291,6 +580,7 @@ jsg::Promise<void> KvNamespace::put(
     validateKeyName("PUT", name);
 
     auto& context = IoContext::current();
+    auto key = kj::str(name);
 
     kj::Url url;
     url.scheme = kj::str("https");
@@ -397,6 +687,11 @@ jsg::Promise<void> KvNamespace::put(
       });
     });
 
+    KJ_IF_MAYBE(c, cache) {
+      // Make sure this namespace reads its own write, rather than a value cached before it.
+      promise = promise.then([c, key = kj::mv(key)]() { c->invalidate(key); });
+    }
+
     return context.awaitIo(js, kj::mv(promise));
   });
 }
@@ -422,6 +717,10 @@ jsg::Promise<void> KvNamespace::delete_(jsg::Lock& js, kj::String name) {
       }).attach(kj::mv(client));
     });
 
+    KJ_IF_MAYBE(c, cache) {
+      promise = promise.then([c, name = kj::mv(name)]() { c->invalidate(name); });
+    }
+
     return context.awaitIo(js, kj::mv(promise));
   });
 }
@@ -11,6 +11,46 @@
 namespace workerd { class IoContext; }
 namespace workerd::api {
 
+class KvCache {
+  // A read-through cache of one KV namespace's values, which the embedder may give a KvNamespace
+  // so that repeated get()s of a key don't each make a subrequest. The storage behind it lives
+  // outside any one request, and may be shared by every isolate on the thread.
+  //
+  // A lookup either hits, or hands the caller a Fill, making it responsible for fetching the
+  // value. Further lookups of that key wait for the Fill rather than missing too, so concurrent
+  // misses collapse into one fetch.
+
+public:
+  struct Value final: public kj::Refcounted {
+    Value(kj::Maybe<kj::Array<kj::byte>> body, kj::Maybe<kj::String> metadata)
+        : body(kj::mv(body)), metadata(kj::mv(metadata)) {}
+
+    kj::Maybe<kj::Array<kj::byte>> body;
+    // The decoded value, or null if the key doesn't exist.
+
+    kj::Maybe<kj::String> metadata;
+    // The value's metadata as JSON, if it has any.
+  };
+
+  class Fill {
+  public:
+    virtual ~Fill() noexcept(false) = default;
+
+    virtual void fulfill(kj::Own<Value> value, kj::Maybe<kj::Duration> ttl) = 0;
+    // Stores `value` for `ttl`, or for the cache's default TTL if null, and wakes the lookups
+    // waiting for it. Dropping the Fill without calling this (e.g. because the fetch failed)
+    // lets them fetch for themselves instead.
+  };
+
+  using Lookup = kj::OneOf<kj::Own<Value>, kj::Own<Fill>>;
+
+  virtual kj::Promise<Lookup> lookup(kj::StringPtr key) = 0;
+
+  virtual void invalidate(kj::StringPtr key) = 0;
+  // Drops any cached value for `key`, e.g. because this namespace just wrote it. A value being
+  // fetched for `key` at the time won't be cached either, since it may predate the write.
+};
+
 class KvNamespace: public jsg::Object {
   // A capability to a KV namespace.
 
@@ -20,11 +60,14 @@ public:
     kj::String value;
   };
 
-  explicit KvNamespace(kj::Array<AdditionalHeader> additionalHeaders, uint subrequestChannel)
-      : additionalHeaders(kj::mv(additionalHeaders)), subrequestChannel(subrequestChannel) {}
+  explicit KvNamespace(kj::Array<AdditionalHeader> additionalHeaders, uint subrequestChannel,
+                       kj::Maybe<KvCache&> cache = nullptr)
+      : additionalHeaders(kj::mv(additionalHeaders)), subrequestChannel(subrequestChannel),
+        cache(cache) {}
   // `subrequestChannel` is what to pass to IoContext::getHttpClient() to get an HttpClient
   // representing this namespace.
   // `additionalHeaders` is what gets appended to every outbound request.
+  // `cache`, if given, serves get()s and must outlive the namespace.
 
   struct GetOptions {
     jsg::Optional<kj::String> type;
@@ -39,9 +82,23 @@ public:
   using GetResult = kj::Maybe<
       kj::OneOf<jsg::Ref<ReadableStream>, kj::Array<byte>, kj::String, jsg::Value>>;
 
+  using GetKeys = kj::OneOf<kj::Array<kj::String>, kj::String>;
+  // get() and getWithMetadata() take either one key or an array of keys. Given an array, they
+  // resolve to a Map from each key to what a get() of that key alone would have resolved to. All
+  // the keys are fetched with a single `POST /bulk/get` request to the namespace's service,
+  // counting as one KV operation, whose JSON body is:
+  //
+  //     { "keys": [...], "type": "text" | "json", "withMetadata": bool, "cacheTtl"?: number }
+  //
+  // The response must be a JSON object mapping each key that exists to its value -- a string for
+  // "text", any JSON value for "json" -- or, with `withMetadata`, to `{ value, metadata }`.
+  // Only the "text" and "json" types are supported for bulk reads.
+
+  static constexpr size_t MAX_BULK_KEYS = 100;
+
   jsg::Promise<GetResult> get(
       jsg::Lock& js,
-      kj::String name,
+      GetKeys name,
       jsg::Optional<kj::OneOf<kj::String, GetOptions>> options,
       CompatibilityFlags::Reader flags);
 
@@ -56,10 +113,11 @@ public:
     });
   };
 
-  jsg::Promise<GetWithMetadataResult> getWithMetadata(
+  jsg::Promise<kj::OneOf<GetWithMetadataResult, jsg::Value>> getWithMetadata(
       jsg::Lock& js,
-      kj::String name,
+      GetKeys name,
       jsg::Optional<kj::OneOf<kj::String, GetOptions>> options);
+  // Resolves to a GetWithMetadataResult for one key, or to a Map of them for an array of keys.
 
   struct ListOptions {
     jsg::Optional<int> limit;
@@ -133,6 +191,11 @@ public:
       get<ExpectedValue = unknown>(key: Key, options?: KVNamespaceGetOptions<"json">): Promise<ExpectedValue | null>;
       get(key: Key, options?: KVNamespaceGetOptions<"arrayBuffer">): Promise<ArrayBuffer | null>;
       get(key: Key, options?: KVNamespaceGetOptions<"stream">): Promise<ReadableStream | null>;
+      get(key: Array<Key>, type: "text"): Promise<Map<string, string | null>>;
+      get<ExpectedValue = unknown>(key: Array<Key>, type: "json"): Promise<Map<string, ExpectedValue | null>>;
+      get(key: Array<Key>, options?: Partial<KVNamespaceGetOptions<undefined>>): Promise<Map<string, string | null>>;
+      get(key: Array<Key>, options?: KVNamespaceGetOptions<"text">): Promise<Map<string, string | null>>;
+      get<ExpectedValue = unknown>(key: Array<Key>, options?: KVNamespaceGetOptions<"json">): Promise<Map<string, ExpectedValue | null>>;
 
       list<Metadata = unknown>(options?: KVNamespaceListOptions): Promise<KVNamespaceListResult<Metadata, Key>>;
 
@@ -147,6 +210,11 @@ public:
       getWithMetadata<ExpectedValue = unknown, Metadata = unknown>(key: Key, options: KVNamespaceGetOptions<"json">): Promise<KVNamespaceGetWithMetadataResult<ExpectedValue, Metadata>>;
       getWithMetadata<Metadata = unknown>(key: Key, options: KVNamespaceGetOptions<"arrayBuffer">): Promise<KVNamespaceGetWithMetadataResult<ArrayBuffer, Metadata>>;
       getWithMetadata<Metadata = unknown>(key: Key, options: KVNamespaceGetOptions<"stream">): Promise<KVNamespaceGetWithMetadataResult<ReadableStream, Metadata>>;
+      getWithMetadata<Metadata = unknown>(key: Array<Key>, type: "text"): Promise<Map<string, KVNamespaceGetWithMetadataResult<string, Metadata>>>;
+      getWithMetadata<ExpectedValue = unknown, Metadata = unknown>(key: Array<Key>, type: "json"): Promise<Map<string, KVNamespaceGetWithMetadataResult<ExpectedValue, Metadata>>>;
+      getWithMetadata<Metadata = unknown>(key: Array<Key>, options?: Partial<KVNamespaceGetOptions<undefined>>): Promise<Map<string, KVNamespaceGetWithMetadataResult<string, Metadata>>>;
+      getWithMetadata<Metadata = unknown>(key: Array<Key>, options?: KVNamespaceGetOptions<"text">): Promise<Map<string, KVNamespaceGetWithMetadataResult<string, Metadata>>>;
+      getWithMetadata<ExpectedValue = unknown, Metadata = unknown>(key: Array<Key>, options?: KVNamespaceGetOptions<"json">): Promise<Map<string, KVNamespaceGetWithMetadataResult<ExpectedValue, Metadata>>>;
 
       delete(key: Key): Promise<void>;
     });
@@ -168,6 +236,18 @@ protected:
 private:
   kj::Array<AdditionalHeader> additionalHeaders;
   uint subrequestChannel;
+  kj::Maybe<KvCache&> cache;
+
+  jsg::Promise<GetWithMetadataResult> getSingle(
+      jsg::Lock& js, kj::String name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options);
+  jsg::Promise<jsg::Value> getBulk(
+      jsg::Lock& js, kj::Array<kj::String> names,
+      jsg::Optional<kj::OneOf<kj::String, GetOptions>> options, bool withMetadata);
+  // Bulk reads bypass `cache`.
+
+  jsg::Promise<GetWithMetadataResult> getWithMetadataCached(
+      jsg::Lock& js, KvCache& cache, kj::String name, kj::String urlStr, kj::String typeName,
+      kj::Maybe<int> cacheTtl);
 };
 
 #define EW_KV_ISOLATE_TYPES                 \
@@ -0,0 +1,48 @@
+import {
+  strictEqual,
+} from 'node:assert';
+
+import {
+  AsyncLocalStorage,
+} from 'node:async_hooks';
+
+export const test_nested_runs = {
+  async test() {
+    const als1 = new AsyncLocalStorage();
+    const als2 = new AsyncLocalStorage();
+    strictEqual(als1.getStore(), undefined);
+
+    // Nest deeply enough that frames are compacted along the way, and check that every level
+    // still sees the right values, both synchronously and after an await.
+    async function nest(depth) {
+      if (depth == 0) return;
+      await als1.run(depth, async () => {
+        strictEqual(als1.getStore(), depth);
+        strictEqual(als2.getStore(), 'outer');
+        await nest(depth - 1);
+        await Promise.resolve();
+        strictEqual(als1.getStore(), depth);
+        strictEqual(als2.getStore(), 'outer');
+      });
+    }
+    await als2.run('outer', () => nest(50));
+
+    strictEqual(als1.getStore(), undefined);
+    strictEqual(als2.getStore(), undefined);
+  }
+};
+
+export const test_exit_and_snapshot = {
+  async test() {
+    const als = new AsyncLocalStorage();
+    const snapshot = als.run('a', () => {
+      return als.run('b', () => {
+        strictEqual(als.getStore(), 'b');
+        als.exit(() => strictEqual(als.getStore(), undefined));
+        return AsyncLocalStorage.snapshot();
+      });
+    });
+    strictEqual(als.getStore(), undefined);
+    strictEqual(snapshot(() => als.getStore()), 'b');
+  }
+};
@@ -0,0 +1,295 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "buffer-base64.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WD_BASE64_SSSE3 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define WD_BASE64_NEON 1
+#endif
+
+namespace workerd::api::node {
+
+// The vectorized kernels below follow Wojciech Muła's base64 algorithms
+// (http://0x80.pl/articles/index.html#base64-algorithm-new). On x86 they need SSSE3, which we
+// check for at runtime; NEON is always available on aarch64. Each kernel handles whole blocks
+// only and leaves the tail to the scalar code.
+
+namespace {
+
+constexpr char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                "abcdefghijklmnopqrstuvwxyz"
+                                "0123456789+/";
+
+constexpr char hex_table[] = "0123456789abcdef";
+
+#if WD_BASE64_SSSE3
+
+const bool have_ssse3 = __builtin_cpu_supports("ssse3");
+
+__attribute__((target("ssse3")))
+size_t base64_encode_ssse3(const uint8_t* src, size_t slen, char* dst, Base64Mode mode) {
+  // Encodes 12 bytes into 16 characters at a time. Each load reads 16 bytes, so the last
+  // 4 bytes of input are always left for the scalar code. Returns the number of bytes consumed.
+  const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+  const __m128i shift_lut = mode == Base64Mode::NORMAL
+      ? _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0)
+      : _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+
+  size_t i = 0;
+  for (; i + 16 <= slen; i += 12, dst += 16) {
+    // Split each group of three bytes into four 6-bit indices, one per byte.
+    __m128i in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)),
+                                  shuffle);
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    const __m128i indices = _mm_or_si128(t1, t3);
+
+    // Map each index to its character by adding the offset for its range of the alphabet.
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i out = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, range), indices);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), out);
+  }
+  return i;
+}
+
+__attribute__((target("ssse3")))
+bool base64_decode_block_ssse3(const uint8_t* src, char* dst) {
+  // Decodes 16 characters into 12 bytes, unless any of them isn't a base64 digit.
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                         0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+
+  __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+  // Node.js accepts the URL-safe alphabet in either mode, so fold '-' and '_' into '+' and '/'.
+  in = _mm_add_epi8(in, _mm_and_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('-')),
+                                      _mm_set1_epi8('+' - '-')));
+  in = _mm_add_epi8(in, _mm_and_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('_')),
+                                      _mm_set1_epi8('/' - '_')));
+
+  const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), nibble);
+  const __m128i lo_nibbles = _mm_and_si128(in, nibble);
+  const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+  const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff) {
+    // Whitespace, padding or an invalid character. Let the scalar code deal with it.
+    return false;
+  }
+
+  const __m128i eq_2f = _mm_cmpeq_epi8(in, _mm_set1_epi8(0x2f));
+  const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+  const __m128i values = _mm_add_epi8(in, roll);
+
+  // Pack four 6-bit values into each three bytes.
+  const __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+  const __m128i out = _mm_shuffle_epi8(packed, _mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+  alignas(16) char buf[16];
+  _mm_store_si128(reinterpret_cast<__m128i*>(buf), out);
+  memcpy(dst, buf, 12);
+  return true;
+}
+
+__attribute__((target("ssse3")))
+size_t hex_encode_ssse3(const uint8_t* src, size_t slen, char* dst) {
+  const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex_table));
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 16 <= slen; i += 16, dst += 32) {
+    const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+    const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(in, nibble));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi8(hi, lo));
+  }
+  return i;
+}
+
+#elif WD_BASE64_NEON
+
+bool base64_decode_block_neon(const uint8_t* src, char* dst) {
+  // Decodes 64 characters into 48 bytes, unless any of them isn't a base64 digit.
+  const uint8x16x4_t lut_lo = vld1q_u8_x4(reinterpret_cast<const uint8_t*>(unbase64_table));
+  const uint8x16x4_t lut_hi = vld1q_u8_x4(reinterpret_cast<const uint8_t*>(unbase64_table + 64));
+  const uint8x16_t offset = vdupq_n_u8(64);
+  const uint8x16_t high_bit = vdupq_n_u8(0x80);
+
+  uint8x16x4_t in = vld4q_u8(src);
+  uint8x16_t invalid = vdupq_n_u8(0);
+  for (auto& v: in.val) {
+    // Invalid characters map to negative values. Characters >= 128 are outside both tables and
+    // come back as 0, so check their high bit too.
+    auto value = vqtbx4q_u8(vqtbl4q_u8(lut_lo, v), lut_hi, vsubq_u8(v, offset));
+    invalid = vorrq_u8(invalid, vorrq_u8(value, vandq_u8(v, high_bit)));
+    v = value;
+  }
+  if (vmaxvq_u8(invalid) > 63) {
+    return false;
+  }
+
+  uint8x16x3_t out;
+  out.val[0] = vorrq_u8(vshlq_n_u8(in.val[0], 2), vshrq_n_u8(in.val[1], 4));
+  out.val[1] = vorrq_u8(vshlq_n_u8(in.val[1], 4), vshrq_n_u8(in.val[2], 2));
+  out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+  vst3q_u8(reinterpret_cast<uint8_t*>(dst), out);
+  return true;
+}
+
+size_t base64_encode_neon(const uint8_t* src, size_t slen, char* dst, Base64Mode mode) {
+  // Encodes 48 bytes into 64 characters at a time, deinterleaving the input into the first,
+  // second and third byte of each group. Returns the number of bytes consumed.
+  const char* table = mode == Base64Mode::NORMAL ? base64_table : base64_table_url;
+  const uint8x16x4_t lut = vld1q_u8_x4(reinterpret_cast<const uint8_t*>(table));
+  const uint8x16_t mask = vdupq_n_u8(0x3f);
+  size_t i = 0;
+  for (; i + 48 <= slen; i += 48, dst += 64) {
+    const uint8x16x3_t in = vld3q_u8(src + i);
+    uint8x16x4_t out;
+    out.val[0] = vshrq_n_u8(in.val[0], 2);
+    out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+    out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+    out.val[3] = vandq_u8(in.val[2], mask);
+    out.val[0] = vqtbl4q_u8(lut, out.val[0]);
+    out.val[1] = vqtbl4q_u8(lut, out.val[1]);
+    out.val[2] = vqtbl4q_u8(lut, out.val[2]);
+    out.val[3] = vqtbl4q_u8(lut, out.val[3]);
+    vst4q_u8(reinterpret_cast<uint8_t*>(dst), out);
+  }
+  return i;
+}
+
+size_t hex_encode_neon(const uint8_t* src, size_t slen, char* dst) {
+  const uint8x16_t lut = vld1q_u8(reinterpret_cast<const uint8_t*>(hex_table));
+  const uint8x16_t nibble = vdupq_n_u8(0x0f);
+  size_t i = 0;
+  for (; i + 16 <= slen; i += 16, dst += 32) {
+    const uint8x16_t in = vld1q_u8(src + i);
+    uint8x16x2_t out;
+    out.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(in, 4));
+    out.val[1] = vqtbl1q_u8(lut, vandq_u8(in, nibble));
+    vst2q_u8(reinterpret_cast<uint8_t*>(dst), out);
+  }
+  return i;
+}
+
+#endif
+
+}  // namespace
+
+size_t base64_decode_blocks(const uint8_t* src, size_t slen, char* dst, size_t dlen) {
+  size_t i = 0;
+  size_t k = 0;
+#if WD_BASE64_SSSE3
+  if (have_ssse3) {
+    while (i + 16 <= slen && k + 12 <= dlen && base64_decode_block_ssse3(src + i, dst + k)) {
+      i += 16;
+      k += 12;
+    }
+  }
+#elif WD_BASE64_NEON
+  while (i + 64 <= slen && k + 48 <= dlen && base64_decode_block_neon(src + i, dst + k)) {
+    i += 64;
+    k += 48;
+  }
+#endif
+  return i;
+}
+
+size_t base64_encode(const char* src,
+                     size_t slen,
+                     char* dst,
+                     size_t dlen,
+                     Base64Mode mode) {
+  dlen = base64_encoded_size(slen, mode);
+
+  const char* table = mode == Base64Mode::NORMAL ? base64_table : base64_table_url;
+  auto usrc = reinterpret_cast<const uint8_t*>(src);
+
+  size_t i = 0;
+#if WD_BASE64_SSSE3
+  if (have_ssse3) i = base64_encode_ssse3(usrc, slen, dst, mode);
+#elif WD_BASE64_NEON
+  i = base64_encode_neon(usrc, slen, dst, mode);
+#endif
+  size_t k = i / 3 * 4;
+  size_t n = slen / 3 * 3;
+
+  while (i < n) {
+    unsigned a = usrc[i + 0];
+    unsigned b = usrc[i + 1];
+    unsigned c = usrc[i + 2];
+
+    dst[k + 0] = table[a >> 2];
+    dst[k + 1] = table[((a & 3) << 4) | (b >> 4)];
+    dst[k + 2] = table[((b & 0x0f) << 2) | (c >> 6)];
+    dst[k + 3] = table[c & 0x3f];
+
+    i += 3;
+    k += 4;
+  }
+
+  switch (slen - n) {
+    case 1: {
+      unsigned a = usrc[i + 0];
+      dst[k + 0] = table[a >> 2];
+      dst[k + 1] = table[(a & 3) << 4];
+      if (mode == Base64Mode::NORMAL) {
+        dst[k + 2] = '=';
+        dst[k + 3] = '=';
+      }
+      break;
+    }
+    case 2: {
+      unsigned a = usrc[i + 0];
+      unsigned b = usrc[i + 1];
+      dst[k + 0] = table[a >> 2];
+      dst[k + 1] = table[((a & 3) << 4) | (b >> 4)];
+      dst[k + 2] = table[(b & 0x0f) << 2];
+      if (mode == Base64Mode::NORMAL) {
+        dst[k + 3] = '=';
+      }
+      break;
+    }
+  }
+
+  return dlen;
+}
+
+size_t hex_encode(const char* src, size_t slen, char* dst, size_t dlen) {
+  dlen = slen * 2;
+  auto usrc = reinterpret_cast<const uint8_t*>(src);
+
+  size_t i = 0;
+#if WD_BASE64_SSSE3
+  if (have_ssse3) i = hex_encode_ssse3(usrc, slen, dst);
+#elif WD_BASE64_NEON
+  i = hex_encode_neon(usrc, slen, dst);
+#endif
+
+  for (; i < slen; i++) {
+    dst[i * 2] = hex_table[usrc[i] >> 4];
+    dst[i * 2 + 1] = hex_table[usrc[i] & 0x0f];
+  }
+  return dlen;
+}
+
+}  // namespace workerd::api::node
@@ -63,11 +63,22 @@ template <typename TypeName>
 size_t base64_decode(char* const dst, const size_t dstlen,
                      const TypeName* const src, const size_t srclen);
 
-inline size_t base64_encode(const char* src,
-                            size_t slen,
-                            char* dst,
-                            size_t dlen,
-                            Base64Mode mode = Base64Mode::NORMAL);
+size_t base64_encode(const char* src,
+                     size_t slen,
+                     char* dst,
+                     size_t dlen,
+                     Base64Mode mode = Base64Mode::NORMAL);
+// Writes base64_encoded_size(slen, mode) characters to dst, padded in NORMAL mode, and returns
+// that size. Vectorized where the CPU allows.
+
+size_t hex_encode(const char* src, size_t slen, char* dst, size_t dlen);
+// Writes slen * 2 lower-case hex digits to dst and returns that size.
+
+size_t base64_decode_blocks(const uint8_t* src, size_t slen, char* dst, size_t dlen);
+// Vectorized fast path for base64_decode_fast(): decodes whole blocks of characters from the
+// start of src for as long as they contain nothing but base64 digits, and the output fits in
+// dlen. Returns the number of characters consumed, which is always a multiple of 4, with 3 bytes
+// written to dst for every 4 of them. Returns 0 if the CPU has no vector support.
 
 static constexpr char base64_table_url[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
                                            "abcdefghijklmnopqrstuvwxyz"
@@ -134,6 +145,14 @@ size_t base64_decode_fast(char* const dst, const size_t dstlen,
   size_t i = 0;
   size_t k = 0;
   while (i < max_i && k < max_k) {
+    if constexpr (sizeof(TypeName) == 1) {
+      const size_t consumed = base64_decode_blocks(
+          reinterpret_cast<const uint8_t*>(src + i), max_i - i, dst + k, max_k - k);
+      i += consumed;
+      k += consumed / 4 * 3;
+      if (i >= max_i || k >= max_k) break;
+    }
+
     const unsigned char txt[] = {
         static_cast<unsigned char>(unbase64(static_cast<uint8_t>(src[i + 0]))),
         static_cast<unsigned char>(unbase64(static_cast<uint8_t>(src[i + 1]))),
@@ -185,62 +204,4 @@ size_t base64_decode(char* const dst, const size_t dstlen,
 }
 
 
-inline size_t base64_encode(const char* src,
-                            size_t slen,
-                            char* dst,
-                            size_t dlen,
-                            Base64Mode mode) {
-  dlen = base64_encoded_size(slen, mode);
-
-  // Node.js introduced a SIMD-capable fast base64 encoder as a dependency.
-  // if (mode == Base64Mode::NORMAL) {
-  //   ::base64_encode(src, slen, dst, &dlen, 0);
-  //   return dlen;
-  // }
-
-  unsigned a;
-  unsigned b;
-  unsigned c;
-  unsigned i;
-  unsigned k;
-  unsigned n;
-
-  const char* table = base64_table_url;
-
-  i = 0;
-  k = 0;
-  n = slen / 3 * 3;
-
-  while (i < n) {
-    a = src[i + 0] & 0xff;
-    b = src[i + 1] & 0xff;
-    c = src[i + 2] & 0xff;
-
-    dst[k + 0] = table[a >> 2];
-    dst[k + 1] = table[((a & 3) << 4) | (b >> 4)];
-    dst[k + 2] = table[((b & 0x0f) << 2) | (c >> 6)];
-    dst[k + 3] = table[c & 0x3f];
-
-    i += 3;
-    k += 4;
-  }
-
-  switch (slen - n) {
-    case 1:
-      a = src[i + 0] & 0xff;
-      dst[k + 0] = table[a >> 2];
-      dst[k + 1] = table[(a & 3) << 4];
-      break;
-    case 2:
-      a = src[i + 0] & 0xff;
-      b = src[i + 1] & 0xff;
-      dst[k + 0] = table[a >> 2];
-      dst[k + 1] = table[((a & 3) << 4) | (b >> 4)];
-      dst[k + 2] = table[(b & 0x0f) << 2];
-      break;
-  }
-
-  return dlen;
-}
-
 }  // namespace workerd::api::node
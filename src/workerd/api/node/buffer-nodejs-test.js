@@ -5567,3 +5567,88 @@ export const toStringRange = {
     });
   }
 };
+
+export const longBase64AndHex = {
+  test(ctrl, env, ctx) {
+    // Long enough inputs to go through the vectorized codecs, with every byte value present.
+    const bytes = new Uint8Array(1000);
+    for (let i = 0; i < bytes.length; i++) {
+      bytes[i] = (i * 7 + (i >> 8)) & 0xff;
+    }
+    for (const len of [0, 1, 2, 3, 47, 48, 49, 63, 64, 65, 191, 192, 193, 1000]) {
+      const buf = Buffer.from(bytes.subarray(0, len));
+
+      const base64 = buf.toString('base64');
+      strictEqual(base64, btoa(String.fromCharCode(...buf)));
+      deepStrictEqual(Buffer.from(base64, 'base64'), buf);
+
+      const base64url = buf.toString('base64url');
+      strictEqual(base64url, base64.replace(/\+/g, '-').replace(/\//g, '_').replace(/=+$/, ''));
+      deepStrictEqual(Buffer.from(base64url, 'base64'), buf);
+
+      // Line breaks and other junk between blocks are skipped.
+      const wrapped = base64.replace(/(.{19})/g, '$1\n');
+      deepStrictEqual(Buffer.from(wrapped, 'base64'), buf);
+
+      const hex = buf.toString('hex');
+      strictEqual(hex, Array.from(buf, (b) => b.toString(16).padStart(2, '0')).join(''));
+      deepStrictEqual(Buffer.from(hex, 'hex'), buf);
+      deepStrictEqual(Buffer.from(hex.toUpperCase(), 'hex'), buf);
+    }
+
+    // Hex decoding stops at the first invalid pair, and write() stops when the buffer is full.
+    deepStrictEqual(Buffer.from('0011zz22', 'hex'), Buffer.from([0x00, 0x11]));
+    const small = Buffer.alloc(3);
+    strictEqual(small.write('aabbccddee', 'hex'), 3);
+    deepStrictEqual(small, Buffer.from([0xaa, 0xbb, 0xcc]));
+  }
+};
+
+export const toStringAsciiAndUcs2 = {
+  test(ctrl, env, ctx) {
+    // ASCII clears the high bit, whether or not any byte has it set.
+    strictEqual(Buffer.from('hello').toString('ascii'), 'hello');
+    strictEqual(Buffer.from([0x68, 0xe9, 0xff, 0x80]).toString('ascii'), 'hi\x7f\x00');
+
+    // UCS-2 works from any offset, aligned or not.
+    const ucs2 = Buffer.from('\x00héllo €', 'ucs2');
+    strictEqual(ucs2.toString('ucs2', 2), 'héllo €');
+    const unaligned = Buffer.concat([Buffer.from([0]), Buffer.from('héllo €', 'ucs2')]);
+    strictEqual(unaligned.toString('ucs2', 1), 'héllo €');
+    strictEqual(unaligned.toString('ucs2', 1, 4), 'h');
+
+    // Large outputs are handed to V8 as external strings; they must read back the same.
+    const big = Buffer.alloc(2 * 1024 * 1024, 0xe1);
+    const ascii = big.toString('ascii');
+    strictEqual(ascii.length, big.length);
+    strictEqual(ascii[0], 'a');
+    strictEqual(ascii[ascii.length - 1], 'a');
+    const hex = big.toString('hex');
+    strictEqual(hex.length, big.length * 2);
+    strictEqual(hex.slice(0, 4), 'e1e1');
+    deepStrictEqual(Buffer.from(hex, 'hex'), big);
+    const bigUcs2 = Buffer.concat([Buffer.from([0]), Buffer.from('é'.repeat(1024 * 1024), 'ucs2')]);
+    strictEqual(bigUcs2.toString('ucs2', 1), 'é'.repeat(1024 * 1024));
+  }
+};
+
+export const indexOfLongHaystack = {
+  test(ctrl, env, ctx) {
+    // Near-misses that share the needle's first and last characters, at every block offset.
+    const filler = 'ab'.repeat(5000) + 'aXb' + 'ab'.repeat(100);
+    const haystack = Buffer.from(filler + 'aYb' + 'ab'.repeat(50));
+    strictEqual(haystack.indexOf('aYb'), filler.length);
+    strictEqual(haystack.lastIndexOf('aYb'), filler.length);
+    strictEqual(haystack.indexOf('aZb'), -1);
+    for (let i = 0; i < 40; i++) {
+      const buf = Buffer.alloc(64 + i, 'x');
+      buf.write('needle', i);
+      strictEqual(buf.indexOf('needle'), i);
+      strictEqual(buf.indexOf('needle', i + 1), -1);
+    }
+
+    const ucs2 = Buffer.from(filler + 'a€b' + 'ab', 'ucs2');
+    strictEqual(ucs2.indexOf('a€b', 0, 'ucs2'), filler.length * 2);
+    strictEqual(ucs2.indexOf('a€c', 0, 'ucs2'), -1);
+  }
+};
@@ -9,6 +9,7 @@
 #include <workerd/jsg/buffersource.h>
 #include <kj/encoding.h>
 #include <algorithm>
+#include <array>
 
 // These are defined by <sys/byteorder.h> or <netinet/in.h> on some systems.
 // To avoid warnings, undefine them before redefining them.
@@ -114,53 +115,49 @@ Encoding getEncoding(kj::StringPtr encoding) {
   KJ_UNREACHABLE;
 }
 
-kj::Maybe<uint> tryFromHexDigit(char c) {
-  if ('0' <= c && c <= '9') {
-    return c - '0';
-  } else if ('a' <= c && c <= 'f') {
-    return c - ('a' - 10);
-  } else if ('A' <= c && c <= 'F') {
-    return c - ('A' - 10);
-  } else {
-    return nullptr;
-  }
-}
-
-kj::Array<byte> decodeHexTruncated(kj::ArrayPtr<kj::byte> text, bool strict = false) {
-  // We do not use kj::decodeHex because we need to match Node.js'
-  // behavior of truncating the response at the first invalid hex
-  // pair as opposed to just marking that an error happened and
-  // trying to continue with the decode.
+constexpr auto HEX_DIGIT_VALUES = [] {
+  // Maps each byte to the value of the hex digit it represents, or -1.
+  std::array<int8_t, 256> table {};
+  for (auto& value: table) value = -1;
+  for (int c = '0'; c <= '9'; c++) table[c] = c - '0';
+  for (int c = 'a'; c <= 'f'; c++) table[c] = c - ('a' - 10);
+  for (int c = 'A'; c <= 'F'; c++) table[c] = c - ('A' - 10);
+  return table;
+}();
+
+size_t decodeHexInto(kj::ArrayPtr<const kj::byte> text,
+                     kj::ArrayPtr<kj::byte> dest,
+                     bool strict = false) {
+  // Decodes as many pairs of hex digits from `text` as fit in `dest`, returning how many bytes it
+  // wrote. We do not use kj::decodeHex because we need to match Node.js' behavior of truncating
+  // the response at the first invalid hex pair as opposed to just marking that an error happened
+  // and trying to continue with the decode.
   if (text.size() % 2 != 0) {
     if (strict) {
       JSG_FAIL_REQUIRE(TypeError, "The text is not valid hex");
     }
     text = text.slice(0, text.size() - 1);
   }
-  kj::Vector vec = kj::Vector<kj::byte>(text.size() / 2);
 
-  for (size_t i = 0; i < text.size(); i += 2) {
-    byte b = 0;
-    KJ_IF_MAYBE(d1, tryFromHexDigit(text[i])) {
-      b = *d1 << 4;
-    } else {
+  auto count = kj::min(text.size() / 2, dest.size());
+  for (size_t i = 0; i < count; i++) {
+    auto high = HEX_DIGIT_VALUES[text[i * 2]];
+    auto low = HEX_DIGIT_VALUES[text[i * 2 + 1]];
+    if ((high | low) < 0) {
       if (strict) {
         JSG_FAIL_REQUIRE(TypeError, "The text is not valid hex");
       }
-      break;
+      return i;
     }
-    KJ_IF_MAYBE(d2, tryFromHexDigit(text[i+1])) {
-      b |= *d2;
-    } else {
-      if (strict) {
-        JSG_FAIL_REQUIRE(TypeError, "The text is not valid hex");
-      }
-      break;
-    }
-    vec.add(b);
+    dest[i] = (high << 4) | low;
   }
+  return count;
+}
 
-  return vec.releaseAsArray();
+kj::Array<byte> decodeHexTruncated(kj::ArrayPtr<kj::byte> text, bool strict = false) {
+  auto dest = kj::heapArray<kj::byte>(text.size() / 2);
+  auto len = decodeHexInto(text, dest, strict);
+  return dest.slice(0, len).attach(kj::mv(dest));
 }
 
 uint32_t writeInto(
@@ -201,14 +198,13 @@ uint32_t writeInto(
           str.size());
     }
     case Encoding::HEX: {
-      KJ_STACK_ARRAY(kj::byte, buf, string->Length(), 1024, 536870888);
-      string->WriteOneByte(js.v8Isolate, buf.begin(), 0, -1,
+      // Only the digits that fit in dest need to be read.
+      auto length = kj::min(static_cast<size_t>(string->Length()), dest.size() * 2);
+      KJ_STACK_ARRAY(kj::byte, buf, length, 1024, 536870888);
+      string->WriteOneByte(js.v8Isolate, buf.begin(), 0, buf.size(),
                            v8::String::NO_NULL_TERMINATION |
                            v8::String::REPLACE_INVALID_UTF8);
-      auto bytes = decodeHexTruncated(buf, false);
-      auto amountToCopy = kj::min(bytes.size(), dest.size());
-      memcpy(dest.begin(), bytes.begin(), amountToCopy);
-      return amountToCopy;
+      return decodeHexInto(buf, dest);
     }
   }
   KJ_UNREACHABLE;
@@ -513,6 +509,32 @@ jsg::Optional<uint32_t> indexOfString(
   return result;
 }
 
+constexpr size_t EXTERN_APEX = 0xFBEE9;
+// As in Node.js, strings built from more data than this are handed to V8 as external strings
+// rather than copied into its heap, so that they aren't held in memory twice.
+
+v8::Local<v8::String> toOneByteString(jsg::Lock& js, kj::Array<char> data) {
+  if (data.size() > EXTERN_APEX) {
+    return jsg::newExternalOneByteString(js, kj::mv(data));
+  }
+  return jsg::v8StrFromLatin1(js.v8Isolate, data.asPtr().asBytes());
+}
+
+bool isAscii(kj::ArrayPtr<const kj::byte> bytes) {
+  // Checks a word at a time, in a form the compiler can vectorize.
+  uint64_t bits = 0;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= bytes.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, bytes.begin() + i, sizeof(word));
+    bits |= word;
+  }
+  for (; i < bytes.size(); i++) {
+    bits |= bytes[i];
+  }
+  return (bits & 0x8080808080808080ull) == 0;
+}
+
 v8::Local<v8::String> toStringImpl(
     jsg::Lock& js,
     kj::ArrayPtr<kj::byte> bytes,
@@ -523,12 +545,16 @@ v8::Local<v8::String> toStringImpl(
   if (slice.size() == 0) return v8::String::Empty(js.v8Isolate);
   switch (encoding) {
     case Encoding::ASCII: {
-      // TODO(perf): We can look at making this more performant later.
-      // Essentially we have to modify the buffer such that every byte
-      // has the highest bit turned off. Whee! Node.js has a faster
-      // algorithm that it implements so we can likely adopt that.
-      kj::Array<kj::byte> copy = KJ_MAP(b, slice) -> kj::byte { return b & 0x7f; };
-      return jsg::v8StrFromLatin1(js.v8Isolate, copy);
+      // ASCII decoding clears the high bit of every byte. Usually it isn't set in the first place,
+      // and the bytes can be used as they are.
+      if (isAscii(slice)) {
+        return jsg::v8StrFromLatin1(js.v8Isolate, slice);
+      }
+      auto dest = kj::heapArray<char>(slice.size());
+      for (auto i: kj::indices(slice)) {
+        dest[i] = slice[i] & 0x7f;
+      }
+      return toOneByteString(js, kj::mv(dest));
     }
     case Encoding::LATIN1: {
       return jsg::v8StrFromLatin1(js.v8Isolate, slice);
@@ -537,19 +563,31 @@ v8::Local<v8::String> toStringImpl(
       return jsg::v8Str(js.v8Isolate, slice.asChars());
     }
     case Encoding::UTF16LE: {
-      // TODO(soon): Using just the slice here results in v8 hitting an IsAligned assertion.
-      auto data = kj::heapArray<uint16_t>(
-          reinterpret_cast<uint16_t*>(slice.begin()), slice.size() / 2);
-      return jsg::v8Str<uint16_t>(js.v8Isolate, data);
-    }
-    case Encoding::BASE64: {
-      return jsg::v8Str(js.v8Isolate, kj::encodeBase64(slice));
+      auto length = slice.size() / sizeof(char16_t);
+      if (reinterpret_cast<uintptr_t>(slice.begin()) % alignof(char16_t) == 0) {
+        return jsg::v8Str(js.v8Isolate,
+            kj::arrayPtr(reinterpret_cast<const char16_t*>(slice.begin()), length));
+      }
+      // V8 requires two-byte data to be aligned, so it has to be copied first.
+      auto data = kj::heapArray<uint16_t>(length);
+      memcpy(data.begin(), slice.begin(), length * sizeof(uint16_t));
+      if (slice.size() > EXTERN_APEX) {
+        return jsg::newExternalTwoByteString(js, kj::mv(data));
+      }
+      return jsg::v8Str(js.v8Isolate, data.asPtr());
     }
+    case Encoding::BASE64:
+      // Fall-through
     case Encoding::BASE64URL: {
-      return jsg::v8Str(js.v8Isolate, kj::encodeBase64Url(slice));
+      auto mode = encoding == Encoding::BASE64 ? Base64Mode::NORMAL : Base64Mode::URL;
+      auto dest = kj::heapArray<char>(base64_encoded_size(slice.size(), mode));
+      base64_encode(slice.asChars().begin(), slice.size(), dest.begin(), dest.size(), mode);
+      return toOneByteString(js, kj::mv(dest));
     }
     case Encoding::HEX: {
-      return jsg::v8Str(js.v8Isolate, kj::encodeHex(slice));
+      auto dest = kj::heapArray<char>(slice.size() * 2);
+      hex_encode(slice.asChars().begin(), slice.size(), dest.begin(), dest.size());
+      return toOneByteString(js, kj::mv(dest));
     }
   }
   KJ_UNREACHABLE;
@@ -622,70 +660,57 @@ uint32_t BufferUtil::write(
 //   results += sd.write(new Uint8Array([0xac]));  // results.length === 1
 //   results += sd.end();
 //
-// Internally, the decoder allocates a small 7 byte buffer (the state) argument below.
+// Internally, each StringDecoder holds a StringDecoderHandle, which keeps up to four bytes of a
+// character cut off at the end of the previous write (incompleteChar), how many of those there
+// are (bufferedBytes), and how many more are needed to complete the character (missingBytes).
 //
-// The first four bytes of the state are used to hold partial bytes received on the previous
-// write. The fifth byte in state is a count of the number of missing bytes we need to complete
-// the character. The sixth byte in state is the number of bytes that have been encoded into the
-// first four. The seventh byte in state identifies the Encoding and matches the values of the
-// Encoding enum.
+// So, in our example above, initially incompleteChar is [0x00, 0x00, 0x00, 0x00] and both
+// counts are zero.
 //
-// So, in our example above, initially the first six bytes of the state are [0x00, 0x00, 0x00,
-// 0x00, 0x00, 0x00]
+// After the first call to write above, incompleteChar is [0xe2, 0x00, 0x00, 0x00], with two bytes
+// missing and one buffered.
 //
-// After the first call to write above, the state is updated to: [0xe2, 0x00, 0x00, 0x00, 0x02,
-// 0x01]
+// After the second call to write, incompleteChar is [0xe2, 0x82, 0x00, 0x00], with one byte
+// missing and two buffered.
 //
-// After the second call to write, the state is updated to: [0xe2, 0x82, 0x00, 0x00, 0x01, 0x02]
-//
-// After the third call to write, the pending multibyte character is completed, the state becomes:
-// [0xe2, 0x82, 0xac, 0x00, 0x00, 0x00] ... while the bytes are still in state, the buffered bytes
-// and bytes needed are zeroed out. Since the character is completed on that third write, it is
+// After the third call to write, the pending multibyte character is completed, incompleteChar
+// becomes [0xe2, 0x82, 0xac, 0x00] ... while the bytes are still there, the buffered bytes and
+// bytes needed are zeroed out. Since the character is completed on that third write, it is
 // included in the returned string.
 //
+// The state lives in the handle rather than in a buffer handed back and forth with JavaScript,
+// so it is updated in place and never needs to be revalidated.
+//
 // The implementation here is taken nearly verbatim from Node.js with a few adaptations. The code
 // from Node.js has remained largely unchanged for years and is well-proven.
 
-namespace {
-inline kj::byte getMissingBytes(kj::ArrayPtr<kj::byte> state) {
-  JSG_REQUIRE(state[BufferUtil::kMissingBytes] <=
-              BufferUtil::kIncompleteCharactersEnd, Error, "Missing bytes cannot exceed 4");
-  return state[BufferUtil::kMissingBytes];
-}
-
-inline kj::byte getBufferedBytes(kj::ArrayPtr<kj::byte> state) {
-  JSG_REQUIRE(state[BufferUtil::kBufferedBytes] <=
-              BufferUtil::kIncompleteCharactersEnd, Error, "Buffered bytes cannot exceed 4");
-  return state[BufferUtil::kBufferedBytes];
+jsg::Ref<BufferUtil::StringDecoderHandle> BufferUtil::StringDecoderHandle::constructor(
+    int encoding) {
+  JSG_REQUIRE(encoding >= 0 && encoding <= static_cast<int>(Encoding::HEX),
+              TypeError, "Invalid StringDecoder encoding");
+  return jsg::alloc<StringDecoderHandle>(static_cast<kj::byte>(encoding));
 }
 
-inline kj::byte* getIncompleteCharacterBuffer(kj::ArrayPtr<kj::byte> state) {
-  return state.begin() + BufferUtil::kIncompleteCharactersStart;
+kj::Array<kj::byte> BufferUtil::StringDecoderHandle::getLastChar() {
+  return kj::heapArray<kj::byte>(incompleteChar, MAX_CHAR_BYTES);
 }
 
-inline Encoding getEncoding(kj::ArrayPtr<kj::byte> state) {
-  JSG_REQUIRE(state[BufferUtil::kEncoding] <= static_cast<kj::byte>(Encoding::HEX),
-              Error, "Invalid StringDecoder state");
-  return static_cast<Encoding>(state[BufferUtil::kEncoding]);
+void BufferUtil::StringDecoderHandle::reset() {
+  missingBytes = 0;
+  bufferedBytes = 0;
 }
 
-v8::Local<v8::String> getBufferedString(jsg::Lock& js, kj::ArrayPtr<kj::byte> state) {
-  JSG_REQUIRE(getBufferedBytes(state) <= BufferUtil::kIncompleteCharactersEnd, Error,
-              "Invalid StringDecoder state");
-  auto ret = toStringImpl(js, state,
-                          BufferUtil::kIncompleteCharactersStart,
-                          BufferUtil::kIncompleteCharactersStart + getBufferedBytes(state),
-                          getEncoding(state));
-  state[BufferUtil::kBufferedBytes] = 0;
+v8::Local<v8::String> BufferUtil::StringDecoderHandle::takeBufferedString(jsg::Lock& js) {
+  KJ_DASSERT(bufferedBytes <= MAX_CHAR_BYTES);
+  auto ret = toStringImpl(js, kj::arrayPtr(incompleteChar, bufferedBytes),
+                          0, bufferedBytes, static_cast<Encoding>(encoding));
+  bufferedBytes = 0;
   return ret;
 }
-}  // namespace
 
-v8::Local<v8::String> BufferUtil::decode(jsg::Lock& js,
-                                         kj::Array<kj::byte> bytes,
-                                         kj::Array<kj::byte> state) {
-  JSG_REQUIRE(state.size() == BufferUtil::kSize, TypeError, "Invalid StringDecoder");
-  auto enc = getEncoding(state);
+v8::Local<v8::String> BufferUtil::StringDecoderHandle::write(jsg::Lock& js,
+                                                            kj::Array<kj::byte> bytes) {
+  auto enc = static_cast<Encoding>(encoding);
   if (enc == Encoding::ASCII || enc == Encoding::LATIN1 || enc == Encoding::HEX) {
     // For ascii, latin1, and hex, we can just use the regular
     // toString option since there will never be a case where
@@ -697,22 +722,21 @@ v8::Local<v8::String> BufferUtil::decode(jsg::Lock& js,
   v8::Local<v8::String> body;
   auto nread = bytes.size();
   auto data = bytes.begin();
-  if (getMissingBytes(state) > 0) {
-    JSG_REQUIRE(getMissingBytes(state) + getBufferedBytes(state) <=
-              BufferUtil::kIncompleteCharactersEnd, Error, "Invalid StringDecoder state");
+  if (missingBytes > 0) {
+    KJ_DASSERT(missingBytes + bufferedBytes <= MAX_CHAR_BYTES);
     if (enc == Encoding::UTF8) {
       // For UTF-8, we need special treatment to algin with the V8 decoder:
       // If an incomplete character is found at a chunk boundary, we use
       // its remainder and pass it to V8 as-is.
-      for (size_t i = 0; i < nread && i < getMissingBytes(state); ++i) {
+      for (size_t i = 0; i < nread && i < missingBytes; ++i) {
         if ((bytes[i] & 0xC0) != 0x80) {
           // This byte is not a continuation byte even though it should have
           // been one. We stop decoding of the incomplete character at this
           // point (but still use the rest of the incomplete bytes from this
           // chunk) and assume that the new, unexpected byte starts a new one.
-          state[kMissingBytes] = 0;
-          memcpy(getIncompleteCharacterBuffer(state) + getBufferedBytes(state), data, i);
-          state[kBufferedBytes] += i;
+          missingBytes = 0;
+          memcpy(incompleteChar + bufferedBytes, data, i);
+          bufferedBytes += i;
           data += i;
           nread -= i;
           break;
@@ -720,141 +744,132 @@ v8::Local<v8::String> BufferUtil::decode(jsg::Lock& js,
       }
     }
 
-    size_t found_bytes = std::min(nread, static_cast<size_t>(getMissingBytes(state)));
-    memcpy(getIncompleteCharacterBuffer(state) + getBufferedBytes(state), data, found_bytes);
+    size_t found_bytes = kj::min(nread, static_cast<size_t>(missingBytes));
+    memcpy(incompleteChar + bufferedBytes, data, found_bytes);
     // Adjust the two buffers.
     data += found_bytes;
     nread -= found_bytes;
 
-    state[kMissingBytes] -= found_bytes;
-    state[kBufferedBytes] += found_bytes;
+    missingBytes -= found_bytes;
+    bufferedBytes += found_bytes;
 
-    if (getMissingBytes(state) == 0) {
+    if (missingBytes == 0) {
       // If no more bytes are missing, create a small string that we will later prepend.
-      prepend = getBufferedString(js, state);
+      prepend = takeBufferedString(js);
     }
   }
 
   if (nread == 0) {
-    body = !prepend.IsEmpty() ? prepend : v8::String::Empty(js.v8Isolate);
-    prepend = v8::Local<v8::String>();
-  } else {
-    JSG_REQUIRE(getMissingBytes(state) == 0, Error, "Invalid StringDecoder state");
-    JSG_REQUIRE(getBufferedBytes(state) == 0, Error, "Invalid StringDecoder state");
-
-    // See whether there is a character that we may have to cut off and
-    // finish when receiving the next chunk.
-    if (enc == Encoding::UTF8 && data[nread - 1] & 0x80) {
-      // This is UTF-8 encoded data and we ended on a non-ASCII UTF-8 byte.
-      // This means we'll need to figure out where the character to which
-      // the byte belongs begins.
-      for (size_t i = nread - 1; ; --i) {
-        JSG_REQUIRE(i < nread, Error, "Invalid StringDecoder state");
-        state[kBufferedBytes]++;
-        if ((data[i] & 0xC0) == 0x80) {
-          // This byte does not start a character (a "trailing" byte).
-          if (state[kBufferedBytes] >= 4 || i == 0) {
-            // We either have more then 4 trailing bytes (which means
-            // the current character would not be inside the range for
-            // valid Unicode, and in particular cannot be represented
-            // through JavaScript's UTF-16-based approach to strings), or the
-            // current buffer does not contain the start of an UTF-8 character
-            // at all. Either way, this is invalid UTF8 and we can just
-            // let the engine's decoder handle it.
-            state[kBufferedBytes] = 0;
-            break;
-          }
+    return !prepend.IsEmpty() ? prepend : v8::String::Empty(js.v8Isolate);
+  }
+
+  KJ_DASSERT(missingBytes == 0 && bufferedBytes == 0);
+
+  // See whether there is a character that we may have to cut off and
+  // finish when receiving the next chunk.
+  if (enc == Encoding::UTF8 && data[nread - 1] & 0x80) {
+    // This is UTF-8 encoded data and we ended on a non-ASCII UTF-8 byte.
+    // This means we'll need to figure out where the character to which
+    // the byte belongs begins.
+    for (size_t i = nread - 1; ; --i) {
+      KJ_DASSERT(i < nread);
+      bufferedBytes++;
+      if ((data[i] & 0xC0) == 0x80) {
+        // This byte does not start a character (a "trailing" byte).
+        if (bufferedBytes >= MAX_CHAR_BYTES || i == 0) {
+          // We either have more then 4 trailing bytes (which means
+          // the current character would not be inside the range for
+          // valid Unicode, and in particular cannot be represented
+          // through JavaScript's UTF-16-based approach to strings), or the
+          // current buffer does not contain the start of an UTF-8 character
+          // at all. Either way, this is invalid UTF8 and we can just
+          // let the engine's decoder handle it.
+          bufferedBytes = 0;
+          break;
+        }
+      } else {
+        // Found the first byte of a UTF-8 character. By looking at the
+        // upper bits we can tell how long the character *should* be.
+        if ((data[i] & 0xE0) == 0xC0) {
+          missingBytes = 2;
+        } else if ((data[i] & 0xF0) == 0xE0) {
+          missingBytes = 3;
+        } else if ((data[i] & 0xF8) == 0xF0) {
+          missingBytes = 4;
         } else {
-          // Found the first byte of a UTF-8 character. By looking at the
-          // upper bits we can tell how long the character *should* be.
-          if ((data[i] & 0xE0) == 0xC0) {
-            state[kMissingBytes] = 2;
-          } else if ((data[i] & 0xF0) == 0xE0) {
-            state[kMissingBytes] = 3;
-          } else if ((data[i] & 0xF8) == 0xF0) {
-            state[kMissingBytes] = 4;
-          } else {
-            // This lead byte would indicate a character outside of the
-            // representable range.
-            state[kBufferedBytes] = 0;
-            break;
-          }
-
-          if (getBufferedBytes(state) >= getMissingBytes(state)) {
-            // Received more or exactly as many trailing bytes than the lead
-            // character would indicate. In the "==" case, we have valid
-            // data and don't need to slice anything off;
-            // in the ">" case, this is invalid UTF-8 anyway.
-            state[kMissingBytes] = 0;
-            state[kBufferedBytes] = 0;
-          }
-
-          state[kMissingBytes] -= state[kBufferedBytes];
+          // This lead byte would indicate a character outside of the
+          // representable range.
+          bufferedBytes = 0;
           break;
         }
+
+        if (bufferedBytes >= missingBytes) {
+          // Received more or exactly as many trailing bytes than the lead
+          // character would indicate. In the "==" case, we have valid
+          // data and don't need to slice anything off;
+          // in the ">" case, this is invalid UTF-8 anyway.
+          missingBytes = 0;
+          bufferedBytes = 0;
+        }
+
+        missingBytes -= bufferedBytes;
+        break;
       }
-    } else if (enc == Encoding::UTF16LE) {
-      if ((nread % 2) == 1) {
-        // We got half a codepoint, and need the second byte of it.
-        state[kBufferedBytes] = 1;
-        state[kMissingBytes] = 1;
-      } else if ((data[nread - 1] & 0xFC) == 0xD8) {
-        // Half a split UTF-16 character.
-        state[kBufferedBytes] = 2;
-        state[kMissingBytes] = 2;
-      }
-    } else if (enc == Encoding::BASE64 || enc == Encoding::BASE64URL) {
-      state[kBufferedBytes] = nread % 3;
-      if (state[kBufferedBytes] > 0)
-        state[kMissingBytes] = 3 - getBufferedBytes(state);
     }
-
-    if (getBufferedBytes(state) > 0) {
-      // Copy the requested number of buffered bytes from the end of the
-      // input into the incomplete character buffer.
-      nread -= getBufferedBytes(state);
-      memcpy(getIncompleteCharacterBuffer(state), data + nread, getBufferedBytes(state));
+  } else if (enc == Encoding::UTF16LE) {
+    if ((nread % 2) == 1) {
+      // We got half a codepoint, and need the second byte of it.
+      bufferedBytes = 1;
+      missingBytes = 1;
+    } else if ((data[nread - 1] & 0xFC) == 0xD8) {
+      // Half a split UTF-16 character.
+      bufferedBytes = 2;
+      missingBytes = 2;
+    }
+  } else if (enc == Encoding::BASE64 || enc == Encoding::BASE64URL) {
+    bufferedBytes = nread % 3;
+    if (bufferedBytes > 0) {
+      missingBytes = 3 - bufferedBytes;
     }
+  }
 
-    if (nread > 0) {
-      body = toStringImpl(js, kj::ArrayPtr<kj::byte>(data, data + nread), 0, nread, enc);
-    } else {
-      body = v8::String::Empty(js.v8Isolate);
-    }
+  if (bufferedBytes > 0) {
+    // Copy the requested number of buffered bytes from the end of the
+    // input into the incomplete character buffer.
+    nread -= bufferedBytes;
+    memcpy(incompleteChar, data + nread, bufferedBytes);
   }
 
-  if (prepend.IsEmpty()) {
-    return body;
+  if (nread > 0) {
+    // The body is decoded straight out of the caller's buffer.
+    body = toStringImpl(js, kj::arrayPtr(data, nread), 0, nread, enc);
   } else {
-    return v8::String::Concat(js.v8Isolate, prepend, body);
+    body = v8::String::Empty(js.v8Isolate);
   }
 
-  return v8::String::Empty(js.v8Isolate);
-}
-
-v8::Local<v8::String> BufferUtil::flush(jsg::Lock& js, kj::Array<kj::byte> state) {
-  JSG_REQUIRE(state.size() == BufferUtil::kSize, TypeError, "Invalid StringDecoder");
-  auto enc = getEncoding(state);
-  if (enc == Encoding::ASCII || enc == Encoding::HEX || enc == Encoding::LATIN1) {
-    JSG_REQUIRE(getMissingBytes(state) == 0, Error, "Invalid StringDecoder state");
-    JSG_REQUIRE(getBufferedBytes(state) == 0, Error, "Invalid StringDecoder state");
+  if (prepend.IsEmpty()) {
+    return body;
   }
+  // V8 represents the result as a rope over the two strings rather than copying the body.
+  return v8::String::Concat(js.v8Isolate, prepend, body);
+}
 
-  if (enc == Encoding::UTF16LE && getBufferedBytes(state) % 2 == 1) {
+v8::Local<v8::String> BufferUtil::StringDecoderHandle::end(jsg::Lock& js) {
+  auto enc = static_cast<Encoding>(encoding);
+  if (enc == Encoding::UTF16LE && bufferedBytes % 2 == 1) {
     // Ignore a single trailing byte, like the JS decoder does.
-    state[kMissingBytes]--;
-    state[kBufferedBytes]--;
+    missingBytes--;
+    bufferedBytes--;
   }
 
-  if (getBufferedBytes(state) == 0) {
+  if (bufferedBytes == 0) {
     return v8::String::Empty(js.v8Isolate);
   }
 
-  auto ret = getBufferedString(js, state);
-  state[kMissingBytes] = 0;
+  auto ret = takeBufferedString(js);
+  missingBytes = 0;
 
   return ret;
 }
 
 }  // namespace workerd::api::node {
-
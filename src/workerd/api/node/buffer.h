@@ -64,20 +64,52 @@ public:
                  uint32_t length,
                  kj::String encoding);
 
-  enum NativeDecoderFields {
-    kIncompleteCharactersStart = 0,
-    kIncompleteCharactersEnd = 4,
-    kMissingBytes = 4,
-    kBufferedBytes = 5,
-    kEncoding = 6,
-    kSize = 7,
+  class StringDecoderHandle final: public jsg::Object {
+    // The native state behind a node:string_decoder StringDecoder: the bytes of a character split
+    // across writes, and how many more bytes it needs. Keeping it here rather than in a JS buffer
+    // lets write() update it in place without checking or rebuilding it on every call.
+  public:
+    StringDecoderHandle(kj::byte encoding): encoding(encoding) {}
+
+    static jsg::Ref<StringDecoderHandle> constructor(int encoding);
+    // `encoding` is one of the values of the Encoding enum in buffer.c++, as chosen by
+    // internal_stringdecoder.ts.
+
+    v8::Local<v8::String> write(jsg::Lock& js, kj::Array<kj::byte> bytes);
+    v8::Local<v8::String> end(jsg::Lock& js);
+    // Returns whatever is left of an incomplete character, decoded as-is.
+
+    void reset();
+    // Drops any incomplete character, as StringDecoder.text() does before decoding.
+
+    kj::Array<kj::byte> getLastChar();
+    kj::byte getLastNeed() { return missingBytes; }
+    kj::byte getLastTotal() { return bufferedBytes + missingBytes; }
+
+    JSG_RESOURCE_TYPE(StringDecoderHandle) {
+      JSG_METHOD(write);
+      JSG_METHOD(end);
+      JSG_METHOD(reset);
+      JSG_READONLY_PROTOTYPE_PROPERTY(lastChar, getLastChar);
+      JSG_READONLY_PROTOTYPE_PROPERTY(lastNeed, getLastNeed);
+      JSG_READONLY_PROTOTYPE_PROPERTY(lastTotal, getLastTotal);
+    }
+
+  private:
+    static constexpr size_t MAX_CHAR_BYTES = 4;
+
+    kj::byte incompleteChar[MAX_CHAR_BYTES] = {};
+    // Bytes of a character that was cut off at the end of the previous write. Only the first
+    // `bufferedBytes` are meaningful, but the rest are left in place so that `lastChar` reports
+    // the same bytes Node.js does.
+
+    kj::byte missingBytes = 0;
+    kj::byte bufferedBytes = 0;
+    kj::byte encoding;
+
+    v8::Local<v8::String> takeBufferedString(jsg::Lock& js);
   };
 
-  v8::Local<v8::String> decode(jsg::Lock& js,
-                               kj::Array<kj::byte> bytes,
-                               kj::Array<kj::byte> state);
-  v8::Local<v8::String> flush(jsg::Lock& js, kj::Array<kj::byte> state);
-
   JSG_RESOURCE_TYPE(BufferUtil) {
     JSG_METHOD(byteLength);
     JSG_METHOD(compare);
@@ -89,14 +121,13 @@ public:
     JSG_METHOD(toString);
     JSG_METHOD(write);
 
-    // For StringDecoder
-    JSG_METHOD(decode);
-    JSG_METHOD(flush);
+    JSG_NESTED_TYPE(StringDecoderHandle);
   }
 };
 
-#define EW_NODE_BUFFER_ISOLATE_TYPES       \
-    api::node::BufferUtil,                 \
+#define EW_NODE_BUFFER_ISOLATE_TYPES                \
+    api::node::BufferUtil,                          \
+    api::node::BufferUtil::StringDecoderHandle,     \
     api::node::BufferUtil::CompareOptions
 
 }  // namespace workerd::api::node
@@ -17,6 +17,9 @@ public:
       : Impl(true, CryptoKeyUsageSet::privateKeyMask() |
                    CryptoKeyUsageSet::publicKeyMask()),
         keyData(kj::mv(keyData)) {}
+  ~SecretKey() noexcept(false) {
+    OPENSSL_cleanse(keyData.begin(), keyData.size());
+  }
 
   kj::StringPtr getAlgorithmName() const override { return "secret"_kj; }
   CryptoKey::AlgorithmVariant getAlgorithm() const override {
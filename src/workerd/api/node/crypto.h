@@ -84,9 +84,17 @@ public:
       unsigned md_len;
   };
 
+  kj::Array<kj::byte> oneShotHash(kj::String algorithm,
+                                  kj::OneOf<kj::Array<kj::byte>, kj::String> data);
+  // Backs crypto.hash(): digests `data` in one call, without a HashHandle or a heap-allocated
+  // EVP_MD_CTX. String data is hashed as UTF-8.
+
   // Pbkdf2
   kj::Array<kj::byte> getPbkdf(kj::Array<kj::byte> password, kj::Array<kj::byte> salt,
                                uint32_t num_iterations, uint32_t keylen, kj::String name);
+  jsg::Promise<kj::Array<kj::byte>> getPbkdfAsync(jsg::Lock& js, kj::Array<kj::byte> password,
+      kj::Array<kj::byte> salt, uint32_t num_iterations, uint32_t keylen, kj::String name);
+  // Like getPbkdf(), but derives the key on the crypto thread pool.
 
   // Keys
   struct KeyExportOptions {
@@ -165,8 +173,10 @@ public:
     JSG_METHOD(checkPrimeSync);
     // Hash
     JSG_NESTED_TYPE(HashHandle);
+    JSG_METHOD(oneShotHash);
     // Pbkdf2
     JSG_METHOD(getPbkdf);
+    JSG_METHOD(getPbkdfAsync);
     // Keys
     JSG_METHOD(exportKey);
     JSG_METHOD(equals);
@@ -260,3 +260,21 @@ export const hash_pipe_test = {
     await p.promise;
   }
 }
+
+export const hash_one_shot_test = {
+  test(ctrl, env, ctx) {
+    for (const algorithm of ['md5', 'sha1', 'sha256', 'sha512']) {
+      for (const input of ['', 'Test123', '½ + ¼ = ¾']) {
+        const expected = crypto.createHash(algorithm).update(input).digest();
+        assert.strictEqual(crypto.hash(algorithm, input), expected.toString('hex'));
+        assert.strictEqual(crypto.hash(algorithm, input, 'base64'), expected.toString('base64'));
+        assert.deepStrictEqual(crypto.hash(algorithm, input, 'buffer'), expected);
+        assert.strictEqual(crypto.hash(algorithm, Buffer.from(input)), expected.toString('hex'));
+      }
+    }
+
+    assert.throws(() => crypto.hash('sha1', 123), { code: 'ERR_INVALID_ARG_TYPE' });
+    assert.throws(() => crypto.hash('sha1', 'x', 'bogus'), { code: 'ERR_INVALID_ARG_VALUE' });
+    assert.throws(() => crypto.hash('bogus', 'x'), /Digest method not supported/);
+  }
+}
@@ -73,4 +73,27 @@ CryptoImpl::HashHandle::HashHandle(kj::String& algorithm, kj::Maybe<uint32_t> xo
   checkDigestLength(md, xofLen);
 };
 
+kj::Array<kj::byte> CryptoImpl::oneShotHash(kj::String algorithm,
+                                            kj::OneOf<kj::Array<kj::byte>, kj::String> data) {
+  const EVP_MD* md = EVP_get_digestbyname(algorithm.begin());
+  JSG_REQUIRE(md != nullptr, Error, "Digest method not supported");
+
+  kj::ArrayPtr<const kj::byte> bytes;
+  KJ_SWITCH_ONEOF(data) {
+    KJ_CASE_ONEOF(array, kj::Array<kj::byte>) {
+      bytes = array;
+    }
+    KJ_CASE_ONEOF(string, kj::String) {
+      bytes = string.asBytes();
+    }
+  }
+
+  // EVP_Digest() keeps its context on the stack, so this allocates nothing but the result.
+  kj::byte buffer[EVP_MAX_MD_SIZE];
+  unsigned len = 0;
+  JSG_REQUIRE(EVP_Digest(bytes.begin(), bytes.size(), buffer, &len, md, nullptr) == 1, Error,
+              "failed to compute hash digest");
+  return kj::heapArray<kj::byte>(buffer, len);
+}
+
 } // namespace workerd::api::node
@@ -193,3 +193,23 @@ export const secret_key_test = {
     ok(!key1.equals(key3));
   }
 };
+
+export const imported_key_is_independent_of_source_test = {
+  async test(ctrl, env, ctx) {
+    // Keys copy the bytes they are imported from; writing to the source afterwards must not
+    // change the key.
+    const keyData = Buffer.from('abcdefghijklmnop');
+    const hmac = await crypto.subtle.importKey('raw', keyData,
+        { name: 'HMAC', hash: 'SHA-256' }, true, ['sign', 'verify']);
+    const secret = createSecretKey(keyData);
+    const data = Buffer.from('hello');
+    const before = Buffer.from(await crypto.subtle.sign('HMAC', hmac, data));
+    keyData.fill(0);
+    const after = Buffer.from(await crypto.subtle.sign('HMAC', hmac, data));
+    ok(before.equals(after));
+    ok(await crypto.subtle.verify('HMAC', hmac, before, data));
+    strictEqual(secret.export().toString(), 'abcdefghijklmnop');
+    strictEqual(Buffer.from(await crypto.subtle.exportKey('raw', hmac)).toString(),
+                'abcdefghijklmnop');
+  }
+};
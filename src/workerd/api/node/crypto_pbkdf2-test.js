@@ -303,3 +303,21 @@ export const invalid_digest_tests = {
     }
   }
 }
+
+export const input_mutation_test = {
+  async test(ctrl, env, ctx) {
+    // The async derivation must not observe changes made to the inputs after the call returns.
+    const password = new Uint8Array([1, 2, 3, 4]);
+    const salt = new Uint8Array([5, 6, 7, 8]);
+    const expected = crypto.pbkdf2Sync(password, salt, 1000, 32, 'sha256');
+
+    const p = deferredPromise();
+    crypto.pbkdf2(password, salt, 1000, 32, 'sha256', (err, result) => {
+      if (err) return p.reject(err);
+      p.resolve(result);
+    });
+    password.fill(0);
+    salt.fill(0);
+    assert.deepStrictEqual(await p.promise, expected);
+  }
+}
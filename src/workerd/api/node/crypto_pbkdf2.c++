@@ -10,8 +10,13 @@
 
 namespace workerd::api::node {
 
-kj::Array<kj::byte> CryptoImpl::getPbkdf(kj::Array<kj::byte> password,
-kj::Array<kj::byte> salt, uint32_t num_iterations, uint32_t keylen, kj::String name) {
+namespace {
+
+kj::Function<kj::Array<kj::byte>()> preparePbkdf(kj::Array<kj::byte> password,
+    kj::Array<kj::byte> salt, uint32_t num_iterations, uint32_t keylen, kj::StringPtr name) {
+  // Validates the arguments and returns a job that performs the derivation. The job only uses
+  // what it owns, so it may run on the crypto thread pool.
+
   // Should not be needed based on current memory limits, still good to have
   JSG_REQUIRE(password.size() <= INT32_MAX, RangeError, "Pbkdf2 failed: password is too large");
   JSG_REQUIRE(salt.size() <= INT32_MAX, RangeError, "Pbkdf2 failed: salt is too large");
@@ -25,17 +30,38 @@ kj::Array<kj::byte> salt, uint32_t num_iterations, uint32_t keylen, kj::String n
   JSG_REQUIRE(digest != nullptr, TypeError, "Invalid Pbkdf2 digest: ", name,
               internalDescribeOpensslErrors());
 
-  // Both pass and salt may be zero length here.
-  auto buf = kj::heapArray<byte>(keylen);
-  OSSLCALL(PKCS5_PBKDF2_HMAC((const char *)password.begin(),
-                        password.size(),
-                        salt.begin(),
-                        salt.size(),
-                        num_iterations,
-                        digest,
-                        keylen,
-                        buf.begin()));
-  return buf;
+  return [password = kj::mv(password), salt = kj::mv(salt), num_iterations, keylen, digest]() {
+    // Both pass and salt may be zero length here.
+    auto buf = kj::heapArray<byte>(keylen);
+    OSSLCALL(PKCS5_PBKDF2_HMAC((const char *)password.begin(),
+                          password.size(),
+                          salt.begin(),
+                          salt.size(),
+                          num_iterations,
+                          digest,
+                          keylen,
+                          buf.begin()));
+    return buf;
+  };
+}
+
+}  // namespace
+
+kj::Array<kj::byte> CryptoImpl::getPbkdf(kj::Array<kj::byte> password,
+kj::Array<kj::byte> salt, uint32_t num_iterations, uint32_t keylen, kj::String name) {
+  return preparePbkdf(kj::mv(password), kj::mv(salt), num_iterations, keylen, name)();
+}
+
+jsg::Promise<kj::Array<kj::byte>> CryptoImpl::getPbkdfAsync(jsg::Lock& js,
+    kj::Array<kj::byte> password, kj::Array<kj::byte> salt, uint32_t num_iterations,
+    uint32_t keylen, kj::String name) {
+  return js.evalNow([&] {
+    // The buffers are shared with script, which keeps running while the job does, so the job gets
+    // its own copies.
+    auto job = preparePbkdf(kj::heapArray(password.asPtr()), kj::heapArray(salt.asPtr()),
+                            num_iterations, keylen, name);
+    return runOffThread(js, kj::mv(job));
+  });
 }
 
 }  // namespace workerd::api::node
@@ -116,3 +116,42 @@ export const test_tracing = {
     await Promise.all(promises.map(p => p.promise));
   }
 };
+
+export const test_subscriber_state = {
+  test(ctrl, env, ctx) {
+    const ch = channel('baz');
+    ok(!ch.hasSubscribers());
+    ok(!('subscriberState' in ch));
+
+    const listener = () => {};
+    subscribe('baz', listener);
+    ok(ch.hasSubscribers());
+    unsubscribe('baz', listener);
+    ok(!ch.hasSubscribers());
+
+    // Bound stores count as subscribers, as in Node.js.
+    const als = new AsyncLocalStorage();
+    ch.bindStore(als);
+    ok(ch.hasSubscribers());
+    ch.unbindStore(als);
+    ok(!ch.hasSubscribers());
+
+    // Without subscribers, tracing calls the function directly.
+    const tc = tracingChannel('qux');
+    ok(!tc.hasSubscribers);
+    const receiver = {};
+    strictEqual(tc.traceSync(function(a, b) {
+      strictEqual(this, receiver);
+      return a + b;
+    }, {}, receiver, 1, 2), 3);
+
+    const messages = [];
+    tc.subscribe({ end(message) { messages.push(message); } });
+    ok(tc.hasSubscribers);
+    const context = {};
+    strictEqual(tc.traceSync(() => 4, context), 4);
+    strictEqual(messages.length, 1);
+    strictEqual(messages[0], context);
+    strictEqual(context.result, 4);
+  }
+};
@@ -14,12 +14,35 @@ Channel::Channel(jsg::Name name) : name(kj::mv(name)) {}
 const jsg::Name& Channel::getName() const { return name; }
 
 bool Channel::hasSubscribers() {
-  return subscribers.size() != 0;
+  return subscribers.size() != 0 || stores.size() != 0;
 }
 
-void Channel::publish(jsg::Lock& js, jsg::Value message) {
+jsg::V8Ref<v8::Object> Channel::getSubscriberState(jsg::Lock& js) {
+  KJ_IF_MAYBE(state, subscriberState) {
+    return state->addRef(js);
+  }
+  auto state = v8::Object::New(js.v8Isolate);
+  jsg::check(state->Set(js.v8Context(), jsg::v8StrIntern(js.v8Isolate, "hasSubscribers"_kj),
+                        v8::Boolean::New(js.v8Isolate, hasSubscribers())));
+  subscriberState = js.v8Ref(state);
+  return js.v8Ref(state);
+}
+
+void Channel::updateSubscriberState(jsg::Lock& js, bool hadSubscribers) {
+  auto nowHasSubscribers = hasSubscribers();
+  if (nowHasSubscribers == hadSubscribers) return;
+  KJ_IF_MAYBE(state, subscriberState) {
+    jsg::check(state->getHandle(js)->Set(js.v8Context(),
+        jsg::v8StrIntern(js.v8Isolate, "hasSubscribers"_kj),
+        v8::Boolean::New(js.v8Isolate, nowHasSubscribers)));
+  }
+}
+
+void Channel::publish(jsg::Lock& js, v8::Local<v8::Value> message) {
+  // Takes the message as a local handle so that publishing to a channel nobody is listening on
+  // does not allocate.
   for (auto& sub : subscribers) {
-    sub.value(js, message.addRef(js), name.clone(js));
+    sub.value(js, js.v8Ref(message), name.clone(js));
   }
 
   auto& context = IoContext::current();
@@ -27,7 +50,7 @@ void Channel::publish(jsg::Lock& js, jsg::Value message) {
     jsg::Serializer ser(js.v8Isolate, jsg::Serializer::Options {
       .omitHeader = false,
     });
-    ser.write(message.getHandle(js));
+    ser.write(message);
     auto tmp = ser.release();
     JSG_REQUIRE(tmp.sharedArrayBuffers.size() == 0 &&
                 tmp.transferedArrayBuffers.size() == 0, Error,
@@ -38,13 +61,17 @@ void Channel::publish(jsg::Lock& js, jsg::Value message) {
 }
 
 void Channel::subscribe(jsg::Lock& js, jsg::Identified<MessageCallback> callback) {
+  auto hadSubscribers = hasSubscribers();
   subscribers.upsert(kj::mv(callback.identity),
                      kj::mv(callback.unwrapped),
                      [&](auto&, auto&&) {});
+  updateSubscriberState(js, hadSubscribers);
 }
 
 void Channel::unsubscribe(jsg::Lock& js, jsg::Identified<MessageCallback> callback) {
+  auto hadSubscribers = hasSubscribers();
   subscribers.erase(callback.identity);
+  updateSubscriberState(js, hadSubscribers);
 }
 
 void Channel::bindStore(jsg::Lock& js, jsg::Ref<AsyncLocalStorage> als,
@@ -61,6 +88,7 @@ void Channel::bindStore(jsg::Lock& js, jsg::Ref<AsyncLocalStorage> als,
     return;
   }
 
+  auto hadSubscribers = hasSubscribers();
   KJ_IF_MAYBE(transform, maybeTransform) {
     stores.insert({
       .key = kj::mv(key),
@@ -74,11 +102,14 @@ void Channel::bindStore(jsg::Lock& js, jsg::Ref<AsyncLocalStorage> als,
       }
     });
   }
+  updateSubscriberState(js, hadSubscribers);
 }
 
 void Channel::unbindStore(jsg::Lock& js, jsg::Ref<AsyncLocalStorage> als) {
   auto key = als->getKey();
+  auto hadSubscribers = hasSubscribers();
   stores.eraseMatch(*key);
+  updateSubscriberState(js, hadSubscribers);
 }
 
 v8::Local<v8::Value> Channel::runStores(
@@ -91,7 +122,7 @@ v8::Local<v8::Value> Channel::runStores(
         store.transform(js, message.addRef(js)));
   };
 
-  publish(js, message.addRef(js));
+  publish(js, message.getHandle(js));
 
   auto context = js.v8Context();
   auto receiver = maybeReceiver.orDefault([&]() -> v8::Local<v8::Value> {
@@ -113,6 +144,7 @@ void Channel::visitForGc(jsg::GcVisitor& visitor) {
   for (auto& store: stores) {
     visitor.visit(store.transform);
   }
+  visitor.visit(subscriberState);
 }
 
 bool DiagnosticsChannelModule::hasSubscribers(jsg::Lock& js, jsg::Name name) {
@@ -121,6 +153,15 @@ bool DiagnosticsChannelModule::hasSubscribers(jsg::Lock& js, jsg::Name name) {
   }).orDefault(false);
 }
 
+jsg::V8Ref<v8::Object> DiagnosticsChannelModule::getSubscriberState(
+    jsg::Lock& js, jsg::Ref<Channel> channel) {
+  return channel->getSubscriberState(js);
+}
+
+bool DiagnosticsChannelModule::isTraced() {
+  return IoContext::hasCurrent() && IoContext::current().getWorkerTracer() != nullptr;
+}
+
 void DiagnosticsChannelModule::subscribe(jsg::Lock& js,
                                          jsg::Name name,
                                          jsg::Identified<Channel::MessageCallback> callback) {
@@ -17,7 +17,15 @@ public:
   Channel(jsg::Name name);
 
   bool hasSubscribers();
-  void publish(jsg::Lock& js, jsg::Value message);
+  // True if the channel has any subscribers or bound stores, as in Node.js.
+
+  jsg::V8Ref<v8::Object> getSubscriberState(jsg::Lock& js);
+  // Returns a plain object whose `hasSubscribers` property always equals hasSubscribers(). The
+  // object is cached on the channel and updated in place whenever the answer changes, so the
+  // JavaScript half of the module can check it on hot paths without calling into C++. Only
+  // reachable through DiagnosticsChannelModule, which user code can't import.
+
+  void publish(jsg::Lock& js, v8::Local<v8::Value> message);
   void subscribe(jsg::Lock& js, jsg::Identified<MessageCallback> callback);
   void unsubscribe(jsg::Lock& js, jsg::Identified<MessageCallback> callback);
   void bindStore(jsg::Lock& js, jsg::Ref<AsyncLocalStorage> als,
@@ -64,6 +72,11 @@ private:
   jsg::Name name;
   kj::HashMap<jsg::HashableV8Ref<v8::Object>, MessageCallback> subscribers;
   kj::Table<StoreEntry, kj::HashIndex<StoreCallbacks>> stores;
+  kj::Maybe<jsg::V8Ref<v8::Object>> subscriberState;
+
+  void updateSubscriberState(jsg::Lock& js, bool hadSubscribers);
+  // Call after any change to `subscribers` or `stores`, passing the result of hasSubscribers()
+  // from before the change.
 
   void visitForGc(jsg::GcVisitor& visitor);
 };
@@ -76,11 +89,20 @@ public:
   void unsubscribe(jsg::Lock& js, jsg::Name name, jsg::Identified<Channel::MessageCallback> callback);
   // TODO: Support tracing channels
 
+  jsg::V8Ref<v8::Object> getSubscriberState(jsg::Lock& js, jsg::Ref<Channel> channel);
+  // See Channel::getSubscriberState().
+
+  bool isTraced();
+  // True if the current request has a worker tracer, which records every published message
+  // whether or not the channel has subscribers.
+
   JSG_RESOURCE_TYPE(DiagnosticsChannelModule) {
     JSG_METHOD(hasSubscribers);
     JSG_METHOD(channel);
     JSG_METHOD(subscribe);
     JSG_METHOD(unsubscribe);
+    JSG_METHOD(getSubscriberState);
+    JSG_METHOD(isTraced);
     JSG_NESTED_TYPE(Channel);
   }
 
@@ -5,6 +5,7 @@
 #include <workerd/jsg/buffersource.h>
 #include <workerd/jsg/ser.h>
 #include <workerd/api/global-scope.h>
+#include <workerd/api/node/buffer-base64.h>
 #include <kj/encoding.h>
 
 namespace workerd::api {
@@ -205,34 +206,46 @@ kj::Promise<void> WorkerQueue::sendBatch(
   auto serializedBodies = builder.finish();
 
   // Construct the request body by concatenating the messages together into a JSON message.
-  // Done manually to minimize copies, although it'd be nice to make this safer.
-  // (totalSize + 2) / 3 * 4 is equivalent to ceil(totalSize / 3) * 4 for base64 encoding overhead.
-  auto estimatedSize = (totalSize + 2) / 3 * 4 + messageCount * 32 + 32;
-  kj::Vector<char> bodyBuilder(estimatedSize);
-  bodyBuilder.addAll("{\"messages\":["_kj);
+  // Done manually to minimize copies, although it'd be nice to make this safer. The body's exact
+  // size is computed first so that each message can be base64-encoded directly into place.
+  constexpr auto PREFIX = "{\"messages\":["_kj;
+  constexpr auto BODY_START = "{\"body\":\""_kj;
+  constexpr auto CONTENT_TYPE_START = "\",\"contentType\":\""_kj;
+  constexpr auto MESSAGE_END = "\"}"_kj;
+  constexpr auto SUFFIX = "]}"_kj;
+
+  size_t bodySize = PREFIX.size() + SUFFIX.size() + (messageCount - 1);
+  for (auto& item: serializedBodies) {
+    bodySize += BODY_START.size() + node::base64_encoded_size(item.body.data.size()) + MESSAGE_END.size();
+    KJ_IF_MAYBE(contentType, item.contentType) {
+      bodySize += CONTENT_TYPE_START.size() + contentType->size();
+    }
+  }
+
+  kj::String body = kj::heapString(bodySize);
+  char* pos = body.begin();
+  auto append = [&pos](kj::StringPtr text) {
+    memcpy(pos, text.begin(), text.size());
+    pos += text.size();
+  };
+  append(PREFIX);
   for (size_t i = 0; i < messageCount; ++i) {
-    bodyBuilder.addAll("{\"body\":\""_kj);
-    // TODO(perf): We should be able to encode the data directly into bodyBuilder's buffer to
-    // eliminate a lot of data copying (whereas now encodeBase64 allocates a new buffer of its own
-    // to hold its result, which we then have to copy into bodyBuilder).
-    bodyBuilder.addAll(kj::encodeBase64(serializedBodies[i].body.data));
-    bodyBuilder.add('"');
+    append(BODY_START);
+    auto data = serializedBodies[i].body.data.asChars();
+    pos += node::base64_encode(data.begin(), data.size(), pos, body.end() - pos);
 
     KJ_IF_MAYBE(contentType, serializedBodies[i].contentType) {
-      bodyBuilder.addAll(",\"contentType\":\""_kj);
-      bodyBuilder.addAll(*contentType);
-      bodyBuilder.add('"');
+      append(CONTENT_TYPE_START);
+      append(*contentType);
     }
 
-    bodyBuilder.addAll("}"_kj);
+    append(MESSAGE_END);
     if (i < messageCount - 1) {
-      bodyBuilder.add(',');
+      *pos++ = ',';
     }
   }
-  bodyBuilder.addAll("]}"_kj);
-  bodyBuilder.add('\0');
-  KJ_DASSERT(bodyBuilder.size() <= estimatedSize);
-  kj::String body(bodyBuilder.releaseAsArray());
+  append(SUFFIX);
+  KJ_ASSERT(pos == body.end());
   KJ_DASSERT(jsg::check(
         v8::JSON::Parse(js.v8Isolate->GetCurrentContext(), jsg::v8Str(js.v8Isolate, body)))->IsObject());
 
@@ -270,7 +283,9 @@ kj::Promise<void> WorkerQueue::sendBatch(
   }).attach(kj::mv(client));
 };
 
-jsg::Value deserialize(jsg::Lock& js, kj::Array<kj::byte> body, kj::Maybe<kj::StringPtr> contentType) {
+jsg::Value deserialize(jsg::Lock& js, kj::Array<kj::byte>&& body,
+                       kj::Maybe<kj::StringPtr> contentType) {
+  // Only consumes `body` if it succeeds.
   auto type = contentType.orDefault(IncomingQueueMessage::ContentType::V8);
 
   if (type == IncomingQueueMessage::ContentType::TEXT) {
@@ -286,32 +301,15 @@ jsg::Value deserialize(jsg::Lock& js, kj::Array<kj::byte> body, kj::Maybe<kj::St
   }
 }
 
-jsg::Value deserialize(jsg::Lock& js, rpc::QueueMessage::Reader message) {
-  kj::StringPtr type = message.getContentType();
-  if (type == "") {
-    // default to v8 format
-    type = IncomingQueueMessage::ContentType::V8;
-  }
-
-  if (type == IncomingQueueMessage::ContentType::TEXT) {
-    return jsg::Value(js.v8Isolate, jsg::v8Str(js.v8Isolate, message.getData().asChars()));
-  } else if (type == IncomingQueueMessage::ContentType::BYTES) {
-    kj::Array<kj::byte> bytes = kj::heapArray(message.getData().asBytes());
-    return jsg::Value(js.v8Isolate, js.wrapBytes(kj::mv(bytes)));
-  } else if (type == IncomingQueueMessage::ContentType::JSON) {
-    return js.parseJson(jsg::v8Str(js.v8Isolate, message.getData().asChars()));
-  } else if (type == IncomingQueueMessage::ContentType::V8) {
-    return jsg::Value(js.v8Isolate, jsg::Deserializer(js.v8Isolate, message.getData()).readValue());
-  } else {
-    JSG_FAIL_REQUIRE(TypeError, kj::str("Unsupported queue message content type: ", type));
-  }
-}
-
 QueueMessage::QueueMessage(
     jsg::Lock& js, rpc::QueueMessage::Reader message, IoPtr<QueueEventResult> result)
     : id(kj::str(message.getId())),
       timestamp(message.getTimestampNs() * kj::NANOSECONDS + kj::UNIX_EPOCH),
-      body(deserialize(js, message)),
+      body(SerializedBody {
+        .data = kj::heapArray(message.getData().asBytes()),
+        .contentType = message.getContentType() == ""
+            ? kj::Maybe<kj::String>(nullptr) : kj::str(message.getContentType()),
+      }),
       result(result) {}
 // Note that we must make deep copies of all data here since the incoming Reader may be
 // deallocated while JS's GC wrappers still exist.
@@ -320,11 +318,25 @@ QueueMessage::QueueMessage(
     jsg::Lock& js, IncomingQueueMessage message, IoPtr<QueueEventResult> result)
     : id(kj::mv(message.id)),
       timestamp(message.timestamp),
-      body(deserialize(js, kj::mv(message.body), message.contentType)),
+      body(SerializedBody {
+        .data = kj::mv(message.body),
+        .contentType = kj::mv(message.contentType),
+      }),
       result(result) {}
 
 jsg::Value QueueMessage::getBody(jsg::Lock& js) {
-  return body.addRef(js);
+  KJ_SWITCH_ONEOF(body) {
+    KJ_CASE_ONEOF(serialized, SerializedBody) {
+      auto value = deserialize(js, kj::mv(serialized.data), serialized.contentType);
+      auto ref = value.addRef(js);
+      body = kj::mv(value);
+      return ref;
+    }
+    KJ_CASE_ONEOF(value, jsg::Value) {
+      return value.addRef(js);
+    }
+  }
+  KJ_UNREACHABLE;
 }
 
 void QueueMessage::retry() {
@@ -481,7 +493,9 @@ kj::Promise<WorkerInterface::CustomEvent::Result> QueueCustomEventImpl::run(
   }
 
   KJ_IF_MAYBE(t, incomingRequest->getWorkerTracer()) {
-    t->setEventInfo(context.now(), Trace::QueueEventInfo(kj::mv(queueName), batchSize));
+    t->setEventInfo(context.now(), [&]() -> Trace::EventInfo {
+      return Trace::QueueEventInfo(kj::mv(queueName), batchSize);
+    });
   }
 
   // Create a custom refcounted type for holding the queueEvent so that we can pass it to the
@@ -136,13 +136,22 @@ public:
   }
 
 private:
+  struct SerializedBody {
+    kj::Array<kj::byte> data;
+    kj::Maybe<kj::String> contentType;
+  };
+
   kj::String id;
   kj::Date timestamp;
-  jsg::Value body;
+  kj::OneOf<SerializedBody, jsg::Value> body;
+  // The body is only deserialized the first time it's read, so that a handler which acks or
+  // retries messages without looking at them doesn't pay for deserializing them.
   IoPtr<QueueEventResult> result;
 
   void visitForGc(jsg::GcVisitor& visitor) {
-    visitor.visit(body);
+    KJ_IF_MAYBE(value, body.tryGet<jsg::Value>()) {
+      visitor.visit(*value);
+    }
   }
 };
 
@@ -12,6 +12,7 @@
 #include <kj/encoding.h>
 #include <kj/compat/http.h>
 #include <capnp/compat/json.h>
+#include <workerd/util/http-date.h>
 #include <workerd/util/http-util.h>
 #include <workerd/api/r2-api.capnp.h>
 
@@ -21,10 +22,15 @@ static bool isWholeNumber(double x) {
   return modf(x, &intpart) == 0;
 }
 
-// TODO(perf): Would be nice to expose the v8 internals for parsing a date/stringifying it as
-// something an embedder can call directly rather than doing this rigamarole. It would also avoid
-// concerns about the user overriding the methods we're invoking.
 static kj::Date parseDate(jsg::Lock& js, kj::StringPtr value) {
+  // Dates in headers are almost always in one of the standard formats, which are parsed natively.
+  // Anything else goes through JavaScript's Date constructor, which is what decided what was
+  // accepted before, and so still does.
+  auto parsed = parseHttpDate(value);
+  KJ_IF_MAYBE(date, parsed) {
+    return *date;
+  }
+
   auto isolate = js.v8Isolate;
   const auto context = js.v8Context();
   const auto tmp = jsg::check(v8::Date::New(context, 0));
@@ -41,8 +47,12 @@ static kj::Date parseDate(jsg::Lock& js, kj::StringPtr value) {
 }
 
 static jsg::ByteString toUTCString(jsg::Lock& js, kj::Date date) {
-  // NOTE: If you need toISOString just unify it into this function as the only difference will be
-  // the function name called.
+  auto formatted = formatHttpDate(date);
+  KJ_IF_MAYBE(f, formatted) {
+    return jsg::ByteString(kj::mv(*f));
+  }
+
+  // Only years outside 0 to 9999 get here.
   auto isolate = js.v8Isolate;
   const auto context = js.v8Context();
   const auto converted = jsg::check(v8::Date::New(
@@ -664,6 +674,39 @@ jsg::Promise<jsg::Ref<R2MultipartUpload>> R2Bucket::createMultipartUpload(jsg::L
   });
 }
 
+jsg::Promise<jsg::Ref<R2Bucket::HeadResult>> R2Bucket::putLarge(jsg::Lock& js, kj::String key,
+    jsg::Ref<ReadableStream> value, jsg::Optional<PutLargeOptions> options,
+    const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType) {
+  return js.evalNow([&] {
+    size_t partSize = DEFAULT_PART_SIZE;
+    uint concurrency = DEFAULT_PART_CONCURRENCY;
+    MultipartOptions multipartOptions;
+
+    KJ_IF_MAYBE(o, options) {
+      KJ_IF_MAYBE(p, o->partSize) {
+        JSG_REQUIRE(isWholeNumber(*p) && *p >= MIN_PART_SIZE && *p <= MAX_PART_SIZE, RangeError,
+            "partSize must be a whole number of bytes between ", MIN_PART_SIZE, " and ",
+            MAX_PART_SIZE, " (inclusive). Actual value was: ", *p);
+        partSize = *p;
+      }
+      KJ_IF_MAYBE(c, o->concurrency) {
+        JSG_REQUIRE(*c >= 1 && *c <= MAX_PART_CONCURRENCY, RangeError,
+            "concurrency must be between 1 and ", MAX_PART_CONCURRENCY,
+            " (inclusive). Actual value was: ", *c);
+        concurrency = *c;
+      }
+      multipartOptions.httpMetadata = kj::mv(o->httpMetadata);
+      multipartOptions.customMetadata = kj::mv(o->customMetadata);
+    }
+
+    return createMultipartUpload(js, kj::mv(key), kj::mv(multipartOptions), errorType)
+        .then(js, [value = kj::mv(value), partSize, concurrency, &errorType]
+                  (jsg::Lock& js, jsg::Ref<R2MultipartUpload> upload) mutable {
+      return upload->uploadStream(js, kj::mv(value), partSize, concurrency, errorType);
+    });
+  });
+}
+
 jsg::Ref<R2MultipartUpload> R2Bucket::resumeMultipartUpload(jsg::Lock& js,
       kj::String key, kj::String uploadId, const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType) {
     return jsg::alloc<R2MultipartUpload>(kj::mv(key), kj::mv(uploadId), JSG_THIS);
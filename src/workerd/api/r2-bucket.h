@@ -169,6 +169,27 @@ public:
     JSG_STRUCT_TS_OVERRIDE(R2MultipartOptions);
   };
 
+  struct PutLargeOptions {
+    jsg::Optional<kj::OneOf<HttpMetadata, jsg::Ref<Headers>>> httpMetadata;
+    jsg::Optional<jsg::Dict<kj::String>> customMetadata;
+
+    jsg::Optional<double> partSize;
+    // Size in bytes of each part but the last. Defaults to DEFAULT_PART_SIZE.
+
+    jsg::Optional<int> concurrency;
+    // How many parts may be uploading at once. Defaults to DEFAULT_PART_CONCURRENCY. At most
+    // `partSize * concurrency` bytes of the stream are buffered at a time.
+
+    JSG_STRUCT(httpMetadata, customMetadata, partSize, concurrency);
+    JSG_STRUCT_TS_OVERRIDE(R2PutLargeOptions);
+  };
+
+  static constexpr size_t MIN_PART_SIZE = 5 << 20;
+  static constexpr size_t MAX_PART_SIZE = size_t(5) << 30;
+  static constexpr size_t DEFAULT_PART_SIZE = 10 << 20;
+  static constexpr int MAX_PART_CONCURRENCY = 16;
+  static constexpr int DEFAULT_PART_CONCURRENCY = 4;
+
   class HeadResult: public jsg::Object {
   public:
     HeadResult(kj::String name, kj::String version, double size,
@@ -324,6 +345,14 @@ public:
       jsg::Lock& js, kj::String key, jsg::Optional<MultipartOptions> options,
       const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType
   );
+  jsg::Promise<jsg::Ref<HeadResult>> putLarge(
+      jsg::Lock& js, kj::String key, jsg::Ref<ReadableStream> value,
+      jsg::Optional<PutLargeOptions> options,
+      const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType
+  );
+  // Stores a stream of any length as a multipart upload: the stream is split into parts which are
+  // uploaded several at a time, each retried if R2 fails transiently, and the upload completed.
+  // If anything fails, the upload is aborted.
   jsg::Ref<R2MultipartUpload> resumeMultipartUpload(
       jsg::Lock& js, kj::String key, kj::String uploadId,
       const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType
@@ -343,6 +372,7 @@ public:
     JSG_METHOD(put);
     JSG_METHOD(createMultipartUpload);
     JSG_METHOD(resumeMultipartUpload);
+    JSG_METHOD(putLarge);
     JSG_METHOD_NAMED(delete, delete_);
     JSG_METHOD(list);
 
@@ -5,6 +5,7 @@
 #include "r2-multipart.h"
 #include "r2-bucket.h"
 #include "r2-rpc.h"
+#include <algorithm>
 #include <array>
 #include <math.h>
 #include <kj/compat/http.h>
@@ -14,6 +15,35 @@
 
 namespace workerd::api::public_beta {
 
+static kj::String encodeUploadPartRequest(
+    kj::StringPtr key, kj::StringPtr uploadId, int partNumber) {
+  capnp::JsonCodec json;
+  json.handleByAnnotation<R2BindingRequest>();
+  json.setHasMode(capnp::HasMode::NON_DEFAULT);
+  capnp::MallocMessageBuilder requestMessage;
+
+  auto requestBuilder = requestMessage.initRoot<R2BindingRequest>();
+  requestBuilder.setVersion(VERSION_PUBLIC_BETA);
+  auto payloadBuilder = requestBuilder.initPayload();
+  auto uploadPartBuilder = payloadBuilder.initUploadPart();
+
+  uploadPartBuilder.setUploadId(uploadId);
+  uploadPartBuilder.setPartNumber(partNumber);
+  uploadPartBuilder.setObject(key);
+
+  return json.encode(requestBuilder);
+}
+
+static kj::String decodeUploadPartEtag(kj::ArrayPtr<const char> metadataPayload) {
+  capnp::MallocMessageBuilder responseMessage;
+  capnp::JsonCodec json;
+  json.handleByAnnotation<R2UploadPartResponse>();
+  auto responseBuilder = responseMessage.initRoot<R2UploadPartResponse>();
+
+  json.decode(metadataPayload, responseBuilder);
+  return kj::str(responseBuilder.getEtag());
+}
+
 jsg::Promise<R2MultipartUpload::UploadedPart> R2MultipartUpload::uploadPart(
   jsg::Lock& js,
   int partNumber,
@@ -26,21 +56,7 @@ jsg::Promise<R2MultipartUpload::UploadedPart> R2MultipartUpload::uploadPart(
     auto& context = IoContext::current();
     auto client = context.getHttpClient(this->bucket->clientIndex, true, nullptr, "r2_uploadPart"_kjc);
 
-    capnp::JsonCodec json;
-    json.handleByAnnotation<R2BindingRequest>();
-    json.setHasMode(capnp::HasMode::NON_DEFAULT);
-    capnp::MallocMessageBuilder requestMessage;
-
-    auto requestBuilder = requestMessage.initRoot<R2BindingRequest>();
-    requestBuilder.setVersion(VERSION_PUBLIC_BETA);
-    auto payloadBuilder = requestBuilder.initPayload();
-    auto uploadPartBuilder = payloadBuilder.initUploadPart();
-
-    uploadPartBuilder.setUploadId(uploadId);
-    uploadPartBuilder.setPartNumber(partNumber);
-    uploadPartBuilder.setObject(key);
-
-    auto requestJson = json.encode(requestBuilder);
+    auto requestJson = encodeUploadPartRequest(key, uploadId, partNumber);
     auto bucket = this->bucket->adminBucket.map([](auto&& s) { return kj::str(s); });
 
     kj::StringPtr components[1];
@@ -53,13 +69,7 @@ jsg::Promise<R2MultipartUpload::UploadedPart> R2MultipartUpload::uploadPart(
         (jsg::Lock& js, R2Result r2Result) mutable {
       r2Result.throwIfError("uploadPart", errorType);
 
-      capnp::MallocMessageBuilder responseMessage;
-      capnp::JsonCodec json;
-      json.handleByAnnotation<R2UploadPartResponse>();
-      auto responseBuilder = responseMessage.initRoot<R2UploadPartResponse>();
-
-      json.decode(KJ_ASSERT_NONNULL(r2Result.metadataPayload), responseBuilder);
-      kj::String etag = kj::str(responseBuilder.getEtag());
+      kj::String etag = decodeUploadPartEtag(KJ_ASSERT_NONNULL(r2Result.metadataPayload));
       UploadedPart uploadedPart = { partNumber, kj::mv(etag) };
       return uploadedPart;
     });
@@ -116,28 +126,33 @@ jsg::Promise<jsg::Ref<R2Bucket::HeadResult>> R2MultipartUpload::complete(
   });
 }
 
-jsg::Promise<void> R2MultipartUpload::abort(jsg::Lock& js, const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType) {
-  return js.evalNow([&] {
-    auto& context = IoContext::current();
-    auto client = context.getHttpClient(this->bucket->clientIndex, true, nullptr, "r2_abortMultipartUpload"_kjc);
+kj::Promise<R2Result> R2MultipartUpload::sendAbort(jsg::Lock& js) {
+  auto& context = IoContext::current();
+  auto client = context.getHttpClient(this->bucket->clientIndex, true, nullptr, "r2_abortMultipartUpload"_kjc);
 
-    capnp::JsonCodec json;
-    json.handleByAnnotation<R2BindingRequest>();
-    capnp::MallocMessageBuilder requestMessage;
+  capnp::JsonCodec json;
+  json.handleByAnnotation<R2BindingRequest>();
+  capnp::MallocMessageBuilder requestMessage;
 
-    auto requestBuilder = requestMessage.initRoot<R2BindingRequest>();
-    requestBuilder.setVersion(VERSION_PUBLIC_BETA);
-    auto abortMultipartUploadBuilder = requestBuilder.initPayload().initAbortMultipartUpload();
+  auto requestBuilder = requestMessage.initRoot<R2BindingRequest>();
+  requestBuilder.setVersion(VERSION_PUBLIC_BETA);
+  auto abortMultipartUploadBuilder = requestBuilder.initPayload().initAbortMultipartUpload();
 
-    abortMultipartUploadBuilder.setObject(key);
-    abortMultipartUploadBuilder.setUploadId(uploadId);
+  abortMultipartUploadBuilder.setObject(key);
+  abortMultipartUploadBuilder.setUploadId(uploadId);
 
-    auto requestJson = json.encode(requestBuilder);
+  auto requestJson = json.encode(requestBuilder);
 
-    kj::StringPtr components[1];
-    auto path = fillR2Path(components, this->bucket->adminBucket);
-    auto promise = doR2HTTPPutRequest(js, kj::mv(client), nullptr, nullptr, kj::mv(requestJson),
-                                      path, nullptr);
+  kj::StringPtr components[1];
+  auto path = fillR2Path(components, this->bucket->adminBucket);
+  return doR2HTTPPutRequest(js, kj::mv(client), nullptr, nullptr, kj::mv(requestJson),
+                            path, nullptr);
+}
+
+jsg::Promise<void> R2MultipartUpload::abort(jsg::Lock& js, const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType) {
+  return js.evalNow([&] {
+    auto& context = IoContext::current();
+    auto promise = sendAbort(js);
 
     return context.awaitIo(js, kj::mv(promise), [&errorType](jsg::Lock& js, R2Result r) {
       if (r.objectNotFound()) {
@@ -148,4 +163,251 @@ jsg::Promise<void> R2MultipartUpload::abort(jsg::Lock& js, const jsg::TypeHandle
     });
   });
 }
+
+class R2MultipartUpload::PartUploader final: public kj::Refcounted,
+                                             private kj::TaskSet::ErrorHandler {
+  // Splits the stream written to its Sink into parts, and uploads them, for uploadStream().
+  //
+  // A part's buffer is only allocated once fewer than `concurrency` parts are uploading, and a
+  // write waits until it can be, so at most `concurrency` buffers exist at once.
+
+public:
+  PartUploader(IoContext& context, uint clientIndex, kj::Maybe<kj::String> adminBucket,
+               kj::String key, kj::String uploadId, size_t partSize, uint concurrency)
+      : context(context), clientIndex(clientIndex), adminBucket(kj::mv(adminBucket)),
+        key(kj::mv(key)), uploadId(kj::mv(uploadId)), partSize(partSize),
+        concurrency(concurrency), tasks(*this) {}
+
+  class Sink final: public WritableStreamSink {
+  public:
+    explicit Sink(kj::Own<PartUploader> uploader): uploader(kj::mv(uploader)) {}
+
+    kj::Promise<void> write(const void* buffer, size_t size) override {
+      return uploader->write(kj::arrayPtr(reinterpret_cast<const kj::byte*>(buffer), size));
+    }
+    kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const kj::byte>> pieces) override {
+      kj::Promise<void> promise = kj::READY_NOW;
+      for (auto piece: pieces) {
+        promise = promise.then([this, piece]() { return uploader->write(piece); });
+      }
+      return promise;
+    }
+    kj::Promise<void> end() override {
+      return uploader->end();
+    }
+    void abort(kj::Exception reason) override {
+      uploader->fail(kj::mv(reason));
+    }
+
+  private:
+    kj::Own<PartUploader> uploader;
+  };
+
+  kj::Maybe<kj::Exception> failure;
+  kj::Maybe<R2Result> r2Failure;
+  // The first failure, if any. R2's own errors are kept as they are, to be thrown to JavaScript
+  // like uploadPart() would throw them.
+
+  kj::Array<UploadedPart> takeParts() {
+    std::sort(parts.begin(), parts.end(), [](const UploadedPart& a, const UploadedPart& b) {
+      return a.partNumber < b.partNumber;
+    });
+    return parts.releaseAsArray();
+  }
+
+private:
+  static constexpr uint MAX_ATTEMPTS = 3;
+  static constexpr int MAX_PARTS = 10000;
+
+  IoContext& context;
+  uint clientIndex;
+  kj::Maybe<kj::String> adminBucket;
+  kj::String key;
+  kj::String uploadId;
+  size_t partSize;
+  uint concurrency;
+
+  kj::Array<kj::byte> buffer;
+  // The part being filled, if any.
+  size_t filled = 0;
+
+  int nextPartNumber = 1;
+  uint inFlight = 0;
+  kj::Vector<UploadedPart> parts;
+
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> progress;
+  // Fulfilled when a part finishes uploading.
+
+  kj::TaskSet tasks;
+
+  kj::Promise<void> write(kj::ArrayPtr<const kj::byte> data) {
+    throwIfFailed();
+    while (data.size() > 0) {
+      if (buffer == nullptr) {
+        if (inFlight >= concurrency) {
+          return waitForProgress().then([this, data]() { return write(data); });
+        }
+        buffer = kj::heapArray<kj::byte>(partSize);
+        filled = 0;
+      }
+
+      size_t amount = kj::min(data.size(), partSize - filled);
+      memcpy(buffer.begin() + filled, data.begin(), amount);
+      filled += amount;
+      data = data.slice(amount, data.size());
+
+      if (filled == partSize) {
+        startPart(kj::mv(buffer));
+      }
+    }
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> end() {
+    throwIfFailed();
+    if (buffer != nullptr) {
+      startPart(kj::heapArray(buffer.slice(0, filled)));
+      buffer = nullptr;
+    } else if (nextPartNumber == 1) {
+      // An upload needs at least one part, even if it's empty.
+      startPart(nullptr);
+    }
+    return whenIdle();
+  }
+
+  void fail(kj::Exception&& exception) {
+    if (failure == nullptr) {
+      failure = kj::mv(exception);
+    }
+  }
+
+  void throwIfFailed() {
+    KJ_IF_MAYBE(e, failure) {
+      kj::throwFatalException(kj::cp(*e));
+    }
+    if (r2Failure != nullptr) {
+      // uploadStream() throws the real error.
+      kj::throwFatalException(KJ_EXCEPTION(FAILED, "jsg.Error: R2 uploadPart failed."));
+    }
+  }
+
+  kj::Promise<void> waitForProgress() {
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    progress = kj::mv(paf.fulfiller);
+    return kj::mv(paf.promise);
+  }
+
+  kj::Promise<void> whenIdle() {
+    throwIfFailed();
+    if (inFlight == 0) return kj::READY_NOW;
+    return waitForProgress().then([this]() { return whenIdle(); });
+  }
+
+  void startPart(kj::Array<kj::byte> data) {
+    int partNumber = nextPartNumber++;
+    JSG_REQUIRE(partNumber <= MAX_PARTS, RangeError,
+        "The stream needs more than ", MAX_PARTS, " parts; use a larger partSize.");
+
+    ++inFlight;
+    tasks.add(uploadPart(partNumber, kj::mv(data), 1).then([this]() {
+      partDone();
+    }, [this](kj::Exception&& exception) {
+      fail(kj::mv(exception));
+      partDone();
+    }));
+  }
+
+  void partDone() {
+    --inFlight;
+    KJ_IF_MAYBE(f, progress) {
+      (*f)->fulfill();
+      progress = nullptr;
+    }
+  }
+
+  kj::Promise<void> uploadPart(int partNumber, kj::Array<kj::byte> data, uint attempt) {
+    // `data` is kept here, rather than handed to the request, so that it can be sent again.
+    kj::Array<kj::byte> body(data.begin(), data.size(), kj::NullArrayDisposer::instance);
+    auto promise = context.run(
+        [this, partNumber, body = kj::mv(body)](jsg::Lock& js) mutable {
+      auto client = context.getHttpClient(clientIndex, true, nullptr, "r2_uploadPart"_kjc);
+      kj::StringPtr components[1];
+      auto path = fillR2Path(components, adminBucket);
+      return doR2HTTPPutRequest(js, kj::mv(client), R2PutValue(kj::mv(body)), nullptr,
+          encodeUploadPartRequest(key, uploadId, partNumber), path, nullptr);
+    });
+
+    using Outcome = kj::OneOf<R2Result, kj::Exception>;
+    return promise.then([](R2Result result) -> Outcome {
+      return kj::mv(result);
+    }, [](kj::Exception&& exception) -> Outcome {
+      return kj::mv(exception);
+    }).then([this, partNumber, data = kj::mv(data), attempt](Outcome outcome) mutable
+        -> kj::Promise<void> {
+      KJ_SWITCH_ONEOF(outcome) {
+        KJ_CASE_ONEOF(result, R2Result) {
+          if (result.toThrow == nullptr) {
+            parts.add(UploadedPart {
+              partNumber, decodeUploadPartEtag(KJ_ASSERT_NONNULL(result.metadataPayload))
+            });
+          } else if (result.httpStatus >= 500 && attempt < MAX_ATTEMPTS) {
+            return uploadPart(partNumber, kj::mv(data), attempt + 1);
+          } else if (r2Failure == nullptr) {
+            r2Failure = kj::mv(result);
+          }
+        }
+        KJ_CASE_ONEOF(exception, kj::Exception) {
+          if (exception.getType() == kj::Exception::Type::DISCONNECTED &&
+              attempt < MAX_ATTEMPTS) {
+            return uploadPart(partNumber, kj::mv(data), attempt + 1);
+          }
+          fail(kj::mv(exception));
+        }
+      }
+      return kj::READY_NOW;
+    });
+  }
+
+  void taskFailed(kj::Exception&& exception) override {
+    // startPart() handles every failure, so this can't happen.
+    KJ_LOG(ERROR, exception);
+  }
+};
+
+jsg::Promise<jsg::Ref<R2Bucket::HeadResult>> R2MultipartUpload::uploadStream(
+    jsg::Lock& js, jsg::Ref<ReadableStream> value, size_t partSize, uint concurrency,
+    const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType) {
+  auto& context = IoContext::current();
+  auto uploader = kj::refcounted<PartUploader>(context, this->bucket->clientIndex,
+      this->bucket->adminBucket.map([](auto&& s) { return kj::str(s); }),
+      kj::str(key), kj::str(uploadId), partSize, concurrency);
+
+  auto pump = value->pumpTo(js, kj::heap<PartUploader::Sink>(kj::addRef(*uploader)), true);
+  auto promise = context.waitForDeferredProxy(kj::mv(pump))
+      .then([]() -> kj::Maybe<kj::Exception> {
+    return nullptr;
+  }, [](kj::Exception&& exception) -> kj::Maybe<kj::Exception> {
+    return kj::mv(exception);
+  });
+
+  return context.awaitIo(js, kj::mv(promise),
+      [self = JSG_THIS, uploader = kj::mv(uploader), &errorType]
+      (jsg::Lock& js, kj::Maybe<kj::Exception> error) mutable
+          -> jsg::Promise<jsg::Ref<R2Bucket::HeadResult>> {
+    if (error != nullptr || uploader->r2Failure != nullptr) {
+      // Don't leave the parts that did upload behind. This is best-effort: if it fails, R2
+      // eventually cleans up abandoned uploads by itself.
+      IoContext::current().addWaitUntil(self->sendAbort(js).then([](R2Result) {},
+          [](kj::Exception&&) {}));
+
+      KJ_IF_MAYBE(r, uploader->r2Failure) {
+        r->throwIfError("uploadPart", errorType);
+      }
+      kj::throwFatalException(kj::mv(KJ_ASSERT_NONNULL(error)));
+    }
+
+    return self->complete(js, uploader->takeParts(), errorType);
+  });
+}
+
 }
@@ -36,6 +36,13 @@ class R2MultipartUpload: public jsg::Object {
         const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType
     );
 
+    jsg::Promise<jsg::Ref<R2Bucket::HeadResult>> uploadStream(
+        jsg::Lock& js, jsg::Ref<ReadableStream> value, size_t partSize, uint concurrency,
+        const jsg::TypeHandler<jsg::Ref<R2Error>>& errorType);
+    // Uploads all of `value` as consecutive parts of `partSize` bytes, with up to `concurrency`
+    // of them in flight, then completes the upload. Aborts the upload if that fails. This is
+    // R2Bucket::putLarge(), once the upload is created.
+
     JSG_RESOURCE_TYPE(R2MultipartUpload) {
       JSG_LAZY_READONLY_INSTANCE_PROPERTY(key, getKey);
       JSG_LAZY_READONLY_INSTANCE_PROPERTY(uploadId, getUploadId);
@@ -50,6 +57,10 @@ class R2MultipartUpload: public jsg::Object {
     jsg::Ref<R2Bucket> bucket;
 
   private:
+    class PartUploader;
+
+    kj::Promise<R2Result> sendAbort(jsg::Lock& js);
+
     void visitForGc(jsg::GcVisitor& visitor) {
       visitor.visit(bucket);
     }
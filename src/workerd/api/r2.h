@@ -21,6 +21,7 @@ namespace workerd::api::public_beta {
     api::public_beta::R2Bucket::GetOptions, \
     api::public_beta::R2Bucket::PutOptions, \
     api::public_beta::R2Bucket::MultipartOptions, \
+    api::public_beta::R2Bucket::PutLargeOptions, \
     api::public_beta::R2Bucket::Checksums, \
     api::public_beta::R2Bucket::StringChecksums, \
     api::public_beta::R2Bucket::HttpMetadata, \
@@ -213,8 +213,13 @@ jsg::Ref<Socket> connectImplNoOutputLock(
   auto httpClient = asHttpClient(kj::mv(client));
   kj::HttpConnectSettings httpConnectSettings = { .useTls = false };
   KJ_IF_MAYBE(opts, options) {
-    httpConnectSettings.useTls =
-        parseSecureTransport(opts) == SecureTransportKind::ON;
+    auto secureTransport = parseSecureTransport(opts);
+    httpConnectSettings.useTls = secureTransport == SecureTransportKind::ON;
+    if (opts->pooled.orDefault(false) && secureTransport != SecureTransportKind::STARTTLS) {
+      // The network service keeps a separate pool for each Worker that calls it, so there's
+      // nothing to identify here; the header just asks for pooling.
+      headers->set(ioContext.getHeaderIds().cfConnectionPool, "1"_kj);
+    }
   }
   kj::Own<kj::TlsStarterCallback> tlsStarter = kj::heap<kj::TlsStarterCallback>();
   httpConnectSettings.tlsStarter = tlsStarter;
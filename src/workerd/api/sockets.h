@@ -29,7 +29,11 @@ typedef kj::OneOf<SocketAddress, kj::String> AnySocketAddress;
 struct SocketOptions {
   jsg::Optional<kj::String> secureTransport;
   bool allowHalfOpen = false;
-  JSG_STRUCT(secureTransport, allowHalfOpen);
+  jsg::Optional<bool> pooled;
+  // Asks for the connection to be reused by a later `connect()` to the same address once this
+  // socket is closed, rather than being torn down, if the network service keeps a connection
+  // pool. Ignored for `secureTransport: "starttls"`.
+  JSG_STRUCT(secureTransport, allowHalfOpen, pooled);
 };
 
 struct TlsOptions {
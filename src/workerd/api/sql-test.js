@@ -26,6 +26,34 @@ async function test(storage) {
   assert.equal(resultNumberRaw[0].length, 1);
   assert.equal(resultNumberRaw[0][0], 123);
 
+  {
+    // Rows are cloned from a per-query template; make sure values don't leak between rows.
+    const result = [...sql.exec(
+        "SELECT 1 AS a, 'x' AS b UNION ALL SELECT NULL, x'01' UNION ALL SELECT 3.5, 'z'")];
+    assert.equal(result.length, 3);
+    assert.deepEqual(Object.keys(result[1]), ["a", "b"]);
+    assert.equal(result[0].a, 1);
+    assert.equal(result[0].b, "x");
+    assert.equal(result[1].a, null);
+    assert.equal(new Uint8Array(result[1].b)[0], 1);
+    assert.equal(result[2].a, 3.5);
+    assert.equal(result[2].b, "z");
+
+    const raw = [...sql.exec(
+        "SELECT 1 AS a, 'x' AS b UNION ALL SELECT NULL, x'01' UNION ALL SELECT 3.5, 'z'").raw()];
+    assert.deepEqual(raw[0], [1, "x"]);
+    assert.equal(raw[1][0], null);
+    assert.deepEqual(raw[2], [3.5, "z"]);
+  }
+
+  {
+    // A column named __proto__ is an ordinary property.
+    const result = [...sql.exec("SELECT 1 AS __proto__")];
+    assert.equal(Object.getPrototypeOf(result[0]), Object.prototype);
+    assert.ok(Object.hasOwn(result[0], "__proto__"));
+    assert.equal(result[0]["__proto__"], 1);
+  }
+
   // Test string results
   const resultStr = [...sql.exec("SELECT 'hello'")];
   assert.equal(resultStr.length, 1);
@@ -168,6 +196,24 @@ async function test(storage) {
     assert.equal(xInfo[1].name, "bar");
   }
 
+  // Cursors report execution statistics.
+  {
+    const insert = sql.exec("INSERT INTO myTable VALUES ('a', 1), ('b', 2), ('c', 3)");
+    assert.equal([...insert].length, 0);
+    assert.equal(insert.rowsWritten, 3);
+    assert.equal(insert.rowsRead, 0);
+
+    // A full table scan counts the rows it visits, even if it returns only one. (SQLite only
+    // counts the steps from one row to the next, so this is 2, not 3.)
+    const scan = sql.exec("SELECT foo FROM myTable WHERE bar = 2");
+    assert.equal([...scan].length, 1);
+    assert.equal(scan.rowsRead, 2);
+    assert.equal(scan.rowsWritten, 0);
+    assert.ok(scan.duration >= 0);
+
+    sql.exec("DELETE FROM myTable");
+  }
+
   // Can't get table_info for _cf_KV.
   requireException(() => sql.exec("PRAGMA table_info(_cf_KV)"), "not authorized");
 
@@ -5,6 +5,7 @@
 #include "sql.h"
 #include "actor-state.h"
 #include "workerd/io/io-context.h"
+#include <workerd/jsg/util.h>
 
 namespace workerd::api {
 
@@ -13,14 +14,51 @@ SqlStorage::SqlStorage(SqliteDatabase& sqlite, jsg::Ref<DurableObjectStorage> st
 
 SqlStorage::~SqlStorage() {}
 
+class SqlStorage::Regulator final: public SqliteDatabase::Regulator {
+public:
+  bool isAllowedName(kj::StringPtr name) override {
+    return !name.startsWith("_cf_");
+  }
+
+  bool isAllowedTrigger(kj::StringPtr name) override {
+    return true;
+  }
+
+  void onError(kj::StringPtr message) override {
+    JSG_ASSERT(false, Error, message);
+  }
+
+  bool enforceVmStepLimit() override {
+    return true;
+  }
+
+  bool allowTransactions() override {
+    if (IoContext::hasCurrent()) {
+      IoContext::current().logWarningOnce(
+          "To execute a transaction, please use the state.storage.transaction() API instead of "
+          "the SQL BEGIN TRANSACTION or SAVEPOINT statements. The JavaScript API is safer because "
+          "it will automatically roll back on exceptions, and because it interacts correctly "
+          "with Durable Objects' automatic atomic write coalescing.");
+    }
+    return false;
+  }
+};
+
+SqlStorage::Regulator SqlStorage::regulator;
+
 jsg::Ref<SqlStorage::Cursor> SqlStorage::exec(jsg::Lock& js, kj::String querySql,
                                               jsg::Arguments<BindingValue> bindings) {
-  SqliteDatabase::Regulator& regulator = *this;
+  auto& cache = sqlite->getStatementCache(regulator, STATEMENT_CACHE_SIZE);
+  KJ_IF_MAYBE(statement, cache.find(querySql)) {
+    return jsg::alloc<Cursor>(kj::mv(*statement), kj::mv(bindings));
+  }
+
+  // Multi-statement code can't be cached.
   return jsg::alloc<Cursor>(*sqlite, regulator, querySql, kj::mv(bindings));
 }
 
 jsg::Ref<SqlStorage::Statement> SqlStorage::prepare(jsg::Lock& js, kj::String query) {
-  return jsg::alloc<Statement>(sqlite->prepare(*this, query));
+  return jsg::alloc<Statement>(sqlite->prepare(regulator, query));
 }
 
 double SqlStorage::getDatabaseSize() {
@@ -31,29 +69,6 @@ double SqlStorage::getDatabaseSize() {
   return pages * getPageSize();
 }
 
-bool SqlStorage::isAllowedName(kj::StringPtr name) {
-  return !name.startsWith("_cf_");
-}
-
-bool SqlStorage::isAllowedTrigger(kj::StringPtr name) {
-  return true;
-}
-
-void SqlStorage::onError(kj::StringPtr message) {
-  JSG_ASSERT(false, Error, message);
-}
-
-bool SqlStorage::allowTransactions() {
-  if (IoContext::hasCurrent()) {
-    IoContext::current().logWarningOnce(
-        "To execute a transaction, please use the state.storage.transaction() API instead of the "
-        "SQL BEGIN TRANSACTION or SAVEPOINT statements. The JavaScript API is safer because it "
-        "will automatically roll back on exceptions, and because it interacts correctly with "
-        "Durable Objects' automatic atomic write coalescing.");
-  }
-  return false;
-}
-
 SqlStorage::Cursor::State::State(
     kj::RefcountedWrapper<SqliteDatabase::Statement>& statement,
     kj::Array<BindingValue> bindingsParam)
@@ -61,6 +76,13 @@ SqlStorage::Cursor::State::State(
       bindings(kj::mv(bindingsParam)),
       query(statement.getWrapped().run(mapBindings(bindings).asPtr())) {}
 
+SqlStorage::Cursor::State::State(
+    kj::Own<SqliteDatabase::Statement> statement, kj::Array<BindingValue> bindingsParam)
+    : bindings(kj::mv(bindingsParam)),
+      query(statement->run(mapBindings(bindings).asPtr())) {
+  dependency = kj::mv(statement);
+}
+
 SqlStorage::Cursor::State::State(
     SqliteDatabase& db, SqliteDatabase::Regulator& regulator,
     kj::StringPtr sqlCode, kj::Array<BindingValue> bindingsParam)
@@ -82,11 +104,18 @@ void SqlStorage::Cursor::CachedColumnNames::ensureInitialized(
     jsg::Lock& js, SqliteDatabase::Query& source) {
   if (names == nullptr) {
     v8::HandleScope scope(js.v8Isolate);
+    auto context = js.v8Context();
+    auto row = v8::Object::New(js.v8Isolate);
     auto builder = kj::heapArrayBuilder<jsg::V8Ref<v8::String>>(source.columnCount());
     for (auto i: kj::zeroTo(builder.capacity())) {
-      builder.add(js.v8Isolate, jsg::v8StrIntern(js.v8Isolate, source.getColumnName(i)));
+      auto name = jsg::v8StrIntern(js.v8Isolate, source.getColumnName(i));
+      // CreateDataProperty() rather than Set() so that a column named `__proto__` is just a
+      // column.
+      jsg::check(row->CreateDataProperty(context, name, v8::Null(js.v8Isolate)));
+      builder.add(js.v8Isolate, name);
     }
     names = builder.finish();
+    rowTemplate = jsg::V8Ref<v8::Object>(js.v8Isolate, row);
   }
 }
 
@@ -97,43 +126,38 @@ jsg::Ref<SqlStorage::Cursor::RowIterator> SqlStorage::Cursor::rows(jsg::Lock& js
   return jsg::alloc<RowIterator>(JSG_THIS);
 }
 
-kj::Maybe<SqlStorage::Cursor::RowDict> SqlStorage::Cursor::rowIteratorNext(
+kj::Maybe<v8::Local<v8::Object>> SqlStorage::Cursor::rowIteratorNext(
     jsg::Lock& js, jsg::Ref<Cursor>& obj) {
+  auto& query = KJ_UNWRAP_OR(advance(*obj), return nullptr);
+
+  auto context = js.v8Context();
   auto names = obj->cachedColumnNames.get();
-  return iteratorImpl(js, obj,
-      [&](State& state, uint i, Value&& value) {
-    return RowDict::Field{
-      // A little trick here: We know there are no HandleScopes on the stack between JSG and here,
-      // so we can return a dict keyed by local handles, which avoids constructing new V8Refs here
-      // which would be relatively slower.
-      .name = names[i].getHandle(js),
-      .value = kj::mv(value)
-    };
-  }).map([&](kj::Array<RowDict::Field>&& fields) {
-    return RowDict { .fields = kj::mv(fields) };
-  });
+  auto row = obj->cachedColumnNames.getRowTemplate(js)->Clone();
+  for (auto i: kj::indices(names)) {
+    jsg::check(row->CreateDataProperty(context, names[i].getHandle(js), getValue(js, query, i)));
+  }
+  return row;
 }
 
 jsg::Ref<SqlStorage::Cursor::RawIterator> SqlStorage::Cursor::raw(jsg::Lock&) {
   return jsg::alloc<RawIterator>(JSG_THIS);
 }
 
-kj::Maybe<kj::Array<SqlStorage::Cursor::Value>> SqlStorage::Cursor::rawIteratorNext(
+kj::Maybe<v8::Local<v8::Array>> SqlStorage::Cursor::rawIteratorNext(
     jsg::Lock& js, jsg::Ref<Cursor>& obj) {
-  return iteratorImpl(js, obj,
-      [&](State& state, uint i, Value&& value) {
-    return kj::mv(value);
-  });
-}
+  auto& query = KJ_UNWRAP_OR(advance(*obj), return nullptr);
 
-template <typename Func>
-auto SqlStorage::Cursor::iteratorImpl(jsg::Lock& js, jsg::Ref<Cursor>& obj, Func&& func)
-    -> kj::Maybe<kj::Array<
-        decltype(func(kj::instance<State&>(), uint(), kj::instance<Value&&>()))>> {
-  using Element = decltype(func(kj::instance<State&>(), uint(), kj::instance<Value&&>()));
+  uint count = query.columnCount();
+  KJ_STACK_ARRAY(v8::Local<v8::Value>, values, count, 32, 256);
+  for (auto i: kj::zeroTo(count)) {
+    values[i] = getValue(js, query, i);
+  }
+  return v8::Array::New(js.v8Isolate, values.begin(), values.size());
+}
 
-  auto& state = *KJ_UNWRAP_OR(obj->state, {
-    if (obj->canceled) {
+kj::Maybe<SqliteDatabase::Query&> SqlStorage::Cursor::advance(Cursor& cursor) {
+  auto& state = *KJ_UNWRAP_OR(cursor.state, {
+    if (cursor.canceled) {
       JSG_FAIL_REQUIRE(Error,
           "SQL cursor was closed because the same statement was executed again. If you need to "
           "run multiple copies of the same statement concurrently, you must create multiple "
@@ -145,46 +169,77 @@ auto SqlStorage::Cursor::iteratorImpl(jsg::Lock& js, jsg::Ref<Cursor>& obj, Func
   });
 
   if (state.isFirst) {
-    // Little hack: We don't want to call query.nextRow() at the end of this method because it
-    // may invalidate the backing buffers of StringPtrs that we haven't returned to JS yet.
+    // The query is positioned on its first row as soon as it starts.
     state.isFirst = false;
   } else {
     state.query.nextRow();
   }
 
-  auto& query = state.query;
-  if (query.isDone()) {
+  if (state.query.isDone()) {
     // Clean up the query proactively.
-    obj->state = nullptr;
+    cursor.endQuery();
     return nullptr;
   }
 
-  auto results = kj::heapArrayBuilder<Element>(query.columnCount());
-  for (auto i: kj::zeroTo(results.capacity())) {
-    Value value;
-    KJ_SWITCH_ONEOF(query.getValue(i)) {
-      KJ_CASE_ONEOF(data, kj::ArrayPtr<const byte>) {
-        value.emplace(kj::heapArray(data));
-      }
-      KJ_CASE_ONEOF(text, kj::StringPtr) {
-        value.emplace(text);
-      }
-      KJ_CASE_ONEOF(i, int64_t) {
-        // int64 will become BigInt, but most applications won't want all their integers to be
-        // BigInt. We will coerce to a double here.
-        // TODO(someday): Allow applications to request that certain columns use BigInt.
-        value.emplace(static_cast<double>(i));
-      }
-      KJ_CASE_ONEOF(d, double) {
-        value.emplace(d);
-      }
-      KJ_CASE_ONEOF(_, decltype(nullptr)) {
-        // leave value null
-      }
+  return state.query;
+}
+
+SqliteDatabase::Query::Stats SqlStorage::Cursor::getStats() {
+  KJ_IF_MAYBE(s, state) {
+    return (*s)->query.getStats();
+  } else {
+    // `state` is only ever nulled by endQuery().
+    return KJ_ASSERT_NONNULL(finalStats);
+  }
+}
+
+double SqlStorage::Cursor::getRowsRead() {
+  return getStats().rowsRead;
+}
+
+double SqlStorage::Cursor::getRowsWritten() {
+  return getStats().rowsWritten;
+}
+
+double SqlStorage::Cursor::getDuration() {
+  return getStats().duration / kj::NANOSECONDS / 1e6;
+}
+
+void SqlStorage::Cursor::endQuery() {
+  KJ_IF_MAYBE(s, state) {
+    auto stats = (*s)->query.getStats();
+    finalStats = stats;
+    state = nullptr;
+
+    KJ_IF_MAYBE(actor, IoContext::current().getActor()) {
+      actor->getMetrics().sqlQueryCompleted(stats.rowsRead, stats.rowsWritten, stats.duration);
+    }
+  }
+}
+
+v8::Local<v8::Value> SqlStorage::Cursor::getValue(
+    jsg::Lock& js, SqliteDatabase::Query& query, uint column) {
+  KJ_SWITCH_ONEOF(query.getValue(column)) {
+    KJ_CASE_ONEOF(data, kj::ArrayPtr<const byte>) {
+      return v8::ArrayBuffer::New(js.v8Isolate, jsg::newBackingStore(kj::heapArray(data)));
+    }
+    KJ_CASE_ONEOF(text, kj::StringPtr) {
+      return jsg::v8Str(js.v8Isolate, text);
+    }
+    KJ_CASE_ONEOF(i, int64_t) {
+      // int64 will become BigInt, but most applications won't want all their integers to be
+      // BigInt. We will coerce to a double here.
+      // TODO(someday): Allow applications to request that certain columns use BigInt.
+      return v8::Number::New(js.v8Isolate, static_cast<double>(i));
+    }
+    KJ_CASE_ONEOF(d, double) {
+      return v8::Number::New(js.v8Isolate, d);
+    }
+    KJ_CASE_ONEOF(_, decltype(nullptr)) {
+      return v8::Null(js.v8Isolate);
     }
-    results.add(func(state, i, kj::mv(value)));
   }
-  return results.finish();
+  KJ_UNREACHABLE;
 }
 
 SqlStorage::Statement::Statement(SqliteDatabase::Statement&& statement)
@@ -225,7 +280,7 @@ jsg::Ref<SqlStorage::Cursor> SqlStorage::Statement::run(jsg::Arguments<BindingVa
     // cursors open and the GC doesn't run proactively enough.
     KJ_IF_MAYBE(s, c->state) {
       c->canceled = !(*s)->query.isDone();
-      c->state = nullptr;
+      c->endQuery();
     }
     c->selfRef = nullptr;
     c->statement = nullptr;
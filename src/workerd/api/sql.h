@@ -13,7 +13,7 @@ namespace workerd::api {
 
 class DurableObjectStorage;
 
-class SqlStorage final: public jsg::Object, private SqliteDatabase::Regulator {
+class SqlStorage final: public jsg::Object {
 public:
   SqlStorage(SqliteDatabase& sqlite, jsg::Ref<DurableObjectStorage> storage);
   ~SqlStorage();
@@ -44,10 +44,14 @@ private:
     visitor.visit(storage);
   }
 
-  bool isAllowedName(kj::StringPtr name) override;
-  bool isAllowedTrigger(kj::StringPtr name) override;
-  void onError(kj::StringPtr message) override;
-  bool allowTransactions() override;
+  class Regulator;
+  static Regulator regulator;
+  // Regulates all application queries. This is a singleton, rather than SqlStorage itself as one
+  // might expect, because statements in the database's statement cache outlive any one
+  // SqlStorage object.
+
+  static constexpr uint STATEMENT_CACHE_SIZE = 100;
+  // Number of exec() statements to keep prepared, per database.
 
   IoPtr<SqliteDatabase> sqlite;
   jsg::Ref<DurableObjectStorage> storage;
@@ -100,32 +104,44 @@ public:
   JSG_RESOURCE_TYPE(Cursor, CompatibilityFlags::Reader flags) {
     JSG_ITERABLE(rows);
     JSG_METHOD(raw);
+    JSG_READONLY_PROTOTYPE_PROPERTY(rowsRead, getRowsRead);
+    JSG_READONLY_PROTOTYPE_PROPERTY(rowsWritten, getRowsWritten);
+    JSG_READONLY_PROTOTYPE_PROPERTY(duration, getDuration);
   }
 
-  using Value = kj::Maybe<kj::OneOf<kj::Array<byte>, kj::StringPtr, double>>;
-  // One value returned from SQL. Note that we intentionally return StringPtr instead of String
-  // because we know that the underlying buffer returned by SQLite will be valid long enough to be
-  // converted by JSG into a V8 string. For byte arrays, on the other hand, we pass ownership to
-  // JSG, which does not need to make a copy.
+  double getRowsRead();
+  double getRowsWritten();
+  double getDuration();
+  // Execution statistics for the query so far; final once the cursor has been fully consumed.
+  // `duration` is in milliseconds. See SqliteDatabase::Query::Stats.
 
-  using RowDict = jsg::Dict<Value, v8::Local<v8::String>>;
-  JSG_ITERATOR(RowIterator, rows, RowDict, jsg::Ref<Cursor>, rowIteratorNext);
-  JSG_ITERATOR(RawIterator, raw, kj::Array<Value>, jsg::Ref<Cursor>, rawIteratorNext);
+  JSG_ITERATOR(RowIterator, rows, v8::Local<v8::Object>, jsg::Ref<Cursor>, rowIteratorNext);
+  JSG_ITERATOR(RawIterator, raw, v8::Local<v8::Array>, jsg::Ref<Cursor>, rawIteratorNext);
+  // Rows are built directly as V8 values rather than via JSG type conversions, since large result
+  // sets spend most of their time constructing them. We know there are no HandleScopes on the
+  // stack between JSG and the iterator functions, so they can safely return local handles.
 
 private:
   class CachedColumnNames {
     // Helper class to cache column names for a query so that we don't have to recreate the V8
-    // strings for every row.
-    //
-    // TODO(perf): Can we further cache the V8 object layout information for a row?
+    // strings for every row, along with a template object that rows are cloned from.
   public:
     kj::ArrayPtr<jsg::V8Ref<v8::String>> get() { return KJ_REQUIRE_NONNULL(names); }
     // Get the cached names. ensureInitialized() must have been called previously.
 
+    v8::Local<v8::Object> getRowTemplate(jsg::Lock& js) {
+      return KJ_REQUIRE_NONNULL(rowTemplate).getHandle(js);
+    }
+    // Get an object which has a null-valued property for each column. Cloning it gives every row
+    // the same hidden class up front, so filling in a row's values is a series of in-place
+    // stores rather than a walk down V8's map transition tree. ensureInitialized() must have been
+    // called previously.
+
     void ensureInitialized(jsg::Lock& js, SqliteDatabase::Query& source);
 
   private:
     kj::Maybe<kj::Array<jsg::V8Ref<v8::String>>> names;
+    kj::Maybe<jsg::V8Ref<v8::Object>> rowTemplate;
   };
 
   struct State {
@@ -142,12 +158,16 @@ private:
 
     State(kj::RefcountedWrapper<SqliteDatabase::Statement>& statement,
           kj::Array<BindingValue> bindings);
+    State(kj::Own<SqliteDatabase::Statement> statement, kj::Array<BindingValue> bindings);
     State(SqliteDatabase& db, SqliteDatabase::Regulator& regulator,
           kj::StringPtr sqlCode, kj::Array<BindingValue> bindings);
   };
 
   kj::Maybe<IoOwn<State>> state;
-  // Nulled out when query is done or canceled.
+  // Nulled out when query is done or canceled, using endQuery().
+
+  kj::Maybe<SqliteDatabase::Query::Stats> finalStats;
+  // Set by endQuery().
 
   bool canceled = false;
   // True if the cursor was canceled by a new call to the same statement. This is used only to
@@ -171,12 +191,19 @@ private:
   static kj::Array<const SqliteDatabase::Query::ValuePtr> mapBindings(
       kj::ArrayPtr<BindingValue> values);
 
-  static kj::Maybe<RowDict> rowIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
-  static kj::Maybe<kj::Array<Value>> rawIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
-  template <typename Func>
-  static auto iteratorImpl(jsg::Lock& js, jsg::Ref<Cursor>& obj, Func&& func)
-      -> kj::Maybe<kj::Array<
-          decltype(func(kj::instance<State&>(), uint(), kj::instance<Value&&>()))>>;
+  static kj::Maybe<v8::Local<v8::Object>> rowIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
+  static kj::Maybe<v8::Local<v8::Array>> rawIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
+
+  SqliteDatabase::Query::Stats getStats();
+
+  void endQuery();
+  // Null out `state`, first recording the query's final stats and reporting them to the actor's
+  // observer.
+
+  static kj::Maybe<SqliteDatabase::Query&> advance(Cursor& cursor);
+  // Step the cursor's query to its next row, returning null when there are no more rows.
+
+  static v8::Local<v8::Value> getValue(jsg::Lock& js, SqliteDatabase::Query& query, uint column);
 
   friend class Statement;
 };
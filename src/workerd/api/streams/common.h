@@ -54,7 +54,11 @@ struct StreamQueuingStrategy {
   jsg::Optional<uint64_t> highWaterMark;
   jsg::Optional<jsg::Function<SizeAlgorithm>> size;
 
-  JSG_STRUCT(highWaterMark, size);
+  jsg::Optional<bool> adaptive;
+  // Non-standard: if true, `highWaterMark` is only the starting point, and the stream adjusts
+  // it to how quickly the stream is actually consumed. See HighWaterMark in queue.h.
+
+  JSG_STRUCT(highWaterMark, size, adaptive);
   JSG_STRUCT_TS_OVERRIDE(QueuingStrategy<T = any> {
     size?: (chunk: T) => number | bigint;
   });
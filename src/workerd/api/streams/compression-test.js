@@ -0,0 +1,63 @@
+import {
+  deepStrictEqual,
+  ok,
+  throws,
+} from 'node:assert';
+
+async function transform(stream, input) {
+  const writer = stream.writable.getWriter();
+  writer.write(input);
+  writer.close();
+  return new Uint8Array(await new Response(stream.readable).arrayBuffer());
+}
+
+function makeInput() {
+  // Large and varied enough to take many passes through the codec's output buffer.
+  const input = new Uint8Array(1 << 20);
+  for (let i = 0; i < input.length; i++) {
+    input[i] = (i * 7 + (i >> 10)) & 0xff;
+  }
+  return input;
+}
+
+export const brotliRoundTrip = {
+  async test(ctrl, env, ctx) {
+    const input = makeInput();
+    for (const options of [undefined, { level: 0 }, { level: 11, windowBits: 24 }]) {
+      const compressed = await transform(new CompressionStream('brotli', options), input);
+      ok(compressed.length < input.length);
+      deepStrictEqual(await transform(new DecompressionStream('brotli'), compressed), input);
+    }
+  }
+};
+
+export const zlibOptions = {
+  async test(ctrl, env, ctx) {
+    const input = makeInput();
+    for (const format of ['gzip', 'deflate', 'deflate-raw']) {
+      const options = { level: 9, windowBits: 9 };
+      const compressed = await transform(new CompressionStream(format, options), input);
+      deepStrictEqual(await transform(new DecompressionStream(format), compressed), input);
+    }
+  }
+};
+
+export const invalidOptions = {
+  test(ctrl, env, ctx) {
+    throws(() => new CompressionStream('zstd'), TypeError);
+    throws(() => new DecompressionStream('zstd'), TypeError);
+    throws(() => new CompressionStream('gzip', { level: 10 }), RangeError);
+    throws(() => new CompressionStream('deflate', { windowBits: 8 }), RangeError);
+    throws(() => new CompressionStream('brotli', { level: 12 }), RangeError);
+    throws(() => new CompressionStream('brotli', { windowBits: 25 }), RangeError);
+  }
+};
+
+export const truncatedBrotli = {
+  async test(ctrl, env, ctx) {
+    const compressed = await transform(new CompressionStream('brotli'), makeInput());
+    await transform(new DecompressionStream('brotli'), compressed.slice(0, 100)).then(
+        () => { throw new Error('expected decompression to fail'); },
+        () => {});
+  }
+};
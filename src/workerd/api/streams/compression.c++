@@ -5,14 +5,66 @@
 #include "compression.h"
 #include <workerd/io/features.h>
 #include <zlib.h>
+#include <brotli/decode.h>
+#include <brotli/encode.h>
 #include <deque>
-#include <vector>
-#include <iterator>
 
 namespace workerd::api {
 
 namespace {
 
+class OutputBuffer {
+  // Output waiting to be read. The storage is reused across chunks: the codec writes straight
+  // into spare capacity at the tail, and reads only advance `start`, with the consumed prefix
+  // dropped lazily (once it's at least half the buffer) so that draining stays amortized O(1).
+  // Spare capacity is never initialized, since the codec overwrites whatever it uses.
+public:
+  size_t size() const { return end - start; }
+  bool empty() const { return size() == 0; }
+
+  kj::ArrayPtr<kj::byte> prepare(size_t amount) {
+    // Extend the buffer by `amount` bytes and return them for the codec to write into. Follow
+    // with commit().
+    if (start > 0 && start * 2 >= end) {
+      memmove(storage.begin(), storage.begin() + start, end - start);
+      end -= start;
+      start = 0;
+    }
+    if (end + amount > storage.size()) {
+      auto newStorage = kj::heapArray<kj::byte>(kj::max(end + amount, storage.size() * 2));
+      memcpy(newStorage.begin(), storage.begin(), end);
+      storage = kj::mv(newStorage);
+    }
+    auto result = storage.slice(end, end + amount);
+    end += amount;
+    return result;
+  }
+
+  void commit(size_t unused) {
+    // Drop the last `unused` bytes handed out by prepare().
+    end -= unused;
+  }
+
+  size_t consume(kj::ArrayPtr<kj::byte> dest) {
+    auto amount = kj::min(dest.size(), size());
+    memcpy(dest.begin(), storage.begin() + start, amount);
+    start += amount;
+    if (start == end) clear();
+    return amount;
+  }
+
+  void clear() {
+    // Keeps the capacity around for the next chunk.
+    start = 0;
+    end = 0;
+  }
+
+private:
+  kj::Array<kj::byte> storage;
+  size_t start = 0;
+  size_t end = 0;
+};
+
 class Context {
 public:
   enum class Mode {
@@ -25,26 +77,124 @@ public:
     STRICT,
   };
 
+  enum class Flush {
+    NONE,
+    FINISH,
+  };
+
   struct Result {
     bool success = false;
-    kj::ArrayPtr<const byte> buffer;
+    // True if calling pumpOnce() again may produce more output without more input.
+
+    size_t produced = 0;
   };
 
-  explicit Context(Mode mode, kj::StringPtr format, ContextFlags flags) :
-      mode(mode), strictCompression(flags) {
+  static constexpr size_t CHUNK_SIZE = 16 * 1024;
+  // How much output space to offer the codec per call.
+
+  static constexpr int DEFAULT_BROTLI_QUALITY = 5;
+  // Brotli's own default (11) is meant for offline compression and is far too slow for streaming.
+
+  explicit Context(Mode mode, kj::StringPtr format, ContextFlags flags,
+                   CompressionStream::Options options)
+      : mode(mode), strictCompression(flags) {
+    if (format == "brotli") {
+      initBrotli(options);
+    } else {
+      initZlib(format, options);
+    }
+  }
+
+  ~Context() noexcept(false) {
+    KJ_SWITCH_ONEOF(state) {
+      KJ_CASE_ONEOF(zlib, z_stream) {
+        switch (mode) {
+          case Mode::COMPRESS:
+            deflateEnd(&zlib);
+            break;
+          case Mode::DECOMPRESS:
+            inflateEnd(&zlib);
+            break;
+        }
+      }
+      KJ_CASE_ONEOF(encoder, BrotliEncoderState*) {
+        BrotliEncoderDestroyInstance(encoder);
+      }
+      KJ_CASE_ONEOF(decoder, BrotliDecoderState*) {
+        BrotliDecoderDestroyInstance(decoder);
+      }
+    }
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(Context);
+
+  void setInput(const void* in, size_t size) {
+    nextIn = reinterpret_cast<const byte*>(in);
+    availIn = size;
+  }
+
+  Result pumpOnce(Flush flush, OutputBuffer& output) {
+    auto space = output.prepare(CHUNK_SIZE);
+    Result result;
+    size_t availOut = space.size();
+    KJ_DEFER(output.commit(availOut));
+
+    KJ_SWITCH_ONEOF(state) {
+      KJ_CASE_ONEOF(zlib, z_stream) {
+        result.success = pumpZlib(zlib, flush, space, availOut);
+      }
+      KJ_CASE_ONEOF(encoder, BrotliEncoderState*) {
+        result.success = pumpBrotliEncoder(encoder, flush, space, availOut);
+      }
+      KJ_CASE_ONEOF(decoder, BrotliDecoderState*) {
+        result.success = pumpBrotliDecoder(decoder, flush, space, availOut);
+      }
+    }
+
+    result.produced = space.size() - availOut;
+    return result;
+  }
+
+private:
+  static int getWindowBits(kj::StringPtr format, kj::Maybe<int> windowBits) {
+    // We use a windowBits value of 15 (unless another was requested) combined with the magic
+    // value for the compression format type. For gzip, the magic value is 16, so the value
+    // returned is 15 + 16. For deflate, the magic value is 15. For raw deflate (i.e. deflate
+    // without a zlib header) the negative windowBits value is used, so -15. See the comments for
+    // deflateInit2() in zlib.h for details.
+    static constexpr auto GZIP = 16;
+    int bits = windowBits.orDefault(15);
+    if (format == "gzip") return bits + GZIP;
+    else if (format == "deflate") return bits;
+    else if (format == "deflate-raw") return -bits;
+    KJ_UNREACHABLE;
+  }
+
+  void initZlib(kj::StringPtr format, CompressionStream::Options& options) {
+    auto& zlib = state.init<z_stream>();
+    zlib = {};
     int result = Z_OK;
     switch (mode) {
-      case Mode::COMPRESS:
+      case Mode::COMPRESS: {
+        KJ_IF_MAYBE(level, options.level) {
+          JSG_REQUIRE(*level >= 0 && *level <= 9, RangeError,
+              "The compression level must be between 0 and 9.");
+        }
+        KJ_IF_MAYBE(windowBits, options.windowBits) {
+          JSG_REQUIRE(*windowBits >= 9 && *windowBits <= 15, RangeError,
+              "The window size must be between 9 and 15 bits.");
+        }
         result = deflateInit2(
-            &ctx,
-            Z_DEFAULT_COMPRESSION,
+            &zlib,
+            options.level.orDefault(Z_DEFAULT_COMPRESSION),
             Z_DEFLATED,
-            getWindowBits(format),
+            getWindowBits(format, options.windowBits),
             8,  // memLevel = 8 is the default
             Z_DEFAULT_STRATEGY);
         break;
+      }
       case Mode::DECOMPRESS:
-        result = inflateInit2(&ctx, getWindowBits(format));
+        result = inflateInit2(&zlib, getWindowBits(format, nullptr));
         break;
       default:
         KJ_UNREACHABLE;
@@ -52,39 +202,61 @@ public:
     JSG_REQUIRE(result == Z_OK, Error, "Failed to initialize compression context.");
   }
 
-  ~Context() noexcept(false) {
+  void initBrotli(CompressionStream::Options& options) {
     switch (mode) {
-      case Mode::COMPRESS:
-        deflateEnd(&ctx);
+      case Mode::COMPRESS: {
+        KJ_IF_MAYBE(level, options.level) {
+          JSG_REQUIRE(*level >= BROTLI_MIN_QUALITY && *level <= BROTLI_MAX_QUALITY, RangeError,
+              "The compression level must be between 0 and 11.");
+        }
+        KJ_IF_MAYBE(windowBits, options.windowBits) {
+          JSG_REQUIRE(*windowBits >= BROTLI_MIN_WINDOW_BITS &&
+                      *windowBits <= BROTLI_MAX_WINDOW_BITS, RangeError,
+              "The window size must be between 10 and 24 bits.");
+        }
+        auto encoder = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        JSG_REQUIRE(encoder != nullptr, Error, "Failed to initialize compression context.");
+        state = encoder;
+        BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY,
+            options.level.orDefault(DEFAULT_BROTLI_QUALITY));
+        BrotliEncoderSetParameter(encoder, BROTLI_PARAM_LGWIN,
+            options.windowBits.orDefault(BROTLI_DEFAULT_WINDOW));
         break;
-      case Mode::DECOMPRESS:
-        inflateEnd(&ctx);
+      }
+      case Mode::DECOMPRESS: {
+        auto decoder = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+        JSG_REQUIRE(decoder != nullptr, Error, "Failed to initialize compression context.");
+        state = decoder;
         break;
+      }
+      default:
+        KJ_UNREACHABLE;
     }
   }
 
-  KJ_DISALLOW_COPY_AND_MOVE(Context);
-
-  void setInput(const void* in, size_t size) {
-    ctx.next_in = const_cast<byte*>(reinterpret_cast<const byte*>(in));
-    ctx.avail_in = size;
-  }
-
-  Result pumpOnce(int flush) {
-    ctx.next_out = buffer;
-    ctx.avail_out = sizeof(buffer);
+  bool pumpZlib(z_stream& zlib, Flush flush, kj::ArrayPtr<kj::byte> space, size_t& availOut) {
+    int zflush = flush == Flush::FINISH ? Z_FINISH : Z_NO_FLUSH;
+    zlib.next_in = const_cast<byte*>(nextIn);
+    zlib.avail_in = availIn;
+    zlib.next_out = space.begin();
+    zlib.avail_out = space.size();
+    KJ_DEFER({
+      nextIn = zlib.next_in;
+      availIn = zlib.avail_in;
+      availOut = zlib.avail_out;
+    });
 
     int result = Z_OK;
 
     switch (mode) {
       case Mode::COMPRESS:
-        result = deflate(&ctx, flush);
+        result = deflate(&zlib, zflush);
         JSG_REQUIRE(result == Z_OK || result == Z_BUF_ERROR || result == Z_STREAM_END,
                      Error,
                      "Compression failed.");
         break;
       case Mode::DECOMPRESS:
-        result = inflate(&ctx, flush);
+        result = inflate(&zlib, zflush);
         JSG_REQUIRE(result == Z_OK || result == Z_BUF_ERROR || result == Z_STREAM_END,
                      Error,
                      "Decompression failed.");
@@ -92,11 +264,11 @@ public:
         if (strictCompression == ContextFlags::STRICT) {
           // The spec requires that a TypeError is produced if there is trailing data after the end
           // of the compression stream.
-          JSG_REQUIRE(!(result == Z_STREAM_END && ctx.avail_in > 0), TypeError,
+          JSG_REQUIRE(!(result == Z_STREAM_END && zlib.avail_in > 0), TypeError,
               "Trailing bytes after end of compressed data");
           // Same applies to closing a stream before the complete decompressed data is available.
-          JSG_REQUIRE(!(flush == Z_FINISH && result == Z_BUF_ERROR &&
-              ctx.avail_out == sizeof(buffer)), TypeError,
+          JSG_REQUIRE(!(zflush == Z_FINISH && result == Z_BUF_ERROR &&
+              zlib.avail_out == space.size()), TypeError,
               "Called close() on a decompression stream with incomplete data");
         }
         break;
@@ -104,32 +276,48 @@ public:
         KJ_UNREACHABLE;
     }
 
-    return Result {
-      .success = result == Z_OK,
-      .buffer = kj::arrayPtr(buffer, sizeof(buffer) - ctx.avail_out),
-    };
+    return result == Z_OK;
   }
 
-private:
-  static int getWindowBits(kj::StringPtr format) {
-    // We use a windowBits value of 15 combined with the magic value
-    // for the compression format type. For gzip, the magic value is
-    // 16, so the value returned is 15 + 16. For deflate, the magic
-    // value is 15. For raw deflate (i.e. deflate without a zlib header)
-    // the negative windowBits value is used, so -15. See the comments for
-    // deflateInit2() in zlib.h for details.
-    static constexpr auto GZIP = 16;
-    static constexpr auto DEFLATE = 15;
-    static constexpr auto DEFLATE_RAW = -15;
-    if (format == "gzip") return DEFLATE + GZIP;
-    else if (format == "deflate") return DEFLATE;
-    else if (format == "deflate-raw") return DEFLATE_RAW;
-    KJ_UNREACHABLE;
+  bool pumpBrotliEncoder(BrotliEncoderState* encoder, Flush flush,
+                         kj::ArrayPtr<kj::byte> space, size_t& availOut) {
+    auto op = flush == Flush::FINISH ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+    uint8_t* nextOut = space.begin();
+    availOut = space.size();
+    JSG_REQUIRE(BrotliEncoderCompressStream(
+        encoder, op, &availIn, &nextIn, &availOut, &nextOut, nullptr), Error,
+        "Compression failed.");
+
+    if (flush == Flush::FINISH) {
+      return !BrotliEncoderIsFinished(encoder);
+    } else {
+      return availIn > 0 || BrotliEncoderHasMoreOutput(encoder);
+    }
+  }
+
+  bool pumpBrotliDecoder(BrotliDecoderState* decoder, Flush flush,
+                         kj::ArrayPtr<kj::byte> space, size_t& availOut) {
+    uint8_t* nextOut = space.begin();
+    availOut = space.size();
+    auto result = BrotliDecoderDecompressStream(
+        decoder, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+    JSG_REQUIRE(result != BROTLI_DECODER_RESULT_ERROR, Error, "Decompression failed.");
+
+    if (strictCompression == ContextFlags::STRICT) {
+      JSG_REQUIRE(!(result == BROTLI_DECODER_RESULT_SUCCESS && availIn > 0), TypeError,
+          "Trailing bytes after end of compressed data");
+      JSG_REQUIRE(!(flush == Flush::FINISH && result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT),
+          TypeError, "Called close() on a decompression stream with incomplete data");
+    }
+
+    return result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
   }
 
   Mode mode;
-  z_stream ctx = {};
-  kj::byte buffer[4096];
+  kj::OneOf<z_stream, BrotliEncoderState*, BrotliDecoderState*> state;
+
+  const byte* nextIn = nullptr;
+  size_t availIn = 0;
 
   // For the eponymous compatibility flag
   ContextFlags strictCompression;
@@ -141,8 +329,9 @@ class CompressionStreamImpl: public kj::Refcounted,
                              public WritableStreamSink {
   // Uncompressed data goes in. Compressed data comes out.
 public:
-  explicit CompressionStreamImpl(kj::String format, Context::ContextFlags flags)
-      : context(mode, format, flags) {}
+  explicit CompressionStreamImpl(kj::String format, Context::ContextFlags flags,
+                                 CompressionStream::Options options = {})
+      : context(mode, format, flags, kj::mv(options)) {}
 
   // WritableStreamSink implementation ---------------------------------------------------
 
@@ -156,7 +345,7 @@ public:
       }
       KJ_CASE_ONEOF(open, Open) {
         context.setInput(buffer, size);
-        return writeInternal(Z_NO_FLUSH);
+        return writeInternal(Context::Flush::NONE);
       }
     }
     KJ_UNREACHABLE;
@@ -182,7 +371,7 @@ public:
 
   kj::Promise<void> end() override {
     state = Ended();
-    return writeInternal(Z_FINISH);
+    return writeInternal(Context::Flush::FINISH);
   }
 
   void abort(kj::Exception reason) override {
@@ -241,19 +430,11 @@ private:
   }
 
   kj::Promise<size_t> tryReadInternal(kj::ArrayPtr<kj::byte> dest, size_t minBytes) {
-    const auto copyIntoBuffer = [this](kj::ArrayPtr<kj::byte> dest) {
-      auto maxBytesToCopy = kj::min(dest.size(), output.size());
-      auto src = &output[0];
-      memcpy(dest.begin(), src, maxBytesToCopy);
-      output.erase(output.begin(), output.begin() + maxBytesToCopy);
-      return maxBytesToCopy;
-    };
-
     // If the output currently contains >= minBytes, then we'll fulfill
     // the read immediately, removing as many bytes as possible from the
     // output queue.
     if (output.size() >= minBytes) {
-      return copyIntoBuffer(dest);
+      return output.consume(dest);
     }
 
     // Otherwise, create a pending read.
@@ -267,7 +448,7 @@ private:
 
     // If there are any bytes queued, copy as much as possible into the buffer.
     if (output.size() > 0) {
-      pendingRead.filled = copyIntoBuffer(dest);
+      pendingRead.filled = output.consume(dest);
     }
 
     pendingReads.push_back(kj::mv(pendingRead));
@@ -275,39 +456,29 @@ private:
     return canceler.wrap(kj::mv(promise.promise));
   }
 
-  kj::Promise<void> writeInternal(int flush) {
+  kj::Promise<void> writeInternal(Context::Flush flush) {
     // TODO(later): This does not yet implement any backpressure. A caller can keep calling
     // write without reading, which will continue to fill the internal buffer.
-    KJ_ASSERT(flush == Z_FINISH || state.template is<Open>());
+    KJ_ASSERT(flush == Context::Flush::FINISH || state.template is<Open>());
     Context::Result result;
     KJ_IF_MAYBE(exception, kj::runCatchingExceptions([this, flush, &result]() {
-      result = context.pumpOnce(flush);
+      result = context.pumpOnce(flush, output);
     })) {
       cancelInternal(kj::cp(*exception));
       return kj::mv(*exception);
     }
 
-    if (result.buffer.size() == 0) {
-      if (result.success) {
-        return writeInternal(flush);
-      }
+    if (result.produced == 0 && !result.success) {
       return maybeFulfillRead();
     }
-
-    if (result.buffer.size() > 0) {
-      std::copy(result.buffer.begin(), result.buffer.end(), std::back_inserter(output));
-    }
     return writeInternal(flush);
   }
 
   kj::Promise<void> maybeFulfillRead() {
     // Fulfill as many pending reads as we can from the output buffer.
-    auto remaining = output.size();
-    auto source = output.begin();
-
     // If there are pending reads and data to be read, we'll loop through
     // the pending reads and fulfill them as much as possible.
-    while (!pendingReads.empty() && remaining > 0) {
+    while (!pendingReads.empty() && !output.empty()) {
       auto& pending = pendingReads.front();
 
       if (!pending.promise->isWaiting()) {
@@ -330,12 +501,7 @@ private:
       }
 
       // The pending read is still viable so determine how much we can copy in.
-      auto amountToCopy = kj::min(pending.buffer.size() - pending.filled, remaining);
-      std::copy(source, source + amountToCopy, pending.buffer.begin() + pending.filled);
-      source += amountToCopy;
-      pending.filled += amountToCopy;
-      remaining -= amountToCopy;
-      output.erase(output.begin(), source);
+      pending.filled += output.consume(pending.buffer.slice(pending.filled, pending.buffer.size()));
 
       // If we've met the minimum bytes requirement for the pending read, fulfill
       // the read promise.
@@ -346,9 +512,9 @@ private:
         continue;
       }
 
-      // If we reached this point in the loop, remaining must be 0 so that we
+      // If we reached this point in the loop, the output must be drained so that we
       // don't keep iterating through on the same pending read.
-      KJ_ASSERT(remaining == 0);
+      KJ_ASSERT(output.empty());
     }
 
     if (state.template is<Ended>() && !pendingReads.empty()) {
@@ -377,18 +543,26 @@ private:
   Context context;
 
   kj::Canceler canceler;
-  std::vector<kj::byte> output;
+  OutputBuffer output;
   std::deque<PendingRead> pendingReads;
 };
+void requireSupportedFormat(kj::StringPtr format) {
+  JSG_REQUIRE(format == "deflate" || format == "gzip" || format == "deflate-raw" ||
+              format == "brotli", TypeError,
+      "The compression format must be either 'deflate', 'deflate-raw', 'gzip' or 'brotli'.");
+}
+
 }  // namespace
 
-jsg::Ref<CompressionStream> CompressionStream::constructor(jsg::Lock& js, kj::String format) {
-  JSG_REQUIRE(format == "deflate" || format == "gzip" || format == "deflate-raw", TypeError,
-               "The compression format must be either 'deflate', 'deflate-raw' or 'gzip'.");
+jsg::Ref<CompressionStream> CompressionStream::constructor(
+    jsg::Lock& js, kj::String format, jsg::Optional<Options> options) {
+  requireSupportedFormat(format);
 
   auto readableSide =
-      kj::refcounted<CompressionStreamImpl<Context::Mode::COMPRESS>>(kj::mv(format),
-                                                                     Context::ContextFlags::NONE);
+      kj::refcounted<CompressionStreamImpl<Context::Mode::COMPRESS>>(
+          kj::mv(format),
+          Context::ContextFlags::NONE,
+          kj::mv(options).orDefault({}));
   auto writableSide = kj::addRef(*readableSide);
 
   auto& ioContext = IoContext::current();
@@ -399,8 +573,7 @@ jsg::Ref<CompressionStream> CompressionStream::constructor(jsg::Lock& js, kj::St
 }
 
 jsg::Ref<DecompressionStream> DecompressionStream::constructor(jsg::Lock& js, kj::String format) {
-  JSG_REQUIRE(format == "deflate" || format == "gzip" || format == "deflate-raw", TypeError,
-               "The compression format must be either 'deflate', 'deflate-raw' or 'gzip'.");
+  requireSupportedFormat(format);
 
   auto readableSide =
       kj::refcounted<CompressionStreamImpl<Context::Mode::DECOMPRESS>>(
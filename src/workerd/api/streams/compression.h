@@ -13,13 +13,27 @@ class CompressionStream: public TransformStream {
 public:
   using TransformStream::TransformStream;
 
-  static jsg::Ref<CompressionStream> constructor(jsg::Lock& js, kj::String format);
+  struct Options {
+    jsg::Optional<int> level;
+    // Compression level: 0-9 for the zlib formats (default 6), 0-11 for brotli (default 5).
+
+    jsg::Optional<int> windowBits;
+    // Base-two logarithm of the window size: 9-15 for the zlib formats (default 15), 10-24 for
+    // brotli (default 22). Larger windows compress better but take more memory on both ends.
+
+    JSG_STRUCT(level, windowBits);
+    JSG_STRUCT_TS_OVERRIDE(CompressionStreamOptions);
+  };
+
+  static jsg::Ref<CompressionStream> constructor(
+      jsg::Lock& js, kj::String format, jsg::Optional<Options> options);
 
   JSG_RESOURCE_TYPE(CompressionStream) {
     JSG_INHERIT(TransformStream);
 
     JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
-      constructor(format: "gzip" | "deflate" | "deflate-raw");
+      constructor(format: "gzip" | "deflate" | "deflate-raw" | "brotli",
+                  options?: CompressionStreamOptions);
     });
   }
 };
@@ -34,7 +48,7 @@ public:
     JSG_INHERIT(TransformStream);
 
     JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
-      constructor(format: "gzip" | "deflate" | "deflate-raw");
+      constructor(format: "gzip" | "deflate" | "deflate-raw" | "brotli");
     });
   }
 };
@@ -139,3 +139,163 @@ export const fixedLengthStream = {
     strictEqual(writer.desiredSize, 10);
   }
 };
+
+export const identityTransformStreamReadAtLeast = {
+  async test(ctrl, env, ctx) {
+    const ts = new IdentityTransformStream();
+    const writer = ts.writable.getWriter();
+    const reader = ts.readable.getReader({ mode: 'byob' });
+
+    // A single read accumulates several small writes until its minimum is met. Each write is
+    // accepted as soon as it has been copied, even while the read is still pending.
+    const read = reader.readAtLeast(8, new Uint8Array(16));
+    await writer.write(new Uint8Array([1, 2, 3]));
+    await writer.write(new Uint8Array([4, 5, 6]));
+    await writer.write(new Uint8Array([7, 8, 9]));
+    {
+      const { value, done } = await read;
+      strictEqual(done, false);
+      strictEqual(value.byteLength, 9);
+      strictEqual(value.join(','), '1,2,3,4,5,6,7,8,9');
+    }
+
+    // If the stream closes first, the read returns what it has, and the next one sees EOF.
+    const partial = reader.readAtLeast(4, new Uint8Array(8));
+    await writer.write(new Uint8Array([10]));
+    await writer.close();
+    {
+      const { value, done } = await partial;
+      strictEqual(done, false);
+      strictEqual(value.byteLength, 1);
+      strictEqual(value[0], 10);
+    }
+    strictEqual((await reader.read(new Uint8Array(1))).done, true);
+  }
+};
+
+export const identityTransformStreamTee = {
+  async test(ctrl, env, ctx) {
+    const ts = new IdentityTransformStream();
+    const [branch1, branch2] = ts.readable.tee();
+
+    const writer = ts.writable.getWriter();
+    const enc = new TextEncoder();
+    const written = (async () => {
+      for (let n = 0; n < 10; n++) {
+        await writer.write(enc.encode(`chunk ${n};`));
+      }
+      await writer.close();
+    })();
+
+    // Reading one branch to completion first forces the other branch's data to be buffered,
+    // which both branches then see in full.
+    const expected = Array.from({ length: 10 }, (_, n) => `chunk ${n};`).join('');
+    strictEqual(await new Response(branch1).text(), expected);
+    await written;
+    strictEqual(await new Response(branch2).text(), expected);
+  }
+};
+
+export const identityTransformStreamCoalesceWrites = {
+  async test(ctrl, env, ctx) {
+    const ts = new IdentityTransformStream({ coalesceWrites: true });
+    const writer = ts.writable.getWriter();
+    const reader = ts.readable.getReader({ mode: 'byob' });
+
+    // A synchronous burst of small writes reaches the reader as one chunk.
+    const writes = [1, 2, 3, 4].map((n) => writer.write(new Uint8Array([n])));
+    const { value } = await reader.read(new Uint8Array(16));
+    strictEqual(value.join(','), '1,2,3,4');
+    await Promise.all(writes);
+
+    const closed = writer.close();
+    strictEqual((await reader.read(new Uint8Array(1))).done, true);
+    await closed;
+  }
+};
+
+// Writes `count` chunks of `size` bytes to a new IdentityTransformStream in the background, and
+// returns its tee'd branches.
+function teeOfWrites(count, size) {
+  const source = new IdentityTransformStream();
+  const writer = source.writable.getWriter();
+  const written = (async () => {
+    for (let n = 0; n < count; n++) {
+      await writer.write(new Uint8Array(size));
+    }
+    await writer.close();
+  })();
+  return [...source.readable.tee(), written];
+}
+
+// Reads from `reader` until it stops making progress for a while, and returns the byte count so
+// far together with the still-pending read.
+async function readUntilStalled(reader) {
+  let bytes = 0;
+  let pending = reader.read();
+  for (;;) {
+    const timeout = new Promise((resolve) => setTimeout(() => resolve('stalled'), 100));
+    const result = await Promise.race([pending, timeout]);
+    if (result === 'stalled' || result.done) {
+      return { bytes, pending };
+    }
+    bytes += result.value.byteLength;
+    pending = reader.read();
+  }
+}
+
+async function readRest(reader, pending) {
+  let bytes = 0;
+  for (let result = await pending; !result.done; result = await reader.read()) {
+    bytes += result.value.byteLength;
+  }
+  return bytes;
+}
+
+const TEE_CHUNK = 64 * 1024;
+const TEE_CHUNKS = 64;  // 4 MiB in all, well past the 1 MiB a branch may fall behind.
+
+export const identityTransformStreamTeeBackpressure = {
+  async test(ctrl, env, ctx) {
+    const [fast, slow, written] = teeOfWrites(TEE_CHUNKS, TEE_CHUNK);
+
+    // The slow branch is pumped into a stream nobody reads yet, so it stops advancing.
+    const sink = new IdentityTransformStream();
+    const piped = slow.pipeTo(sink.writable);
+
+    // The fast branch gets ahead, but only so far.
+    const reader = fast.getReader();
+    const { bytes, pending } = await readUntilStalled(reader);
+    strictEqual(bytes >= 1024 * 1024, true);
+    strictEqual(bytes < TEE_CHUNKS * TEE_CHUNK, true);
+
+    // Once the slow branch is drained, both branches see everything.
+    const [slowBody, rest] = await Promise.all([
+      new Response(sink.readable).arrayBuffer(),
+      readRest(reader, pending),
+    ]);
+    await Promise.all([piped, written]);
+    strictEqual(bytes + rest, TEE_CHUNKS * TEE_CHUNK);
+    strictEqual(slowBody.byteLength, TEE_CHUNKS * TEE_CHUNK);
+  }
+};
+
+export const identityTransformStreamTeeCancelSlowBranch = {
+  async test(ctrl, env, ctx) {
+    const [fast, slow, written] = teeOfWrites(TEE_CHUNKS, TEE_CHUNK);
+
+    const sink = new IdentityTransformStream();
+    const piped = slow.pipeTo(sink.writable);
+
+    const reader = fast.getReader();
+    const { bytes, pending } = await readUntilStalled(reader);
+    strictEqual(bytes < TEE_CHUNKS * TEE_CHUNK, true);
+
+    // When the slow branch's consumer goes away, its branch is canceled, and the fast branch no
+    // longer waits for it.
+    await sink.readable.cancel(new Error('gone'));
+    await piped.catch(() => {});
+    strictEqual(bytes + await readRest(reader, pending), TEE_CHUNKS * TEE_CHUNK);
+    await written;
+  }
+};
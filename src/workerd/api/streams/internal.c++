@@ -5,6 +5,7 @@
 #include "internal.h"
 #include "readable.h"
 #include "writable.h"
+#include <workerd/api/util.h>
 #include <workerd/jsg/jsg.h>
 #include <kj/vector.h>
 
@@ -141,32 +142,243 @@ kj::Exception reasonToException(
 
 // =======================================================================================
 
-class TeeAdapter final: public kj::AsyncInputStream {
-  // Adapt ReadableStreamSource to kj::AsyncInputStream's interface for use with `kj::newTee()`.
+class SharedTee final: public kj::Refcounted {
+  // The shared half of a tee of a stream that has no optimized tee implementation of its own.
+  // Every chunk pulled from `inner` is stored exactly once, no matter how many branches there
+  // are; each branch only keeps a cursor (a byte offset) into the buffered chunks. A chunk is
+  // freed as soon as every branch has read past it, and branches that are being pumped write the
+  // buffered chunks to their sink directly, without copying them first.
+  //
+  // We only pull more data when some branch has caught up and is waiting for it. If another
+  // branch has fallen behind by `backpressureLimit` bytes or more *and* is being pumped, the pull
+  // waits until that branch catches up a bit, so a fast consumer can't make us buffer a whole body
+  // on behalf of a slow one. A branch that isn't being consumed at all might never be (e.g. the
+  // application only reads one of two clones), so we can't wait for it; instead we keep buffering
+  // until `limit` is reached, at which point the read that would exceed it fails.
 
 public:
-  explicit TeeAdapter(kj::Own<ReadableStreamSource> inner)
-      : inner(kj::mv(inner)) {}
+  static constexpr size_t MIN_PULL_BYTES = 4096;
+  static constexpr size_t MAX_PULL_BYTES = 64 * 1024;
+  static constexpr uint64_t BACKPRESSURE_BYTES = 1024 * 1024;
 
-  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
-    return inner->tryRead(buffer, minBytes, maxBytes);
+  struct Cursor {
+    uint64_t position = 0;
+    // Absolute offset in the stream of the next byte this branch will read.
+
+    bool pumping = false;
+    // True while the branch is in pumpTo(), which guarantees it will keep advancing.
+
+    size_t wanted = 0;
+    kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> waiter;
+    // Set while the branch is waiting for data past `end`.
+  };
+
+  explicit SharedTee(kj::Own<ReadableStreamSource> inner, uint64_t limit)
+      : inner(kj::mv(inner)), limit(limit), backpressureLimit(kj::min(limit, BACKPRESSURE_BYTES)) {}
+
+  void addCursor(Cursor& cursor) { cursors.add(&cursor); }
+
+  void removeCursor(Cursor& cursor) {
+    for (auto i: kj::indices(cursors)) {
+      if (cursors[i] == &cursor) {
+        cursors.removeAt(i);
+        break;
+      }
+    }
+    trim();
+    maybePull();
   }
 
-  kj::Maybe<uint64_t> tryGetLength() override {
-    return inner->tryGetLength(StreamEncoding::IDENTITY);
+  bool hasCursors() { return cursors.size() > 0; }
+
+  ReadableStreamSource& getInner() { return *inner; }
+
+  size_t copyOut(Cursor& cursor, kj::ArrayPtr<kj::byte> buffer) {
+    // Copy as much buffered data as fits in `buffer`, advancing the cursor past it.
+
+    size_t copied = 0;
+    for (auto piece: peek(cursor, buffer.size())) {
+      memcpy(buffer.begin() + copied, piece.begin(), piece.size());
+      copied += piece.size();
+    }
+    advance(cursor, copied);
+    return copied;
+  }
+
+  kj::Array<kj::ArrayPtr<const kj::byte>> peek(Cursor& cursor, size_t maxBytes) {
+    // Returns the buffered data past the cursor, up to `maxBytes`, without advancing it. The
+    // returned pieces stay valid until the cursor is advanced past them.
+
+    kj::Vector<kj::ArrayPtr<const kj::byte>> pieces;
+    uint64_t chunkStart = bufferStart;
+    for (auto& chunk: chunks) {
+      if (maxBytes == 0) break;
+      uint64_t chunkEnd = chunkStart + chunk.size();
+      if (cursor.position < chunkEnd) {
+        size_t offset = kj::max(cursor.position, chunkStart) - chunkStart;
+        size_t amount = kj::min(chunk.size() - offset, maxBytes);
+        pieces.add(chunk.slice(offset, offset + amount));
+        maxBytes -= amount;
+      }
+      chunkStart = chunkEnd;
+    }
+    return pieces.releaseAsArray();
+  }
+
+  void advance(Cursor& cursor, size_t amount) {
+    if (amount == 0) return;
+    KJ_ASSERT(cursor.position + amount <= end);
+    cursor.position += amount;
+    trim();
+    maybePull();
+  }
+
+  kj::Promise<bool> whenReadable(Cursor& cursor, size_t wanted) {
+    // Resolves to true once there's data past the cursor, or to false at EOF.
+
+    while (cursor.position == end) {
+      KJ_IF_MAYBE(e, error) {
+        kj::throwFatalException(kj::cp(*e));
+      }
+      if (eof) co_return false;
+
+      auto paf = kj::newPromiseAndFulfiller<void>();
+      cursor.waiter = kj::mv(paf.fulfiller);
+      cursor.wanted = wanted;
+      maybePull();
+      co_await paf.promise;
+    }
+    co_return true;
+  }
+
+  kj::Maybe<uint64_t> tryGetLength(Cursor& cursor) {
+    uint64_t buffered = end - cursor.position;
+    if (eof) return buffered;
+    KJ_IF_MAYBE(length, inner->tryGetLength(StreamEncoding::IDENTITY)) {
+      return *length + buffered;
+    }
+    return nullptr;
   }
 
 private:
   kj::Own<ReadableStreamSource> inner;
+  uint64_t limit;
+  uint64_t backpressureLimit;
+
+  kj::Vector<Cursor*> cursors;
+
+  std::deque<kj::Array<kj::byte>> chunks;
+  uint64_t bufferStart = 0;
+  // Absolute offset of the first byte of `chunks.front()`.
+
+  uint64_t end = 0;
+  // Absolute offset just past the last byte pulled from `inner`.
+
+  bool eof = false;
+  kj::Maybe<kj::Exception> error;
+
+  bool pulling = false;
+  kj::Maybe<kj::Promise<void>> pullTask;
+  // Declared after `inner` so that an in-flight read is canceled before `inner` is destroyed.
+
+  void trim() {
+    uint64_t minPosition = end;
+    for (auto cursor: cursors) {
+      minPosition = kj::min(minPosition, cursor->position);
+    }
+    while (!chunks.empty() && bufferStart + chunks.front().size() <= minPosition) {
+      bufferStart += chunks.front().size();
+      chunks.pop_front();
+    }
+  }
+
+  void maybePull() {
+    if (pulling || eof || error != nullptr) return;
+
+    size_t wanted = 0;
+    bool laggardPumping = false;
+    for (auto cursor: cursors) {
+      if (cursor->waiter != nullptr) {
+        wanted = kj::max(wanted, cursor->wanted);
+      } else if (cursor->pumping && cursor->position < end) {
+        laggardPumping = true;
+      }
+    }
+    if (wanted == 0) return;
+
+    uint64_t buffered = end - bufferStart;
+    if (buffered >= backpressureLimit && laggardPumping) {
+      // The lagging branch will call advance() as it catches up, which brings us back here.
+      return;
+    }
+    if (buffered >= limit) {
+      auto exception = teeBufferLimitExceeded();
+      for (auto cursor: cursors) {
+        KJ_IF_MAYBE(w, cursor->waiter) {
+          (*w)->reject(kj::cp(exception));
+          cursor->waiter = nullptr;
+        }
+      }
+      return;
+    }
+
+    pulling = true;
+    auto bytes = kj::heapArray<kj::byte>(kj::max(MIN_PULL_BYTES, kj::min(wanted, MAX_PULL_BYTES)));
+    auto promise = inner->tryRead(bytes.begin(), 1, bytes.size());
+    pullTask = promise.then([this, bytes = kj::mv(bytes)](size_t amount) mutable {
+      pulling = false;
+      if (amount == 0) {
+        eof = true;
+      } else {
+        if (amount * 2 < bytes.size()) {
+          // Don't pin a mostly-empty read buffer for as long as the slowest branch needs it.
+          chunks.push_back(kj::heapArray<kj::byte>(bytes.first(amount)));
+        } else {
+          chunks.push_back(bytes.slice(0, amount).attach(kj::mv(bytes)));
+        }
+        end += amount;
+      }
+      wakeAll();
+    }, [this](kj::Exception&& exception) {
+      pulling = false;
+      error = kj::mv(exception);
+      wakeAll();
+    }).eagerlyEvaluate(nullptr);
+  }
+
+  void wakeAll() {
+    for (auto cursor: cursors) {
+      KJ_IF_MAYBE(w, cursor->waiter) {
+        (*w)->fulfill();
+        cursor->waiter = nullptr;
+      }
+    }
+  }
 };
 
 class TeeBranch final: public ReadableStreamSource {
 public:
-  explicit TeeBranch(kj::Own<kj::AsyncInputStream> inner)
-      : inner(kj::mv(inner)) {}
+  explicit TeeBranch(kj::Own<SharedTee> tee, uint64_t position = 0)
+      : tee(kj::mv(tee)) {
+    cursor.position = position;
+    this->tee->addCursor(cursor);
+  }
+
+  ~TeeBranch() noexcept(false) {
+    if (!canceled) tee->removeCursor(cursor);
+  }
 
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
-    return inner->tryRead(buffer, minBytes, maxBytes);
+    if (maxBytes == 0) co_return 0;
+    minBytes = kj::max(minBytes, 1);
+
+    auto bytes = static_cast<kj::byte*>(buffer);
+    size_t total = 0;
+    for (;;) {
+      total += tee->copyOut(cursor, kj::arrayPtr(bytes + total, maxBytes - total));
+      if (total >= minBytes) co_return total;
+      if (!co_await tee->whenReadable(cursor, maxBytes - total)) co_return total;
+    }
   }
 
   kj::Promise<DeferredProxy<void>> pumpTo(WritableStreamSink& output, bool end) override {
@@ -181,71 +393,73 @@ public:
     JSG_REQUIRE(kj::dynamicDowncastIfAvailable<IdentityTransformStreamImpl>(output) == nullptr,
         TypeError, "Inter-TransformStream ReadableStream.pipeTo() is not implemented.");
 
-    // It is important we actually call `inner->pumpTo()` so that `kj::newTee()` is aware of this
-    // pump operation's backpressure. So we can't use the default `ReadableStreamSource::pumpTo()`
-    // implementation, and have to implement our own.
-
-    auto outputAdapter = kj::heap<PumpAdapter>(output);
-    auto promise = inner->pumpTo(*outputAdapter).attach(kj::mv(outputAdapter)).ignoreResult();
-
-    if (end) {
-      promise = promise.then([&output]() { return output.end(); });
-    }
-
     // We only use `TeeBranch` when a locally-sourced stream was tee'd (because system streams
     // implement `tryTee()` in a different way that doesn't use `TeeBranch`). So, we know that
     // none of the pump can be performed without the IoContext active, and thus
     // `DeferredProxy` has to be a noop.
-    return addNoopDeferredProxy(kj::mv(promise));
+    return addNoopDeferredProxy(pumpLoop(output, end));
   }
 
   kj::Maybe<uint64_t> tryGetLength(StreamEncoding encoding) override {
     if (encoding == StreamEncoding::IDENTITY) {
-      return inner->tryGetLength();
+      return tee->tryGetLength(cursor);
     } else {
       return nullptr;
     }
   }
 
   kj::Maybe<Tee> tryTee(uint64_t limit) override {
-    KJ_IF_MAYBE(t, inner->tryTee(limit)) {
-      auto branch = kj::heap<TeeBranch>(newTeeErrorAdapter(kj::mv(*t)));
-      auto consumed = kj::heap<TeeBranch>(kj::mv(inner));
-      return Tee{kj::mv(branch), kj::mv(consumed)};
-    }
-
-    return nullptr;
+    // Further branches just get another cursor into the same buffer, starting where this one is.
+    // The consumed branch is replaced by one at the same position before this one is dropped, so
+    // nothing buffered past it is freed in between.
+    auto branch = kj::heap<TeeBranch>(kj::addRef(*tee), cursor.position);
+    auto consumed = kj::heap<TeeBranch>(kj::addRef(*tee), cursor.position);
+    return Tee{kj::mv(branch), kj::mv(consumed)};
   }
 
   void cancel(kj::Exception reason) override {
-    // TODO(someday): What to do?
+    if (canceled) return;
+    canceled = true;
+    tee->removeCursor(cursor);
+    if (!tee->hasCursors()) {
+      tee->getInner().cancel(kj::mv(reason));
+    }
   }
 
 private:
-  class PumpAdapter final: public kj::AsyncOutputStream {
-    // Adapt WritableStreamSink to kj::AsyncOutputStream's interface for use in
-    // `TeeBranch::pumpTo()`. If you squint, the write logic looks very similar to TeeAdapter's
-    // read logic.
+  static constexpr size_t MAX_PUMP_BYTES = 64 * 1024;
 
-  public:
-    explicit PumpAdapter(WritableStreamSink& inner): inner(inner) {}
+  kj::Own<SharedTee> tee;
+  SharedTee::Cursor cursor;
+  bool canceled = false;
 
-    kj::Promise<void> write(const void* buffer, size_t size) override {
-      return inner.write(buffer, size);
-    }
+  kj::Promise<void> pumpLoop(WritableStreamSink& output, bool end) {
+    cursor.pumping = true;
+    KJ_DEFER(cursor.pumping = false);
 
-    kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
-      return inner.write(pieces);
-    }
+    for (;;) {
+      auto pieces = tee->peek(cursor, MAX_PUMP_BYTES);
+      if (pieces.size() == 0) {
+        if (!co_await tee->whenReadable(cursor, MAX_PUMP_BYTES)) break;
+        continue;
+      }
 
-    kj::Promise<void> whenWriteDisconnected() override {
-      KJ_UNIMPLEMENTED("whenWriteDisconnected() not expected on PumpAdapter");
+      // The pieces point straight into the shared buffer, which keeps them alive until we advance
+      // past them below.
+      size_t amount = 0;
+      for (auto piece: pieces) amount += piece.size();
+      if (pieces.size() == 1) {
+        co_await output.write(pieces[0].begin(), pieces[0].size());
+      } else {
+        co_await output.write(pieces);
+      }
+      tee->advance(cursor, amount);
     }
 
-    WritableStreamSink& inner;
-  };
-
-  kj::Own<kj::AsyncInputStream> inner;
+    if (end) {
+      co_await output.end();
+    }
+  }
 };
 
 class WarnIfUnusedStream final: public ReadableStreamSource {
@@ -265,8 +479,8 @@ public:
     return inner->tryRead(buffer, minBytes, maxBytes);
   }
 
-  // TODO(someday): we set `wasRead` to avoid warning here, but TeeBranch might still buffer the body.
-  // We should fix it not to buffer when cancelled.
+  // We set `wasRead` to avoid warning here; canceling a TeeBranch drops its cursor, so the other
+  // branch no longer buffers on its behalf.
   void cancel(kj::Exception reason) override {
     wasRead = true;
     return inner->cancel(reason);
@@ -597,11 +811,11 @@ ReadableStreamController::Tee ReadableStreamInternalController::tee(jsg::Lock& j
         return makeTee(kj::mv(tee->branches[0]), kj::mv(tee->branches[1]));
       }
 
-      auto tee = kj::newTee(kj::heap<TeeAdapter>(kj::mv(readable)), bufferLimit);
+      auto tee = kj::refcounted<SharedTee>(kj::mv(readable), bufferLimit);
 
       return makeTee(
-          kj::heap<TeeBranch>(newTeeErrorAdapter(kj::mv(tee.branches[0]))),
-          kj::heap<TeeBranch>(newTeeErrorAdapter(kj::mv(tee.branches[1]))));
+          kj::heap<TeeBranch>(kj::addRef(*tee)),
+          kj::heap<TeeBranch>(kj::mv(tee)));
     }
   }
 
@@ -1189,8 +1403,17 @@ void WritableStreamInternalController::doError(jsg::Lock& js, v8::Local<v8::Valu
 void WritableStreamInternalController::ensureWriting(jsg::Lock& js) {
   auto& ioContext = IoContext::current();
   if (queue.size() == 1) {
-    ioContext.addTask(ioContext.awaitJs(
-        writeLoop(js, ioContext)).attach(addRef()));
+    if (coalesceWrites) {
+      // Give the rest of the current task a chance to queue more writes before we start.
+      auto promise = js.resolvedPromise().then(js,
+          ioContext.addFunctor([this](jsg::Lock& js) -> jsg::Promise<void> {
+        return writeLoop(js, IoContext::current());
+      }));
+      ioContext.addTask(ioContext.awaitJs(kj::mv(promise)).attach(addRef()));
+    } else {
+      ioContext.addTask(ioContext.awaitJs(
+          writeLoop(js, ioContext)).attach(addRef()));
+    }
   }
 }
 
@@ -1289,6 +1512,69 @@ jsg::Promise<void> WritableStreamInternalController::writeLoopAfterFrontOutputLo
       auto& writable = state.get<Writable>();
       auto check = makeChecker(request);
 
+      if (coalesceWrites) {
+        // Gather the writes queued behind this one, as long as they don't have to wait for an
+        // output lock of their own.
+        size_t count = 1;
+        size_t totalBytes = request.bytes.size();
+        for (auto it = queue.begin() + 1; it != queue.end() && count < MAX_COALESCED_WRITES;
+             ++it, ++count) {
+          KJ_IF_MAYBE(next, it->event.tryGet<Write>()) {
+            if (it->outputLock != nullptr || next->bytes.size() == 0 ||
+                totalBytes + next->bytes.size() > MAX_COALESCED_BYTES) {
+              break;
+            }
+            totalBytes += next->bytes.size();
+          } else {
+            break;
+          }
+        }
+
+        if (count > 1) {
+          auto pieces = kj::heapArray<kj::ArrayPtr<const kj::byte>>(count);
+          auto stores = kj::heapArrayBuilder<std::shared_ptr<v8::BackingStore>>(count);
+          for (auto i: kj::zeroTo(count)) {
+            auto& write = queue[i].event.get<Write>();
+            pieces[i] = write.bytes;
+            stores.add(kj::mv(write.ownBytes));
+          }
+          auto promise = writable->write(pieces).attach(kj::mv(pieces), stores.finish());
+
+          // As in the single-write case below, the writes are resolved in order once the sink has
+          // accepted all of them, or all rejected if it fails.
+          return ioContext.awaitIoLegacy(kj::mv(promise)).then(js,
+              ioContext.addFunctor(
+                [this, check, maybeAbort, count, totalBytes](jsg::Lock& js)
+                    -> jsg::Promise<void> {
+            auto& request = check();
+            decreaseCurrentWriteBufferSize(js, totalBytes);
+            for (auto i KJ_UNUSED: kj::zeroTo(count)) {
+              maybeResolvePromise(queue.front().event.get<Write>().promise);
+              queue.pop_front();
+            }
+            maybeAbort(js, request);
+            return writeLoop(js, IoContext::current());
+          }), ioContext.addFunctor(
+                [this, check, maybeAbort, count, totalBytes](jsg::Lock& js, jsg::Value reason)
+                    -> jsg::Promise<void> {
+              auto handle = reason.getHandle(js);
+              auto& request = check();
+              auto& writable = state.get<Writable>();
+              decreaseCurrentWriteBufferSize(js, totalBytes);
+              for (auto i KJ_UNUSED: kj::zeroTo(count)) {
+                maybeRejectPromise<void>(queue.front().event.get<Write>().promise, handle);
+                queue.pop_front();
+              }
+              if (!maybeAbort(js, request)) {
+                writable->abort(js.exceptionToKj(reason.addRef(js)));
+                drain(js, handle);
+              }
+              return js.resolvedPromise();
+            }
+          ));
+        }
+      }
+
       auto amountToWrite = request.bytes.size();
 
       auto promise = writable->write(request.bytes.begin(), request.bytes.size())
@@ -1854,29 +2140,8 @@ kj::Promise<size_t> IdentityTransformStreamImpl::tryRead(
     void* buffer,
     size_t minBytes,
     size_t maxBytes) {
-  size_t total = 0;
-  while (total < minBytes) {
-    // TODO(perf): tryReadInternal was written assuming minBytes would always be 1 but we've now
-    // introduced an API for user to specify a larger minBytes. For now, this is implemented as a
-    // naiive loop dispatching to the 1 byte version but would be better to bake it deeper into
-    // the implementation where it can be more efficient.
-    auto amount = co_await tryReadInternal(buffer, maxBytes);
-    KJ_ASSERT(amount <= maxBytes);
-    if (amount == 0) {
-      // EOF.
-      break;
-    }
-
-    total += amount;
-    buffer = reinterpret_cast<char*>(buffer) + amount;
-    maxBytes -= amount;
-  }
-
-  co_return total;
-}
-
-kj::Promise<size_t> IdentityTransformStreamImpl::tryReadInternal(void* buffer, size_t maxBytes) {
-  auto promise = readHelper(kj::arrayPtr(static_cast<kj::byte*>(buffer), maxBytes));
+  minBytes = kj::max(kj::min(minBytes, maxBytes), size_t(1));
+  auto promise = readHelper(kj::arrayPtr(static_cast<kj::byte*>(buffer), maxBytes), minBytes);
 
   KJ_IF_MAYBE(l, limit) {
     promise = promise.then([this, &l = *l](size_t amount) -> kj::Promise<size_t> {
@@ -1929,6 +2194,7 @@ void IdentityTransformStreamImpl::cancel(kj::Exception reason) {
       // This is fine.
     }
     KJ_CASE_ONEOF(request, ReadRequest) {
+      // Any bytes already accumulated for a partial read are discarded along with it.
       request.fulfiller->fulfill(size_t(0));
     }
     KJ_CASE_ONEOF(request, WriteRequest) {
@@ -1958,9 +2224,32 @@ kj::Promise<void> IdentityTransformStreamImpl::write(const void* buffer, size_t
 
 kj::Promise<void> IdentityTransformStreamImpl::write(
     kj::ArrayPtr<const kj::ArrayPtr<const kj::byte>> pieces) {
-  KJ_UNIMPLEMENTED("IdentityTransformStreamImpl piecewise write() not currently supported");
-  // TODO(soon): This will be called by TeeBranch::pumpTo(). We disallow that anyway, since we
-  //   disallow inter-TransformStream pumping.
+  // Each piece is handed to the reader in turn. A pending read with a large enough buffer will
+  // absorb several of them at once (see tryRead()): pieces that fit are copied straight in without
+  // completing the read, and only the last piece that reaches it is left to writeHelper(), which
+  // decides whether the read is done.
+  for (auto i: kj::indices(pieces)) {
+    auto piece = pieces[i];
+    if (piece.size() == 0) continue;
+
+    KJ_IF_MAYBE(request, state.tryGet<ReadRequest>()) {
+      bool morePieces = false;
+      for (auto& later: pieces.slice(i + 1, pieces.size())) {
+        if (later.size() > 0) {
+          morePieces = true;
+          break;
+        }
+      }
+      if (morePieces && request->fulfiller->isWaiting() &&
+          piece.size() < request->bytes.size() - request->filled) {
+        memcpy(request->bytes.begin() + request->filled, piece.begin(), piece.size());
+        request->filled += piece.size();
+        continue;
+      }
+    }
+
+    co_await writeHelper(piece);
+  }
 }
 
 kj::Promise<void> IdentityTransformStreamImpl::end() {
@@ -1995,13 +2284,15 @@ void IdentityTransformStreamImpl::abort(kj::Exception reason) {
   // TODO(conform): Proactively put ReadableStream into Errored state.
 }
 
-kj::Promise<size_t> IdentityTransformStreamImpl::readHelper(kj::ArrayPtr<kj::byte> bytes) {
+kj::Promise<size_t> IdentityTransformStreamImpl::readHelper(
+    kj::ArrayPtr<kj::byte> bytes, size_t minBytes) {
   KJ_SWITCH_ONEOF(state) {
     KJ_CASE_ONEOF(idle, Idle) {
       // No outstanding write request, switch to ReadRequest state.
 
       auto paf = kj::newPromiseAndFulfiller<size_t>();
-      state = ReadRequest { bytes, kj::mv(paf.fulfiller) };
+      state = ReadRequest { .bytes = bytes, .minBytes = minBytes,
+                            .fulfiller = kj::mv(paf.fulfiller) };
       return kj::mv(paf.promise);
     }
     KJ_CASE_ONEOF(request, ReadRequest) {
@@ -2009,15 +2300,22 @@ kj::Promise<size_t> IdentityTransformStreamImpl::readHelper(kj::ArrayPtr<kj::byt
     }
     KJ_CASE_ONEOF(request, WriteRequest) {
       if (bytes.size() >= request.bytes.size()) {
-        // The write buffer will entirely fit into our read buffer; fulfill both requests.
+        // The write buffer will entirely fit into our read buffer; fulfill the write request.
         memcpy(bytes.begin(), request.bytes.begin(), request.bytes.size());
         auto result = request.bytes.size();
         request.fulfiller->fulfill();
 
-        // Switch to idle state.
-        state = Idle();
+        if (result >= minBytes) {
+          // That's enough to satisfy the read, too. Switch to idle state.
+          state = Idle();
+          return result;
+        }
 
-        return result;
+        // Wait for more writes to fill the rest of the minimum.
+        auto paf = kj::newPromiseAndFulfiller<size_t>();
+        state = ReadRequest { .bytes = bytes, .minBytes = minBytes, .filled = result,
+                              .fulfiller = kj::mv(paf.fulfiller) };
+        return kj::mv(paf.promise);
       }
 
       // The write buffer won't quite fit into our read buffer; fulfill only the read request.
@@ -2065,25 +2363,33 @@ kj::Promise<void> IdentityTransformStreamImpl::writeHelper(kj::ArrayPtr<const kj
       }
 
       if (bytes.size() == 0) {
-        // This is a close operation.
-        request.fulfiller->fulfill(size_t(0));
+        // This is a close operation. A partially-filled read completes with what it has; the
+        // next read will see EOF.
+        request.fulfiller->fulfill(kj::cp(request.filled));
         state = StreamStates::Closed();
         return kj::READY_NOW;
       }
 
-      KJ_ASSERT(request.bytes.size() > 0);
-
-      if (request.bytes.size() >= bytes.size()) {
-        // Our write buffer will entirely fit into the read buffer; fulfill both requests.
-        memcpy(request.bytes.begin(), bytes.begin(), bytes.size());
-        request.fulfiller->fulfill(bytes.size());
-        state = Idle();
+      auto remaining = request.bytes.slice(request.filled, request.bytes.size());
+      KJ_ASSERT(remaining.size() > 0);
+
+      if (remaining.size() >= bytes.size()) {
+        // Our write buffer will entirely fit into the read buffer.
+        memcpy(remaining.begin(), bytes.begin(), bytes.size());
+        request.filled += bytes.size();
+        if (request.filled >= request.minBytes) {
+          // Fulfill both requests.
+          request.fulfiller->fulfill(kj::cp(request.filled));
+          state = Idle();
+        } else {
+          // The read wants more; leave it pending, but the write is done.
+        }
         return kj::READY_NOW;
       }
 
       // Our write buffer won't quite fit into the read buffer; fulfill only the read request.
-      memcpy(request.bytes.begin(), bytes.begin(), request.bytes.size());
-      bytes = bytes.slice(request.bytes.size(), bytes.size());
+      memcpy(remaining.begin(), bytes.begin(), remaining.size());
+      bytes = bytes.slice(remaining.size(), bytes.size());
       request.fulfiller->fulfill(request.bytes.size());
 
       auto paf = kj::newPromiseAndFulfiller<void>();
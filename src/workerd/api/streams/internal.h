@@ -203,6 +203,15 @@ public:
 
   void setHighWaterMark(uint64_t highWaterMark);
 
+  void enableWriteCoalescing() { coalesceWrites = true; }
+  // Opt in to gathering small queued writes into one vectored write to the sink. The first write
+  // after the queue goes idle is deferred by a microtask, so that a synchronous burst of writes is
+  // sent as one; after that, whatever piles up while a write is in flight goes out together, up
+  // to MAX_COALESCED_BYTES at a time. close() flushes anything still queued, as usual.
+
+  static constexpr size_t MAX_COALESCED_BYTES = 16 * 1024;
+  static constexpr size_t MAX_COALESCED_WRITES = 64;
+
   bool isClosedOrClosing() override;
 private:
 
@@ -238,6 +247,7 @@ private:
   kj::Maybe<PendingAbort> maybePendingAbort;
 
   uint64_t currentWriteBufferSize = 0;
+  bool coalesceWrites = false;
   kj::Maybe<uint64_t> maybeHighWaterMark;
   // The highWaterMark is the total amount of data currently buffered in
   // the controller waiting to be flushed out to the underlying WritableStreamSink.
@@ -309,8 +319,9 @@ public:
   // ReadableStreamSource implementation -------------------------------------------------
 
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override;
-
-  kj::Promise<size_t> tryReadInternal(void* buffer, size_t maxBytes);
+  // A read stays pending, accumulating bytes from successive writes, until at least `minBytes`
+  // have arrived or the stream ends. Each write is acknowledged as soon as it has been copied into
+  // the read buffer, so the writer can produce the next chunk while the read is still pending.
 
   kj::Promise<DeferredProxy<void>> pumpTo(WritableStreamSink& output, bool end) override;
 
@@ -329,7 +340,7 @@ public:
   void abort(kj::Exception reason) override;
 
 private:
-  kj::Promise<size_t> readHelper(kj::ArrayPtr<kj::byte> bytes);
+  kj::Promise<size_t> readHelper(kj::ArrayPtr<kj::byte> bytes, size_t minBytes);
 
   kj::Promise<void> writeHelper(kj::ArrayPtr<const kj::byte> bytes);
 
@@ -340,6 +351,10 @@ private:
     // WARNING: `bytes` may be invalid if fulfiller->isWaiting() returns false! (This indicates the
     //   read was canceled.)
 
+    size_t minBytes;
+    size_t filled = 0;
+    // The read completes once `filled` reaches `minBytes` (or `bytes` is full).
+
     kj::Own<kj::PromiseFulfiller<size_t>> fulfiller;
   };
 
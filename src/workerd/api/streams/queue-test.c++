@@ -1239,7 +1239,57 @@ KJ_TEST("ByteQueue with multiple default consumers with atLeast (different rate)
   js.v8Isolate->PerformMicrotaskCheckpoint();
 }
 
+KJ_TEST("ByteQueue entries are pooled") {
+  Preamble preamble;
+  auto& js = preamble.getJs();
+
+  ByteQueue queue(2);
+  ByteQueue::Consumer consumer(queue);
+
+  const void* freed;
+  {
+    auto entry = ByteQueue::Entry::create(jsg::BackingStore::alloc(js, 4));
+    freed = entry.get();
+  }
+
+  // The next entry reuses the freed memory, and behaves like any other.
+  auto entry = ByteQueue::Entry::create(jsg::BackingStore::alloc(js, 4));
+  KJ_ASSERT(entry.get() == freed);
+  queue.push(js, kj::mv(entry));
+  KJ_ASSERT(consumer.size() == 4);
+}
+
 #pragma endregion ByteQueue Tests
 
+KJ_TEST("Adaptive high water mark") {
+  HighWaterMark fixed(16);
+  fixed.observe(0);
+  KJ_ASSERT(fixed.get() == 16);
+
+  HighWaterMark hwm(0);
+  hwm.makeAdaptive(1024, 4096);
+
+  // A starved consumer grows the mark, jumping to the floor first and capped at the ceiling.
+  hwm.observe(0);
+  KJ_ASSERT(hwm.get() == 1024);
+  hwm.observe(0);
+  KJ_ASSERT(hwm.get() == 2048);
+  hwm.observe(0);
+  hwm.observe(0);
+  KJ_ASSERT(hwm.get() == 4096);
+
+  // Only a run of full observations shrinks it again.
+  for (uint i = 0; i < HighWaterMark::SHRINK_AFTER - 1; i++) {
+    hwm.observe(4096);
+  }
+  hwm.observe(100);
+  hwm.observe(4096);
+  KJ_ASSERT(hwm.get() == 4096);
+  for (uint i = 0; i < HighWaterMark::SHRINK_AFTER - 1; i++) {
+    hwm.observe(4096);
+  }
+  KJ_ASSERT(hwm.get() == 2048);
+}
+
 }  // namespace
 }  // namespace workerd::api
@@ -4,9 +4,102 @@
 
 #include "queue.h"
 #include <algorithm>
+#include <kj/vector.h>
 
 namespace workerd::api {
 
+namespace {
+
+template <typename T>
+class EntryPool final: public kj::Disposer {
+  // Queue entries are small and fixed-size, and streams of many small chunks allocate and free
+  // one per chunk per consumer. The pool keeps the memory of up to MAX_RETAINED freed entries per
+  // thread (of each entry type) for reuse, so the steady state of such a stream doesn't touch
+  // malloc for them at all.
+  //
+  // Entries may be freed on a different thread than the one that allocated them (isolates move
+  // between threads); that's fine, the memory just joins the freeing thread's pool.
+
+public:
+  static constexpr size_t MAX_RETAINED = 256;
+
+  template <typename... Params>
+  static kj::Own<T> alloc(Params&&... params) {
+    void* memory;
+    auto& blocks = freeList.blocks;
+    if (blocks.empty()) {
+      memory = operator new(sizeof(T));
+    } else {
+      memory = blocks.back();
+      blocks.removeLast();
+    }
+    KJ_ON_SCOPE_FAILURE(release(memory));
+    return kj::Own<T>(new (memory) T(kj::fwd<Params>(params)...), instance);
+  }
+
+private:
+  struct FreeList {
+    kj::Vector<void*> blocks;
+    ~FreeList() noexcept(false) {
+      for (auto block: blocks) operator delete(block);
+      releasedAll = true;
+    }
+  };
+  static thread_local FreeList freeList;
+  static thread_local bool releasedAll;
+  // Set once the thread's free list has been destroyed at thread exit, after which entries are
+  // freed directly.
+
+  static const EntryPool instance;
+
+  static void release(void* memory) {
+    if (!releasedAll && freeList.blocks.size() < MAX_RETAINED) {
+      freeList.blocks.add(memory);
+    } else {
+      operator delete(memory);
+    }
+  }
+
+  void disposeImpl(void* pointer) const override {
+    static_cast<T*>(pointer)->~T();
+    release(pointer);
+  }
+};
+
+template <typename T>
+thread_local typename EntryPool<T>::FreeList EntryPool<T>::freeList;
+template <typename T>
+thread_local bool EntryPool<T>::releasedAll = false;
+template <typename T>
+const EntryPool<T> EntryPool<T>::instance;
+
+}  // namespace
+
+// ======================================================================================
+// HighWaterMark
+
+void HighWaterMark::makeAdaptive(size_t floor, size_t ceiling) {
+  adaptive = Adaptive { .floor = floor, .ceiling = kj::max(ceiling, initial) };
+}
+
+void HighWaterMark::observe(size_t buffered) {
+  KJ_IF_MAYBE(a, adaptive) {
+    if (buffered == 0) {
+      a->fullStreak = 0;
+      if (value < a->ceiling) {
+        value = kj::min(kj::max(value * 2, a->floor), a->ceiling);
+      }
+    } else if (buffered >= value) {
+      if (++a->fullStreak >= SHRINK_AFTER) {
+        a->fullStreak = 0;
+        value = kj::max(value / 2, initial);
+      }
+    } else {
+      a->fullStreak = 0;
+    }
+  }
+}
+
 // ======================================================================================
 // ValueQueue
 #pragma region ValueQueue
@@ -32,6 +125,10 @@ void ValueQueue::ReadRequest::reject(jsg::Lock& js, jsg::Value& value) {
 ValueQueue::Entry::Entry(jsg::Value value, size_t size)
     : value(kj::mv(value)), size(size) {}
 
+kj::Own<ValueQueue::Entry> ValueQueue::Entry::create(jsg::Value value, size_t size) {
+  return EntryPool<Entry>::alloc(kj::mv(value), size);
+}
+
 jsg::Value ValueQueue::Entry::getValue(jsg::Lock& js) {
   return value.addRef(js);
 }
@@ -47,7 +144,7 @@ void ValueQueue::Entry::visitForGc(jsg::GcVisitor& visitor) {
 #pragma region ValueQueue::QueueEntry
 
 kj::Own<ValueQueue::Entry> ValueQueue::Entry::clone(jsg::Lock& js) {
-  return kj::heap<Entry>(getValue(js), getSize());
+  return create(getValue(js), getSize());
 }
 
 ValueQueue::QueueEntry ValueQueue::QueueEntry::clone(jsg::Lock& js) {
@@ -120,6 +217,8 @@ void ValueQueue::close(jsg::Lock& js) {
 
 ssize_t ValueQueue::desiredSize() const { return impl.desiredSize(); }
 
+HighWaterMark& ValueQueue::getHighWaterMark() { return impl.getHighWaterMark(); }
+
 void ValueQueue::error(jsg::Lock& js, jsg::Value reason) {
   impl.error(js, kj::mv(reason));
 }
@@ -305,12 +404,16 @@ kj::Own<ByteQueue::ByobRequest> ByteQueue::ReadRequest::makeByobReadRequest(
 
 ByteQueue::Entry::Entry(jsg::BackingStore store) : store(kj::mv(store)) {}
 
+kj::Own<ByteQueue::Entry> ByteQueue::Entry::create(jsg::BackingStore store) {
+  return EntryPool<Entry>::alloc(kj::mv(store));
+}
+
 kj::ArrayPtr<kj::byte> ByteQueue::Entry::toArrayPtr() { return store.asArrayPtr(); }
 
 size_t ByteQueue::Entry::getSize() const { return store.size(); }
 
 kj::Own<ByteQueue::Entry> ByteQueue::Entry::clone(jsg::Lock& js) {
-  return kj::heap<ByteQueue::Entry>(store.clone());
+  return create(store.clone());
 }
 
 void ByteQueue::Entry::visitForGc(jsg::GcVisitor& visitor) {}
@@ -531,6 +634,8 @@ void ByteQueue::close(jsg::Lock& js) {
 
 ssize_t ByteQueue::desiredSize() const { return impl.desiredSize(); }
 
+HighWaterMark& ByteQueue::getHighWaterMark() { return impl.getHighWaterMark(); }
+
 void ByteQueue::error(jsg::Lock& js, jsg::Value reason) {
   impl.error(js, kj::mv(reason));
 }
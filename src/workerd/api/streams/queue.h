@@ -143,6 +143,46 @@ class ConsumerImpl;
 template <typename Self>
 class QueueImpl;
 
+class HighWaterMark final {
+  // A queue's high water mark. By default this is just the fixed value from the queuing strategy,
+  // but a stream can opt in (with `adaptive: true` in its strategy) to having it adjusted based on
+  // how the consumer keeps up:
+  //
+  //  - Every time the consumer finds nothing buffered, it was waiting on the producer, so we
+  //    double the mark to let the producer run further ahead.
+  //  - If the consumer instead finds the buffer at or over the mark SHRINK_AFTER times in a
+  //    row, the producer is comfortably ahead and the extra buffering only costs memory, so we
+  //    halve it again.
+  //
+  // The mark never drops below the strategy's value, and never grows above the ceiling passed to
+  // makeAdaptive(), which is derived from the isolate's buffering limit.
+public:
+  HighWaterMark(size_t value): value(value), initial(value) {}
+
+  size_t get() const { return value; }
+
+  void makeAdaptive(size_t floor, size_t ceiling);
+  // Start adapting. The first growth step jumps straight to `floor` if the strategy's value is
+  // smaller, so that streams with a high water mark of 0 or 1 don't take forever to ramp up.
+
+  void observe(size_t buffered);
+  // Called whenever the consumer takes data from the queue, with the amount buffered at that
+  // moment. No-op unless adaptive.
+
+  static constexpr uint SHRINK_AFTER = 4;
+
+private:
+  size_t value;
+  size_t initial;
+
+  struct Adaptive {
+    size_t floor;
+    size_t ceiling;
+    uint fullStreak = 0;
+  };
+  kj::Maybe<Adaptive> adaptive;
+};
+
 template <typename Self>
 class QueueImpl final {
   // Provides the underlying implementation shared by ByteQueue and ValueQueue.
@@ -175,7 +215,7 @@ public:
     // The value can be zero or negative, in which case backpressure is
     // signaled on the queue.
     // If the queue is already closed or errored, return 0.
-    return state.template is<Ready>() ? highWaterMark - size() : 0;
+    return state.template is<Ready>() ? highWaterMark.get() - size() : 0;
   }
 
   void error(jsg::Lock& js, jsg::Value reason) {
@@ -231,6 +271,8 @@ public:
   size_t size() const { return totalQueueSize; }
   // The current size of consumer with the most stored data.
 
+  HighWaterMark& getHighWaterMark() { return highWaterMark; }
+
   size_t getConsumerCount() const {
     KJ_SWITCH_ONEOF(state) {
       KJ_CASE_ONEOF(closed, Closed) { return 0; }
@@ -271,7 +313,7 @@ private:
     std::set<ConsumerImpl*> consumers;
   };
 
-  size_t highWaterMark;
+  HighWaterMark highWaterMark;
   size_t totalQueueSize = 0;
   kj::OneOf<Ready, Closed, Errored> state = Ready();
 
@@ -394,6 +436,7 @@ public:
         return request.reject(js, e);
       }
       KJ_CASE_ONEOF(ready, Ready) {
+        queue.highWaterMark.observe(ready.queueTotalSize);
         Self::handleRead(js, ready, *this, queue, kj::mv(request));
         return maybeDrainAndSetState(js);
       }
@@ -595,6 +638,10 @@ public:
     explicit Entry(jsg::Value value, size_t size);
     KJ_DISALLOW_COPY_AND_MOVE(Entry);
 
+    static kj::Own<Entry> create(jsg::Value value, size_t size);
+    // Like kj::heap<Entry>(), but reuses the memory of recently freed entries. Prefer this on hot
+    // paths, since a queue allocates an entry per chunk per consumer.
+
     jsg::Value getValue(jsg::Lock& js);
 
     size_t getSize() const;
@@ -657,6 +704,8 @@ public:
 
   ssize_t desiredSize() const;
 
+  HighWaterMark& getHighWaterMark();
+
   void error(jsg::Lock& js, jsg::Value reason);
 
   void maybeUpdateBackpressure();
@@ -785,6 +834,10 @@ public:
   public:
     explicit Entry(jsg::BackingStore store);
 
+    static kj::Own<Entry> create(jsg::BackingStore store);
+    // Like kj::heap<Entry>(), but reuses the memory of recently freed entries. Prefer this on hot
+    // paths, since a queue allocates an entry per chunk per consumer.
+
     kj::ArrayPtr<kj::byte> toArrayPtr();
 
     size_t getSize() const;
@@ -846,6 +899,8 @@ public:
 
   ssize_t desiredSize() const;
 
+  HighWaterMark& getHighWaterMark();
+
   void error(jsg::Lock& js, jsg::Value reason);
 
   void maybeUpdateBackpressure();
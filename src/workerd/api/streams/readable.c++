@@ -423,13 +423,23 @@ kj::Array<jsg::Ref<ReadableStream>> ReadableStream::tee(jsg::Lock& js) {
 jsg::Promise<kj::Maybe<jsg::Value>> ReadableStream::nextFunction(
     jsg::Lock& js,
     AsyncIteratorState& state) {
-  return state.reader->read(js).then(js,
-      [reader = state.reader.addRef()](jsg::Lock& js, ReadResult result) mutable {
+  auto handleResult = [](jsg::Lock& js, ReadableStreamDefaultReader& reader, ReadResult result) {
     if (result.done) {
-      reader->releaseLock(js);
+      reader.releaseLock(js);
       return js.resolvedPromise(kj::Maybe<jsg::Value>(nullptr));
     }
     return js.resolvedPromise<kj::Maybe<jsg::Value>>(kj::mv(result.value));
+  };
+
+  auto promise = state.reader->read(js);
+  KJ_IF_MAYBE(result, promise.tryConsumeResolved(js)) {
+    // The chunk was already queued. Returning an already-resolved promise lets the async iterator
+    // hand it out without waiting for a continuation to run.
+    return handleResult(js, *state.reader, kj::mv(*result));
+  }
+  return promise.then(js,
+      [reader = state.reader.addRef(), handleResult](jsg::Lock& js, ReadResult result) mutable {
+    return handleResult(js, *reader, kj::mv(result));
   });
 }
 
@@ -487,10 +487,42 @@ jsg::Promise<void> maybeRunAlgorithm(
   return js.resolvedPromise();
 }
 
+bool isByteSource(const UnderlyingSource& underlyingSource) {
+  return underlyingSource.type.map([](auto& s) { return s == "bytes"; }).orDefault(false);
+}
+
 int getHighWaterMark(const UnderlyingSource& underlyingSource,
                      const StreamQueuingStrategy& queuingStrategy) {
-  bool isBytes = underlyingSource.type.map([](auto& s) { return s == "bytes"; }).orDefault(false);
-  return queuingStrategy.highWaterMark.orDefault(isBytes ? 0 : 1);
+  return queuingStrategy.highWaterMark.orDefault(isByteSource(underlyingSource) ? 0 : 1);
+}
+
+constexpr size_t ADAPTIVE_BYTES_FLOOR = 16 * 1024;
+constexpr size_t ADAPTIVE_MAX_GROWTH = 64;
+// An adaptive byte stream ramps up from 16 KiB and can grow to 1 MiB. Other streams measure
+// their queue in whatever units their size algorithm uses, so we can only bound them relative to
+// their initial high water mark.
+
+void maybeMakeAdaptive(HighWaterMark& highWaterMark,
+                       const StreamQueuingStrategy& queuingStrategy,
+                       size_t floor) {
+  if (!queuingStrategy.adaptive.orDefault(false)) return;
+
+  size_t ceiling = kj::max(highWaterMark.get(), floor) * ADAPTIVE_MAX_GROWTH;
+  if (IoContext::hasCurrent()) {
+    // Leave at least half of the buffering limit for everything else the request is doing.
+    ceiling = kj::min(
+        ceiling, IoContext::current().getLimitEnforcer().getBufferingLimit() / 2);
+  }
+  highWaterMark.makeAdaptive(floor, ceiling);
+}
+
+template <typename Queue>
+Queue makeQueue(const UnderlyingSource& underlyingSource,
+                const StreamQueuingStrategy& queuingStrategy) {
+  Queue queue(getHighWaterMark(underlyingSource, queuingStrategy));
+  maybeMakeAdaptive(queue.getHighWaterMark(), queuingStrategy,
+                    isByteSource(underlyingSource) ? ADAPTIVE_BYTES_FLOOR : 1);
+  return queue;
 }
 
 }  // namespace
@@ -792,7 +824,7 @@ template <typename Self>
 ReadableImpl<Self>::ReadableImpl(
     UnderlyingSource underlyingSource,
     StreamQueuingStrategy queuingStrategy)
-    : state(Queue(getHighWaterMark(underlyingSource, queuingStrategy))),
+    : state(makeQueue<Queue>(underlyingSource, queuingStrategy)),
       algorithms(kj::mv(underlyingSource), kj::mv(queuingStrategy)) {}
 
 template <typename Self>
@@ -1107,7 +1139,7 @@ kj::Maybe<WritableStreamJsController&> WritableImpl<Self>::tryGetOwner() {
 
 template <typename Self>
 ssize_t WritableImpl<Self>::getDesiredSize() {
-  return highWaterMark - amountBuffered;
+  return highWaterMark.get() - amountBuffered;
 }
 
 template <typename Self>
@@ -1366,6 +1398,7 @@ void WritableImpl<Self>::setup(
   starting = true;
 
   highWaterMark = queuingStrategy.highWaterMark.orDefault(1);
+  maybeMakeAdaptive(highWaterMark, queuingStrategy, 1);
   auto startAlgorithm = kj::mv(underlyingSink.start);
   algorithms.write = kj::mv(underlyingSink.write);
   algorithms.close = kj::mv(underlyingSink.close);
@@ -1467,6 +1500,9 @@ jsg::Promise<void> WritableImpl<Self>::write(
 
   KJ_ASSERT(isWritable());
 
+  // From the sink's point of view, a write arriving at an empty queue means it was idle.
+  highWaterMark.observe(amountBuffered);
+
   auto prp = js.newPromiseAndResolver<void>();
   writeRequests.push_back(WriteRequest {
     .resolver = kj::mv(prp.resolver),
@@ -1645,6 +1681,11 @@ struct ValueReadable final: public api::ValueQueue::ConsumerImpl::StateListener
     return state.map([](State& state) { return state.hasPendingReadRequests(); }).orDefault(false);
   }
 
+  size_t bufferedSize() {
+    // The amount of data (as measured by the queue) that a read() could take without waiting.
+    return state.map([](State& state) { return state.consumer->size(); }).orDefault(0);
+  }
+
   void setOwner(auto newOwner) {
     KJ_IF_MAYBE(s, state) { s->setOwner(kj::mv(newOwner)); }
   }
@@ -1748,6 +1789,11 @@ struct ByteReadable final: public api::ByteQueue::ConsumerImpl::StateListener {
     return state.map([](State& state) { return state.hasPendingReadRequests(); }).orDefault(false);
   }
 
+  size_t bufferedSize() {
+    // The amount of data (as measured by the queue) that a read() could take without waiting.
+    return state.map([](State& state) { return state.consumer->size(); }).orDefault(0);
+  }
+
   void setOwner(auto newOwner) {
     KJ_IF_MAYBE(s, state) { s->setOwner(kj::mv(newOwner)); }
   }
@@ -1933,7 +1979,7 @@ void ReadableStreamDefaultController::enqueue(
   }
 
   if (!errored) {
-    impl.enqueue(js, kj::heap<ValueQueue::Entry>(js.v8Ref(value), size), JSG_THIS);
+    impl.enqueue(js, ValueQueue::Entry::create(js.v8Ref(value), size), JSG_THIS);
   }
 }
 
@@ -2024,7 +2070,7 @@ void ReadableStreamBYOBRequest::respond(jsg::Lock& js, int bytesWritten) {
       // While this particular request may be invalidated, there are still
       // other branches we can push the data to. Let's do so.
       jsg::BufferSource source(js, impl.view.getHandle(js));
-      auto entry = kj::heap<ByteQueue::Entry>(source.detach(js));
+      auto entry = ByteQueue::Entry::create(source.detach(js));
       impl.controller->impl.enqueue(js, kj::mv(entry), impl.controller.addRef());
     } else {
       JSG_REQUIRE(bytesWritten > 0,
@@ -2062,7 +2108,7 @@ void ReadableStreamBYOBRequest::respondWithNewView(jsg::Lock& js, jsg::BufferSou
     if (impl.readRequest->isInvalidated() && impl.controller->impl.consumerCount() >= 1) {
       // While this particular request may be invalidated, there are still
       // other branches we can push the data to. Let's do so.
-      auto entry = kj::heap<ByteQueue::Entry>(view.detach(js));
+      auto entry = ByteQueue::Entry::create(view.detach(js));
       impl.controller->impl.enqueue(js, kj::mv(entry), impl.controller.addRef());
     } else {
       JSG_REQUIRE(view.size() > 0,
@@ -2159,7 +2205,7 @@ void ReadableByteStreamController::enqueue(jsg::Lock& js, jsg::BufferSource chun
     (*byobRequest)->invalidate(js);
   }
 
-  impl.enqueue(js, kj::heap<ByteQueue::Entry>(chunk.detach(js)), JSG_THIS);
+  impl.enqueue(js, ByteQueue::Entry::create(chunk.detach(js)), JSG_THIS);
 }
 
 void ReadableByteStreamController::error(jsg::Lock& js, v8::Local<v8::Value> reason) {
@@ -2898,11 +2944,69 @@ private:
            state.template is<StreamStates::Closed>();
   }
 
+  static constexpr size_t MAX_BATCH_BYTES = 64 * 1024;
+  // When several chunks are already buffered in the readable, we pull them out synchronously and
+  // write them to the sink together, up to this many bytes, so that a JS producer that enqueues
+  // many small chunks costs one trip through the event loop per batch rather than per chunk.
+
+  using Result = kj::OneOf<Pumping,              // Continue with next read.
+                           kj::Array<kj::byte>,  // Bytes to write were returned.
+                           StreamStates::Closed, // Readable indicated done.
+                           jsg::Value>;          // There was an error.
+
+  static jsg::Promise<ReadResult> readFrom(jsg::Lock& js, T& readable) {
+    // There's no need to use a ReadPendingScope here because synchronous
+    // calls to doClose/doError will not impact the lifetime of the readable
+    // state.
+    if constexpr (kj::isSameType<T, ByteReadable>()) {
+      return readable.read(js, nullptr);
+    } else {
+      return readable.read(js);
+    }
+  }
+
+  static Result toResult(jsg::Lock& js, ReadResult result) {
+    KJ_REQUIRE(!js.v8Isolate->IsExecutionTerminating(),
+        "Attempting to continue pump after isolate execution terminating.");
+
+    if (result.done) {
+      // Indicate to the outer promise that the readable is done.
+      // There's nothing further to do.
+      return StreamStates::Closed ();
+    }
+
+    // If we're not done, the result value must be interpretable as
+    // bytes for the read to make any sense.
+    auto handle = KJ_ASSERT_NONNULL(result.value).getHandle(js);
+    if (!handle->IsArrayBufferView() && !handle->IsArrayBuffer()) {
+      return js.v8Ref(js.v8TypeError("This ReadableStream did not return bytes."));
+    }
+
+    jsg::BufferSource bufferSource(js, handle);
+    if (bufferSource.size() == 0) {
+      // Weird, but allowed. We'll skip it.
+      return Pumping {};
+    }
+
+    if constexpr (kj::isSameType<T, ByteReadable>()) {
+      jsg::BackingStore backing = bufferSource.detach(js);
+      return backing.asArrayPtr().attach(kj::mv(backing));
+    } else if constexpr (kj::isSameType<T, ValueReadable>()) {
+      // We do not detach in this case because, as bad as an idea as it is,
+      // the stream spec does allow a single typedarray/arraybuffer instance
+      // to be queued multiple times when using value-oriented streams.
+      return bufferSource.asArrayPtr().attach(kj::mv(bufferSource));
+    }
+
+    KJ_UNREACHABLE;
+  }
+
   jsg::Promise<void> pumpLoop(
       jsg::Lock& js,
       IoContext& ioContext,
       Readable readable,
-      IoOwn<WeakRef<AllReaderBase>> pumpToReader) {
+      IoOwn<WeakRef<AllReaderBase>> pumpToReader,
+      kj::Maybe<jsg::Promise<ReadResult>> nextRead = nullptr) {
     ioContext.requireCurrentOrThrowJs();
     KJ_SWITCH_ONEOF(state) {
       KJ_CASE_ONEOF(ready, Readable) {
@@ -2923,21 +3027,14 @@ private:
         KJ_REQUIRE(!js.v8Isolate->IsExecutionTerminating(),
             "Attempting to continue pump after isolate execution terminating.");
 
-        const auto read = [&](auto& js) {
-          // There's no need to use a ReadPendingScope here because synchronous
-          // calls to doClose/doError will not impact the lifetime of the readable
-          // state.
-          if constexpr (kj::isSameType<T, ByteReadable>()) {
-            return readable->read(js, nullptr);
-          } else {
-            return readable->read(js);
+        // If a previous iteration left a read in flight, continue with it rather than starting
+        // another.
+        auto read = [&]() -> jsg::Promise<ReadResult> {
+          KJ_IF_MAYBE(p, nextRead) {
+            return kj::mv(*p);
           }
-        };
-
-        using Result = kj::OneOf<Pumping,              // Continue with next read.
-                                 kj::Array<kj::byte>,  // Bytes to write were returned.
-                                 StreamStates::Closed, // Readable indicated done.
-                                 jsg::Value>;          // There was an error.
+          return readFrom(js, *readable);
+        }();
 
         // The flow here is relatively straightforward but the ownership of
         // readable/pumpToReader is fairly complicated.
@@ -2954,7 +3051,8 @@ private:
         // if necessary and just stopping. If the PumpToReader is alive, our next
         // step is determined by the result of the read.
         //
-        // If the read provided bytes, we write those into the sink, which returns
+        // If the read provided bytes, we gather up any more bytes that the readable
+        // can provide synchronously, and write all of them into the sink, which returns
         // a kj::Promise wrapped with a JS promise. If that write fails, we error
         // the PumpToReader and cleanup. If the write succeeds, we loop again for
         // another read.
@@ -2977,42 +3075,9 @@ private:
         // be freed. When the JS promise resolves, we make sure we detect that
         // case and handle appropriately (generally by canceling the readable
         // and exiting the loop).
-        return read(js).then(js, ioContext.addFunctor(
-            [](auto& js, ReadResult result) mutable -> Result {
-
-          KJ_REQUIRE(!js.v8Isolate->IsExecutionTerminating(),
-              "Attempting to continue pump after isolate execution terminating.");
-
-          if (result.done) {
-            // Indicate to the outer promise that the readable is done.
-            // There's nothing further to do.
-            return StreamStates::Closed ();
-          }
-
-          // If we're not done, the result value must be interpretable as
-          // bytes for the read to make any sense.
-          auto handle = KJ_ASSERT_NONNULL(result.value).getHandle(js);
-          if (!handle->IsArrayBufferView() && !handle->IsArrayBuffer()) {
-            return js.v8Ref(js.v8TypeError("This ReadableStream did not return bytes."));
-          }
-
-          jsg::BufferSource bufferSource(js, handle);
-          if (bufferSource.size() == 0) {
-            // Weird, but allowed. We'll skip it.
-            return Pumping {};
-          }
-
-          if constexpr (kj::isSameType<T, ByteReadable>()) {
-            jsg::BackingStore backing = bufferSource.detach(js);
-            return backing.asArrayPtr().attach(kj::mv(backing));
-          } else if constexpr (kj::isSameType<T, ValueReadable>()) {
-            // We do not detach in this case because, as bad as an idea as it is,
-            // the stream spec does allow a single typedarray/arraybuffer instance
-            // to be queued multiple times when using value-oriented streams.
-            return bufferSource.asArrayPtr().attach(kj::mv(bufferSource));
-          }
-
-          KJ_UNREACHABLE;
+        return read.then(js, ioContext.addFunctor(
+            [](jsg::Lock& js, ReadResult result) mutable -> Result {
+          return toResult(js, kj::mv(result));
         }), [](auto& js, jsg::Value exception) mutable -> Result {
           return kj::mv(exception);
         }).then(js, ioContext.addFunctor(
@@ -3031,12 +3096,48 @@ private:
             auto& ioContext = IoContext::current();
             KJ_SWITCH_ONEOF(result) {
               KJ_CASE_ONEOF(bytes, kj::Array<kj::byte>) {
+                // We received bytes to write. Before doing so, take any further chunks the
+                // readable already has buffered, up to MAX_BATCH_BYTES.
+                kj::Vector<kj::Array<kj::byte>> batch;
+                size_t batchSize = bytes.size();
+                batch.add(kj::mv(bytes));
+                kj::Maybe<Result> trailing;
+                kj::Maybe<jsg::Promise<ReadResult>> nextRead;
+                while (batchSize < MAX_BATCH_BYTES && readable->bufferedSize() > 0 &&
+                       !readable->hasPendingReadRequests()) {
+                  auto read = readFrom(js, *readable);
+                  KJ_IF_MAYBE(r, read.tryConsumeResolved(js)) {
+                    auto next = toResult(js, kj::mv(*r));
+                    KJ_IF_MAYBE(more, next.template tryGet<kj::Array<kj::byte>>()) {
+                      batchSize += more->size();
+                      batch.add(kj::mv(*more));
+                    } else if (!next.template is<Pumping>()) {
+                      // Done or errored; handle that once the batch is written.
+                      trailing = kj::mv(next);
+                      break;
+                    }
+                  } else {
+                    // The read didn't complete synchronously after all. The next iteration
+                    // will wait for it.
+                    nextRead = kj::mv(read);
+                    break;
+                  }
+                }
+
                 // We received bytes to write. Do so...
                 // (It's safe to directly access reader->sink here --it's an kj::Own--
                 // because we accessed the reader through an IoOwn, proving that
                 // we're in the correct IoContext...)
-                auto promise = reader->sink->write(bytes.begin(), bytes.size())
-                    .attach(kj::mv(bytes));
+                kj::Promise<void> promise = nullptr;
+                if (batch.size() == 1) {
+                  promise = reader->sink->write(batch[0].begin(), batch[0].size())
+                      .attach(kj::mv(batch));
+                } else {
+                  auto pieces = KJ_MAP(piece, batch) -> kj::ArrayPtr<const kj::byte> {
+                    return piece;
+                  };
+                  promise = reader->sink->write(pieces).attach(kj::mv(pieces), kj::mv(batch));
+                }
                 // Wrap the write promise in a canceler that will be triggered when the
                 // PumpToReader is dropped. While the write promise is pending, it is
                 // possible for the promise that is holding the PumpToReader to be
@@ -3052,8 +3153,9 @@ private:
                   return kj::mv(exception);
                 }).then(js, ioContext.addFunctor(
                     JSG_VISITABLE_LAMBDA(
-                      (readable=kj::mv(readable),pumpToReader=kj::mv(pumpToReader)),
-                      (readable),
+                      (readable=kj::mv(readable),pumpToReader=kj::mv(pumpToReader),
+                       trailing=kj::mv(trailing),nextRead=kj::mv(nextRead)),
+                      (readable, nextRead),
                       (jsg::Lock& js, kj::Maybe<jsg::Value> maybeException) mutable {
                   KJ_IF_MAYBE(reader, tryGetAs<PumpToReader>(pumpToReader)) {
                     auto& ioContext = reader->ioContext;
@@ -3062,8 +3164,15 @@ private:
                     // the PumpToReader is still alive.
                     KJ_IF_MAYBE(exception, maybeException) {
                       reader->doError(js, exception->getHandle(js));
+                    } else KJ_IF_MAYBE(t, trailing) {
+                      KJ_IF_MAYBE(exception, t->template tryGet<jsg::Value>()) {
+                        reader->doError(js, exception->getHandle(js));
+                      } else {
+                        reader->doClose();
+                      }
                     }
-                    return reader->pumpLoop(js, ioContext, kj::mv(readable), kj::mv(pumpToReader));
+                    return reader->pumpLoop(js, ioContext, kj::mv(readable), kj::mv(pumpToReader),
+                        kj::mv(nextRead));
                   } else {
                     // If we got here, we're in the right IoContext but the PumpToReader
                     // has been destroyed. Let's cancel the readable as the last step.
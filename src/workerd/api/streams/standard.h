@@ -370,7 +370,7 @@ private:
   bool started = false;
   bool starting = false;
   bool backpressure = false;
-  size_t highWaterMark = 1;
+  HighWaterMark highWaterMark = 1;
 
   std::deque<WriteRequest> writeRequests;
   size_t amountBuffered = 0;
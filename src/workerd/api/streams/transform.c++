@@ -122,6 +122,25 @@ jsg::Ref<TransformStream> TransformStream::constructor(
   return IdentityTransformStream::constructor(js);
 }
 
+namespace {
+
+jsg::Ref<WritableStream> newIdentityWritableSide(
+    IoContext& ioContext,
+    kj::Own<WritableStreamSink> sink,
+    kj::Maybe<uint64_t> maybeHighWaterMark,
+    const jsg::Optional<IdentityTransformStream::QueuingStrategy>& maybeQueuingStrategy) {
+  auto controller = kj::heap<WritableStreamInternalController>(
+      ioContext.addObject(kj::mv(sink)), maybeHighWaterMark);
+  KJ_IF_MAYBE(queuingStrategy, maybeQueuingStrategy) {
+    if (queuingStrategy->coalesceWrites.orDefault(false)) {
+      controller->enableWriteCoalescing();
+    }
+  }
+  return jsg::alloc<WritableStream>(kj::mv(controller));
+}
+
+}  // namespace
+
 jsg::Ref<IdentityTransformStream> IdentityTransformStream::constructor(
     jsg::Lock& js,
     jsg::Optional<IdentityTransformStream::QueuingStrategy> maybeQueuingStrategy) {
@@ -137,7 +156,8 @@ jsg::Ref<IdentityTransformStream> IdentityTransformStream::constructor(
 
   return jsg::alloc<IdentityTransformStream>(
       jsg::alloc<ReadableStream>(ioContext, kj::mv(readableSide)),
-      jsg::alloc<WritableStream>(ioContext, kj::mv(writableSide), maybeHighWaterMark));
+      newIdentityWritableSide(ioContext, kj::mv(writableSide), maybeHighWaterMark,
+                              maybeQueuingStrategy));
 }
 
 jsg::Ref<FixedLengthStream> FixedLengthStream::constructor(
@@ -164,7 +184,8 @@ jsg::Ref<FixedLengthStream> FixedLengthStream::constructor(
 
   return jsg::alloc<FixedLengthStream>(
       jsg::alloc<ReadableStream>(ioContext, kj::mv(readableSide)),
-      jsg::alloc<WritableStream>(ioContext, kj::mv(writableSide), maybeHighWaterMark));
+      newIdentityWritableSide(ioContext, kj::mv(writableSide), maybeHighWaterMark,
+                              maybeQueuingStrategy));
 }
 
 }  // namespace workerd::api
@@ -83,7 +83,12 @@ public:
   struct QueuingStrategy {
     jsg::Optional<uint64_t> highWaterMark;
 
-    JSG_STRUCT(highWaterMark);
+    jsg::Optional<bool> coalesceWrites;
+    // If true, small writes that queue up on the writable side are passed on as one larger write.
+    // Useful when writing many small chunks to a response body. See
+    // WritableStreamInternalController::enableWriteCoalescing().
+
+    JSG_STRUCT(highWaterMark, coalesceWrites);
   };
 
   static jsg::Ref<IdentityTransformStream> constructor(
@@ -63,15 +63,15 @@ kj::String getTraceLogLevel(const Trace::Log& log) {
   KJ_UNREACHABLE;
 }
 
-jsg::V8Ref<v8::Object> getTraceLogMessage(jsg::Lock& js, const Trace::Log& log) {
-  auto jsonString = jsg::v8Str(js.v8Isolate, log.message);
+jsg::V8Ref<v8::Object> parseTraceJson(jsg::Lock& js, kj::StringPtr json) {
+  auto jsonString = jsg::v8Str(js.v8Isolate, json);
   auto handle = jsg::check(v8::JSON::Parse(js.v8Context(), jsonString));
   return js.v8Ref(handle.As<v8::Object>());
 }
 
-kj::Array<jsg::Ref<TraceLog>> getTraceLogs(jsg::Lock& js, const Trace& trace) {
+kj::Array<jsg::Ref<TraceLog>> getTraceLogs(const Trace& trace) {
   return KJ_MAP(x, trace.logs) -> jsg::Ref<TraceLog> {
-    return jsg::alloc<TraceLog>(js, trace, x);
+    return jsg::alloc<TraceLog>(trace, x);
   };
 }
 
@@ -113,15 +113,12 @@ kj::String getTraceOutcome(const Trace& trace) {
 }
 
 kj::Own<TraceItem::FetchEventInfo::Request::Detail> getFetchRequestDetail(
-    jsg::Lock& js,
     const Trace& trace,
     const Trace::FetchEventInfo& eventInfo) {
-  const auto getCf = [&]() -> jsg::Optional<jsg::V8Ref<v8::Object>> {
-    const auto& cfJson = eventInfo.cfJson;
+  const auto getCfJson = [&]() -> kj::Maybe<kj::String> {
+    auto cfJson = eventInfo.getCfJson();
     if (cfJson.size() > 0) {
-      auto jsonString = jsg::v8Str(js.v8Isolate, cfJson);
-      auto handle = jsg::check(v8::JSON::Parse(js.v8Context(), jsonString));
-      return js.v8Ref(handle.As<v8::Object>());
+      return kj::str(cfJson);
     }
     return nullptr;
   };
@@ -133,7 +130,7 @@ kj::Own<TraceItem::FetchEventInfo::Request::Detail> getFetchRequestDetail(
   };
 
   return kj::refcounted<TraceItem::FetchEventInfo::Request::Detail>(
-    getCf(),
+    getCfJson(),
     getHeaders(),
     kj::str(eventInfo.method),
     kj::str(eventInfo.url));
@@ -169,7 +166,7 @@ kj::Maybe<TraceItem::EventInfo> getTraceEvent(jsg::Lock& js, const Trace& trace)
 TraceItem::TraceItem(jsg::Lock& js, const Trace& trace)
     : eventInfo(getTraceEvent(js, trace)),
       eventTimestamp(getTraceTimestamp(trace)),
-      logs(getTraceLogs(js, trace)),
+      logs(getTraceLogs(trace)),
       exceptions(getTraceExceptions(trace)),
       diagnosticChannelEvents(getTraceDiagnosticChannelEvents(js, trace)),
       scriptName(trace.scriptName.map([](auto& name) { return kj::str(name); })),
@@ -237,11 +234,11 @@ TraceItem::FetchEventInfo::FetchEventInfo(jsg::Lock& js,
       response(responseInfo.map([&](auto& info) { return jsg::alloc<Response>(trace, info); })) {}
 
 TraceItem::FetchEventInfo::Request::Detail::Detail(
-    jsg::Optional<jsg::V8Ref<v8::Object>> cf,
+    kj::Maybe<kj::String> cfJson,
     kj::Array<Trace::FetchEventInfo::Header> headers,
     kj::String method,
     kj::String url)
-    : cf(kj::mv(cf)),
+    : cfJson(kj::mv(cfJson)),
       headers(kj::mv(headers)),
       method(kj::mv(method)),
       url(kj::mv(url)) {}
@@ -259,12 +256,18 @@ jsg::Optional<jsg::Ref<TraceItem::FetchEventInfo::Response>> TraceItem::FetchEve
 TraceItem::FetchEventInfo::Request::Request(jsg::Lock& js,
                                             const Trace& trace,
                                             const Trace::FetchEventInfo& eventInfo)
-    : detail(getFetchRequestDetail(js, trace, eventInfo)) {}
+    : detail(getFetchRequestDetail(trace, eventInfo)) {}
 
 TraceItem::FetchEventInfo::Request::Request(Detail& detail, bool redacted)
     : redacted(redacted), detail(kj::addRef(detail)) {}
 
 jsg::Optional<jsg::V8Ref<v8::Object>> TraceItem::FetchEventInfo::Request::getCf(jsg::Lock& js) {
+  KJ_IF_MAYBE(json, detail->cfJson) {
+    // Parsed on first access and cached in the shared Detail, so that the redacted and unredacted
+    // views hand out the same object.
+    detail->cf = parseTraceJson(js, *json);
+    detail->cfJson = nullptr;
+  }
   return detail->cf.map([&](jsg::V8Ref<v8::Object>& obj) {
     return obj.addRef(js);
   });
@@ -392,10 +395,10 @@ TraceItem::CustomEventInfo::CustomEventInfo(const Trace& trace,
                                             const Trace::CustomEventInfo& eventInfo)
     : eventInfo(eventInfo) {}
 
-TraceLog::TraceLog(jsg::Lock& js, const Trace& trace, const Trace::Log& log)
+TraceLog::TraceLog(const Trace& trace, const Trace::Log& log)
     : timestamp(getTraceLogTimestamp(log)),
       level(getTraceLogLevel(log)),
-      message(getTraceLogMessage(js, log)) {}
+      message(kj::str(log.message)) {}
 
 double TraceLog::getTimestamp() {
   return timestamp;
@@ -406,7 +409,8 @@ kj::StringPtr TraceLog::getLevel() {
 }
 
 jsg::V8Ref<v8::Object> TraceLog::getMessage(jsg::Lock& js) {
-  return message.addRef(js);
+  // Only called once, since `message` is a lazy instance property.
+  return parseTraceJson(js, message);
 }
 
 TraceException::TraceException(const Trace& trace, const Trace::Exception& exception)
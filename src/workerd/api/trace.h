@@ -147,12 +147,16 @@ private:
 class TraceItem::FetchEventInfo::Request final: public jsg::Object {
 public:
   struct Detail : public kj::Refcounted {
+    kj::Maybe<kj::String> cfJson;
     jsg::Optional<jsg::V8Ref<v8::Object>> cf;
+    // The cf object is kept as JSON until a handler first reads it; most tail handlers never do,
+    // and parsing it dominates the cost of building the trace items.
+
     kj::Array<Trace::FetchEventInfo::Header> headers;
     kj::String method;
     kj::String url;
 
-    Detail(jsg::Optional<jsg::V8Ref<v8::Object>> cf,
+    Detail(kj::Maybe<kj::String> cfJson,
            kj::Array<Trace::FetchEventInfo::Header> headers,
            kj::String method,
            kj::String url);
@@ -301,7 +305,7 @@ private:
 
 class TraceLog final: public jsg::Object {
 public:
-  TraceLog(jsg::Lock& js, const Trace& trace, const Trace::Log& log);
+  TraceLog(const Trace& trace, const Trace::Log& log);
 
   double getTimestamp();
   kj::StringPtr getLevel();
@@ -316,7 +320,8 @@ public:
 private:
   double timestamp;
   kj::String level;
-  jsg::V8Ref<v8::Object> message;
+  kj::String message;
+  // JSON, parsed when the property is first read.
 };
 
 class TraceException final: public jsg::Object {
@@ -618,7 +618,9 @@ kj::Maybe<UrlRecord> URL::parse(
   bool passwordTokenSeen = false;
 
   const auto trimControlOrSpace = [&maybeRecord](jsg::UsvStringPtr& input) {
-    if (input.empty()) return jsg::usv();
+    // Trims `input` in place, and returns true if it still contains tabs or newlines, which must
+    // then be stripped.
+    if (input.empty()) return false;
     auto start = input.begin();
     auto end = input.end() - 1;
 
@@ -628,13 +630,17 @@ kj::Maybe<UrlRecord> URL::parse(
       while (start && isControlOrSpaceCodepoint(*start)) { ++start; }
       while (end && end > start && isControlOrSpaceCodepoint(*end)) { --end; }
 
-      // Now go through the remaining and strip tabs and newlines.
       input = input.slice(start, end + 1);
     }
 
-    if (input.empty()) return jsg::usv();
+    return input.visitStorage([](auto chars) {
+      return std::any_of(chars.begin(), chars.end(), [](uint32_t c) {
+        return c == 0x09 /* tab */ || c == 0x0a /* lf */ || c == 0x0d /* cr */;
+      });
+    });
+  };
 
-    // But we always strip tabs and new-lines in the input.
+  const auto stripTabOrNewline = [](jsg::UsvStringPtr input) {
     jsg::UsvStringBuilder res(input.size());
     auto it = input.begin();
     while (it) {
@@ -644,12 +650,17 @@ kj::Maybe<UrlRecord> URL::parse(
       }
       ++it;
     }
-
     return res.finish();
   };
 
-  // Per the spec, we have to trim leading control and space characters.
-  auto processed = trimControlOrSpace(input);
+  // Per the spec, we have to trim leading control and space characters, and always strip tabs and
+  // newlines. Input rarely has tabs or newlines in it, so only copy it when it does.
+  jsg::UsvString stripped;
+  jsg::UsvStringPtr processed = input;
+  if (trimControlOrSpace(processed)) {
+    stripped = stripTabOrNewline(processed);
+    processed = stripped.asPtr();
+  }
 
   auto it = processed.begin();
 
@@ -1539,7 +1550,7 @@ kj::Maybe<UrlRecord> URL::parse(
             if (record.scheme == getCommonStrings().SCHEME_FILE &&
                 pathIsEmpty(record) &&
                 isWindowsDriveLetter(temp, false)) {
-              temp.storage()[1] = ':';
+              buffer.set(1, ':');
             }
             appendToPath(jsg::usv(temp));
           }
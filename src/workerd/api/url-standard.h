@@ -159,7 +159,7 @@ private:
     Entry(jsg::UsvString name, jsg::UsvString value)
         : name(kj::mv(name)),
           value(kj::mv(value)),
-          hash(kj::hashCode(this->name.storage())) {}
+          hash(this->name.hashCode()) {}
 
     Entry(Entry&&) = default;
     Entry& operator=(Entry&&) = default;
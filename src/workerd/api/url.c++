@@ -143,15 +143,45 @@ kj::String kjUrlToString(const kj::Url& url) {
 // =======================================================================================
 // URL
 
-jsg::Ref<URL> URL::constructor(kj::String url, jsg::Optional<kj::String> base) {
+jsg::Ref<URL> URL::constructor(Input url, jsg::Optional<Input> base) {
   KJ_IF_MAYBE(b, base) {
-    auto baseUrl = JSG_REQUIRE_NONNULL(kj::Url::tryParse(kj::mv(*b)),
-        TypeError, "Invalid base URL string.");
-    return jsg::alloc<URL>(JSG_REQUIRE_NONNULL(baseUrl.tryParseRelative(kj::mv(url)),
+    kj::String urlString;
+    KJ_SWITCH_ONEOF(url) {
+      KJ_CASE_ONEOF(u, jsg::Ref<URL>) {
+        urlString = u->toString();
+      }
+      KJ_CASE_ONEOF(string, kj::String) {
+        urlString = kj::mv(string);
+      }
+    }
+
+    kj::Maybe<kj::Url> maybeParsed;
+    KJ_SWITCH_ONEOF(*b) {
+      KJ_CASE_ONEOF(baseUrl, jsg::Ref<URL>) {
+        maybeParsed = baseUrl->url->tryParseRelative(kj::mv(urlString));
+      }
+      KJ_CASE_ONEOF(baseString, kj::String) {
+        auto baseUrl = JSG_REQUIRE_NONNULL(kj::Url::tryParse(kj::mv(baseString)),
+            TypeError, "Invalid base URL string.");
+        maybeParsed = baseUrl.tryParseRelative(kj::mv(urlString));
+      }
+    }
+    return jsg::alloc<URL>(JSG_REQUIRE_NONNULL(kj::mv(maybeParsed),
         TypeError, "Invalid relative URL string."));
   }
-  return jsg::alloc<URL>(JSG_REQUIRE_NONNULL(kj::Url::tryParse(kj::mv(url)),
-      TypeError, "Invalid URL string."));
+
+  KJ_SWITCH_ONEOF(url) {
+    KJ_CASE_ONEOF(u, jsg::Ref<URL>) {
+      // The other URL is already parsed and normalized, so a copy is equivalent to parsing its
+      // href.
+      return jsg::alloc<URL>(u->url->clone());
+    }
+    KJ_CASE_ONEOF(string, kj::String) {
+      return jsg::alloc<URL>(JSG_REQUIRE_NONNULL(kj::Url::tryParse(kj::mv(string)),
+          TypeError, "Invalid URL string."));
+    }
+  }
+  KJ_UNREACHABLE;
 }
 
 URL::URL(kj::Url&& u): url(kj::refcounted<RefcountedUrl>(kj::mv(u))) {
@@ -176,6 +206,12 @@ URL::URL(kj::Url&& u): url(kj::refcounted<RefcountedUrl>(kj::mv(u))) {
 // kj::Url's parser, more and more unit tests for this wrapper class should start passing without
 // modification.
 //
+// Only the protocol setter still goes through this, since changing the scheme changes how the
+// rest of the URL must be parsed. The username and password setters write the component in place:
+// kj::Url stores them decoded and re-encodes them on output, so the round trip through a string
+// could never change them. The remaining setters already either mutate in place or parse just their
+// own component, and URLSearchParams edits the query of the URL it shares in place.
+//
 // TODO(perf): Pre-processing input, cloning, stringifying, and parsing the cloned URL is an awfully
 //   heavyweight operation when all we want to do is validly replace a URL component. A couple
 //   attributes, pathname and search, are able to take advantage of the kj::Url parser's context
@@ -236,15 +272,10 @@ kj::String URL::getUsername() {
   return {};
 }
 void URL::setUsername(kj::String value) {
-  auto copy = url->clone();
-  KJ_IF_MAYBE(ui, copy.userInfo) {
+  KJ_IF_MAYBE(ui, url->userInfo) {
     ui->username = kj::mv(value);
   } else {
-    copy.userInfo = kj::Url::UserInfo{.username = kj::mv(value)};
-  }
-
-  KJ_IF_MAYBE(u, kj::Url::tryParse(kjUrlToString(copy))) {
-    url->kj::Url::operator=(kj::mv(*u));
+    url->userInfo = kj::Url::UserInfo{.username = kj::mv(value)};
   }
 }
 
@@ -257,8 +288,7 @@ kj::String URL::getPassword() {
   return {};
 }
 void URL::setPassword(kj::String value) {
-  auto copy = url->clone();
-  KJ_IF_MAYBE(ui, copy.userInfo) {
+  KJ_IF_MAYBE(ui, url->userInfo) {
     // We already have userInfo. Set the password if we were given a non-empty string, otherwise
     // reset the password Maybe.
     if (value.size() > 0) {
@@ -267,11 +297,7 @@ void URL::setPassword(kj::String value) {
       ui->password = nullptr;
     }
   } else if (value.size() > 0) {
-    copy.userInfo = kj::Url::UserInfo{.password = kj::mv(value)};
-  }
-
-  KJ_IF_MAYBE(u, kj::Url::tryParse(kjUrlToString(copy))) {
-    url->kj::Url::operator=(kj::mv(*u));
+    url->userInfo = kj::Url::UserInfo{.password = kj::mv(value)};
   }
 }
 
@@ -17,7 +17,11 @@ class URL: public jsg::Object {
   // Implements the URL interface as prescribed by: https://url.spec.whatwg.org/#api
 
 public:
-  static jsg::Ref<URL> constructor(kj::String url, jsg::Optional<kj::String> base);
+  using Input = kj::OneOf<jsg::Ref<URL>, kj::String>;
+  // Anything else gets coerced to a string, as the spec requires. URLs are accepted directly so
+  // that we can copy their parsed form instead of stringifying and re-parsing them.
+
+  static jsg::Ref<URL> constructor(Input url, jsg::Optional<Input> base);
 
   kj::String getHref();
   void setHref(const v8::PropertyCallbackInfo<void>& info, kj::String value);
@@ -0,0 +1,48 @@
+function assertEqual(a, b) {
+  if (a !== b) {
+    throw new Error(a + " !== " + b);
+  }
+}
+
+export default {
+  async test(ctrl, env, ctx) {
+    // Literal and trailing-wildcard components are matched without a regex.
+    const literal = new URLPattern({ pathname: "/foo/bar" });
+    assertEqual(literal.test("https://example.com/foo/bar"), true);
+    assertEqual(literal.test("https://example.com/foo/barn"), false);
+    assertEqual(literal.test("https://example.com/foo"), false);
+
+    const prefixed = new URLPattern({ hostname: "example.com", pathname: "/static/*" });
+    const result = prefixed.exec("https://example.com/static/js/app.js?v=1");
+    assertEqual(result.pathname.input, "/static/js/app.js");
+    assertEqual(result.pathname.groups["0"], "js/app.js");
+    assertEqual(result.protocol.groups["0"], "https");
+    assertEqual(result.search.groups["0"], "v=1");
+    assertEqual(prefixed.test("https://example.com/static"), false);
+    assertEqual(prefixed.test("https://example.org/static/x"), false);
+
+    const named = new URLPattern({ pathname: "/files/:rest(.*)" });
+    assertEqual(named.exec({ pathname: "/files/a/b" }).pathname.groups.rest, "a/b");
+
+    // Inputs are canonicalized before matching, which strips newlines, so the wildcard still
+    // matches.
+    const hashResult = new URLPattern({ hash: "*" }).exec({ hash: "a\nb" });
+    assertEqual(hashResult.hash.input, "ab");
+    assertEqual(hashResult.hash.groups["0"], "ab");
+
+    // Patterns with other kinds of groups still go through the regex, which is shared between
+    // identical patterns.
+    for (let i = 0; i < 3; i++) {
+      const p = new URLPattern({ pathname: "/users/:id/posts/:post?" });
+      assertEqual(p.exec({ pathname: "/users/42/posts" }).pathname.groups.id, "42");
+      assertEqual(p.exec({ pathname: "/users/42/posts/7" }).pathname.groups.post, "7");
+      assertEqual(p.test({ pathname: "/users/42/comments" }), false);
+    }
+
+    // A literal protocol component still has special-scheme pathname handling applied.
+    const special = new URLPattern({ protocol: "https", pathname: "/a/../b" });
+    assertEqual(special.pathname, "/b");
+    assertEqual(special.test("https://example.com/b"), true);
+    assertEqual(special.test("http://example.com/b"), false);
+  }
+};
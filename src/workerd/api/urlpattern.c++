@@ -379,6 +379,32 @@ Part::Modifier maybeTokenToModifier(kj::Maybe<Token&> modifierToken) {
   V(ftp)   \
   V(file)  \
 
+inline bool isRegexLineTerminator(uint32_t codepoint) {
+  return codepoint == '\n' || codepoint == '\r' || codepoint == 0x2028 || codepoint == 0x2029;
+}
+
+kj::Maybe<jsg::UsvStringPtr> execSimpleMatch(
+    const URLPatternComponent::SimpleMatch& simpleMatch,
+    jsg::UsvStringPtr input) {
+  // Matches `input` against a component that has a SimpleMatch, exactly as its regex would,
+  // returning the part of the input captured by the wildcard (empty if there is none), or null if
+  // the input does not match.
+  auto prefixSize = simpleMatch.prefix.size();
+  if (input.size() < prefixSize || input.slice(0, prefixSize) != simpleMatch.prefix.asPtr()) {
+    return nullptr;
+  }
+  auto rest = input.slice(prefixSize);
+  if (!simpleMatch.wildcard) {
+    if (rest.size() != 0) return nullptr;
+  } else {
+    // The wildcard is `.*`, and `.` does not match line terminators.
+    for (auto c: rest) {
+      if (isRegexLineTerminator(c)) return nullptr;
+    }
+  }
+  return rest;
+}
+
 // This function is a bit unfortunate. It is required by the specification. What is it doing
 // is checking to see if the compiled regular expression for a protocol component matches
 // any of the special protocol schemes. To do so, it has to execute the regular expression
@@ -386,6 +412,13 @@ Part::Modifier maybeTokenToModifier(kj::Maybe<Token&> modifierToken) {
 // ordered to make it so the *most likely* matches will be checked first.
 // TODO (later): Investigate whether there is a more efficient way to handle this.
 bool protocolComponentMatchesSpecialScheme(jsg::Lock& js, URLPatternComponent& component) {
+  KJ_IF_MAYBE(simpleMatch, component.simpleMatch) {
+#define V(name) if (execSimpleMatch(*simpleMatch, jsg::usv(#name)) != nullptr) return true;
+    SPECIAL_SCHEME(V)
+#undef V
+    return false;
+  }
+
   auto handle = component.regex.getHandle(js);
   auto context = js.v8Context();
 
@@ -1031,6 +1064,45 @@ kj::Array<Part> parsePatternString(
   return partList.releaseAsArray();
 }
 
+constexpr uint32_t MAX_CACHED_REGEXES = 1024;
+
+v8::Local<v8::RegExp> getOrCompileRegex(jsg::Lock& js, jsg::UsvString source) {
+  // Routers commonly construct the same URLPatterns over and over -- per request, or in every
+  // module that imports a shared route table -- so the compiled regular expressions are cached
+  // once per isolate in a Map held in a private field on the global scope (as with the default
+  // botManagement value in global-scope.c++). The generated source already encodes the
+  // component's options and every regex uses the same flags, so the source alone is the key.
+  // Sharing a RegExp between patterns is safe: it is never exposed to JavaScript, and since it is
+  // not global or sticky, Exec() leaves its lastIndex alone. The cache is simply cleared once it
+  // fills up.
+  auto isolate = js.v8Isolate;
+  auto context = js.v8Context();
+  auto global = context->Global();
+  auto sym = v8::Private::ForApi(isolate, jsg::v8StrIntern(isolate, "urlPatternRegexCache"_kj));
+
+  v8::Local<v8::Map> cache;
+  auto cacheValue = jsg::check(global->GetPrivate(context, sym));
+  if (cacheValue->IsMap()) {
+    cache = cacheValue.As<v8::Map>();
+  } else {
+    cache = v8::Map::New(isolate);
+    jsg::check(global->SetPrivate(context, sym, cache));
+  }
+
+  auto key = jsg::v8Str(isolate, source);
+  auto cached = jsg::check(cache->Get(context, key));
+  if (cached->IsRegExp()) {
+    return cached.As<v8::RegExp>();
+  }
+
+  auto regex = jsg::check(v8::RegExp::New(context, key, v8::RegExp::Flags::kUnicode));
+  if (cache->Size() >= MAX_CACHED_REGEXES) {
+    cache->Clear();
+  }
+  jsg::check(cache->Set(context, key, regex));
+  return regex;
+}
+
 RegexAndNameList generateRegularExpressionAndNameList(
     jsg::Lock& js,
     kj::ArrayPtr<Part> partList,
@@ -1125,11 +1197,8 @@ RegexAndNameList generateRegularExpressionAndNameList(
   // regular expression syntax is invalid as opposed to the default SyntaxError
   // that V8 throws.
   return js.tryCatch([&]() {
-    auto context = js.v8Context();
     return RegexAndNameList {
-      js.v8Ref(jsg::check(v8::RegExp::New(context,
-                        v8Str(js.v8Isolate, result.finish()),
-                        v8::RegExp::Flags::kUnicode)).As<v8::RegExp>()),
+      js.v8Ref(getOrCompileRegex(js, result.finish())),
       nameList.releaseAsArray(),
     };
   }, [&](jsg::Value reason) -> RegexAndNameList {
@@ -1255,6 +1324,32 @@ jsg::UsvString generatePatternString(kj::ArrayPtr<Part> partList, const CompileO
   return result.finish();
 }
 
+kj::Maybe<URLPatternComponent::SimpleMatch> generateSimpleMatch(kj::ArrayPtr<Part> partList) {
+  // Recognizes the part lists that URLPatternComponent::SimpleMatch can represent: any number of
+  // unmodified fixed text parts, optionally followed by one unmodified full wildcard with no
+  // suffix. These cover the default "*" of every unspecified component as well as typical
+  // literal and "/prefix/*" routes.
+  jsg::UsvStringBuilder prefix;
+  bool wildcard = false;
+  for (auto& part : partList) {
+    if (wildcard || part.modifier != Part::Modifier::NONE) {
+      return nullptr;
+    }
+    if (part.type == Part::Type::FIXED_TEXT) {
+      prefix.addAll(part.value);
+    } else if (part.type == Part::Type::FULL_WILDCARD && part.suffix.size() == 0) {
+      prefix.addAll(part.prefix);
+      wildcard = true;
+    } else {
+      return nullptr;
+    }
+  }
+  return URLPatternComponent::SimpleMatch {
+    .prefix = prefix.finish(),
+    .wildcard = wildcard,
+  };
+}
+
 URLPatternComponent compileComponent(
     jsg::Lock& js,
     kj::Maybe<jsg::UsvStringPtr> input,
@@ -1270,6 +1365,7 @@ URLPatternComponent compileComponent(
     .pattern = generatePatternString(partList, options),
     .regex = kj::mv(regexAndNameList.first),
     .nameList = kj::mv(regexAndNameList.second),
+    .simpleMatch = generateSimpleMatch(partList),
   };
 }
 
@@ -1835,6 +1931,23 @@ kj::Maybe<URLPattern::URLPatternComponentResult> execRegex(
     jsg::UsvStringPtr input) {
   using Groups = jsg::Dict<jsg::UsvString, jsg::UsvString>;
 
+  KJ_IF_MAYBE(simpleMatch, component.simpleMatch) {
+    KJ_IF_MAYBE(rest, execSimpleMatch(*simpleMatch, input)) {
+      kj::Vector<Groups::Field> fields(1);
+      if (simpleMatch->wildcard) {
+        fields.add(Groups::Field {
+          .name = jsg::usv(component.nameList[0]),
+          .value = jsg::usv(*rest),
+        });
+      }
+      return URLPattern::URLPatternComponentResult {
+        .input = jsg::usv(input),
+        .groups = Groups { .fields = fields.releaseAsArray() },
+      };
+    }
+    return nullptr;
+  }
+
   auto context = js.v8Context();
 
   auto execResult =
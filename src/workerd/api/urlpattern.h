@@ -14,6 +14,20 @@ struct URLPatternComponent {
   jsg::UsvString pattern;
   jsg::V8Ref<v8::RegExp> regex;
   kj::Array<jsg::UsvString> nameList;
+
+  struct SimpleMatch {
+    // A component consisting only of fixed text, optionally followed by a single full wildcard
+    // (`*`, or a named group matching `(.*)`), can be matched without running `regex` at all.
+
+    jsg::UsvString prefix;
+    // Text the input must begin with, or, without the wildcard, be equal to. Includes the
+    // wildcard's own prefix, if any (e.g. the trailing "/" of "/foo/*").
+
+    bool wildcard;
+    // If true, whatever follows `prefix` is captured as the group named by `nameList[0]`.
+  };
+  kj::Maybe<SimpleMatch> simpleMatch;
+  // Set when the component's pattern allows it.
 };
 
 struct URLPatternComponents {
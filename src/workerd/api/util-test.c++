@@ -217,5 +217,44 @@ KJ_TEST("readContentTypeParameter can fetch boundary parameter") {
 
 }
 
+KJ_TEST("selectWebSocketCompression") {
+  auto expectSelected = [](kj::StringPtr offers, kj::StringPtr expected) {
+    auto selected = KJ_ASSERT_NONNULL(selectWebSocketCompression(offers), offers);
+    KJ_EXPECT(selected == expected, offers, selected, expected);
+  };
+
+  expectSelected("permessage-deflate"_kj, "permessage-deflate"_kj);
+  // What browsers send. The client_* parameters don't need confirming.
+  expectSelected("permessage-deflate; client_max_window_bits"_kj, "permessage-deflate"_kj);
+  expectSelected("permessage-deflate;client_no_context_takeover;client_max_window_bits=10"_kj,
+      "permessage-deflate"_kj);
+
+  // server_* parameters are echoed to agree to them.
+  expectSelected("permessage-deflate; server_no_context_takeover; server_max_window_bits=10"_kj,
+      "permessage-deflate; server_no_context_takeover; server_max_window_bits=10"_kj);
+  expectSelected("permessage-deflate; server_max_window_bits=\"12\""_kj,
+      "permessage-deflate; server_max_window_bits=12"_kj);
+
+  // The first acceptable offer wins.
+  expectSelected("x-webkit-deflate-frame, permessage-deflate; server_max_window_bits=8, "
+      "permessage-deflate; server_max_window_bits=9, permessage-deflate"_kj,
+      "permessage-deflate; server_max_window_bits=9"_kj);
+  expectSelected("permessage-deflate; foo, permessage-deflate"_kj, "permessage-deflate"_kj);
+
+  // Malformed or unsupported offers are declined.
+  KJ_EXPECT(selectWebSocketCompression(""_kj) == nullptr);
+  KJ_EXPECT(selectWebSocketCompression("x-webkit-deflate-frame"_kj) == nullptr);
+  KJ_EXPECT(selectWebSocketCompression("permessage-deflate; unknown"_kj) == nullptr);
+  KJ_EXPECT(selectWebSocketCompression("permessage-deflate; server_max_window_bits"_kj) == nullptr);
+  KJ_EXPECT(selectWebSocketCompression(
+      "permessage-deflate; server_max_window_bits=16"_kj) == nullptr);
+  KJ_EXPECT(selectWebSocketCompression(
+      "permessage-deflate; client_max_window_bits=7"_kj) == nullptr);
+  KJ_EXPECT(selectWebSocketCompression(
+      "permessage-deflate; server_no_context_takeover=1"_kj) == nullptr);
+  KJ_EXPECT(selectWebSocketCompression(
+      "permessage-deflate; client_no_context_takeover; client_no_context_takeover"_kj) == nullptr);
+}
+
 }  // namespace
 }  // namespace workerd::api
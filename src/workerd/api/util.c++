@@ -148,6 +148,113 @@ kj::Maybe<kj::ArrayPtr<const char>> readContentTypeParameter(kj::StringPtr conte
   return nullptr;
 }
 
+namespace {
+
+kj::ArrayPtr<const char> trimWhitespace(kj::ArrayPtr<const char> str) {
+  while (str.size() > 0 && (str.front() == ' ' || str.front() == '\t')) str = str.slice(1);
+  while (str.size() > 0 && (str.back() == ' ' || str.back() == '\t')) {
+    str = str.slice(0, str.size() - 1);
+  }
+  return str;
+}
+
+kj::Vector<kj::ArrayPtr<const char>> splitTrimmed(kj::ArrayPtr<const char> input, char delim) {
+  kj::Vector<kj::ArrayPtr<const char>> parts;
+  size_t start = 0;
+  for (auto i: kj::indices(input)) {
+    if (input[i] == delim) {
+      parts.add(trimWhitespace(input.slice(start, i)));
+      start = i + 1;
+    }
+  }
+  parts.add(trimWhitespace(input.slice(start, input.size())));
+  return parts;
+}
+
+kj::Maybe<uint> parseWindowBits(kj::ArrayPtr<const char> value) {
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.slice(1, value.size() - 1);
+  }
+  if (value.size() == 0 || value.size() > 2) return nullptr;
+  uint bits = 0;
+  for (char c: value) {
+    if (c < '0' || c > '9') return nullptr;
+    bits = bits * 10 + (c - '0');
+  }
+  // RFC 7692 allows 8 through 15.
+  if (bits < 8 || bits > 15) return nullptr;
+  return bits;
+}
+
+}  // namespace
+
+kj::Maybe<kj::String> selectWebSocketCompression(kj::StringPtr offers) {
+  for (auto offer: splitTrimmed(offers, ',')) {
+    auto params = splitTrimmed(offer, ';');
+    if (params[0] != "permessage-deflate"_kj.asArray()) continue;
+
+    bool valid = true;
+    bool serverNoContextTakeover = false;
+    bool clientNoContextTakeover = false;
+    bool clientMaxWindowBits = false;
+    kj::Maybe<uint> serverMaxWindowBits;
+
+    for (auto param: params.asPtr().slice(1, params.size())) {
+      kj::ArrayPtr<const char> name = param;
+      kj::Maybe<kj::ArrayPtr<const char>> value;
+      for (auto i: kj::indices(param)) {
+        if (param[i] == '=') {
+          name = trimWhitespace(param.slice(0, i));
+          value = trimWhitespace(param.slice(i + 1, param.size()));
+          break;
+        }
+      }
+
+      // Each parameter may appear at most once, and only the window sizes take a value.
+      if (name == "server_no_context_takeover"_kj.asArray()) {
+        valid = value == nullptr && !serverNoContextTakeover;
+        serverNoContextTakeover = true;
+      } else if (name == "client_no_context_takeover"_kj.asArray()) {
+        valid = value == nullptr && !clientNoContextTakeover;
+        clientNoContextTakeover = true;
+      } else if (name == "server_max_window_bits"_kj.asArray()) {
+        valid = serverMaxWindowBits == nullptr;
+        KJ_IF_MAYBE(v, value) {
+          serverMaxWindowBits = parseWindowBits(*v);
+        }
+        valid = valid && serverMaxWindowBits != nullptr;
+      } else if (name == "client_max_window_bits"_kj.asArray()) {
+        valid = !clientMaxWindowBits;
+        KJ_IF_MAYBE(v, value) {
+          valid = valid && parseWindowBits(*v) != nullptr;
+        }
+        clientMaxWindowBits = true;
+      } else {
+        valid = false;
+      }
+      if (!valid) break;
+    }
+    if (!valid) continue;
+
+    // The client_* parameters only constrain the client, and our inflater accepts any window
+    // size, so there's nothing to confirm for them. The server_* parameters must be echoed to
+    // agree to them.
+    kj::Vector<kj::String> response;
+    response.add(kj::str("permessage-deflate"));
+    if (serverNoContextTakeover) {
+      response.add(kj::str("server_no_context_takeover"));
+    }
+    KJ_IF_MAYBE(bits, serverMaxWindowBits) {
+      // zlib can't produce raw deflate streams with a 256-byte window, so decline the offer.
+      if (*bits < 9) continue;
+      response.add(kj::str("server_max_window_bits=", *bits));
+    }
+    return kj::str(kj::delimited(response, "; "_kj));
+  }
+
+  return nullptr;
+}
+
 kj::Maybe<kj::Exception> translateKjException(const kj::Exception& exception,
     std::initializer_list<ErrorTranslation> translations) {
   for (auto& t: translations) {
@@ -162,17 +269,19 @@ kj::Maybe<kj::Exception> translateKjException(const kj::Exception& exception,
 
 namespace {
 
+constexpr kj::StringPtr TEE_BUFFER_LIMIT_MESSAGE =
+    "ReadableStream.tee() buffer limit exceeded. This error usually occurs when a Request or "
+    "Response with a large body is cloned, then only one of the clones is read, forcing "
+    "the Workers runtime to buffer the entire body in memory. To fix this issue, remove "
+    "unnecessary calls to Request/Response.clone() and ReadableStream.tee(), and always read "
+    "clones/tees in parallel."_kj;
+
 template <typename Func>
 auto translateTeeErrors(Func&& f) -> decltype(kj::fwd<Func>(f)()) {
   return kj::evalNow(kj::fwd<Func>(f))
       .catch_([](kj::Exception&& exception) -> decltype(kj::fwd<Func>(f)()) {
     KJ_IF_MAYBE(e, translateKjException(exception, {
-      { "tee buffer size limit exceeded"_kj,
-        "ReadableStream.tee() buffer limit exceeded. This error usually occurs when a Request or "
-        "Response with a large body is cloned, then only one of the clones is read, forcing "
-        "the Workers runtime to buffer the entire body in memory. To fix this issue, remove "
-        "unnecessary calls to Request/Response.clone() and ReadableStream.tee(), and always read "
-        "clones/tees in parallel."_kj },
+      { "tee buffer size limit exceeded"_kj, TEE_BUFFER_LIMIT_MESSAGE },
     })) {
       return kj::mv(*e);
     }
@@ -218,6 +327,11 @@ kj::Own<kj::AsyncInputStream> newTeeErrorAdapter(kj::Own<kj::AsyncInputStream> i
   }
 }
 
+kj::Exception teeBufferLimitExceeded() {
+  return kj::Exception(kj::Exception::Type::FAILED, __FILE__, __LINE__,
+      kj::str(JSG_EXCEPTION(TypeError) ": ", TEE_BUFFER_LIMIT_MESSAGE));
+}
+
 kj::String redactUrl(kj::StringPtr url) {
   kj::Vector<char> redacted(url.size() + 1);
   const char* spanStart = url.begin();
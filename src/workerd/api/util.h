@@ -65,6 +65,16 @@ kj::Maybe<kj::ArrayPtr<const char>> readContentTypeParameter(kj::StringPtr conte
 //
 // TODO(cleanup): Replace this function with a full kj::MimeType parser.
 
+kj::Maybe<kj::String> selectWebSocketCompression(kj::StringPtr offers);
+// Given the Sec-WebSocket-Extensions header of a WebSocket upgrade request, picks the first
+// permessage-deflate offer (RFC 7692) that we can honor and returns the response header value
+// accepting it, or null if compression shouldn't be used.
+//
+// This is for when the Worker accepts the upgrade itself (e.g. with a WebSocketPair), so there's
+// no kj::WebSocket implementation to ask for its preferred extensions. Offers can't be echoed
+// back as-is, since a request may list several alternatives and may contain parameters that are
+// invalid in a response.
+
 // =======================================================================================
 
 struct ErrorTranslation {
@@ -90,6 +100,10 @@ kj::Own<kj::AsyncInputStream> newTeeErrorAdapter(kj::Own<kj::AsyncInputStream> i
 // Wrap the given stream in an adapter which translates kj::newTee()-specific exceptions into
 // JS-visible exceptions.
 
+kj::Exception teeBufferLimitExceeded();
+// The JS-visible exception reported when a tee branch falls so far behind that the other branch
+// would have to buffer more than the limit.
+
 kj::String redactUrl(kj::StringPtr url);
 // Redacts potential secret keys from a given URL using a couple heuristics:
 //   - Any run of hex characters of 32 or more digits, ignoring potential "+-_" separators
@@ -12,6 +12,42 @@
 
 namespace workerd::api {
 
+kj::WebSocket::Message SharedWebSocketMessage::borrow() {
+  KJ_SWITCH_ONEOF(content) {
+    KJ_CASE_ONEOF(text, kj::String) {
+      return kj::String(text.begin(), text.size(), kj::NullArrayDisposer::instance);
+    }
+    KJ_CASE_ONEOF(data, kj::Array<byte>) {
+      return kj::Array<byte>(data.begin(), data.size(), kj::NullArrayDisposer::instance);
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
+kj::Promise<void> SharedWebSocketMessage::sendTo(kj::WebSocket& ws) {
+  KJ_SWITCH_ONEOF(content) {
+    KJ_CASE_ONEOF(text, kj::String) {
+      return ws.send(text);
+    }
+    KJ_CASE_ONEOF(data, kj::Array<byte>) {
+      return ws.send(data);
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
+size_t SharedWebSocketMessage::size() const {
+  KJ_SWITCH_ONEOF(content) {
+    KJ_CASE_ONEOF(text, kj::String) {
+      return text.size();
+    }
+    KJ_CASE_ONEOF(data, kj::Array<byte>) {
+      return data.size();
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
 kj::StringPtr KJ_STRINGIFY(const WebSocket::NativeState& state) {
   // TODO(someday) We might care more about this `OneOf` than its which, that probably means
   // returning a kj::String instead.
@@ -233,8 +269,11 @@ jsg::Ref<WebSocket> WebSocket::constructor(
   auto connUrl = urlRecord.toString();
   auto ws = jsg::alloc<WebSocket>(kj::mv(url), Locality::REMOTE);
 
-  headers.set(kj::HttpHeaderId::SEC_WEBSOCKET_EXTENSIONS, kj::str("permessage-deflate"));
-  // By default, browsers set the compression extension header for `new WebSocket()`.
+  headers.set(kj::HttpHeaderId::SEC_WEBSOCKET_EXTENSIONS,
+      kj::str("permessage-deflate; client_max_window_bits"));
+  // By default, browsers set the compression extension header for `new WebSocket()`. Like them, we
+  // also let the server pick the window size we compress with, so that it can bound its memory use
+  // per connection rather than refuse compression outright.
 
   if (!FeatureFlags::get(js).getWebSocketCompression()) {
     // If we haven't enabled the websocket compression compatibility flag, strip the header from the
@@ -487,7 +526,7 @@ void WebSocket::startReadLoop(jsg::Lock& js) {
   })));
 }
 
-void WebSocket::send(jsg::Lock& js, kj::OneOf<kj::Array<byte>, kj::String> message) {
+bool WebSocket::readyToSend(jsg::Lock& js) {
   auto& native = *farNative;
   JSG_REQUIRE(!native.closedOutgoing, TypeError, "Can't call WebSocket send() after close().");
   if (native.outgoingAborted || native.state.is<Released>()) {
@@ -500,26 +539,31 @@ void WebSocket::send(jsg::Lock& js, kj::OneOf<kj::Array<byte>, kj::String> messa
     // * It makes no sense that *receiving* a close message should prevent further calls to send().
     //   The spec seems broken here. What if you need to send a couple final messages for a clean
     //   shutdown?
-    return;
+    return false;
   } else if (awaitingHibernatableError()) {
     // Ready for the hibernatable error event state, after encountering an error, the websocket
     // isn't able to send outbound messages; let's release it.
     tryReleaseNative(js);
-    return;
+    return false;
   }
 
   JSG_REQUIRE(native.state.is<Accepted>(), TypeError,
       "You must call one of accept() or state.acceptWebSocket() on this WebSocket before sending "\
       "messages.");
+  return true;
+}
 
-  auto maybeOutputLock = IoContext::current().waitForOutputLocksIfNecessary();
+void WebSocket::enqueueMessage(kj::Maybe<kj::Promise<void>> maybeOutputLock,
+                               kj::OneOf<kj::Array<byte>, kj::String> message) {
   auto msg = [&]() -> kj::WebSocket::Message {
     KJ_SWITCH_ONEOF(message) {
       KJ_CASE_ONEOF(text, kj::String) {
+        farNative->bufferedAmount += text.size();
         return kj::mv(text);
         break;
       }
       KJ_CASE_ONEOF(data, kj::Array<byte>) {
+        farNative->bufferedAmount += data.size();
         return kj::mv(data);
         break;
       }
@@ -528,10 +572,51 @@ void WebSocket::send(jsg::Lock& js, kj::OneOf<kj::Array<byte>, kj::String> messa
     KJ_UNREACHABLE;
   }();
   outgoingMessages->insert(GatedMessage{kj::mv(maybeOutputLock), kj::mv(msg)});
+}
 
+void WebSocket::send(jsg::Lock& js, kj::OneOf<kj::Array<byte>, kj::String> message) {
+  if (!readyToSend(js)) return;
+
+  enqueueMessage(IoContext::current().waitForOutputLocksIfNecessary(), kj::mv(message));
+  ensurePumping(js);
+}
+
+void WebSocket::sendBatch(
+    jsg::Lock& js, kj::Array<kj::OneOf<kj::Array<byte>, kj::String>> messages) {
+  if (!readyToSend(js) || messages.size() == 0) return;
+
+  // The pump sends messages in order, so only the first one needs to wait on the output gate.
+  auto maybeOutputLock = IoContext::current().waitForOutputLocksIfNecessary();
+  for (auto& message: messages) {
+    enqueueMessage(kj::mv(maybeOutputLock), kj::mv(message));
+    maybeOutputLock = nullptr;
+  }
   ensurePumping(js);
 }
 
+void WebSocket::sendAfter(kj::Promise<void> previousSends) {
+  auto& native = *farNative;
+  KJ_REQUIRE(native.previousSends == nullptr && !native.isPumping);
+  native.previousSends = kj::mv(previousSends);
+}
+
+bool WebSocket::trySendShared(jsg::Lock& js, SharedWebSocketMessage& message,
+                              kj::Maybe<kj::Promise<void>> outputLock) {
+  auto& native = *farNative;
+  if (native.closedOutgoing || native.outgoingAborted || !native.state.is<Accepted>()) {
+    return false;
+  } else if (awaitingHibernatableError()) {
+    tryReleaseNative(js);
+    return false;
+  }
+
+  native.bufferedAmount += message.size();
+  outgoingMessages->insert(GatedMessage{
+    kj::mv(outputLock), message.borrow(), kj::addRef(message)});
+  ensurePumping(js);
+  return true;
+}
+
 void WebSocket::close(
     jsg::Lock& js, jsg::Optional<int> code, jsg::Optional<kj::String> reason) {
   auto& native = *farNative;
@@ -601,6 +686,10 @@ int WebSocket::getReadyState() {
   return READY_STATE_OPEN;
 }
 
+double WebSocket::getBufferedAmount() {
+  return farNative->bufferedAmount;
+}
+
 bool WebSocket::isAccepted() {
   return farNative->state.is<Accepted>();
 }
@@ -765,6 +854,12 @@ kj::Promise<void> WebSocket::pump(
     outgoingMessages.clear();
   });
 
+  KJ_IF_MAYBE(sends, native.previousSends) {
+    auto promise = kj::mv(*sends);
+    native.previousSends = nullptr;
+    co_await promise;
+  }
+
   while (outgoingMessages.size() > 0) {
     GatedMessage gatedMessage = outgoingMessages.release(*outgoingMessages.ordered().begin());
     KJ_IF_MAYBE(promise, gatedMessage.outputLock) {
@@ -776,10 +871,12 @@ kj::Promise<void> WebSocket::pump(
     KJ_SWITCH_ONEOF(gatedMessage.message) {
       KJ_CASE_ONEOF(text, kj::String) {
         co_await ws.send(text);
+        native.bufferedAmount -= text.size();
         break;
       }
       KJ_CASE_ONEOF(data, kj::Array<byte>) {
         co_await ws.send(data);
+        native.bufferedAmount -= data.size();
         break;
       }
       KJ_CASE_ONEOF(close, kj::WebSocket::Close) {
@@ -18,6 +18,27 @@ namespace workerd::api {
 
 template <typename T> struct DeferredProxy;
 
+class SharedWebSocketMessage final: public kj::Refcounted {
+  // A message payload that is sent to many WebSockets at once (see DurableObjectState::broadcast())
+  // without copying it for each of them.
+
+public:
+  explicit SharedWebSocketMessage(kj::OneOf<kj::Array<byte>, kj::String> content)
+      : content(kj::mv(content)) {}
+
+  kj::WebSocket::Message borrow();
+  // Returns a message that refers to the shared payload rather than owning a copy. The caller
+  // must keep this object alive for as long as the message is in use.
+
+  kj::Promise<void> sendTo(kj::WebSocket& ws);
+  // Writes the payload to `ws`. The caller must keep this object alive until the promise resolves.
+
+  size_t size() const;
+
+private:
+  kj::OneOf<kj::Array<byte>, kj::String> content;
+};
+
 class MessageEvent: public Event {
 public:
   MessageEvent(v8::Isolate* isolate, v8::Local<v8::Value> data)
@@ -240,6 +261,17 @@ public:
   // Similar to how the JS `constructor()` creates a WebSocket, when waking from hibernation
   // we want to be able to recreate WebSockets from C++ that will be delivered to JS code.
 
+  void sendAfter(kj::Promise<void> previousSends);
+  // Makes the outgoing pump wait for `previousSends` before sending anything. Used when waking
+  // from hibernation, since messages may have been broadcast directly on the kj::WebSocket while
+  // there was no api::WebSocket to queue them.
+
+  bool trySendShared(jsg::Lock& js, SharedWebSocketMessage& message,
+                     kj::Maybe<kj::Promise<void>> outputLock);
+  // Queues a shared message on behalf of DurableObjectState::broadcast(). Unlike send(), this
+  // doesn't throw if the WebSocket can't send right now (e.g. because close() was called); it
+  // just returns false.
+
   WebSocket(kj::Own<kj::WebSocket> native, Locality locality);
   WebSocket(kj::String url, Locality locality);
   // The JS WebSocket constructor needs to initiate a connection, but we need to return the
@@ -378,6 +410,9 @@ public:
   // share code.
 
   void send(jsg::Lock& js, kj::OneOf<kj::Array<byte>, kj::String> message);
+  void sendBatch(jsg::Lock& js, kj::Array<kj::OneOf<kj::Array<byte>, kj::String>> messages);
+  // Non-standard: queues several messages, as if by calling send() on each in turn, but with a
+  // single trip through the output gate for the whole batch.
   void close(jsg::Lock& js, jsg::Optional<int> code, jsg::Optional<kj::String> reason);
 
   void serializeAttachment(jsg::Lock& js, v8::Local<v8::Value> attachment);
@@ -392,6 +427,11 @@ public:
 
   int getReadyState();
 
+  double getBufferedAmount();
+  // Payload bytes passed to send() that haven't been handed to the underlying connection yet.
+  // Like in browsers, this doesn't drop back to zero for messages that are discarded because the
+  // connection closed.
+
   bool isAccepted();
   bool isReleased();
 
@@ -409,6 +449,9 @@ public:
     JSG_METHOD(accept);
     JSG_METHOD(send);
     JSG_METHOD(close);
+    if (flags.getWorkerdExperimental()) {
+      JSG_METHOD(sendBatch);
+    }
     JSG_METHOD(serializeAttachment);
     JSG_METHOD(deserializeAttachment);
 
@@ -423,11 +466,13 @@ public:
     // prototype.
     if (flags.getJsgPropertyOnPrototypeTemplate()) {
       JSG_READONLY_PROTOTYPE_PROPERTY(readyState, getReadyState);
+      JSG_READONLY_PROTOTYPE_PROPERTY(bufferedAmount, getBufferedAmount);
       JSG_READONLY_PROTOTYPE_PROPERTY(url, getUrl);
       JSG_READONLY_PROTOTYPE_PROPERTY(protocol, getProtocol);
       JSG_READONLY_PROTOTYPE_PROPERTY(extensions, getExtensions);
     } else {
       JSG_READONLY_INSTANCE_PROPERTY(readyState, getReadyState);
+      JSG_READONLY_INSTANCE_PROPERTY(bufferedAmount, getBufferedAmount);
       JSG_READONLY_INSTANCE_PROPERTY(url, getUrl);
       JSG_READONLY_INSTANCE_PROPERTY(protocol, getProtocol);
       JSG_READONLY_INSTANCE_PROPERTY(extensions, getExtensions);
@@ -602,6 +647,12 @@ private:
     bool outgoingAborted = false;
     // Have we detected that the peer has stopped accepting messages? We may want to clean up more
     // proactively in this case.
+
+    size_t bufferedAmount = 0;
+    // Payload bytes of the data messages queued in `outgoingMessages`, plus the one being sent.
+
+    kj::Maybe<kj::Promise<void>> previousSends;
+    // See sendAfter().
   };
   IoOwn<Native> farNative;
   // The underlying native WebSocket (or a promise that will emplace one).
@@ -624,6 +675,8 @@ private:
   struct GatedMessage {
     kj::Maybe<kj::Promise<void>> outputLock;  // must wait for this before actually sending
     kj::WebSocket::Message message;
+    kj::Maybe<kj::Own<SharedWebSocketMessage>> sharedPayload;
+    // Keeps the payload alive if `message` borrows it from a broadcast.
   };
   using OutgoingMessagesMap = kj::Table<GatedMessage, kj::InsertionOrderIndex>;
   IoOwn<OutgoingMessagesMap> outgoingMessages;
@@ -649,6 +702,12 @@ private:
 
   void dispatchOpen(jsg::Lock& js);
 
+  bool readyToSend(jsg::Lock& js);
+  // Checks that send() may be called now. Returns false if the message should be silently dropped.
+
+  void enqueueMessage(kj::Maybe<kj::Promise<void>> outputLock,
+                      kj::OneOf<kj::Array<byte>, kj::String> message);
+
   void ensurePumping(jsg::Lock& js);
 
   static kj::Promise<void> pump(
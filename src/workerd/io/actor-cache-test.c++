@@ -197,6 +197,10 @@ struct ActorCacheTestOptions {
   size_t maxKeysPerRpc = 128;
   bool noCache = false;
   bool neverFlush = false;
+  bool pipelineFlushes = false;
+  size_t maxFlushBatchesInFlight = 16;
+  size_t maxFlushBytesInFlight = 32 * (1ull << 20);
+  ActorCache::Hooks& hooks = ActorCache::Hooks::DEFAULT;
 };
 
 struct ActorCacheTest: public ActorCacheConvenienceWrappers {
@@ -221,8 +225,9 @@ struct ActorCacheTest: public ActorCacheConvenienceWrappers {
         ws(loop), mockStorage(kj::mv(mockPair.mock)),
         lru({options.softLimit, options.hardLimit,
              options.staleTimeout, options.dirtyListByteLimit, options.maxKeysPerRpc,
-             options.noCache, options.neverFlush}),
-        cache(kj::mv(mockPair.client), lru, gate),
+             options.noCache, options.neverFlush, options.pipelineFlushes,
+             options.maxFlushBatchesInFlight, options.maxFlushBytesInFlight}),
+        cache(kj::mv(mockPair.client), lru, gate, options.hooks),
         gateBrokenPromise(options.monitorOutputGate
             ? eagerlyReportExceptions(gate.onBroken())
             : kj::Promise<void>(kj::READY_NOW)) {}
@@ -678,6 +683,43 @@ KJ_TEST("ActorCache batching due to maxKeysPerRpc") {
   KJ_EXPECT(deleteProm3.wait(ws) == 2);
 }
 
+KJ_TEST("ActorCache flush batches are sent through a bounded window") {
+  ActorCacheTest test({.maxKeysPerRpc = 1, .maxFlushBatchesInFlight = 2});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  test.put({{"a", "1"}, {"b", "2"}, {"c", "3"}, {"d", "4"}});
+
+  auto mockTxn = mockStorage->expectCall("txn", ws).returnMock("transaction");
+  auto putA = mockTxn->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "a", value = "1")]));
+  auto putB = mockTxn->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "b", value = "2")]));
+
+  // The window is full, so nothing else is sent until a batch completes.
+  mockTxn->expectNoActivity(ws);
+
+  // Overwriting a key doesn't affect the batches still waiting to be sent.
+  test.put("c", "333");
+
+  kj::mv(putA).thenReturn(CAPNP());
+  auto putC = mockTxn->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "c", value = "3")]));
+  mockTxn->expectNoActivity(ws);
+
+  kj::mv(putB).thenReturn(CAPNP());
+  kj::mv(putC).thenReturn(CAPNP());
+  mockTxn->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "d", value = "4")]))
+      .thenReturn(CAPNP());
+  mockTxn->expectCall("commit", ws).thenReturn(CAPNP());
+  mockTxn->expectDropped(ws);
+
+  mockStorage->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "c", value = "333")]))
+      .thenReturn(CAPNP());
+}
+
 KJ_TEST("ActorCache batching due to max storage RPC words") {
   ActorCacheTest test({.hardLimit = 128 * 1024 * 1024});
   auto& ws = test.ws;
@@ -1130,6 +1172,65 @@ KJ_TEST("ActorCache put during flush") {
   KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("bar"))) == "654");
 }
 
+KJ_TEST("ActorCache pipelined flushes") {
+  ActorCacheTest test({.monitorOutputGate = false, .pipelineFlushes = true});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  test.put("foo", "123");
+  auto firstGate = test.gate.wait();
+
+  auto firstFlush = mockStorage->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "foo", value = "123")]));
+
+  // While the first flush is in flight, a second write is sent right away rather than waiting.
+  test.put("bar", "456");
+  test.put("foo", "321");
+  auto secondGate = test.gate.wait();
+
+  auto secondFlush = mockStorage->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "bar", value = "456"), (key = "foo", value = "321")]));
+
+  KJ_ASSERT(!firstGate.poll(ws));
+  KJ_ASSERT(!secondGate.poll(ws));
+
+  // Completing the second flush first isn't enough to unblock anything.
+  kj::mv(secondFlush).thenReturn(CAPNP());
+  KJ_ASSERT(!firstGate.poll(ws));
+  KJ_ASSERT(!secondGate.poll(ws));
+
+  kj::mv(firstFlush).thenReturn(CAPNP());
+  firstGate.wait(ws);
+  secondGate.wait(ws);
+
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("foo"))) == "321");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("bar"))) == "456");
+}
+
+KJ_TEST("ActorCache pipelined flushes are serialized around counted deletes") {
+  ActorCacheTest test({.pipelineFlushes = true});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  test.put("foo", "123");
+
+  auto firstFlush = mockStorage->expectCall("put", ws)
+      .withParams(CAPNP(entries = [(key = "foo", value = "123")]));
+
+  // A delete whose count someone is waiting for can't be pipelined...
+  auto promise = expectUncached(test.delete_("bar"));
+
+  mockStorage->expectNoActivity(ws);
+  kj::mv(firstFlush).thenReturn(CAPNP());
+
+  // ...so it's only sent once the previous flush completes.
+  mockStorage->expectCall("delete", ws)
+      .withParams(CAPNP(keys = ["bar"]))
+      .thenReturn(CAPNP(numDeleted = 1));
+
+  KJ_ASSERT(promise.wait(ws) == 1);
+}
+
 KJ_TEST("ActorCache flush retry") {
   ActorCacheTest test;
   auto& ws = test.ws;
@@ -3561,6 +3662,40 @@ KJ_TEST("ActorCache LRU purge ordering") {
   KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("yyy"))) == "bbb");
 }
 
+KJ_TEST("ActorCache LRU gives a touched entry one second chance per touch") {
+  ActorCacheTest test({.softLimit = 512});  // big enough for four entries
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  test.put("foo", "123");
+  test.put("bar", "456");
+  test.put("baz", "789");
+  test.put("qux", "555");
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+
+  // Touch foo, so that it survives the next evictions by moving behind qux.
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("foo"))) == "123");
+
+  test.put("xxx", "aaa");
+  test.put("yyy", "bbb");
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+
+  // foo used up its second chance, so without another touch it goes right after qux.
+  test.put("zzz", "ccc");
+  test.put("www", "ddd");
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+
+  expectUncached(test.get("qux"));
+  expectUncached(test.get("foo"));
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("xxx"))) == "aaa");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("yyy"))) == "bbb");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("zzz"))) == "ccc");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("www"))) == "ddd");
+}
+
 KJ_TEST("ActorCache LRU purge larger") {
   ActorCacheTest test({.softLimit = 4096});
   auto& ws = test.ws;
@@ -3647,6 +3782,58 @@ KJ_TEST("ActorCache LRU purge") {
   expectUncached(test.get("baz"));
 }
 
+KJ_TEST("ActorCache entries are allocated from the SharedLru's slabs") {
+  ActorCacheTest test({.neverFlush = true});
+
+  KJ_EXPECT(test.lru.entrySlabCountForTest() == 0);
+
+  // Slabs hold 128 entries each, so this needs three.
+  constexpr uint count = 257;
+  for (uint i = 0; i < count; i++) {
+    test.put(kj::str("key", i), kj::str(i));
+  }
+  KJ_EXPECT(test.lru.entrySlabCountForTest() == 3);
+
+  // Overwriting every key frees each old entry right after allocating its replacement, so the
+  // freed slots are reused rather than growing the slab count without bound.
+  for (uint i = 0; i < count; i++) {
+    test.put(kj::str("key", i), kj::str(i + 1));
+  }
+  KJ_EXPECT(test.lru.entrySlabCountForTest() <= 4);
+
+  for (uint i = 0; i < count; i += 37) {
+    KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get(kj::str("key", i)))) == kj::str(i + 1));
+  }
+}
+
+KJ_TEST("ActorCache releases entry slabs once their entries are evicted") {
+  ActorCacheTest test({.maxKeysPerRpc = 1000});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  for (uint i = 0; i < 300; i++) {
+    test.put(kj::str("key", i), kj::str(i));
+  }
+  KJ_EXPECT(test.lru.entrySlabCountForTest() == 3);
+
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+
+  // Every entry is now clean, and goes stale and is evicted without being touched again.
+  for (uint i = 1; i <= 3; i++) {
+    KJ_ASSERT(test.cache.evictStale(kj::UNIX_EPOCH + i * kj::SECONDS) == nullptr);
+  }
+  // One empty slab is kept for reuse.
+  KJ_EXPECT(test.lru.entrySlabCountForTest() == 1);
+
+  // It's reused, rather than a new one being allocated.
+  test.put("again", "1");
+  KJ_EXPECT(test.lru.entrySlabCountForTest() == 1);
+
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+}
+
 KJ_TEST("ActorCache evict on timeout") {
   ActorCacheTest test;
   auto& ws = test.ws;
@@ -3698,6 +3885,113 @@ KJ_TEST("ActorCache evict on timeout") {
   expectUncached(test.get("baz"));
 }
 
+struct CacheStatsRecorder final: public ActorCache::Hooks {
+  uint getHits = 0;
+  uint getMisses = 0;
+  uint listHits = 0;
+  uint listMisses = 0;
+  uint evictions = 0;
+  uint flushes = 0;
+  size_t residentBytes = 0;
+  size_t dirtyBytes = 0;
+
+  void cacheHits(ReadOp op, uint count) override {
+    (op == ReadOp::GET ? getHits : listHits) += count;
+  }
+  void cacheMisses(ReadOp op, uint count) override {
+    (op == ReadOp::GET ? getMisses : listMisses) += count;
+  }
+  void cacheEvictions(uint count) override { evictions += count; }
+  void cacheFlushed(kj::Duration latency) override { ++flushes; }
+  void cacheSize(size_t resident, size_t dirty) override {
+    residentBytes = resident;
+    dirtyBytes = dirty;
+  }
+};
+
+KJ_TEST("ActorCache reports hits, misses, evictions, flushes, and size to its hooks") {
+  CacheStatsRecorder stats;
+  ActorCacheTest test({.hooks = stats});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  auto timePoint = kj::UNIX_EPOCH;
+
+  {
+    auto promise = expectUncached(test.get("foo"));
+
+    mockStorage->expectCall("get", ws)
+        .withParams(CAPNP(key = "foo"))
+        .thenReturn(CAPNP(value = "123"));
+
+    promise.wait(ws);
+  }
+  expectCached(test.get("foo"));
+  KJ_EXPECT(stats.getMisses == 1);
+  KJ_EXPECT(stats.getHits == 1);
+
+  // A multi-key get() counts each key.
+  {
+    auto promise = expectUncached(test.get({"foo"_kj, "bar"_kj}));
+
+    mockStorage->expectCall("getMultiple", ws)
+        .withParams(CAPNP(keys = ["bar"]), "stream"_kj)
+        .useCallback("stream", [&](MockClient stream) {
+      stream.call("end", CAPNP()).expectReturns(CAPNP(), ws);
+    }).expectCanceled();
+
+    promise.wait(ws);
+  }
+  KJ_EXPECT(stats.getMisses == 2);
+  KJ_EXPECT(stats.getHits == 2);
+
+  // A list() counts once, as a hit only if it didn't need storage.
+  {
+    auto promise = expectUncached(test.list(nullptr, nullptr));
+
+    mockStorage->expectCall("list", ws)
+        .withParams(CAPNP(), "stream"_kj)
+        .useCallback("stream", [&](MockClient stream) {
+      stream.call("values", CAPNP(list = [(key = "foo", value = "123")]))
+          .expectReturns(CAPNP(), ws);
+      stream.call("end", CAPNP()).expectReturns(CAPNP(), ws);
+    }).expectCanceled();
+
+    promise.wait(ws);
+  }
+  expectCached(test.list(nullptr, nullptr));
+  KJ_EXPECT(stats.listMisses == 1);
+  KJ_EXPECT(stats.listHits == 1);
+
+  // Sizes are reported from evictStale().
+  test.put("baz", "789");
+  KJ_ASSERT(test.cache.evictStale(timePoint) == nullptr);
+  KJ_EXPECT(stats.dirtyBytes > 0);
+  KJ_EXPECT(stats.residentBytes > stats.dirtyBytes);
+
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+  KJ_EXPECT(stats.flushes == 1);
+
+  // Everything goes stale and is evicted; evictions are reported by the following call.
+  KJ_ASSERT(test.cache.evictStale(timePoint + 1000 * kj::MILLISECONDS) == nullptr);
+  KJ_EXPECT(stats.dirtyBytes == 0);
+  KJ_ASSERT(test.cache.evictStale(timePoint + 2000 * kj::MILLISECONDS) == nullptr);
+  KJ_EXPECT(stats.evictions == 0);
+  KJ_ASSERT(test.cache.evictStale(timePoint + 3000 * kj::MILLISECONDS) == nullptr);
+  KJ_EXPECT(stats.evictions >= 3);
+  KJ_EXPECT(stats.residentBytes == 0);
+
+  // Dropping a noCache entry once it has been flushed isn't an eviction.
+  uint evictionsBefore = stats.evictions;
+  test.put("qux", "555", {.noCache = true});
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+  KJ_ASSERT(test.cache.evictStale(timePoint + 3000 * kj::MILLISECONDS) == nullptr);
+  KJ_EXPECT(stats.evictions == evictionsBefore);
+  KJ_EXPECT(stats.residentBytes == 0);
+}
+
 KJ_TEST("ActorCache backpressure due to dirtyPressureThreshold") {
   // Each Entry below ends up being about ~126 bytes, so a limit of 256 allows for 2 entries.
   ActorCacheTest test({.dirtyListByteLimit = 256});
@@ -3858,6 +4152,58 @@ KJ_TEST("ActorCache lru evict entry with trailing known-empty gap (followed by E
   expectUncached(test.get("quy"));
 }
 
+KJ_TEST("ActorCache lru evict large entry keeps preceding known-empty gap") {
+  ActorCacheTest test({.softLimit = 1900});  // just big enough for the first list results
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  auto bigValue = kj::str(kj::repeat('x', 1000));
+
+  // Populate cache.
+  {
+    auto promise = expectUncached(test.list("bar", "qux"));
+
+    mockStorage->expectCall("list", ws)
+        .withParams(CAPNP(start = "bar", end = "qux"), "stream"_kj)
+        .useCallback("stream", [&](MockClient stream) {
+      stream.call("values", kj::str(
+          "(list = [(key = \"bar\", value = \"456\"), (key = \"baz\", value = \"789\"), "
+          "(key = \"corge\", value = \"", bigValue, "\"), (key = \"foo\", value = \"123\")])"))
+          .expectReturns(CAPNP(), ws);
+      stream.call("end", CAPNP()).expectReturns(CAPNP(), ws);
+    }).expectCanceled();
+
+    KJ_ASSERT(promise.wait(ws) ==
+        kvs({{"bar", "456"}, {"baz", "789"}, {"corge", bigValue}, {"foo", "123"}}));
+  }
+
+  // touch some stuff so that "corge" is the oldest entry.
+  expectCached(test.get("bar"));
+  expectCached(test.get("baz"));
+  expectCached(test.get("foo"));
+
+  // do a put() to force an eviction.
+  {
+    auto putValue = kj::str(kj::repeat('y', 500));
+    test.put("xyzzy", putValue);
+
+    mockStorage->expectCall("put", ws)
+        .withParams(kj::str("(entries = [(key = \"xyzzy\", value = \"", putValue, "\")])"))
+        .thenReturn(CAPNP());
+  }
+
+  // "corge" itself is gone, but the gap between "baz" and "corge" is still known empty, because
+  // the evicted entry was replaced with an END_GAP marker.
+  KJ_ASSERT(expectCached(test.list("bar", "corge")) == kvs({{"bar", "456"}, {"baz", "789"}}));
+  KJ_ASSERT(expectCached(test.get("baza")) == nullptr);
+  KJ_ASSERT(expectCached(test.list("foo", "qux")) == kvs({{"foo", "123"}}));
+
+  expectUncached(test.get("corge"));
+  expectUncached(test.get("corgea"));
+
+  test.cache.verifyConsistencyForTest();
+}
+
 KJ_TEST("ActorCache timeout entry with known-empty gaps") {
   ActorCacheTest test({.softLimit = 700});  // just big enough for the first list results
   auto& ws = test.ws;
@@ -10,6 +10,7 @@
 #include <workerd/jsg/jsg.h>
 #include <workerd/io/io-gate.h>
 #include <workerd/util/sentry.h>
+#include <workerd/util/sqlite.h>
 
 namespace workerd {
 
@@ -62,10 +63,12 @@ void ActorCache::clear(Lock& lock) {
 
 kj::Own<ActorCache::Entry> ActorCache::makeEntry(
     Lock& lock, EntryState state, Key key, kj::Maybe<Value> value) {
+  EntryAllocator::Scope allocScope(lru.entryAllocator);
   auto result = kj::atomicRefcounted<Entry>(
     kj::Badge<ActorCache>(), *this, kj::mv(key), kj::mv(value), state);
 
   lru.size.fetch_add(result->size(), std::memory_order_relaxed);
+  residentBytes.fetch_add(result->size(), std::memory_order_relaxed);
 
   return result;
 }
@@ -81,6 +84,7 @@ ActorCache::Entry::~Entry() noexcept(false) {
   KJ_IF_MAYBE(c, cache) {
     size_t size = this->size();
 
+    c->residentBytes.fetch_sub(size, std::memory_order_relaxed);
     size_t before = c->lru.size.fetch_sub(size, std::memory_order_relaxed);
 
     if (KJ_UNLIKELY(before < size)) {
@@ -94,7 +98,150 @@ ActorCache::Entry::~Entry() noexcept(false) {
   }
 }
 
-ActorCache::SharedLru::SharedLru(Options options): options(options) {}
+void* ActorCache::Entry::operator new(size_t size) {
+  return EntryAllocator::allocate(size);
+}
+
+void ActorCache::Entry::operator delete(void* ptr) {
+  EntryAllocator::free(ptr);
+}
+
+thread_local const ActorCache::EntryAllocator* ActorCache::EntryAllocator::current = nullptr;
+
+ActorCache::EntryAllocator::Scope::Scope(const EntryAllocator& allocator)
+    : previous(current) {
+  current = &allocator;
+}
+
+ActorCache::EntryAllocator::Scope::~Scope() noexcept(false) {
+  current = previous;
+}
+
+ActorCache::EntryAllocator::Slab::Slab(const SharedState& shared)
+    : shared(kj::atomicAddRef(shared)) {
+  for (auto& slot: slots) {
+    slot.slab = this;
+  }
+  // Thread the free list front-to-back so that consecutive allocations are adjacent in memory.
+  for (uint i = SLOTS_PER_SLAB; i > 0; i--) {
+    slots[i - 1].nextFree = freeList;
+    freeList = &slots[i - 1];
+  }
+}
+
+ActorCache::EntryAllocator::~EntryAllocator() noexcept(false) {
+  // Apart from the spare, every remaining slab still holds live entries. Those slabs keep `shared`
+  // alive, and are released when their last entry is freed.
+  size_t slabCount;
+  {
+    auto lock = shared->state.lockExclusive();
+    lock->keepSpare = false;
+    KJ_IF_MAYBE(spare, lock->spare) {
+      lock->spare = nullptr;
+      --lock->slabCount;
+      delete spare;
+    }
+    slabCount = lock->slabCount;
+  }
+  if (slabCount != 0) {
+    KJ_LOG(ERROR, "ActorCache::EntryAllocator destroyed while entries still exist", slabCount);
+  }
+}
+
+size_t ActorCache::EntryAllocator::slabCount() const {
+  return shared->state.lockShared()->slabCount;
+}
+
+ActorCache::EntryAllocator::Slot* ActorCache::EntryAllocator::slotFor(void* ptr) {
+  return reinterpret_cast<Slot*>(reinterpret_cast<kj::byte*>(ptr) - offsetof(Slot, storage));
+}
+
+void* ActorCache::EntryAllocator::allocate(size_t size) {
+  KJ_ASSERT(size == sizeof(Entry), size);
+
+  Slot* slot;
+  if (current == nullptr) {
+    slot = new Slot;
+    slot->slab = nullptr;
+  } else {
+    // Only the Entry allocated immediately inside the Scope comes from the slabs.
+    auto allocator = current;
+    current = nullptr;
+    slot = allocator->allocateSlot();
+  }
+  return slot->storage;
+}
+
+ActorCache::EntryAllocator::Slot* ActorCache::EntryAllocator::allocateSlot() const {
+  auto lock = shared->state.lockExclusive();
+
+  Slab* slab;
+  if (lock->available.empty()) {
+    KJ_IF_MAYBE(spare, lock->spare) {
+      slab = spare;
+      lock->spare = nullptr;
+    } else {
+      slab = new Slab(*shared);
+      ++lock->slabCount;
+    }
+    lock->available.add(*slab);
+  } else {
+    slab = &*lock->available.begin();
+  }
+
+  Slot* slot = slab->freeList;
+  slab->freeList = slot->nextFree;
+  ++slab->used;
+  if (slab->freeList == nullptr) {
+    lock->available.remove(*slab);
+  }
+  return slot;
+}
+
+void ActorCache::EntryAllocator::free(void* ptr) {
+  Slot* slot = slotFor(ptr);
+  if (slot->slab == nullptr) {
+    delete slot;
+    return;
+  }
+
+  Slab& slab = *slot->slab;
+
+  // If this empties the slab, we release its reference to the shared state only after unlocking,
+  // since it may be the last one.
+  kj::Own<const SharedState> releasedShared;
+  {
+    auto lock = slab.shared->state.lockExclusive();
+
+    bool wasFull = slab.freeList == nullptr;
+    slot->nextFree = slab.freeList;
+    slab.freeList = slot;
+    --slab.used;
+
+    if (slab.used == 0) {
+      if (!wasFull) {
+        lock->available.remove(slab);
+      }
+      if (lock->keepSpare && lock->spare == nullptr) {
+        lock->spare = slab;
+      } else {
+        --lock->slabCount;
+        releasedShared = kj::mv(slab.shared);
+        delete &slab;
+      }
+    } else if (wasFull) {
+      lock->available.add(slab);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+
+ActorCache::SharedLru::SharedLru(Options options): options(options) {
+  if (options.sqlitePageCacheLimit > 0) {
+    SqliteDatabase::setPageCacheLimit(options.sqlitePageCacheLimit);
+  }
+}
 
 ActorCache::SharedLru::~SharedLru() noexcept(false) {
   KJ_REQUIRE(cleanList.getWithoutLock().empty(),
@@ -106,6 +253,12 @@ ActorCache::SharedLru::~SharedLru() noexcept(false) {
 }
 
 kj::Maybe<kj::Promise<void>> ActorCache::evictStale(kj::Date now) {
+  uint evictions = unreportedEvictions.exchange(0, std::memory_order_relaxed);
+  if (evictions > 0) {
+    hooks.cacheEvictions(evictions);
+  }
+  hooks.cacheSize(residentBytes.load(std::memory_order_relaxed), dirtyList.sizeInBytes());
+
   int64_t nowNs = (now - kj::UNIX_EPOCH) / kj::NANOSECONDS;
   int64_t oldValue = lru.nextStaleCheckNs.load(std::memory_order_relaxed);
 
@@ -117,7 +270,9 @@ kj::Maybe<kj::Promise<void>> ActorCache::evictStale(kj::Date now) {
         if (entry.state == STALE) {
           entry.state = NOT_IN_CACHE;
           lock->remove(entry);
-          KJ_ASSERT_NONNULL(entry.cache).evictEntry(lock, entry);
+          auto& cache = KJ_ASSERT_NONNULL(entry.cache);
+          cache.unreportedEvictions.fetch_add(1, std::memory_order_relaxed);
+          cache.evictEntry(lock, entry);
         } else {
           KJ_ASSERT(entry.state == CLEAN);
           entry.state = STALE;
@@ -260,9 +415,19 @@ bool ActorCache::SharedLru::evictIfNeeded(Lock& lock) const {
     }
 
     Entry& entry = lock->front();
-    entry.state = NOT_IN_CACHE;
     lock->remove(entry);
-    KJ_ASSERT_NONNULL(entry.cache).evictEntry(lock, entry);
+    if (entry.recentlyUsed) {
+      // Accessed since it was last considered, give it a second chance. This loop terminates
+      // because each entry can only be given one second chance per pass over the list.
+      entry.recentlyUsed = false;
+      lock->add(entry);
+      continue;
+    }
+
+    entry.state = NOT_IN_CACHE;
+    auto& cache = KJ_ASSERT_NONNULL(entry.cache);
+    cache.unreportedEvictions.fetch_add(1, std::memory_order_relaxed);
+    cache.evictEntry(lock, entry);
   }
 }
 
@@ -270,8 +435,7 @@ void ActorCache::touchEntry(Lock& lock, Entry& entry, const ReadOptions& options
   if (!options.noCache) {
     if (entry.state == CLEAN || entry.state == STALE) {
       entry.state = CLEAN;
-      lock->remove(entry);
-      lock->add(entry);
+      entry.recentlyUsed = true;
     }
 
     // If this is a dirty entry previously marked no-cache, remove that mark. This results in the
@@ -288,22 +452,6 @@ void ActorCache::evictEntry(Lock& lock, Entry& entry) {
 
   KJ_ASSERT(iter != ordered.end() && iter->get() == &entry);
 
-  // If the previous entry has gapIsKnownEmpty, we need to set that false, because when we delete
-  // this entry, the previous entry's "gap" will now extend to the *next* entry. We definitely know
-  // that that the new gap is non-empty because we're evicting an entry inside that very gap.
-  //
-  // TODO(perf): Maybe we should instead replace the evicted entry with an END_GAP entry in this
-  //   case? The problem is, when the app accesses a key in the gap, the LRU time of the previous
-  //   entry gets bumped, but the _next_ entry does not get bumped. Hence these acccesses won't
-  //   prevent the next entry from being evicted, and when it is, the gap effectively gets evicted
-  //   too, leading to a cache miss on a key that had been recently accessed. This is a pretty
-  //   obscure scenario, though, and after one cache miss the key would then be in cache again.
-  if (iter != ordered.begin()) {
-    auto prev = iter;
-    --prev;
-    prev->get()->gapIsKnownEmpty = false;
-  }
-
   // If this entry has gapIsKnownEmpty and the next entry is END_GAP, we should delete the
   // END_GAP, because it no longer serves a purpose.
   kj::Maybe<KeyPtr> eraseLater;
@@ -316,7 +464,45 @@ void ActorCache::evictEntry(Lock& lock, Entry& entry) {
     }
   }
 
-  map.erase(*iter);
+  bool prevGapIsKnownEmpty = false;
+  if (iter != ordered.begin()) {
+    auto prev = iter;
+    --prev;
+    prevGapIsKnownEmpty = prev->get()->gapIsKnownEmpty;
+  }
+
+  bool keepGap = false;
+  if (prevGapIsKnownEmpty) {
+    KJ_IF_MAYBE(v, entry.value) {
+      keepGap = v->size() >= sizeof(Entry) + entry.key.size();
+    }
+  }
+
+  if (keepGap) {
+    // The previous entry's gap is known empty up to this key. Rather than forget that (which
+    // would send the next list() over the range back to storage from the previous key onward),
+    // replace the evicted entry with an END_GAP marker that keeps the gap capped. The marker
+    // holds no value, so this still frees the value's memory. The gap then lives exactly as
+    // long as the previous entry, which is the one whose LRU position is bumped by accesses to
+    // keys inside the gap; when the previous entry is evicted in turn, the marker goes with it
+    // (see above).
+    //
+    // We only do this when the marker is at most half the size of the evicted entry, so that
+    // eviction still makes real progress towards the LRU's limits.
+    *iter = makeEntry(lock, END_GAP, cloneKey(entry.key), nullptr);
+  } else {
+    // If the previous entry has gapIsKnownEmpty, we need to set that false, because when we
+    // delete this entry, the previous entry's "gap" will now extend to the *next* entry. We
+    // definitely know that that the new gap is non-empty because we're evicting an entry inside
+    // that very gap.
+    if (prevGapIsKnownEmpty) {
+      auto prev = iter;
+      --prev;
+      prev->get()->gapIsKnownEmpty = false;
+    }
+
+    map.erase(*iter);
+  }
 
   KJ_IF_MAYBE(k, eraseLater) {
     map.eraseMatch(*k);
@@ -371,10 +557,12 @@ kj::OneOf<kj::Maybe<ActorCache::Value>, kj::Promise<kj::Maybe<ActorCache::Value>
 
   auto lock = lru.cleanList.lockExclusive();
   KJ_IF_MAYBE(entry, findInCache(lock, key, options)) {
+    hooks.cacheHits(Hooks::ReadOp::GET, 1);
     return entry->get()->value.map([&](ValuePtr value) {
       return value.attach(kj::mv(*entry));
     });
   } else {
+    hooks.cacheMisses(Hooks::ReadOp::GET, 1);
     return scheduleStorageRead([key=KeyPtr(key)](rpc::ActorStorage::Operations::Client client) {
       auto req = client.getRequest(
           capnp::MessageSize { 4 + key.size() / sizeof(capnp::word), 0 });
@@ -548,6 +736,9 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
     }
   }
 
+  hooks.cacheHits(Hooks::ReadOp::GET, cachedEntries.size());
+  hooks.cacheMisses(Hooks::ReadOp::GET, keysToFetch.size());
+
   if (keysToFetch.empty()) {
     // All satisfied, return early.
     return GetResultList(kj::mv(cachedEntries), {}, GetResultList::FORWARD);
@@ -983,9 +1174,12 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
 
   if (storageListStart == nullptr || knownPrefixSize >= limit.orDefault(kj::maxValue)) {
     // We fully satisfied the list operation from cache.
+    hooks.cacheHits(Hooks::ReadOp::LIST, 1);
     return GetResultList(kj::mv(cachedEntries), {}, GetResultList::FORWARD, limit);
   }
 
+  hooks.cacheMisses(Hooks::ReadOp::LIST, 1);
+
   auto adjustedLimit = limit.map([&](uint orig) {
     return orig + limitAdjustment - knownPrefixSize;
   });
@@ -1304,9 +1498,12 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
 
   if (storageListEnd == nullptr || knownSuffixSize >= limit.orDefault(kj::maxValue)) {
     // We fully satisfied the list operation from cache.
+    hooks.cacheHits(Hooks::ReadOp::LIST, 1);
     return GetResultList(kj::mv(cachedEntries), {}, GetResultList::REVERSE, limit);
   }
 
+  hooks.cacheMisses(Hooks::ReadOp::LIST, 1);
+
   {
     KeyPtr k = KJ_ASSERT_NONNULL(storageListEnd);
     if (k == nullptr) {
@@ -1435,12 +1632,18 @@ kj::Own<ActorCache::Entry> ActorCache::addReadResultToCache(
 
   auto& map = currentValues.get(lock);
 
+  kj::Maybe<kj::Own<Entry>&> existingSlot;
+  // If we already looked up the key and found an existing entry, this is its slot, so that we
+  // don't need to repeat the lookup below.
+
   if (value == nullptr) {
     // Inserting a negative entry. Let's check if the new insertion is redundant due to the
     // previous entry having `gapIsKnownEmpty`.
     auto iter = map.seek(entry->key);
     auto ordered = map.ordered();
-    if ((iter == ordered.end() || iter->get()->key != entry->key) && iter != ordered.begin()) {
+    if (iter != ordered.end() && iter->get()->key == entry->key) {
+      existingSlot = *iter;
+    } else if (iter != ordered.begin()) {
       // We did not find an exact match for the key, so we got an iterator pointing to the next
       // entry after the key. It's not the first entry, so we can back it up one to get the
       // entry before the key.
@@ -1454,28 +1657,40 @@ kj::Own<ActorCache::Entry> ActorCache::addReadResultToCache(
       }
     }
 
-    // TODO(perf): It's a little sad that we are going to do a findOrCreate() below that is going
-    //   to repeat the same lookup that produced `iter`. Maybe we could extend kj::Table with a
-    //   way to provide an existing iterator as a hint when inserting?
+    // TODO(perf): If the key wasn't found, the findOrCreate() below repeats the lookup that
+    //   produced `iter`. Avoiding that needs kj::TreeIndex to accept an iterator as an insertion
+    //   hint.
   }
 
+  // Positive results -- including every row a list() inserts -- skip the seek above, so they pay
+  // for exactly one lookup, in findOrCreate(). A list() batch then costs one more seek per batch,
+  // not per row, in markGapsEmpty().
+
   // At this point, we know we definitely want there to exist an entry matching this key. So now
   // try to insert it.
-  auto& slot = map.findOrCreate(entry->key, [&]() {
-    // No existing entry has this key, so insert our new entry.
-    //
-    // Note that it's definitely guaranteed that the entry *before* the one we're inserting cannot
-    // possibly have `gapIsKnownEmpty = true`, because:
-    // 1. If our new entry has a null value, then we could have returned early above in this case.
-    // 2. If our new entry has a non-null value, then it would be inconsistent for a previous
-    //    entry to claim that the gap is empty -- this new entry proves it was not! Remember that
-    //    we are inserting an entry that was the result of reading from disk, so it *must* be
-    //    consistent with any existing knowledge about the state of disk -- unless we have a bug in
-    //    the caching logic.
-    //
-    // Because of this, we know it is correct to leave `gapIsKnownEmpty = false` on our new entry.
-    return kj::atomicAddRef(*entry);
-  });
+  auto& slot = [&]() -> kj::Own<Entry>& {
+    KJ_IF_MAYBE(s, existingSlot) {
+      return *s;
+    }
+
+    return map.findOrCreate(entry->key, [&]() {
+      // No existing entry has this key, so insert our new entry.
+      //
+      // Note that it's definitely guaranteed that the entry *before* the one we're inserting
+      // cannot possibly have `gapIsKnownEmpty = true`, because:
+      // 1. If our new entry has a null value, then we could have returned early above in this
+      //    case.
+      // 2. If our new entry has a non-null value, then it would be inconsistent for a previous
+      //    entry to claim that the gap is empty -- this new entry proves it was not! Remember that
+      //    we are inserting an entry that was the result of reading from disk, so it *must* be
+      //    consistent with any existing knowledge about the state of disk -- unless we have a bug
+      //    in the caching logic.
+      //
+      // Because of this, we know it is correct to leave `gapIsKnownEmpty = false` on our new
+      // entry.
+      return kj::atomicAddRef(*entry);
+    });
+  }();
 
   if (slot.get() != entry.get()) {
     // There was a pre-existing entry with the key, so ours wasn't inserted.
@@ -2139,17 +2354,34 @@ void ActorCache::ensureFlushScheduled(const WriteOptions& options) {
 
   if (!flushScheduled) {
     flushScheduled = true;
-    auto flushPromise = lastFlush.addBranch().attach(kj::defer([this]() {
+
+    // When pipelining, we can start as soon as the previous flush has sent its writes, but we
+    // still need to know when it completes, since this flush isn't done until all previous ones
+    // are.
+    kj::Maybe<kj::Promise<void>> previous;
+    if (lru.options.pipelineFlushes) {
+      previous = lastFlush.addBranch();
+    }
+    auto& startAfter = lru.options.pipelineFlushes ? lastFlushSent : lastFlush;
+
+    auto flushPromise = startAfter.addBranch().attach(kj::defer([this]() {
       flushScheduled = false;
       flushScheduledWithOutputGate = false;
-    })).then([this]() {
+    })).then([this, previous = kj::mv(previous)]() mutable {
       ++flushesEnqueued;
-      return kj::evalNow([this](){
+      auto startTime = kj::systemPreciseMonotonicClock().now();
+      return kj::evalNow([&]() {
         // `flushImpl()` can throw, so we need to wrap it in `evalNow()` to observe all pathways.
-        return flushImpl();
+        KJ_IF_MAYBE(p, previous) {
+          return flushImplPipelined(kj::mv(*p));
+        } else {
+          return flushImpl();
+        }
       }).attach(kj::defer([this](){
         --flushesEnqueued;
-      }));
+      })).then([this, startTime]() {
+        hooks.cacheFlushed(kj::systemPreciseMonotonicClock().now() - startTime);
+      });
     });
 
     if (options.allowUnconfirmed) {
@@ -2246,6 +2478,80 @@ using RpcDeleteRequest = capnp::Request<rpc::ActorStorage::Operations::DeletePar
     rpc::ActorStorage::Operations::DeleteResults>;
 }
 
+void ActorCache::includeInFlushBatch(kj::Vector<FlushBatch>& batches, size_t words) {
+  KJ_ASSERT(words < MAX_ACTOR_STORAGE_RPC_WORDS);
+
+  if (batches.empty()) {
+    // This is the first one, let's just set up a current batch.
+    batches.add(FlushBatch{});
+  } else if (auto& tailBatch = batches.back();
+      tailBatch.pairCount >= lru.options.maxKeysPerRpc
+      || ((tailBatch.wordCount + words) > MAX_ACTOR_STORAGE_RPC_WORDS)) {
+    // We've filled this batch, add a new one.
+    batches.add(FlushBatch{});
+  }
+
+  auto& batch = batches.back();
+  ++batch.pairCount;
+  batch.wordCount += words;
+}
+
+void ActorCache::markFlushedEntryClean(Lock& lock, Entry& entry) {
+  KJ_ASSERT(entry.state == FLUSHING);
+
+  // We know all `countedDelete` operations were satisfied so we can remove this if it's
+  // present. Note that if, during the flush, the entry was overwritten, then the new entry
+  // will have inherited the `countedDelete`, and will still be DIRTY at this point. That is
+  // OK, because the `countedDelete`'s fulfiller will have already been fulfilled, and
+  // therefore the next flushImpl() will see that it is obsolete and discard it.
+  entry.countedDelete = nullptr;
+
+  dirtyList.remove(entry);
+  if (entry.noCache) {
+    entry.state = NOT_IN_CACHE;
+    evictEntry(lock, entry);
+  } else {
+    entry.state = CLEAN;
+
+    if (entry.gapIsKnownEmpty && entry.value == nullptr) {
+      // This is a negative entry, and is followed by a known-empty gap. If the previous entry
+      // also has `gapIsKnownEmpty`, then this entry is entirely redundant.
+      auto& map = KJ_ASSERT_NONNULL(entry.cache).currentValues.get(lock);
+      auto iter = map.seek(entry.key);
+      KJ_ASSERT(iter->get() == &entry);
+
+      if (iter != map.ordered().begin()) {
+        auto& slot = *iter;
+        --iter;
+        if (iter->get()->gapIsKnownEmpty) {
+          // Yep!
+          entry.state = NOT_IN_CACHE;
+          map.erase(slot);
+          // WARNING: We might have just deleted `entry`.
+          return;
+        }
+      }
+    }
+
+    lock->add(entry);
+  }
+}
+
+void ActorCache::dropFlushedFromDeleteAll(DeleteAllState& state) {
+  // It would appear that all dirty entries were moved into `requestedDeleteAll` during the
+  // time that we were waiting for the flushImpl(). We want to remove the `FLUSHING` entries
+  // from that vector now.
+  // TODO(cleanup): kj::Vector<T>::filter() would be nice to have here.
+  auto dst = state.deletedDirty.begin();
+  for (auto src = state.deletedDirty.begin(); src != state.deletedDirty.end(); ++src) {
+    if (src->get()->state == DIRTY) {
+      if (dst != src) *dst = kj::mv(*src);
+      ++dst;
+    }
+  }
+  state.deletedDirty.resize(dst - state.deletedDirty.begin());
+}
+
 kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
   KJ_IF_MAYBE(e, maybeTerminalException) {
     // If we have a terminal exception, throw here to break the output gate and prevent any calls
@@ -2286,33 +2592,16 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
   // muted deletes, we go ahead and construct batches of no more than 128 keys. They all end up
   // being part of the same transaction in the end, though.
   //
-  // TODO(perf): Currently we send all the batches at the same time. If the batches are large,
-  //   it could be worth spacing them out a bit so we don't saturate the connection. However, we
-  //   still need to make sure that the whole transaction represents a consistent snapshot in time,
-  //   so getting this right, without making a copy of everything upfront, could get complicated.
-  //   Punting for now.
+  // When a transaction has many batches, we don't send them all at once, since that would mean
+  // building every RPC message upfront and saturating the storage connection. Instead,
+  // flushImplUsingTxn() keeps at most `maxFlushBatchesInFlight` batches (and
+  // `maxFlushBytesInFlight` bytes) outstanding, building each message right before sending it.
+  // The transaction still represents a consistent snapshot because it holds references to the
+  // (immutable) entries it is writing, rather than looking them up again later.
 
   PutFlush putFlush;
   MutedDeleteFlush mutedDeleteFlush;
 
-  auto includeInCurrentBatch = [this](kj::Vector<FlushBatch>& batches, size_t words) {
-    KJ_ASSERT(words < MAX_ACTOR_STORAGE_RPC_WORDS);
-
-    if (batches.empty()) {
-      // This is the first one, let's just set up a current batch.
-      batches.add(FlushBatch{});
-    } else if (auto& tailBatch = batches.back();
-        tailBatch.pairCount >= lru.options.maxKeysPerRpc
-        || ((tailBatch.wordCount + words) > MAX_ACTOR_STORAGE_RPC_WORDS)) {
-      // We've filled this batch, add a new one.
-      batches.add(FlushBatch{});
-    }
-
-    auto& batch = batches.back();
-    ++batch.pairCount;
-    batch.wordCount += words;
-  };
-
   kj::Vector<CountedDeleteFlush> countedDeleteFlushes;
 
   auto countEntry = [&](Entry& entry) {
@@ -2349,7 +2638,7 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
           });
         }
         auto words = keySizeInWords + 1;
-        includeInCurrentBatch(countedDeleteFlush->batches, words);
+        includeInFlushBatch(countedDeleteFlush->batches, words);
         countedDeleteFlush->entries.add(&entry);
       } else {
         // No one is waiting on this `CountedDelete` anymore so we can just drop it.
@@ -2360,11 +2649,11 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
     KJ_IF_MAYBE(v, entry.value) {
       auto words = keySizeInWords + bytesToWordsRoundUp(v->size()) +
           capnp::sizeInWords<rpc::ActorStorage::KeyValue>();
-      includeInCurrentBatch(putFlush.batches, words);
+      includeInFlushBatch(putFlush.batches, words);
       putFlush.entries.add(&entry);
     } else if (entry.countedDelete == nullptr) {
       auto words = keySizeInWords + 1;
-      includeInCurrentBatch(mutedDeleteFlush.batches, words);
+      includeInFlushBatch(mutedDeleteFlush.batches, words);
       mutedDeleteFlush.entries.add(&entry);
     }
   };
@@ -2485,18 +2774,7 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
     auto lock = lru.cleanList.lockExclusive();
 
     KJ_IF_MAYBE(r, requestedDeleteAll) {
-      // It would appear that all dirty entries were moved into `requestedDeleteAll` during the
-      // time that we were waiting for the flushImpl(). We want to remove the `FLUSHING` entries
-      // from that vector now.
-      // TODO(cleanup): kj::Vector<T>::filter() would be nice to have here.
-      auto dst = r->deletedDirty.begin();
-      for (auto src = r->deletedDirty.begin(); src != r->deletedDirty.end(); ++src) {
-        if (src->get()->state == DIRTY) {
-          if (dst != src) *dst = kj::mv(*src);
-          ++dst;
-        }
-      }
-      r->deletedDirty.resize(dst - r->deletedDirty.begin());
+      dropFlushedFromDeleteAll(*r);
     } else {
       // Mark all `FLUSHING` entries as `CLEAN`. Note that we know that all `FLUSHING` must
       // form a prefix of `dirtyList` since any new entries would have been added to the end.
@@ -2506,44 +2784,7 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
           break;
         }
 
-        KJ_ASSERT(entry.state == FLUSHING);
-
-        // We know all `countedDelete` operations were satisfied so we can remove this if it's
-        // present. Note that if, during the flush, the entry was overwritten, then the new entry
-        // will have inherited the `countedDelete`, and will still be DIRTY at this point. That is
-        // OK, because the `countedDelete`'s fulfiller will have already been fulfilled, and
-        // therefore the next flushImpl() will see that it is obsolete and discard it.
-        entry.countedDelete = nullptr;
-
-        dirtyList.remove(entry);
-        if (entry.noCache) {
-          entry.state = NOT_IN_CACHE;
-          evictEntry(lock, entry);
-        } else {
-          entry.state = CLEAN;
-
-          if (entry.gapIsKnownEmpty && entry.value == nullptr) {
-            // This is a negative entry, and is followed by a known-empty gap. If the previous entry
-            // also has `gapIsKnownEmpty`, then this entry is entirely redundant.
-            auto& map = KJ_ASSERT_NONNULL(entry.cache).currentValues.get(lock);
-            auto iter = map.seek(entry.key);
-            KJ_ASSERT(iter->get() == &entry);
-
-            if (iter != map.ordered().begin()) {
-              auto& slot = *iter;
-              --iter;
-              if (iter->get()->gapIsKnownEmpty) {
-                // Yep!
-                entry.state = NOT_IN_CACHE;
-                map.erase(slot);
-                // WARNING: We might have just deleted `entry`.
-                continue;
-              }
-            }
-          }
-
-          lock->add(entry);
-        }
+        markFlushedEntryClean(lock, entry);
       }
     }
 
@@ -2573,7 +2814,144 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
   });
 }
 
-kj::Promise<void> ActorCache::flushImplUsingSinglePut(PutFlush putFlush) {
+bool ActorCache::canPipelineFlush() {
+  if (requestedDeleteAll != nullptr) {
+    // deleteAll() can't be part of a transaction, so has to be ordered explicitly.
+    return false;
+  }
+
+  KJ_SWITCH_ONEOF(currentAlarmTime) {
+    KJ_CASE_ONEOF(knownAlarmTime, ActorCache::KnownAlarmTime) {
+      if (knownAlarmTime.status != KnownAlarmTime::Status::CLEAN) return false;
+    }
+    KJ_CASE_ONEOF(deferredDelete, ActorCache::DeferredAlarmDelete) {
+      if (deferredDelete.status == DeferredAlarmDelete::Status::READY ||
+          deferredDelete.status == DeferredAlarmDelete::Status::FLUSHING) {
+        return false;
+      }
+    }
+    KJ_CASE_ONEOF(_, UnknownAlarmTime) {}
+  }
+
+  for (auto& entry: dirtyList) {
+    if (entry.state != DIRTY) continue;
+    KJ_IF_MAYBE(c, entry.countedDelete) {
+      if (c->get()->resultFulfiller->isWaiting()) {
+        // Counted deletes track their progress in the CountedDelete itself (see `flushIndex`),
+        // so two flushes can't be counting the same one at once.
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+kj::Promise<void> ActorCache::flushImplPipelined(kj::Promise<void> previous) {
+  KJ_IF_MAYBE(e, maybeTerminalException) {
+    kj::throwFatalException(kj::cp(*e));
+  }
+
+  if (!canPipelineFlush()) {
+    // Fall back to a regular flush once everything before us has completed, and don't let the
+    // next flush start until this one has completed either. This way flushImpl() never sees
+    // FLUSHING entries that belong to some other flush, and can retry on disconnect as usual.
+    auto done = previous.then([this]() { return flushImpl(); }).fork();
+    lastFlushSent = done.addBranch().fork();
+    return done.addBranch();
+  }
+
+  // Collect only DIRTY entries; FLUSHING ones are being written by an earlier flush which is
+  // still in flight. Unlike flushImpl(), we can't rely on our entries forming a prefix of
+  // `dirtyList` when we complete, so we hold on to them explicitly.
+  PutFlush putFlush;
+  MutedDeleteFlush mutedDeleteFlush;
+  kj::Vector<kj::Own<Entry>> flushing;
+  for (auto& entry: dirtyList) {
+    if (entry.state != DIRTY) continue;
+
+    entry.state = FLUSHING;
+
+    // canPipelineFlush() checked that no one is waiting on this anymore.
+    entry.countedDelete = nullptr;
+
+    auto keySizeInWords = bytesToWordsRoundUp(entry.key.size());
+    KJ_IF_MAYBE(v, entry.value) {
+      auto words = keySizeInWords + bytesToWordsRoundUp(v->size()) +
+          capnp::sizeInWords<rpc::ActorStorage::KeyValue>();
+      includeInFlushBatch(putFlush.batches, words);
+      putFlush.entries.add(&entry);
+    } else {
+      includeInFlushBatch(mutedDeleteFlush.batches, keySizeInWords + 1);
+      mutedDeleteFlush.entries.add(&entry);
+    }
+    flushing.add(kj::atomicAddRef(entry));
+  }
+
+  if (flushing.empty()) {
+    // Nothing new to write. `lastFlushSent` is already resolved.
+    return kj::mv(previous);
+  }
+
+  auto sentPaf = kj::newPromiseAndFulfiller<void>();
+  lastFlushSent = sentPaf.promise.fork();
+
+  kj::Promise<void> flushProm = nullptr;
+  if (mutedDeleteFlush.batches.empty() && putFlush.batches.size() == 1) {
+    flushProm = flushImplUsingSinglePut(kj::mv(putFlush), kj::mv(sentPaf.fulfiller));
+  } else if (putFlush.batches.empty() && mutedDeleteFlush.batches.size() == 1) {
+    flushProm = flushImplUsingSingleMutedDelete(kj::mv(mutedDeleteFlush),
+                                                kj::mv(sentPaf.fulfiller));
+  } else {
+    flushProm = flushImplUsingTxn(kj::mv(putFlush), kj::mv(mutedDeleteFlush), nullptr,
+                                  CleanAlarm{}, kj::mv(sentPaf.fulfiller));
+  }
+
+  // This flush only counts as done once all previous flushes are, too. That also means entries
+  // are marked clean in flush order.
+  auto promises = kj::heapArrayBuilder<kj::Promise<void>>(2);
+  promises.add(kj::mv(previous));
+  promises.add(oomCanceler.wrap(kj::mv(flushProm)));
+
+  return kj::joinPromises(promises.finish())
+      .then([this, flushing = flushing.releaseAsArray()]() -> kj::Promise<void> {
+    auto lock = lru.cleanList.lockExclusive();
+
+    KJ_IF_MAYBE(r, requestedDeleteAll) {
+      dropFlushedFromDeleteAll(*r);
+    } else {
+      for (auto& entry: flushing) {
+        // Entries overwritten in the meantime are NOT_IN_CACHE now; their replacements will be
+        // written by a later flush.
+        if (entry->state == FLUSHING) {
+          markFlushedEntryClean(lock, *entry);
+        }
+      }
+    }
+
+    evictOrOomIfNeeded(lock);
+
+    return kj::READY_NOW;
+  }, [](kj::Exception&& e) -> kj::Promise<void> {
+    // Unlike flushImpl(), we can't retry on disconnect: later flushes may have been sent already,
+    // and a retry would then land after them.
+    if (jsg::isTunneledException(e.getDescription()) ||
+        jsg::isDoNotLogException(e.getDescription())) {
+      auto msg = jsg::stripRemoteExceptionPrefix(e.getDescription());
+      if (!(msg.startsWith("broken."))) {
+        e.setDescription(kj::str("broken.outputGateBroken; ", msg));
+      }
+      return kj::mv(e);
+    } else {
+      LOG_EXCEPTION("actorCacheFlush", e);
+      return KJ_EXCEPTION(FAILED, "broken.outputGateBroken; jsg.Error: Internal error in Durable "
+          "Object storage write caused object to be reset.");
+    }
+  });
+}
+
+kj::Promise<void> ActorCache::flushImplUsingSinglePut(
+    PutFlush putFlush, kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> onSent) {
   KJ_ASSERT(putFlush.batches.size() == 1);
   auto& batch = putFlush.batches[0];
 
@@ -2597,10 +2975,13 @@ kj::Promise<void> ActorCache::flushImplUsingSinglePut(PutFlush putFlush) {
   // See the comment in flushImplUsingTxn for why we need to construct our RPC and then wait on
   // reads before actually sending the write. The same exact logic applies here.
   co_await waitForPastReads();
-  co_await request.send().ignoreResult();
+  auto promise = request.send().ignoreResult();
+  KJ_IF_MAYBE(f, onSent) f->get()->fulfill();
+  co_await promise;
 }
 
-kj::Promise<void> ActorCache::flushImplUsingSingleMutedDelete(MutedDeleteFlush mutedFlush) {
+kj::Promise<void> ActorCache::flushImplUsingSingleMutedDelete(
+    MutedDeleteFlush mutedFlush, kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> onSent) {
   KJ_ASSERT(mutedFlush.batches.size() == 1);
   auto& batch = mutedFlush.batches[0];
 
@@ -2622,7 +3003,9 @@ kj::Promise<void> ActorCache::flushImplUsingSingleMutedDelete(MutedDeleteFlush m
   // See the comment in flushImplUsingTxn for why we need to construct our RPC and then wait on
   // reads before actually sending the write. The same exact logic applies here.
   co_await waitForPastReads();
-  co_await request.send().ignoreResult();
+  auto promise = request.send().ignoreResult();
+  KJ_IF_MAYBE(f, onSent) f->get()->fulfill();
+  co_await promise;
 }
 
 kj::Promise<void> ActorCache::flushImplUsingSingleCountedDelete(CountedDeleteFlush countedFlush) {
@@ -2702,9 +3085,54 @@ kj::Promise<void> ActorCache::flushImplAlarmOnly(DirtyAlarm dirty) {
   }
 }
 
+ActorCache::FlushWindow::FlushWindow(size_t maxBatches, size_t maxBytes)
+    : maxBatches(maxBatches), maxBytes(maxBytes) {}
+
+kj::Promise<void> ActorCache::FlushWindow::reserve(size_t bytes) {
+  // Always allow at least one batch in flight, so that a single batch larger than `maxBytes` can
+  // still make progress.
+  while (batchesInFlight > 0 &&
+         (batchesInFlight >= maxBatches || bytesInFlight + bytes > maxBytes)) {
+    KJ_IF_MAYBE(e, error) {
+      kj::throwFatalException(kj::cp(*e));
+    }
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    waiter = kj::mv(paf.fulfiller);
+    co_await paf.promise;
+  }
+
+  KJ_IF_MAYBE(e, error) {
+    kj::throwFatalException(kj::cp(*e));
+  }
+
+  ++batchesInFlight;
+  bytesInFlight += bytes;
+}
+
+kj::Promise<void> ActorCache::FlushWindow::track(kj::Promise<void> promise, size_t bytes) {
+  return promise.then([this, bytes]() {
+    release(bytes);
+  }, [this, bytes](kj::Exception&& e) {
+    // Stop sending any more batches; the transaction is going to fail anyway.
+    if (error == nullptr) error = kj::cp(e);
+    release(bytes);
+    kj::throwFatalException(kj::mv(e));
+  }).eagerlyEvaluate(nullptr);
+}
+
+void ActorCache::FlushWindow::release(size_t bytes) {
+  --batchesInFlight;
+  bytesInFlight -= bytes;
+  KJ_IF_MAYBE(w, waiter) {
+    w->get()->fulfill();
+    waiter = nullptr;
+  }
+}
+
 kj::Promise<void> ActorCache::flushImplUsingTxn(
     PutFlush putFlush, MutedDeleteFlush mutedDeleteFlush,
-    CountedDeleteFlushes countedDeleteFlushes, MaybeAlarmChange maybeAlarmChange) {
+    CountedDeleteFlushes countedDeleteFlushes, MaybeAlarmChange maybeAlarmChange,
+    kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> onSent) {
   auto txnProm = storage.txnRequest(capnp::MessageSize { 4, 0 }).send();
   auto txn = txnProm.getTransaction();
 
@@ -2713,8 +3141,6 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
     kj::Array<RpcDeleteRequest> rpcDeletes;
   };
   auto rpcCountedDeletes = kj::heapArrayBuilder<RpcCountedDelete>(countedDeleteFlushes.size());
-  auto rpcMutedDeletes = kj::heapArrayBuilder<RpcDeleteRequest>(mutedDeleteFlush.batches.size());
-  auto rpcPuts = kj::heapArrayBuilder<RpcPutRequest>(putFlush.batches.size());
 
   for (auto& flush: countedDeleteFlushes) {
     auto entryIt = flush.entries.begin();
@@ -2739,47 +3165,17 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
     KJ_ASSERT(entryIt == flush.entries.end());
   }
 
-  {
-    auto entryIt = mutedDeleteFlush.entries.begin();
-    for (auto& batch: mutedDeleteFlush.batches) {
-      KJ_ASSERT(batch.wordCount < MAX_ACTOR_STORAGE_RPC_WORDS);
-
-      auto request = txn.deleteRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
-      auto listBuilder = request.initKeys(batch.pairCount);
-      for (size_t i = 0; i < batch.pairCount; ++i) {
-        KJ_ASSERT(entryIt != mutedDeleteFlush.entries.end());
-        auto& entry = **(entryIt++);
-        listBuilder.set(i, entry.key.asBytes());
-      }
-      rpcMutedDeletes.add(kj::mv(request));
-    }
-    KJ_ASSERT(entryIt == mutedDeleteFlush.entries.end());
-  }
-
-  {
-    auto entryIt = putFlush.entries.begin();
-    for (auto& batch: putFlush.batches) {
-      KJ_ASSERT(batch.wordCount < MAX_ACTOR_STORAGE_RPC_WORDS);
-
-      auto request = txn.putRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
-      auto listBuilder = request.initEntries(batch.pairCount);
-      for (auto kv : listBuilder) {
-        KJ_ASSERT(entryIt != putFlush.entries.end());
-        auto& entry = **(entryIt++);
-        auto& v = KJ_ASSERT_NONNULL(entry.value);
-        kv.setKey(entry.key.asBytes());
-        kv.setValue(v);
-      }
-      rpcPuts.add(kj::mv(request));
-    }
-    KJ_ASSERT(entryIt == putFlush.entries.end());
-  }
+  // Muted deletes and puts can be numerous, so we build their messages lazily as the flush
+  // window allows (see `FlushWindow`). To do that without losing our snapshot, take references
+  // on the entries now; their keys and values can't change.
+  auto mutedDeleteEntries = KJ_MAP(e, mutedDeleteFlush.entries) { return kj::atomicAddRef(*e); };
+  auto mutedDeleteBatches = mutedDeleteFlush.batches.releaseAsArray();
+  auto putEntries = KJ_MAP(e, putFlush.entries) { return kj::atomicAddRef(*e); };
+  auto putBatches = putFlush.batches.releaseAsArray();
 
   // We're done with the batching instructions, free them before we go async.
   putFlush.entries.clear();
-  putFlush.batches.clear();
   mutedDeleteFlush.entries.clear();
-  mutedDeleteFlush.batches.clear();
   countedDeleteFlushes = nullptr;
 
   // We don't want to write anything until we know that any past reads have completed, because one
@@ -2798,8 +3194,9 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
   // But it is important that we created our put/delete batches prior to waiting on past reads,
   // because if we were to wait before doing so then more new writes might sneak into the flush, and
   // if we were to include those new writes we'd potentially have to wait on past reads again.
-  // Similarly, we have to copy the data into our RPC structs prior to waiting instead of after to
-  // avoid the data changing out from under us while we wait.
+  // Similarly, we have to capture the data prior to waiting instead of after to avoid the data
+  // changing out from under us while we wait -- either by copying it into our RPC structs, or, for
+  // muted deletes and puts, by holding references to the entries themselves.
   co_await waitForPastReads();
 
   // Send all the RPCs. It's important that counted deletes are sent first since they can overlap
@@ -2810,8 +3207,11 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
   // The constant extra 2 promises are those added outside of the rpc batches, currently one
   // to work around a bug in capnp::autoreconnect, and one to actually commit the flush txn
   // A 3rd promise may be added to write the alarm time if necessary.
+  FlushWindow window(lru.options.maxFlushBatchesInFlight, lru.options.maxFlushBytesInFlight);
+  // Must outlive `promises`, which refer to it.
+
   auto promises = kj::heapArrayBuilder<kj::Promise<void>>(
-      rpcPuts.size() + rpcMutedDeletes.size() + rpcCountedDeletes.size()
+      putBatches.size() + mutedDeleteBatches.size() + rpcCountedDeletes.size()
       + 2 + !maybeAlarmChange.is<CleanAlarm>());
 
   auto joinCountedDelete = [](RpcCountedDelete& rpcCountedDelete) -> kj::Promise<void> {
@@ -2849,13 +3249,47 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
     }));
   }
 
-  for (auto& request: rpcMutedDeletes) {
-    promises.add(request.send().ignoreResult());
+  {
+    auto entryIt = mutedDeleteEntries.begin();
+    for (auto& batch: mutedDeleteBatches) {
+      KJ_ASSERT(batch.wordCount < MAX_ACTOR_STORAGE_RPC_WORDS);
+      auto bytes = batch.wordCount * sizeof(capnp::word);
+      co_await window.reserve(bytes);
+
+      auto request = txn.deleteRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
+      auto listBuilder = request.initKeys(batch.pairCount);
+      for (size_t i = 0; i < batch.pairCount; ++i) {
+        KJ_ASSERT(entryIt != mutedDeleteEntries.end());
+        auto& entry = **(entryIt++);
+        listBuilder.set(i, entry.key.asBytes());
+      }
+      promises.add(window.track(request.send().ignoreResult(), bytes));
+    }
+    KJ_ASSERT(entryIt == mutedDeleteEntries.end());
   }
+  mutedDeleteEntries = nullptr;
 
-  for (auto& request: rpcPuts) {
-    promises.add(request.send().ignoreResult());
+  {
+    auto entryIt = putEntries.begin();
+    for (auto& batch: putBatches) {
+      KJ_ASSERT(batch.wordCount < MAX_ACTOR_STORAGE_RPC_WORDS);
+      auto bytes = batch.wordCount * sizeof(capnp::word);
+      co_await window.reserve(bytes);
+
+      auto request = txn.putRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
+      auto listBuilder = request.initEntries(batch.pairCount);
+      for (auto kv : listBuilder) {
+        KJ_ASSERT(entryIt != putEntries.end());
+        auto& entry = **(entryIt++);
+        auto& v = KJ_ASSERT_NONNULL(entry.value);
+        kv.setKey(entry.key.asBytes());
+        kv.setValue(v);
+      }
+      promises.add(window.track(request.send().ignoreResult(), bytes));
+    }
+    KJ_ASSERT(entryIt == putEntries.end());
   }
+  putEntries = nullptr;
 
   KJ_SWITCH_ONEOF(maybeAlarmChange) {
     KJ_CASE_ONEOF(dirty, DirtyAlarm) {
@@ -2902,6 +3336,7 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
   promises.add(txnProm.ignoreResult());
 
   promises.add(txn.commitRequest(capnp::MessageSize { 4, 0 }).send().ignoreResult());
+  KJ_IF_MAYBE(f, onSent) f->get()->fulfill();
 
   co_await kj::joinPromises(promises.finish());
 }
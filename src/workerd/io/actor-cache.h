@@ -19,6 +19,7 @@ using kj::byte;
 using kj::uint;
 class OutputGate;
 class SqliteDatabase;
+class SqliteKv;
 
 struct ActorCacheReadOptions {
   bool noCache = false;
@@ -126,6 +127,11 @@ public:
   // can pass an empty string to list from the first key in the actor, since the empty string is
   // the first possible key.
 
+  virtual kj::Maybe<SqliteKv&> getSqliteKv() { return nullptr; }
+  // If these operations read directly from a SqliteKv, returns it, so that callers consuming a
+  // list immediately can walk the rows in place instead of having list() copy them all into a
+  // GetResultList first. The returned reference must not be held across turns of the event loop.
+
   typedef ActorCacheWriteOptions WriteOptions;
 
   virtual kj::Maybe<kj::Promise<void>> put(
@@ -255,6 +261,26 @@ public:
     virtual void updateAlarmInMemory(kj::Maybe<kj::Date> newAlarmTime) {};
     // Called when the alarm time is dirty when neverFlush is set and ensureFlushScheduled is called.
 
+    enum class ReadOp { GET, LIST };
+
+    virtual void cacheHits(ReadOp op, uint count) {}
+    virtual void cacheMisses(ReadOp op, uint count) {}
+    // Called for each read. A get() counts once per key; a list() counts once, as a hit only if
+    // it was fully satisfied from cache.
+
+    virtual void cacheEvictions(uint count) {}
+    // Reports entries evicted from this cache since the last report, whether due to memory
+    // pressure or staleness. Entries written with `noCache`, which are dropped as soon as they
+    // are flushed, don't count.
+
+    virtual void cacheFlushed(kj::Duration latency) {}
+    // Called when a flush to storage completes successfully.
+
+    virtual void cacheSize(size_t residentBytes, size_t dirtyBytes) {}
+    // Reports the memory currently used by this cache's entries, as counted against the
+    // SharedLru, and how much of that is dirty. Called at the start of each request (see
+    // `evictStale()`).
+
     static Hooks DEFAULT;
   };
 
@@ -398,6 +424,11 @@ private:
     ~Entry() noexcept(false);
     KJ_DISALLOW_COPY_AND_MOVE(Entry);
 
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+    // Entries created through makeEntry() are allocated from the SharedLru's EntryAllocator;
+    // others come from the heap.
+
     kj::Maybe<ActorCache&> cache;
     const Key key;
 
@@ -420,6 +451,10 @@ private:
     // If true, then a past list() operation covered the space between this entry and the following
     // entry, meaning that we know for sure that there are no other keys on disk between them.
 
+    bool recentlyUsed = false;
+    // In the CLEAN or STALE state, set when the entry is accessed, and cleared when the LRU gives
+    // the entry a second chance instead of evicting it. See `SharedLru::cleanList`.
+
     bool noCache = false;
     // If true, then this entry should be evicted from cache immediately when it becomes CLEAN.
     // The entry still needs to reside in cache while DIRTY/FLUSHING since we need to store it
@@ -452,6 +487,8 @@ private:
     }
   };
 
+  class EntryAllocator;
+
   class EntryTableCallbacks {
     // Callbacks for a kj::TreeIndex for a kj::Table<kj::Own<Entry>>.
   public:
@@ -521,6 +558,14 @@ private:
   // List of entries in DIRTY or FLUSHING state. New dirty entries are added to the end. If any
   // FLUSHING entries are present, they always appear strictly before DIRTY entries.
 
+  std::atomic<size_t> residentBytes = 0;
+  // Total size of this cache's entries, i.e. its share of `lru.size`. Atomic because entries may
+  // be destroyed by other threads.
+
+  std::atomic<uint> unreportedEvictions = 0;
+  // Evictions not yet reported to `hooks`. Entries may be evicted by other threads sharing the
+  // LRU, so we only count them there and report them from evictStale().
+
   kj::ExternalMutexGuarded<kj::Table<kj::Own<Entry>, kj::TreeIndex<EntryTableCallbacks>>>
       currentValues;
   // Map of current known values for keys. Searchable by key, including ordered iteration.
@@ -584,12 +629,18 @@ private:
 
 
   kj::ForkedPromise<void> lastFlush = kj::Promise<void>(kj::READY_NOW).fork();
-  // Promise for the completion of the previous flush. We can only execute one flushImpl() at a time
-  // because we can't allow out-of-order writes.
+  // Promise for the completion of the previous flush. By default we can only execute one
+  // flushImpl() at a time because we can't allow out-of-order writes.
   //
-  // TODO(perf): If we could rely on e-order on the ActorStorage API, we could pipeline additional
-  //   writes and not have to worry about this. However, at present, ActorStorage has automatic
-  //   reconnect behavior at the supervisor layer which violates e-order.
+  // If the ActorStorage API preserves e-order, `SharedLru::Options::pipelineFlushes` may be set,
+  // in which case the next flush starts as soon as the previous one has sent its writes (see
+  // `lastFlushSent`). `lastFlush` still resolves only once every flush so far has completed.
+  // At present, the supervisor's ActorStorage has automatic reconnect behavior which violates
+  // e-order, so this is off by default.
+
+  kj::ForkedPromise<void> lastFlushSent = kj::Promise<void>(kj::READY_NOW).fork();
+  // When pipelining flushes, resolves once the previous flush has sent all of its RPCs to storage.
+  // Flushes that can't be pipelined (see canPipelineFlush()) only resolve this on completion.
 
   kj::Maybe<kj::Exception> maybeTerminalException;
   // Did we hit a problem that makes the ActorCache unusable? If so this is the exception that
@@ -663,6 +714,17 @@ private:
   kj::Promise<void> flushImpl(uint retryCount = 0);
   kj::Promise<void> flushImplDeleteAll(uint retryCount = 0);
 
+  kj::Promise<void> flushImplPipelined(kj::Promise<void> previous);
+  // Used instead of flushImpl() when `pipelineFlushes` is enabled. Writes only the entries that
+  // are DIRTY (not ones still being written by an earlier flush), and resolves once both this
+  // flush and `previous` have completed. Falls back to flushImpl() after `previous` if
+  // canPipelineFlush() says no.
+
+  bool canPipelineFlush();
+  // True if the next flush consists of only puts and muted deletes: no deleteAll(), no alarm
+  // change, and no counted deletes. Those all have ordering or bookkeeping requirements that assume
+  // a single flush in flight.
+
   struct FlushBatch {
     size_t pairCount = 0;
     size_t wordCount = 0;
@@ -681,13 +743,51 @@ private:
     kj::Vector<FlushBatch> batches;
   };
   using CountedDeleteFlushes = kj::Array<CountedDeleteFlush>;
-  kj::Promise<void> flushImplUsingSinglePut(PutFlush putFlush);
-  kj::Promise<void> flushImplUsingSingleMutedDelete(MutedDeleteFlush mutedFlush);
+  kj::Promise<void> flushImplUsingSinglePut(
+      PutFlush putFlush, kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> onSent = nullptr);
+  kj::Promise<void> flushImplUsingSingleMutedDelete(
+      MutedDeleteFlush mutedFlush, kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> onSent = nullptr);
   kj::Promise<void> flushImplUsingSingleCountedDelete(CountedDeleteFlush countedFlush);
   kj::Promise<void> flushImplAlarmOnly(DirtyAlarm dirty);
   kj::Promise<void> flushImplUsingTxn(
       PutFlush putFlush, MutedDeleteFlush mutedDeleteFlush,
-      CountedDeleteFlushes countedDeleteFlushes, MaybeAlarmChange maybeAlarmChange);
+      CountedDeleteFlushes countedDeleteFlushes, MaybeAlarmChange maybeAlarmChange,
+      kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> onSent = nullptr);
+  // `onSent`, if given, is fulfilled as soon as all of the flush's RPCs have been sent.
+
+  class FlushWindow {
+    // Limits how many batches of a single flushImplUsingTxn() are in flight at once, by count and
+    // by total message size. At least one batch is always allowed.
+  public:
+    FlushWindow(size_t maxBatches, size_t maxBytes);
+
+    kj::Promise<void> reserve(size_t bytes);
+    // Wait until a batch of the given size can be sent. Throws if a previous batch failed.
+
+    kj::Promise<void> track(kj::Promise<void> promise, size_t bytes);
+    // Wrap the promise for a sent batch so that its space is released when it completes.
+
+  private:
+    size_t maxBatches;
+    size_t maxBytes;
+    size_t batchesInFlight = 0;
+    size_t bytesInFlight = 0;
+    kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> waiter;
+    kj::Maybe<kj::Exception> error;
+
+    void release(size_t bytes);
+  };
+
+  void includeInFlushBatch(kj::Vector<FlushBatch>& batches, size_t words);
+  // Count one more key of `words` size into the last batch, starting a new batch if it's full.
+
+  void markFlushedEntryClean(Lock& lock, Entry& entry);
+  // Called on each FLUSHING entry once its flush has completed. May delete `entry` if it turned
+  // out to be redundant.
+
+  void dropFlushedFromDeleteAll(DeleteAllState& state);
+  // Called when a flush completes while a deleteAll() is pending, in place of
+  // markFlushedEntryClean(), to remove entries that are no longer dirty from `deletedDirty`.
 
   void evictEntry(Lock& lock, Entry& entry);
   // Carefully remove a clean entry from `currentValues`, making sure to update gaps.
@@ -809,6 +909,134 @@ struct ActorCacheSharedLruOptions {
   bool neverFlush = false;
   // If true, don't actually flush anything. This is used in preview sessions, since they keep
   // state strictly in memory.
+
+  size_t sqlitePageCacheLimit = 0;
+  // If non-zero, the byte budget for the SQLite page cache shared by all SQLite-backed actors
+  // (and any other SQLite databases) in the process. See SqliteDatabase::setPageCacheLimit().
+  // Unlike the rest of these options, this is process-wide, so it should be the same for every
+  // SharedLru in the process.
+
+  bool pipelineFlushes = false;
+  // If true, start each flush as soon as the previous flush's writes have been sent, rather than
+  // waiting for it to complete, so that write-heavy actors aren't limited to one flush per storage
+  // round trip. The output gate still waits for every flush a write depends on.
+  //
+  // Only set this if the ActorStorage client delivers calls in e-order and never transparently
+  // reconnects: pipelined flushes are not retried on disconnect, since a retry could land after a
+  // later flush. Flushes involving deleteAll(), alarm changes, or counted deletes are still
+  // serialized.
+
+  size_t maxFlushBatchesInFlight = 16;
+  size_t maxFlushBytesInFlight = 32 * (1ull << 20);
+  // When a flush is split into multiple batches (see `maxKeysPerRpc`), at most this many batches,
+  // totalling at most this many bytes, are sent to storage at a time; the rest are built and sent
+  // as earlier ones complete. This bounds the memory and storage load of very large flushes. (A
+  // single batch is always allowed, even if larger than `maxFlushBytesInFlight`.)
+};
+
+class ActorCache::EntryAllocator {
+  // Slab allocator for the `Entry` objects of all caches sharing one SharedLru. Actors that cache
+  // many small keys would otherwise make a separate heap allocation for every entry, paying
+  // malloc's time and space overhead on each. Instead, entries are carved out of slabs of
+  // `SLOTS_PER_SLAB` slots. Freed slots are reused before any new slab is allocated. One empty
+  // slab is kept around for reuse, so that a cache whose size hovers around a slab boundary
+  // doesn't allocate and free a slab over and over; any other slab is returned to the heap as
+  // soon as its last entry is freed.
+  //
+  // Entries are refcounted and may outlive the allocator. The allocator's bookkeeping is therefore
+  // refcounted too, and each slab holds a reference to it, so that a slab still holding live
+  // entries when the allocator is destroyed is released once those entries are freed.
+  //
+  // Each slot carries a one-pointer header identifying its slab; this is the only per-entry
+  // overhead not counted by `Entry::size()`, and is smaller than the malloc overhead it replaces.
+  // Keys and values are still separate allocations owned by the Entry, since callers hand them to
+  // the cache already allocated.
+
+public:
+  EntryAllocator() = default;
+  ~EntryAllocator() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(EntryAllocator);
+
+  static constexpr uint SLOTS_PER_SLAB = 128;
+
+  class Scope {
+    // While a Scope is live on the current thread, the next `Entry` allocated on it comes from
+    // the given allocator. makeEntry() uses this, since the Entry is constructed by
+    // `kj::atomicRefcounted()` which has no way to pass allocation parameters.
+  public:
+    explicit Scope(const EntryAllocator& allocator);
+    ~Scope() noexcept(false);
+    KJ_DISALLOW_COPY_AND_MOVE(Scope);
+
+  private:
+    const EntryAllocator* previous;
+  };
+
+  static void* allocate(size_t size);
+  static void free(void* ptr);
+  // Implementations of Entry::operator new/delete.
+
+  size_t slabCount() const;
+  // Number of slabs currently allocated, including the empty one kept for reuse. For testing.
+
+private:
+  struct Slab;
+
+  struct Slot {
+    Slab* slab;
+    // The slab this slot belongs to, or null if the slot was allocated directly from the heap.
+
+    union {
+      Slot* nextFree;
+      // While free, the next free slot in the same slab.
+
+      alignas(Entry) kj::byte storage[sizeof(Entry)];
+    };
+  };
+
+  struct SharedState;
+
+  struct Slab {
+    explicit Slab(const SharedState& shared);
+
+    kj::Own<const SharedState> shared;
+    Slot* freeList = nullptr;
+    uint used = 0;
+
+    kj::ListLink<Slab> link;
+    // Present in `State::available` whenever `freeList` is non-null.
+
+    Slot slots[SLOTS_PER_SLAB];
+  };
+
+  struct State {
+    kj::List<Slab, &Slab::link> available;
+    // Slabs with at least one free slot, other than `spare`.
+
+    kj::Maybe<Slab&> spare;
+    // An empty slab kept for the next allocation that finds `available` empty.
+
+    bool keepSpare = true;
+    // Cleared when the allocator is destroyed, after which no more entries will be allocated.
+
+    size_t slabCount = 0;
+    // Including `spare`.
+  };
+
+  struct SharedState: public kj::AtomicRefcounted {
+    kj::MutexGuarded<State> state;
+    // Entries are normally allocated and freed under the isolate lock, so this is rarely
+    // contended, but entries are atomic-refcounted and the last reference may be dropped on any
+    // thread.
+  };
+
+  kj::Own<const SharedState> shared = kj::atomicRefcounted<SharedState>();
+
+  static thread_local const EntryAllocator* current;
+  // Set by Scope.
+
+  Slot* allocateSlot() const;
+  static Slot* slotFor(void* ptr);
 };
 
 class ActorCache::SharedLru {
@@ -823,17 +1051,25 @@ public:
   size_t currentSize() const { return size.load(std::memory_order_relaxed); }
   // Mostly for testing.
 
+  size_t entrySlabCountForTest() const { return entryAllocator.slabCount(); }
+
 private:
   Options options;
 
   kj::MutexGuarded<kj::List<Entry, &Entry::link>> cleanList;
-  // List of clean values, across all caches, ordered from least-recently-used to
-  // most-recently-used. Note that due to the ordering, all STALE entries will appear before all
-  // CLEAN entries.
+  // List of clean values, across all caches, approximately ordered from least-recently-used to
+  // most-recently-used. Accessing an entry only sets its `recentlyUsed` flag rather than moving
+  // it to the end of the list; eviction gives flagged entries a second chance by moving them to
+  // the end when they reach the front (i.e. the CLOCK algorithm). This keeps the per-access
+  // bookkeeping done under the lock down to a single store, and avoids touching the list
+  // neighbors' memory on every cache hit.
 
   mutable std::atomic<size_t> size = 0;
   // Total byte size of everything that is cached, including dirty values that are not in `list`.
 
+  EntryAllocator entryAllocator;
+  // Allocates every Entry created by caches using this LRU.
+
   mutable std::atomic<int64_t> nextStaleCheckNs = 0;
   // TimePoint when we should next evict stale entries. Represented as an int64_t of nanoseconds
   // instead of kj::TimePoint to allow for atomic operations.
@@ -0,0 +1,115 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "actor-sqlite.h"
+#include "io-gate.h"
+#include <kj/test.h>
+
+namespace workerd {
+namespace {
+
+struct ActorSqliteTest {
+  // An ActorSqlite over an in-memory database, whose commit callbacks complete only when the test
+  // fulfills them.
+
+  kj::EventLoop loop;
+  kj::WaitScope ws { loop };
+  OutputGate gate;
+  kj::Own<kj::Directory> dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs { *dir };
+  kj::Vector<kj::Own<kj::PromiseFulfiller<void>>> commits;
+  ActorSqlite actor;
+
+  ActorSqliteTest(ActorSqlite::Options options)
+      : actor(kj::heap<SqliteDatabase>(vfs, kj::Path({"foo.sqlite"}),
+                                       kj::WriteMode::CREATE | kj::WriteMode::MODIFY),
+              gate, [this]() -> kj::Promise<void> {
+                auto paf = kj::newPromiseAndFulfiller<void>();
+                commits.add(kj::mv(paf.fulfiller));
+                return kj::mv(paf.promise);
+              }, ActorSqlite::Hooks::DEFAULT, options) {}
+
+  void put(kj::StringPtr key) {
+    actor.put(kj::str(key), kj::heapArray(key.asBytes()), {});
+  }
+
+  bool has(kj::StringPtr key) {
+    auto result = actor.get(kj::str(key), {});
+    return KJ_ASSERT_NONNULL(result.tryGet<kj::Maybe<ActorCacheOps::Value>>()) != nullptr;
+  }
+};
+
+KJ_TEST("ActorSqlite commits each event's writes separately without group commit") {
+  ActorSqliteTest test({});
+
+  test.put("a");
+  test.ws.poll();
+  KJ_EXPECT(test.commits.size() == 1);
+
+  test.put("b");
+  test.ws.poll();
+  KJ_EXPECT(test.commits.size() == 2);
+
+  auto gateWait = test.gate.wait();
+  test.commits[0]->fulfill();
+  test.commits[1]->fulfill();
+  KJ_EXPECT(gateWait.poll(test.ws));
+}
+
+KJ_TEST("ActorSqlite group commit merges writes made while a commit is in flight") {
+  ActorSqliteTest test({ .groupCommit = true });
+
+  test.put("a");
+  test.ws.poll();
+  KJ_ASSERT(test.commits.size() == 1);
+
+  // Writes from later events wait for the first commit to complete, and share one commit.
+  test.put("b");
+  test.ws.poll();
+  test.put("c");
+  test.ws.poll();
+  KJ_EXPECT(test.commits.size() == 1);
+  KJ_EXPECT(test.actor.isCommitScheduled());
+
+  auto gateWait = test.gate.wait();
+  KJ_EXPECT(!gateWait.poll(test.ws));
+
+  test.commits[0]->fulfill();
+  test.ws.poll();
+  KJ_ASSERT(test.commits.size() == 2);
+  KJ_EXPECT(!test.actor.isCommitScheduled());
+  KJ_EXPECT(!gateWait.poll(test.ws));
+
+  test.commits[1]->fulfill();
+  KJ_EXPECT(gateWait.poll(test.ws));
+  KJ_EXPECT(test.commits.size() == 2);
+
+  KJ_EXPECT(test.has("a"));
+  KJ_EXPECT(test.has("b"));
+  KJ_EXPECT(test.has("c"));
+}
+
+KJ_TEST("ActorSqlite group commit reports a failed commit once and stops further writes") {
+  ActorSqliteTest test({ .groupCommit = true });
+
+  test.put("a");
+  test.ws.poll();
+  KJ_ASSERT(test.commits.size() == 1);
+
+  // This write is waiting for the first commit when it fails.
+  test.put("b");
+  test.ws.poll();
+
+  auto gateWait = test.gate.wait();
+  test.commits[0]->reject(KJ_EXCEPTION(FAILED, "replication failed"));
+  KJ_EXPECT_THROW_MESSAGE("replication failed", gateWait.wait(test.ws));
+
+  // The pending transaction was never committed, and the object is broken from here on.
+  test.ws.poll();
+  KJ_EXPECT(test.commits.size() == 1);
+  KJ_EXPECT_THROW_MESSAGE("replication failed", test.put("c"));
+}
+
+}  // namespace
+}  // namespace workerd
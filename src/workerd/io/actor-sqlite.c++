@@ -11,9 +11,9 @@ namespace workerd {
 
 ActorSqlite::ActorSqlite(kj::Own<SqliteDatabase> dbParam, OutputGate& outputGate,
                          kj::Function<kj::Promise<void>()> commitCallback,
-                         Hooks& hooks)
+                         Hooks& hooks, Options options)
     : db(kj::mv(dbParam)), outputGate(outputGate), commitCallback(kj::mv(commitCallback)),
-      hooks(hooks), kv(*db), commitTasks(*this) {
+      hooks(hooks), options(options), kv(*db), commitTasks(*this) {
   db->onWrite(KJ_BIND_METHOD(*this, onWrite));
 }
 
@@ -135,7 +135,20 @@ void ActorSqlite::onWrite() {
   if (currentTxn.is<NoTxn>()) {
     auto txn = kj::heap<ImplicitTxn>(*this);
 
-    commitTasks.add(outputGate.lockWhile(kj::evalLater(
+    kj::Promise<void> readyToCommit = nullptr;
+    KJ_IF_MAYBE(inFlight, commitCallbackInFlight) {
+      // Group commit: keep accumulating writes into this transaction until the previous commit is
+      // fully done. evalLater() ensures we still wait at least for the current event to finish
+      // its synchronous writes, as in the non-grouped case.
+      // If that commit failed, the failure has already been reported through its own task, and
+      // requireNotBroken() below stops this one.
+      readyToCommit = inFlight->addBranch().catch_([](kj::Exception&&) {})
+          .then([]() { return kj::evalLater([]() {}); });
+    } else {
+      readyToCommit = kj::evalLater([]() {});
+    }
+
+    commitTasks.add(outputGate.lockWhile(readyToCommit.then(
         [this, txn = kj::mv(txn)]() mutable -> kj::Promise<void> {
       // Don't commit if shutdown() has been called.
       requireNotBroken();
@@ -157,7 +170,22 @@ void ActorSqlite::onWrite() {
       // rather than after the callback.
       { auto drop = kj::mv(txn); }
 
-      return commitCallback();
+      if (!options.groupCommit) {
+        return commitCallback();
+      }
+
+      auto forked = commitCallback().fork();
+      auto result = forked.addBranch();
+      uint generation = ++commitCallbackGeneration;
+      // A failure is reported once, through `result`; this branch only does the bookkeeping.
+      commitTasks.add(forked.addBranch().catch_([](kj::Exception&&) {})
+          .then([this, generation]() {
+        if (commitCallbackGeneration == generation) {
+          commitCallbackInFlight = nullptr;
+        }
+      }));
+      commitCallbackInFlight = kj::mv(forked);
+      return result;
     })));
   }
 }
@@ -196,12 +224,12 @@ kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList
     ActorSqlite::get(kj::Array<Key> keys, ReadOptions options) {
   requireNotBroken();
 
-  kj::Vector<KeyValuePair> results;
-  for (auto& key: keys) {
-    kv.get(key, [&](ValuePtr value) {
-      results.add(KeyValuePair { kj::mv(key), kj::heapArray(value) });
-    });
-  }
+  auto keyPtrs = KJ_MAP(key, keys) -> KeyPtr { return key; };
+
+  kj::Vector<KeyValuePair> results(keys.size());
+  kv.getMultiple(keyPtrs, [&](KeyPtr key, ValuePtr value) {
+    results.add(KeyValuePair { kj::str(key), kj::heapArray(value) });
+  });
   std::sort(results.begin(), results.end(),
       [](auto& a, auto& b) { return a.key < b.key; });
   return GetResultList(kj::mv(results));
@@ -252,9 +280,10 @@ kj::Maybe<kj::Promise<void>> ActorSqlite::put(
     kj::Array<KeyValuePair> pairs, WriteOptions options) {
   requireNotBroken();
 
-  for (auto& pair: pairs) {
-    kv.put(pair.key, pair.value);
-  }
+  auto pairPtrs = KJ_MAP(pair, pairs) -> SqliteKv::KeyValuePtrPair {
+    return { pair.key, pair.value };
+  };
+  kv.putMultiple(pairPtrs);
   return nullptr;
 }
 
@@ -268,11 +297,8 @@ kj::OneOf<uint, kj::Promise<uint>> ActorSqlite::delete_(
     kj::Array<Key> keys, WriteOptions options) {
   requireNotBroken();
 
-  uint count = 0;
-  for (auto& key: keys) {
-    count += kv.delete_(key);
-  }
-  return count;
+  auto keyPtrs = KJ_MAP(key, keys) -> KeyPtr { return key; };
+  return kv.deleteMultiple(keyPtrs);
 }
 
 kj::Maybe<kj::Promise<void>> ActorSqlite::setAlarm(
@@ -9,14 +9,29 @@
 
 namespace workerd {
 
+struct ActorSqliteOptions {
+  // Options affecting the ActorSqlite constructor.
+
+  bool groupCommit = false;
+  // If true, an implicit transaction that opens while a previous commit's `commitCallback` is
+  // still in progress stays open until that callback completes, and is only committed then. So,
+  // when many events each make small writes while a commit is in flight, their writes are merged
+  // into a single SQLite commit and a single `commitCallback` call, instead of one of each per
+  // event.
+  //
+  // This doesn't delay anything the output gate wasn't already blocking: the gate stays locked
+  // until every commit has completed either way. It does mean commit callbacks run one at a
+  // time rather than concurrently, which trades a little latency under load for much less
+  // commit overhead, so it's useful when `commitCallback` is slow (e.g. replication).
+};
+
 class ActorSqlite final: public ActorCacheInterface, private kj::TaskSet::ErrorHandler {
   // An implementation of ActorCacheOps that is backed by SqliteKv.
   //
   // TODO(perf): This interface is not designed ideally for wrapping SqliteKv. In particular, we
-  //   end up allocating extra copies of all the results. It would be nicer if we could actually
-  //   parse the V8-serialized values directly from the blob pointers that SQLite spits out.
-  //   However, that probably requires rewriting `DurableObjectStorageOperations`. For now, hooking
-  //   here is easier and not too costly.
+  //   end up allocating extra copies of all the results. `DurableObjectStorage.list()` avoids
+  //   this by using getSqliteKv() to parse the V8-serialized values directly from the blob
+  //   pointers that SQLite spits out, but get() and listIterator() still go through here.
 
 public:
   class Hooks {
@@ -32,9 +47,13 @@ public:
     static Hooks DEFAULT;
   };
 
+  using Options = ActorSqliteOptions;
+  // Pretend `Options` is declared nested here. Due to a C++ quirk, we cannot actually declare it
+  // nested while having default-initialized parameters of this type.
+
   explicit ActorSqlite(kj::Own<SqliteDatabase> dbParam, OutputGate& outputGate,
                        kj::Function<kj::Promise<void>()> commitCallback,
-                       Hooks& hooks = Hooks::DEFAULT);
+                       Hooks& hooks = Hooks::DEFAULT, Options options = {});
   // Constructs ActorSqlite, arranging to honor the output gate, that is, any writes to the
   // database which occur without any `await`s in between will automatically be combined into a
   // single atomic write. This is accomplished using transactions. In addition to ensuring
@@ -49,6 +68,11 @@ public:
 
   kj::Maybe<SqliteDatabase&> getSqliteDatabase() override { return *db; }
 
+  kj::Maybe<SqliteKv&> getSqliteKv() override {
+    requireNotBroken();
+    return kv;
+  }
+
   kj::OneOf<kj::Maybe<Value>, kj::Promise<kj::Maybe<Value>>> get(
       Key key, ReadOptions options) override;
   kj::OneOf<GetResultList, kj::Promise<GetResultList>> get(
@@ -80,6 +104,7 @@ private:
   OutputGate& outputGate;
   kj::Function<kj::Promise<void>()> commitCallback;
   Hooks& hooks;
+  Options options;
   SqliteKv kv;
 
   SqliteDatabase::Statement beginTxn = db->prepare("BEGIN TRANSACTION");
@@ -123,6 +148,7 @@ private:
         Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) override;
     kj::OneOf<GetResultList, kj::Promise<GetResultList>> listReverse(
         Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) override;
+    kj::Maybe<SqliteKv&> getSqliteKv() override { return actorSqlite.getSqliteKv(); }
     kj::Maybe<kj::Promise<void>> put(Key key, Value value, WriteOptions options) override;
     kj::Maybe<kj::Promise<void>> put(kj::Array<KeyValuePair> pairs, WriteOptions options) override;
     kj::OneOf<bool, kj::Promise<bool>> delete_(Key key, WriteOptions options) override;
@@ -153,6 +179,14 @@ private:
 
   kj::TaskSet commitTasks;
 
+  kj::Maybe<kj::ForkedPromise<void>> commitCallbackInFlight;
+  // In group commit mode, the most recent `commitCallback()` promise, if it hasn't completed
+  // yet. The next implicit transaction waits for this before committing.
+
+  uint commitCallbackGeneration = 0;
+  // Incremented on each `commitCallback()` in group commit mode, so that a completed callback
+  // only clears `commitCallbackInFlight` if no later one has replaced it.
+
   void onWrite();
 
   void taskFailed(kj::Exception&& exception) override;
@@ -42,8 +42,7 @@ void HibernationManagerImpl::acceptWebSocket(
   size_t position = 0;
   for (auto tag = tags.begin(); tag < tags.end(); tag++, position++) {
     auto& tagCollection = tagToWs.findOrCreate(*tag, [&tag]() {
-      auto item = kj::heap<TagCollection>(
-          kj::mv(*tag), kj::heap<kj::List<TagListItem, &TagListItem::link>>());
+      auto item = kj::heap<TagCollection>(kj::mv(*tag));
       return decltype(tagToWs)::Entry {
           item->tag,
           kj::mv(item)
@@ -52,14 +51,12 @@ void HibernationManagerImpl::acceptWebSocket(
     // This TagListItem sits in the HibernatableWebSocket's tagItems array.
     auto& tagListItem = refToHibernatable.tagItems[position];
     tagListItem.hibWS = refToHibernatable;
-    tagListItem.tag = tagCollection->tag.asPtr();
 
-    auto& list = tagCollection->list;
-    list->add(tagListItem);
-    // We also give the TagListItem a reference to the list it was added to so the
+    tagCollection->list.add(tagListItem);
+    // We also give the TagListItem a reference to the collection it was added to so the
     // HibernatableWebSocket can quickly remove itself from the list without doing a lookup
     // in `tagToWs`.
-    tagListItem.list = *list.get();
+    tagListItem.collection = *tagCollection;
   }
 
   // Finally, we initiate the readloop for this HibernatableWebSocket.
@@ -81,8 +78,7 @@ kj::Vector<jsg::Ref<api::WebSocket>> HibernationManagerImpl::getWebSockets(
   kj::Vector<jsg::Ref<api::WebSocket>> matches;
   KJ_IF_MAYBE(tag, maybeTag) {
     KJ_IF_MAYBE(item, tagToWs.find(*tag)) {
-      auto& list = *((*item)->list);
-      for (auto& entry: list) {
+      for (auto& entry: (*item)->list) {
         auto& hibWS = KJ_REQUIRE_NONNULL(entry.hibWS);
         matches.add(hibWS.getActiveOrUnhibernate(js));
       }
@@ -96,6 +92,62 @@ kj::Vector<jsg::Ref<api::WebSocket>> HibernationManagerImpl::getWebSockets(
   return kj::mv(matches);
 }
 
+void HibernationManagerImpl::broadcast(
+    jsg::Lock& js,
+    kj::OneOf<kj::Array<kj::byte>, kj::String> message,
+    kj::Maybe<kj::StringPtr> maybeTag,
+    kj::ArrayPtr<jsg::Ref<api::WebSocket>> except) {
+  auto shared = kj::refcounted<api::SharedWebSocketMessage>(kj::mv(message));
+  // All the sends happen at the same time, so they can share a single wait on the output gate.
+  auto outputLock = IoContext::current().waitForOutputLocksIfNecessary()
+      .map([](kj::Promise<void> promise) { return promise.fork(); });
+
+  auto sendTo = [&](HibernatableWebSocket& hibWS) {
+    auto lockBranch = outputLock.map([](kj::ForkedPromise<void>& lock) {
+      return lock.addBranch();
+    });
+    KJ_IF_MAYBE(active, hibWS.activeOrPackage.tryGet<jsg::Ref<api::WebSocket>>()) {
+      for (auto& excluded: except) {
+        if (excluded.get() == active->get()) return;
+      }
+      (*active)->trySendShared(js, *shared, kj::mv(lockBranch));
+    } else if (hibWS.ws != nullptr) {
+      // The application can't hold a reference to a hibernating websocket, so it can't be in
+      // `except`.
+      hibWS.sendWhileHibernating(kj::addRef(*shared), kj::mv(lockBranch));
+    }
+  };
+
+  KJ_IF_MAYBE(tag, maybeTag) {
+    KJ_IF_MAYBE(item, tagToWs.find(*tag)) {
+      for (auto& entry: (*item)->list) {
+        sendTo(KJ_REQUIRE_NONNULL(entry.hibWS));
+      }
+    }
+  } else {
+    for (auto& hibWS : allWs) {
+      sendTo(*hibWS);
+    }
+  }
+}
+
+void HibernationManagerImpl::HibernatableWebSocket::sendWhileHibernating(
+    kj::Own<api::SharedWebSocketMessage> message, kj::Maybe<kj::Promise<void>> outputLock) {
+  auto& native = *KJ_REQUIRE_NONNULL(ws);
+  kj::Promise<void> previous = kj::READY_NOW;
+  KJ_IF_MAYBE(sends, pendingSends) {
+    previous = kj::mv(*sends);
+  }
+  KJ_IF_MAYBE(gate, outputLock) {
+    previous = previous.then([gate = kj::mv(*gate)]() mutable { return kj::mv(gate); });
+  }
+  pendingSends = previous.then([&native, message = kj::mv(message)]() mutable {
+    return message->sendTo(native).attach(kj::mv(message));
+  }).eagerlyEvaluate([](kj::Exception&&) {
+    // A failed send means the peer is gone, which the read loop will notice and report.
+  });
+}
+
 void HibernationManagerImpl::setWebSocketAutoResponse(
     jsg::Ref<api::WebSocketRequestResponsePair> reqResp) {
   autoResponsePair = kj::mv(reqResp);
@@ -142,6 +194,15 @@ inline void HibernationManagerImpl::removeFromAllWs(HibernatableWebSocket& hib)
 
 kj::Promise<void> HibernationManagerImpl::handleSocketTermination(
     HibernatableWebSocket& hib, kj::Maybe<kj::Exception>& maybeError) {
+  if (hib.isDelivering) {
+    // Messages received before the socket went away are still being delivered as a batch. The
+    // close or error event must come after them, as would the next message.
+    return KJ_ASSERT_NONNULL(hib.delivering).addBranch()
+        .then([this, &hib, maybeError = kj::mv(maybeError)]() mutable {
+      return handleSocketTermination(hib, maybeError);
+    });
+  }
+
   kj::Maybe<kj::Promise<void>> event;
   KJ_IF_MAYBE(error, maybeError) {
 
@@ -206,8 +267,13 @@ kj::Promise<void> HibernationManagerImpl::readLoop(HibernatableWebSocket& hib) {
               // If the actor is not hibernated/If the WebSocket is active, we need to update
               // autoResponseTimestamp on the active websocket.
               (*active)->setAutoResponseTimestamp(hib.autoResponseTimestamp);
+              ws.send((*reqResp)->getResponse().asArray());
+            } else {
+              // Messages broadcast while hibernating may still be being written, so the response
+              // has to wait its turn behind them.
+              hib.sendWhileHibernating(kj::refcounted<api::SharedWebSocketMessage>(
+                  kj::str((*reqResp)->getResponse())), nullptr);
             }
-            ws.send((*reqResp)->getResponse().asArray());
             skip = true;
             // If we've sent an auto response message, we should not unhibernate or deliver the
             // received message to the actor
@@ -221,6 +287,41 @@ kj::Promise<void> HibernationManagerImpl::readLoop(HibernatableWebSocket& hib) {
       continue;
     }
 
+    if (batchedDelivery && !message.is<kj::WebSocket::Close>()) {
+      KJ_SWITCH_ONEOF(message) {
+        KJ_CASE_ONEOF(text, kj::String) {
+          hib.inbox.bytes += text.size();
+          hib.inbox.messages.add(kj::mv(text));
+        }
+        KJ_CASE_ONEOF(data, kj::Array<kj::byte>) {
+          hib.inbox.bytes += data.size();
+          hib.inbox.messages.add(kj::mv(data));
+        }
+        KJ_CASE_ONEOF_DEFAULT { KJ_UNREACHABLE; }
+      }
+
+      if (!hib.isDelivering) {
+        hib.isDelivering = true;
+        hib.delivering = deliverInbox(hib).fork();
+      } else if (hib.inbox.messages.size() >= MAX_BATCH_MESSAGES ||
+                 hib.inbox.bytes >= MAX_BATCH_BYTES) {
+        // Apply backpressure to the client until the backlog has been delivered.
+        co_await KJ_ASSERT_NONNULL(hib.delivering).addBranch();
+      }
+      KJ_IF_MAYBE(e, hib.deliveryError) {
+        kj::throwFatalException(kj::mv(*e));
+      }
+      continue;
+    }
+
+    if (hib.isDelivering) {
+      // Events must be delivered in order, so let the queued messages go first.
+      co_await KJ_ASSERT_NONNULL(hib.delivering).addBranch();
+    }
+    KJ_IF_MAYBE(e, hib.deliveryError) {
+      kj::throwFatalException(kj::mv(*e));
+    }
+
     auto websocketId = randomUUID(nullptr);
     webSocketsForEventHandler.insert(kj::str(websocketId), &hib);
 
@@ -254,4 +355,24 @@ kj::Promise<void> HibernationManagerImpl::readLoop(HibernatableWebSocket& hib) {
   }
 }
 
+kj::Promise<void> HibernationManagerImpl::deliverInbox(HibernatableWebSocket& hib) {
+  KJ_DEFER(hib.isDelivering = false);
+  try {
+    while (hib.inbox.messages.size() > 0) {
+      auto messages = hib.inbox.messages.releaseAsArray();
+      hib.inbox.bytes = 0;
+
+      auto websocketId = randomUUID(nullptr);
+      webSocketsForEventHandler.insert(kj::str(websocketId), &hib);
+      auto workerInterface = loopback->getWorker(IoChannelFactory::SubrequestMetadata{});
+      co_await workerInterface->customEvent(
+          kj::heap<api::HibernatableWebSocketCustomEventImpl>(hibernationEventType, readLoopTasks,
+              api::HibernatableSocketParams(kj::mv(messages), kj::mv(websocketId)), *this));
+    }
+  } catch (...) {
+    // The read loop rethrows this once it next wakes up.
+    hib.deliveryError = kj::getCaughtExceptionAsKj();
+  }
+}
+
 }; // namespace workerd
@@ -36,6 +36,16 @@ public:
   // Gets a collection of websockets associated with the given tag. Any hibernating websockets will
   // be woken up. If no tag is provided, we return all accepted websockets.
 
+  void broadcast(
+      jsg::Lock& js,
+      kj::OneOf<kj::Array<kj::byte>, kj::String> message,
+      kj::Maybe<kj::StringPtr> tag,
+      kj::ArrayPtr<jsg::Ref<api::WebSocket>> except) override;
+  // Sends `message` to every websocket associated with the given tag (or all of them, if there's
+  // no tag), other than those in `except`. The payload is shared rather than copied per websocket,
+  // and hibernating websockets stay hibernated: the message is written straight to their
+  // kj::WebSocket.
+
   void hibernateWebSockets(Worker::Lock& lock) override;
   // Hibernates all the websockets held by the HibernationManager.
   // This converts our activeOrPackage from an api::WebSocket to a HibernationPackage.
@@ -45,19 +55,25 @@ public:
   kj::Maybe<jsg::Ref<api::WebSocketRequestResponsePair>> getWebSocketAutoResponse() override;
   void setTimerChannel(TimerChannel& timerChannel) override;
 
+  void setBatchedDelivery(bool enabled) { batchedDelivery = enabled; }
+  // Called by each event with whether the Worker exports a webSocketMessages() handler. When it
+  // does, text and binary messages that arrive while an event is running are queued and
+  // delivered together in the next one, rather than one event per message.
+
   friend class api::HibernatableWebSocketEvent;
 
 private:
   class HibernatableWebSocket;
+  struct TagCollection;
   struct TagListItem {
     // Each HibernatableWebSocket can have multiple tags, so we want to store a reference
     // in our kj::List.
     kj::Maybe<HibernatableWebSocket&> hibWS;
     kj::ListLink<TagListItem> link;
-    kj::StringPtr tag;
-    kj::Maybe<kj::List<TagListItem, &TagListItem::link>&> list;
-    // The List that refers to this TagListItem.
-    // If `list` is null, we've already removed this item from the list.
+    kj::Maybe<TagCollection&> collection;
+    // The collection whose list refers to this TagListItem. This is the only record of the tag
+    // itself: the tag string is interned in the collection, so we don't keep a copy per websocket.
+    // If `collection` is null, we've already removed this item from the list.
   };
 
   class HibernatableWebSocket {
@@ -86,17 +102,19 @@ private:
       // This removal is fast because we have direct access to each kj::List, as well as direct
       // access to each TagListItem we want to remove.
       for (auto& item: tagItems) {
-        KJ_IF_MAYBE(list, item.list) {
-          // The list reference is non-null, so we still have a valid reference to this
+        KJ_IF_MAYBE(collection, item.collection) {
+          // The collection reference is non-null, so we still have a valid reference to this
           // TagListItem in the list, which we will now remove.
-          list->remove(item);
-          if (list->empty()) {
-            // Remove the bucket in tagToWs if the tag has no more websockets.
-            manager.tagToWs.erase(kj::mv(item.tag));
+          collection->list.remove(item);
+          if (collection->list.empty()) {
+            // Remove the bucket in tagToWs if the tag has no more websockets. This destroys
+            // the collection, and with it the interned tag.
+            kj::StringPtr tag = collection->tag;
+            manager.tagToWs.erase(tag);
           }
         }
         item.hibWS = nullptr;
-        item.list = nullptr;
+        item.collection = nullptr;
       }
     }
 
@@ -110,6 +128,13 @@ private:
         )->setAutoResponseTimestamp(autoResponseTimestamp);
         // Now that we unhibernated the WebSocket, we can set the last received autoResponse timestamp
         // that was stored in the corresponding HibernatableWebSocket.
+
+        KJ_IF_MAYBE(sends, pendingSends) {
+          // Broadcasts sent while we were hibernating must go out before anything the
+          // api::WebSocket sends.
+          activeOrPackage.get<jsg::Ref<api::WebSocket>>()->sendAfter(kj::mv(*sends));
+          pendingSends = nullptr;
+        }
       }
       return activeOrPackage.get<jsg::Ref<api::WebSocket>>().addRef();
     }
@@ -145,6 +170,30 @@ private:
     kj::Maybe<kj::Date> autoResponseTimestamp;
     // Stores the last received autoResponseRequest timestamp.
 
+    void sendWhileHibernating(
+        kj::Own<api::SharedWebSocketMessage> message, kj::Maybe<kj::Promise<void>> outputLock);
+    // Writes a broadcast message or auto-response directly to `ws`, after any previous ones.
+
+    struct Inbox {
+      kj::Vector<kj::OneOf<kj::String, kj::Array<kj::byte>>> messages;
+      size_t bytes = 0;
+    };
+    Inbox inbox;
+    // Messages waiting to be delivered as a batch by deliverInbox().
+
+    bool isDelivering = false;
+    kj::Maybe<kj::ForkedPromise<void>> delivering;
+    // The most recent deliverInbox() task. It's only running while `isDelivering` is true.
+
+    kj::Maybe<kj::Exception> deliveryError;
+    // Set if deliverInbox() failed, in which case the read loop stops.
+
+    kj::Maybe<kj::Promise<void>> pendingSends;
+    // Messages sent while hibernating (see sendWhileHibernating()) that may not have been
+    // written yet. A kj::WebSocket only allows one send at a time, so each waits for the previous
+    // one, and the api::WebSocket waits for all of them when we wake up. Declared last so that
+    // it's destroyed before `ws`.
+
     friend HibernationManagerImpl;
   };
 
@@ -164,14 +213,16 @@ private:
   kj::Promise<void> readLoop(HibernatableWebSocket& hib);
   // Like the api::WebSocket readLoop(), but we dispatch different types of events.
 
+  kj::Promise<void> deliverInbox(HibernatableWebSocket& hib);
+  // Dispatches the messages in `hib.inbox` in batches until it's empty.
+
   struct TagCollection {
     // This struct is held by the `tagToWs` hashmap. The key is a StringPtr to tag, and the value
-    // is this struct itself.
+    // is this struct itself. Since the struct is boxed, the list can live inline.
     kj::String tag;
-    kj::Own<kj::List<TagListItem, &TagListItem::link>> list;
+    kj::List<TagListItem, &TagListItem::link> list;
 
-    TagCollection(kj::String tag, decltype(list) list): tag(kj::mv(tag)), list(kj::mv(list)) {}
-    TagCollection(TagCollection&& other) = default;
+    explicit TagCollection(kj::String tag): tag(kj::mv(tag)) {}
   };
 
   kj::HashMap<kj::StringPtr, kj::Own<TagCollection>> tagToWs;
@@ -198,6 +249,13 @@ private:
   // It is possible that both of them will be added to the map (i.e. their `receive()`
   // will throw) before the first event is dispatched and manages to obtain its associated websocket.
 
+  bool batchedDelivery = false;
+
+  static constexpr size_t MAX_BATCH_MESSAGES = 256;
+  static constexpr size_t MAX_BATCH_BYTES = 1024 * 1024;
+  // Once this much is waiting in a websocket's inbox, we stop reading from it until the inbox has
+  // been delivered.
+
   const size_t ACTIVE_CONNECTION_LIMIT = 1024 * 32;
   // The maximum number of Hibernatable WebSocket connections a single HibernationManagerImpl
   // instance can manage.
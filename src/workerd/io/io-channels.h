@@ -5,6 +5,7 @@
 #pragma once
 
 #include <kj/string.h>
+#include <kj/filesystem.h>
 #include <workerd/io/trace.h>
 
 namespace kj { class HttpClient; }
@@ -176,6 +177,25 @@ public:
   // `buildMessage` will be invoked to fill in the pointer's content. The callback is always
   // executed immediately, before `writeLogfwdr()` returns a promise.
 
+  virtual kj::Promise<void> writeLogfwdrBatch(uint channel, uint count,
+      kj::FunctionParam<void(uint, capnp::AnyPointer::Builder)> buildMessage) {
+    // Like writeLogfwdr(), but writes `count` messages at once, calling `buildMessage` with each
+    // index in order. Implementations that can send several messages in one go should override
+    // this; by default it writes them one by one.
+    auto promises = kj::heapArrayBuilder<kj::Promise<void>>(count);
+    for (auto i: kj::zeroTo(count)) {
+      promises.add(writeLogfwdr(channel, [&](capnp::AnyPointer::Builder ptr) {
+        buildMessage(i, ptr);
+      }));
+    }
+    return kj::joinPromises(promises.finish());
+  }
+
+  virtual kj::Maybe<kj::Own<const kj::File>> newSpoolFile() { return nullptr; }
+  // Creates an anonymous temporary file in which a large body can be spooled rather than held in
+  // memory, or returns null if this Worker has nowhere to spool to, in which case the body is
+  // buffered in memory as usual.
+
   class ActorChannel {
     // Stub for a remote actor. Allows sending requests to the actor. Multiple requests may be
     // sent, and they will be delivered in the order they are sent (e-order). This is an I/O type
@@ -27,13 +27,49 @@ void IoContext::DeleteQueue::scheduleDeletion(OwnedObject* object) const {
     kj::AllowAsyncDestructorsScope scope;
     OwnedObjectList::unlink(*object);
   } else {
-    auto lock = crossThreadDeleteQueue.lockExclusive();
+    // Objects tend to be dropped in bursts (e.g. by GC), so rather than taking the target queue's
+    // lock for each one, collect them and publish them together.
+    auto& batches = getPendingBatches();
+    PendingBatch* batch = nullptr;
+    for (auto& b: batches) {
+      if (b.queue.get() == this) {
+        batch = &b;
+        break;
+      }
+    }
+    if (batch == nullptr) {
+      batch = &batches.add(PendingBatch { kj::atomicAddRef(*this), {} });
+    }
+    batch->objects.add(object);
+
+    if (batch->objects.size() >= MAX_PENDING_DELETIONS || threadLocalRequest == nullptr) {
+      // Outside of an IoContext there's no scope exit to flush at, so publish right away.
+      flushPendingDeletions();
+    }
+  }
+}
+
+void IoContext::DeleteQueue::flushPendingDeletions() {
+  auto& batches = getPendingBatches();
+  if (batches.empty()) return;
+
+  auto toPublish = kj::mv(batches);
+  batches = kj::Vector<PendingBatch>();
+  for (auto& batch: toPublish) {
+    auto lock = batch.queue->crossThreadDeleteQueue.lockExclusive();
     KJ_IF_MAYBE(state, *lock) {
-      state->queue.add(object);
+      for (auto object: batch.objects) {
+        state->queue.push(object);
+      }
     }
   }
 }
 
+kj::Vector<IoContext::DeleteQueue::PendingBatch>& IoContext::DeleteQueue::getPendingBatches() {
+  static thread_local kj::Vector<PendingBatch> batches;
+  return batches;
+}
+
 class IoContext::TimeoutManagerImpl final: public TimeoutManager {
 public:
   class TimeoutState;
@@ -102,11 +138,19 @@ private:
 
   kj::Promise<void> timerTask = nullptr;
   // Promise that is waiting for the closest timeout, and will fulfill its fulfiller. We only ever
-  // actually wait on the next timeout in `timeoutTasks`, so that we can't fulfill timer callbacks
-  // out-of-order. This task gets replaced each time the lead timeout changes.
+  // fulfill the first timeout in `timeoutTimes`, so that we can't fulfill timer callbacks
+  // out-of-order.
 
-  void resetTimerTask(TimerChannel& timerChannel);
+  kj::Maybe<kj::Date> timerTaskTime;
+  // The time `timerTask` is waiting for, or null if it isn't waiting. This may be earlier than the
+  // lead timeout: rather than re-arming the timer every time the lead timeout is cleared (which,
+  // for code that sets and clears timeouts in a loop, is every time), we let it fire early and
+  // then wait again for whatever leads at that point.
+
+  void resetTimerTask(IoContext& context);
   // Must be called any time timeoutTimes.begin() changes.
+
+  kj::Promise<void> waitForLeadTimeout(IoContext& context, kj::Date when);
 };
 
 class IoContext::TimeoutManagerImpl::TimeoutState {
@@ -137,7 +181,8 @@ ThreadContext::HeaderIdBundle::HeaderIdBundle(kj::HttpHeaderTable::Builder& buil
       cfBlobMetadataSize(builder.add("CF-R2-Metadata-Size")),
       cfBlobRequest(builder.add("CF-R2-Request")),
       authorization(builder.add("Authorization")),
-      secWebSocketProtocol(builder.add("Sec-WebSocket-Protocol")) {}
+      secWebSocketProtocol(builder.add("Sec-WebSocket-Protocol")),
+      cfConnectionPool(builder.add("CF-Connection-Pool")) {}
 
 ThreadContext::ThreadContext(
     kj::Timer& timer, kj::EntropySource& entropySource,
@@ -727,12 +772,12 @@ void IoContext::TimeoutManagerImpl::setTimeoutImpl(IoContext& context, Iterator
     if (context.selfRef->maybeContext != nullptr) {
       bool isNext = timeoutTimes.begin()->key == timeoutTimesKey;
       timeoutTimes.erase(timeoutTimesKey);
-      if (isNext) resetTimerTask(context.getIoChannelFactory().getTimer());
+      if (isNext) resetTimerTask(context);
     }
   });
 
   if (timeoutTimes.begin()->key == timeoutTimesKey) {
-    resetTimerTask(context.getIoChannelFactory().getTimer());
+    resetTimerTask(context);
   }
   promise = promise.attach(kj::mv(deferredTimeoutTimeRemoval));
 
@@ -749,24 +794,45 @@ void IoContext::TimeoutManagerImpl::setTimeoutImpl(IoContext& context, Iterator
   state.maybePromise = promise.eagerlyEvaluate(nullptr);
 }
 
-void IoContext::TimeoutManagerImpl::resetTimerTask(TimerChannel& timerChannel) {
+void IoContext::TimeoutManagerImpl::resetTimerTask(IoContext& context) {
   if (timeoutTimes.size() == 0) {
-    // Not waiting for any timer, clear the existing timer task.
-    timerTask = nullptr;
-  } else {
-    // Wait for the first timer.
-    auto& entry = *timeoutTimes.begin();
-    timerTask = timerChannel.atTime(entry.key.when)
-        .then([this, key = entry.key]() {
-      auto& newEntry = *timeoutTimes.begin();
-      KJ_ASSERT(newEntry.key == key,
-          "front of timeoutTimes changed without calling resetTimerTask(), we probably missed "
-          "a timeout!");
-      newEntry.value->fulfill();
-    }).eagerlyEvaluate([](kj::Exception&& e) {
-      KJ_LOG(ERROR, e);
-    });
+    // Nothing to wait for. If the timer is armed, we leave it be: it's cheaper to let it fire
+    // and find nothing to do than to cancel it, since the next timeout will often be set right
+    // away for a later time.
+    return;
   }
+
+  auto when = timeoutTimes.begin()->key.when;
+  KJ_IF_MAYBE(armed, timerTaskTime) {
+    if (*armed <= when) {
+      // The timer will fire no later than the lead timeout, and wait again from there.
+      return;
+    }
+  }
+
+  timerTask = waitForLeadTimeout(context, when).eagerlyEvaluate([](kj::Exception&& e) {
+    KJ_LOG(ERROR, e);
+  });
+}
+
+kj::Promise<void> IoContext::TimeoutManagerImpl::waitForLeadTimeout(
+    IoContext& context, kj::Date when) {
+  timerTaskTime = when;
+  return context.atTime(when).then([this, &context, when]() -> kj::Promise<void> {
+    timerTaskTime = nullptr;
+    if (timeoutTimes.size() == 0) return kj::READY_NOW;
+
+    auto& entry = *timeoutTimes.begin();
+    if (entry.key.when > when) {
+      // The timeout we were waiting for was cleared, and a later one leads now.
+      return waitForLeadTimeout(context, entry.key.when);
+    }
+
+    // Only the lead timeout is fulfilled. Once it completes, removing it from `timeoutTimes`
+    // calls resetTimerTask() for the next one.
+    entry.value->fulfill();
+    return kj::READY_NOW;
+  });
 }
 
 void IoContext::TimeoutManagerImpl::clearTimeout(
@@ -778,7 +844,15 @@ void IoContext::TimeoutManagerImpl::clearTimeout(
   }
 
   // Cancel the timeout.
-  timeout->second.cancel();
+  auto& state = timeout->second;
+  state.cancel();
+  if (!state.isRunning) {
+    // Nothing refers to the state anymore now that its promise is gone, so drop it right away.
+    // Otherwise code that sets and clears timeouts in a loop would grow `timeouts` for the rest
+    // of the IoContext's life. (A running timeout, i.e. one that cleared itself, is erased once
+    // its callback returns.)
+    timeouts.erase(timeout);
+  }
 }
 
 TimeoutId IoContext::setTimeoutImpl(
@@ -1071,6 +1145,10 @@ public:
 
   ~ThreadScope() {
     threadLocalRequest = previousRequest;
+    if (previousRequest == nullptr) {
+      // Leaving the outermost context: hand off whatever this thread dropped for other contexts.
+      DeleteQueue::flushPendingDeletions();
+    }
   }
 
 private:
@@ -1103,13 +1181,13 @@ public:
 
     {
       // Handle any pending deletions that arrived while the worker was processing a different
-      // request.
-      auto lock = context.deleteQueue->crossThreadDeleteQueue.lockExclusive();
-      auto& state = KJ_ASSERT_NONNULL(*lock);
-      for (auto& object: state.queue) {
+      // request. We only hold the lock long enough to swap out the batch, so other threads aren't
+      // blocked behind the destructors.
+      auto batch = KJ_ASSERT_NONNULL(*context.deleteQueue->crossThreadDeleteQueue.lockExclusive())
+          .queue.pop();
+      for (auto object: batch.asArrayPtr()) {
         OwnedObjectList::unlink(*object);
       }
-      state.queue.clear();
     }
   }
   ~Scope() {
@@ -1406,6 +1484,12 @@ void IoContext::writeLogfwdr(uint channel,
       .attach(registerPendingEvent()));
 }
 
+void IoContext::writeLogfwdrBatch(uint channel, uint count,
+    kj::FunctionParam<void(uint, capnp::AnyPointer::Builder)> buildMessage) {
+  addWaitUntil(getIoChannelFactory().writeLogfwdrBatch(channel, count, kj::mv(buildMessage))
+      .attach(registerPendingEvent()));
+}
+
 void IoContext::requireCurrentOrThrowJs() {
   JSG_REQUIRE(isCurrent(),
       Error,
@@ -19,6 +19,7 @@
 #include <capnp/dynamic.h>
 #include <workerd/io/limit-enforcer.h>
 #include <workerd/io/io-channels.h>
+#include <workerd/util/batch-queue.h>
 
 namespace capnp { class HttpOverCapnpFactory; }
 
@@ -62,6 +63,7 @@ public:
     const kj::HttpHeaderId cfBlobRequest;         // used by R2 binding implementation
     const kj::HttpHeaderId authorization;         // used by R2 binding implementation
     const kj::HttpHeaderId secWebSocketProtocol;
+    const kj::HttpHeaderId cfConnectionPool;      // used by sockets API implementation
   };
 
   ThreadContext(
@@ -849,6 +851,12 @@ public:
   }
 
   void writeLogfwdr(uint channel, kj::FunctionParam<void(capnp::AnyPointer::Builder)> buildMessage);
+  void writeLogfwdrBatch(uint channel, uint count,
+      kj::FunctionParam<void(uint, capnp::AnyPointer::Builder)> buildMessage);
+
+  kj::Maybe<kj::Own<const kj::File>> newSpoolFile() {
+    return getIoChannelFactory().newSpoolFile();
+  }
 
   v8::Local<v8::Object> getPromiseContextTag(jsg::Lock& js);
 
@@ -917,12 +925,19 @@ private:
 
   public:
     DeleteQueue()
-        : crossThreadDeleteQueue(State { kj::Vector<OwnedObject*>() }) {}
+        : crossThreadDeleteQueue(State { BatchQueue<OwnedObject*>(
+              INITIAL_BATCH_CAPACITY, MAX_RETAINED_BATCH_CAPACITY) }) {}
 
     void scheduleDeletion(OwnedObject* object) const;
+    // Deletes `object` now if this queue's IoContext is current, otherwise adds it to this
+    // thread's pending batch for the queue.
+
+    static void flushPendingDeletions();
+    // Publishes this thread's pending batches, taking each target queue's lock once. Called
+    // whenever the thread leaves an IoContext, and from scheduleDeletion() if a batch grows large.
 
     struct State {
-      kj::Vector<OwnedObject*> queue;
+      BatchQueue<OwnedObject*> queue;
     };
 
     kj::MutexGuarded<kj::Maybe<State>> crossThreadDeleteQueue;
@@ -930,9 +945,27 @@ private:
     // whenever the IoContext gets around to it. The maybe is changed to nullptr when the
     // IoContext goes away, at which point all OwnedObjects have already been deleted so
     // cross-thread deletions can just be ignored.
+    //
+    // The IoContext drains this each time it is entered, by popping the batch under the lock and
+    // then deleting the objects after releasing it.
 
     template <typename T> IoOwn<T> addObject(kj::Own<T> obj, OwnedObjectList& ownedObjects);
     // Implements the corresponding methods of IoContext and ActorContext.
+
+  private:
+    static constexpr uint INITIAL_BATCH_CAPACITY = 16;
+    static constexpr uint MAX_RETAINED_BATCH_CAPACITY = 1024;
+    static constexpr size_t MAX_PENDING_DELETIONS = 1024;
+
+    struct PendingBatch {
+      kj::Own<const DeleteQueue> queue;
+      kj::Vector<OwnedObject*> objects;
+    };
+
+    static kj::Vector<PendingBatch>& getPendingBatches();
+    // This thread's deletions for other threads' IoContexts, not yet published. The batch holds a
+    // reference to its queue, so the pointers can be published however late: if the IoContext has
+    // gone away in the meantime, they are ignored just like any other late deletion.
   };
 
   class DeleteQueuePtr: public kj::Own<DeleteQueue> {
@@ -1156,6 +1189,9 @@ kj::PromiseForResult<Func, Worker::Lock&> IoContext::run(
     Func&& func, kj::Maybe<InputGate::Lock> inputLock) {
   kj::Promise<Worker::AsyncLock> asyncLockPromise = nullptr;
   KJ_IF_MAYBE(a, actor) {
+    if (inputLock == nullptr) {
+      inputLock = a->getInputGate().tryLock();
+    }
     if (inputLock == nullptr) {
       return a->getInputGate().wait()
           .then([this,func=kj::fwd<Func>(func)](InputGate::Lock&& inputLock) mutable {
@@ -41,6 +41,38 @@ KJ_TEST("InputGate basics") {
   KJ_EXPECT(!gate.onBroken().poll(ws));
 }
 
+KJ_TEST("InputGate tryLock") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  InputGate gate;
+
+  {
+    auto lock = KJ_ASSERT_NONNULL(gate.tryLock());
+    KJ_EXPECT(lock.isFor(gate));
+    KJ_EXPECT(gate.tryLock() == nullptr);
+
+    auto promise = gate.wait();
+    KJ_EXPECT(!promise.poll(ws));
+    { auto drop = kj::mv(lock); }
+
+    // The waiter got the lock, so tryLock() still can't.
+    KJ_ASSERT(promise.poll(ws));
+    KJ_EXPECT(gate.tryLock() == nullptr);
+    promise.wait(ws);
+  }
+
+  KJ_EXPECT(gate.tryLock() != nullptr);
+
+  // A broken gate never hands out locks.
+  {
+    auto cs = KJ_ASSERT_NONNULL(gate.tryLock()).startCriticalSection();
+    cs->wait().wait(ws);
+    cs->failed(KJ_EXCEPTION(FAILED, "critical section failed"));
+  }
+  KJ_EXPECT(gate.tryLock() == nullptr);
+}
+
 KJ_TEST("InputGate critical section") {
   kj::EventLoop loop;
   kj::WaitScope ws(loop);
@@ -404,6 +436,30 @@ KJ_TEST("OutputGate basics") {
   KJ_EXPECT(!gate.onBroken().poll(ws));
 }
 
+KJ_TEST("OutputGate uncontended") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  OutputGate gate;
+
+  for (auto i KJ_UNUSED: kj::zeroTo(3)) {
+    auto blocker = gate.lockWhile(kj::Promise<void>(kj::READY_NOW));
+    auto promise = gate.wait();
+    blocker.wait(ws);
+    promise.wait(ws);
+
+    // With no locks outstanding, waiting completes immediately.
+    KJ_EXPECT(gate.wait().poll(ws));
+  }
+
+  // Once broken, waits fail even with no locks outstanding.
+  gate.lockWhile(kj::Promise<void>(KJ_EXCEPTION(FAILED, "write failed")))
+      .then([]() { KJ_FAIL_EXPECT("should have failed"); }, [](kj::Exception&&) {})
+      .wait(ws);
+  KJ_EXPECT(gate.isBroken());
+  KJ_EXPECT_THROW_MESSAGE("write failed", gate.wait().wait(ws));
+}
+
 KJ_TEST("OutputGate out-of-order") {
   kj::EventLoop loop;
   kj::WaitScope ws(loop);
@@ -54,6 +54,14 @@ kj::Promise<InputGate::Lock> InputGate::wait() {
   }
 }
 
+kj::Maybe<InputGate::Lock> InputGate::tryLock() {
+  if (lockCount == 0 && !brokenState.is<kj::Exception>()) {
+    return Lock(*this);
+  } else {
+    return nullptr;
+  }
+}
+
 kj::Promise<void> InputGate::onBroken() {
   KJ_IF_MAYBE(e, brokenState.tryGet<kj::Exception>()) {
     return kj::cp(*e);
@@ -307,12 +315,21 @@ OutputGate::Hooks OutputGate::Hooks::DEFAULT;
 
 kj::Own<kj::PromiseFulfiller<void>> OutputGate::lock() {
   auto paf = kj::newPromiseAndFulfiller<void>();
-  auto joined = kj::joinPromises(kj::arr(pastLocksPromise.addBranch(), kj::mv(paf.promise)));
-  pastLocksPromise = joined.fork();
+  if (activeLocks++ == 0 && !isBroken()) {
+    // All past locks have completed successfully, so there's nothing to join with.
+    pastLocksPromise = paf.promise.fork();
+  } else {
+    auto joined = kj::joinPromises(kj::arr(pastLocksPromise.addBranch(), kj::mv(paf.promise)));
+    pastLocksPromise = joined.fork();
+  }
   return kj::mv(paf.fulfiller);
 }
 
 kj::Promise<void> OutputGate::wait() {
+  if (activeLocks == 0 && !isBroken()) {
+    return kj::READY_NOW;
+  }
+
   hooks.outputGateWaiterAdded();
   return pastLocksPromise.addBranch().attach(kj::defer([this]() {
     hooks.outputGateWaiterRemoved();
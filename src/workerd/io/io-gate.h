@@ -101,6 +101,11 @@ public:
   kj::Promise<Lock> wait();
   // Wait until there are no `Lock`s, then create a new one and return it.
 
+  kj::Maybe<Lock> tryLock();
+  // If there are no `Lock`s and the gate isn't broken, creates a new one and returns it, just as
+  // `wait()` would have done immediately. Otherwise returns null, and the caller should use
+  // `wait()`. This avoids allocating a promise in the common uncontended case.
+
   kj::Promise<void> onBroken();
   // Rejects if and when calls to `wait()` become broken due to a failed critical section. The
   // actor should be shut down in this case. This promise never resolves, only rejects.
@@ -254,6 +259,9 @@ public:
   kj::Promise<void> wait();
   // Wait until all preceding locks are released. The wait will not be affected by any future
   // call to `lockWhile()`.
+  //
+  // If no locks are outstanding, this returns an already-resolved promise without counting as a
+  // waiter in the hooks.
 
   kj::Promise<void> onBroken();
   // Rejects if and when calls to `wait()` become broken due to a failed lockWhile(). The actor
@@ -268,6 +276,11 @@ private:
 
   kj::ForkedPromise<void> pastLocksPromise;
 
+  uint activeLocks = 0;
+  // Number of `lockWhile()` calls that haven't completed yet. While this is zero (and the gate
+  // isn't broken), `pastLocksPromise` has resolved, so `wait()` need not wait for it and `lock()`
+  // need not join a new lock with it.
+
   kj::OneOf<kj::Own<kj::PromiseFulfiller<void>>, kj::Exception> brokenState;
   // A fulfiller for onBroken(), or an exception if already broken.
 
@@ -293,6 +306,7 @@ kj::Promise<T> OutputGate::lockWhile(kj::Promise<T> promise) {
 
   hooks.outputGateLocked();
   auto rejectIfCanceled = kj::defer([this, &fulfiller](){
+    --activeLocks;
     hooks.outputGateReleased();
     if (fulfiller->isWaiting()) {
       auto e = makeUnfulfilledException();
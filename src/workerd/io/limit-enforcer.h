@@ -125,6 +125,11 @@ public:
 
   virtual void reportMetrics(RequestObserver& requestMetrics) = 0;
   // Report resource usage metrics to the given request metrics object.
+
+  virtual void chargeOffThreadCpu(kj::Duration cpuTime) = 0;
+  // Called when work that this request handed off to another thread (such as the crypto thread
+  // pool) has finished, with the CPU time the work took. It should count against the request's
+  // CPU limit as though it had been spent running JavaScript.
 };
 
 }  // namespace workerd
@@ -85,6 +85,12 @@ public:
   virtual void teardownLockAcquired() {}
   virtual void teardownFinished() {}
 
+  virtual bool wantsHeapUsage() const { return false; }
+  virtual void reportHeapUsage(size_t usedBytes, size_t totalBytes) {}
+  // If wantsHeapUsage() returns true, reportHeapUsage() is called with the isolate lock held
+  // every time the isolate checks in with its limit enforcer, i.e. after JavaScript has run.
+  // Reading the heap statistics isn't free, so observers that don't care should leave this off.
+
   enum class StartType: uint8_t {
     // Describes why a worker was started.
 
@@ -213,6 +219,18 @@ public:
   virtual void addStorageWriteUnits(uint32_t units) {}
   virtual void addStorageDeletes(uint32_t count) {}
 
+  enum class StorageCacheOp { GET, LIST };
+  virtual void addStorageCacheHits(StorageCacheOp op, uint32_t count) {}
+  virtual void addStorageCacheMisses(StorageCacheOp op, uint32_t count) {}
+  virtual void addStorageCacheEvictions(uint32_t count) {}
+  virtual void storageCacheFlushed(kj::Duration latency) {}
+  virtual void reportStorageCacheSize(size_t residentBytes, size_t dirtyBytes) {}
+  // Behavior of the actor's storage cache, if it has one. See ActorCache::Hooks.
+
+  virtual void sqlQueryCompleted(uint64_t rowsRead, uint64_t rowsWritten,
+                                 kj::Duration duration) {}
+  // A query run through `state.storage.sql` finished. See SqliteDatabase::Query::Stats.
+
   virtual void inputGateLocked() {}
   virtual void inputGateReleased() {}
   virtual void inputGateWaiterAdded() {}
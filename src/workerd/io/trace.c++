@@ -24,15 +24,18 @@ static kj::HttpMethod validateMethod(capnp::HttpMethod method) {
 
 } // namespace
 
-Trace::FetchEventInfo::FetchEventInfo(kj::HttpMethod method, kj::String url, kj::String cfJson,
-    kj::Array<Header> headers)
-    : method(method), url(kj::mv(url)), cfJson(kj::mv(cfJson)), headers(kj::mv(headers)) {}
+Trace::FetchEventInfo::FetchEventInfo(kj::HttpMethod method, kj::String url,
+    kj::Maybe<kj::Own<CfBlob>> cf, kj::Array<Header> headers)
+    : method(method), url(kj::mv(url)), cf(kj::mv(cf)), headers(kj::mv(headers)) {}
 
 Trace::FetchEventInfo::FetchEventInfo(rpc::Trace::FetchEventInfo::Reader reader)
     : method(validateMethod(reader.getMethod())),
-      url(kj::str(reader.getUrl())),
-      cfJson(kj::str(reader.getCfJson()))
+      url(kj::str(reader.getUrl()))
 {
+  if (reader.getCfJson().size() > 0) {
+    cf = kj::refcounted<CfBlob>(kj::str(reader.getCfJson()));
+  }
+
   kj::Vector<Header> v;
   v.addAll(reader.getHeaders());
   headers = v.releaseAsArray();
@@ -41,7 +44,7 @@ Trace::FetchEventInfo::FetchEventInfo(rpc::Trace::FetchEventInfo::Reader reader)
 void Trace::FetchEventInfo::copyTo(rpc::Trace::FetchEventInfo::Builder builder) {
   builder.setMethod(static_cast<capnp::HttpMethod>(method));
   builder.setUrl(url);
-  builder.setCfJson(cfJson);
+  builder.setCfJson(getCfJson());
 
   auto list = builder.initHeaders(headers.size());
   for (auto i: kj::indices(headers)) {
@@ -468,19 +471,19 @@ void WorkerTracer::addDiagnosticChannelEvent(kj::Date timestamp,
   trace->diagnosticChannelEvents.add(timestamp, kj::mv(channel), kj::mv(message));
 }
 
-void WorkerTracer::setEventInfo(kj::Date timestamp, Trace::EventInfo&& info) {
+void WorkerTracer::setEventInfo(
+    kj::Date timestamp, kj::FunctionParam<Trace::EventInfo()> makeInfo) {
   KJ_ASSERT(trace->eventInfo == nullptr, "tracer can only be used for a single event");
 
   // TODO(someday): For now, we're using logLevel == none as a hint to avoid doing anything
   //   expensive while tracing.  We may eventually want separate configuration for event info vs.
   //   logs.
-  // TODO(perf): Find a way to allow caller to avoid the cost of generation if the info struct
-  //   won't be used?
   if (pipelineLogLevel == PipelineLogLevel::NONE) {
     return;
   }
 
   trace->eventTimestamp = timestamp;
+  auto info = makeInfo();
 
   size_t newSize = trace->bytesUsed;
   KJ_SWITCH_ONEOF(info) {
@@ -489,7 +492,7 @@ void WorkerTracer::setEventInfo(kj::Date timestamp, Trace::EventInfo&& info) {
       for (const auto& header: fetch.headers) {
         newSize += header.name.size() + header.value.size();
       }
-      newSize += fetch.cfJson.size();
+      newSize += fetch.getCfJson().size();
       if (newSize > MAX_TRACE_BYTES) {
         trace->logs.add(
             timestamp, LogLevel::WARN,
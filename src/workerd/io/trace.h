@@ -5,6 +5,7 @@
 #pragma once
 
 #include <kj/async.h>
+#include <kj/function.h>
 #include <kj/one-of.h>
 #include <kj/refcount.h>
 #include <kj/string.h>
@@ -44,6 +45,23 @@ enum class PipelineLogLevel {
 //     and intermediate values can be freed at different times.
 //   - Request builds a vector of results, while Tracer builds a tree.
 
+class CfBlob final: public kj::Refcounted {
+  // The `cf` metadata of an incoming request, as JSON. Shared between the request and its traces,
+  // which outlive it, so that neither needs its own copy.
+  //
+  // We keep the text rather than a parsed form because every consumer (`request.cf`, and the
+  // `TraceItem`s delivered to tail workers) ultimately needs a V8 object in some isolate, and
+  // v8::JSON::Parse() of the text is the cheapest way to build one.
+public:
+  explicit CfBlob(kj::String json): json(kj::mv(json)) {}
+  KJ_DISALLOW_COPY_AND_MOVE(CfBlob);
+
+  kj::StringPtr getJson() const { return json; }
+
+private:
+  kj::String json;
+};
+
 // TODO(cleanup) - worth separating into immutable Trace vs. mutable TraceBuilder?
 class Trace final : public kj::Refcounted {
   // Collects trace information about the handling of a worker/pipline fetch event.
@@ -57,8 +75,8 @@ public:
   public:
     class Header;
 
-    explicit FetchEventInfo(kj::HttpMethod method, kj::String url, kj::String cfJson,
-        kj::Array<Header> headers);
+    explicit FetchEventInfo(kj::HttpMethod method, kj::String url,
+        kj::Maybe<kj::Own<CfBlob>> cf, kj::Array<Header> headers);
     FetchEventInfo(rpc::Trace::FetchEventInfo::Reader reader);
 
     class Header {
@@ -74,10 +92,14 @@ public:
 
     kj::HttpMethod method;
     kj::String url;
-    kj::String cfJson;
-    // TODO(perf): It might be more efficient to store some sort of parsed JSON result instead?
+    kj::Maybe<kj::Own<CfBlob>> cf;
     kj::Array<Header> headers;
 
+    kj::StringPtr getCfJson() const {
+      // Empty if the request had no cf metadata.
+      return cf.map([](const kj::Own<CfBlob>& b) { return b->getJson(); }).orDefault(""_kj);
+    }
+
     void copyTo(rpc::Trace::FetchEventInfo::Builder builder);
   };
 
@@ -307,8 +329,11 @@ public:
   void addDiagnosticChannelEvent(kj::Date timestamp, kj::String channel,
                                  kj::Array<kj::byte> message);
 
-  void setEventInfo(kj::Date timestamp, Trace::EventInfo&&);
+  void setEventInfo(kj::Date timestamp, kj::FunctionParam<Trace::EventInfo()> makeInfo);
   // Adds info about the event that triggered the trace.  Must not be called more than once.
+  //
+  // `makeInfo` is only called if the info will actually be recorded, so callers should do any
+  // copying (URLs, headers, etc.) inside it rather than up front.
 
   void setFetchResponseInfo(Trace::FetchResponseInfo&&);
   // Adds info about the response. Must not be called more than once, and only
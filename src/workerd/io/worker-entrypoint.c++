@@ -70,7 +70,9 @@ WorkerEntrypoint::WorkerEntrypoint(kj::Badge<WorkerEntrypoint> badge,
       waitUntilTasks(waitUntilTasks),
       tunnelExceptions(tunnelExceptions),
       entrypointName(entrypointName),
-      cfBlobJson(kj::mv(cfBlobJson)) {}
+      cfBlob(cfBlobJson.map([](kj::String& json) -> kj::Own<CfBlob> {
+        return kj::refcounted<CfBlob>(kj::mv(json));
+      })) {}
 
 void WorkerEntrypoint::init(
     kj::Own<const Worker> worker,
@@ -125,32 +127,30 @@ kj::Promise<void> WorkerEntrypoint::request(
   bool isActor = context.getActor() != nullptr;
 
   KJ_IF_MAYBE(t, incomingRequest->getWorkerTracer()) {
-    auto timestamp = context.now();
-    kj::String cfJson;
-    KJ_IF_MAYBE(c, cfBlobJson) {
-      cfJson = kj::str(*c);
-    }
-
-    // To match our historical behavior (when we used to pull the headers from the JavaScript
-    // object later on), we need to canonicalize the headers, including:
-    // - Lower-case the header name.
-    // - Combine multiple headers with the same name into a comma-delimited list. (This explicitly
-    //   breaks the Set-Cookie header, incidentally, but should be equivalent for all other
-    //   headers.)
-    kj::TreeMap<kj::String, kj::Vector<kj::StringPtr>> traceHeaders;
-    headers.forEach([&](kj::StringPtr name, kj::StringPtr value) {
-      kj::String lower = api::toLower(name);
-      auto& slot = traceHeaders.findOrCreate(lower,
-          [&]() { return decltype(traceHeaders)::Entry {kj::mv(lower), {}}; });
-      slot.add(value);
+    t->setEventInfo(context.now(), [&]() -> Trace::EventInfo {
+      // To match our historical behavior (when we used to pull the headers from the JavaScript
+      // object later on), we need to canonicalize the headers, including:
+      // - Lower-case the header name.
+      // - Combine multiple headers with the same name into a comma-delimited list. (This
+      //   explicitly breaks the Set-Cookie header, incidentally, but should be equivalent for all
+      //   other headers.)
+      kj::TreeMap<kj::String, kj::Vector<kj::StringPtr>> traceHeaders;
+      headers.forEach([&](kj::StringPtr name, kj::StringPtr value) {
+        kj::String lower = api::toLower(name);
+        auto& slot = traceHeaders.findOrCreate(lower,
+            [&]() { return decltype(traceHeaders)::Entry {kj::mv(lower), {}}; });
+        slot.add(value);
+      });
+      auto traceHeadersArray = KJ_MAP(entry, traceHeaders) {
+        return Trace::FetchEventInfo::Header(kj::mv(entry.key),
+            kj::strArray(entry.value, ", "));
+      };
+
+      // The trace shares the request's cf blob rather than copying it.
+      return Trace::FetchEventInfo(method, kj::str(url),
+          cfBlob.map([](kj::Own<CfBlob>& b) { return kj::addRef(*b); }),
+          kj::mv(traceHeadersArray));
     });
-    auto traceHeadersArray = KJ_MAP(entry, traceHeaders) {
-      return Trace::FetchEventInfo::Header(kj::mv(entry.key),
-          kj::strArray(entry.value, ", "));
-    };
-
-    t->setEventInfo(timestamp, Trace::FetchEventInfo(method, kj::str(url),
-        kj::mv(cfJson), kj::mv(traceHeadersArray)));
   }
 
   auto metricsForCatch = kj::addRef(incomingRequest->getMetrics());
@@ -164,7 +164,8 @@ kj::Promise<void> WorkerEntrypoint::request(
 
     return lock.getGlobalScope().request(
         method, url, headers, requestBody, wrappedResponse,
-        cfBlobJson, lock, lock.getExportedHandler(entrypointName, context.getActor()));
+        cfBlob.map([](kj::Own<CfBlob>& b) { return b->getJson(); }),
+        lock, lock.getExportedHandler(entrypointName, context.getActor()));
   }).then([this](api::DeferredProxy<void> deferredProxy) {
     proxyTask = kj::mv(deferredProxy.proxyTask);
   }).exclusiveJoin(context.onAbort())
@@ -186,7 +187,7 @@ kj::Promise<void> WorkerEntrypoint::request(
       // Fail-open behavior has been chosen, we'd better save an interface that we can use for
       // that purpose later.
       failOpenService = context.getSubrequestChannelNoChecks(IoContext::NEXT_CLIENT_CHANNEL, false,
-                                                             kj::mv(cfBlobJson));
+          cfBlob.map([](kj::Own<CfBlob>& b) { return kj::str(b->getJson()); }));
     }
     auto promise = incomingRequest->drain().attach(kj::mv(incomingRequest));
     maybeAddGcPassForTest(context, promise);
@@ -349,7 +350,9 @@ kj::Promise<WorkerInterface::ScheduledResult> WorkerEntrypoint::runScheduled(
 
   KJ_IF_MAYBE(t, context.getWorkerTracer()) {
     double eventTime = (scheduledTime - kj::UNIX_EPOCH) / kj::MILLISECONDS;
-    t->setEventInfo(context.now(), Trace::ScheduledEventInfo(eventTime, kj::str(cron)));
+    t->setEventInfo(context.now(), [&]() -> Trace::EventInfo {
+      return Trace::ScheduledEventInfo(eventTime, kj::str(cron));
+    });
   }
 
   // Scheduled handlers run entirely in waitUntil() tasks.
@@ -402,7 +405,9 @@ kj::Promise<WorkerInterface::AlarmResult> WorkerEntrypoint::runAlarmImpl(
   incomingRequest->delivered();
 
   KJ_IF_MAYBE(t, incomingRequest->getWorkerTracer()) {
-    t->setEventInfo(context.now(), Trace::AlarmEventInfo(scheduledTime));
+    t->setEventInfo(context.now(), [&]() -> Trace::EventInfo {
+      return Trace::AlarmEventInfo(scheduledTime);
+    });
   }
 
   auto scheduleAlarmResult = co_await actor.scheduleAlarm(scheduledTime);
@@ -67,7 +67,7 @@ private:
   kj::Maybe<kj::Own<IoContext::IncomingRequest>> incomingRequest;
   bool tunnelExceptions;
   kj::Maybe<kj::StringPtr> entrypointName;
-  kj::Maybe<kj::String> cfBlobJson;
+  kj::Maybe<kj::Own<CfBlob>> cfBlob;
   // Members initialized at startup.
 
   kj::Maybe<kj::Promise<void>> proxyTask;
@@ -34,9 +34,15 @@ public:
   // Make an HTTP request. (This method is inherited from HttpService, but re-declared here for
   // visibility.)
   //
-  // TODO(perf): Consider changing this to return Promise<DeferredProxy>. This would allow
-  //   more resources to be dropped when merely proxying a request. However, it means we would no
-  //   longer be immplementing kj::HttpService. But maybe that doesn't matter too much in practice.
+  // Note that WorkerEntrypoint already splits its implementation of this method internally: once
+  // the JavaScript handler has produced a response, it releases the IoContext (and with it the
+  // isolate and any actor's active-request count) before finishing the DeferredProxy part of the
+  // response, so a worker that merely passes a response body through does not pin the isolate.
+  //
+  // TODO(perf): Consider changing this to return Promise<DeferredProxy>, so that callers could
+  //   release their own resources at the same point. However, it means we would no longer be
+  //   implementing kj::HttpService, and every WorkerInterface wrapper would need to forward the
+  //   split. So far no caller in workerd holds anything costly across the proxy phase.
 
   virtual kj::Promise<void> connect(kj::StringPtr host,
                                     const kj::HttpHeaders& headers,
@@ -0,0 +1,94 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "worker.h"
+#include <kj/test.h>
+#include <workerd/tests/test-fixture.h>
+
+namespace workerd {
+namespace {
+
+KJ_TEST("Worker::Isolate::newScriptAsync() waits its turn, and Scripts are torn down lazily") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  TestFixture fixture({ .waitScope = ws });
+  auto& isolate = fixture.getWorker().getIsolate();
+
+  kj::Maybe<Worker::AsyncLock> asyncLock = isolate.takeAsyncLockWithoutRequest(nullptr).wait(ws);
+
+  auto promise = isolate.newScriptAsync("other-script", Worker::Script::ScriptSource {
+    .mainScript = "addEventListener('fetch', event => {});"_kj,
+    .mainScriptName = "other-script.js"_kj,
+    .compileGlobals = [](jsg::Lock& lock, const Worker::ApiIsolate& apiIsolate) {
+      return kj::Array<Worker::Script::CompiledGlobal>();
+    },
+  }, IsolateObserver::StartType::COLD);
+
+  // Compiling queues behind whoever holds the async lock.
+  KJ_EXPECT(!promise.poll(ws));
+  asyncLock = nullptr;
+  auto script = promise.wait(ws);
+  KJ_EXPECT(&script->getIsolate() == &isolate);
+  KJ_EXPECT(!script->isModular());
+
+  // Dropping the script doesn't lock the isolate; the next lock holder tears it down.
+  auto lockCount = isolate.getLockSuccessCount();
+  script = nullptr;
+  KJ_EXPECT(isolate.getLockSuccessCount() == lockCount);
+
+  fixture.runInIoContext([](const TestFixture::Environment& env) {});
+  KJ_EXPECT(isolate.getLockSuccessCount() > lockCount);
+}
+
+KJ_TEST("Worker::Isolate lock attempts queued behind another isolate's lock wake in order") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  TestFixture fixtureA({ .waitScope = ws });
+  TestFixture fixtureB({ .waitScope = ws });
+  TestFixture fixtureC({ .waitScope = ws });
+  auto& a = fixtureA.getWorker().getIsolate();
+  auto& b = fixtureB.getWorker().getIsolate();
+  auto& c = fixtureC.getWorker().getIsolate();
+
+  {
+    // While this thread holds A's lock, attempts to lock other isolates wait for its release.
+    kj::Maybe<Worker::AsyncLock> lockA = a.takeAsyncLockWithoutRequest(nullptr).wait(ws);
+    auto b1 = b.takeAsyncLockWithoutRequest(nullptr).eagerlyEvaluate(nullptr);
+    auto c1 = c.takeAsyncLockWithoutRequest(nullptr).eagerlyEvaluate(nullptr);
+    auto b2 = b.takeAsyncLockWithoutRequest(nullptr).eagerlyEvaluate(nullptr);
+    KJ_EXPECT(!b1.poll(ws));
+    KJ_EXPECT(!c1.poll(ws));
+    KJ_EXPECT(!b2.poll(ws));
+
+    // Releasing it wakes the first waiter, along with the later one for the same isolate, which
+    // shares its lock. C's attempt stays queued until B's lock is released in turn.
+    lockA = nullptr;
+    KJ_EXPECT(b1.poll(ws));
+    KJ_EXPECT(b2.poll(ws));
+    KJ_EXPECT(!c1.poll(ws));
+    {
+      auto lockB1 = b1.wait(ws);
+      auto lockB2 = b2.wait(ws);
+    }
+    KJ_EXPECT(c1.poll(ws));
+    c1.wait(ws);
+  }
+
+  {
+    kj::Maybe<Worker::AsyncLock> lockA = a.takeAsyncLockWithoutRequest(nullptr).wait(ws);
+    auto b1 = b.takeAsyncLockWithoutRequest(nullptr).eagerlyEvaluate(nullptr);
+    auto c1 = c.takeAsyncLockWithoutRequest(nullptr).eagerlyEvaluate(nullptr);
+    KJ_EXPECT(!c1.poll(ws));
+
+    // B's attempt is woken but canceled before it gets to run. It passes the wakeup on, or C's
+    // attempt would wait forever.
+    lockA = nullptr;
+    b1 = nullptr;
+    KJ_EXPECT(c1.poll(ws));
+    c1.wait(ws);
+  }
+}
+
+}  // namespace
+}  // namespace workerd
@@ -526,6 +526,9 @@ struct Worker::Isolate::Impl {
   kj::Maybe<std::unique_ptr<v8_inspector::V8Inspector>> inspector;
   InspectorPolicy inspectorPolicy;
   kj::Maybe<kj::Own<v8::CpuProfiler>> profiler;
+  kj::Maybe<kj::Own<v8::CpuProfiler>> headlessProfiler;
+  // `profiler` serves the inspector's Profiler domain; `headlessProfiler` serves
+  // startCpuProfiling() / stopCpuProfiling(). V8 lets both run at once.
   ActorCache::SharedLru actorCacheLru;
 
   kj::Vector<kj::String> queuedNotifications;
@@ -541,6 +544,11 @@ struct Worker::Isolate::Impl {
   // Instantaneous count of how many threads are trying to or have successfully obtained an
   // AsyncLock on this isolate, used to implement getCurrentLoad().
 
+  mutable uint lockWaiterGauge = 0;
+  // Instantaneous count of lock attempts on this isolate that haven't obtained the lock yet, used
+  // to implement getLockWaiterCount(). Unlike `lockAttemptGauge`, this counts each attempt rather
+  // than each thread, and excludes the holder.
+
   mutable uint64_t lockSuccessCount = 0;
   // Atomically incremented upon every successful lock. The ThreadProgressCounter in Impl::Lock
   // registers a reference to `lockSuccessCounter` as the thread's progress counter during a lock
@@ -598,6 +606,7 @@ struct Worker::Isolate::Impl {
         }
         workerImpl = nullptr;
       }
+      disposeQueuedScripts();
 
       currentApiIsolate = isolate.apiIsolate.get();
     }
@@ -614,6 +623,12 @@ struct Worker::Isolate::Impl {
       if (shouldReportIsolateMetrics) {
         // The isolate asked this lock to report the stats when it released. Let's do it.
         limitEnforcer.reportMetrics(impl.metrics);
+
+        if (impl.metrics.wantsHeapUsage()) {
+          v8::HeapStatistics heapStats;
+          lock->v8Isolate->GetHeapStatistics(&heapStats);
+          impl.metrics.reportHeapUsage(heapStats.used_heap_size(), heapStats.total_heap_size());
+        }
       }
       impl.currentLock = nullptr;
     }
@@ -663,6 +678,10 @@ struct Worker::Isolate::Impl {
       lock->v8Isolate->ContextDisposedNotification(false);
     }
 
+    void disposeQueuedScripts();
+    // Destroys any `Script::Impl`s queued up in `scriptDestructionQueue`. Defined out-of-line
+    // since `Script::Impl` is not yet complete here.
+
     void gcPrologue() {
       metrics.gcPrologue();
     }
@@ -701,8 +720,18 @@ struct Worker::Isolate::Impl {
   // Similar in spirit to the deferred destruction queue in jsg::IsolateBase. When a Worker is
   // destroyed, it puts its Impl, which contains objects that need to be destroyed under the isolate
   // lock, into this queue. Our own Isolate::Impl::Lock implementation then clears this queue the
-  // next time the isolate is locked, whether that be by a connection thread, or the Worker's own
-  // destructor if it owns the last `kj::Own<const Script>` reference.
+  // next time the isolate is locked, whether that be by a connection thread, or the Isolate's own
+  // destructor once the last `kj::Own<const Script>` reference is gone.
+
+  static constexpr auto SCRIPT_DESTRUCTION_QUEUE_INITIAL_SIZE = 2;
+  static constexpr auto SCRIPT_DESTRUCTION_QUEUE_MAX_CAPACITY = 16;
+  const kj::MutexGuarded<BatchQueue<kj::Own<Worker::Script::Impl>>> scriptDestructionQueue {
+    SCRIPT_DESTRUCTION_QUEUE_INITIAL_SIZE,
+    SCRIPT_DESTRUCTION_QUEUE_MAX_CAPACITY
+  };
+  // Like `workerDestructionQueue`, but for Scripts. Tearing down a script's module context can be
+  // GC-heavy, so rather than stalling whoever holds the isolate lock, ~Script() defers the work to
+  // the next lock holder.
   //
   // Fairly obviously, this member is protected by its own mutex, not the isolate lock.
   //
@@ -742,30 +771,28 @@ public:
 const CpuProfilerDisposer CpuProfilerDisposer::instance {};
 
 static constexpr kj::StringPtr PROFILE_NAME = "Default Profile"_kj;
+static constexpr kj::StringPtr HEADLESS_PROFILE_NAME = "Headless Profile"_kj;
 
 static void setSamplingInterval(v8::CpuProfiler& profiler, int interval) {
   profiler.SetSamplingInterval(interval);
 }
 
-static void startProfiling(v8::CpuProfiler& profiler, v8::Isolate* isolate) {
+static void startProfiling(v8::CpuProfiler& profiler, v8::Isolate* isolate,
+    kj::StringPtr name = PROFILE_NAME) {
   v8::HandleScope handleScope(isolate);
   v8::CpuProfilingOptions options(
     v8::kLeafNodeLineNumbers,
     v8::CpuProfilingOptions::kNoSampleLimit
   );
-  profiler.StartProfiling(jsg::v8StrIntern(isolate, PROFILE_NAME.cStr()), kj::mv(options));
+  profiler.StartProfiling(jsg::v8StrIntern(isolate, name.cStr()), kj::mv(options));
 }
 
-static void stopProfiling(v8::CpuProfiler& profiler,v8::Isolate* isolate,
-    cdp::Command::Builder& cmd) {
-  v8::HandleScope handleScope(isolate);
-  auto cpuProfile = profiler.StopProfiling(jsg::v8StrIntern(isolate, PROFILE_NAME.cStr()));
-  if (cpuProfile == nullptr) return; // profiling never started
-
+static void buildProfile(const v8::CpuProfile& cpuProfile,
+    cdp::Profiler::Profile::Builder profile) {
   kj::Vector<const v8::CpuProfileNode*> allNodes;
   kj::Vector<const v8::CpuProfileNode*> unvisited;
 
-  unvisited.add(cpuProfile->GetTopDownRoot());
+  unvisited.add(cpuProfile.GetTopDownRoot());
   while (!unvisited.empty()) {
     auto next = unvisited.back();
     allNodes.add(next);
@@ -775,10 +802,8 @@ static void stopProfiling(v8::CpuProfiler& profiler,v8::Isolate* isolate,
     }
   }
 
-  auto res = cmd.getProfilerStop().initResult();
-  auto profile = res.initProfile();
-  profile.setStartTime(cpuProfile->GetStartTime());
-  profile.setEndTime(cpuProfile->GetEndTime());
+  profile.setStartTime(cpuProfile.GetStartTime());
+  profile.setEndTime(cpuProfile.GetEndTime());
 
   auto nodes = profile.initNodes(allNodes.size());
   for (auto i : kj::indices(allNodes)) {
@@ -815,18 +840,28 @@ static void stopProfiling(v8::CpuProfiler& profiler,v8::Isolate* isolate,
     }
   }
 
-  auto sampleCount = cpuProfile->GetSamplesCount();
+  auto sampleCount = cpuProfile.GetSamplesCount();
   auto samples = profile.initSamples(sampleCount);
   auto timeDeltas = profile.initTimeDeltas(sampleCount);
-  auto lastTimestamp = cpuProfile->GetStartTime();
+  auto lastTimestamp = cpuProfile.GetStartTime();
   for (int i=0; i < sampleCount; i++) {
-    samples.set(i, cpuProfile->GetSample(i)->GetNodeId());
-    auto sampleTime = cpuProfile->GetSampleTimestamp(i);
+    samples.set(i, cpuProfile.GetSample(i)->GetNodeId());
+    auto sampleTime = cpuProfile.GetSampleTimestamp(i);
     timeDeltas.set(i, sampleTime - lastTimestamp);
     lastTimestamp = sampleTime;
   }
 }
 
+static void stopProfiling(v8::CpuProfiler& profiler,v8::Isolate* isolate,
+    cdp::Command::Builder& cmd) {
+  v8::HandleScope handleScope(isolate);
+  auto cpuProfile = profiler.StopProfiling(jsg::v8StrIntern(isolate, PROFILE_NAME.cStr()));
+  if (cpuProfile == nullptr) return; // profiling never started
+  KJ_DEFER(cpuProfile->Delete());
+
+  buildProfile(*cpuProfile, cmd.getProfilerStop().initResult().initProfile());
+}
+
 } // anonymous namespace
 
 struct Worker::Script::Impl {
@@ -1134,16 +1169,14 @@ Worker::Isolate::Isolate(kj::Own<ApiIsolate> apiIsolateParam,
 
 Worker::Script::Script(kj::Own<const Isolate> isolateParam, kj::StringPtr id,
                        Script::Source source, IsolateObserver::StartType startType,
-                       bool logNewScript, kj::Maybe<ValidationErrorReporter&> errorReporter)
+                       bool logNewScript, kj::Maybe<ValidationErrorReporter&> errorReporter,
+                       Worker::LockType lockType)
     : isolate(kj::mv(isolateParam)), id(kj::str(id)), impl(kj::heap<Impl>()) {
   auto parseMetrics = isolate->metrics->parse(startType);
-  // TODO(perf): It could make sense to take an async lock when constructing a script if we
-  //   co-locate multiple scripts in the same isolate. As of this writing, we do not, except in
-  //   previews, where it doesn't matter. If we ever do co-locate multiple scripts in the same
-  //   isolate, we may wish to make the RequestObserver object available here, in order to
-  //   attribute lock timing to that request.
+  // Callers that may contend with live traffic on this isolate should use `newScriptAsync()`, so
+  // that `lockType` is an `AsyncLock`.
   jsg::V8StackScope stackScope;
-  Isolate::Impl::Lock recordedLock(*isolate, Worker::Lock::TakeSynchronously(nullptr), stackScope);
+  Isolate::Impl::Lock recordedLock(*isolate, lockType, stackScope);
   auto& lock = *recordedLock.lock;
 
   // If we throw an exception, it's important that `impl` is destroyed under lock.
@@ -1280,17 +1313,22 @@ Worker::Isolate::~Isolate() noexcept(false) {
 }
 
 Worker::Script::~Script() noexcept(false) {
-  // Make sure to destroy things under lock.
-  // TODO(perf): It could make sense to try to obtain an async lock before destroying a script if
-  //   multiple scripts are co-located in the same isolate. As of this writing, that doesn't happen
-  //   except in preview. In any case, Scripts are destroyed in the GC thread, where we don't care
-  //   too much about lock latency.
-  jsg::V8StackScope stackScope;
-  Isolate::Impl::Lock recordedLock(*isolate, Worker::Lock::TakeSynchronously(nullptr), stackScope);
-  KJ_IF_MAYBE(c, impl->moduleContext) {
-    recordedLock.disposeContext(kj::mv(*c));
+  // Our V8 objects need to be destroyed under lock, but we don't want to stall whoever is using
+  // the isolate while we tear down a potentially large module graph. So, like ~Worker(), we defer
+  // destruction to the next time the isolate is locked. If we held the last reference to the
+  // isolate, that will be the final lock taken by ~Isolate(), which happens as soon as our
+  // `isolate` member is destroyed below.
+  isolate->impl->scriptDestructionQueue.lockExclusive()->push(kj::mv(impl));
+}
+
+void Worker::Isolate::Impl::Lock::disposeQueuedScripts() {
+  auto scriptsToDestroy = impl.scriptDestructionQueue.lockExclusive()->pop();
+  for (auto& scriptImpl: scriptsToDestroy.asArrayPtr()) {
+    KJ_IF_MAYBE(c, scriptImpl->moduleContext) {
+      disposeContext(kj::mv(*c));
+    }
+    scriptImpl = nullptr;
   }
-  impl = nullptr;
 }
 
 bool Worker::Script::isModular() const {
@@ -1846,6 +1884,95 @@ void Worker::Lock::validateHandlers(ValidationErrorReporter& errorReporter) {
 // AsyncLock implementation
 
 thread_local Worker::AsyncWaiter* Worker::AsyncWaiter::threadCurrentWaiter = nullptr;
+thread_local Worker::AsyncWaiter::ReleaseWaiterList Worker::AsyncWaiter::threadReleaseWaiters;
+
+class Worker::AsyncWaiter::ReleaseWaiter {
+  // An entry in `threadReleaseWaiters`. Lives in the frame of the takeAsyncLockImpl() coroutine
+  // that is waiting.
+
+public:
+  ReleaseWaiter(const Isolate& isolate, bool atFront): isolate(isolate) {
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    promise = kj::mv(paf.promise);
+    fulfiller = kj::mv(paf.fulfiller);
+
+    auto& list = threadReleaseWaiters;
+    if (atFront) {
+      // A waiter that was woken but lost the race to some other lock attempt keeps its place.
+      next = list.head;
+      prev = &list.head;
+      KJ_IF_MAYBE(n, next) {
+        n->prev = &next;
+      } else {
+        list.tail = &next;
+      }
+      list.head = *this;
+    } else {
+      next = nullptr;
+      prev = list.tail;
+      *list.tail = *this;
+      list.tail = &next;
+    }
+  }
+
+  ~ReleaseWaiter() noexcept {
+    if (prev != nullptr) {
+      unlink();
+    } else if (!resumed && threadCurrentWaiter == nullptr) {
+      // We were woken, but our coroutine was canceled before it could take the lock. Pass the
+      // wakeup on, or the remaining waiters would wait for a release that never comes.
+      wakeReleaseWaiters();
+    }
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(ReleaseWaiter);
+
+  const Isolate& isolate;
+  // The isolate this waiter wants to lock.
+
+  kj::Promise<void> promise = nullptr;
+  kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+
+  bool resumed = false;
+  // Set by the waiting coroutine once it has run after being woken.
+
+  void wake() {
+    unlink();
+    fulfiller->fulfill();
+  }
+
+private:
+  kj::Maybe<ReleaseWaiter&> next;
+  kj::Maybe<ReleaseWaiter&>* prev = nullptr;
+  // Null once removed from the list.
+
+  void unlink() {
+    auto& list = threadReleaseWaiters;
+    *prev = next;
+    KJ_IF_MAYBE(n, next) {
+      n->prev = prev;
+    } else {
+      list.tail = prev;
+    }
+    prev = nullptr;
+  }
+
+  friend class Worker::AsyncWaiter;
+};
+
+void Worker::AsyncWaiter::wakeReleaseWaiters() {
+  KJ_IF_MAYBE(first, threadReleaseWaiters.head) {
+    const Isolate* isolate = &first->isolate;
+    kj::Maybe<ReleaseWaiter&> current = *first;
+    while (current != nullptr) {
+      auto& waiter = KJ_ASSERT_NONNULL(current);
+      current = waiter.next;
+      if (&waiter.isolate == isolate) {
+        waiter.wake();
+      }
+    }
+  }
+}
 
 Worker::Isolate::AsyncWaiterList::~AsyncWaiterList() noexcept {
   // It should be impossible for this list to be non-empty since each member of the list holds a
@@ -1874,6 +2001,10 @@ kj::Promise<Worker::AsyncLock> Worker::Isolate::takeAsyncLockImpl(
     currentLoad = getCurrentLoad();
   }
 
+  __atomic_add_fetch(&impl->lockWaiterGauge, 1, __ATOMIC_RELAXED);
+  KJ_DEFER(__atomic_sub_fetch(&impl->lockWaiterGauge, 1, __ATOMIC_RELAXED));
+
+  bool wasWoken = false;
   for (uint threadWaitingDifferentLockCount = 0; ; ++threadWaitingDifferentLockCount) {
     AsyncWaiter* waiter = AsyncWaiter::threadCurrentWaiter;
 
@@ -1900,13 +2031,16 @@ kj::Promise<Worker::AsyncLock> Worker::Isolate::takeAsyncLockImpl(
       co_return AsyncLock(kj::mv(newWaiterRef), kj::mv(lockTiming));
     } else {
       // Thread is already waiting for or holding a different isolate lock. Wait for that one to
-      // be released before we try to lock a different isolate.
-      // TODO(perf): Use of ForkedPromise leads to thundering herd here. Should be minor in practice,
-      //   but we could consider creating another linked list instead...
+      // be released before we try to lock a different isolate. Releasing it wakes only the
+      // waiters at the front of the line (see wakeReleaseWaiters()), rather than every waiter on
+      // the thread, only for all but one of them to go back to waiting.
       KJ_IF_MAYBE(lt, lockTiming) {
         lt->get()->waitingForOtherIsolate(waiter->isolate->getId());
       }
-      co_await waiter->releasePromise.addBranch();
+      AsyncWaiter::ReleaseWaiter releaseWaiter(*this, wasWoken);
+      co_await kj::mv(releaseWaiter.promise);
+      releaseWaiter.resumed = true;
+      wasWoken = true;
     }
   }
 }
@@ -1929,24 +2063,37 @@ Worker::AsyncWaiter::AsyncWaiter(kj::Own<const Isolate> isolateParam)
     releaseFulfiller = kj::mv(paf.fulfiller);
   }
 
+  // Allocate the cross-thread fulfiller before taking the lock, so that the critical section is
+  // limited to pointer updates. If it turns out the queue is empty we simply discard it.
+  auto readyPaf = kj::newPromiseAndCrossThreadFulfiller<void>();
+
   // Add ourselves to the wait queue for this isolate.
-  auto lock = isolate->asyncWaiters.lockExclusive();
-  if (lock->tail == &lock->head) {
-    // Looks like the queue is empty, so we immediately get the lock.
+  bool queueWasEmpty;
+  {
+    auto lock = isolate->asyncWaiters.lockExclusive();
+    queueWasEmpty = lock->tail == &lock->head;
+    if (!queueWasEmpty) {
+      // Arrange to get notified later. `readyFulfiller` must be set while holding the lock since
+      // the waiter ahead of us reads it under the lock when it releases.
+      readyFulfiller = kj::mv(readyPaf.fulfiller);
+    }
+    // Otherwise we can leave `readyFulfiller` null as no one will ever invoke it anyway.
+
+    next = nullptr;
+    prev = lock->tail;
+    *lock->tail = this;
+    lock->tail = &next;
+  }
+
+  if (queueWasEmpty) {
+    // Looks like the queue was empty, so we immediately get the lock.
     readyPromise = kj::Promise<void>(kj::READY_NOW).fork();
-    // We can leave `readyFulfiller` null as no one will ever invoke it anyway.
   } else {
-    // Arrange to get notified later.
-    auto paf = kj::newPromiseAndCrossThreadFulfiller<void>();
-    readyPromise = paf.promise.fork();
-    readyFulfiller = kj::mv(paf.fulfiller);
+    // It's fine if the fulfiller has already been fulfilled by now; the promise will simply be
+    // ready immediately.
+    readyPromise = readyPaf.promise.fork();
   }
 
-  next = nullptr;
-  prev = lock->tail;
-  *lock->tail = this;
-  lock->tail = &next;
-
   threadCurrentWaiter = this;
 
   __atomic_add_fetch(&isolate->impl->lockAttemptGauge, 1, __ATOMIC_RELAXED);
@@ -1958,28 +2105,38 @@ Worker::AsyncWaiter::~AsyncWaiter() noexcept {
 
   __atomic_sub_fetch(&isolate->impl->lockAttemptGauge, 1, __ATOMIC_RELAXED);
 
-  auto lock = isolate->asyncWaiters.lockExclusive();
+  kj::Own<kj::CrossThreadPromiseFulfiller<void>> nextReadyFulfiller;
+  {
+    auto lock = isolate->asyncWaiters.lockExclusive();
 
-  releaseFulfiller->fulfill();
+    // Remove ourselves from the list.
+    *prev = next;
+    KJ_IF_MAYBE(n, next) {
+      n->prev = prev;
+    } else {
+      lock->tail = prev;
+    }
 
-  // Remove ourselves from the list.
-  *prev = next;
-  KJ_IF_MAYBE(n, next) {
-    n->prev = prev;
-  } else {
-    lock->tail = prev;
+    if (prev == &lock->head) {
+      // We held the lock before now. The next waiter is now at the front of the line. We take its
+      // fulfiller so that we can alert it after releasing the mutex -- fulfilling a cross-thread
+      // fulfiller may need to wake another thread, which we'd rather not do while other threads
+      // are contending for `asyncWaiters`.
+      KJ_IF_MAYBE(n, next) {
+        nextReadyFulfiller = kj::mv(n->readyFulfiller);
+      }
+    }
   }
 
-  if (prev == &lock->head) {
-    // We held the lock before now. Alert the next waiter that they are now at the front of the
-    // line.
-    KJ_IF_MAYBE(n, next) {
-      n->readyFulfiller->fulfill();
-    }
+  releaseFulfiller->fulfill();
+  if (nextReadyFulfiller.get() != nullptr) {
+    nextReadyFulfiller->fulfill();
   }
 
   KJ_ASSERT(threadCurrentWaiter == this);
   threadCurrentWaiter = nullptr;
+
+  wakeReleaseWaiters();
 }
 
 kj::Promise<void> Worker::AsyncLock::whenThreadIdle() {
@@ -2683,9 +2840,28 @@ struct Worker::Actor::Impl {
     // Implements OutputGate::Hooks.
 
     void updateAlarmInMemory(kj::Maybe<kj::Date> newAlarmTime) override;
+    void cacheHits(ReadOp op, uint count) override {
+      metrics.addStorageCacheHits(toObserverOp(op), count);
+    }
+    void cacheMisses(ReadOp op, uint count) override {
+      metrics.addStorageCacheMisses(toObserverOp(op), count);
+    }
+    void cacheEvictions(uint count) override { metrics.addStorageCacheEvictions(count); }
+    void cacheFlushed(kj::Duration latency) override { metrics.storageCacheFlushed(latency); }
+    void cacheSize(size_t residentBytes, size_t dirtyBytes) override {
+      metrics.reportStorageCacheSize(residentBytes, dirtyBytes);
+    }
     // Implements ActorCache::Hooks
 
   private:
+    static ActorObserver::StorageCacheOp toObserverOp(ReadOp op) {
+      switch (op) {
+        case ReadOp::GET: return ActorObserver::StorageCacheOp::GET;
+        case ReadOp::LIST: return ActorObserver::StorageCacheOp::LIST;
+      }
+      KJ_UNREACHABLE;
+    }
+
     kj::Own<Loopback> loopback;    // only for updateAlarmInMemory()
     TimerChannel& timerChannel;    // only for afterLimitTimeout() and updateAlarmInMemory()
     ActorObserver& metrics;
@@ -3196,6 +3372,10 @@ uint Worker::Isolate::getCurrentLoad() const {
   return __atomic_load_n(&impl->lockAttemptGauge, __ATOMIC_RELAXED);
 }
 
+uint Worker::Isolate::getLockWaiterCount() const {
+  return __atomic_load_n(&impl->lockWaiterGauge, __ATOMIC_RELAXED);
+}
+
 uint Worker::Isolate::getLockSuccessCount() const {
   return __atomic_load_n(&impl->lockSuccessCount, __ATOMIC_RELAXED);
 }
@@ -3206,7 +3386,17 @@ kj::Own<const Worker::Script> Worker::Isolate::newScript(
     kj::Maybe<ValidationErrorReporter&> errorReporter) const {
   // Script doesn't already exist, so compile it.
   return kj::atomicRefcounted<Script>(kj::atomicAddRef(*this), scriptId, kj::mv(source),
-                                      startType, logNewScript, errorReporter);
+                                      startType, logNewScript, errorReporter,
+                                      Worker::Lock::TakeSynchronously(nullptr));
+}
+
+kj::Promise<kj::Own<const Worker::Script>> Worker::Isolate::newScriptAsync(
+    kj::StringPtr scriptId, Script::Source source,
+    IsolateObserver::StartType startType, bool logNewScript,
+    kj::Maybe<ValidationErrorReporter&> errorReporter) const {
+  auto asyncLock = co_await takeAsyncLockWithoutRequest(nullptr);
+  co_return kj::atomicRefcounted<Script>(kj::atomicAddRef(*this), scriptId, kj::mv(source),
+                                         startType, logNewScript, errorReporter, asyncLock);
 }
 
 kj::Own<WorkerInterface> Worker::Isolate::wrapSubrequestClient(
@@ -3225,6 +3415,45 @@ void Worker::Isolate::completedRequest() const {
   limitEnforcer->completedRequest(id);
 }
 
+void Worker::Isolate::startCpuProfiling(kj::Duration samplingInterval) const {
+  // const_cast OK because we take out a lock.
+  auto& isolate = const_cast<Isolate&>(*this);
+  jsg::V8StackScope stackScope;
+  Isolate::Impl::Lock recordedLock(*this, Worker::Lock::TakeSynchronously(nullptr), stackScope);
+  auto& lock = *recordedLock.lock;
+
+  KJ_REQUIRE(isolate.impl->headlessProfiler == nullptr, "CPU profiling is already in progress");
+  auto profiler = kj::Own<v8::CpuProfiler>(
+      v8::CpuProfiler::New(lock.v8Isolate, v8::kDebugNaming, v8::kLazyLogging),
+      CpuProfilerDisposer::instance);
+  setSamplingInterval(*profiler, samplingInterval / kj::MICROSECONDS);
+  startProfiling(*profiler, lock.v8Isolate, HEADLESS_PROFILE_NAME);
+  isolate.impl->headlessProfiler = kj::mv(profiler);
+}
+
+kj::String Worker::Isolate::stopCpuProfiling() const {
+  // const_cast OK because we take out a lock.
+  auto& isolate = const_cast<Isolate&>(*this);
+  jsg::V8StackScope stackScope;
+  Isolate::Impl::Lock recordedLock(*this, Worker::Lock::TakeSynchronously(nullptr), stackScope);
+  auto& lock = *recordedLock.lock;
+
+  auto profiler = kj::mv(KJ_REQUIRE_NONNULL(isolate.impl->headlessProfiler,
+      "CPU profiling is not in progress"));
+  isolate.impl->headlessProfiler = nullptr;
+
+  v8::HandleScope handleScope(lock.v8Isolate);
+  auto cpuProfile = profiler->StopProfiling(
+      jsg::v8StrIntern(lock.v8Isolate, HEADLESS_PROFILE_NAME.cStr()));
+  KJ_ASSERT(cpuProfile != nullptr);
+  KJ_DEFER(cpuProfile->Delete());
+
+  capnp::MallocMessageBuilder message;
+  auto profile = message.initRoot<cdp::Profiler::Profile>();
+  buildProfile(*cpuProfile, profile);
+  return getCdpJsonCodec().encode(profile.asReader());
+}
+
 bool Worker::Isolate::isInspectorEnabled() const {
   return impl->inspector != nullptr;
 }
@@ -223,7 +223,7 @@ private:
 public:  // pretend this is private (needs to be public because allocated through template)
   explicit Script(kj::Own<const Isolate> isolate, kj::StringPtr id, Source source,
                   IsolateObserver::StartType startType, bool logNewScript,
-                  kj::Maybe<ValidationErrorReporter&> errorReporter);
+                  kj::Maybe<ValidationErrorReporter&> errorReporter, Worker::LockType lockType);
 };
 
 class Worker::Isolate: public kj::AtomicRefcounted {
@@ -272,6 +272,15 @@ public:
       kj::Maybe<ValidationErrorReporter&> errorReporter = nullptr) const;
   // Parses the given code to create a new script object and returns it.
 
+  kj::Promise<kj::Own<const Worker::Script>> newScriptAsync(
+      kj::StringPtr id, Script::Source source,
+      IsolateObserver::StartType startType, bool logNewScript = false,
+      kj::Maybe<ValidationErrorReporter&> errorReporter = nullptr) const;
+  // Like newScript(), but queues behind other users of the isolate by taking an `AsyncLock`
+  // first rather than locking synchronously. Use this when the isolate may already be serving
+  // traffic, e.g. when reloading a script. `id`, the memory referenced by `source`, and
+  // `errorReporter` must remain valid until the returned promise resolves.
+
   const IsolateLimitEnforcer& getLimitEnforcer() const { return *limitEnforcer; }
   const ApiIsolate& getApiIsolate() const { return *apiIsolate; }
 
@@ -279,6 +288,10 @@ public:
   // Returns the number of threads currently blocked trying to lock this isolate's mutex (using
   // takeAsyncLock()).
 
+  uint getLockWaiterCount() const;
+  // Returns the number of lock attempts on this isolate, across all threads, that are still
+  // waiting to obtain the lock.
+
   uint getLockSuccessCount() const;
   // Returns a count that is incremented upon every successful lock.
 
@@ -316,6 +329,14 @@ public:
   void completedRequest() const;
   // Called after each completed request. Does not require a lock.
 
+  void startCpuProfiling(kj::Duration samplingInterval) const;
+  kj::String stopCpuProfiling() const;
+  // Sample the isolate's JavaScript with V8's CPU profiler, without an inspector client attached.
+  // stopCpuProfiling() returns the profile as JSON in the format of the inspector's
+  // Profiler.Profile, which is also the format of Chrome DevTools' `.cpuprofile` files. Only one
+  // such profile may be in progress per isolate. Both methods take the isolate lock
+  // synchronously.
+
   kj::Promise<AsyncLock> takeAsyncLockWithoutRequest(SpanParent parentSpan) const;
   kj::Promise<AsyncLock> takeAsyncLock(RequestObserver&) const;
   // See Worker::takeAsyncLock().
@@ -405,8 +426,12 @@ private:
   // protects the `AsyncWaiterList` as well as the next/prev pointers in each `AsyncWaiter` that
   // is currently in the list.
   //
-  // TODO(perf): Use a lock-free list? Tricky to get right. `asyncWaiters` should only be locked
-  //   briefly so there's probably not that much to gain.
+  // The critical sections only ever perform pointer updates: allocating a waiter's cross-thread
+  // fulfiller and waking the next waiter both happen outside the lock.
+  //
+  // TODO(perf): Use a lock-free list? Tricky to get right, since waiters can cancel from the
+  //   middle of the queue. `asyncWaiters` is only locked very briefly so there's probably not that
+  //   much to gain; see `async-lock-bench` in `src/workerd/tests` to measure.
 
   friend class Worker::AsyncLock;
 
@@ -684,6 +709,11 @@ public:
     virtual kj::Vector<jsg::Ref<api::WebSocket>> getWebSockets(
         jsg::Lock& js,
         kj::Maybe<kj::StringPtr> tag) = 0;
+    virtual void broadcast(
+        jsg::Lock& js,
+        kj::OneOf<kj::Array<kj::byte>, kj::String> message,
+        kj::Maybe<kj::StringPtr> tag,
+        kj::ArrayPtr<jsg::Ref<api::WebSocket>> except) = 0;
     virtual void hibernateWebSockets(Worker::Lock& lock) = 0;
     virtual void setWebSocketAutoResponse(jsg::Ref<api::WebSocketRequestResponsePair> reqResp) = 0;
     virtual void unsetWebSocketAutoResponse() = 0;
@@ -878,10 +908,10 @@ private:
 
   kj::ForkedPromise<void> releasePromise = nullptr;
   kj::Own<kj::PromiseFulfiller<void>> releaseFulfiller;
-  // Promise/fulfiller to fire when the AsyncLock is finally released. This is used when a thread
-  // tries to take locks on multiple different isolates concurrently, in order to serialize the
-  // locks so only one is taken at a time. This is NOT a cross-thread fulfiller; it can only be
-  // fulfilled by the thread that owns the waiter.
+  // Promise/fulfiller to fire when the AsyncLock is finally released. This is used by
+  // `AsyncLock::whenThreadIdle()`. (Lock attempts on other isolates, which must be serialized so
+  // that only one lock is taken at a time, wait in `threadReleaseWaiters` instead.) This is NOT a
+  // cross-thread fulfiller; it can only be fulfilled by the thread that owns the waiter.
 
   kj::Maybe<AsyncWaiter&> next;
   kj::Maybe<AsyncWaiter&>* prev;
@@ -891,6 +921,21 @@ private:
 
   static thread_local AsyncWaiter* threadCurrentWaiter;
 
+  class ReleaseWaiter;
+  struct ReleaseWaiterList {
+    kj::Maybe<ReleaseWaiter&> head = nullptr;
+    kj::Maybe<ReleaseWaiter&>* tail = &head;
+  };
+  static thread_local ReleaseWaiterList threadReleaseWaiters;
+  // Lock attempts on this thread that are waiting for `threadCurrentWaiter`, which is for a
+  // different isolate, to be released, in FIFO order. Only the thread itself touches this list, so
+  // it needs no lock.
+
+  static void wakeReleaseWaiters();
+  // Wakes the first waiter in `threadReleaseWaiters`, along with any others waiting to lock the
+  // same isolate, since those will coalesce with it. The rest stay queued until the lock taken by
+  // the first waiter is released in turn.
+
   friend class Worker::Isolate;
   friend class Worker::AsyncLock;
 };
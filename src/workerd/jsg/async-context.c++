@@ -9,6 +9,17 @@
 namespace workerd::jsg {
 
 namespace {
+constexpr uint MAX_FRAME_DEPTH = 16;
+// Length of a chain of frames at which a new frame copies the visible entries instead of
+// referencing its parent. See AsyncContextFrame.
+
+inline AsyncContextFrame* toPointer(kj::Maybe<AsyncContextFrame&> maybeFrame) {
+  KJ_IF_MAYBE(frame, maybeFrame) {
+    return frame;
+  }
+  return nullptr;
+}
+
 inline void maybeSetV8ContinuationContext(
     v8::Isolate* isolate,
     kj::Maybe<AsyncContextFrame&> maybeFrame) {
@@ -23,23 +34,50 @@ inline void maybeSetV8ContinuationContext(
 }  // namespace
 
 AsyncContextFrame::AsyncContextFrame(Lock& js, StorageEntry storageEntry) {
+  // Dead keys are extremely unlikely here, but let's handle them anyway just out of an excess of
+  // caution.
+  bool live = !storageEntry.key->isDead();
+
   KJ_IF_MAYBE(frame, current(js)) {
-    // Propagate the storage context of the current frame (if any).
-    // If current(js) returns nullptr, we assume we're in the root
-    // frame and there is no storage to propagate.
-    frame->storage.eraseAll([](const auto& entry) { return entry.key->isDead(); });
-    for (auto& entry : frame->storage) {
-      storage.insert(entry.clone(js));
+    // Inherit the storage context of the current frame (if any). If current(js) returns nullptr,
+    // we're in the root frame and there is no storage to inherit.
+    if (frame->depth < MAX_FRAME_DEPTH) {
+      parent = frame->addRef();
+      depth = frame->depth + 1;
+      if (live) entries = kj::arr(kj::mv(storageEntry));
+      return;
     }
-  }
 
-  // This case is extremely unlikely to happen but let's handle it anyway
-  // just out of an excess of caution.
-  if (storageEntry.key->isDead()) return;
+    // The chain is getting long, so start a new one with the entries that are still visible. There
+    // are rarely more than a handful of keys, so linear searches are fine.
+    kj::Vector<StorageEntry> visible;
+    if (live) visible.add(kj::mv(storageEntry));
+    AsyncContextFrame* ancestor = frame;
+    for (;;) {
+      for (auto& entry: ancestor->entries) {
+        if (entry.key->isDead()) continue;
+        bool shadowed = false;
+        for (auto& v: visible) {
+          if (v.key.get() == entry.key.get()) {
+            shadowed = true;
+            break;
+          }
+        }
+        if (!shadowed) visible.add(entry.clone(js));
+      }
+      KJ_IF_MAYBE(p, ancestor->parent) {
+        ancestor = p->get();
+      } else {
+        break;
+      }
+    }
+    depth = 1;
+    entries = visible.releaseAsArray();
+    return;
+  }
 
-  storage.upsert(kj::mv(storageEntry), [](StorageEntry& existing, StorageEntry&& row) mutable {
-    existing.value = kj::mv(row.value);
-  });
+  depth = 1;
+  if (live) entries = kj::arr(kj::mv(storageEntry));
 }
 
 kj::Maybe<AsyncContextFrame&> AsyncContextFrame::current(Lock& js) {
@@ -54,12 +92,17 @@ kj::Maybe<Ref<AsyncContextFrame>> AsyncContextFrame::currentRef(Lock& js) {
 
 kj::Maybe<AsyncContextFrame&> AsyncContextFrame::current(v8::Isolate* isolate) {
   auto value = isolate->GetCurrentContext()->GetContinuationPreservedEmbedderData();
-  KJ_IF_MAYBE(wrappable, Wrappable::tryUnwrapOpaque(isolate, value)) {
-    AsyncContextFrame* frame = dynamic_cast<AsyncContextFrame*>(wrappable);
-    KJ_ASSERT(frame != nullptr);
-    return *frame;
+  if (!value->IsObject()) {
+    // The root frame.
+    return nullptr;
   }
-  return nullptr;
+
+  // Only frames' own wrappers are ever set as the continuation data (see
+  // maybeSetV8ContinuationContext()), so we can skip the prototype chain search done by
+  // Wrappable::tryUnwrapOpaque().
+  auto wrappable = reinterpret_cast<Wrappable*>(value.As<v8::Object>()
+      ->GetAlignedPointerFromInternalField(Wrappable::WRAPPED_OBJECT_FIELD_INDEX));
+  return kj::downcast<AsyncContextFrame>(*wrappable);
 }
 
 Ref<AsyncContextFrame> AsyncContextFrame::create(Lock& js, StorageEntry storageEntry) {
@@ -146,8 +189,19 @@ v8::Local<v8::Function> AsyncContextFrame::wrapRoot(
 
 kj::Maybe<Value&> AsyncContextFrame::get(StorageKey& key) {
   KJ_ASSERT(!key.isDead());
-  storage.eraseAll([](const auto& entry) { return entry.key->isDead(); });
-  return storage.find(key).map([](auto& entry) -> Value& { return entry.value; });
+  AsyncContextFrame* frame = this;
+  for (;;) {
+    for (auto& entry: frame->entries) {
+      if (entry.key.get() == &key) {
+        return entry.value;
+      }
+    }
+    KJ_IF_MAYBE(p, frame->parent) {
+      frame = p->get();
+    } else {
+      return nullptr;
+    }
+  }
 }
 
 AsyncContextFrame::Scope::Scope(Lock& js, kj::Maybe<AsyncContextFrame&> resource)
@@ -155,8 +209,11 @@ AsyncContextFrame::Scope::Scope(Lock& js, kj::Maybe<AsyncContextFrame&> resource
 
 AsyncContextFrame::Scope::Scope(v8::Isolate* ptr, kj::Maybe<AsyncContextFrame&> maybeFrame)
     : isolate(ptr),
-      prior(AsyncContextFrame::current(ptr)) {
-  maybeSetV8ContinuationContext(isolate, maybeFrame);
+      prior(AsyncContextFrame::current(ptr)),
+      changed(toPointer(prior) != toPointer(maybeFrame)) {
+  if (changed) {
+    maybeSetV8ContinuationContext(isolate, maybeFrame);
+  }
 }
 
 AsyncContextFrame::Scope::Scope(Lock& js, kj::Maybe<Ref<AsyncContextFrame>>& resource)
@@ -165,7 +222,9 @@ AsyncContextFrame::Scope::Scope(Lock& js, kj::Maybe<Ref<AsyncContextFrame>>& res
     })) {}
 
 AsyncContextFrame::Scope::~Scope() noexcept(false) {
-  maybeSetV8ContinuationContext(isolate, prior);
+  if (changed) {
+    maybeSetV8ContinuationContext(isolate, prior);
+  }
 }
 
 AsyncContextFrame::StorageScope::StorageScope(
@@ -190,7 +249,8 @@ v8::Local<v8::Object> AsyncContextFrame::getJSWrapper(Lock& js) {
 }
 
 void AsyncContextFrame::jsgVisitForGc(GcVisitor& visitor) {
-  for (auto& entry : storage) {
+  visitor.visit(parent);
+  for (auto& entry : entries) {
     visitor.visit(entry.value);
   }
 }
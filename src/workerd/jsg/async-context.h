@@ -42,7 +42,13 @@ class AsyncContextFrame final: public Wrappable {
   //
   // All frames (except for the Root) are created within the scope of a parent, which by
   // default is whichever frame is current when the new frame is created. When the new frame
-  // is created, it inherits a copy storage context of the parent.
+  // is created, it inherits the storage context of the parent.
+  //
+  // Frames are immutable, so rather than copying the parent's storage context, a new frame holds
+  // a reference to its parent plus the one entry it adds, and lookups walk up the chain. This
+  // makes creating a frame (e.g. for every AsyncLocalStorage.run()) cost a single allocation no
+  // matter how many storage cells are in use. To keep lookups cheap, a frame created at the end
+  // of a long chain instead copies the entries that are still visible, and starts a new chain.
   //
   // To implement all of this, however, we depend largely on an obscure v8 API on the
   // v8::Context object called SetContinuationPreservedEmbedderData and
@@ -73,9 +79,9 @@ public:
     // The StorageKey is typically owned by an instance of AsyncLocalStorage (see
     // the api/node/async-hooks.h). When the ALS instance is garbage collected, it
     // must call reset to signal that this StorageKey is "dead" and can never be
-    // looked up again. Subsequent accesses to a frame will remove dead keys from
-    // the frame lazily. The lazy cleanup does mean that values may persist in
-    // memory a bit longer so if it proves to be problematic we can make the cleanup
+    // looked up again. Frames are immutable, so values stored under a dead key
+    // stay in memory until the frames holding them are collected or a new frame
+    // compacts the chain. If that proves to be problematic we can make the cleanup
     // a bit more proactive.
     //
     // TODO(later): We should also evaluate the relatively unlikely case where an
@@ -146,6 +152,9 @@ public:
     // stack until the scope is destroyed.
     v8::Isolate* isolate;
     kj::Maybe<AsyncContextFrame&> prior;
+    bool changed;
+    // False if the frame was already current, in which case there's nothing to restore. This is
+    // the common case for code that doesn't use AsyncLocalStorage.
     Scope(Lock& js, kj::Maybe<AsyncContextFrame&> frame = nullptr);
     Scope(v8::Isolate* isolate, kj::Maybe<AsyncContextFrame&> frame = nullptr);
     Scope(Lock& js, kj::Maybe<Ref<AsyncContextFrame>>& frame);
@@ -176,22 +185,15 @@ public:
   };
 
 private:
-  struct StorageEntryCallbacks {
-    StorageKey& keyForRow(StorageEntry& entry) const {
-      return *entry.key;
-    }
-
-    bool matches(const StorageEntry& entry, StorageKey& key) const {
-      return entry.key.get() == &key;
-    }
+  kj::Maybe<Ref<AsyncContextFrame>> parent;
+  // The frame this one inherits storage from, or null if it inherits from the root (or copied its
+  // parent's entries).
 
-    uint hashCode(StorageKey& key) const {
-      return key.hashCode();
-    }
-  };
+  kj::Array<StorageEntry> entries;
+  // Entries that this frame adds or overrides. Usually just one.
 
-  using Storage = kj::Table<StorageEntry, kj::HashIndex<StorageEntryCallbacks>>;
-  Storage storage;
+  uint depth;
+  // Number of frames in the chain ending at this one, including this one.
 
   void jsgVisitForGc(GcVisitor& visitor) override;
 
@@ -55,11 +55,16 @@ struct BufferSourceContext: public Object {
     return BufferSource(js, BackingStore::alloc<v8::ArrayBuffer>(js, 3));
   }
 
+  BufferSource makeEmptyBufferSource(jsg::Lock& js) {
+    return BufferSource(js, BackingStore::from(kj::Array<kj::byte>()));
+  }
+
   JSG_RESOURCE_TYPE(BufferSourceContext) {
     JSG_METHOD(takeBufferSource);
     JSG_METHOD(takeUint8Array);
     JSG_METHOD(makeBufferSource);
     JSG_METHOD(makeArrayBuffer);
+    JSG_METHOD(makeEmptyBufferSource);
   }
 };
 JSG_DECLARE_ISOLATE_TYPE(BufferSourceIsolate, BufferSourceContext);
@@ -79,6 +84,11 @@ KJ_TEST("BufferSource works") {
       "boolean",
       "true");
 
+  e.expectEval(
+      "const u8 = makeEmptyBufferSource(); u8.byteLength === 0 && u8.buffer.byteLength === 0",
+      "boolean",
+      "true");
+
   e.expectEval(
       "const ab = new ArrayBuffer(9); takeBufferSource(new Uint8Array(ab, 1, 8)).byteLength === 8",
       "boolean",
@@ -75,13 +75,8 @@ public:
   static BackingStore from(kj::Array<kj::byte> data) {
     // Creates a new BackingStore that takes over ownership of the given kj::Array.
     size_t size = data.size();
-    auto ptr = new kj::Array<byte>(kj::mv(data));
     return BackingStore(
-        v8::ArrayBuffer::NewBackingStore(
-            ptr->begin(), size,
-            [](void*, size_t, void* ptr) {
-              delete reinterpret_cast<kj::Array<byte>*>(ptr);
-            }, ptr),
+        newBackingStore(kj::mv(data)),
         size, 0,
         getBufferSourceElementSize<T>(), construct<T>,
         checkIsIntegerType<T>());
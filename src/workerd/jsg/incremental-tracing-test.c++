@@ -0,0 +1,133 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+// Exercises wrapper tracing with incremental marking enabled. `--stress-incremental-marking` makes
+// V8 start a marking cycle as soon as it can, so most of the reference changes below happen while
+// one is in progress.
+
+#include "jsg-test.h"
+
+namespace workerd::jsg::test {
+namespace {
+
+V8System v8System({"--expose-gc"_kj, "--incremental-marking"_kj,
+                   "--stress-incremental-marking"_kj});
+
+class Holder: public Object {
+  // Holds a NumberBox and a JavaScript value, and implements GC visitation.
+
+public:
+  Holder(Ref<NumberBox> box, Value value): box(kj::mv(box)), value(kj::mv(value)) { ++count; }
+  ~Holder() noexcept(false) { --count; }
+
+  static inline uint count = 0;
+  // Number of Holders currently alive.
+
+  static Ref<Holder> constructor(Ref<NumberBox> box, Value value) {
+    return jsg::alloc<Holder>(kj::mv(box), kj::mv(value));
+  }
+
+  Ref<NumberBox> getBox() { return box.addRef(); }
+  void setBox(Ref<NumberBox> newBox) { box = kj::mv(newBox); }
+
+  Value getValue(Lock& js) { return value.addRef(js); }
+  void setValue(Value newValue) { value = kj::mv(newValue); }
+
+  JSG_RESOURCE_TYPE(Holder) {
+    JSG_PROTOTYPE_PROPERTY(box, getBox, setBox);
+    JSG_PROTOTYPE_PROPERTY(value, getValue, setValue);
+  }
+
+private:
+  Ref<NumberBox> box;
+  Value value;
+
+  void visitForGc(GcVisitor& visitor) {
+    visitor.visit(box, value);
+  }
+};
+
+struct IncrementalTracingContext: public Object {
+  Ref<Holder> makeNested(Lock& js, double n) {
+    // Builds a holder whose box and value were never exported to JavaScript, so they are only
+    // reachable by tracing through the holder once its wrapper exists.
+    auto array = v8::Array::New(js.v8Isolate, 1);
+    check(array->Set(js.v8Context(), 0, v8::Number::New(js.v8Isolate, n)));
+    return jsg::alloc<Holder>(jsg::alloc<NumberBox>(n), js.v8Ref(array.As<v8::Value>()));
+  }
+
+  kj::Maybe<Ref<Holder>> stash;
+  // A strong reference from C++, which may be set and cleared from JavaScript.
+
+  void setStash(jsg::Optional<Ref<Holder>> holder) { stash = kj::mv(holder); }
+
+  uint countHolders() { return Holder::count; }
+
+  JSG_RESOURCE_TYPE(IncrementalTracingContext) {
+    JSG_NESTED_TYPE(NumberBox);
+    JSG_NESTED_TYPE(Holder);
+    JSG_METHOD(makeNested);
+    JSG_METHOD(setStash);
+    JSG_METHOD(countHolders);
+  }
+};
+JSG_DECLARE_ISOLATE_TYPE(IncrementalTracingIsolate, IncrementalTracingContext, NumberBox, Holder);
+
+KJ_TEST("references changed during incremental marking stay alive") {
+  Evaluator<IncrementalTracingContext, IncrementalTracingIsolate> e(v8System);
+
+  e.expectEval(R"(
+    const holders = [];
+    for (let i = 0; i < 2000; i++) {
+      // Allocate enough garbage along the way that marking steps run in between.
+      const garbage = new Array(64).fill({ i });
+      const holder = i % 2 ? makeNested(i) : new Holder(new NumberBox(i), [i]);
+      holders.push(holder);
+
+      // Move references between holders which may already have been traced.
+      if (i >= 10) {
+        const other = holders[i - 10];
+        const box = other.box;
+        other.box = holder.box;
+        holder.box = box;
+        other.value = [other.value[0]];
+      }
+
+      // Hand an object to C++ and take it back, flipping its references between strong and
+      // traced.
+      setStash(holder);
+      setStash();
+    }
+
+    gc();
+    gc();
+
+    let sum = 0;
+    for (const holder of holders) {
+      sum += holder.box.value + holder.value[0];
+    }
+    sum
+  )", "number", kj::str(2 * (1999 * 2000 / 2)));
+}
+
+KJ_TEST("unreachable objects are still collected with incremental marking") {
+  Evaluator<IncrementalTracingContext, IncrementalTracingIsolate> e(v8System);
+
+  e.expectEval(R"(
+    const before = countHolders();
+    let chain = [];
+    for (let i = 0; i < 1000; i++) {
+      const holder = makeNested(i);
+      holder.value = chain;
+      chain = [holder, new Array(64).fill(i)];
+    }
+    chain = null;
+    gc();
+    gc();
+    countHolders() - before
+  )", "number", "0");
+}
+
+}  // namespace
+}  // namespace workerd::jsg::test
@@ -805,6 +805,15 @@ private:
     }));
   }
 
+  Promise<Next> handleNext(Lock& js, kj::Maybe<Type> maybeResult) {
+    KJ_IF_MAYBE(result, maybeResult) {
+      return js.resolvedPromise(Next { .done = false, .value = kj::mv(*result) });
+    } else {
+      state.template init<Finished>();
+      return js.resolvedPromise(Next { .done = true });
+    }
+  }
+
   Promise<Next> nextImpl(Lock& js, NextSignature nextFunc) {
     KJ_SWITCH_ONEOF(state) {
       KJ_CASE_ONEOF(finished, Finished) {
@@ -826,15 +835,17 @@ private:
             }
             KJ_CASE_ONEOF(inner, InnerState) {
               auto promise = nextFunc(js, inner.state);
+              KJ_IF_MAYBE(maybeResult, promise.tryConsumeResolved(js)) {
+                // The value was available synchronously, as it is whenever the source has data
+                // buffered. There is nothing for later calls to wait on, so we can skip the
+                // bookkeeping and the continuation, making each step of a `for await` over
+                // buffered data cost one promise resolution instead of several.
+                return handleNext(js, kj::mv(*maybeResult));
+              }
               pushCurrent(js, promise.whenResolved());
               return promise.then(js,
                   [this, self = kj::mv(self)](Lock& js, kj::Maybe<Type> maybeResult) mutable {
-                KJ_IF_MAYBE(result, maybeResult) {
-                  return js.resolvedPromise(Next { .done = false, .value = kj::mv(*result) });
-                } else {
-                  state.template init<Finished>();
-                  return js.resolvedPromise(Next { .done = true });
-                }
+                return handleNext(js, kj::mv(maybeResult));
               });
             }
           }
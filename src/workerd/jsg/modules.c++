@@ -342,12 +342,22 @@ void instantiateModule(jsg::Lock& js, v8::Local<v8::Module>& module) {
 // ===================================================================================
 
 namespace {
+void addToCodeCache(const ModuleCodeCache& cache, kj::ArrayPtr<const char> content,
+                    v8::Local<v8::Module> module) {
+  auto cachedData = std::unique_ptr<v8::ScriptCompiler::CachedData>(
+      v8::ScriptCompiler::CreateCodeCache(module->GetUnboundModuleScript()));
+  if (cachedData != nullptr && cachedData->length > 0) {
+    cache.add(content, kj::arrayPtr(cachedData->data, cachedData->length));
+  }
+}
+
 v8::Local<v8::Module> compileEsmModule(
     jsg::Lock& js,
     kj::StringPtr name,
     kj::ArrayPtr<const char> content,
     ModuleInfoCompileOption option,
-    const CompilationObserver& observer) {
+    const CompilationObserver& observer,
+    kj::Maybe<const ModuleCodeCache&> codeCache) {
   // destroy the observer after compilation finished to indicate the end of the process.
   auto compilationObserver = observer.onEsmCompilationStart(js.v8Isolate, name, option);
 
@@ -397,6 +407,30 @@ v8::Local<v8::Module> compileEsmModule(
 
   contentStr = jsg::v8Str(js.v8Isolate, content);
 
+  KJ_IF_MAYBE(cache, codeCache) {
+    KJ_IF_MAYBE(data, cache->find(content)) {
+      // The Source takes ownership of the CachedData object, but not of the buffer, which
+      // `data` keeps alive until we return.
+      v8::ScriptCompiler::Source source(contentStr, origin,
+          new v8::ScriptCompiler::CachedData(data->begin(), data->size(),
+              v8::ScriptCompiler::CachedData::BufferNotOwned));
+      auto module = jsg::check(v8::ScriptCompiler::CompileModule(
+          js.v8Isolate, &source, v8::ScriptCompiler::kConsumeCodeCache));
+      if (!source.GetCachedData()->rejected) {
+        return module;
+      }
+      // V8 rejected the cached data (e.g. because it was produced by a different V8 version or
+      // with different flags) and compiled from source instead. Replace the stale entry.
+      addToCodeCache(*cache, content, module);
+      return module;
+    }
+
+    v8::ScriptCompiler::Source source(contentStr, origin);
+    auto module = jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source));
+    addToCodeCache(*cache, content, module);
+    return module;
+  }
+
   v8::ScriptCompiler::Source source(contentStr, origin);
   auto module = jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source));
 
@@ -434,8 +468,9 @@ ModuleRegistry::ModuleInfo::ModuleInfo(
     kj::StringPtr name,
     kj::ArrayPtr<const char> content,
     ModuleInfoCompileOption flags,
-    const CompilationObserver& observer)
-    : ModuleInfo(js, compileEsmModule(js, name, content, flags, observer)) {}
+    const CompilationObserver& observer,
+    kj::Maybe<const ModuleCodeCache&> codeCache)
+    : ModuleInfo(js, compileEsmModule(js, name, content, flags, observer, codeCache)) {}
 
 ModuleRegistry::ModuleInfo::ModuleInfo(
     jsg::Lock& js,
@@ -183,6 +183,23 @@ v8::Local<v8::WasmModuleObject> compileWasmModule(jsg::Lock& js,
     kj::ArrayPtr<const uint8_t> code,
     const CompilationObserver& observer);
 
+class ModuleCodeCache {
+  // Holds V8 code cache data for ES modules compiled from worker bundles, keyed by the module's
+  // source content. When one is provided, module compilation consults the cache first and
+  // populates it after a miss, so that identical modules compiled in other isolates (or, for
+  // persistent implementations, in later processes) can skip parsing and compiling from scratch.
+  //
+  // All methods may be called from any thread, with any isolate lock held.
+public:
+  virtual kj::Maybe<kj::Array<const kj::byte>> find(kj::ArrayPtr<const char> content) const = 0;
+  // Returns the cached data previously added for `content`, if any. The data is not guaranteed
+  // to be accepted by V8 (e.g. it may have been produced by a different V8 version or flag set),
+  // in which case the caller will recompile and `add()` fresh data.
+
+  virtual void add(kj::ArrayPtr<const char> content, kj::ArrayPtr<const kj::byte> data) const = 0;
+  // Records cached data for `content`, replacing any previous entry.
+};
+
 class ModuleRegistry {
   // The ModuleRegistry maintains the collection of modules known to a script that can be
   // required or imported.
@@ -253,6 +270,8 @@ public:
       v8::ScriptCompiler::Source source(v8Str(lock.v8Isolate, content), origin);
       auto context = lock.v8Context();
       auto handle = lock.wrap(context, moduleContext.addRef());
+      // No compile options: V8 only pre-parses the functions the module body defines, compiling
+      // each one the first time it's called, so large bundles don't pay for unused code up front.
       auto fn = jsg::check(v8::ScriptCompiler::CompileFunction(
           context,
           &source,
@@ -332,7 +351,8 @@ public:
                kj::StringPtr name,
                kj::ArrayPtr<const char> content,
                ModuleInfoCompileOption flags,
-               const CompilationObserver& observer);
+               const CompilationObserver& observer,
+               kj::Maybe<const ModuleCodeCache&> codeCache = nullptr);
 
     ModuleInfo(jsg::Lock& js, kj::StringPtr name,
                kj::Maybe<kj::ArrayPtr<kj::StringPtr>> maybeExports,
@@ -381,6 +401,13 @@ public:
     entries.insert(Entry(specifier, Type::BUNDLE, kj::fwd<ModuleInfo>(info)));
   }
 
+  void add(kj::Path& specifier, kj::Function<ModuleInfo(Lock&)> factory) {
+    // Register a worker bundle module that is compiled the first time it's resolved, by
+    // calling `factory`. Until then, the registry holds only the factory, so modules the
+    // application never imports are never compiled.
+    entries.insert(Entry(specifier, Type::BUNDLE, kj::mv(factory)));
+  }
+
   void addBuiltinBundle(Bundle::Reader bundle) {
     for (auto module: bundle.getModules()) {
       // TODO: asChars() might be wrong for wide characters
@@ -544,7 +571,8 @@ private:
     kj::Path specifier;
     Type type;
     Info info;
-    // Either instantiated module or module source code.
+    // Either instantiated module, or builtin module source code or a factory to compile it with
+    // on first resolve.
 
     Entry(const kj::Path& specifier, Type type, ModuleInfo info)
         : specifier(specifier.clone()),
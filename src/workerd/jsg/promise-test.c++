@@ -91,6 +91,25 @@ struct PromiseContext: public Object {
     }
   }
 
+  int consumeSettled(Promise<int> promise) {
+    // Returns the value if the promise was already resolved when it was unwrapped, -1 otherwise.
+    KJ_IF_MAYBE(value, promise.tryConsumeResolved()) {
+      return *value;
+    } else {
+      return -1;
+    }
+  }
+
+  void catchMismatch(Lock& js, Promise<int> promise) {
+    promise.then(js, [](Lock& js, int i) {
+      return kj::str("resolved: ", i);
+    }, [](Lock& js, Value value) {
+      return kj::str(value.getHandle(js.v8Isolate));
+    }).then([](kj::String s) {
+      catchTestResult = kj::mv(s);
+    });
+  }
+
   JSG_RESOURCE_TYPE(PromiseContext) {
     JSG_READONLY_PROTOTYPE_PROPERTY(promise, makePromise);
     JSG_METHOD(resolvePromise);
@@ -102,6 +121,8 @@ struct PromiseContext: public Object {
 
     JSG_METHOD(testConsumeResolved);
     JSG_METHOD(whenResolved);
+    JSG_METHOD(consumeSettled);
+    JSG_METHOD(catchMismatch);
   }
 
   kj::Maybe<Promise<int>::Resolver> resolver;
@@ -172,5 +193,42 @@ KJ_TEST("whenResolved") {
   e.expectEval("whenResolved(Promise.resolve(1))", "undefined", "undefined");
 }
 
+KJ_TEST("already-settled promises") {
+  Evaluator<PromiseContext, PromiseIsolate> e(v8System);
+
+  // A promise that is already fulfilled with a primitive is unwrapped immediately...
+  e.expectEval("consumeSettled(Promise.resolve(5))", "number", "5");
+
+  // ... but not if it is pending, or fulfilled with an object, since unwrapping that could run
+  // user code.
+  e.expectEval("consumeSettled(new Promise(() => {}))", "number", "-1");
+  e.expectEval("consumeSettled(Promise.resolve({ valueOf() { return 5; } }))", "number", "-1");
+
+  // Conversion errors must still be reported as a rejection, not a synchronous exception.
+  e.expectEval("catchMismatch(Promise.resolve(Symbol()))", "undefined", "undefined");
+  e.runMicrotasks();
+  KJ_EXPECT(catchTestResult.startsWith("TypeError"), catchTestResult);
+  catchTestResult = nullptr;
+
+  // That includes primitives the fast path tries to unwrap but can't: a BigInt can't be
+  // converted to a number, and 2**40 is out of range for an int.
+  e.expectEval("catchMismatch(Promise.resolve(1n))", "undefined", "undefined");
+  e.runMicrotasks();
+  KJ_EXPECT(catchTestResult.startsWith("TypeError"), catchTestResult);
+  catchTestResult = nullptr;
+
+  e.expectEval("catchMismatch(Promise.resolve(2**40))", "undefined", "undefined");
+  e.runMicrotasks();
+  KJ_EXPECT(catchTestResult.startsWith("TypeError: Value out of range"), catchTestResult);
+  catchTestResult = nullptr;
+
+  // C++ continuations on already-settled promises still run asynchronously.
+  e.expectEval("catchIt(Promise.reject('foo'))", "undefined", "undefined");
+  KJ_EXPECT(catchTestResult == nullptr);
+  e.runMicrotasks();
+  KJ_EXPECT(catchTestResult == "Error: foo");
+  catchTestResult = nullptr;
+}
+
 }  // namespace
 }  // namespace workerd::jsg::test
@@ -486,17 +486,32 @@ private:
     auto context = js.v8Context();
 
     auto funcPairHandle = wrapOpaque(context, kj::mv(funcPair));
+    auto promise = consumeHandle(js);
 
-    auto then = check(v8::Function::New(
-        context, thenCallback, funcPairHandle, 1, v8::ConstructorBehavior::kThrow));
-
-    auto errThen = check(v8::Function::New(
-        context, errCallback, funcPairHandle, 1, v8::ConstructorBehavior::kThrow));
+    auto newCallback = [&](v8::FunctionCallback callback) {
+      return check(v8::Function::New(
+          context, callback, funcPairHandle, 1, v8::ConstructorBehavior::kThrow));
+    };
 
     using Type = RemovePromise<Result>;
 
+    // If the promise has already settled, only one of the two callbacks can ever run, so don't
+    // bother allocating the other one. This is common for things like cache hits, where a chain
+    // of continuations is attached to an immediately-resolved promise. Note that the continuation
+    // still runs as a microtask, as required for correct ordering; we only save an allocation.
+    switch (promise->State()) {
+      case v8::Promise::kFulfilled:
+        return Promise<Type>(js.v8Isolate,
+            check(promise->Then(context, newCallback(thenCallback))));
+      case v8::Promise::kRejected:
+        return Promise<Type>(js.v8Isolate,
+            check(promise->Catch(context, newCallback(errCallback))));
+      case v8::Promise::kPending:
+        break;
+    }
+
     return Promise<Type>(js.v8Isolate,
-        check(consumeHandle(js)->Then(context, then, errThen)));
+        check(promise->Then(context, newCallback(thenCallback), newCallback(errCallback))));
   }
 
   friend class Lock;
@@ -671,6 +686,22 @@ public:
     // the object whose method returned the promise will not be destroyed while the promise is
     // still executing.
     auto markedAsHandled = promise.markedAsHandled;
+
+    if constexpr (!isVoid<T>() && !isV8Ref<T>()) {
+      // If the C++ promise has already been fulfilled, convert the value now and return an
+      // already-resolved promise, saving a function allocation and a trip through the microtask
+      // queue. (Void and V8Ref promises don't need conversion but still go the slow route, since
+      // we'd still need to allocate a new promise either way.)
+      auto& js = Lock::from(context->GetIsolate());
+      KJ_IF_MAYBE(value, promise.tryConsumeResolved(js)) {
+        auto& wrapper = *static_cast<TypeWrapper*>(this);
+        auto handle = wrapper.wrap(context, creator, kj::mv(*value));
+        auto resolver = check(v8::Promise::Resolver::New(context));
+        check(resolver->Resolve(context, handle));
+        return resolver->GetPromise();
+      }
+    }
+
     auto then = check(v8::Function::New(context,
         &thenWrap<TypeWrapper, T>, creator.orDefault({}), 1, v8::ConstructorBehavior::kThrow));
 
@@ -693,13 +724,31 @@ public:
     if (handle->IsPromise()) {
       auto promise = handle.As<v8::Promise>();
       if constexpr (!isVoid<T>() && !isV8Ref<T>()) {
+        if (promise->State() == v8::Promise::kFulfilled) {
+          // The promise has already been fulfilled, so unwrap the result now instead of adding a
+          // .then(). We only do this for primitive results: unwrapping an object may run user
+          // code (getters, etc.) which must not happen synchronously here. A primitive of the
+          // wrong type must still turn into a rejection rather than a synchronous error, so if
+          // unwrapping fails or throws (e.g. a number out of range, or a BigInt where a number
+          // is expected), we fall through to the slow path below, which rejects with the error.
+          auto result = promise->Result();
+          if (!result->IsObject()) {
+            auto& wrapper = *static_cast<TypeWrapper*>(this);
+            auto& js = Lock::from(context->GetIsolate());
+            kj::Maybe<T> maybeValue = js.tryCatch([&]() {
+              return wrapper.tryUnwrap(context, result, (T*)nullptr, parentObject);
+            }, [](Value&&) -> kj::Maybe<T> {
+              return nullptr;
+            });
+            KJ_IF_MAYBE(value, maybeValue) {
+              return resolvedPromise<T>(context->GetIsolate(), kj::mv(*value));
+            }
+          }
+        }
+
         // Add a .then() to unwrap the promise's resolution (i.e. convert it from JS to C++).
         // Note that we don't need to handle the rejection case here as there is no wrapping
         // applied to exception values, so we just let it propagate through.
-        //
-        // TODO(perf): We could in theory check if promise->State() is kFulfilled and, in that
-        //   case, pull out promise->Result(), unwrap it, and make a new immediate promise.
-        //   Similarly in `wrap()`. Not clear if the added complexity is worth it, though.
         auto then = check(v8::Function::New(context,
             &thenUnwrap<TypeWrapper, T>, {}, 1, v8::ConstructorBehavior::kThrow));
         promise = check(promise->Then(context, then));
@@ -624,5 +624,56 @@ KJ_TEST("Methods can take Lock& as first parameter") {
   e.expectEval("let t = new Thingy(123); t.val", "number", "123");
 }
 
+// ========================================================================================
+
+struct FastMethodContext: public Object {
+  struct Counter: public Object {
+    static Ref<Counter> constructor() { return jsg::alloc<Counter>(); }
+
+    double add(double a, int32_t b) {
+      ++calls;
+      return a + b;
+    }
+
+    void check(int32_t value) {
+      JSG_REQUIRE(value >= 0, RangeError, "value must not be negative");
+    }
+
+    kj::String describe(kj::String prefix) { return kj::str(prefix, calls); }
+    // Not eligible for a fast call; JSG_FAST_METHOD falls back to a regular method.
+
+    uint32_t getCalls() { return calls; }
+
+    uint32_t calls = 0;
+
+    JSG_RESOURCE_TYPE(Counter) {
+      JSG_FAST_METHOD(add);
+      JSG_FAST_METHOD(check);
+      JSG_FAST_METHOD(describe);
+      JSG_READONLY_INSTANCE_PROPERTY(calls, getCalls);
+    }
+  };
+
+  JSG_RESOURCE_TYPE(FastMethodContext) {
+    JSG_NESTED_TYPE(Counter);
+  }
+};
+JSG_DECLARE_ISOLATE_TYPE(FastMethodIsolate, FastMethodContext, FastMethodContext::Counter);
+
+KJ_TEST("JSG_FAST_METHOD") {
+  Evaluator<FastMethodContext, FastMethodIsolate> e(v8System);
+  e.expectEval(
+      "let c = new Counter(); let sum = 0;\n"
+      "for (let i = 0; i < 100000; i++) sum = c.add(sum, 1);\n"
+      "[sum, c.calls].join()", "string", "100000,100000");
+  e.expectEval(
+      "let c = new Counter(); for (let i = 0; i < 100000; i++) c.check(i); c.check(-1)",
+      "throws", "RangeError: value must not be negative");
+  e.expectEval("let c = new Counter(); c.add(1, 2); c.describe('calls: ')", "string", "calls: 1");
+  e.expectEval(
+      "Counter.prototype.add.call({}, 1, 2)", "throws",
+      "TypeError: Illegal invocation");
+}
+
 }  // namespace
 }  // namespace workerd::jsg::test
@@ -18,6 +18,7 @@
 #include "wrappable.h"
 #include "jsg.h"
 #include <typeindex>
+#include <v8-fast-api-calls.h>
 
 namespace std {
   inline auto KJ_HASHCODE(const std::type_index& idx) {
@@ -324,6 +325,55 @@ struct MethodCallback<TypeWrapper, methodName, isContext,
   }
 };
 
+template <typename T>
+constexpr bool isFastApiType = std::is_same_v<T, bool> ||
+                               std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t> ||
+                               std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t> ||
+                               std::is_same_v<T, float> || std::is_same_v<T, double>;
+// Types which V8 fast API calls can pass or return directly.
+
+template <typename TypeWrapper, const char* methodName, bool isContext,
+          typename T, typename Method, Method method>
+struct FastMethodCallback {
+  // Implements the V8 fast API call for a JSG_FAST_METHOD. This primary template is used for
+  // methods whose signature isn't supported by fast API calls.
+  static constexpr bool supported = false;
+};
+
+template <typename TypeWrapper, const char* methodName, bool isContext,
+          typename T, typename U, typename Ret, typename... Args, Ret (U::*method)(Args...)>
+struct FastMethodCallback<TypeWrapper, methodName, isContext, T, Ret (U::*)(Args...), method> {
+  // Fast API calls can't give us a context, so methods of the global scope are excluded.
+  static constexpr bool supported = !isContext &&
+      (isVoid<Ret>() || isFastApiType<Ret>) && (isFastApiType<Args> && ...);
+
+  static Ret callback(v8::Local<v8::Object> receiver, Args... args,
+                      v8::FastApiCallbackOptions& options) {
+    // We can't throw here, and we must not touch the V8 heap, so on any problem we ask V8 to
+    // fall back to the slow path, which will redo the call and report the error properly.
+    if (receiver->InternalFieldCount() != Wrappable::INTERNAL_FIELD_COUNT) {
+      options.fallback = true;
+      return Ret();
+    }
+    auto& self = *reinterpret_cast<T*>(receiver->GetAlignedPointerFromInternalField(
+        Wrappable::WRAPPED_OBJECT_FIELD_INDEX));
+
+    if constexpr(isVoid<Ret>()) {
+      KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() { (self.*method)(args...); })) {
+        options.fallback = true;
+      }
+    } else {
+      Ret result = Ret();
+      KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+        result = (self.*method)(args...);
+      })) {
+        options.fallback = true;
+      }
+      return result;
+    }
+  }
+};
+
 template <typename TypeWrapper, const char* methodName,
           typename T, typename Method, Method* method, typename Indexes>
 struct StaticMethodCallback;
@@ -712,6 +762,21 @@ struct ResourceTypeBuilder {
         v8::Local<v8::Value>(), signature, 0, v8::ConstructorBehavior::kThrow));
   }
 
+  template<const char* name, typename Method, Method method>
+  inline void registerFastMethod() {
+    using Fast = FastMethodCallback<TypeWrapper, name, isContext, Self, Method, method>;
+    if constexpr (Fast::supported) {
+      static const v8::CFunction cFunction = v8::CFunction::Make(&Fast::callback);
+      prototype->Set(isolate, name, v8::FunctionTemplate::New(isolate,
+          &MethodCallback<TypeWrapper, name, isContext, Self, Method, method,
+                          ArgumentIndexes<Method>>::callback,
+          v8::Local<v8::Value>(), signature, 0, v8::ConstructorBehavior::kThrow,
+          v8::SideEffectType::kHasSideEffect, &cFunction));
+    } else {
+      registerMethod<name, Method, method>();
+    }
+  }
+
   template<const char* name, typename Method, Method method>
   inline void registerStaticMethod() {
     // Notably, we specify an empty signature because a static method invocation will have no holder
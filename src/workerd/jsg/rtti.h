@@ -487,6 +487,9 @@ struct MemberCounter {
   template<const char* name, typename Method, Method method>
   inline void registerMethod() { ++count; }
 
+  template<const char* name, typename Method, Method method>
+  inline void registerFastMethod() { ++count; }
+
   template<typename Method, Method method>
   inline void registerCallable() { /* not a member */ }
 
@@ -652,6 +655,12 @@ struct MembersBuilder {
     TupleRttiBuilder<Configuration, Args>::build(method.initArgs(std::tuple_size_v<Args>), rtti);
   }
 
+  template<const char* name, typename Method, Method method>
+  inline void registerFastMethod() {
+    // The fast path is an implementation detail; the type is the same as a regular method.
+    registerMethod<name, Method, method>();
+  }
+
   template<typename Method, Method method>
   inline void registerCallable() {
     auto func = structure.initCallable();
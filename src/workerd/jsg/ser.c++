@@ -3,12 +3,380 @@
 //     https://opensource.org/licenses/Apache-2.0
 
 #include "ser.h"
+#include <kj/map.h>
 
 namespace workerd::jsg {
 
+namespace {
+
+// -----------------------------------------------------------------------------
+// Compact format
+//
+// Written by Serializer when Options::compact is set and the value allows it. The format is:
+//
+//   COMPACT_FORMAT_TAG COMPACT_FORMAT_VERSION value
+//
+// where each value is a CompactTag followed by:
+//
+//   INT32: the zigzag-encoded value as a varint
+//   DOUBLE: the value's 8 bytes, little-endian
+//   ONE_BYTE_STRING: the length as a varint, then Latin-1 characters
+//   TWO_BYTE_STRING: the length in bytes as a varint, then UTF-16 code units; preceded by a
+//       PADDING byte if needed so that the code units start at an even offset
+//   OBJECT: the property count as a varint, then a string and a value for each property
+//   ARRAY: the length as a varint, then the elements
+//
+// and nothing for the rest. Varints are unsigned LEB128.
+
+constexpr kj::byte COMPACT_FORMAT_TAG = 0xFE;
+// V8's output starts either with its version tag (0xFF) or, if the header is omitted, with one of
+// its value tags, none of which is 0xFE.
+
+constexpr kj::byte COMPACT_FORMAT_VERSION = 1;
+
+enum class CompactTag: kj::byte {
+  PADDING = 0,
+  UNDEFINED = '_',
+  NULL_ = '0',
+  TRUE = 'T',
+  FALSE = 'F',
+  INT32 = 'I',
+  DOUBLE = 'N',
+  ONE_BYTE_STRING = '"',
+  TWO_BYTE_STRING = 'c',
+  OBJECT = 'o',
+  ARRAY = 'A',
+};
+
+constexpr uint MAX_COMPACT_DEPTH = 64;
+// Deeper values are left to V8, which has its own stack checks.
+
+class CompactWriter {
+  // Encodes a value in the compact format, or reports that it can't be.
+public:
+  CompactWriter(v8::Isolate* isolate)
+      : isolate(isolate), context(isolate->GetCurrentContext()),
+        objectPrototype(v8::Object::New(isolate)->GetPrototype()),
+        arrayPrototype(v8::Array::New(isolate)->GetPrototype()) {
+    buffer.add(COMPACT_FORMAT_TAG);
+    buffer.add(COMPACT_FORMAT_VERSION);
+  }
+
+  bool write(v8::Local<v8::Value> value, uint depth = 0) {
+    // Returns false if the value can't be written in the compact format. Objects with accessor
+    // properties are rejected before any of their values are read, so no user code has run by
+    // then, and V8's serializer is the first to call any getters.
+
+    if (value->IsUndefined()) {
+      writeTag(CompactTag::UNDEFINED);
+    } else if (value->IsNull()) {
+      writeTag(CompactTag::NULL_);
+    } else if (value->IsTrue()) {
+      writeTag(CompactTag::TRUE);
+    } else if (value->IsFalse()) {
+      writeTag(CompactTag::FALSE);
+    } else if (value->IsInt32()) {
+      int32_t n = value.As<v8::Int32>()->Value();
+      writeTag(CompactTag::INT32);
+      writeVarint((static_cast<uint32_t>(n) << 1) ^ static_cast<uint32_t>(n >> 31));
+    } else if (value->IsNumber()) {
+      double d = value.As<v8::Number>()->Value();
+      writeTag(CompactTag::DOUBLE);
+      auto bytes = kj::arrayPtr(reinterpret_cast<const kj::byte*>(&d), sizeof(d));
+      buffer.addAll(bytes);
+    } else if (value->IsString()) {
+      writeString(value.As<v8::String>());
+    } else if (value->IsObject()) {
+      auto object = value.As<v8::Object>();
+      if (depth >= MAX_COMPACT_DEPTH) return false;
+
+      // The compact format can't express an object being referenced twice (including cycles).
+      // Identity hashes can collide, in which case we just give up needlessly.
+      int hash = object->GetIdentityHash();
+      if (seen.contains(hash)) return false;
+      seen.insert(hash);
+
+      if (object->IsArray()) {
+        return object->GetPrototype() == arrayPrototype &&
+            writeArray(object.As<v8::Array>(), depth);
+      } else if (isPlainObject(object)) {
+        return writeObject(object, depth);
+      } else {
+        return false;
+      }
+    } else {
+      // Symbols and BigInts.
+      return false;
+    }
+    return true;
+  }
+
+  kj::Array<kj::byte> finish() { return buffer.releaseAsArray(); }
+
+private:
+  v8::Isolate* isolate;
+  v8::Local<v8::Context> context;
+  v8::Local<v8::Value> objectPrototype;
+  v8::Local<v8::Value> arrayPrototype;
+  kj::Vector<kj::byte> buffer;
+  kj::HashSet<int> seen;
+
+  void writeTag(CompactTag tag) {
+    buffer.add(static_cast<kj::byte>(tag));
+  }
+
+  void writeVarint(uint32_t n) {
+    while (n >= 0x80) {
+      buffer.add(static_cast<kj::byte>(n | 0x80));
+      n >>= 7;
+    }
+    buffer.add(static_cast<kj::byte>(n));
+  }
+
+  static uint varintSize(uint32_t n) {
+    uint size = 1;
+    while (n >= 0x80) {
+      n >>= 7;
+      ++size;
+    }
+    return size;
+  }
+
+  void writeString(v8::Local<v8::String> string) {
+    uint length = string->Length();
+    if (string->IsOneByte()) {
+      writeTag(CompactTag::ONE_BYTE_STRING);
+      writeVarint(length);
+      size_t offset = buffer.size();
+      buffer.resize(offset + length);
+      string->WriteOneByte(isolate, buffer.begin() + offset, 0, length,
+                           v8::String::NO_NULL_TERMINATION);
+    } else {
+      uint32_t byteLength = length * sizeof(uint16_t);
+      if ((buffer.size() + 1 + varintSize(byteLength)) % 2 != 0) {
+        writeTag(CompactTag::PADDING);
+      }
+      writeTag(CompactTag::TWO_BYTE_STRING);
+      writeVarint(byteLength);
+      size_t offset = buffer.size();
+      buffer.resize(offset + byteLength);
+      string->Write(isolate, reinterpret_cast<uint16_t*>(buffer.begin() + offset), 0, length,
+                    v8::String::NO_NULL_TERMINATION);
+    }
+  }
+
+  bool isPlainObject(v8::Local<v8::Object> object) {
+    // True if V8 would serialize `object` as a plain bag of properties. Host objects have internal
+    // fields; the checks after that only matter for built-ins whose prototype was replaced.
+    return object->InternalFieldCount() == 0 &&
+        object->GetPrototype() == objectPrototype &&
+        !(object->IsFunction() || object->IsProxy() || object->IsDate() || object->IsRegExp() ||
+          object->IsNativeError() || object->IsMap() || object->IsSet() ||
+          object->IsWeakMap() || object->IsWeakSet() || object->IsPromise() ||
+          object->IsArrayBuffer() || object->IsArrayBufferView() ||
+          object->IsSharedArrayBuffer() || object->IsBooleanObject() ||
+          object->IsNumberObject() || object->IsStringObject() || object->IsBigIntObject() ||
+          object->IsSymbolObject());
+  }
+
+  bool hasAccessors(v8::Local<v8::Object> object, v8::Local<v8::Array> names) {
+    // True if any of the named own properties is a getter/setter pair (or a native accessor),
+    // which would run code when read.
+    for (auto i: kj::zeroTo(names->Length())) {
+      auto name = check(names->Get(context, i)).As<v8::String>();
+      if (check(object->HasRealNamedCallbackProperty(context, name))) return true;
+    }
+    return false;
+  }
+
+  bool writeObject(v8::Local<v8::Object> object, uint depth) {
+    // Like V8, we write own enumerable string-keyed properties, in enumeration order.
+    auto names = check(object->GetOwnPropertyNames(context,
+        static_cast<v8::PropertyFilter>(v8::ONLY_ENUMERABLE | v8::SKIP_SYMBOLS),
+        v8::KeyConversionMode::kConvertToString));
+    if (hasAccessors(object, names)) return false;
+    uint count = names->Length();
+    writeTag(CompactTag::OBJECT);
+    writeVarint(count);
+    for (auto i: kj::zeroTo(count)) {
+      auto name = check(names->Get(context, i));
+      writeString(name.As<v8::String>());
+      if (!write(check(object->Get(context, name)), depth + 1)) return false;
+    }
+    return true;
+  }
+
+  bool writeArray(v8::Local<v8::Array> array, uint depth) {
+    // Only dense arrays without any other properties qualify. V8 writes holes and extra properties,
+    // and so would we have to. Counting the own properties isn't enough, since a hole and an extra
+    // property cancel out: the names must be exactly the indices. Index keys are enumerated first,
+    // in ascending order, so any other array falls back to V8's serializer.
+    uint length = array->Length();
+    auto names = check(array->GetOwnPropertyNames(context,
+        static_cast<v8::PropertyFilter>(v8::ONLY_ENUMERABLE | v8::SKIP_SYMBOLS),
+        v8::KeyConversionMode::kConvertToString));
+    if (names->Length() != length) return false;
+    for (auto i: kj::zeroTo(length)) {
+      auto name = check(names->Get(context, i));
+      v8::Local<v8::Uint32> index;
+      if (!name->ToArrayIndex(context).ToLocal(&index) || index->Value() != i) return false;
+    }
+    if (hasAccessors(array, names)) return false;
+
+    writeTag(CompactTag::ARRAY);
+    writeVarint(length);
+    for (auto i: kj::zeroTo(length)) {
+      if (!write(check(array->Get(context, i)), depth + 1)) return false;
+    }
+    return true;
+  }
+};
+
+class CompactReader {
+  // Decodes the output of CompactWriter.
+public:
+  CompactReader(v8::Isolate* isolate, kj::ArrayPtr<const kj::byte> data)
+      : isolate(isolate), data(data),
+        objectPrototype(v8::Object::New(isolate)->GetPrototype()) {}
+
+  v8::Local<v8::Value> read() {
+    require(data.size() >= 2 && data[0] == COMPACT_FORMAT_TAG);
+    if (data[1] != COMPACT_FORMAT_VERSION) {
+      fail("Unable to deserialize cloned data due to invalid or unsupported version.");
+    }
+    position = 2;
+    return readValue(0);
+  }
+
+private:
+  v8::Isolate* isolate;
+  kj::ArrayPtr<const kj::byte> data;
+  size_t position = 0;
+  v8::Local<v8::Value> objectPrototype;
+
+  [[noreturn]] void fail(kj::StringPtr message) {
+    // Throws the same way V8's deserializer would.
+    isolate->ThrowException(v8::Exception::Error(v8Str(isolate, message)));
+    throw JsExceptionThrown();
+  }
+
+  void require(bool condition) {
+    if (!condition) fail("Unable to deserialize cloned data.");
+  }
+
+  kj::byte readByte() {
+    require(position < data.size());
+    return data[position++];
+  }
+
+  uint32_t readVarint() {
+    uint32_t result = 0;
+    for (uint shift = 0; shift < 35; shift += 7) {
+      kj::byte b = readByte();
+      result |= static_cast<uint32_t>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) return result;
+    }
+    fail("Unable to deserialize cloned data.");
+  }
+
+  kj::ArrayPtr<const kj::byte> readBytes(size_t size) {
+    require(size <= data.size() - position);
+    auto result = data.slice(position, position + size);
+    position += size;
+    return result;
+  }
+
+  v8::Local<v8::Value> readValue(uint depth) {
+    require(depth <= MAX_COMPACT_DEPTH);
+
+    auto tag = static_cast<CompactTag>(readByte());
+    while (tag == CompactTag::PADDING) {
+      tag = static_cast<CompactTag>(readByte());
+    }
+
+    switch (tag) {
+      case CompactTag::UNDEFINED:
+        return v8::Undefined(isolate);
+      case CompactTag::NULL_:
+        return v8::Null(isolate);
+      case CompactTag::TRUE:
+        return v8::True(isolate);
+      case CompactTag::FALSE:
+        return v8::False(isolate);
+      case CompactTag::INT32: {
+        uint32_t n = readVarint();
+        return v8::Integer::New(isolate, static_cast<int32_t>((n >> 1) ^ -(n & 1)));
+      }
+      case CompactTag::DOUBLE: {
+        double d;
+        memcpy(&d, readBytes(sizeof(d)).begin(), sizeof(d));
+        return v8::Number::New(isolate, d);
+      }
+      case CompactTag::ONE_BYTE_STRING:
+      case CompactTag::TWO_BYTE_STRING:
+        return readString(tag, v8::NewStringType::kNormal);
+      case CompactTag::OBJECT: {
+        uint32_t count = readVarint();
+        // Each property takes at least two bytes, which bounds the allocation below.
+        require(count <= (data.size() - position) / 2);
+        auto names = kj::heapArray<v8::Local<v8::Name>>(count);
+        auto values = kj::heapArray<v8::Local<v8::Value>>(count);
+        for (auto i: kj::zeroTo(count)) {
+          // Property names are likely to recur, e.g. across records of the same shape.
+          names[i] = readString(static_cast<CompactTag>(readByte()),
+                                v8::NewStringType::kInternalized);
+          values[i] = readValue(depth + 1);
+        }
+        return v8::Object::New(isolate, objectPrototype, names.begin(), values.begin(), count);
+      }
+      case CompactTag::ARRAY: {
+        uint32_t length = readVarint();
+        require(length <= data.size() - position);
+        auto elements = kj::heapArray<v8::Local<v8::Value>>(length);
+        for (auto i: kj::zeroTo(length)) {
+          elements[i] = readValue(depth + 1);
+        }
+        return v8::Array::New(isolate, elements.begin(), length);
+      }
+      case CompactTag::PADDING:
+        break;
+    }
+    fail("Unable to deserialize cloned data.");
+  }
+
+  v8::Local<v8::String> readString(CompactTag tag, v8::NewStringType type) {
+    while (tag == CompactTag::PADDING) {
+      tag = static_cast<CompactTag>(readByte());
+    }
+    if (tag == CompactTag::ONE_BYTE_STRING) {
+      auto bytes = readBytes(readVarint());
+      return check(v8::String::NewFromOneByte(isolate, bytes.begin(), type, bytes.size()));
+    }
+    require(tag == CompactTag::TWO_BYTE_STRING);
+    uint32_t byteLength = readVarint();
+    require(byteLength % 2 == 0);
+    auto bytes = readBytes(byteLength);
+    if (reinterpret_cast<uintptr_t>(bytes.begin()) % alignof(uint16_t) == 0) {
+      return check(v8::String::NewFromTwoByte(isolate,
+          reinterpret_cast<const uint16_t*>(bytes.begin()), type, byteLength / 2));
+    } else {
+      // The writer aligns strings within its output, but the output itself may have been copied
+      // to an odd address.
+      auto aligned = kj::heapArray<uint16_t>(byteLength / 2);
+      memcpy(aligned.begin(), bytes.begin(), byteLength);
+      return check(v8::String::NewFromTwoByte(isolate, aligned.begin(), type, aligned.size()));
+    }
+  }
+};
+
+}  // namespace
+
+// -----------------------------------------------------------------------------
+
 Serializer::Serializer(v8::Isolate* isolate, kj::Maybe<Options> maybeOptions)
     : isolate(isolate),
-      ser(isolate, this) {
+      ser(isolate, this),
+      compact(maybeOptions.map([](const Options& o) { return o.compact; }).orDefault(false)) {
   auto options = maybeOptions.orDefault({});
   KJ_IF_MAYBE(version, options.version) {
     KJ_ASSERT(*version >= 13, "The minimum serialization version is 13.");
@@ -44,6 +412,13 @@ Serializer::Released Serializer::release() {
   released = true;
   sharedArrayBuffers.clear();
   arrayBuffers.clear();
+  KJ_IF_MAYBE(data, compactData) {
+    return Released {
+      .data = kj::mv(*data),
+      .sharedArrayBuffers = sharedBackingStores.releaseAsArray(),
+      .transferedArrayBuffers = backingStores.releaseAsArray(),
+    };
+  }
   auto pair = ser.Release();
   return Released {
     .data = kj::Array(pair.first, pair.second, jsg::SERIALIZED_BUFFER_DISPOSER),
@@ -70,12 +445,30 @@ void Serializer::transfer(v8::Local<v8::ArrayBuffer> arrayBuffer) {
 
 void Serializer::write(v8::Local<v8::Value> value) {
   KJ_ASSERT(!released, "The data has already been released.");
+  if (compact) {
+    KJ_REQUIRE(!wroteValue, "Only one value may be written in compact mode.");
+    wroteValue = true;
+    if (arrayBuffers.empty()) {
+      CompactWriter writer(isolate);
+      if (writer.write(value)) {
+        compactData = writer.finish();
+        return;
+      }
+    }
+  }
   KJ_ASSERT(check(ser.WriteValue(isolate->GetCurrentContext(),value)));
 }
 
 void Deserializer::init(
+    kj::ArrayPtr<const kj::byte> data,
     kj::Maybe<kj::ArrayPtr<std::shared_ptr<v8::BackingStore>>> transferedArrayBuffers,
     kj::Maybe<Options> maybeOptions) {
+  if (data.size() > 0 && data[0] == COMPACT_FORMAT_TAG) {
+    // Written by Serializer in compact mode, which ignores the header options.
+    compactData = data;
+    return;
+  }
+
   auto options = maybeOptions.orDefault({});
   if (options.readHeader) {
     check(deser.ReadHeader(isolate->GetCurrentContext()));
@@ -93,6 +486,9 @@ void Deserializer::init(
 }
 
 v8::Local<v8::Value> Deserializer::readValue() {
+  KJ_IF_MAYBE(data, compactData) {
+    return CompactReader(isolate, *data).read();
+  }
   return check(deser.ReadValue(isolate->GetCurrentContext()));
 }
 
@@ -119,7 +515,7 @@ v8::Local<v8::Value> structuredClone(
     v8::Local<v8::Value> value,
     v8::Isolate* isolate,
     kj::Maybe<kj::ArrayPtr<jsg::Value>> maybeTransfer) {
-  Serializer ser(isolate, nullptr);
+  Serializer ser(isolate, Serializer::Options { .compact = true });
   KJ_IF_MAYBE(transfers, maybeTransfer) {
     for (auto& item : *transfers) {
       auto val = item.getHandle(isolate);
@@ -17,6 +17,15 @@ public:
     // When set, overrides the default wire format version with the one provided.
     bool omitHeader = false;
     // When set to true, the serialization header is not written to the output buffer.
+    bool compact = false;
+    // When set to true, a value made up only of plain objects, dense arrays, strings, numbers,
+    // booleans, null and undefined -- with no object reachable twice -- is written in a compact
+    // format of our own instead of V8's, which is much cheaper to produce and to read back. Other
+    // values are written by V8 as usual. Only one value may be written.
+    //
+    // The output starts with a tag no V8 serialization starts with, and Deserializer recognizes
+    // it regardless of its options. Don't store compact output anywhere it may be read by a
+    // version of this code that predates the format.
   };
 
   struct Released {
@@ -54,6 +63,10 @@ private:
   kj::Vector<std::shared_ptr<v8::BackingStore>> backingStores;
   v8::Isolate* isolate;
   v8::ValueSerializer ser;
+  bool compact;
+  kj::Maybe<kj::Array<kj::byte>> compactData;
+  // Set if write() used the compact format.
+  bool wroteValue = false;
   bool released = false;
 };
 
@@ -73,7 +86,8 @@ public:
       : isolate(isolate),
         deser(isolate, data.begin(), data.size(), this),
         sharedBackingStores(kj::mv(sharedArrayBuffers)) {
-    init(kj::mv(transferedArrayBuffers), kj::mv(maybeOptions));
+    init(kj::ArrayPtr<const kj::byte>(data.begin(), data.size()),
+         kj::mv(transferedArrayBuffers), kj::mv(maybeOptions));
   }
 
   inline explicit Deserializer(
@@ -95,6 +109,7 @@ public:
 
 private:
   void init(
+      kj::ArrayPtr<const kj::byte> data,
       kj::Maybe<kj::ArrayPtr<std::shared_ptr<v8::BackingStore>>> transferedArrayBuffers = nullptr,
       kj::Maybe<Options> maybeOptions = nullptr);
 
@@ -105,6 +120,8 @@ private:
   v8::Isolate* isolate;
   v8::ValueDeserializer deser;
   kj::Maybe<kj::ArrayPtr<std::shared_ptr<v8::BackingStore>>> sharedBackingStores;
+  kj::Maybe<kj::ArrayPtr<const kj::byte>> compactData;
+  // Set if the data is in Serializer's compact format, in which case `deser` is unused.
 };
 
 class SerializedBufferDisposer: public kj::ArrayDisposer {
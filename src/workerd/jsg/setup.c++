@@ -53,11 +53,12 @@ public:
 
 const PlatformDisposer PlatformDisposer::instance {};
 
-kj::Own<v8::Platform> defaultPlatform(uint backgroundThreadCount) {
+kj::Own<v8::Platform> defaultPlatform(uint backgroundThreadCount, bool enableIdleTasks) {
   return kj::Own<v8::Platform>(
       v8::platform::NewDefaultPlatform(
         backgroundThreadCount,  // default thread pool size
-        v8::platform::IdleTaskSupport::kDisabled,  // TODO(perf): investigate enabling
+        enableIdleTasks ? v8::platform::IdleTaskSupport::kEnabled
+                        : v8::platform::IdleTaskSupport::kDisabled,
         v8::platform::InProcessStackDumping::kDisabled,  // KJ's stack traces are better
         nullptr)  // default TracingController
       .release(), PlatformDisposer::instance);
@@ -91,6 +92,12 @@ V8System::V8System(kj::Own<v8::Platform> platformParam, kj::ArrayPtr<const kj::S
   //
   // Especially annoying is that V8 expects an array of `char*` -- not `const`. It won't actually
   // modify the strings, so we'll just const_cast them here...
+  for (auto flag: flags) {
+    if (flag == "--incremental-marking" || flag == "--incremental_marking") {
+      incrementalMarking = true;
+    }
+  }
+
   int argc = flags.size() + 1;
   KJ_STACK_ARRAY(char*, argv, flags.size() + 2, 32, 32);
   argv[0] = const_cast<char*>("fake-binary-name");
@@ -103,16 +110,18 @@ V8System::V8System(kj::Own<v8::Platform> platformParam, kj::ArrayPtr<const kj::S
 
   KJ_REQUIRE(argc == 1, "unrecognized V8 flag", argv[1]);
 
-  // At present, we're not confident the JSG GC integration works with incremental marking. We have
-  // seen bugs in the past that were fixed by adding this flag, although that was a long time ago
-  // and the code has changed a lot since then. Since Worker heaps are generally relatively small
-  // (limited to 128MB in Cloudflare Workers), incremental marking is probably not a win anyway,
-  // and can be disabled. If we want to support significantly larger heaps, we may want to revisit
-  // this. We'll want to do some stress testing first, and fix any bugs seen.
+  // Incremental marking is off unless explicitly requested. Since Worker heaps are generally
+  // relatively small (limited to 128MB in Cloudflare Workers), a single atomic mark is usually
+  // short, and it is the configuration that has seen by far the most use. Embedders with large
+  // heaps -- tens of thousands of live wrappers -- can opt in to avoid long pauses; Wrappable
+  // applies the write barriers incremental marking needs when it sees a marking cycle in
+  // progress.
   //
   // (It turns out you can call v8::V8::SetFlagsFromString() as many times as you want to add
   // more flags.)
-  v8::V8::SetFlagsFromString("--noincremental-marking");
+  if (!incrementalMarking) {
+    v8::V8::SetFlagsFromString("--noincremental-marking");
+  }
 
 #ifdef __APPLE__
   // On macOS arm64, we find that V8 can be collecting pages that contain compiled code when
@@ -155,6 +164,12 @@ void V8System::setFatalErrorCallback(FatalErrorCallback* callback) {
   v8FatalErrorCallback = callback;
 }
 
+void V8System::enableIdleTasks(v8::Platform& defaultPlatform, kj::Duration budget) {
+  KJ_REQUIRE(budget > 0 * kj::NANOSECONDS, "idle task budget must be positive");
+  idleTaskPlatform = &defaultPlatform;
+  idleTaskBudget = budget;
+}
+
 IsolateBase& IsolateBase::from(v8::Isolate* isolate) {
   return *reinterpret_cast<IsolateBase*>(isolate->GetData(0));
 }
@@ -167,6 +182,13 @@ void IsolateBase::terminateExecution() const {
   ptr->TerminateExecution();
 }
 
+void IsolateBase::runIdleTasks() {
+  if (system.idleTaskPlatform != nullptr) {
+    double budgetSeconds = (system.idleTaskBudget / kj::NANOSECONDS) / 1e9;
+    v8::platform::RunIdleTasks(system.idleTaskPlatform, ptr, budgetSeconds);
+  }
+}
+
 void IsolateBase::clearDestructionQueue() {
   // Safe to destroy the popped batch outside of the lock because the lock is only actually used to
   // guard the push buffer.
@@ -174,7 +196,8 @@ void IsolateBase::clearDestructionQueue() {
   auto drop = queue.lockExclusive()->pop();
 }
 
-HeapTracer::HeapTracer(v8::Isolate* isolate): isolate(isolate) {
+HeapTracer::HeapTracer(v8::Isolate* isolate, bool incrementalMarking)
+    : isolate(isolate), incrementalMarking(incrementalMarking) {
   isolate->AddGCPrologueCallback(
       [](v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags, void* data) {
     // We can expect that any freelisted shims will be collected during a major GC, because
@@ -274,7 +297,7 @@ namespace {
 IsolateBase::IsolateBase(const V8System& system, v8::Isolate::CreateParams&& createParams)
     : system(system),
       ptr(newIsolate(kj::mv(createParams))),
-      heapTracer(ptr) {
+      heapTracer(ptr, system.incrementalMarking) {
   V8StackScope stackScope;
 
   v8::CppHeapCreateParams params {
@@ -285,12 +308,13 @@ IsolateBase::IsolateBase(const V8System& system, v8::Isolate::CreateParams&& cre
         Wrappable::WRAPPABLE_TAG)
   };
 
-  params.marking_support = cppgc::Heap::MarkingType::kAtomic;
+  params.marking_support = system.incrementalMarking
+      ? cppgc::Heap::MarkingType::kIncremental
+      : cppgc::Heap::MarkingType::kAtomic;
   params.sweeping_support = cppgc::Heap::SweepingType::kAtomic;
-  // We currently don't attempt to support incremental marking or sweeping. We probably could
-  // support them, but it will take some careful investigation and testing. It's not clear if
-  // this would be a win anyway, since Worker heaps are relatively small and therefore doing a
-  // full atomic mark-sweep usually doesn't require much of a pause.
+  // Incremental marking is opt-in (see V8System::isIncrementalMarkingEnabled()). Sweeping stays
+  // atomic: CppgcShim destructors detach wrappers, which must not happen at an arbitrary
+  // allocation point in the middle of attaching another one.
   //
   // We probably won't ever support concurrent marking or sweeping because concurrent GC is only
   // expected to be a win if there are idle CPU cores available. Workers normally run on servers
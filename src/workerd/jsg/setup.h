@@ -15,9 +15,12 @@
 
 namespace workerd::jsg {
 
-kj::Own<v8::Platform> defaultPlatform(uint backgroundThreadCount);
+kj::Own<v8::Platform> defaultPlatform(uint backgroundThreadCount, bool enableIdleTasks = false);
 // Construct a default V8 platform, with the given background thread pool size.
 //
+// If `enableIdleTasks` is true, V8 is allowed to post idle tasks (mostly incremental GC work),
+// which will only run if the platform is also passed to `V8System::enableIdleTasks()`.
+//
 // Passing zero for `backgroundThreadCount` causes V8 to ask glibc how many processors there are.
 // Now, glibc *could* answer this problem easily by calling `sched_getaffinity()`, which would
 // not only tell it how many cores exist, but also how many cores are available to this specific
@@ -41,6 +44,9 @@ public:
   explicit V8System(kj::ArrayPtr<const kj::StringPtr> flags);
   // `flags` is a list of command-line flags to pass to V8, like "--expose-gc" or
   // "--single_threaded_gc". An exception will be thrown if any flags are not recognized.
+  //
+  // Incremental marking is disabled by default. Passing "--incremental-marking" enables it, both
+  // for the JavaScript heap and for JSG's wrapper tracing; see isIncrementalMarkingEnabled().
 
   explicit V8System(v8::Platform& platform);
   // Use a possibly-custom v8::Platform implementation. Use this if you need to override any
@@ -54,11 +60,32 @@ public:
   typedef void FatalErrorCallback(kj::StringPtr location, kj::StringPtr message);
   static void setFatalErrorCallback(FatalErrorCallback* callback);
 
+  void enableIdleTasks(v8::Platform& defaultPlatform, kj::Duration budget);
+  // Allow `IsolateBase::runIdleTasks()` to run V8's pending idle tasks for up to `budget` at a
+  // time. `defaultPlatform` must have been returned by `defaultPlatform()` with
+  // `enableIdleTasks = true`. It is usually, but need not be, the same platform passed to the
+  // constructor: a custom platform which wraps the default one should pass the inner platform
+  // here.
+
+  bool areIdleTasksEnabled() const { return idleTaskPlatform != nullptr; }
+
+  bool isIncrementalMarkingEnabled() const { return incrementalMarking; }
+  // True if "--incremental-marking" was passed to the constructor. Major GCs then mark the heap,
+  // including the objects reachable through Wrappables, in steps interleaved with JavaScript
+  // execution (or in idle time, see enableIdleTasks()) instead of in a single pause. Sweeping is
+  // still atomic, and marking never runs concurrently with the isolate's thread.
+
 private:
   kj::Own<v8::Platform> platformInner;
   V8PlatformWrapper platformWrapper;
   friend class IsolateBase;
 
+  v8::Platform* idleTaskPlatform = nullptr;
+  kj::Duration idleTaskBudget = 0 * kj::MILLISECONDS;
+  // Set by enableIdleTasks().
+
+  bool incrementalMarking = false;
+
   explicit V8System(kj::Own<v8::Platform>, kj::ArrayPtr<const kj::StringPtr>);
 };
 
@@ -105,6 +132,12 @@ public:
   kj::StringPtr getUuid();
   // Returns a random UUID for this isolate instance.
 
+  void runIdleTasks();
+  // Runs V8 idle tasks that have been posted for this isolate, for at most the budget configured
+  // with `V8System::enableIdleTasks()`. Does nothing if idle tasks are not enabled. The isolate
+  // must be locked. Call this when the thread is otherwise idle, so that GC work which would
+  // otherwise land inside a request can happen in between requests instead.
+
 private:
   template <typename TypeWrapper>
   friend class Isolate;
@@ -162,7 +162,7 @@ KJ_TEST("UsvString from kj::String") {
   {
     UsvString str;
     KJ_ASSERT(str.size() == 0);
-    KJ_ASSERT(str.storage().size() == 0);
+    KJ_ASSERT(str.empty());
     KJ_ASSERT(str.toStr() == "");
   }
 
@@ -328,7 +328,22 @@ KJ_TEST("UsvString from kj::String") {
     // Unpaired surrogates get transformed consistently.
     auto str1 = usv("\xd8\x00");
     auto str2 = usv("\xd8\x01");
-    KJ_ASSERT(memcmp(str1.storage().begin(), str2.storage().begin(), 4) == 0);
+    KJ_ASSERT(str1 == str2);
+  }
+
+  {
+    // Strings are stored as narrowly as their widest codepoint allows, and strings of different
+    // widths still compare by codepoint.
+    KJ_ASSERT(usv("hello"_kj).bytesPerCodepoint() == 1);
+    KJ_ASSERT(usv("Café"_kj).bytesPerCodepoint() == 1);
+    KJ_ASSERT(usv("日本"_kj).bytesPerCodepoint() == 2);
+    KJ_ASSERT(usv("a😀"_kj).bytesPerCodepoint() == 4);
+
+    auto wide = usv("Café 😀"_kj);
+    KJ_ASSERT(wide.slice(0, 4) == usv("Café"_kj));
+    KJ_ASSERT(wide.slice(0, 4).clone().bytesPerCodepoint() == 1);
+    KJ_ASSERT(wide.slice(0, 4).clone() == usv("Café"_kj));
+    KJ_ASSERT(wide.slice(0, 4).clone().hashCode() == usv("Café"_kj).hashCode());
   }
 
   {
@@ -386,6 +401,13 @@ KJ_TEST("JavaScript USVStrings") {
   e.expectEval("testUsv('\\uda99') === '\\ufffd'", "boolean", "true");
   e.expectEval("testUsv('\\uda99\\uda99') === '\\ufffd'.repeat(2)", "boolean", "true");
   e.expectEval("testUsv('\\ud800\\ud800') === '\\ufffd'.repeat(2)", "boolean", "true");
+
+  // One-byte (Latin-1) strings take a shortcut in both directions, as do results that fit in one
+  // byte. Check that they round-trip exactly, including above the stack buffer size.
+  e.expectEval("testUsv('caf\\xe9\\xff\\x00!') === 'caf\\xe9\\xff\\x00!'", "boolean", "true");
+  e.expectEval("let s = 'x\\xe9'.repeat(1000); testUsv(s) === s", "boolean", "true");
+  e.expectEval("testUsv('caf\\xe9\\u0100') === 'caf\\xe9\\u0100'", "boolean", "true");
+  e.expectEval("testUsv('\\ud83d\\ude00x') === '\\ud83d\\ude00x'", "boolean", "true");
 }
 
 }  // namespace
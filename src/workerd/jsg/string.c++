@@ -10,12 +10,35 @@
 namespace workerd::jsg {
 
 namespace {
-kj::Array<uint32_t> transcodeToUtf32(kj::ArrayPtr<uint16_t> buffer) {
+uint8_t shiftFor(uint32_t maxCodepoint) {
+  // Returns log2 of the number of bytes per codepoint needed to store `maxCodepoint`.
+  return maxCodepoint <= 0xff ? 0 : maxCodepoint <= 0xffff ? 1 : 2;
+}
+
+template <typename T>
+void narrowInto(kj::ArrayPtr<kj::byte> dest, kj::ArrayPtr<const T> codepoints, uint8_t shift) {
+  // Copies `codepoints` into `dest`, each narrowed to (1 << shift) bytes, which the caller has
+  // determined will fit them all.
+  switch (shift) {
+    case 0:
+      for (auto i: kj::indices(codepoints)) dest[i] = codepoints[i];
+      break;
+    case 1: {
+      auto out = reinterpret_cast<uint16_t*>(dest.begin());
+      for (auto i: kj::indices(codepoints)) out[i] = codepoints[i];
+      break;
+    }
+    default: {
+      auto out = reinterpret_cast<uint32_t*>(dest.begin());
+      for (auto i: kj::indices(codepoints)) out[i] = codepoints[i];
+      break;
+    }
+  }
+}
+
+kj::Vector<uint32_t> transcodeToUtf32(kj::ArrayPtr<const uint16_t> buffer) {
   // In this variation, the result length will be <= buffer.size, with the exact
   // size dependent on the number of paired or unpaired surrogates in the buffer.
-  if (buffer.size() == 0) {
-    return kj::Array<uint32_t>();
-  }
   kj::Vector<uint32_t> result(buffer.size());
   auto start = buffer.begin();
   auto offset = 0;
@@ -25,15 +48,12 @@ kj::Array<uint32_t> transcodeToUtf32(kj::ArrayPtr<uint16_t> buffer) {
     result.add(codepoint);
   }
 
-  return result.releaseAsArray();
+  return result;
 }
 
-kj::Array<uint32_t> transcodeToUtf32(kj::ArrayPtr<const char> buffer) {
+kj::Vector<uint32_t> transcodeToUtf32(kj::ArrayPtr<const char> buffer) {
   // In this variation, we assume buffer is UTF8 encoded data. The result size
   // will be <= buffer.
-  if (buffer.size() == 0) {
-    return kj::Array<uint32_t>();
-  }
   kj::Vector<uint32_t> result(buffer.size());
   auto start = buffer.begin();
   auto offset = 0;
@@ -43,110 +63,167 @@ kj::Array<uint32_t> transcodeToUtf32(kj::ArrayPtr<const char> buffer) {
     result.add(codepoint);
   }
 
-  return result.releaseAsArray();
-}
-
-auto transcodeToUtf8(const auto& buffer) {
-  if (buffer.size() == 0) return kj::str();
-  // In the worst case, we need four bytes per codepoint.
-  kj::Vector<char> result(buffer.size() * 4);
-  kj::byte token[4];
-
-  for (auto codepoint : buffer) {
-    auto offset = 0;
-    U8_APPEND_UNSAFE(&token[0], offset, codepoint);
-    for (auto n = 0; n < offset; n++) {
-      result.add(token[n]);
+  return result;
+}
+
+kj::String transcodeToUtf8(const UsvStringPtr& str) {
+  if (str.size() == 0) return kj::str();
+  return str.visitStorage([](auto codepoints) {
+    // In the worst case, we need four bytes per codepoint.
+    kj::Vector<char> result(codepoints.size() * 4 + 1);
+    kj::byte token[4];
+
+    for (uint32_t codepoint: codepoints) {
+      if (codepoint < 0x80) {
+        result.add(codepoint);
+        continue;
+      }
+      auto offset = 0;
+      U8_APPEND_UNSAFE(&token[0], offset, codepoint);
+      for (auto n = 0; n < offset; n++) {
+        result.add(token[n]);
+      }
     }
-  }
 
-  return kj::str(result.releaseAsArray());
+    result.add('\0');
+    return kj::String(result.releaseAsArray());
+  });
 }
 
-auto transcodeToUtf16(const auto& buffer) {
-  if (buffer.size() == 0) return kj::Array<uint16_t>();
-  // Worst case, we need two uint16_t's per codepoint.
-  kj::Vector<uint16_t> result(buffer.size() * 2);
-
-  for (auto codepoint : buffer) {
-    if (codepoint <= 0xffff) {
-      result.add(static_cast<uint16_t>(codepoint));
+kj::Array<uint16_t> transcodeToUtf16(const UsvStringPtr& str) {
+  if (str.size() == 0) return kj::Array<uint16_t>();
+  return str.visitStorage([](auto codepoints) {
+    using T = kj::Decay<decltype(codepoints[0])>;
+    if constexpr (sizeof(T) < 4) {
+      // Every codepoint fits in one code unit.
+      auto result = kj::heapArray<uint16_t>(codepoints.size());
+      for (auto i: kj::indices(codepoints)) result[i] = codepoints[i];
+      return result;
     } else {
-      result.add(static_cast<uint16_t>((codepoint >> 10)+0xd7c0));
-      result.add(static_cast<uint16_t>((codepoint & 0x3ff)|0xdc00));
+      // Worst case, we need two uint16_t's per codepoint.
+      kj::Vector<uint16_t> result(codepoints.size() * 2);
+
+      for (auto codepoint : codepoints) {
+        if (codepoint <= 0xffff) {
+          result.add(static_cast<uint16_t>(codepoint));
+        } else {
+          result.add(static_cast<uint16_t>((codepoint >> 10)+0xd7c0));
+          result.add(static_cast<uint16_t>((codepoint & 0x3ff)|0xdc00));
+        }
+      }
+
+      return result.releaseAsArray();
     }
-  }
-
-  return result.releaseAsArray();
+  });
 }
 
-kj::Array<uint32_t> writeFromV8String(v8::Isolate *isolate, v8::Local<v8::Value> value) {
-  auto string = check(value->ToString(isolate->GetCurrentContext()));
-  if (string->Length() == 0) return kj::Array<uint32_t>();
-
-  auto buffer = kj::heapArray<uint16_t>(string->Length());
-  string->Write(isolate, buffer.begin(), 0, -1, v8::String::NO_NULL_TERMINATION);
-
-  return transcodeToUtf32(buffer);
-}
-
-kj::Array<uint32_t> copyUsvString(kj::ArrayPtr<uint32_t> other) {
-  auto dest = kj::heapArray<uint32_t>(other.size());
-  if (other.size() > 0) {
-    memcpy(dest.begin(), other.begin(), other.size() * sizeof(uint32_t));
+bool containsSurrogates(kj::ArrayPtr<const uint16_t> units) {
+  for (auto unit: units) {
+    if (U16_IS_SURROGATE(unit)) return true;
   }
-  return kj::mv(dest);
+  return false;
 }
 
-kj::Maybe<size_t> findLastIndexOf(kj::ArrayPtr<uint32_t> buffer, uint32_t codepoint) {
-  // kj::Array does not expose a regular iterator or reverse iterator so we
-  // have to do this the manual way...
-  size_t index = buffer.size();
-  while (index != 0) {
-    if (buffer[--index] == codepoint) return index;
-  }
-  return nullptr;
+kj::Maybe<size_t> findLastIndexOf(const UsvStringPtr& str, uint32_t codepoint) {
+  return str.visitStorage([codepoint](auto codepoints) -> kj::Maybe<size_t> {
+    size_t index = codepoints.size();
+    while (index != 0) {
+      if (codepoints[--index] == codepoint) return index;
+    }
+    return nullptr;
+  });
 }
 
-auto lexCmpThreeway(const kj::ArrayPtr<const uint32_t> one,
-                    const kj::ArrayPtr<const uint32_t> two) {
-  if (one.size() == 0 && two.size() == 0) return std::weak_ordering::equivalent;
+std::weak_ordering lexCmpThreeway(const UsvStringPtr& one, const UsvStringPtr& two) {
+  return one.visitStorage([&](auto left) {
+    return two.visitStorage([&](auto right) {
+      auto [l, r] = std::mismatch(left.begin(), left.end(), right.begin(), right.end(),
+          [](uint32_t a, uint32_t b) { return a == b; });
 
-  auto [left, right] = std::mismatch(
-      one.begin(), one.end(),
-      two.begin(), two.end());
+      if (l == left.end() && r == right.end()) {
+        return std::weak_ordering::equivalent;
+      }
 
-  if (left == one.end() && right == two.end()) {
-    return std::weak_ordering::equivalent;
-  }
-
-  return left == one.end() ? std::weak_ordering::less
-       : right == two.end() ? std::weak_ordering::greater
-       : *left <=> *right;
+      return l == left.end() ? std::weak_ordering::less
+           : r == right.end() ? std::weak_ordering::greater
+           : uint32_t(*l) <=> uint32_t(*r);
+    });
+  });
 }
 }  // namespace
 
+UsvString::UsvString(kj::ArrayPtr<const uint32_t> codepoints) {
+  uint32_t max = 0;
+  for (auto c: codepoints) max = kj::max(max, c);
+  shift = shiftFor(max);
+  buffer = kj::heapArray<kj::byte>(codepoints.size() << shift);
+  narrowInto(buffer, codepoints, shift);
+}
+
 UsvString usv(v8::Isolate* isolate, v8::Local<v8::Value> value) {
-  return UsvString(writeFromV8String(isolate, value));
+  auto string = check(value->ToString(isolate->GetCurrentContext()));
+  if (string->Length() == 0) return UsvString();
+
+  if (string->IsOneByte()) {
+    // Every Latin-1 character is a code point as is, so the string can be copied as is. Most
+    // strings we see here (URLs, in particular) are ASCII, which V8 always stores this way.
+    auto bytes = kj::heapArray<kj::byte>(string->Length());
+    string->WriteOneByte(isolate, bytes.begin(), 0, -1, v8::String::NO_NULL_TERMINATION);
+    return UsvString(kj::mv(bytes), 0);
+  }
+
+  auto units = kj::heapArray<uint16_t>(string->Length());
+  string->Write(isolate, units.begin(), 0, -1, v8::String::NO_NULL_TERMINATION);
+  return usv(units.asPtr());
 }
 
 UsvString usv(kj::ArrayPtr<uint16_t> string) {
-  return UsvString(transcodeToUtf32(string));
+  if (containsSurrogates(string)) {
+    return UsvString(transcodeToUtf32(string).asPtr());
+  }
+
+  // Without surrogates, each code unit is a codepoint.
+  uint16_t max = 0;
+  for (auto unit: string) max = kj::max(max, unit);
+  auto shift = shiftFor(max);
+  auto buffer = kj::heapArray<kj::byte>(string.size() << shift);
+  narrowInto(buffer, string.asConst(), shift);
+  return UsvString(kj::mv(buffer), shift);
 }
 
 UsvString usv(kj::ArrayPtr<const char> string) {
-  return UsvString(transcodeToUtf32(string));
+  if (std::all_of(string.begin(), string.end(), [](char c) { return (c & 0x80) == 0; })) {
+    // ASCII is common enough to be worth skipping the decoder for.
+    return UsvString(kj::heapArray(string.asBytes()), 0);
+  }
+  return UsvString(transcodeToUtf32(string).asPtr());
 }
 
 v8::Local<v8::String> v8Str(v8::Isolate* isolate, UsvStringPtr str, v8::NewStringType newType) {
   if (str.size() == 0) return v8::String::Empty(isolate);
-  auto data = transcodeToUtf16(str.storage());
-  return v8Str(isolate, data.asPtr(), newType);
+
+  return str.visitStorage([&](auto codepoints) {
+    using T = kj::Decay<decltype(codepoints[0])>;
+    if constexpr (sizeof(T) == 1) {
+      return v8StrFromLatin1(isolate, codepoints, newType);
+    } else if constexpr (sizeof(T) == 2) {
+      // Every codepoint is a single UTF-16 code unit.
+      return v8Str(isolate, kj::arrayPtr(
+          reinterpret_cast<const char16_t*>(codepoints.begin()), codepoints.size()), newType);
+    } else {
+      auto data = transcodeToUtf16(str);
+      return v8Str(isolate, data.asPtr(), newType);
+    }
+  });
 }
 
 uint32_t UsvStringIterator::operator*() const {
   KJ_REQUIRE(pos < size(), "Out-of-bounds read on UsvStringIterator.");
-  return ptr[pos];
+  switch (shift) {
+    case 0: return data[pos];
+    case 1: return reinterpret_cast<const uint16_t*>(data)[pos];
+    default: return reinterpret_cast<const uint32_t*>(data)[pos];
+  }
 }
 
 UsvStringIterator& UsvStringIterator::operator++() {
@@ -200,61 +277,80 @@ UsvStringIterator& UsvStringIterator::operator-=(int count) {
 }
 
 UsvString UsvString::clone() {
-  return UsvString(copyUsvString(buffer));
+  return UsvString(kj::heapArray<kj::byte>(buffer), shift);
 }
 
 uint32_t UsvString::getCodepointAt(size_t index) const {
   KJ_REQUIRE(index < size(), "Out-of-bounds read on UsvString.");
-  return buffer[index];
+  return asPtr().getCodepointAt(index);
 }
 
 UsvStringPtr UsvString::slice(size_t start, size_t end) {
-  return UsvStringPtr(buffer.slice(start, end));
+  return asPtr().slice(start, end);
 }
 
 kj::String UsvString::toStr() {
-  return transcodeToUtf8(buffer);
+  return transcodeToUtf8(*this);
 }
 
 const kj::String UsvString::toStr() const {
-  return transcodeToUtf8(buffer);
+  return transcodeToUtf8(*this);
 }
 
 kj::Array<uint16_t> UsvString::toUtf16() {
-  return transcodeToUtf16(buffer.asPtr());
+  return transcodeToUtf16(*this);
 }
 
 const kj::Array<const uint16_t> UsvString::toUtf16() const {
-  return transcodeToUtf16(buffer.asPtr());
+  return transcodeToUtf16(*this);
 }
 
 UsvString UsvStringPtr::clone() {
-  return UsvString(copyUsvString(ptr));
+  // A slice may be stored wider than its contents need (e.g. an ASCII part of a string that has
+  // non-Latin-1 characters elsewhere), so re-narrow it.
+  return visitStorage([](auto codepoints) {
+    using T = kj::Decay<decltype(codepoints[0])>;
+    uint32_t max = 0;
+    for (auto c: codepoints) max = kj::max<uint32_t>(max, c);
+    auto shift = shiftFor(max);
+    auto buffer = kj::heapArray<kj::byte>(codepoints.size() << shift);
+    narrowInto<T>(buffer, codepoints, shift);
+    return UsvString(kj::mv(buffer), shift);
+  });
 }
 
 uint32_t UsvStringPtr::getCodepointAt(size_t index) const {
   KJ_REQUIRE(index < size(), "Out-of-bounds read on UsvStringPtr.");
-  return ptr[index];
+  return *UsvStringIterator(data, length, shift, index);
 }
 
 UsvStringPtr UsvStringPtr::slice(size_t start, size_t end) {
-  return ptr.slice(start, end);
+  KJ_REQUIRE(start <= end && end <= length, "Out-of-bounds slice of UsvStringPtr.");
+  return UsvStringPtr(data + (start << shift), end - start, shift);
+}
+
+bool UsvStringPtr::operator==(const UsvStringPtr& other) const {
+  if (length != other.length) return false;
+  if (shift == other.shift) {
+    return length == 0 || memcmp(data, other.data, length << shift) == 0;
+  }
+  return lexCmpThreeway(*this, other) == std::weak_ordering::equivalent;
 }
 
 kj::String UsvStringPtr::toStr() {
-  return transcodeToUtf8(ptr);
+  return transcodeToUtf8(*this);
 }
 
 const kj::String UsvStringPtr::toStr() const {
-  return transcodeToUtf8(ptr);
+  return transcodeToUtf8(*this);
 }
 
 kj::Array<uint16_t> UsvStringPtr::toUtf16() {
-  return transcodeToUtf16(ptr);
+  return transcodeToUtf16(*this);
 }
 
 const kj::Array<const uint16_t> UsvStringPtr::toUtf16() const {
-  return transcodeToUtf16(ptr);
+  return transcodeToUtf16(*this);
 }
 
 void UsvStringBuilder::add(uint32_t codepoint) {
@@ -262,6 +358,12 @@ void UsvStringBuilder::add(uint32_t codepoint) {
   buffer.add(codepoint);
 }
 
+void UsvStringBuilder::set(size_t index, uint32_t codepoint) {
+  KJ_REQUIRE(codepoint <= 0x10ffff, "Invalid Unicode codepoint.");
+  KJ_REQUIRE(index < buffer.size(), "Out-of-bounds write on UsvStringBuilder.");
+  buffer[index] = codepoint;
+}
+
 void UsvStringBuilder::addAll(UsvStringIterator begin, UsvStringIterator end) {
   KJ_ASSERT(begin <= end, "Invalid iterator range.");
   while (begin < end) {
@@ -270,44 +372,50 @@ void UsvStringBuilder::addAll(UsvStringIterator begin, UsvStringIterator end) {
   }
 }
 
+UsvString UsvStringBuilder::finish() {
+  auto result = UsvString(buffer.asPtr());
+  buffer.clear();
+  return result;
+}
+
 std::weak_ordering UsvString::operator<=>(const UsvString& other) const {
-  return lexCmpThreeway(buffer, other.buffer);
+  return lexCmpThreeway(*this, other);
 }
 
 std::weak_ordering UsvString::operator<=>(const UsvStringPtr& other) const {
-  return lexCmpThreeway(buffer, other.ptr);
+  return lexCmpThreeway(*this, other);
 }
 
 std::weak_ordering UsvString::operator<=>(UsvString& other) {
-  return lexCmpThreeway(buffer, other.buffer);
+  return lexCmpThreeway(*this, other);
 }
 
 std::weak_ordering UsvString::operator<=>(UsvStringPtr& other) {
-  return lexCmpThreeway(buffer, other.ptr);
+  return lexCmpThreeway(*this, other);
 }
 
 std::weak_ordering UsvStringPtr::operator<=>(const UsvString& other) const {
-  return lexCmpThreeway(ptr, other.buffer);
+  return lexCmpThreeway(*this, other);
 }
 
 std::weak_ordering UsvStringPtr::operator<=>(const UsvStringPtr& other) const {
-  return lexCmpThreeway(ptr, other.ptr);
+  return lexCmpThreeway(*this, other);
 }
 
 std::weak_ordering UsvStringPtr::operator<=>(UsvString& other) {
-  return lexCmpThreeway(ptr, other.buffer);
+  return lexCmpThreeway(*this, other);
 }
 
 std::weak_ordering UsvStringPtr::operator<=>(UsvStringPtr& other) {
-  return lexCmpThreeway(ptr, other.ptr);
+  return lexCmpThreeway(*this, other);
 }
 
 kj::Maybe<size_t> UsvString::lastIndexOf(uint32_t codepoint) {
-  return findLastIndexOf(buffer, codepoint);
+  return findLastIndexOf(*this, codepoint);
 }
 
 kj::Maybe<size_t> UsvStringPtr::lastIndexOf(uint32_t codepoint) {
-  return findLastIndexOf(ptr, codepoint);
+  return findLastIndexOf(*this, codepoint);
 }
 
 kj::String KJ_STRINGIFY(UsvString& string) {
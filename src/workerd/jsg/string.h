@@ -67,10 +67,12 @@ class UsvStringBuilder;
 // The jsg::UsvStringBuilder allows constructing a UsvString one Unicode codepoint at
 // a time or from other UsvStrings, kj::Strings, string literals, and so on.
 //
-// It is important to know that every UsvString has a heap-allocated internal storage
-// in the form of a kj::Array<uint32_t>. When a string literal or kj::String is used
-// to create a UsvString, a UTF-8 encoding is assumed and the content will be transcoded
-// into a UTF-32 representation. In performance sensitive parts of the code, these
+// It is important to know that every UsvString has a heap-allocated internal storage.
+// It holds one, two or four bytes per codepoint, whichever is the smallest that fits every
+// codepoint in the string, so that ASCII and Latin-1 strings (which covers most URLs) take one
+// byte per codepoint, and converting them to and from V8 strings is a plain copy. When a string
+// literal or kj::String is used to create a UsvString, a UTF-8 encoding is assumed and the content
+// will be decoded into codepoints. In performance sensitive parts of the code, these
 // additional heap allocations can be expensive. If you find yourself doing multiple
 // conversions of the same string literals or kj::String values (such as performing
 // multiple comparison operations against the same value), then it is advisable just to
@@ -166,7 +168,7 @@ public:
   UsvStringIterator& operator-=(int);
   UsvStringIterator operator-(int);
 
-  inline explicit operator bool() const { return pos < ptr.size(); }
+  inline explicit operator bool() const { return pos < length; }
 
   inline bool operator<(UsvStringIterator& other) const {
     return pos < other.pos;
@@ -196,13 +198,16 @@ public:
   // Informational. Identifies the iterators current codepoint position.
   // When position() == size(), this iterator has reached the end.
 
-  inline size_t size() const { return ptr.size(); }
+  inline size_t size() const { return length; }
   // Informational. Identifies the maximum number of codepoints.
 
 private:
-  explicit inline UsvStringIterator(kj::ArrayPtr<uint32_t> ptr, size_t pos) : ptr(ptr), pos(pos) {}
+  explicit inline UsvStringIterator(const kj::byte* data, size_t length, uint8_t shift, size_t pos)
+      : data(data), length(length), shift(shift), pos(pos) {}
 
-  kj::ArrayPtr<uint32_t> ptr;
+  const kj::byte* data;
+  size_t length;
+  uint8_t shift;
   size_t pos = 0;
 
   friend class UsvStringPtr;
@@ -235,11 +240,8 @@ public:
   uint32_t getCodepointAt(size_t index) const;
   uint32_t operator[](size_t index) const { return getCodepointAt(index); }
 
-  inline bool operator==(UsvStringPtr& other) { return ptr == other.ptr; }
-  inline bool operator!=(UsvStringPtr& other) { return ptr != other.ptr; };
-
-  inline bool operator==(const UsvStringPtr& other) const { return ptr == other.ptr; }
-  inline bool operator!=(const UsvStringPtr& other) const { return ptr != other.ptr; };
+  bool operator==(const UsvStringPtr& other) const;
+  inline bool operator!=(const UsvStringPtr& other) const { return !(*this == other); };
 
   std::weak_ordering operator<=>(const UsvString& other) const;
   std::weak_ordering operator<=>(const UsvStringPtr& other) const;
@@ -254,22 +256,35 @@ public:
 
   kj::Maybe<size_t> lastIndexOf(uint32_t codepoint);
 
-  inline UsvStringIterator begin() KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
-    return UsvStringIterator(ptr, 0);
+  inline UsvStringIterator begin() const KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
+    return UsvStringIterator(data, length, shift, 0);
   }
-  inline UsvStringIterator end() KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
-    return UsvStringIterator(ptr, size());
+  inline UsvStringIterator end() const KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
+    return UsvStringIterator(data, length, shift, length);
   }
 
-  inline size_t size() const { return ptr.size(); }
+  inline size_t size() const { return length; }
   // Returns the counted number of unicode codepoints in the string.
 
   inline bool empty() const { return size() == 0; }
 
-  inline kj::ArrayPtr<uint32_t> storage() KJ_LIFETIMEBOUND { return ptr; }
-  // Informational. Returns a pointer to the underlying storage.
+  template <typename Func>
+  decltype(auto) visitStorage(Func&& func) const {
+    // Calls `func` with the codepoints as a `kj::ArrayPtr<const T>`, where `T` is `uint8_t`,
+    // `uint16_t` or `uint32_t` depending on how the string is stored. This lets loops over the
+    // codepoints be specialized for each width, rather than branching on it for every codepoint.
+    switch (shift) {
+      case 0:
+        return func(kj::arrayPtr(data, length));
+      case 1:
+        return func(kj::arrayPtr(reinterpret_cast<const uint16_t*>(data), length));
+      default:
+        return func(kj::arrayPtr(reinterpret_cast<const uint32_t*>(data), length));
+    }
+  }
 
-  inline const kj::ArrayPtr<const uint32_t> storage() const KJ_LIFETIMEBOUND { return ptr; }
+  inline uint bytesPerCodepoint() const { return 1u << shift; }
+  // Informational. The width of each codepoint in the underlying storage.
 
   UsvStringPtr slice(size_t start, size_t end) KJ_LIFETIMEBOUND;
   inline UsvStringPtr slice(size_t start) KJ_LIFETIMEBOUND { return slice(start, size()); }
@@ -281,9 +296,15 @@ public:
   }
 
 private:
-  UsvStringPtr(kj::ArrayPtr<uint32_t> ptr) : ptr(ptr) {}
+  UsvStringPtr(const kj::byte* data, size_t length, uint8_t shift)
+      : data(data), length(length), shift(shift) {}
+  UsvStringPtr(kj::ArrayPtr<const uint32_t> ptr)
+      : data(reinterpret_cast<const kj::byte*>(ptr.begin())), length(ptr.size()), shift(2) {}
 
-  kj::ArrayPtr<uint32_t> ptr;
+  const kj::byte* data;
+  size_t length;
+  uint8_t shift;
+  // log2 of the number of bytes per codepoint.
 
   friend class UsvString;
   friend class UsvStringBuilder;
@@ -294,16 +315,15 @@ class UsvString {
   // Unpaired surrogate codepoints are automatically converted into
   // the standard 0xFFFD replacement character on creation.
   //
-  // Internally, a UsvString is an array of 2-byte code units.
-  // Every Unicode codepoint is represented by either one or two
-  // code units each.
+  // Internally, a UsvString is an array of codepoints that are each one, two or
+  // four bytes wide: always the narrowest width that fits every codepoint in the
+  // string. Since the width depends only on the contents, two UsvStrings with the
+  // same contents have identical storage.
 public:
   UsvString() = default;
 
-  UsvString(kj::Array<uint32_t> buffer) : buffer(kj::mv(buffer)) {}
-  // Takes over ownership of the array of unicode code units. Specifically,
-  // does not copy or heap allocate anything. The number of Unicode codepoints
-  // will be calculated.
+  explicit UsvString(kj::ArrayPtr<const uint32_t> codepoints);
+  // Copies the codepoints into storage of the appropriate width.
 
   UsvString(UsvString&& other) = default;
   UsvString& operator=(UsvString&& other) = default;
@@ -324,17 +344,21 @@ public:
   const kj::Array<const uint16_t> toUtf16() const KJ_WARN_UNUSED_RESULT;
   // Return a copy of this UsvString as an array of UTF-16 code units.
 
-  inline operator UsvStringPtr() KJ_LIFETIMEBOUND { return UsvStringPtr(buffer); }
-  inline UsvStringPtr asPtr() KJ_LIFETIMEBOUND { return UsvStringPtr(*this); }
+  inline operator UsvStringPtr() const KJ_LIFETIMEBOUND {
+    return UsvStringPtr(buffer.begin(), size(), shift);
+  }
+  inline UsvStringPtr asPtr() const KJ_LIFETIMEBOUND { return UsvStringPtr(*this); }
 
   uint32_t getCodepointAt(size_t index) const;
   uint32_t operator[](size_t index) const { return getCodepointAt(index); }
 
-  inline bool operator==(UsvString& other) { return buffer == other.buffer; }
-  inline bool operator!=(UsvString& other) { return buffer != other.buffer; };
+  inline bool operator==(const UsvString& other) const {
+    // Equal strings always have the same width, so their storage must match exactly.
+    return shift == other.shift && buffer == other.buffer;
+  }
+  inline bool operator!=(const UsvString& other) const { return !(*this == other); };
 
-  inline bool operator==(const UsvString& other) const { return buffer == other.buffer; }
-  inline bool operator!=(const UsvString& other) const { return buffer != other.buffer; };
+  inline uint hashCode() const { return kj::hashCode(buffer); }
 
   std::weak_ordering operator<=>(const UsvString& other) const;
   std::weak_ordering operator<=>(const UsvStringPtr& other) const;
@@ -349,22 +373,26 @@ public:
 
   kj::Maybe<size_t> lastIndexOf(uint32_t codepoint);
 
-  inline UsvStringIterator begin() KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
-    return UsvStringIterator(buffer, 0);
+  inline UsvStringIterator begin() const KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
+    return UsvStringIterator(buffer.begin(), size(), shift, 0);
   }
-  inline UsvStringIterator end() KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
-    return UsvStringIterator(buffer, size());
+  inline UsvStringIterator end() const KJ_LIFETIMEBOUND KJ_WARN_UNUSED_RESULT {
+    return UsvStringIterator(buffer.begin(), size(), shift, size());
   }
 
-  inline size_t size() const { return buffer.size(); }
+  inline size_t size() const { return buffer.size() >> shift; }
   // Returns the counted number of unicode codepoints in the string.
 
   inline bool empty() const { return size() == 0; }
 
-  inline kj::ArrayPtr<uint32_t> storage() KJ_LIFETIMEBOUND { return buffer; }
-  // Informational. Returns a pointer to the underlying storage.
+  template <typename Func>
+  decltype(auto) visitStorage(Func&& func) const {
+    // See UsvStringPtr::visitStorage().
+    return asPtr().visitStorage(kj::fwd<Func>(func));
+  }
 
-  inline const kj::ArrayPtr<const uint32_t> storage() const KJ_LIFETIMEBOUND { return buffer; }
+  inline uint bytesPerCodepoint() const { return 1u << shift; }
+  // Informational. The width of each codepoint in the underlying storage.
 
   UsvStringPtr slice(size_t start, size_t end) KJ_LIFETIMEBOUND;
   inline UsvStringPtr slice(size_t start) KJ_LIFETIMEBOUND { return slice(start, size()); }
@@ -376,10 +404,17 @@ public:
   }
 
 private:
-  kj::Array<uint32_t> buffer;
+  UsvString(kj::Array<kj::byte> buffer, uint8_t shift): buffer(kj::mv(buffer)), shift(shift) {}
+
+  kj::Array<kj::byte> buffer;
+  uint8_t shift = 0;
+  // log2 of the number of bytes per codepoint.
 
   friend class UsvStringBuilder;
   friend class UsvStringPtr;
+  friend UsvString usv(kj::ArrayPtr<const char> string);
+  friend UsvString usv(kj::ArrayPtr<uint16_t> string);
+  friend UsvString usv(v8::Isolate* isolate, v8::Local<v8::Value> value);
 };
 
 inline KJ_WARN_UNUSED_RESULT UsvString usv() { return UsvString(); }
@@ -423,11 +458,14 @@ public:
 
   KJ_DISALLOW_COPY(UsvStringBuilder);
 
-  inline operator UsvStringPtr() KJ_LIFETIMEBOUND { return UsvStringPtr(buffer); }
-  inline UsvStringPtr asPtr() KJ_LIFETIMEBOUND { return UsvStringPtr(*this); }
+  inline operator UsvStringPtr() const KJ_LIFETIMEBOUND { return UsvStringPtr(buffer.asPtr()); }
+  inline UsvStringPtr asPtr() const KJ_LIFETIMEBOUND { return UsvStringPtr(*this); }
 
   void add(uint32_t codepoint);
 
+  void set(size_t index, uint32_t codepoint);
+  // Replaces the codepoint at `index`, which must be less than size().
+
   inline void add(uint32_t codepoint, auto&&... codepoints) {
     add(codepoint);
     add(kj::fwd<decltype(codepoints)>(codepoints)...);
@@ -459,7 +497,8 @@ public:
 
   inline void truncate(size_t size) { buffer.truncate(size); }
 
-  inline UsvString finish() KJ_WARN_UNUSED_RESULT  { return UsvString(buffer.releaseAsArray()); }
+  UsvString finish() KJ_WARN_UNUSED_RESULT;
+  // Returns the string built so far, and clears the builder.
 
   inline kj::String finishAsStr() KJ_WARN_UNUSED_RESULT  { return finish().toStr(); }
 
@@ -16,6 +16,14 @@ struct SelfStruct {
   JSG_STRUCT(self, i);
 };
 
+struct OptionalStruct {
+  int a;
+  Optional<kj::String> b;
+  int c;
+
+  JSG_STRUCT(a, b, c);
+};
+
 struct StructContext: public Object {
   kj::String readTestStruct(TestStruct s) {
     return kj::str(s.str, ", ", s.num, ", ", s.box->value);
@@ -34,15 +42,21 @@ struct StructContext: public Object {
     };
   }
 
+  OptionalStruct makeOptionalStruct(Optional<kj::String> b) {
+    return { .a = 1, .b = kj::mv(b), .c = 3 };
+  }
+
   JSG_RESOURCE_TYPE(StructContext) {
     JSG_NESTED_TYPE(NumberBox);
     JSG_METHOD(readTestStruct);
     JSG_METHOD(makeTestStruct);
     JSG_METHOD(readSelfStruct);
     JSG_METHOD(makeSelfStruct);
+    JSG_METHOD(makeOptionalStruct);
   }
 };
-JSG_DECLARE_ISOLATE_TYPE(StructIsolate, StructContext, NumberBox, TestStruct, SelfStruct);
+JSG_DECLARE_ISOLATE_TYPE(StructIsolate, StructContext, NumberBox, TestStruct, SelfStruct,
+    OptionalStruct);
 
 KJ_TEST("structs") {
   Evaluator<StructContext, StructIsolate> e(v8System);
@@ -67,5 +81,24 @@ KJ_TEST("structs") {
       "string", "{\"i\":456}");
 }
 
+KJ_TEST("struct fields are defined as own data properties") {
+  Evaluator<StructContext, StructIsolate> e(v8System);
+
+  // Setters on Object.prototype must not intercept the fields.
+  e.expectEval(
+      "Object.defineProperty(Object.prototype, 'num', { set(v) { throw new Error('oops'); } });\n"
+      "var s = makeTestStruct('foo', 123, new NumberBox(456));\n"
+      "Object.keys(s).join(', ') + ': ' + s.num",
+      "string", "str, num, box: 123");
+
+  // Absent optional fields are not defined at all; present ones keep their declared order.
+  e.expectEval(
+      "Object.keys(makeOptionalStruct()).join(', ')",
+      "string", "a, c");
+  e.expectEval(
+      "JSON.stringify(makeOptionalStruct('x'))",
+      "string", "{\"a\":1,\"b\":\"x\",\"c\":3}");
+}
+
 }  // namespace
 }  // namespace workerd::jsg::test
@@ -21,6 +21,10 @@ class FieldWrapper {
 public:
   using Type = T;
 
+  static constexpr bool alwaysPresent =
+      !kj::isSameType<T, SelfRef>() && !webidl::isOptional<T>;
+  // True if wrap() always sets this field.
+
   explicit FieldWrapper(v8::Isolate* isolate)
       : nameHandle(isolate, v8StrIntern(isolate, exportedName)) {}
 
@@ -34,7 +38,15 @@ public:
         if (in.*field == nullptr) return;
       }
       auto value = wrapper.wrap(context, creator, kj::mv(in.*field));
-      check(out->Set(context, nameHandle.Get(isolate), value));
+      // Unlike Set(), CreateDataProperty() doesn't look for setters on the prototype chain, which
+      // is both faster and what Web IDL specifies for converting dictionaries.
+      check(out->CreateDataProperty(context, nameHandle.Get(isolate), value));
+    }
+  }
+
+  void addToShape(v8::Isolate* isolate, v8::Local<v8::ObjectTemplate> shape) {
+    if constexpr (!kj::isSameType<T, SelfRef>()) {
+      shape->Set(nameHandle.Get(isolate), v8::Undefined(isolate));
     }
   }
 
@@ -73,7 +85,14 @@ public:
     auto isolate = context->GetIsolate();
     v8::EscapableHandleScope handleScope(isolate);
     auto& fields = getFields(isolate);
-    v8::Local<v8::Object> out = v8::Object::New(isolate);
+    v8::Local<v8::Object> out;
+    if constexpr (hasFixedShape) {
+      // Every field is always set, so start from an object that already has all of them, in
+      // order. Setting each field is then a plain store rather than a transition to a new map.
+      out = check(getShape(isolate)->NewInstance(context));
+    } else {
+      out = v8::Object::New(isolate);
+    }
     (kj::get<indices>(fields).wrap(
         static_cast<Self&>(*this), isolate, context, creator, in, out), ...);
     return handleScope.Escape(out);
@@ -127,7 +146,10 @@ public:
   void getTemplate() = delete;
 
 private:
+  static constexpr bool hasFixedShape = (FieldWrappers::alwaysPresent && ...);
+
   kj::Maybe<kj::Tuple<FieldWrappers...>> lazyFields;
+  v8::Global<v8::ObjectTemplate> shape;
 
   kj::Tuple<FieldWrappers...>& getFields(v8::Isolate* isolate) {
     KJ_IF_MAYBE(f, lazyFields) {
@@ -136,6 +158,16 @@ private:
       return lazyFields.emplace(kj::tuple(FieldWrappers(isolate)...));
     }
   }
+
+  v8::Local<v8::ObjectTemplate> getShape(v8::Isolate* isolate) {
+    if (shape.IsEmpty()) {
+      auto& fields = getFields(isolate);
+      auto tmpl = v8::ObjectTemplate::New(isolate);
+      (kj::get<indices>(fields).addToShape(isolate, tmpl), ...);
+      shape.Reset(isolate, tmpl);
+    }
+    return shape.Get(isolate);
+  }
 };
 
 }  // namespace workerd::jsg
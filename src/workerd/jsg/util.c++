@@ -476,6 +476,31 @@ static kj::Array<kj::byte> getEmptyArray() {
   return kj::Array<kj::byte>(&DUMMY, 0, kj::NullArrayDisposer::instance);
 }
 
+std::unique_ptr<v8::BackingStore> newBackingStore(kj::Array<kj::byte> data) {
+  if (data.size() == 0) {
+    // Nothing to keep alive, so don't bother allocating an owner for the (empty) array.
+    return v8::ArrayBuffer::NewBackingStore(nullptr, 0, v8::BackingStore::EmptyDeleter, nullptr);
+  }
+
+  // We use the version of v8::ArrayBuffer::NewBackingStore() that accepts a deleter callback, and
+  // arrange for it to delete an Array<byte> placed on the heap.
+  //
+  // TODO(perf): We could avoid an allocation here, perhaps, by decomposing the kj::Array<byte>
+  //   into its component pointer and disposer, and then pass the disposer pointer as the
+  //   "deleter_data" for NewBackingStore. However, KJ doesn't give us any way to decompose an
+  //   Array<T> this way, and it might not want to, as this could make it impossible to support
+  //   unifying Array<T> and Vector<T> in the future (i.e. making all Array<T>s growable). So
+  //   it may be best to stick with allocating an Array<byte> on the heap after all...
+  byte* begin = data.begin();
+  size_t size = data.size();
+  auto ownerPtr = new kj::Array<byte>(kj::mv(data));
+
+  return v8::ArrayBuffer::NewBackingStore(begin, size,
+      [](void* begin, size_t size, void* ownerPtr) {
+        delete reinterpret_cast<kj::Array<byte>*>(ownerPtr);
+      }, ownerPtr);
+}
+
 kj::Array<kj::byte> asBytes(v8::Local<v8::ArrayBuffer> arrayBuffer) {
   auto backing = arrayBuffer->GetBackingStore();
   kj::ArrayPtr bytes(static_cast<kj::byte*>(backing->Data()), backing->ByteLength());
@@ -619,8 +644,36 @@ public:
 
   inline uint64_t byteLength() const { return length() * sizeof(Data); }
 
+  ~ExternString() {
+    if (owned != nullptr) {
+      isolate->AdjustAmountOfExternalAllocatedMemory(-static_cast<int64_t>(byteLength()));
+    }
+  }
+
   static v8::MaybeLocal<v8::String> createExtern(v8::Isolate* isolate,
                                                  kj::ArrayPtr<const Data>& buf) {
+    return createExtern(isolate, buf, nullptr);
+  }
+
+  static v8::MaybeLocal<v8::String> createExtern(v8::Isolate* isolate,
+                                                 kj::Array<Data> owned) {
+    kj::ArrayPtr<const Data> buf = owned;
+    return createExtern(isolate, buf, kj::mv(owned));
+  }
+
+private:
+  v8::Isolate* isolate;
+  kj::ArrayPtr<const Data> buf;
+  kj::Array<Data> owned;
+  // If non-null, the string's data, which the string frees when it is collected.
+
+  inline ExternString(v8::Isolate* isolate, kj::ArrayPtr<const Data>& buf,
+                      kj::Array<Data> owned)
+      : isolate(isolate), buf(buf), owned(kj::mv(owned)) {}
+
+  static v8::MaybeLocal<v8::String> createExtern(v8::Isolate* isolate,
+                                                 kj::ArrayPtr<const Data>& buf,
+                                                 kj::Array<Data> owned) {
     if (buf.size() == 0) {
       return v8::String::Empty(isolate);
     }
@@ -632,7 +685,7 @@ public:
 
     // We typically don't use the new keyword in workerd/Workers but in this case we
     // have to.
-    auto resource = new ExternString<Type, Data>(isolate, buf);
+    auto resource = new ExternString<Type, Data>(isolate, buf, kj::mv(owned));
 
     v8::MaybeLocal<v8::String> str;
     if constexpr (kj::isSameType<Type, v8::String::ExternalOneByteStringResource>()) {
@@ -643,19 +696,18 @@ public:
     }
     if (str.IsEmpty()) {
       // This should happen only if the string is too long
+      resource->owned = nullptr;
       delete resource;
       return v8::MaybeLocal<v8::String>();
     }
 
+    if (resource->owned != nullptr) {
+      // Let the GC know about the memory the string holds on to, as Node.js does.
+      isolate->AdjustAmountOfExternalAllocatedMemory(resource->byteLength());
+    }
+
     return str;
   }
-
-private:
-  v8::Isolate* isolate;
-  kj::ArrayPtr<const Data> buf;
-
-  inline ExternString(v8::Isolate* isolate, kj::ArrayPtr<const Data>& buf)
-      : isolate(isolate), buf(buf) {}
 };
 
 using ExternOneByteString = ExternString<v8::String::ExternalOneByteStringResource, char>;
@@ -669,4 +721,12 @@ v8::Local<v8::String> newExternalTwoByteString(Lock& js, kj::ArrayPtr<const uint
   return check(ExternTwoByteString::createExtern(js.v8Isolate, buf));
 }
 
+v8::Local<v8::String> newExternalOneByteString(Lock& js, kj::Array<char> buf) {
+  return check(ExternOneByteString::createExtern(js.v8Isolate, kj::mv(buf)));
+}
+
+v8::Local<v8::String> newExternalTwoByteString(Lock& js, kj::Array<uint16_t> buf) {
+  return check(ExternTwoByteString::createExtern(js.v8Isolate, kj::mv(buf)));
+}
+
 }  // namespace workerd::jsg
@@ -151,6 +151,10 @@ kj::Array<kj::byte> asBytes(v8::Local<v8::ArrayBuffer> arrayBuffer);
 kj::Array<kj::byte> asBytes(v8::Local<v8::ArrayBufferView> arrayBufferView);
 // View the contents of the given v8::ArrayBuffer/ArrayBufferView as an ArrayPtr<byte>.
 
+std::unique_ptr<v8::BackingStore> newBackingStore(kj::Array<kj::byte> data);
+// Creates a v8::BackingStore that takes ownership of `data` without copying it. The array is
+// destroyed when V8 releases the backing store, which may happen on any thread.
+
 void recursivelyFreeze(v8::Local<v8::Context> context, v8::Local<v8::Value> value);
 // Freeze the given object and all its members, making it recursively immutable.
 //
@@ -393,4 +397,11 @@ v8::Local<v8::String> newExternalTwoByteString(Lock& js, kj::ArrayPtr<const uint
 // string methods because it needs to be absolutely clear that these use external buffers
 // that are not owned by the v8 heap.
 
+v8::Local<v8::String> newExternalOneByteString(Lock& js, kj::Array<char> buf);
+v8::Local<v8::String> newExternalTwoByteString(Lock& js, kj::Array<uint16_t> buf);
+// Like the above, but the string takes ownership of buf and frees it once the string is garbage
+// collected. Useful for large strings built outside the v8 heap, which would otherwise have to
+// be copied into it. Small strings are better off copied, as an external string has overhead of
+// its own.
+
 }  // namespace workerd::jsg
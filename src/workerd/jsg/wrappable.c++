@@ -10,6 +10,7 @@
 #include <v8-cppgc.h>
 #include <cppgc/allocation.h>
 #include <cppgc/garbage-collected.h>
+#include <cppgc/heap-state.h>
 
 namespace workerd::jsg {
 
@@ -21,6 +22,11 @@ static thread_local bool inCppgcShimDestructor = false;
 
 bool HeapTracer::isInCppgcDestructor() { return inCppgcShimDestructor; }
 
+bool HeapTracer::isIncrementallyMarking() {
+  return incrementalMarking &&
+      cppgc::subtle::HeapState::IsMarking(isolate->GetCppHeap()->GetHeapHandle());
+}
+
 void HeapTracer::clearWrappers() {
   // When clearing wrappers (at isolate shutdown), we may be destroying objects that were recenly
   // determined to be unreachable, but the CppgcShim destructors haven't been run yet. We need to
@@ -128,8 +134,9 @@ public:
   struct Dead {};
 
   mutable kj::OneOf<Active, Freelisted, Dead> state;
-  // This is `mutable` because `Trace()` is const. We configure V8 to perform traces atomically in
-  // the main thread so concurrency is not a concern.
+  // This is `mutable` because `Trace()` is const. We configure V8 to only trace on the main thread
+  // (atomically, or incrementally if enabled, but never concurrently) so concurrency is not a
+  // concern.
 };
 
 void HeapTracer::addToFreelist(Wrappable::CppgcShim& shim) {
@@ -143,19 +150,25 @@ void HeapTracer::addToFreelist(Wrappable::CppgcShim& shim) {
 }
 
 Wrappable::CppgcShim* HeapTracer::allocateShim(Wrappable& wrappable) {
-  KJ_IF_MAYBE(shim, freelistedShims) {
-    freelistedShims = shim->state.get<Wrappable::CppgcShim::Freelisted>().next;
-    KJ_IF_MAYBE(next, freelistedShims) {
-      next->state.get<Wrappable::CppgcShim::Freelisted>().prev = &freelistedShims;
+  // A freelisted shim is unreachable as far as cppgc is concerned, so if a marking cycle is in
+  // progress it has likely not been marked, and would be swept at the end of the cycle even
+  // though we're using it again. Objects allocated during marking, on the other hand, are
+  // allocated already marked.
+  if (!isIncrementallyMarking()) {
+    KJ_IF_MAYBE(shim, freelistedShims) {
+      freelistedShims = shim->state.get<Wrappable::CppgcShim::Freelisted>().next;
+      KJ_IF_MAYBE(next, freelistedShims) {
+        next->state.get<Wrappable::CppgcShim::Freelisted>().prev = &freelistedShims;
+      }
+      shim->state = Wrappable::CppgcShim::Active { kj::addRef(wrappable) };
+      KJ_DASSERT(wrappable.cppgcShim == nullptr);
+      wrappable.cppgcShim = *shim;
+      return shim;
     }
-    shim->state = Wrappable::CppgcShim::Active { kj::addRef(wrappable) };
-    KJ_DASSERT(wrappable.cppgcShim == nullptr);
-    wrappable.cppgcShim = *shim;
-    return shim;
-  } else {
-    auto& cppgcAllocHandle = isolate->GetCppHeap()->GetAllocationHandle();
-    return cppgc::MakeGarbageCollected<Wrappable::CppgcShim>(cppgcAllocHandle, wrappable);
   }
+
+  auto& cppgcAllocHandle = isolate->GetCppHeap()->GetAllocationHandle();
+  return cppgc::MakeGarbageCollected<Wrappable::CppgcShim>(cppgcAllocHandle, wrappable);
 }
 
 void HeapTracer::clearFreelistedShims() {
@@ -298,6 +311,12 @@ void Wrappable::attachWrapper(v8::Isolate* isolate,
     // references. Performing a visitation pass will update them.
     GcVisitor visitor(*this, nullptr);
     jsgVisitForGc(visitor);
+  } else if (isIncrementallyMarking()) {
+    // The new wrapper was allocated already marked, so V8 won't trace through it during the
+    // current cycle, yet our referrers will now stop their traces at it rather than tracing
+    // through to our references. A visitation pass applies write barriers to those references.
+    GcVisitor visitor(*this, nullptr);
+    jsgVisitForGc(visitor);
   }
 }
 
@@ -328,6 +347,25 @@ void Wrappable::jsgVisitForGc(GcVisitor& visitor) {
   // Nothing; subclasses that need tracing will override.
 }
 
+bool Wrappable::isIncrementallyMarking() {
+  return isolate != nullptr && HeapTracer::getTracer(isolate).isIncrementallyMarking();
+}
+
+void Wrappable::markForIncrementalGc() {
+  KJ_IF_MAYBE(w, wrapper) {
+    // Re-assigning a TracedReference (as opposed to initializing one) runs V8's marking barrier on
+    // the target. Once the wrapper is marked, V8 will trace our shim, and thus our references.
+    v8::HandleScope scope(isolate);
+    w->Reset(isolate, w->Get(isolate));
+    w->SetWrapperClassId(WRAPPABLE_TAG);
+  } else {
+    // Without a wrapper, we are traced through by our referrers, so the barrier has to be applied
+    // to our own references instead. A non-tracing visitation pass does that.
+    GcVisitor visitor(*this, nullptr);
+    jsgVisitForGc(visitor);
+  }
+}
+
 void Wrappable::visitRef(GcVisitor& visitor, kj::Maybe<Wrappable&>& refParent, bool& refStrong) {
   KJ_IF_MAYBE(p, refParent) {
     KJ_ASSERT(p == &visitor.parent);
@@ -377,6 +415,9 @@ void Wrappable::visitRef(GcVisitor& visitor, kj::Maybe<Wrappable&>& refParent, b
       GcVisitor subVisitor(*this, visitor.cppgcVisitor);
       jsgVisitForGc(subVisitor);
     }
+  } else if (!refStrong && isIncrementallyMarking()) {
+    // We're only reachable through tracing from a parent which may already have been traced.
+    markForIncrementalGc();
   }
 }
 
@@ -394,13 +435,21 @@ void GcVisitor::visit(Data& value) {
       // This is only reachable via traced objects, so the handle should be weak, and we should
       // hold a TracedReference alongside it.
       if (value.tracedHandle == nullptr) {
-        // Create the TracedReference.
+        // Create the TracedReference. We assign it with Reset(), rather than constructing it
+        // directly, because only assignment runs V8's marking barrier: if a marking cycle is in
+        // progress, `parent` may already have been traced.
         v8::HandleScope scope(parent.isolate);
-        value.tracedHandle = v8::TracedReference<v8::Data>(
-            parent.isolate, value.handle.Get(parent.isolate));
+        value.tracedHandle.emplace().Reset(parent.isolate, value.handle.Get(parent.isolate));
 
         // Set the handle weak.
         value.handle.SetWeak();
+      } else if (cppgcVisitor == nullptr && parent.isIncrementallyMarking()) {
+        // The handle was already weak, but this visitation may be the write barrier for a parent
+        // which is no longer traced through (see Wrappable::markForIncrementalGc()).
+        KJ_IF_MAYBE(t, value.tracedHandle) {
+          v8::HandleScope scope(parent.isolate);
+          t->Reset(parent.isolate, t->Get(parent.isolate));
+        }
       }
     }
 
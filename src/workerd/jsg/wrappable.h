@@ -126,6 +126,15 @@ public:
 private:
   class CppgcShim;
 
+  bool isIncrementallyMarking();
+
+  void markForIncrementalGc();
+  // Write barrier for incremental marking. Called when, outside of a GC trace, a reference to this
+  // object is found to be weak (i.e. the object is only kept alive by tracing) while a marking
+  // cycle is in progress. The referrer may already have been traced, in which case the marker
+  // would never find this object, so we mark it (or, without a wrapper, everything it
+  // references) explicitly.
+
   kj::Maybe<CppgcShim&> cppgcShim;
   // If a JS wrapper is currently allocated, this point to the cppgc shim object.
 
@@ -166,7 +175,7 @@ class HeapTracer: public v8::EmbedderRootsHandler {
   // For historical reasons, this is actually implemented in setup.c++.
 
 public:
-  explicit HeapTracer(v8::Isolate* isolate);
+  explicit HeapTracer(v8::Isolate* isolate, bool incrementalMarking);
 
   ~HeapTracer() noexcept {
     // Destructor has to be noexcept because it inherits from a V8 type that has a noexcept
@@ -183,6 +192,11 @@ public:
   // Returns true if the current thread is currently executing the destructor of a CppgcShim
   // object, which implies that we are collecting unreachable objects.
 
+  bool isIncrementallyMarking();
+  // Returns true if an incremental marking cycle is in progress. JavaScript and C++ then run in
+  // between marking steps, so objects which were already traced may gain references to objects
+  // which were not, and Wrappable must apply write barriers (see markForIncrementalGc()).
+
   void addWrapper(kj::Badge<Wrappable>, Wrappable& wrappable) { wrappers.add(wrappable); }
   void removeWrapper(kj::Badge<Wrappable>, Wrappable& wrappable) { wrappers.remove(wrappable); }
   void clearWrappers();
@@ -198,6 +212,7 @@ public:
 
 private:
   v8::Isolate* isolate;
+  bool incrementalMarking;
   kj::Vector<Wrappable*> wrappersToTrace;
 
   kj::Vector<Wrappable*> detachLater;
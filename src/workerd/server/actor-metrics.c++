@@ -0,0 +1,161 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "actor-metrics.h"
+
+namespace workerd::server {
+
+class ActorCacheMetrics::Observer final: public ActorObserver {
+  // Like any ActorObserver, only used from the actor's own thread; the shared ClassStats are
+  // updated with relaxed atomics since several actors of the same class may run on different
+  // threads.
+
+public:
+  explicit Observer(kj::Own<const ClassStats> stats): stats(kj::mv(stats)) {}
+
+  ~Observer() noexcept(false) {
+    stats->residentBytes.fetch_sub(lastResident, std::memory_order_relaxed);
+    stats->dirtyBytes.fetch_sub(lastDirty, std::memory_order_relaxed);
+  }
+
+  void addStorageCacheHits(StorageCacheOp op, uint32_t count) override {
+    counter(op, stats->getHits, stats->listHits).fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void addStorageCacheMisses(StorageCacheOp op, uint32_t count) override {
+    counter(op, stats->getMisses, stats->listMisses).fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void addStorageCacheEvictions(uint32_t count) override {
+    stats->evictions.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void storageCacheFlushed(kj::Duration latency) override {
+    stats->flushMicros.record(latency / kj::MICROSECONDS);
+  }
+
+  void sqlQueryCompleted(uint64_t rowsRead, uint64_t rowsWritten,
+                         kj::Duration duration) override {
+    stats->sqlRowsRead.fetch_add(rowsRead, std::memory_order_relaxed);
+    stats->sqlRowsWritten.fetch_add(rowsWritten, std::memory_order_relaxed);
+    stats->sqlQueryMicros.record(duration / kj::MICROSECONDS);
+  }
+
+  void reportStorageCacheSize(size_t residentBytes, size_t dirtyBytes) override {
+    int64_t resident = residentBytes;
+    int64_t dirty = dirtyBytes;
+    stats->residentBytes.fetch_add(resident - lastResident, std::memory_order_relaxed);
+    stats->dirtyBytes.fetch_add(dirty - lastDirty, std::memory_order_relaxed);
+    lastResident = resident;
+    lastDirty = dirty;
+  }
+
+private:
+  kj::Own<const ClassStats> stats;
+  int64_t lastResident = 0;
+  int64_t lastDirty = 0;
+
+  static std::atomic<uint64_t>& counter(StorageCacheOp op,
+      std::atomic<uint64_t>& get, std::atomic<uint64_t>& list) {
+    switch (op) {
+      case StorageCacheOp::GET: return get;
+      case StorageCacheOp::LIST: return list;
+    }
+    KJ_UNREACHABLE;
+  }
+};
+
+kj::Own<ActorObserver> ActorCacheMetrics::makeActorObserver(kj::StringPtr className) {
+  auto lock = classes.lockExclusive();
+  auto& stats = lock->findOrCreate(className,
+      [&]() -> kj::HashMap<kj::String, kj::Own<const ClassStats>>::Entry {
+    return { kj::str(className), kj::atomicRefcounted<ClassStats>(kj::str(className)) };
+  });
+  return kj::refcounted<Observer>(kj::atomicAddRef(*stats));
+}
+
+kj::String ActorCacheMetrics::render() const {
+  auto lock = classes.lockShared();
+
+  kj::Vector<kj::String> out;
+  auto header = [&](kj::StringPtr metric, kj::StringPtr type, kj::StringPtr help) {
+    out.add(kj::str("# HELP ", metric, ' ', help, '\n'));
+    out.add(kj::str("# TYPE ", metric, ' ', type, '\n'));
+  };
+  auto forEachClass = [&](auto&& func) {
+    for (auto& entry: *lock) {
+      auto labels = kj::str("class=\"", escapePrometheusLabel(entry.key), '"');
+      func(labels, *entry.value);
+    }
+  };
+
+  header("workerd_actor_storage_cache_hits_total", "counter",
+      "Storage reads satisfied from the actor cache.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    out.add(kj::str("workerd_actor_storage_cache_hits_total{", labels, ",op=\"get\"} ",
+        stats.getHits.load(std::memory_order_relaxed), '\n'));
+    out.add(kj::str("workerd_actor_storage_cache_hits_total{", labels, ",op=\"list\"} ",
+        stats.listHits.load(std::memory_order_relaxed), '\n'));
+  });
+
+  header("workerd_actor_storage_cache_misses_total", "counter",
+      "Storage reads that had to go to the underlying storage.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    out.add(kj::str("workerd_actor_storage_cache_misses_total{", labels, ",op=\"get\"} ",
+        stats.getMisses.load(std::memory_order_relaxed), '\n'));
+    out.add(kj::str("workerd_actor_storage_cache_misses_total{", labels, ",op=\"list\"} ",
+        stats.listMisses.load(std::memory_order_relaxed), '\n'));
+  });
+
+  header("workerd_actor_storage_cache_evictions_total", "counter",
+      "Entries evicted from the actor cache to stay under its memory limit or for going stale.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    out.add(kj::str("workerd_actor_storage_cache_evictions_total{", labels, "} ",
+        stats.evictions.load(std::memory_order_relaxed), '\n'));
+  });
+
+  header("workerd_actor_storage_cache_resident_bytes", "gauge",
+      "Bytes of keys and values held in the actor cache.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    out.add(kj::str("workerd_actor_storage_cache_resident_bytes{", labels, "} ",
+        stats.residentBytes.load(std::memory_order_relaxed), '\n'));
+  });
+
+  header("workerd_actor_storage_cache_dirty_bytes", "gauge",
+      "Bytes of writes in the actor cache not yet flushed to storage.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    out.add(kj::str("workerd_actor_storage_cache_dirty_bytes{", labels, "} ",
+        stats.dirtyBytes.load(std::memory_order_relaxed), '\n'));
+  });
+
+  header("workerd_actor_storage_cache_flush_microseconds", "histogram",
+      "Time taken to flush the actor cache's dirty entries to storage.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    stats.flushMicros.render(out, "workerd_actor_storage_cache_flush_microseconds", labels);
+  });
+
+  header("workerd_actor_sql_rows_read_total", "counter",
+      "Rows read by SQL queries, including rows stepped over by full table scans.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    out.add(kj::str("workerd_actor_sql_rows_read_total{", labels, "} ",
+        stats.sqlRowsRead.load(std::memory_order_relaxed), '\n'));
+  });
+
+  header("workerd_actor_sql_rows_written_total", "counter",
+      "Rows inserted, updated, or deleted by SQL queries.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    out.add(kj::str("workerd_actor_sql_rows_written_total{", labels, "} ",
+        stats.sqlRowsWritten.load(std::memory_order_relaxed), '\n'));
+  });
+
+  header("workerd_actor_sql_query_microseconds", "histogram",
+      "Time spent executing SQL queries.");
+  forEachClass([&](kj::StringPtr labels, const ClassStats& stats) {
+    stats.sqlQueryMicros.render(out, "workerd_actor_sql_query_microseconds", labels);
+  });
+
+  return kj::strArray(out, "");
+}
+
+}  // namespace workerd::server
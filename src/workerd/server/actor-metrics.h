@@ -0,0 +1,68 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include "lock-metrics.h"
+#include <kj/map.h>
+#include <atomic>
+
+namespace workerd::server {
+
+class ActorCacheMetrics {
+  // Collects Durable Object storage cache statistics and renders them in the Prometheus text
+  // exposition format, alongside LockMetrics. Created per Server when the config defines a
+  // `metrics` service; each actor then gets an observer from `makeActorObserver()` in place of
+  // the default no-op ActorObserver.
+  //
+  // Statistics are aggregated per Durable Object class rather than per actor, so that the
+  // number of series stays bounded no matter how many actors are alive:
+  // - Cache hits and misses, by operation (`get` or `list`).
+  // - Entries evicted under memory pressure or for going stale.
+  // - Bytes currently resident in, and dirty in, the cache, summed over live actors.
+  // - Flush latency (microseconds).
+  // - For SQLite-backed actors, rows read and written by `state.storage.sql` queries, and query
+  //   execution time (microseconds).
+
+public:
+  kj::Own<ActorObserver> makeActorObserver(kj::StringPtr className);
+  // Construct an observer that reports into this ActorCacheMetrics. The observer may outlive
+  // the ActorCacheMetrics.
+
+  kj::String render() const;
+  // Render all metrics in the Prometheus text exposition format.
+
+  class ClassStats;
+
+private:
+  class Observer;
+
+  kj::MutexGuarded<kj::HashMap<kj::String, kj::Own<const ClassStats>>> classes;
+};
+
+class ActorCacheMetrics::ClassStats final: public kj::AtomicRefcounted {
+public:
+  explicit ClassStats(kj::String name): name(kj::mv(name)) {}
+
+  kj::String name;
+
+  mutable std::atomic<uint64_t> getHits = 0;
+  mutable std::atomic<uint64_t> getMisses = 0;
+  mutable std::atomic<uint64_t> listHits = 0;
+  mutable std::atomic<uint64_t> listMisses = 0;
+  mutable std::atomic<uint64_t> evictions = 0;
+
+  mutable std::atomic<int64_t> residentBytes = 0;
+  mutable std::atomic<int64_t> dirtyBytes = 0;
+  // Gauges. Each observer adds the delta from its previous report, and subtracts its last
+  // report when it's destroyed.
+
+  LockHistogram flushMicros;
+
+  mutable std::atomic<uint64_t> sqlRowsRead = 0;
+  mutable std::atomic<uint64_t> sqlRowsWritten = 0;
+  LockHistogram sqlQueryMicros;
+};
+
+}  // namespace workerd::server
@@ -0,0 +1,138 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "alarm-scheduler.h"
+#include <kj/test.h>
+
+namespace workerd::server {
+namespace {
+
+constexpr kj::Date START = kj::UNIX_EPOCH + 1'000'000 * kj::SECONDS;
+
+class FakeClock final: public kj::Clock {
+  // A calendar clock that advances with `timer`.
+
+public:
+  FakeClock(kj::Timer& timer): timer(timer) {}
+
+  kj::Date now() const override {
+    return START + (timer.now() - kj::origin<kj::TimePoint>());
+  }
+
+private:
+  kj::Timer& timer;
+};
+
+class AlarmRecorder final: public WorkerInterface {
+  // Records the alarms delivered to one actor, and reports success for each.
+
+public:
+  AlarmRecorder(kj::Vector<kj::Date>& ran): ran(ran) {}
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, Response& response) override {
+    KJ_UNIMPLEMENTED("not used in this test");
+  }
+
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    KJ_UNIMPLEMENTED("not used in this test");
+  }
+
+  void prewarm(kj::StringPtr url) override {}
+
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    KJ_UNIMPLEMENTED("not used in this test");
+  }
+
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+    ran.add(scheduledTime);
+    return AlarmResult { .retry = false, .outcome = EventOutcome::OK };
+  }
+
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    KJ_UNIMPLEMENTED("not used in this test");
+  }
+
+private:
+  kj::Vector<kj::Date>& ran;
+};
+
+struct AlarmTestFixture {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope { loop };
+  kj::TimerImpl timer { kj::origin<kj::TimePoint>() };
+  FakeClock clock { timer };
+  kj::Own<kj::Directory> dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs { *dir };
+  kj::Vector<kj::Date> ran;
+
+  kj::Own<AlarmScheduler> makeScheduler() {
+    auto scheduler = kj::heap<AlarmScheduler>(clock, timer, vfs, kj::Path({"alarms.sqlite"}));
+    scheduler->registerNamespace("ns", [this](kj::String) -> kj::Own<WorkerInterface> {
+      return kj::heap<AlarmRecorder>(ran);
+    });
+    return scheduler;
+  }
+
+  void advance(kj::Duration duration) {
+    // Advances time in small steps, letting everything that becomes due run at each one.
+    auto end = timer.now() + duration;
+    while (timer.now() < end) {
+      timer.advanceTo(kj::min(end, timer.now() + kj::SECONDS));
+      waitScope.poll();
+    }
+  }
+};
+
+KJ_TEST("AlarmScheduler setAlarm() resolves once the alarm is stored") {
+  AlarmTestFixture f;
+  ActorKey actor { .uniqueKey = "ns", .actorId = "a" };
+
+  {
+    auto scheduler = f.makeScheduler();
+    auto promise = scheduler->setAlarm(actor, START + 5 * kj::HOURS);
+    KJ_EXPECT(!promise.poll(f.waitScope));
+    f.advance(AlarmScheduler::PERSIST_DELAY);
+    KJ_EXPECT(promise.poll(f.waitScope));
+    promise.wait(f.waitScope);
+  }
+
+  // A new scheduler over the same database sees the alarm, even though it's outside the window
+  // of alarms loaded at startup.
+  auto scheduler = f.makeScheduler();
+  KJ_EXPECT(KJ_ASSERT_NONNULL(scheduler->getAlarm(actor)) == START + 5 * kj::HOURS);
+}
+
+KJ_TEST("AlarmScheduler loads alarms beyond the initial window as time advances") {
+  AlarmTestFixture f;
+  ActorKey actor { .uniqueKey = "ns", .actorId = "a" };
+  auto scheduledTime = START + AlarmScheduler::LOAD_WINDOW * 3 + 30 * kj::MINUTES;
+
+  {
+    auto scheduler = f.makeScheduler();
+    auto promise = scheduler->setAlarm(actor, scheduledTime);
+    f.advance(AlarmScheduler::PERSIST_DELAY);
+    promise.wait(f.waitScope);
+  }
+
+  // Nothing is due within the window loaded at startup, so nothing else arms the timer: it must be
+  // armed for the end of the window anyway, to load the stored alarm when its time approaches.
+  auto scheduler = f.makeScheduler();
+
+  f.advance(scheduledTime - f.clock.now() - kj::SECONDS);
+  KJ_EXPECT(f.ran.size() == 0);
+
+  f.advance(2 * kj::SECONDS);
+  KJ_ASSERT(f.ran.size() == 1);
+  KJ_EXPECT(f.ran[0] == scheduledTime);
+
+  // The alarm was deleted once it ran.
+  KJ_EXPECT(scheduler->getAlarm(actor) == nullptr);
+}
+
+}  // namespace
+}  // namespace workerd::server
@@ -22,6 +22,14 @@ std::default_random_engine makeSeededRandomEngine() {
   return engine;
 }
 
+int64_t toNs(kj::Date date) {
+  return (date - kj::UNIX_EPOCH) / kj::NANOSECONDS;
+}
+
+kj::Date fromNs(int64_t ns) {
+  return kj::UNIX_EPOCH + (kj::NANOSECONDS * ns);
+}
+
 } // namespace
 
 AlarmScheduler::AlarmScheduler(
@@ -37,9 +45,16 @@ AlarmScheduler::AlarmScheduler(
         return kj::mv(db);
       }()),
       tasks(*this) {
-    loadAlarmsFromDb();
+    // Initially, also load any alarms that are already overdue.
+    loadAlarmsFromDb(kj::minValue, clock.now());
   }
 
+AlarmScheduler::~AlarmScheduler() noexcept(false) {
+  KJ_IF_MAYBE(e, kj::runCatchingExceptions([&]() { persistPendingWrites(); })) {
+    KJ_LOG(ERROR, "failed to persist alarms on shutdown", *e);
+  }
+}
+
 void AlarmScheduler::ensureInitialized(SqliteDatabase& db) {
   // TODO(sqlite): Do this automatically at a lower layer?
   db.run("PRAGMA journal_mode=WAL;");
@@ -52,29 +67,32 @@ void AlarmScheduler::ensureInitialized(SqliteDatabase& db) {
       PRIMARY KEY (actor_unique_key, actor_id)
     ) WITHOUT ROWID;
   )");
+
+  db.run(R"(
+    CREATE INDEX IF NOT EXISTS _cf_ALARM_scheduled_time ON _cf_ALARM(scheduled_time);
+  )");
 }
 
-void AlarmScheduler::loadAlarmsFromDb() {
-  auto now = clock.now();
+void AlarmScheduler::loadAlarmsFromDb(int64_t lowerBoundNs, kj::Date now) {
+  // Make sure the database reflects every setAlarm() and deleteAlarm() so far.
+  persistPendingWrites();
 
-  // TODO(someday): don't maintain the entire alarm set in memory -- right now for the usecase of
-  // local development, doing so is sufficent.
-  auto query = db->run(R"(
-    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM;
-  )");
+  loadedUntil = now + LOAD_WINDOW;
+  auto query = stmtLoadAlarms.run(lowerBoundNs, toNs(loadedUntil));
 
   while (!query.isDone()) {
-    auto date = kj::UNIX_EPOCH + (kj::NANOSECONDS * query.getInt64(2));
+    ActorKey key { .uniqueKey = query.getText(0), .actorId = query.getText(1) };
 
-    auto ownUniqueKey = kj::str(query.getText(0));
-    auto ownActorId = kj::str(query.getText(1));
-    auto actor = kj::attachVal(ActorKey { .uniqueKey = ownUniqueKey, .actorId = ownActorId },
-        kj::mv(ownUniqueKey), kj::mv(ownActorId));
-
-    alarms.insert(*actor, scheduleAlarm(now, kj::mv(actor), date));
+    // Alarms that were set while further out than the window may already be in memory, in which
+    // case the in-memory state is authoritative.
+    if (alarms.find(key) == nullptr) {
+      addAlarmInMemory(key.clone(), fromNs(query.getInt64(2)));
+    }
 
     query.nextRow();
   }
+
+  armTimer();
 }
 
 void AlarmScheduler::registerNamespace(kj::StringPtr uniqueKey, GetActorFn getActor) {
@@ -92,62 +110,62 @@ kj::Maybe<kj::Date> AlarmScheduler::getAlarm(ActorKey actor) {
     } else {
       return alarm->scheduledTime;
     }
+  } else KJ_IF_MAYBE(write, pendingWrites.find(actor)) {
+    return write->scheduledTime;
   } else {
-    // We currently retain the entire set of queued alarms in memory, no need to hit sqlite
-    return nullptr;
+    // The alarm, if any, isn't due within the load window, so it's only in the database.
+    auto query = stmtGetAlarm.run(actor.uniqueKey, actor.actorId);
+    if (query.isDone()) {
+      return nullptr;
+    } else {
+      return fromNs(query.getInt64(0));
+    }
   }
 }
 
-bool AlarmScheduler::setAlarm(ActorKey actor, kj::Date scheduledTime) {
-  int64_t scheduledTimeNs = (scheduledTime - kj::UNIX_EPOCH) / kj::NANOSECONDS;
-  auto query = stmtSetAlarm.run(actor.uniqueKey, actor.actorId, scheduledTimeNs);
+kj::Promise<void> AlarmScheduler::setAlarm(ActorKey actor, kj::Date scheduledTime) {
+  auto persisted = persistLater(actor, scheduledTime);
 
-  bool existing = true;
-  auto& entry = alarms.findOrCreate(actor, [&]() {
-    existing = false;
-
-    auto ownUniqueKey = kj::str(actor.uniqueKey);
-    auto ownActorId = kj::str(actor.actorId);
-    auto ownActor = kj::attachVal(ActorKey { .uniqueKey = ownUniqueKey, .actorId = ownActorId },
-    kj::mv(ownUniqueKey), kj::mv(ownActorId));
-
-    return decltype(alarms)::Entry {
-        *ownActor, scheduleAlarm(clock.now(), kj::mv(ownActor), scheduledTime) };
-  });
-
-  if (existing) {
-    if (entry.status != AlarmStatus::WAITING) {
+  KJ_IF_MAYBE(entry, alarms.find(actor)) {
+    if (entry->status != AlarmStatus::WAITING) {
       // We queue any new alarm after the existing alarm even if the new alarm has the same scheduled
       // time, as receiving a notification directly maps to a write for that time in the actor.
-      entry.queuedAlarm = scheduledTime;
+      entry->queuedAlarm = scheduledTime;
     } else {
-      entry = scheduleAlarm(clock.now(), kj::mv(entry.actor), scheduledTime);
+      reschedule(*entry, scheduledTime);
     }
+  } else if (scheduledTime < loadedUntil) {
+    addAlarmInMemory(actor.clone(), scheduledTime);
+  } else {
+    // We'll load the alarm from the database when its time approaches.
   }
 
-  return query.changeCount() > 0;
+  return persisted;
 }
 
-bool AlarmScheduler::deleteAlarm(ActorKey actor) {
-  auto query = stmtDeleteAlarm.run(actor.uniqueKey, actor.actorId);
+kj::Promise<void> AlarmScheduler::deleteAlarm(ActorKey actor) {
+  auto persisted = persistLater(actor, nullptr);
+  deleteAlarmInMemory(actor);
+  return persisted;
+}
 
+void AlarmScheduler::deleteAlarmInMemory(const ActorKey& actor) {
   KJ_IF_MAYBE(entry, alarms.findEntry(actor)) {
     KJ_IF_MAYBE(queued, entry->value.queuedAlarm) {
       if ((*entry).value.status == AlarmStatus::STARTED) {
         // If we are currently running an alarm, we want to delete the queued instead of current.
         entry->value.queuedAlarm = nullptr;
       } else {
-        entry->value = scheduleAlarm(clock.now(), kj::mv(entry->value.actor), *queued);
+        reschedule(entry->value, *queued);
       }
     } else {
       if ((*entry).value.status != AlarmStatus::STARTED) {
         // We can't remove running alarms.
+        cancelWakeup(entry->value);
         alarms.erase(*entry);
       }
     }
   }
-
-  return query.changeCount() > 0;
 }
 
 kj::Promise<AlarmScheduler::RetryInfo> AlarmScheduler::runAlarm(
@@ -164,97 +182,223 @@ kj::Promise<AlarmScheduler::RetryInfo> AlarmScheduler::runAlarm(
   }
 }
 
-AlarmScheduler::ScheduledAlarm AlarmScheduler::scheduleAlarm(
-    kj::Date now, kj::Own<ActorKey> actor, kj::Date scheduledTime) {
-  auto task = makeAlarmTask(scheduledTime - now, *actor, scheduledTime);
+void AlarmScheduler::addAlarmInMemory(kj::Own<ActorKey> actor, kj::Date scheduledTime) {
+  ActorKey key = *actor;
+  auto& entry = alarms.insert(key, ScheduledAlarm {
+    .actor = kj::mv(actor), .scheduledTime = scheduledTime });
+  wakeAt(entry.value, scheduledTime);
+}
+
+void AlarmScheduler::reschedule(ScheduledAlarm& alarm, kj::Date scheduledTime) {
+  cancelWakeup(alarm);
+  alarm = ScheduledAlarm { .actor = kj::mv(alarm.actor), .scheduledTime = scheduledTime };
+  wakeAt(alarm, scheduledTime);
+}
+
+void AlarmScheduler::wakeAt(ScheduledAlarm& alarm, kj::Date time) {
+  KJ_ASSERT(alarm.wakeup == nullptr);
+  Wakeup wakeup { .time = time, .seq = wakeupCounter++ };
+  wakeups.insert(wakeup, *alarm.actor);
+  alarm.wakeup = wakeup;
+  armTimer();
+}
+
+void AlarmScheduler::cancelWakeup(ScheduledAlarm& alarm) {
+  KJ_IF_MAYBE(wakeup, alarm.wakeup) {
+    wakeups.erase(*wakeup);
+    alarm.wakeup = nullptr;
+  }
+}
+
+void AlarmScheduler::armTimer() {
+  kj::Date target = loadedUntil;
+  auto first = wakeups.begin();
+  if (first != wakeups.end()) {
+    target = kj::min(target, first->key.time);
+  }
 
-  return ScheduledAlarm { kj::mv(actor), scheduledTime, kj::mv(task) };
+  if (wakeTimer != nullptr && wakeTimerTime <= target) {
+    // Already armed early enough. If we wake up before anything is due, we'll just re-arm.
+    return;
+  }
+
+  wakeTimerTime = target;
+  wakeTimer = timer.afterDelay(target - clock.now()).then([this]() {
+    onWakeTimer();
+  }).eagerlyEvaluate([](kj::Exception&& e) {
+    KJ_LOG(ERROR, "alarm scheduler failed to process due alarms", e);
+  });
 }
 
-kj::Promise<void> AlarmScheduler::makeAlarmTask(
-    kj::Duration delay, const ActorKey& actorRef, kj::Date scheduledTime) {
-  return timer.afterDelay(delay).then([this, actor = actorRef.clone(), scheduledTime]() mutable
+void AlarmScheduler::onWakeTimer() {
+  // We can't destroy the timer promise from within its own continuation.
+  tasks.add(kj::mv(KJ_ASSERT_NONNULL(wakeTimer)));
+  wakeTimer = nullptr;
+
+  // The calendar clock may lag slightly behind the timer.
+  auto now = kj::max(clock.now(), wakeTimerTime);
+
+  if (now >= loadedUntil) {
+    loadAlarmsFromDb(toNs(loadedUntil), now);
+  }
+
+  for (;;) {
+    auto first = wakeups.begin();
+    if (first == wakeups.end() || first->key.time > now) break;
+
+    Wakeup due = first->key;
+    ActorKey actor = first->value;
+    wakeups.erase(due);
+    auto& alarm = KJ_ASSERT_NONNULL(alarms.find(actor));
+    alarm.wakeup = nullptr;
+    startAlarm(alarm);
+  }
+
+  armTimer();
+}
+
+void AlarmScheduler::startAlarm(ScheduledAlarm& alarm) {
+  alarm.status = AlarmStatus::STARTED;
+
+  auto scheduledTime = alarm.scheduledTime;
+  alarm.task = runAlarm(*alarm.actor, scheduledTime).catch_([](kj::Exception&& e)
       -> kj::Promise<RetryInfo> {
-    {
-      auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(*actor));
-      entry.value.status = AlarmStatus::STARTED;
-    }
+    KJ_LOG(WARNING, e);
+
+    return RetryInfo {
+      .retry = true,
+
+      // An exception here is "weird", they should normally
+      // be turned into AlarmResult statuses in the sandbox
+      // for any user-caused error. Let's not count this
+      // retry attempt against the limit.
+      .retryCountsAgainstLimit = false
+    };
+  }).then([this, actor = alarm.actor->clone(), scheduledTime](RetryInfo retryInfo) {
+    finishAlarm(*actor, scheduledTime, retryInfo);
+  }).eagerlyEvaluate([actor = alarm.actor->clone()](kj::Exception&& e) {
+    KJ_LOG(ERROR, "Failed to run alarm and was unable to schedule a retry", e);
+  });
+}
+
+void AlarmScheduler::finishAlarm(
+    const ActorKey& actor, kj::Date scheduledTime, RetryInfo retryInfo) {
+  auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(actor));
+
+  // We can't overwrite our entry before moving ourselves out of it, as a promise cannot
+  // delete itself.
+  KJ_IF_MAYBE(task, entry.value.task) {
+    tasks.add(kj::mv(*task));
+    entry.value.task = nullptr;
+  }
 
-    return runAlarm(*actor, scheduledTime).catch_([](kj::Exception&& e)
-        -> kj::Promise<RetryInfo> {
-      KJ_LOG(WARNING, e);
-
-      return RetryInfo {
-        .retry = true,
-
-        // An exception here is "weird", they should normally
-        // be turned into AlarmResult statuses in the sandbox
-        // for any user-caused error. Let's not count this
-        // retry attempt against the limit.
-        .retryCountsAgainstLimit = false
-      };
-    });
-  }).then([this, actor = actorRef.clone(), scheduledTime](RetryInfo retryInfo) -> kj::Promise<void> {
-    auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(*actor));
-
-    // We can't overwrite our entry before moving ourselves out of it, as a promise cannot
-    // delete itself.
-    tasks.add(kj::mv(entry.value.task));
-
-    // If an alarm is queued, there's no point in retrying the current one -- proceed
-    // to running the queued alarm instead.
-    KJ_IF_MAYBE(a, entry.value.queuedAlarm) {
-      // creating a new alarm and overwriting the old one will reset
-      // `status` to WAITING and `queuedAlarm` to null
-      entry.value = scheduleAlarm(clock.now(), kj::mv(entry.value.actor), *a);
-      return kj::READY_NOW;
+  // If an alarm is queued, there's no point in retrying the current one -- proceed
+  // to running the queued alarm instead.
+  KJ_IF_MAYBE(a, entry.value.queuedAlarm) {
+    // rescheduling will reset `status` to WAITING and `queuedAlarm` to null
+    reschedule(entry.value, *a);
+    return;
+  }
+
+  // When we reach this block of code and alarm has either successed or failed and may (or may not)
+  // retry. Setting the status of an alarm as FINISHED here, will allow deletion of alarms between
+  // retries. If there's a retry, startAlarm() is called when it's due, setting status as STARTED
+  // again.
+  entry.value.status = AlarmStatus::FINISHED;
+
+  if (retryInfo.retry) {
+    // schedule a wakeup after a delay determined using the retry factor
+    if (entry.value.countedRetry >= AlarmScheduler::RETRY_MAX_TRIES) {
+      auto ownActor = entry.value.actor->clone();
+      persistLater(*ownActor, nullptr).detach([](kj::Exception&&) {});
+      deleteAlarmInMemory(*ownActor);
+      return;
     }
+    if (retryInfo.retryCountsAgainstLimit) {
+      entry.value.countedRetry++;
 
-    // When we reach this block of code and alarm has either successed or failed and may (or may not)
-    // retry. Setting the status of an alarm as FINISHED here, will allow deletion of alarms between
-    // retries. If there's a retry, `makeAlarmTask` is called, setting status as RUNNING again.
-    entry.value.status = AlarmStatus::FINISHED;
+      if (!entry.value.previousRetryCountedAgainstLimit) {
+        // The last retry didn't count against the limit, indicating it was due to some internal
+        // error. However, this retry does, meaning it's due to an error in user code,
+        // most likely a different error. We should reset the retry counter used for
+        // calculating backoff, so user-caused retries don't have an unnecessarily high backoff
+        // time if they come after internal-caused retries.
 
-    if (retryInfo.retry) {
-      // recreate the task, running after a delay determined using the retry factor
-      if (entry.value.countedRetry >= AlarmScheduler::RETRY_MAX_TRIES) {
-        deleteAlarm(*entry.value.actor);
-        return kj::READY_NOW;
-      }
-      if (retryInfo.retryCountsAgainstLimit) {
-        entry.value.countedRetry++;
-
-        if (!entry.value.previousRetryCountedAgainstLimit) {
-          // The last retry didn't count against the limit, indicating it was due to some internal
-          // error. However, this retry does, meaning it's due to an error in user code,
-          // most likely a different error. We should reset the retry counter used for
-          // calculating backoff, so user-caused retries don't have an unnecessarily high backoff
-          // time if they come after internal-caused retries.
-
-          entry.value.backoff = 0;
-        }
+        entry.value.backoff = 0;
       }
-      entry.value.previousRetryCountedAgainstLimit = retryInfo.retryCountsAgainstLimit;
+    }
+    entry.value.previousRetryCountedAgainstLimit = retryInfo.retryCountsAgainstLimit;
 
-      entry.value.backoff = kj::min(AlarmScheduler::RETRY_BACKOFF_MAX, entry.value.backoff);
-      auto delay = (AlarmScheduler::RETRY_START_SECONDS << entry.value.backoff) * kj::SECONDS;
+    entry.value.backoff = kj::min(AlarmScheduler::RETRY_BACKOFF_MAX, entry.value.backoff);
+    auto delay = (AlarmScheduler::RETRY_START_SECONDS << entry.value.backoff) * kj::SECONDS;
 
-      std::uniform_int_distribution<> distribution(0, maxJitterMsForDelay(delay));
-      delay += distribution(random) * kj::MILLISECONDS;
+    std::uniform_int_distribution<> distribution(0, maxJitterMsForDelay(delay));
+    delay += distribution(random) * kj::MILLISECONDS;
 
-      entry.value.backoff++;
-      entry.value.retry++;
+    entry.value.backoff++;
+    entry.value.retry++;
 
-      entry.value.task = makeAlarmTask(delay, *actor, scheduledTime);
-    } else {
-      KJ_ASSERT(entry.value.queuedAlarm == nullptr);
-      deleteAlarm(*actor);
+    // The retry runs with the original `scheduledTime`, which is unchanged in `entry`.
+    KJ_ASSERT(entry.value.scheduledTime == scheduledTime);
+    wakeAt(entry.value, clock.now() + delay);
+  } else {
+    KJ_ASSERT(entry.value.queuedAlarm == nullptr);
+    persistLater(actor, nullptr).detach([](kj::Exception&&) {});
+    deleteAlarmInMemory(actor);
+  }
+}
+
+kj::Promise<void> AlarmScheduler::persistLater(
+    ActorKey actor, kj::Maybe<kj::Date> scheduledTime) {
+  KJ_IF_MAYBE(write, pendingWrites.find(actor)) {
+    write->scheduledTime = scheduledTime;
+  } else {
+    auto ownActor = actor.clone();
+    ActorKey key = *ownActor;
+    pendingWrites.insert(key, PendingWrite {
+      .actor = kj::mv(ownActor), .scheduledTime = scheduledTime });
+  }
+
+  if (!persistScheduled) {
+    persistScheduled = true;
+    tasks.add(timer.afterDelay(PERSIST_DELAY).then([this]() {
+      persistScheduled = false;
+      persistPendingWrites();
+    }));
+  }
+
+  auto paf = kj::newPromiseAndFulfiller<void>();
+  persistWaiters.add(kj::mv(paf.fulfiller));
+  return kj::mv(paf.promise);
+}
+
+void AlarmScheduler::persistPendingWrites() {
+  if (pendingWrites.size() == 0) return;
+
+  auto waiters = kj::mv(persistWaiters);
+
+  KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+    db->run("BEGIN TRANSACTION;");
+    KJ_ON_SCOPE_FAILURE(db->run("ROLLBACK TRANSACTION;"));
+
+    for (auto& entry: pendingWrites) {
+      KJ_IF_MAYBE(scheduledTime, entry.value.scheduledTime) {
+        stmtSetAlarm.run(entry.key.uniqueKey, entry.key.actorId, toNs(*scheduledTime));
+      } else {
+        stmtDeleteAlarm.run(entry.key.uniqueKey, entry.key.actorId);
+      }
     }
 
-    return kj::READY_NOW;
-  }).eagerlyEvaluate([actor = actorRef.clone()](kj::Exception&& e) {
-    KJ_LOG(ERROR, "Failed to run alarm and was unable to schedule a retry", e);
-  });
+    db->run("COMMIT TRANSACTION;");
+  })) {
+    // The writes stay pending, to be retried with the next batch, but the callers waiting on
+    // this one learn that it failed.
+    for (auto& waiter: waiters) waiter->reject(kj::cp(*exception));
+    kj::throwFatalException(kj::mv(*exception));
+  }
+
+  pendingWrites.clear();
+  for (auto& waiter: waiters) waiter->fulfill();
 }
 
 void AlarmScheduler::taskFailed(kj::Exception&& e) {
@@ -10,6 +10,7 @@
 #include <kj/time.h>
 #include <kj/timer.h>
 #include <kj/map.h>
+#include <kj/vector.h>
 
 #include <random>
 
@@ -58,6 +59,16 @@ public:
   // How much jitter should be applied to retry times to avoid bundled retries overloading
   // some common dependency between a set of failed alarms
 
+  static constexpr auto LOAD_WINDOW = 1 * kj::HOURS;
+  // Alarms due further in the future than this are left in the database, and loaded into memory
+  // only as their time approaches. Alarms that have been set or retried since startup may stay in
+  // memory for longer.
+
+  static constexpr auto PERSIST_DELAY = 10 * kj::MILLISECONDS;
+  // setAlarm() and deleteAlarm() take effect in memory immediately, but are buffered for up to
+  // this long before being written to the database together, in one transaction. The promises
+  // they return resolve once that transaction commits.
+
   using GetActorFn = kj::Function<kj::Own<WorkerInterface>(kj::String)>;
 
   AlarmScheduler(
@@ -65,10 +76,11 @@ public:
     kj::Timer& timer,
     const SqliteDatabase::Vfs& vfs,
     kj::PathPtr path);
+  ~AlarmScheduler() noexcept(false);
 
   kj::Maybe<kj::Date> getAlarm(ActorKey actor);
-  bool setAlarm(ActorKey actor, kj::Date scheduledTime);
-  bool deleteAlarm(ActorKey actor);
+  kj::Promise<void> setAlarm(ActorKey actor, kj::Date scheduledTime);
+  kj::Promise<void> deleteAlarm(ActorKey actor);
 
   void registerNamespace(kj::StringPtr uniqueKey, GetActorFn getActor);
 
@@ -85,10 +97,29 @@ private:
   kj::Own<SqliteDatabase> db;
   kj::TaskSet tasks;
 
+  struct Wakeup {
+    kj::Date time;
+    uint64_t seq;
+    // Distinguishes wakeups due at the same time.
+
+    bool operator==(const Wakeup& other) const {
+      return time == other.time && seq == other.seq;
+    }
+    bool operator<(const Wakeup& other) const {
+      return time < other.time || (time == other.time && seq < other.seq);
+    }
+  };
+
   struct ScheduledAlarm {
     kj::Own<ActorKey> actor;
     kj::Date scheduledTime;
-    kj::Promise<void> task;
+
+    kj::Maybe<Wakeup> wakeup;
+    // Our entry in `wakeups`, if we're waiting for our scheduled time or for a retry.
+
+    kj::Maybe<kj::Promise<void>> task;
+    // The running alarm handler, while STARTED.
+
     kj::Maybe<kj::Date> queuedAlarm = nullptr;
     // Once started, an alarm can have a single alarm queued behind it.
     AlarmStatus status = AlarmStatus::WAITING;
@@ -107,6 +138,33 @@ private:
   };
 
   kj::HashMap<ActorKey, ScheduledAlarm> alarms;
+  // Every alarm due before `loadedUntil`, plus any others set since startup.
+
+  kj::TreeMap<Wakeup, ActorKey> wakeups;
+  // The in-memory alarms that are waiting to run, ordered by when they're due. Rather than a timer
+  // per alarm, we keep a single timer armed for the earliest of these (or for `loadedUntil`).
+  // Values point into the corresponding ScheduledAlarm's `actor`.
+
+  uint64_t wakeupCounter = 0;
+
+  kj::Maybe<kj::Promise<void>> wakeTimer;
+  kj::Date wakeTimerTime = kj::UNIX_EPOCH;
+  // The timer currently armed, if any, and when it fires.
+
+  kj::Date loadedUntil = kj::UNIX_EPOCH;
+  // Alarms due before this time have been loaded from the database.
+
+  struct PendingWrite {
+    kj::Own<ActorKey> actor;
+    kj::Maybe<kj::Date> scheduledTime;
+    // Null to delete the alarm.
+  };
+  kj::HashMap<ActorKey, PendingWrite> pendingWrites;
+  bool persistScheduled = false;
+  // Changes not yet written to the database.
+
+  kj::Vector<kj::Own<kj::PromiseFulfiller<void>>> persistWaiters;
+  // Callers of setAlarm() and deleteAlarm() waiting for `pendingWrites` to be committed.
 
   struct RetryInfo {
     bool retry;
@@ -114,11 +172,22 @@ private:
   };
   kj::Promise<RetryInfo> runAlarm(const ActorKey& actor, kj::Date scheduledTime);
 
-  void setAlarmInMemory(kj::Own<ActorKey> actor, kj::Date scheduledTime);
+  void addAlarmInMemory(kj::Own<ActorKey> actor, kj::Date scheduledTime);
+  void reschedule(ScheduledAlarm& alarm, kj::Date scheduledTime);
+  // Resets `alarm` to WAITING for `scheduledTime`.
 
-  ScheduledAlarm scheduleAlarm(kj::Date now, kj::Own<ActorKey> actor, kj::Date scheduledTime);
+  void wakeAt(ScheduledAlarm& alarm, kj::Date time);
+  void cancelWakeup(ScheduledAlarm& alarm);
+  void armTimer();
+  void onWakeTimer();
 
-  kj::Promise<void> makeAlarmTask(kj::Duration delay, const ActorKey& actor, kj::Date scheduledTime);
+  void startAlarm(ScheduledAlarm& alarm);
+  void finishAlarm(const ActorKey& actor, kj::Date scheduledTime, RetryInfo retryInfo);
+
+  void deleteAlarmInMemory(const ActorKey& actor);
+
+  kj::Promise<void> persistLater(ActorKey actor, kj::Maybe<kj::Date> scheduledTime);
+  void persistPendingWrites();
 
   SqliteDatabase::Statement stmtSetAlarm = db->prepare(R"(
     INSERT INTO _cf_ALARM VALUES(?, ?, ?)
@@ -127,13 +196,24 @@ private:
   SqliteDatabase::Statement stmtDeleteAlarm = db->prepare(R"(
     DELETE FROM _cf_ALARM WHERE actor_unique_key = ? AND actor_id = ?
   )");
+  SqliteDatabase::Statement stmtGetAlarm = db->prepare(R"(
+    SELECT scheduled_time FROM _cf_ALARM WHERE actor_unique_key = ? AND actor_id = ?
+  )");
+  SqliteDatabase::Statement stmtLoadAlarms = db->prepare(R"(
+    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM
+      WHERE scheduled_time >= ? AND scheduled_time < ?
+      ORDER BY scheduled_time
+  )");
 
   void taskFailed(kj::Exception&& exception) override;
 
   int maxJitterMsForDelay(kj::Duration delay);
 
   static void ensureInitialized(SqliteDatabase& db);
-  void loadAlarmsFromDb();
+  void loadAlarmsFromDb(int64_t lowerBoundNs, kj::Date now);
+  // Loads alarms due in [lowerBoundNs, now + LOAD_WINDOW) and advances `loadedUntil`. The timer is
+  // then armed for `loadedUntil` at the latest, even if nothing was loaded, so that the window
+  // keeps advancing.
 };
 
 } // namespace workerd::server
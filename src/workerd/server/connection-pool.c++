@@ -0,0 +1,165 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "connection-pool.h"
+#include <kj/debug.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace workerd::server {
+
+namespace {
+
+constexpr size_t PUMP_BUFFER_SIZE = 16 * 1024;
+
+kj::Promise<void> pumpFromWorker(kj::AsyncIoStream& from, kj::AsyncIoStream& to) {
+  // Like `from.pumpTo(to)`, except that the Worker dropping its end of the tunnel counts as the
+  // end of its data rather than an error: that's how a Worker's `socket.close()` shows up here.
+
+  auto buffer = kj::heapArray<kj::byte>(PUMP_BUFFER_SIZE);
+  for (;;) {
+    size_t n = 0;
+    try {
+      n = co_await from.tryRead(buffer.begin(), 1, buffer.size());
+    } catch (...) {
+      auto exception = kj::getCaughtExceptionAsKj();
+      if (exception.getType() != kj::Exception::Type::DISCONNECTED) {
+        kj::throwFatalException(kj::mv(exception));
+      }
+    }
+    if (n == 0) co_return;
+    co_await to.write(buffer.begin(), n);
+  }
+}
+
+kj::Promise<void> pumpFromServer(kj::AsyncIoStream& from, kj::AsyncIoStream& to,
+                                 bool& delivering) {
+  // Like `from.pumpTo(to)`, but sets `delivering` while data read from the server hasn't been
+  // fully written to the Worker yet.
+
+  auto buffer = kj::heapArray<kj::byte>(PUMP_BUFFER_SIZE);
+  for (;;) {
+    size_t n = co_await from.tryRead(buffer.begin(), 1, buffer.size());
+    if (n == 0) co_return;
+    delivering = true;
+    co_await to.write(buffer.begin(), n);
+    delivering = false;
+  }
+}
+
+}  // namespace
+
+ConnectionPool::ConnectionPool(kj::Timer& timer, Options options)
+    : timer(timer), options(options), tasks(*this) {}
+
+ConnectionPool::~ConnectionPool() noexcept(false) {}
+
+kj::Maybe<kj::Own<kj::AsyncIoStream>> ConnectionPool::take(kj::StringPtr key) {
+  KJ_IF_MAYBE(list, idle.find(key)) {
+    auto connection = kj::mv(list->back());
+    list->removeLast();
+    if (list->empty()) {
+      idle.erase(key);
+    }
+
+    // Canceling the outstanding read doesn't consume anything from the stream.
+    connection->canceler.cancel("idle connection taken for reuse");
+    return kj::mv(connection->stream);
+  }
+  return nullptr;
+}
+
+void ConnectionPool::configure(kj::AsyncIoStream& stream) {
+  // Streams that aren't sockets (e.g. in-process pipes) throw here; there's nothing to tune.
+  int one = 1;
+  kj::runCatchingExceptions([&]() {
+    stream.setsockopt(IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (options.keepAlive) {
+      stream.setsockopt(SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    }
+  });
+}
+
+kj::Promise<void> ConnectionPool::tunnel(kj::String key, kj::Own<kj::AsyncIoStream> stream,
+                                         kj::AsyncIoStream& connection) {
+  bool serverClosed = false;
+  bool delivering = false;
+  auto fromServer = pumpFromServer(*stream, connection, delivering)
+      .then([&]() -> kj::Promise<void> {
+    // The server closed its side, so the connection can't be reused, but the Worker may not be
+    // done writing yet.
+    serverClosed = true;
+    connection.shutdownWrite();
+    return kj::NEVER_DONE;
+  });
+
+  // The Worker is done once it has both finished writing and stopped reading. Until then, the
+  // server's response keeps flowing to it. Anything the server sends after that point would
+  // belong to the Worker's session, and makes the health check drop the connection.
+  auto fromWorker = pumpFromWorker(connection, *stream).then([&]() {
+    return connection.whenWriteDisconnected();
+  });
+
+  try {
+    co_await fromWorker.exclusiveJoin(kj::mv(fromServer));
+  } catch (...) {
+    auto exception = kj::getCaughtExceptionAsKj();
+    if (exception.getType() != kj::Exception::Type::DISCONNECTED) {
+      kj::throwFatalException(kj::mv(exception));
+    }
+    // One side went away in the middle of the session, so the connection can't be reused.
+    co_return;
+  }
+
+  if (!serverClosed && !delivering) {
+    release(kj::mv(key), kj::mv(stream));
+  }
+}
+
+void ConnectionPool::release(kj::String key, kj::Own<kj::AsyncIoStream> stream) {
+  auto& list = idle.findOrCreate(key, [&]() {
+    return decltype(idle)::Entry { kj::str(key), {} };
+  });
+  if (list.size() >= options.maxIdlePerKey) {
+    // Pool is full; just close it.
+    return;
+  }
+
+  auto& connection = *list.add(kj::heap<IdleConnection>(kj::mv(key), kj::mv(stream)));
+
+  auto watch = connection.stream->tryRead(&connection.probe, 1, 1)
+      .then([](size_t) {}, [](kj::Exception&&) {})
+      .exclusiveJoin(timer.afterDelay(options.idleTimeout));
+  tasks.add(connection.canceler.wrap(kj::mv(watch)).then([this, &connection]() {
+    // The server sent something or hung up, the read failed, or the connection sat idle for
+    // too long.
+    evict(connection);
+  }, [](kj::Exception&&) {
+    // Canceled by take().
+  }));
+}
+
+void ConnectionPool::evict(IdleConnection& connection) {
+  auto key = kj::mv(connection.key);
+  auto& list = KJ_ASSERT_NONNULL(idle.find(key));
+  for (auto& entry: list) {
+    if (entry.get() == &connection) {
+      if (&entry != &list.back()) {
+        entry = kj::mv(list.back());
+      }
+      list.removeLast();
+      break;
+    }
+  }
+  if (list.empty()) {
+    idle.erase(key);
+  }
+}
+
+void ConnectionPool::taskFailed(kj::Exception&& exception) {
+  KJ_LOG(ERROR, "connection pool health check failed", exception);
+}
+
+}  // namespace workerd::server
@@ -0,0 +1,78 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/async-io.h>
+#include <kj/map.h>
+#include <kj/timer.h>
+#include <kj/vector.h>
+
+namespace workerd::server {
+
+class ConnectionPool final: private kj::TaskSet::ErrorHandler {
+  // Keeps connections opened for the sockets `connect()` API open after the Worker closes them,
+  // so that a later `connect()` to the same place can reuse them instead of paying for TCP and TLS
+  // setup again.
+  //
+  // Connections are grouped by a key, which the caller builds from everything that makes two
+  // connections interchangeable: at least the calling Worker, the address, and whether TLS is
+  // used. A connection only goes back into the pool once the Worker has cleanly finished writing
+  // and stopped reading, with nothing from the server still on its way to it, and only if the
+  // server hadn't closed its side.
+  //
+  // While idle, each connection has a one-byte read outstanding, which doubles as a health check:
+  // an idle connection must not receive anything, so if the read completes -- with data, EOF or
+  // an error -- the connection is dropped. Idle connections are also dropped after a timeout.
+
+public:
+  struct Options {
+    uint maxIdlePerKey;
+    kj::Duration idleTimeout;
+    bool keepAlive;
+  };
+
+  ConnectionPool(kj::Timer& timer, Options options);
+  ~ConnectionPool() noexcept(false);
+
+  kj::Maybe<kj::Own<kj::AsyncIoStream>> take(kj::StringPtr key);
+  // Takes an idle connection for the key out of the pool, if there is one. The most recently
+  // used connection is returned first.
+
+  void configure(kj::AsyncIoStream& stream);
+  // Applies the pool's socket options to a newly opened connection: TCP_NODELAY, and SO_KEEPALIVE
+  // if enabled. Streams that aren't sockets are left alone.
+
+  kj::Promise<void> tunnel(kj::String key, kj::Own<kj::AsyncIoStream> stream,
+                           kj::AsyncIoStream& connection);
+  // Pumps data both ways between the Worker's end of the tunnel (`connection`) and the server's
+  // (`stream`) until the Worker is done in both directions, then returns `stream` to the pool
+  // under `key` if it can be reused.
+
+private:
+  kj::Timer& timer;
+  Options options;
+
+  struct IdleConnection {
+    IdleConnection(kj::String key, kj::Own<kj::AsyncIoStream> stream)
+        : key(kj::mv(key)), stream(kj::mv(stream)) {}
+
+    kj::String key;
+    kj::Own<kj::AsyncIoStream> stream;
+    kj::Canceler canceler;
+    // Cancels the health check when the connection is taken.
+    kj::byte probe;
+  };
+
+  kj::HashMap<kj::String, kj::Vector<kj::Own<IdleConnection>>> idle;
+  kj::TaskSet tasks;
+  // Declared after `idle`, so that the health checks are canceled before the connections go away.
+
+  void release(kj::String key, kj::Own<kj::AsyncIoStream> stream);
+  void evict(IdleConnection& connection);
+
+  void taskFailed(kj::Exception&& exception) override;
+};
+
+}  // namespace workerd::server
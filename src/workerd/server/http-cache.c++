@@ -0,0 +1,445 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "http-cache.h"
+#include <kj/debug.h>
+#include <strings.h>
+
+namespace workerd::server {
+
+namespace {
+
+constexpr size_t MAX_PENDING_FILLS = 1024;
+// Misses on more distinct keys than this at once simply go to origin without collapsing, so that
+// a flood of one-off URLs can't grow `pendingFills` without bound.
+
+kj::String toLowerCase(kj::ArrayPtr<const char> text) {
+  auto result = kj::heapString(text);
+  for (char& c: result) {
+    if ('A' <= c && c <= 'Z') c += 'a' - 'A';
+  }
+  return result;
+}
+
+template <typename Func>
+void forEachListItem(kj::StringPtr list, Func&& func) {
+  // Calls `func` with each non-empty item of a comma-separated header value, with surrounding
+  // whitespace trimmed.
+
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = start;
+    while (end < list.size() && list[end] != ',') ++end;
+
+    size_t itemStart = start;
+    size_t itemEnd = end;
+    while (itemStart < itemEnd && (list[itemStart] == ' ' || list[itemStart] == '\t')) {
+      ++itemStart;
+    }
+    while (itemEnd > itemStart && (list[itemEnd - 1] == ' ' || list[itemEnd - 1] == '\t')) {
+      --itemEnd;
+    }
+    if (itemEnd > itemStart) {
+      func(list.slice(itemStart, itemEnd));
+    }
+
+    start = end + 1;
+  }
+}
+
+kj::Maybe<kj::String> getHeaderByName(const kj::HttpHeaders& headers, kj::StringPtr lowerName) {
+  // Returns the comma-concatenation of all values of the named header, or null if there are none.
+  // `Vary` can name any header, not just those registered in the header table, so we have to
+  // search by name.
+
+  kj::Vector<kj::StringPtr> values;
+  headers.forEach([&](kj::StringPtr name, kj::StringPtr value) {
+    if (name.size() == lowerName.size() &&
+        strncasecmp(name.begin(), lowerName.begin(), name.size()) == 0) {
+      values.add(value);
+    }
+  });
+  if (values.empty()) return nullptr;
+  return kj::strArray(values, ", ");
+}
+
+bool isDirective(kj::StringPtr item, kj::StringPtr name) {
+  // Matches a Cache-Control directive with or without an argument, like `private` or
+  // `private="Set-Cookie"`.
+  return item == name || (item.startsWith(name) && item[name.size()] == '=');
+}
+
+struct CacheControl {
+  bool noStore = false;
+  kj::Maybe<uint64_t> maxAge;
+  kj::Maybe<uint64_t> sMaxAge;
+};
+
+CacheControl parseCacheControl(kj::Maybe<kj::StringPtr> value) {
+  CacheControl result;
+  KJ_IF_MAYBE(v, value) {
+    forEachListItem(*v, [&](kj::ArrayPtr<const char> rawItem) {
+      auto item = toLowerCase(rawItem);
+      if (isDirective(item, "no-store") || isDirective(item, "private") ||
+          isDirective(item, "no-cache")) {
+        // We never revalidate, so a response that must be revalidated is as good as uncacheable.
+        result.noStore = true;
+      } else if (item.startsWith("s-maxage=")) {
+        result.sMaxAge = item.slice(strlen("s-maxage=")).tryParseAs<uint64_t>();
+      } else if (item.startsWith("max-age=")) {
+        result.maxAge = item.slice(strlen("max-age=")).tryParseAs<uint64_t>();
+      }
+    });
+  }
+  return result;
+}
+
+kj::Maybe<size_t> findHeaderEnd(kj::ArrayPtr<const char> payload) {
+  // Returns the offset just past the blank line ending the headers of a serialized HTTP message.
+  static constexpr char TERMINATOR[] = "\r\n\r\n";
+  constexpr size_t LENGTH = sizeof(TERMINATOR) - 1;
+  for (size_t i = 0; i + LENGTH <= payload.size(); i++) {
+    if (memcmp(payload.begin() + i, TERMINATOR, LENGTH) == 0) {
+      return i + LENGTH;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+HttpCache::HttpCache(kj::Timer& timer, kj::HttpHeaderTable::Builder& headerTableBuilder,
+                     Options options)
+    : timer(timer), headerTable(headerTableBuilder.getFutureTable()), options(options),
+      hCacheControl(headerTableBuilder.add("Cache-Control")),
+      hVary(headerTableBuilder.add("Vary")),
+      hSetCookie(headerTableBuilder.add("Set-Cookie")),
+      hCfCacheStatus(headerTableBuilder.add("CF-Cache-Status")),
+      hCfCacheNamespace(headerTableBuilder.add("CF-Cache-Namespace")) {}
+
+HttpCache::~HttpCache() noexcept(false) {
+  // Entries may outlive the cache if a response is still being written out of one, so unlink them
+  // all from the LRU list.
+  for (auto& variants: entries) {
+    for (auto& entry: variants.value->entries) {
+      lru.remove(*entry);
+      entry->owner = nullptr;
+    }
+  }
+}
+
+kj::Promise<void> HttpCache::request(
+    kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+    kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) {
+  auto key = makeKey(url, headers);
+
+  switch (method) {
+    case kj::HttpMethod::GET:
+      return get(key, headers, response);
+    case kj::HttpMethod::PUT: {
+      // Wake up any collapsed misses once the put is done, whether or not it stored anything.
+      auto release = kj::defer([this, key = kj::str(key)]() { releasePendingFill(key); });
+      return put(kj::mv(key), headers, requestBody, response).attach(kj::mv(release));
+    }
+    case kj::HttpMethod::PURGE:
+      return purge(key, response);
+    default:
+      return response.sendError(501, "Not Implemented", headerTable);
+  }
+}
+
+kj::String HttpCache::makeKey(kj::StringPtr url, const kj::HttpHeaders& headers) {
+  // Namespace names arrive URI-encoded, so they can't contain a newline.
+  return kj::str(headers.get(hCfCacheNamespace).orDefault(""), '\n', url);
+}
+
+kj::Maybe<HttpCache::Entry&> HttpCache::findEntry(
+    kj::StringPtr key, const kj::HttpHeaders& requestHeaders) {
+  auto& variants = *KJ_UNWRAP_OR(entries.find(key), { return nullptr; });
+
+  for (auto& entry: variants.entries) {
+    bool matches = true;
+    for (auto& field: entry->vary) {
+      auto requestValue = getHeaderByName(requestHeaders, field.name);
+      KJ_IF_MAYBE(expected, field.value) {
+        KJ_IF_MAYBE(actual, requestValue) {
+          matches = *actual == *expected;
+        } else {
+          matches = false;
+        }
+      } else {
+        matches = requestValue == nullptr;
+      }
+      if (!matches) break;
+    }
+    if (!matches) continue;
+
+    KJ_IF_MAYBE(expires, entry->expires) {
+      if (*expires <= timer.now()) {
+        remove(*entry);
+        return nullptr;
+      }
+    }
+    return *entry;
+  }
+
+  return nullptr;
+}
+
+kj::Promise<void> HttpCache::put(kj::String key, const kj::HttpHeaders& requestHeaders,
+    kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) {
+  KJ_IF_MAYBE(length, requestBody.tryGetLength()) {
+    if (*length > options.maxEntrySize) {
+      co_await response.sendError(413, "Payload Too Large", headerTable);
+      co_return;
+    }
+  }
+
+  // Read the whole payload. We keep this buffer as the entry's storage.
+  static constexpr size_t READ_SIZE = 16 * 1024;
+  kj::Vector<char> buffer;
+  for (;;) {
+    size_t oldSize = buffer.size();
+    buffer.resize(oldSize + READ_SIZE);
+    size_t n = co_await requestBody.tryRead(buffer.begin() + oldSize, 1, READ_SIZE);
+    buffer.resize(oldSize + n);
+    if (n == 0) break;
+
+    if (buffer.size() > options.maxEntrySize) {
+      co_await response.sendError(413, "Payload Too Large", headerTable);
+      co_return;
+    }
+  }
+
+  auto entry = kj::refcounted<Entry>(headerTable);
+  entry->payload = buffer.releaseAsArray();
+
+  size_t headerEnd;
+  KJ_IF_MAYBE(end, findHeaderEnd(entry->payload)) {
+    headerEnd = *end;
+  } else {
+    co_await response.sendError(400, "Bad Request", headerTable);
+    co_return;
+  }
+
+  KJ_SWITCH_ONEOF(entry->headers.tryParseResponse(entry->payload.slice(0, headerEnd))) {
+    KJ_CASE_ONEOF(parsed, kj::HttpHeaders::Response) {
+      entry->statusCode = parsed.statusCode;
+      entry->statusText = parsed.statusText;
+    }
+    KJ_CASE_ONEOF(error, kj::HttpHeaders::ProtocolError) {
+      co_await response.sendError(400, "Bad Request", headerTable);
+      co_return;
+    }
+  }
+  entry->body = entry->payload.slice(headerEnd, entry->payload.size()).asBytes();
+
+  // The body's framing is implied by the payload's length, whatever the serialized headers say.
+  entry->headers.unset(kj::HttpHeaderId::CONTENT_LENGTH);
+  entry->headers.unset(kj::HttpHeaderId::TRANSFER_ENCODING);
+
+  bool cacheable = entry->headers.get(hSetCookie) == nullptr;
+
+  auto cacheControl = parseCacheControl(entry->headers.get(hCacheControl));
+  if (cacheControl.noStore) cacheable = false;
+  auto ttl = cacheControl.sMaxAge;
+  if (ttl == nullptr) ttl = cacheControl.maxAge;
+  KJ_IF_MAYBE(t, ttl) {
+    if (*t == 0) {
+      cacheable = false;
+    } else {
+      entry->expires = timer.now() + *t * kj::SECONDS;
+    }
+  }
+
+  kj::Vector<Entry::VaryField> vary;
+  KJ_IF_MAYBE(v, entry->headers.get(hVary)) {
+    forEachListItem(*v, [&](kj::ArrayPtr<const char> item) {
+      if (item == "*"_kj.asArray()) {
+        cacheable = false;
+      } else {
+        auto name = toLowerCase(item);
+        auto value = getHeaderByName(requestHeaders, name);
+        vary.add(Entry::VaryField { kj::mv(name), kj::mv(value) });
+      }
+    });
+  }
+  entry->vary = vary.releaseAsArray();
+
+  if (cacheable && entry->payload.size() <= options.maxTotalSize) {
+    // Replace whatever a later match() with this same request would have found.
+    while (findEntry(key, requestHeaders) != nullptr) {
+      remove(KJ_ASSERT_NONNULL(findEntry(key, requestHeaders)));
+    }
+
+    while (totalSize + entry->payload.size() > options.maxTotalSize && !lru.empty()) {
+      remove(lru.front());
+    }
+
+    insert(kj::mv(key), kj::mv(entry));
+  }
+
+  kj::HttpHeaders responseHeaders(headerTable);
+  response.send(204, "No Content", responseHeaders);
+}
+
+kj::Promise<void> HttpCache::get(kj::StringPtr key, const kj::HttpHeaders& requestHeaders,
+                                 kj::HttpService::Response& response) {
+  KJ_IF_MAYBE(entry, findEntry(key, requestHeaders)) {
+    return sendHit(*entry, response);
+  }
+
+  KJ_IF_MAYBE(timeout, options.collapsedForwardingTimeout) {
+    auto now = timer.now();
+    KJ_IF_MAYBE(pending, pendingFills.find(key)) {
+      auto& fill = **pending;
+      if (fill.deadline > now) {
+        // Someone else missed on this key recently and is presumably fetching it. Wait for their
+        // put() instead of sending yet another request to origin.
+        auto wait = fill.promise.addBranch().exclusiveJoin(timer.atTime(fill.deadline));
+        return wait.then([this, key = kj::str(key), &requestHeaders, &response]() {
+          KJ_IF_MAYBE(entry, findEntry(key, requestHeaders)) {
+            return sendHit(*entry, response);
+          } else {
+            // The fill timed out or wasn't cacheable (or didn't match our `Vary`). Fall back to
+            // going to origin ourselves.
+            return sendMiss(response);
+          }
+        });
+      }
+
+      // The previous fill never completed. This request takes over.
+      releasePendingFill(key);
+    }
+
+    if (pendingFills.size() >= MAX_PENDING_FILLS) {
+      // Drop fills whose waiters have all given up by now.
+      kj::Vector<kj::StringPtr> expired;
+      for (auto& pending: pendingFills) {
+        if (pending.value->deadline <= now) expired.add(pending.key);
+      }
+      for (auto expiredKey: expired) {
+        releasePendingFill(expiredKey);
+      }
+      if (pendingFills.size() >= MAX_PENDING_FILLS) {
+        return sendMiss(response);
+      }
+    }
+
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    auto fill = kj::heap<PendingFill>(PendingFill {
+      .key = kj::str(key),
+      .deadline = now + *timeout,
+      .fulfiller = kj::mv(paf.fulfiller),
+      .promise = paf.promise.fork(),
+    });
+    PendingFill* fillPtr = fill.get();
+    kj::StringPtr keyPtr = fill->key;
+    pendingFills.insert(keyPtr, kj::mv(fill));
+
+    // If the miss is canceled before it reaches the client, nobody is going to put() this key, so
+    // wake the waiters now rather than leaving them to wait out the timeout.
+    auto release = kj::defer([this, key = kj::str(key), fillPtr]() {
+      KJ_IF_MAYBE(pending, pendingFills.find(key)) {
+        if (pending->get() == fillPtr) releasePendingFill(key);
+      }
+    });
+    return sendMiss(response).then([release = kj::mv(release)]() mutable {
+      release.cancel();
+    });
+  }
+
+  return sendMiss(response);
+}
+
+kj::Promise<void> HttpCache::sendHit(Entry& entry, kj::HttpService::Response& response) {
+  lru.remove(entry);
+  lru.add(entry);
+
+  auto responseHeaders = entry.headers.cloneShallow();
+  responseHeaders.set(hCfCacheStatus, "HIT");
+  auto out = response.send(entry.statusCode, entry.statusText, responseHeaders, entry.body.size());
+  if (entry.body.size() == 0) {
+    return kj::READY_NOW;
+  }
+
+  // Hold a reference so the body stays valid even if the entry is evicted in the meantime.
+  auto ref = kj::addRef(entry);
+  auto promise = out->write(ref->body.begin(), ref->body.size());
+  return promise.attach(kj::mv(out), kj::mv(ref));
+}
+
+kj::Promise<void> HttpCache::sendMiss(kj::HttpService::Response& response) {
+  kj::HttpHeaders responseHeaders(headerTable);
+  responseHeaders.set(hCfCacheStatus, "MISS");
+  return response.sendError(504, "Gateway Timeout", responseHeaders);
+}
+
+void HttpCache::releasePendingFill(kj::StringPtr key) {
+  KJ_IF_MAYBE(pending, pendingFills.find(key)) {
+    auto fill = kj::mv(*pending);
+    pendingFills.erase(fill->key);
+    fill->fulfiller->fulfill();
+  }
+}
+
+kj::Promise<void> HttpCache::purge(kj::StringPtr key, kj::HttpService::Response& response) {
+  KJ_IF_MAYBE(variants, entries.find(key)) {
+    // Removing the last entry also destroys `variants`.
+    auto& list = (*variants)->entries;
+    for (size_t n = list.size(); n > 0; n--) {
+      remove(*list.back());
+    }
+    return response.sendError(200, "OK", headerTable);
+  } else {
+    return response.sendError(404, "Not Found", headerTable);
+  }
+}
+
+void HttpCache::insert(kj::String key, kj::Own<Entry> entry) {
+  Variants* variants;
+  KJ_IF_MAYBE(existing, entries.find(key)) {
+    variants = existing->get();
+  } else {
+    auto newVariants = kj::heap<Variants>();
+    newVariants->key = kj::mv(key);
+    variants = newVariants.get();
+    kj::StringPtr keyPtr = newVariants->key;
+    entries.insert(keyPtr, kj::mv(newVariants));
+  }
+
+  entry->owner = *variants;
+  totalSize += entry->payload.size();
+  ++entryCount;
+  lru.add(*entry);
+  variants->entries.add(kj::mv(entry));
+}
+
+void HttpCache::remove(Entry& entry) {
+  auto& variants = KJ_ASSERT_NONNULL(entry.owner);
+  entry.owner = nullptr;
+  lru.remove(entry);
+  totalSize -= entry.payload.size();
+  --entryCount;
+
+  // Dropping our reference may destroy `entry`, so this must come last.
+  kj::Own<Entry> own;
+  auto& list = variants.entries;
+  for (auto i: kj::indices(list)) {
+    if (list[i].get() == &entry) {
+      own = kj::mv(list[i]);
+      if (i + 1 < list.size()) {
+        list[i] = kj::mv(list.back());
+      }
+      list.removeLast();
+      break;
+    }
+  }
+
+  if (list.empty()) {
+    KJ_ASSERT(entries.erase(variants.key));
+  }
+}
+
+}  // namespace workerd::server
@@ -0,0 +1,153 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/compat/http.h>
+#include <kj/list.h>
+#include <kj/map.h>
+#include <kj/timer.h>
+
+namespace workerd::server {
+
+class HttpCache final: public kj::HttpService {
+  // An in-memory HTTP cache speaking the protocol that the Cache API implementation (api/cache.c++)
+  // uses to talk to a Worker's `cacheApiOutbound` service:
+  //
+  // - `PUT <url>`: The request body is a complete serialized HTTP response (status line, headers
+  //   and body -- never chunk-encoded, even if it claims `Transfer-Encoding: chunked`) to store
+  //   for `<url>`. The request's headers are those of the request being cached against, used to
+  //   evaluate `Vary`. Responds 204, or 413 if the response is too large to store.
+  // - `GET <url>`: Responds with the stored response and `CF-Cache-Status: HIT`, or with a 504
+  //   and `CF-Cache-Status: MISS`.
+  // - `PURGE <url>`: Removes all stored responses for `<url>`. Responds 200 if there were any,
+  //   404 otherwise.
+  //
+  // The `CF-Cache-Namespace` request header, if present, selects a separate namespace, as used by
+  // `caches.open()`.
+  //
+  // Responses are stored unless they have `Cache-Control: no-store`, `private` or `no-cache`, a
+  // zero `max-age` or `s-maxage`, a `Set-Cookie` header or `Vary: *`. A response expires after
+  // its `s-maxage` or `max-age`, and otherwise lives until evicted. When the cache is full, the
+  // least-recently-used responses are evicted.
+  //
+  // With collapsed forwarding enabled (see `Options`), the first miss on a key is assumed to be
+  // fetching the response and will put() it; further misses on that key wait for the put()
+  // rather than all going to origin at once, e.g. right after a purge.
+  //
+  // Each stored response is kept as the single buffer it was received in. Its headers are parsed
+  // in place and its body is served straight out of that buffer, so a hit copies nothing.
+
+public:
+  struct Options {
+    size_t maxTotalSize;
+    // Upper bound on the total size of all stored responses.
+
+    size_t maxEntrySize;
+    // Responses larger than this (serialized headers included) are rejected with 413.
+
+    kj::Maybe<kj::Duration> collapsedForwardingTimeout;
+    // If set, a miss on a key that already missed within this long, with no put() since, waits for
+    // that put() (up to the remainder of the timeout) instead of missing straight away, so that
+    // only one of many concurrent requests for an uncached URL goes to origin.
+  };
+
+  HttpCache(kj::Timer& timer, kj::HttpHeaderTable::Builder& headerTableBuilder, Options options);
+  ~HttpCache() noexcept(false);
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override;
+
+  size_t getTotalSize() const { return totalSize; }
+  size_t getEntryCount() const { return entryCount; }
+
+private:
+  struct Variants;
+
+  struct Entry final: public kj::Refcounted {
+    Entry(const kj::HttpHeaderTable& headerTable): headers(headerTable) {}
+
+    kj::Array<char> payload;
+    // The serialized response as received. `statusText`, `headers` and `body` point into it.
+
+    uint statusCode = 0;
+    kj::StringPtr statusText;
+    kj::HttpHeaders headers;
+    kj::ArrayPtr<const kj::byte> body;
+
+    struct VaryField {
+      kj::String name;
+      // Lower-cased.
+
+      kj::Maybe<kj::String> value;
+      // The value the cached-against request had for this header, if any.
+    };
+    kj::Array<VaryField> vary;
+
+    kj::Maybe<kj::TimePoint> expires;
+
+    kj::Maybe<Variants&> owner;
+    // Null once the entry has been removed from the cache. A response still being written out may
+    // hold a reference past that point.
+
+    kj::ListLink<Entry> link;
+  };
+
+  struct Variants {
+    // All stored responses for one URL, which differ by their `Vary`-ed request headers.
+
+    kj::String key;
+    kj::Vector<kj::Own<Entry>> entries;
+  };
+
+  kj::Timer& timer;
+  kj::HttpHeaderTable& headerTable;
+  Options options;
+
+  kj::HttpHeaderId hCacheControl;
+  kj::HttpHeaderId hVary;
+  kj::HttpHeaderId hSetCookie;
+  kj::HttpHeaderId hCfCacheStatus;
+  kj::HttpHeaderId hCfCacheNamespace;
+
+  kj::HashMap<kj::StringPtr, kj::Own<Variants>> entries;
+  // Keyed by `Variants::key`, which combines the namespace and URL.
+
+  struct PendingFill {
+    // Records a miss whose put() other misses on the same key are waiting for.
+
+    kj::String key;
+    kj::TimePoint deadline;
+    kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+    kj::ForkedPromise<void> promise;
+  };
+
+  kj::HashMap<kj::StringPtr, kj::Own<PendingFill>> pendingFills;
+  // Keyed by `PendingFill::key`. Only used with collapsed forwarding. Bounded by
+  // MAX_PENDING_FILLS in http-cache.c++.
+
+  kj::List<Entry, &Entry::link> lru;
+  // Least-recently-used first.
+
+  size_t totalSize = 0;
+  size_t entryCount = 0;
+
+  kj::String makeKey(kj::StringPtr url, const kj::HttpHeaders& headers);
+  kj::Maybe<Entry&> findEntry(kj::StringPtr key, const kj::HttpHeaders& requestHeaders);
+
+  kj::Promise<void> put(kj::String key, const kj::HttpHeaders& requestHeaders,
+                        kj::AsyncInputStream& requestBody, kj::HttpService::Response& response);
+  kj::Promise<void> get(kj::StringPtr key, const kj::HttpHeaders& requestHeaders,
+                        kj::HttpService::Response& response);
+  kj::Promise<void> purge(kj::StringPtr key, kj::HttpService::Response& response);
+  kj::Promise<void> sendHit(Entry& entry, kj::HttpService::Response& response);
+  kj::Promise<void> sendMiss(kj::HttpService::Response& response);
+  void releasePendingFill(kj::StringPtr key);
+
+  void insert(kj::String key, kj::Own<Entry> entry);
+  void remove(Entry& entry);
+};
+
+}  // namespace workerd::server
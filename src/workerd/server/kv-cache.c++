@@ -0,0 +1,174 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "kv-cache.h"
+#include <kj/debug.h>
+
+namespace workerd::server {
+
+class KvReadCache::Namespace final: public api::KvCache {
+public:
+  Namespace(KvReadCache& cache, kj::StringPtr name, kj::Duration defaultTtl)
+      : cache(cache), prefix(kj::str(name.size(), ':', name)), defaultTtl(defaultTtl) {}
+
+  kj::Promise<Lookup> lookup(kj::StringPtr key) override {
+    return cache.lookup(kj::str(prefix, key), defaultTtl);
+  }
+
+  void invalidate(kj::StringPtr key) override {
+    cache.invalidate(kj::str(prefix, key));
+  }
+
+private:
+  KvReadCache& cache;
+  kj::String prefix;
+  // Length-prefixed namespace name, so that no namespace/key pair collides with another.
+  kj::Duration defaultTtl;
+};
+
+class KvReadCache::FillImpl final: public api::KvCache::Fill {
+public:
+  FillImpl(KvReadCache& cache, kj::String key, kj::Duration defaultTtl)
+      : cache(cache), key(kj::mv(key)), defaultTtl(defaultTtl) {}
+
+  ~FillImpl() noexcept(false) {
+    cache.releasePendingFill(key, *this);
+  }
+
+  void fulfill(kj::Own<api::KvCache::Value> value, kj::Maybe<kj::Duration> ttl) override {
+    if (!cache.isPendingFill(key, *this)) {
+      // The key was written since this fill started (or another lookup took over after it timed
+      // out), so the value may be stale.
+      return;
+    }
+    cache.store(key, kj::mv(value), ttl.orDefault(defaultTtl));
+    cache.releasePendingFill(key, *this);
+  }
+
+private:
+  KvReadCache& cache;
+  kj::String key;
+  kj::Duration defaultTtl;
+};
+
+KvReadCache::KvReadCache(kj::Timer& timer, Options options)
+    : timer(timer), options(options) {}
+
+KvReadCache::~KvReadCache() noexcept(false) {
+  for (auto& entry: entries) {
+    lru.remove(*entry.value);
+  }
+}
+
+api::KvCache& KvReadCache::getNamespace(kj::StringPtr name, kj::Duration defaultTtl) {
+  return *namespaces.add(kj::heap<Namespace>(*this, name, defaultTtl));
+}
+
+kj::Promise<api::KvCache::Lookup> KvReadCache::lookup(kj::String key, kj::Duration defaultTtl) {
+  auto now = timer.now();
+  KJ_IF_MAYBE(found, entries.find(key)) {
+    auto& entry = **found;
+    if (entry.expires > now) {
+      lru.remove(entry);
+      lru.add(entry);
+      return api::KvCache::Lookup(kj::addRef(*entry.value));
+    }
+    remove(entry);
+  }
+
+  KJ_IF_MAYBE(pending, pendingFills.find(key)) {
+    auto& fill = **pending;
+    if (fill.deadline > now) {
+      // Someone else missed on this key recently and is fetching it. Wait for them instead of
+      // making another subrequest, then look again: by then the value is either cached, or the
+      // fill failed or timed out and this lookup becomes the fill.
+      auto wait = fill.promise.addBranch().exclusiveJoin(timer.atTime(fill.deadline));
+      return wait.then([this, key = kj::mv(key), defaultTtl]() mutable {
+        return lookup(kj::mv(key), defaultTtl);
+      });
+    }
+
+    // The previous fill never completed. This lookup takes over.
+    releasePendingFill(key);
+  }
+
+  auto fillImpl = kj::heap<FillImpl>(*this, kj::str(key), defaultTtl);
+  auto paf = kj::newPromiseAndFulfiller<void>();
+  auto pendingFill = kj::heap<PendingFill>(PendingFill {
+    .key = kj::mv(key),
+    .owner = fillImpl.get(),
+    .deadline = now + options.fillTimeout,
+    .fulfiller = kj::mv(paf.fulfiller),
+    .promise = paf.promise.fork(),
+  });
+  kj::StringPtr keyPtr = pendingFill->key;
+  pendingFills.insert(keyPtr, kj::mv(pendingFill));
+
+  return api::KvCache::Lookup(kj::Own<api::KvCache::Fill>(kj::mv(fillImpl)));
+}
+
+void KvReadCache::store(
+    kj::StringPtr key, kj::Own<api::KvCache::Value> value, kj::Duration ttl) {
+  if (ttl <= 0 * kj::SECONDS) return;
+
+  size_t size = key.size();
+  KJ_IF_MAYBE(body, value->body) {
+    size += body->size();
+  }
+  KJ_IF_MAYBE(metadata, value->metadata) {
+    size += metadata->size();
+  }
+  if (size > options.maxEntrySize) return;
+
+  KJ_IF_MAYBE(existing, entries.find(key)) {
+    remove(**existing);
+  }
+  while (totalSize + size > options.maxTotalSize && !lru.empty()) {
+    remove(lru.front());
+  }
+
+  auto entry = kj::heap<Entry>(kj::str(key), kj::mv(value), size, timer.now() + ttl);
+  totalSize += size;
+  lru.add(*entry);
+  kj::StringPtr keyPtr = entry->key;
+  entries.insert(keyPtr, kj::mv(entry));
+}
+
+void KvReadCache::releasePendingFill(kj::StringPtr key, kj::Maybe<FillImpl&> owner) {
+  KJ_IF_MAYBE(pending, pendingFills.find(key)) {
+    KJ_IF_MAYBE(o, owner) {
+      // A later lookup may have taken over after this fill timed out.
+      if ((*pending)->owner != o) return;
+    }
+    auto fill = kj::mv(*pending);
+    pendingFills.erase(fill->key);
+    fill->fulfiller->fulfill();
+  }
+}
+
+bool KvReadCache::isPendingFill(kj::StringPtr key, FillImpl& owner) {
+  KJ_IF_MAYBE(pending, pendingFills.find(key)) {
+    return (*pending)->owner == &owner;
+  }
+  return false;
+}
+
+void KvReadCache::invalidate(kj::StringPtr key) {
+  KJ_IF_MAYBE(entry, entries.find(key)) {
+    remove(**entry);
+  }
+
+  // A fetch that started before the write may return the old value, so it mustn't be cached, and
+  // lookups waiting for it should fetch again instead.
+  releasePendingFill(key);
+}
+
+void KvReadCache::remove(Entry& entry) {
+  lru.remove(entry);
+  totalSize -= entry.size;
+  // Erasing destroys `entry`, including the key the map is indexed by, so do it last.
+  KJ_ASSERT(entries.erase(entry.key));
+}
+
+}  // namespace workerd::server
@@ -0,0 +1,94 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <workerd/api/kv.h>
+#include <kj/list.h>
+#include <kj/map.h>
+#include <kj/timer.h>
+
+namespace workerd::server {
+
+class KvReadCache {
+  // The storage behind every `kvNamespace` binding that sets `kvCacheTtlSeconds`, shared by all
+  // the Server's workers. Values are keyed by namespace (the binding's service designator) and
+  // key, so two bindings to the same namespace share entries.
+  //
+  // A value expires after its TTL. When the cache is full, the least-recently-used values are
+  // evicted. Like everything else in a Server, it's only used from the Server's thread.
+
+public:
+  struct Options {
+    size_t maxTotalSize;
+    // Upper bound on the total size of all cached values, keys included.
+
+    size_t maxEntrySize;
+    // Values larger than this aren't cached.
+
+    kj::Duration fillTimeout;
+    // How long a lookup waits for another reader's fetch of the same key before fetching it
+    // itself.
+  };
+
+  KvReadCache(kj::Timer& timer, Options options);
+  ~KvReadCache() noexcept(false);
+
+  api::KvCache& getNamespace(kj::StringPtr name, kj::Duration defaultTtl);
+  // Returns a cache for one binding. It lives as long as the KvReadCache.
+
+  size_t getTotalSize() const { return totalSize; }
+  size_t getEntryCount() const { return entries.size(); }
+
+private:
+  class Namespace;
+  class FillImpl;
+
+  struct Entry {
+    Entry(kj::String key, kj::Own<api::KvCache::Value> value, size_t size, kj::TimePoint expires)
+        : key(kj::mv(key)), value(kj::mv(value)), size(size), expires(expires) {}
+
+    kj::String key;
+    kj::Own<api::KvCache::Value> value;
+    size_t size;
+    kj::TimePoint expires;
+    kj::ListLink<Entry> link;
+  };
+
+  struct PendingFill {
+    kj::String key;
+    FillImpl* owner;
+    kj::TimePoint deadline;
+    kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+    kj::ForkedPromise<void> promise;
+  };
+
+  kj::Timer& timer;
+  Options options;
+
+  kj::Vector<kj::Own<Namespace>> namespaces;
+
+  kj::HashMap<kj::StringPtr, kj::Own<Entry>> entries;
+  // Keyed by `Entry::key`, which combines the namespace and the KV key.
+
+  kj::HashMap<kj::StringPtr, kj::Own<PendingFill>> pendingFills;
+  // Keyed by `PendingFill::key`.
+
+  kj::List<Entry, &Entry::link> lru;
+  // Least-recently-used first.
+
+  size_t totalSize = 0;
+
+  kj::Promise<api::KvCache::Lookup> lookup(kj::String key, kj::Duration defaultTtl);
+  void store(kj::StringPtr key, kj::Own<api::KvCache::Value> value, kj::Duration ttl);
+  void releasePendingFill(kj::StringPtr key, kj::Maybe<FillImpl&> owner = nullptr);
+  // Wakes the lookups waiting on `key`'s fill, if it's `owner`'s (or anyone's, if null).
+  bool isPendingFill(kj::StringPtr key, FillImpl& owner);
+  // True if `owner` is still the fill that lookups on `key` are waiting for.
+  void invalidate(kj::StringPtr key);
+  // Drops the cached value for `key`, and disowns any fill in progress for it.
+  void remove(Entry& entry);
+};
+
+}  // namespace workerd::server
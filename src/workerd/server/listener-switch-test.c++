@@ -0,0 +1,143 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "listener-switch.h"
+#include <kj/test.h>
+#include <deque>
+
+namespace workerd::server {
+namespace {
+
+class FakeListener final: public kj::ConnectionReceiver {
+  // A listener whose connections are in-memory pipes opened by the test.
+
+public:
+  FakeListener(bool& destroyed): destroyed(destroyed) {}
+  ~FakeListener() noexcept(false) { destroyed = true; }
+
+  kj::Own<kj::AsyncIoStream> connect() {
+    // Returns the client end of a new connection.
+    auto pipe = kj::newTwoWayPipe();
+    KJ_IF_MAYBE(w, waiter) {
+      (*w)->fulfill(kj::mv(pipe.ends[0]));
+      waiter = nullptr;
+    } else {
+      queue.push_back(kj::mv(pipe.ends[0]));
+    }
+    return kj::mv(pipe.ends[1]);
+  }
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> accept() override {
+    if (!queue.empty()) {
+      auto stream = kj::mv(queue.front());
+      queue.pop_front();
+      return kj::mv(stream);
+    }
+    auto paf = kj::newPromiseAndFulfiller<kj::Own<kj::AsyncIoStream>>();
+    waiter = kj::mv(paf.fulfiller);
+    return kj::mv(paf.promise);
+  }
+
+  uint getPort() override { return 1234; }
+
+private:
+  bool& destroyed;
+  std::deque<kj::Own<kj::AsyncIoStream>> queue;
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<kj::Own<kj::AsyncIoStream>>>> waiter;
+};
+
+void expectSameConnection(kj::WaitScope& ws, kj::AsyncIoStream& client,
+                          kj::AsyncIoStream& server, char tag) {
+  client.write(&tag, 1).wait(ws);
+  char c = 0;
+  KJ_EXPECT(server.tryRead(&c, 1, 1).wait(ws) == 1);
+  KJ_EXPECT(c == tag);
+}
+
+KJ_TEST("ListenerSwitch moves connections to the newly activated receiver") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  bool destroyed = false;
+  auto ownListener = kj::heap<FakeListener>(destroyed);
+  auto& listener = *ownListener;
+  auto listenerSwitch = kj::refcounted<ListenerSwitch>(kj::mv(ownListener));
+
+  // The first Server starts and goes live.
+  auto first = listenerSwitch->newReceiver();
+  KJ_EXPECT(first->getPort() == 1234);
+  KJ_EXPECT(listenerSwitch->hasNext());
+  listenerSwitch->activate();
+  KJ_EXPECT(!listenerSwitch->hasNext());
+
+  auto client1 = listener.connect();
+  auto client2 = listener.connect();
+  auto client3 = listener.connect();
+  auto server1 = first->accept().wait(ws);
+  expectSameConnection(ws, *client1, *server1, '1');
+
+  // A new Server starts up. Until it's activated, it gets nothing, and connections keep going to
+  // the first one.
+  auto second = listenerSwitch->newReceiver();
+  auto secondAccept = second->accept();
+  auto client4 = listener.connect();
+  KJ_EXPECT(!secondAccept.poll(ws));
+
+  // Going live hands over the connections the first Server hadn't accepted yet, in order.
+  listenerSwitch->activate();
+  auto server2 = secondAccept.wait(ws);
+  expectSameConnection(ws, *client2, *server2, '2');
+  auto server3 = second->accept().wait(ws);
+  expectSameConnection(ws, *client3, *server3, '3');
+  auto server4 = second->accept().wait(ws);
+  expectSameConnection(ws, *client4, *server4, '4');
+
+  // New connections go to the second Server, and the draining first one gets no more.
+  auto firstAccept = first->accept();
+  auto client5 = listener.connect();
+  auto server5 = second->accept().wait(ws);
+  expectSameConnection(ws, *client5, *server5, '5');
+  KJ_EXPECT(!firstAccept.poll(ws));
+
+  // The connection the first Server accepted before the switch still works while it drains.
+  expectSameConnection(ws, *client1, *server1, 'a');
+
+  // Once the first Server is gone, the listener is still open.
+  firstAccept = nullptr;
+  first = nullptr;
+  KJ_EXPECT(!destroyed);
+  auto client6 = listener.connect();
+  auto server6 = second->accept().wait(ws);
+  expectSameConnection(ws, *client6, *server6, '6');
+}
+
+KJ_TEST("ListenerSwitch keeps serving the current receiver when a reload fails") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  bool destroyed = false;
+  auto ownListener = kj::heap<FakeListener>(destroyed);
+  auto& listener = *ownListener;
+  auto listenerSwitch = kj::refcounted<ListenerSwitch>(kj::mv(ownListener));
+
+  auto first = listenerSwitch->newReceiver();
+  listenerSwitch->activate();
+
+  // The new Server fails to start and is thrown away.
+  auto second = listenerSwitch->newReceiver();
+  listenerSwitch->abandonNext();
+  KJ_EXPECT(!listenerSwitch->hasNext());
+  second = nullptr;
+
+  auto client = listener.connect();
+  auto server = first->accept().wait(ws);
+  expectSameConnection(ws, *client, *server, 'x');
+
+  // The socket is removed from the config.
+  listenerSwitch->retire();
+  KJ_EXPECT(destroyed);
+}
+
+}  // namespace
+}  // namespace workerd::server
@@ -0,0 +1,95 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "listener-switch.h"
+#include <kj/debug.h>
+#include <deque>
+
+namespace workerd::server {
+
+class ListenerSwitch::Receiver final: public kj::ConnectionReceiver {
+public:
+  Receiver(ListenerSwitch& owner): owner(kj::addRef(owner)) {}
+
+  ~Receiver() noexcept(false) {
+    KJ_IF_MAYBE(c, owner->current) {
+      if (c == this) owner->current = nullptr;
+    }
+    KJ_IF_MAYBE(n, owner->next) {
+      if (n == this) owner->next = nullptr;
+    }
+  }
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> accept() override {
+    return acceptAuthenticated().then([](kj::AuthenticatedStream stream) {
+      return kj::mv(stream.stream);
+    });
+  }
+
+  kj::Promise<kj::AuthenticatedStream> acceptAuthenticated() override {
+    if (!queue.empty()) {
+      auto stream = kj::mv(queue.front());
+      queue.pop_front();
+      return kj::mv(stream);
+    }
+
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    waiter = kj::mv(paf.fulfiller);
+    return paf.promise.then([this]() { return acceptAuthenticated(); });
+  }
+
+  uint getPort() override { return owner->port; }
+
+  void push(kj::AuthenticatedStream stream) {
+    queue.push_back(kj::mv(stream));
+    KJ_IF_MAYBE(w, waiter) {
+      (*w)->fulfill();
+      waiter = nullptr;
+    }
+  }
+
+private:
+  kj::Own<ListenerSwitch> owner;
+  std::deque<kj::AuthenticatedStream> queue;
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> waiter;
+
+  friend class ListenerSwitch;
+};
+
+kj::Own<kj::ConnectionReceiver> ListenerSwitch::newReceiver() {
+  auto receiver = kj::heap<Receiver>(*this);
+  next = *receiver;
+  return receiver;
+}
+
+void ListenerSwitch::activate() {
+  auto& receiver = KJ_ASSERT_NONNULL(next);
+  KJ_IF_MAYBE(previous, current) {
+    // The previous Server is about to drain, so it won't accept these.
+    for (auto& stream: previous->queue) {
+      receiver.push(kj::mv(stream));
+    }
+    previous->queue.clear();
+  }
+  current = receiver;
+  next = nullptr;
+
+  if (acceptLoop == nullptr && listener.get() != nullptr) {
+    acceptLoop = run().eagerlyEvaluate([](kj::Exception&& e) {
+      KJ_LOG(ERROR, "accept loop failed", e);
+    });
+  }
+}
+
+kj::Promise<void> ListenerSwitch::run() {
+  return listener->acceptAuthenticated().then([this](kj::AuthenticatedStream stream) {
+    KJ_IF_MAYBE(receiver, current) {
+      receiver->push(kj::mv(stream));
+    }
+    // Otherwise, no Server is serving this socket anymore; drop the connection.
+    return run();
+  });
+}
+
+}  // namespace workerd::server
@@ -0,0 +1,55 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/async-io.h>
+#include <kj/refcount.h>
+
+namespace workerd::server {
+
+class ListenerSwitch final: public kj::Refcounted {
+  // Owns one socket's listener for as long as the socket is in the config, across config reloads
+  // (see `--reload-on-sighup`). Each Server accepts from its own Receiver, and the switch hands
+  // every connection it accepts to the receiver of the Server that currently serves the socket,
+  // so switching to a newly loaded Server is just a matter of pointing at its receiver: the socket
+  // is never closed, and no connection is refused in between.
+
+public:
+  ListenerSwitch(kj::Own<kj::ConnectionReceiver> listener)
+      : listener(kj::mv(listener)), port(this->listener->getPort()) {}
+
+  kj::Own<kj::ConnectionReceiver> newReceiver();
+  // Returns a receiver for a Server that is starting up. It gets no connections until
+  // `activate()` is called.
+
+  bool hasNext() { return next != nullptr; }
+
+  void activate();
+  // Sends all further connections to the receiver most recently returned by `newReceiver()`,
+  // along with any connections the previous receiver had not yet accepted.
+
+  void abandonNext() { next = nullptr; }
+  // Forgets the receiver most recently returned by `newReceiver()`, because its Server failed to
+  // start.
+
+  void retire() {
+    // Stops accepting connections and closes the socket, because it was removed from the config.
+    acceptLoop = nullptr;
+    listener = nullptr;
+  }
+
+private:
+  class Receiver;
+
+  kj::Own<kj::ConnectionReceiver> listener;
+  uint port;
+  kj::Maybe<Receiver&> current;
+  kj::Maybe<Receiver&> next;
+  kj::Maybe<kj::Promise<void>> acceptLoop;
+
+  kj::Promise<void> run();
+};
+
+}  // namespace workerd::server
@@ -0,0 +1,206 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "lock-metrics.h"
+#include <kj/time.h>
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace workerd::server {
+
+namespace {
+
+kj::Duration threadCpuTime() {
+#if _WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return 0 * kj::NANOSECONDS;
+  }
+  auto to100ns = [](const FILETIME& t) {
+    return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+  };
+  return (to100ns(kernel) + to100ns(user)) * 100 * kj::NANOSECONDS;
+#else
+  struct timespec ts;
+  KJ_SYSCALL(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts));
+  return ts.tv_sec * kj::SECONDS + ts.tv_nsec * kj::NANOSECONDS;
+#endif
+}
+
+}  // namespace
+
+void LockHistogram::record(uint64_t value) const {
+  uint i = 0;
+  if (value > 1) {
+    // Index of the smallest power of two >= value.
+    i = 64 - __builtin_clzll(value - 1);
+    if (i >= BUCKET_COUNT) i = BUCKET_COUNT - 1;
+  }
+  __atomic_add_fetch(&buckets[i], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&sum, value, __ATOMIC_RELAXED);
+}
+
+LockHistogram::Snapshot LockHistogram::snapshot() const {
+  Snapshot result;
+  result.count = 0;
+  for (uint i = 0; i < BUCKET_COUNT; i++) {
+    result.buckets[i] = __atomic_load_n(&buckets[i], __ATOMIC_RELAXED);
+    result.count += result.buckets[i];
+  }
+  result.sum = __atomic_load_n(&sum, __ATOMIC_RELAXED);
+  return result;
+}
+
+void LockHistogram::render(
+    kj::Vector<kj::String>& out, kj::StringPtr metric, kj::StringPtr labels) const {
+  auto snap = snapshot();
+
+  uint64_t cumulative = 0;
+  for (uint i = 0; i < BUCKET_COUNT - 1; i++) {
+    cumulative += snap.buckets[i];
+    out.add(kj::str(metric, "_bucket{", labels, ",le=\"", bucketBound(i), "\"} ",
+        cumulative, '\n'));
+  }
+  out.add(kj::str(metric, "_bucket{", labels, ",le=\"+Inf\"} ", snap.count, '\n'));
+  out.add(kj::str(metric, "_sum{", labels, "} ", snap.sum, '\n'));
+  out.add(kj::str(metric, "_count{", labels, "} ", snap.count, '\n'));
+}
+
+kj::String escapePrometheusLabel(kj::StringPtr value) {
+  kj::Vector<char> result(value.size() + 1);
+  for (char c: value) {
+    switch (c) {
+      case '\\': result.addAll("\\\\"_kj); break;
+      case '"':  result.addAll("\\\""_kj); break;
+      case '\n': result.addAll("\\n"_kj); break;
+      default:   result.add(c); break;
+    }
+  }
+  result.add('\0');
+  return kj::String(result.releaseAsArray());
+}
+
+// =======================================================================================
+
+class LockMetrics::Timing final: public IsolateObserver::LockTiming {
+  // Created for every lock attempt. The wait is measured from construction rather than from
+  // start(), since for async locks the LockRecord (and thus start()) is only created once the
+  // waiter reaches the front of the queue.
+
+public:
+  explicit Timing(const IsolateStats& stats)
+      : stats(stats), requestedAt(kj::systemPreciseMonotonicClock().now()) {}
+
+  void reportAsyncInfo(uint currentLoad, bool threadWaitingSameLock,
+      uint threadWaitingDifferentLockCount) override {
+    stats.queueDepth.record(currentLoad);
+  }
+
+  void locked() override {
+    auto now = kj::systemPreciseMonotonicClock().now();
+    stats.waitMicros.record((now - requestedAt) / kj::MICROSECONDS);
+    lockedAt = now;
+    cpuAtLock = threadCpuTime();
+  }
+
+  void stop() override {
+    KJ_IF_MAYBE(l, lockedAt) {
+      auto now = kj::systemPreciseMonotonicClock().now();
+      stats.holdMicros.record((now - *l) / kj::MICROSECONDS);
+      stats.cpuMicros.fetch_add((threadCpuTime() - cpuAtLock) / kj::MICROSECONDS,
+          std::memory_order_relaxed);
+    }
+  }
+
+private:
+  const IsolateStats& stats;
+  // Owned by the Observer, which the isolate keeps alive for longer than any of its locks.
+
+  kj::TimePoint requestedAt;
+  kj::Maybe<kj::TimePoint> lockedAt;
+  kj::Duration cpuAtLock = 0 * kj::NANOSECONDS;
+};
+
+class LockMetrics::Observer final: public IsolateObserver {
+public:
+  explicit Observer(kj::Own<const IsolateStats> stats): stats(kj::mv(stats)) {}
+
+  kj::Maybe<kj::Own<LockTiming>> tryCreateLockTiming(
+      kj::OneOf<SpanParent, kj::Maybe<RequestObserver&>> parentOrRequest) const override {
+    return kj::Own<LockTiming>(kj::heap<Timing>(*stats));
+  }
+
+  bool wantsHeapUsage() const override { return true; }
+
+  void reportHeapUsage(size_t usedBytes, size_t totalBytes) override {
+    stats->heapUsedBytes.store(usedBytes, std::memory_order_relaxed);
+    stats->heapTotalBytes.store(totalBytes, std::memory_order_relaxed);
+  }
+
+private:
+  kj::Own<const IsolateStats> stats;
+};
+
+kj::Own<IsolateObserver> LockMetrics::makeIsolateObserver(kj::StringPtr isolateName) {
+  auto stats = kj::atomicRefcounted<IsolateStats>(kj::str(isolateName));
+  auto observer = kj::atomicRefcounted<Observer>(kj::atomicAddRef(*stats));
+  isolates.lockExclusive()->add(kj::mv(stats));
+  return kj::mv(observer);
+}
+
+namespace {
+
+void renderValues(kj::Vector<kj::String>& out, kj::StringPtr metric, kj::StringPtr type,
+    kj::StringPtr help, kj::ArrayPtr<const kj::Own<const LockMetrics::IsolateStats>> isolates,
+    std::atomic<uint64_t> LockMetrics::IsolateStats::* field) {
+  out.add(kj::str("# HELP ", metric, ' ', help, '\n'));
+  out.add(kj::str("# TYPE ", metric, ' ', type, '\n'));
+
+  for (auto& isolate: isolates) {
+    out.add(kj::str(metric, "{isolate=\"", escapePrometheusLabel(isolate->name), "\"} ",
+        (isolate.get()->*field).load(std::memory_order_relaxed), '\n'));
+  }
+}
+
+void renderHistogram(kj::Vector<kj::String>& out, kj::StringPtr metric, kj::StringPtr help,
+    kj::ArrayPtr<const kj::Own<const LockMetrics::IsolateStats>> isolates,
+    const LockHistogram LockMetrics::IsolateStats::* field) {
+  out.add(kj::str("# HELP ", metric, ' ', help, '\n'));
+  out.add(kj::str("# TYPE ", metric, " histogram\n"));
+
+  for (auto& isolate: isolates) {
+    auto labels = kj::str("isolate=\"", escapePrometheusLabel(isolate->name), '"');
+    (isolate.get()->*field).render(out, metric, labels);
+  }
+}
+
+}  // namespace
+
+kj::String LockMetrics::render() const {
+  auto lock = isolates.lockShared();
+
+  kj::Vector<kj::String> out;
+  renderHistogram(out, "workerd_isolate_lock_wait_microseconds",
+      "Time spent waiting to acquire the isolate lock.", *lock, &IsolateStats::waitMicros);
+  renderHistogram(out, "workerd_isolate_lock_hold_microseconds",
+      "Time the isolate lock was held.", *lock, &IsolateStats::holdMicros);
+  renderHistogram(out, "workerd_isolate_lock_queue_depth",
+      "Number of async lock waiters ahead of a new async lock request.", *lock,
+      &IsolateStats::queueDepth);
+  renderValues(out, "workerd_isolate_cpu_microseconds_total", "counter",
+      "Thread CPU time spent holding the isolate lock.", *lock, &IsolateStats::cpuMicros);
+  renderValues(out, "workerd_isolate_heap_used_bytes", "gauge",
+      "V8 heap in use, as of the last time JavaScript ran.", *lock,
+      &IsolateStats::heapUsedBytes);
+  renderValues(out, "workerd_isolate_heap_total_bytes", "gauge",
+      "V8 heap reserved, as of the last time JavaScript ran.", *lock,
+      &IsolateStats::heapTotalBytes);
+  return kj::strArray(out, "");
+}
+
+}  // namespace workerd::server
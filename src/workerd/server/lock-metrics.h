@@ -0,0 +1,100 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <workerd/io/observer.h>
+#include <kj/mutex.h>
+#include <kj/vector.h>
+#include <atomic>
+
+namespace workerd::server {
+
+class LockHistogram {
+  // A fixed-size histogram with power-of-two bucket bounds. Bucket `i` counts samples in
+  // (2^(i-1), 2^i]; bucket 0 counts samples <= 1, and the last bucket also absorbs everything
+  // larger than its bound. Recording is a handful of relaxed atomic increments, so it's safe to
+  // call from whichever thread holds (or waits for) the isolate lock while another thread renders.
+
+public:
+  static constexpr uint BUCKET_COUNT = 24;
+
+  static constexpr uint64_t bucketBound(uint i) { return uint64_t(1) << i; }
+
+  void record(uint64_t value) const;
+
+  struct Snapshot {
+    uint64_t buckets[BUCKET_COUNT];
+    // Per-bucket (not cumulative) counts.
+
+    uint64_t count;
+    uint64_t sum;
+  };
+
+  Snapshot snapshot() const;
+  // Reads all counters. Concurrent record() calls may be partially reflected, which is fine for
+  // monitoring purposes.
+
+  void render(kj::Vector<kj::String>& out, kj::StringPtr metric, kj::StringPtr labels) const;
+  // Appends the histogram's sample lines in the Prometheus text format. `labels` is the
+  // already-escaped label list without braces, e.g. `isolate="foo"`.
+
+private:
+  mutable uint64_t buckets[BUCKET_COUNT] = {};
+  mutable uint64_t sum = 0;
+};
+
+kj::String escapePrometheusLabel(kj::StringPtr value);
+// Escapes a label value for the Prometheus text format.
+
+class LockMetrics {
+  // Collects isolate lock timing for every Worker in the server, and renders it in the Prometheus
+  // text exposition format. One of these is created per Server when the config defines a
+  // `metrics` service; each Worker's isolate then gets an observer from
+  // `makeIsolateObserver()` in place of the default no-op IsolateObserver.
+  //
+  // For each isolate we keep three histograms:
+  // - Lock wait time (microseconds), from the moment a lock was requested -- including time spent
+  //   queued behind other async lock waiters -- to the moment it was acquired.
+  // - Lock hold time (microseconds), from acquisition to release.
+  // - Async lock queue depth, i.e. the isolate's current load when an async lock was requested.
+  //
+  // Alongside these, a counter of thread CPU time spent holding the lock (microseconds), which is
+  // where all of the isolate's JavaScript runs, and gauges of the isolate's V8 heap as of the last
+  // time JavaScript ran.
+  //
+  // TODO(someday): GC time under the lock (LockTiming::gcPrologue/gcEpilogue) would be useful too.
+
+public:
+  kj::Own<IsolateObserver> makeIsolateObserver(kj::StringPtr isolateName);
+  // Construct an observer that reports into this LockMetrics. The observer (and the timing
+  // objects it creates) may outlive the LockMetrics.
+
+  kj::String render() const;
+  // Render all histograms in the Prometheus text exposition format.
+
+  class IsolateStats;
+
+private:
+  class Observer;
+  class Timing;
+
+  kj::MutexGuarded<kj::Vector<kj::Own<const IsolateStats>>> isolates;
+};
+
+class LockMetrics::IsolateStats final: public kj::AtomicRefcounted {
+public:
+  explicit IsolateStats(kj::String name): name(kj::mv(name)) {}
+
+  kj::String name;
+  LockHistogram waitMicros;
+  LockHistogram holdMicros;
+  LockHistogram queueDepth;
+
+  mutable std::atomic<uint64_t> cpuMicros = 0;
+  mutable std::atomic<uint64_t> heapUsedBytes = 0;
+  mutable std::atomic<uint64_t> heapTotalBytes = 0;
+};
+
+}  // namespace workerd::server
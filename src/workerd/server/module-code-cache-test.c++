@@ -0,0 +1,61 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "module-code-cache.h"
+#include <kj/test.h>
+
+namespace workerd::server {
+namespace {
+
+kj::Array<const kj::byte> bytes(kj::StringPtr text) {
+  return kj::heapArray<const kj::byte>(text.asBytes());
+}
+
+bool hasEntry(const ModuleCodeCacheImpl& cache, kj::StringPtr content, kj::StringPtr data) {
+  KJ_IF_MAYBE(entry, cache.find(content)) {
+    return entry->asPtr() == data.asBytes();
+  }
+  return false;
+}
+
+KJ_TEST("ModuleCodeCacheImpl keys entries by module source") {
+  ModuleCodeCacheImpl cache;
+
+  KJ_EXPECT(cache.find("export default 1;"_kj) == nullptr);
+
+  cache.add("export default 1;"_kj, bytes("one"));
+  cache.add("export default 2;"_kj, bytes("two"));
+  KJ_EXPECT(hasEntry(cache, "export default 1;"_kj, "one"));
+  KJ_EXPECT(hasEntry(cache, "export default 2;"_kj, "two"));
+
+  // Data V8 rejected is replaced.
+  cache.add("export default 1;"_kj, bytes("fresh"));
+  KJ_EXPECT(hasEntry(cache, "export default 1;"_kj, "fresh"));
+}
+
+KJ_TEST("ModuleCodeCacheImpl persists entries to its directory") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+
+  {
+    ModuleCodeCacheImpl cache(dir->clone());
+    cache.add("export default 1;"_kj, bytes("one"));
+  }
+
+  // One file per entry.
+  KJ_EXPECT(dir->listNames().size() == 1);
+
+  // A new process finds it.
+  ModuleCodeCacheImpl cache(dir->clone());
+  KJ_EXPECT(hasEntry(cache, "export default 1;"_kj, "one"));
+  KJ_EXPECT(cache.find("export default 2;"_kj) == nullptr);
+
+  // Empty files, e.g. left by a failed write, are ignored.
+  auto names = dir->listNames();
+  dir->openFile(kj::Path({names[0]}), kj::WriteMode::MODIFY)->truncate(0);
+  ModuleCodeCacheImpl emptied(dir->clone());
+  KJ_EXPECT(emptied.find("export default 1;"_kj) == nullptr);
+}
+
+}  // namespace
+}  // namespace workerd::server
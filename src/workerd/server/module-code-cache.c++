@@ -0,0 +1,77 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "module-code-cache.h"
+#include <kj/encoding.h>
+#include <openssl/sha.h>
+
+namespace workerd::server {
+
+namespace {
+
+kj::String hashContent(kj::ArrayPtr<const char> content) {
+  kj::byte digest[SHA256_DIGEST_LENGTH];
+  SHA256(content.asBytes().begin(), content.size(), digest);
+  return kj::encodeHex(kj::ArrayPtr<const kj::byte>(digest));
+}
+
+}  // namespace
+
+ModuleCodeCacheImpl::ModuleCodeCacheImpl(kj::Maybe<kj::Own<const kj::Directory>> directory)
+    : directory(kj::mv(directory)) {}
+
+kj::Maybe<kj::Array<const kj::byte>> ModuleCodeCacheImpl::find(
+    kj::ArrayPtr<const char> content) const {
+  auto key = hashContent(content);
+
+  {
+    auto lock = entries.lockShared();
+    KJ_IF_MAYBE(entry, lock->find(key)) {
+      return kj::heapArray<const kj::byte>(*entry);
+    }
+  }
+
+  KJ_IF_MAYBE(dir, directory) {
+    kj::Maybe<kj::Array<const kj::byte>> result;
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      KJ_IF_MAYBE(file, (*dir)->tryOpenFile(kj::Path({key}))) {
+        kj::Array<const kj::byte> data = (*file)->readAllBytes();
+        if (data.size() > 0) {
+          result = kj::heapArray<const kj::byte>(data);
+          entries.lockExclusive()->upsert(kj::mv(key), kj::mv(data), [](auto&, auto&&) {});
+        }
+      }
+    })) {
+      KJ_LOG(WARNING, "failed to read module code cache entry", *exception);
+    }
+    return kj::mv(result);
+  }
+
+  return nullptr;
+}
+
+void ModuleCodeCacheImpl::add(
+    kj::ArrayPtr<const char> content, kj::ArrayPtr<const kj::byte> data) const {
+  auto key = hashContent(content);
+
+  KJ_IF_MAYBE(dir, directory) {
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      // Write through a replacer so that concurrent readers (including other processes sharing
+      // the directory) never observe a partially-written entry.
+      auto replacer = (*dir)->replaceFile(kj::Path({key}),
+          kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+      replacer->get().writeAll(data);
+      replacer->commit();
+    })) {
+      KJ_LOG(WARNING, "failed to write module code cache entry", *exception);
+    }
+  }
+
+  entries.lockExclusive()->upsert(kj::mv(key), kj::heapArray<const kj::byte>(data),
+      [](kj::Array<const kj::byte>& existing, kj::Array<const kj::byte>&& replacement) {
+    existing = kj::mv(replacement);
+  });
+}
+
+}  // namespace workerd::server
@@ -0,0 +1,35 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <workerd/jsg/modules.h>
+#include <kj/filesystem.h>
+#include <kj/map.h>
+#include <kj/mutex.h>
+
+namespace workerd::server {
+
+class ModuleCodeCacheImpl final: public jsg::ModuleCodeCache {
+  // A process-wide ModuleCodeCache keyed by the SHA-256 of each module's source. Entries live in
+  // memory for the lifetime of the process. If a directory is given, entries are also written to
+  // it (one file per entry, named by hash) and read back on an in-memory miss, so the cache
+  // survives restarts.
+  //
+  // Entries are never evicted; the cache is bounded by the total size of distinct module sources
+  // the process was configured with.
+public:
+  explicit ModuleCodeCacheImpl(kj::Maybe<kj::Own<const kj::Directory>> directory = nullptr);
+
+  kj::Maybe<kj::Array<const kj::byte>> find(kj::ArrayPtr<const char> content) const override;
+  void add(kj::ArrayPtr<const char> content, kj::ArrayPtr<const kj::byte> data) const override;
+
+private:
+  kj::Maybe<kj::Own<const kj::Directory>> directory;
+
+  kj::MutexGuarded<kj::HashMap<kj::String, kj::Array<const kj::byte>>> entries;
+  // Maps hex-encoded SHA-256 of the module source to V8 cached data.
+};
+
+}  // namespace workerd::server
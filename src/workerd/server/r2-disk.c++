@@ -0,0 +1,839 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "r2-disk.h"
+#include <workerd/util/uuid.h>
+#include <capnp/compat/json.h>
+#include <kj/debug.h>
+#include <kj/encoding.h>
+#include <openssl/evp.h>
+
+namespace workerd::server {
+
+using namespace api::public_beta;
+
+namespace {
+
+// v4 error codes, as R2 itself reports them.
+constexpr uint V4_NO_SUCH_KEY = 10007;
+constexpr uint V4_NO_SUCH_UPLOAD = 10024;
+constexpr uint V4_INVALID_PART = 10025;
+constexpr uint V4_INVALID_ARGUMENT = 10029;
+constexpr uint V4_PRECONDITION_FAILED = 10031;
+constexpr uint V4_BAD_DIGEST = 10037;
+constexpr uint V4_INVALID_RANGE = 10039;
+
+constexpr uint64_t UNSET = 0xffffffffffffffff;
+// The default of the optional UInt64 fields in r2-api.capnp.
+
+template <typename T>
+kj::String encodeJson(typename T::Reader value) {
+  capnp::JsonCodec json;
+  json.handleByAnnotation<T>();
+  json.setHasMode(capnp::HasMode::NON_DEFAULT);
+  return json.encode(value);
+}
+
+template <typename T>
+void decodeJson(kj::ArrayPtr<const char> text, typename T::Builder value) {
+  capnp::JsonCodec json;
+  json.handleByAnnotation<T>();
+  json.decode(text, value);
+}
+
+class Digester {
+  // Incrementally computes a hash with the given OpenSSL digest.
+
+public:
+  explicit Digester(const EVP_MD* md): ctx(EVP_MD_CTX_new()) {
+    KJ_ASSERT(ctx != nullptr);
+    KJ_ASSERT(EVP_DigestInit_ex(ctx, md, nullptr) == 1);
+  }
+  ~Digester() noexcept(false) { EVP_MD_CTX_free(ctx); }
+  KJ_DISALLOW_COPY_AND_MOVE(Digester);
+
+  void update(kj::ArrayPtr<const kj::byte> data) {
+    KJ_ASSERT(EVP_DigestUpdate(ctx, data.begin(), data.size()) == 1);
+  }
+
+  kj::Array<kj::byte> finish() {
+    auto result = kj::heapArray<kj::byte>(EVP_MD_CTX_size(ctx));
+    uint size;
+    KJ_ASSERT(EVP_DigestFinal_ex(ctx, result.begin(), &size) == 1);
+    KJ_ASSERT(size == result.size());
+    return result;
+  }
+
+private:
+  EVP_MD_CTX* ctx;
+};
+
+struct PutDigests {
+  // The hashes computed over a put's content: always MD5, plus whichever others the put supplied
+  // for us to check.
+
+  Digester md5 { EVP_md5() };
+  kj::Maybe<kj::Own<Digester>> sha1;
+  kj::Maybe<kj::Own<Digester>> sha256;
+  kj::Maybe<kj::Own<Digester>> sha384;
+  kj::Maybe<kj::Own<Digester>> sha512;
+
+  PutDigests() = default;
+  explicit PutDigests(R2PutRequest::Reader request) {
+    if (request.hasSha1()) sha1 = kj::heap<Digester>(EVP_sha1());
+    if (request.hasSha256()) sha256 = kj::heap<Digester>(EVP_sha256());
+    if (request.hasSha384()) sha384 = kj::heap<Digester>(EVP_sha384());
+    if (request.hasSha512()) sha512 = kj::heap<Digester>(EVP_sha512());
+  }
+
+  void update(kj::ArrayPtr<const kj::byte> data) {
+    md5.update(data);
+    KJ_IF_MAYBE(d, sha1) (*d)->update(data);
+    KJ_IF_MAYBE(d, sha256) (*d)->update(data);
+    KJ_IF_MAYBE(d, sha384) (*d)->update(data);
+    KJ_IF_MAYBE(d, sha512) (*d)->update(data);
+  }
+};
+
+kj::Promise<uint64_t> writeBody(kj::AsyncInputStream& body, const kj::File& file,
+                                PutDigests& digests, size_t chunkSize) {
+  // Copies `body` into `file`, feeding it through `digests` along the way. Returns the size.
+
+  auto buffer = kj::heapArray<kj::byte>(chunkSize);
+  uint64_t offset = 0;
+  for (;;) {
+    size_t n = co_await body.tryRead(buffer.begin(), 1, buffer.size());
+    if (n == 0) break;
+    auto chunk = buffer.slice(0, n);
+    file.write(offset, chunk);
+    digests.update(chunk);
+    offset += n;
+  }
+  co_return offset;
+}
+
+bool digestEquals(kj::ArrayPtr<const kj::byte> a, kj::ArrayPtr<const kj::byte> b) {
+  return a == b;
+}
+
+bool etagListMatches(capnp::List<R2Etag>::Reader etags, kj::StringPtr etag) {
+  for (auto e: etags) {
+    if (e.getType().isWildcard() || e.getValue() == etag) return true;
+  }
+  return false;
+}
+
+bool conditionHolds(R2Conditional::Reader cond, kj::Maybe<R2HeadResponse::Reader> object) {
+  // Evaluates `onlyIf` against the current object, or null if there is none. As with the
+  // corresponding HTTP headers, a matching `etagMatches` overrides `uploadedBefore`, and a
+  // non-matching `etagDoesNotMatch` overrides `uploadedAfter`.
+
+  auto& o = KJ_UNWRAP_OR(object, {
+    return !cond.hasEtagMatches() || cond.getEtagMatches().size() == 0;
+  });
+
+  bool checkBefore = true;
+  bool checkAfter = true;
+  if (cond.hasEtagMatches() && cond.getEtagMatches().size() > 0) {
+    if (!etagListMatches(cond.getEtagMatches(), o.getEtag())) return false;
+    checkBefore = false;
+  }
+  if (cond.hasEtagDoesNotMatch() && cond.getEtagDoesNotMatch().size() > 0) {
+    if (etagListMatches(cond.getEtagDoesNotMatch(), o.getEtag())) return false;
+    checkAfter = false;
+  }
+
+  uint64_t uploaded = o.getUploadedMillisecondsSinceEpoch();
+  uint64_t before = cond.getUploadedBefore();
+  uint64_t after = cond.getUploadedAfter();
+  if (cond.getSecondsGranularity()) {
+    uploaded /= 1000;
+    if (before != UNSET) before /= 1000;
+    if (after != UNSET) after /= 1000;
+  }
+  if (checkBefore && before != UNSET && uploaded >= before) return false;
+  if (checkAfter && after != UNSET && uploaded <= after) return false;
+  return true;
+}
+
+kj::Maybe<uint64_t> parseDecimal(kj::StringPtr text) {
+  if (text.size() == 0) return nullptr;
+  uint64_t result = 0;
+  for (char c: text) {
+    if (c < '0' || c > '9') return nullptr;
+    if (result > (UNSET - uint64_t(c - '0')) / 10) return nullptr;
+    result = result * 10 + (c - '0');
+  }
+  return result;
+}
+
+struct ByteRange {
+  uint64_t offset;
+  uint64_t length;
+};
+
+bool resolveRange(R2GetRequest::Reader request, uint64_t size, kj::Maybe<ByteRange>& result) {
+  // Works out which part of an object of the given size a get asked for, clamped to the object.
+  // Leaves `result` null if it asked for the whole object, and returns false if the range can't
+  // be satisfied.
+
+  uint64_t offset = UNSET;
+  uint64_t length = UNSET;
+  uint64_t suffix = UNSET;
+
+  if (request.hasRangeHeader()) {
+    auto header = request.getRangeHeader();
+    if (!header.startsWith("bytes=")) return false;
+    auto spec = header.slice(strlen("bytes="));
+    size_t dash = KJ_UNWRAP_OR(spec.findFirst('-'), { return false; });
+    auto first = kj::str(spec.slice(0, dash));
+    auto last = kj::str(spec.slice(dash + 1));
+    if (first.size() == 0) {
+      suffix = KJ_UNWRAP_OR(parseDecimal(last), { return false; });
+    } else {
+      offset = KJ_UNWRAP_OR(parseDecimal(first), { return false; });
+      if (last.size() > 0) {
+        uint64_t lastByte = KJ_UNWRAP_OR(parseDecimal(last), { return false; });
+        if (lastByte < offset) return false;
+        length = lastByte - offset + 1;
+      }
+    }
+  } else if (request.hasRange()) {
+    auto range = request.getRange();
+    offset = range.getOffset();
+    length = range.getLength();
+    suffix = range.getSuffix();
+  } else {
+    return true;
+  }
+
+  if (suffix != UNSET) {
+    suffix = kj::min(suffix, size);
+    result = ByteRange { .offset = size - suffix, .length = suffix };
+    return true;
+  }
+  if (offset == UNSET && length == UNSET) return true;
+
+  if (offset == UNSET) offset = 0;
+  if (offset > size) return false;
+  length = kj::min(length, size - offset);
+  result = ByteRange { .offset = offset, .length = length };
+  return true;
+}
+
+}  // namespace
+
+R2DiskStore::R2DiskStore(const kj::Clock& clock, kj::Own<const kj::Directory> dirParam,
+                         kj::HttpHeaderTable::Builder& headerTableBuilder)
+    : clock(clock), dir(kj::mv(dirParam)),
+      headerTable(headerTableBuilder.getFutureTable()),
+      hR2Request(headerTableBuilder.add("CF-R2-Request")),
+      hR2MetadataSize(headerTableBuilder.add("CF-R2-Metadata-Size")),
+      hR2Error(headerTableBuilder.add("CF-R2-Error")),
+      vfs(kj::heap<SqliteDatabase::Vfs>(*dir)),
+      db([&]{
+        auto db = kj::heap<SqliteDatabase>(*vfs, kj::Path({"r2.sqlite"}),
+            kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+        ensureInitialized(*db);
+        return kj::mv(db);
+      }()) {}
+
+R2DiskStore::~R2DiskStore() noexcept(false) {}
+
+void R2DiskStore::ensureInitialized(SqliteDatabase& db) {
+  db.run("PRAGMA journal_mode=WAL;");
+
+  db.run(R"(
+    CREATE TABLE IF NOT EXISTS objects (
+      key TEXT PRIMARY KEY,
+      version TEXT NOT NULL,
+      metadata TEXT NOT NULL
+    ) WITHOUT ROWID;
+  )");
+
+  db.run(R"(
+    CREATE TABLE IF NOT EXISTS uploads (
+      upload_id TEXT PRIMARY KEY,
+      key TEXT NOT NULL,
+      metadata TEXT NOT NULL
+    ) WITHOUT ROWID;
+  )");
+
+  db.run(R"(
+    CREATE TABLE IF NOT EXISTS parts (
+      upload_id TEXT,
+      part INTEGER,
+      size INTEGER NOT NULL,
+      etag TEXT NOT NULL,
+      md5 BLOB NOT NULL,
+      PRIMARY KEY (upload_id, part)
+    ) WITHOUT ROWID;
+  )");
+}
+
+kj::Promise<void> R2DiskStore::request(
+    kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+    kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) {
+  // The URL names the bucket, which is irrelevant since we only hold the one.
+
+  capnp::MallocMessageBuilder requestMessage;
+  auto requestBuilder = requestMessage.initRoot<R2BindingRequest>();
+
+  if (method == kj::HttpMethod::GET) {
+    kj::StringPtr json;
+    KJ_IF_MAYBE(h, headers.get(hR2Request)) {
+      json = *h;
+    } else {
+      co_await sendFailure(response, { 400, "Bad Request", V4_INVALID_ARGUMENT,
+          kj::str("Missing CF-R2-Request header.") });
+      co_return;
+    }
+    KJ_IF_MAYBE(e, kj::runCatchingExceptions([&]() {
+      decodeJson<R2BindingRequest>(json.asArray(), requestBuilder);
+    })) {
+      co_await sendFailure(response, { 400, "Bad Request", V4_INVALID_ARGUMENT,
+          kj::str("Malformed request: ", e->getDescription()) });
+      co_return;
+    }
+
+    auto payload = requestBuilder.asReader().getPayload();
+    switch (payload.which()) {
+      case R2BindingRequest::Payload::HEAD:
+        co_await head(payload.getHead(), response);
+        co_return;
+      case R2BindingRequest::Payload::GET:
+        co_await get(payload.getGet(), response);
+        co_return;
+      case R2BindingRequest::Payload::LIST:
+        co_await list(payload.getList(), response);
+        co_return;
+      default:
+        break;
+    }
+  } else if (method == kj::HttpMethod::PUT) {
+    kj::Maybe<uint64_t> maybeMetadataSize;
+    KJ_IF_MAYBE(h, headers.get(hR2MetadataSize)) {
+      maybeMetadataSize = parseDecimal(*h);
+    }
+    uint64_t metadataSize = 0;
+    KJ_IF_MAYBE(m, maybeMetadataSize) {
+      metadataSize = *m;
+    } else {
+      co_await sendFailure(response, { 400, "Bad Request", V4_INVALID_ARGUMENT,
+          kj::str("Missing or malformed CF-R2-Metadata-Size header.") });
+      co_return;
+    }
+    if (metadataSize > MAX_METADATA_SIZE) {
+      co_await sendFailure(response, { 400, "Bad Request", V4_INVALID_ARGUMENT,
+          kj::str("Request metadata is too large.") });
+      co_return;
+    }
+
+    auto json = kj::heapArray<char>(metadataSize);
+    size_t n = co_await requestBody.tryRead(json.begin(), json.size(), json.size());
+    KJ_IF_MAYBE(e, kj::runCatchingExceptions([&]() {
+      KJ_REQUIRE(n == json.size(), "request body is shorter than CF-R2-Metadata-Size");
+      decodeJson<R2BindingRequest>(json, requestBuilder);
+    })) {
+      co_await sendFailure(response, { 400, "Bad Request", V4_INVALID_ARGUMENT,
+          kj::str("Malformed request: ", e->getDescription()) });
+      co_return;
+    }
+
+    auto payload = requestBuilder.asReader().getPayload();
+    switch (payload.which()) {
+      case R2BindingRequest::Payload::PUT:
+        co_await put(payload.getPut(), requestBody, response);
+        co_return;
+      case R2BindingRequest::Payload::DELETE:
+        co_await del(payload.getDelete(), response);
+        co_return;
+      case R2BindingRequest::Payload::CREATE_MULTIPART_UPLOAD:
+        co_await createMultipartUpload(payload.getCreateMultipartUpload(), response);
+        co_return;
+      case R2BindingRequest::Payload::UPLOAD_PART:
+        co_await uploadPart(payload.getUploadPart(), requestBody, response);
+        co_return;
+      case R2BindingRequest::Payload::COMPLETE_MULTIPART_UPLOAD:
+        co_await completeMultipartUpload(payload.getCompleteMultipartUpload(), response);
+        co_return;
+      case R2BindingRequest::Payload::ABORT_MULTIPART_UPLOAD:
+        co_await abortMultipartUpload(payload.getAbortMultipartUpload(), response);
+        co_return;
+      default:
+        break;
+    }
+  } else {
+    co_await response.sendError(405, "Method Not Allowed", headerTable);
+    co_return;
+  }
+
+  // Bucket administration, or a method we don't know.
+  co_await sendFailure(response, { 501, "Not Implemented", V4_INVALID_ARGUMENT,
+      kj::str("Operation not supported by local disk R2 buckets.") });
+}
+
+kj::Promise<void> R2DiskStore::head(
+    R2HeadRequest::Reader request, kj::HttpService::Response& response) {
+  KJ_IF_MAYBE(object, findObject(request.getObject())) {
+    return sendJson(response, kj::mv(object->metadata));
+  } else {
+    return sendFailure(response, { 404, "Not Found", V4_NO_SUCH_KEY,
+        kj::str("The specified key does not exist.") });
+  }
+}
+
+kj::Promise<void> R2DiskStore::get(
+    R2GetRequest::Reader request, kj::HttpService::Response& response) {
+  auto object = KJ_UNWRAP_OR(findObject(request.getObject()), {
+    return sendFailure(response, { 404, "Not Found", V4_NO_SUCH_KEY,
+        kj::str("The specified key does not exist.") });
+  });
+
+  capnp::MallocMessageBuilder message;
+  auto metadata = message.initRoot<R2HeadResponse>();
+  decodeJson<R2HeadResponse>(object.metadata.asArray(), metadata);
+
+  if (request.hasOnlyIf() && !conditionHolds(request.getOnlyIf(), metadata.asReader())) {
+    return sendFailure(response, { 412, "Precondition Failed", V4_PRECONDITION_FAILED,
+        kj::str("At least one of the pre-conditions you specified did not hold.") },
+        kj::mv(object.metadata));
+  }
+
+  uint64_t size = metadata.getSize();
+  uint64_t offset = 0;
+  uint64_t length = size;
+  kj::Maybe<ByteRange> range;
+  if (!resolveRange(request, size, range)) {
+    return sendFailure(response, { 416, "Range Not Satisfiable", V4_INVALID_RANGE,
+        kj::str("The requested range is not satisfiable.") });
+  }
+  KJ_IF_MAYBE(r, range) {
+    offset = r->offset;
+    length = r->length;
+    auto echo = metadata.initRange();
+    echo.setOffset(offset);
+    echo.setLength(length);
+    object.metadata = encodeJson<R2HeadResponse>(metadata.asReader());
+  }
+
+  // Open the content before responding, so that a concurrent overwrite can't pull it out from
+  // under us once we've committed to a size.
+  auto file = dir->openFile(kj::Path({"objects"_kj, object.version}));
+
+  kj::HttpHeaders headers(headerTable);
+  headers.set(hR2MetadataSize, kj::str(object.metadata.size()));
+  uint64_t total = object.metadata.size() + length;
+  headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(total));
+  auto out = response.send(200, "OK", headers, total);
+
+  auto promise = out->write(object.metadata.begin(), object.metadata.size());
+  return promise.attach(kj::mv(object.metadata))
+      .then([file = kj::mv(file), out = kj::mv(out), offset, length]() mutable {
+    return sendFileRange(kj::mv(file), kj::mv(out), offset, length);
+  });
+}
+
+kj::Promise<void> R2DiskStore::list(
+    R2ListRequest::Reader request, kj::HttpService::Response& response) {
+  uint limit = kj::min(request.getLimit(), MAX_LIST_LIMIT);
+  kj::StringPtr prefix = request.hasPrefix() ? request.getPrefix() : ""_kj;
+  kj::StringPtr delimiter = request.hasDelimiter() ? request.getDelimiter() : ""_kj;
+
+  // Listing resumes after the later of the cursor and `startAfter`.
+  kj::StringPtr after = ""_kj;
+  if (request.hasStartAfter()) after = request.getStartAfter();
+  if (request.hasCursor() && request.getCursor() > after) after = request.getCursor();
+
+  bool includeHttp = !request.getNewRuntime();
+  bool includeCustom = !request.getNewRuntime();
+  for (auto field: request.getInclude()) {
+    if (field == uint16_t(R2ListRequest::IncludeField::HTTP)) includeHttp = true;
+    if (field == uint16_t(R2ListRequest::IncludeField::CUSTOM)) includeCustom = true;
+  }
+
+  kj::Vector<kj::String> objects;
+  kj::Vector<kj::String> delimitedPrefixes;
+  kj::String cursor;
+  bool truncated = false;
+
+  auto query = stmtListObjects.run(prefix, after);
+  while (!query.isDone()) {
+    auto key = query.getText(0);
+    if (!key.startsWith(prefix)) break;
+
+    kj::Maybe<kj::String> delimitedPrefix;
+    if (delimiter.size() > 0) {
+      auto rest = key.slice(prefix.size());
+      for (size_t i = 0; i + delimiter.size() <= rest.size(); i++) {
+        if (rest.slice(i).startsWith(delimiter)) {
+          delimitedPrefix = kj::str(key.slice(0, prefix.size() + i + delimiter.size()));
+          break;
+        }
+      }
+    }
+
+    KJ_IF_MAYBE(p, delimitedPrefix) {
+      // Keys under a prefix we've already reported are skipped, but still move the cursor, so
+      // that the next page doesn't report the prefix again.
+      if (delimitedPrefixes.empty() || delimitedPrefixes.back() != *p) {
+        if (objects.size() + delimitedPrefixes.size() == limit) {
+          truncated = true;
+          break;
+        }
+        delimitedPrefixes.add(kj::mv(*p));
+      }
+    } else {
+      if (objects.size() + delimitedPrefixes.size() == limit) {
+        truncated = true;
+        break;
+      }
+      objects.add(kj::str(query.getText(1)));
+    }
+
+    cursor = kj::str(key);
+    query.nextRow();
+  }
+
+  capnp::MallocMessageBuilder message;
+  auto result = message.initRoot<R2ListResponse>();
+  auto objectsBuilder = result.initObjects(objects.size());
+  for (auto i: kj::indices(objects)) {
+    auto object = objectsBuilder[i];
+    decodeJson<R2HeadResponse>(objects[i].asArray(), object);
+    if (!includeHttp) object.disownHttpFields();
+    if (!includeCustom) object.disownCustomFields();
+  }
+  result.setTruncated(truncated);
+  if (truncated) result.setCursor(cursor);
+  if (delimitedPrefixes.size() > 0) {
+    auto prefixesBuilder = result.initDelimitedPrefixes(delimitedPrefixes.size());
+    for (auto i: kj::indices(delimitedPrefixes)) {
+      prefixesBuilder.set(i, delimitedPrefixes[i]);
+    }
+  }
+
+  return sendJson(response, encodeJson<R2ListResponse>(result.asReader()));
+}
+
+kj::Promise<void> R2DiskStore::put(R2PutRequest::Reader request, kj::AsyncInputStream& body,
+                                   kj::HttpService::Response& response) {
+  auto key = request.getObject();
+  auto version = randomUUID(nullptr);
+  auto replacer = dir->replaceFile(kj::Path({"objects"_kj, version}),
+      kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+
+  PutDigests digests(request);
+  uint64_t size = co_await writeBody(body, replacer->get(), digests, READ_CHUNK_SIZE);
+
+  capnp::MallocMessageBuilder message;
+  auto metadata = message.initRoot<R2HeadResponse>();
+  auto checksums = metadata.initChecksums();
+
+  // Checks each supplied digest, and records it. We don't record digests nobody asked for, other
+  // than MD5, because R2 doesn't either.
+  bool digestsMatch = true;
+  auto md5 = digests.md5.finish();
+  if (request.hasMd5() && !digestEquals(request.getMd5(), md5)) digestsMatch = false;
+  checksums.setMd5(md5);
+  KJ_IF_MAYBE(d, digests.sha1) {
+    auto hash = (*d)->finish();
+    if (!digestEquals(request.getSha1(), hash)) digestsMatch = false;
+    checksums.setSha1(hash);
+  }
+  KJ_IF_MAYBE(d, digests.sha256) {
+    auto hash = (*d)->finish();
+    if (!digestEquals(request.getSha256(), hash)) digestsMatch = false;
+    checksums.setSha256(hash);
+  }
+  KJ_IF_MAYBE(d, digests.sha384) {
+    auto hash = (*d)->finish();
+    if (!digestEquals(request.getSha384(), hash)) digestsMatch = false;
+    checksums.setSha384(hash);
+  }
+  KJ_IF_MAYBE(d, digests.sha512) {
+    auto hash = (*d)->finish();
+    if (!digestEquals(request.getSha512(), hash)) digestsMatch = false;
+    checksums.setSha512(hash);
+  }
+  if (!digestsMatch) {
+    // Dropping `replacer` without committing discards what we wrote.
+    co_await sendFailure(response, { 400, "Bad Request", V4_BAD_DIGEST,
+        kj::str("The checksum you specified did not match what we received.") });
+    co_return;
+  }
+
+  // Preconditions are checked against the object as it is now that the upload is complete, since
+  // that's what we'd be replacing.
+  auto existing = findObject(key);
+  if (request.hasOnlyIf()) {
+    capnp::MallocMessageBuilder existingMessage;
+    kj::Maybe<R2HeadResponse::Reader> existingMetadata;
+    KJ_IF_MAYBE(e, existing) {
+      auto builder = existingMessage.initRoot<R2HeadResponse>();
+      decodeJson<R2HeadResponse>(e->metadata.asArray(), builder);
+      existingMetadata = builder.asReader();
+    }
+    if (!conditionHolds(request.getOnlyIf(), existingMetadata)) {
+      co_await sendFailure(response, { 412, "Precondition Failed", V4_PRECONDITION_FAILED,
+          kj::str("At least one of the pre-conditions you specified did not hold.") });
+      co_return;
+    }
+  }
+
+  metadata.setName(key);
+  metadata.setVersion(version);
+  metadata.setSize(size);
+  metadata.setEtag(kj::encodeHex(md5));
+  metadata.setUploadedMillisecondsSinceEpoch(nowMs());
+  if (request.hasHttpFields()) metadata.setHttpFields(request.getHttpFields());
+  if (request.hasCustomFields()) metadata.setCustomFields(request.getCustomFields());
+  auto json = encodeJson<R2HeadResponse>(metadata.asReader());
+
+  replacer->commit();
+  stmtPutObject.run(key, kj::StringPtr(version), kj::StringPtr(json));
+  KJ_IF_MAYBE(e, existing) {
+    removeQuietly(kj::Path({"objects"_kj, e->version}));
+  }
+
+  co_await sendJson(response, kj::mv(json));
+}
+
+kj::Promise<void> R2DiskStore::del(
+    R2DeleteRequest::Reader request, kj::HttpService::Response& response) {
+  auto deleteOne = [&](kj::StringPtr key) {
+    KJ_IF_MAYBE(object, findObject(key)) {
+      stmtDeleteObject.run(key);
+      removeQuietly(kj::Path({"objects"_kj, object->version}));
+    }
+  };
+
+  switch (request.which()) {
+    case R2DeleteRequest::OBJECT:
+      deleteOne(request.getObject());
+      break;
+    case R2DeleteRequest::OBJECTS:
+      db->run("BEGIN TRANSACTION;");
+      {
+        KJ_ON_SCOPE_FAILURE(db->run("ROLLBACK TRANSACTION;"));
+        for (auto key: request.getObjects()) {
+          deleteOne(key);
+        }
+      }
+      db->run("COMMIT TRANSACTION;");
+      break;
+  }
+
+  return sendJson(response, kj::str("{}"));
+}
+
+kj::Promise<void> R2DiskStore::createMultipartUpload(
+    R2CreateMultipartUploadRequest::Reader request, kj::HttpService::Response& response) {
+  capnp::MallocMessageBuilder message;
+  auto metadata = message.initRoot<R2HeadResponse>();
+  if (request.hasHttpFields()) metadata.setHttpFields(request.getHttpFields());
+  if (request.hasCustomFields()) metadata.setCustomFields(request.getCustomFields());
+
+  auto uploadId = randomUUID(nullptr);
+  stmtPutUpload.run(kj::StringPtr(uploadId), request.getObject(),
+      kj::StringPtr(encodeJson<R2HeadResponse>(metadata.asReader())));
+
+  capnp::MallocMessageBuilder responseMessage;
+  auto result = responseMessage.initRoot<R2CreateMultipartUploadResponse>();
+  result.setUploadId(uploadId);
+  return sendJson(response, encodeJson<R2CreateMultipartUploadResponse>(result.asReader()));
+}
+
+kj::Promise<void> R2DiskStore::uploadPart(R2UploadPartRequest::Reader request,
+    kj::AsyncInputStream& body, kj::HttpService::Response& response) {
+  if (findUpload(request.getUploadId(), request.getObject()) == nullptr) {
+    co_await sendFailure(response, { 404, "Not Found", V4_NO_SUCH_UPLOAD,
+        kj::str("The specified multipart upload does not exist.") });
+    co_return;
+  }
+
+  auto partNumber = request.getPartNumber();
+  auto replacer = dir->replaceFile(
+      kj::Path({"multipart"_kj, request.getUploadId(), kj::str(partNumber)}),
+      kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+
+  PutDigests digests;
+  uint64_t size = co_await writeBody(body, replacer->get(), digests, READ_CHUNK_SIZE);
+  auto md5 = digests.md5.finish();
+
+  // The upload may have been completed or aborted while we were receiving the part.
+  if (findUpload(request.getUploadId(), request.getObject()) == nullptr) {
+    co_await sendFailure(response, { 404, "Not Found", V4_NO_SUCH_UPLOAD,
+        kj::str("The specified multipart upload does not exist.") });
+    co_return;
+  }
+
+  // The part's ETag is unique to this upload of it, so that completing with the ETag of a part
+  // that has since been re-uploaded fails rather than silently using the new content.
+  auto etag = kj::str(kj::encodeHex(md5), '-', randomUUID(nullptr));
+
+  replacer->commit();
+  stmtPutPart.run(request.getUploadId(), partNumber, int64_t(size), kj::StringPtr(etag),
+                  md5.asPtr().asConst());
+
+  capnp::MallocMessageBuilder message;
+  auto result = message.initRoot<R2UploadPartResponse>();
+  result.setEtag(etag);
+  co_await sendJson(response, encodeJson<R2UploadPartResponse>(result.asReader()));
+}
+
+kj::Promise<void> R2DiskStore::completeMultipartUpload(
+    R2CompleteMultipartUploadRequest::Reader request, kj::HttpService::Response& response) {
+  auto uploadId = request.getUploadId();
+  auto key = request.getObject();
+  auto upload = KJ_UNWRAP_OR(findUpload(uploadId, key), {
+    return sendFailure(response, { 404, "Not Found", V4_NO_SUCH_UPLOAD,
+        kj::str("The specified multipart upload does not exist.") });
+  });
+
+  auto parts = request.getParts();
+  if (parts.size() == 0) {
+    return sendFailure(response, { 400, "Bad Request", V4_INVALID_PART,
+        kj::str("A multipart upload must have at least one part.") });
+  }
+
+  // Assemble the object from the listed parts. File::copy() lets the filesystem share or copy the
+  // blocks itself where it can.
+  auto version = randomUUID(nullptr);
+  auto replacer = dir->replaceFile(kj::Path({"objects"_kj, version}),
+      kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+  auto& file = replacer->get();
+  Digester etagDigest(EVP_md5());
+  uint64_t size = 0;
+  for (auto part: parts) {
+    auto query = stmtGetPart.run(uploadId, part.getPart());
+    if (query.isDone() || query.getText(1) != part.getEtag()) {
+      return sendFailure(response, { 400, "Bad Request", V4_INVALID_PART,
+          kj::str("Part ", part.getPart(), " was not found or its ETag does not match.") });
+    }
+    uint64_t partSize = query.getInt64(0);
+    etagDigest.update(query.getBlob(2));
+
+    auto partFile = dir->openFile(
+        kj::Path({"multipart"_kj, uploadId, kj::str(part.getPart())}));
+    file.copy(size, *partFile, 0, partSize);
+    size += partSize;
+  }
+
+  capnp::MallocMessageBuilder message;
+  auto metadata = message.initRoot<R2HeadResponse>();
+  decodeJson<R2HeadResponse>(upload.metadata.asArray(), metadata);
+  metadata.setName(key);
+  metadata.setVersion(version);
+  metadata.setSize(size);
+  metadata.setEtag(kj::str(kj::encodeHex(etagDigest.finish()), '-', parts.size()));
+  metadata.setUploadedMillisecondsSinceEpoch(nowMs());
+  auto json = encodeJson<R2HeadResponse>(metadata.asReader());
+
+  replacer->commit();
+  auto existing = findObject(key);
+  db->run("BEGIN TRANSACTION;");
+  {
+    KJ_ON_SCOPE_FAILURE(db->run("ROLLBACK TRANSACTION;"));
+    stmtPutObject.run(key, kj::StringPtr(version), kj::StringPtr(json));
+    stmtDeleteUpload.run(uploadId);
+    stmtDeleteParts.run(uploadId);
+  }
+  db->run("COMMIT TRANSACTION;");
+
+  KJ_IF_MAYBE(e, existing) {
+    removeQuietly(kj::Path({"objects"_kj, e->version}));
+  }
+  removeQuietly(kj::Path({"multipart"_kj, uploadId}));
+
+  return sendJson(response, kj::mv(json));
+}
+
+kj::Promise<void> R2DiskStore::abortMultipartUpload(
+    R2AbortMultipartUploadRequest::Reader request, kj::HttpService::Response& response) {
+  auto uploadId = request.getUploadId();
+  if (findUpload(uploadId, request.getObject()) == nullptr) {
+    return sendFailure(response, { 404, "Not Found", V4_NO_SUCH_UPLOAD,
+        kj::str("The specified multipart upload does not exist.") });
+  }
+
+  db->run("BEGIN TRANSACTION;");
+  {
+    KJ_ON_SCOPE_FAILURE(db->run("ROLLBACK TRANSACTION;"));
+    stmtDeleteUpload.run(uploadId);
+    stmtDeleteParts.run(uploadId);
+  }
+  db->run("COMMIT TRANSACTION;");
+  removeQuietly(kj::Path({"multipart"_kj, uploadId}));
+
+  return sendJson(response, kj::str("{}"));
+}
+
+kj::Promise<void> R2DiskStore::sendJson(kj::HttpService::Response& response, kj::String json) {
+  kj::HttpHeaders headers(headerTable);
+  headers.set(hR2MetadataSize, kj::str(json.size()));
+  headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(json.size()));
+  auto out = response.send(200, "OK", headers, json.size());
+  auto promise = out->write(json.begin(), json.size());
+  return promise.attach(kj::mv(out), kj::mv(json));
+}
+
+kj::Promise<void> R2DiskStore::sendFailure(kj::HttpService::Response& response,
+    const Failure& failure, kj::Maybe<kj::String> metadata) {
+  capnp::MallocMessageBuilder message;
+  auto error = message.initRoot<R2ErrorResponse>();
+  error.setVersion(VERSION_PUBLIC_BETA);
+  error.setV4code(failure.v4code);
+  error.setMessage(failure.message);
+
+  kj::HttpHeaders headers(headerTable);
+  headers.set(hR2Error, encodeJson<R2ErrorResponse>(error.asReader()));
+
+  KJ_IF_MAYBE(m, metadata) {
+    headers.set(hR2MetadataSize, kj::str(m->size()));
+    headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(m->size()));
+    auto out = response.send(failure.httpStatus, failure.statusText, headers, m->size());
+    auto promise = out->write(m->begin(), m->size());
+    return promise.attach(kj::mv(out), kj::mv(*m));
+  } else {
+    response.send(failure.httpStatus, failure.statusText, headers, uint64_t(0));
+    return kj::READY_NOW;
+  }
+}
+
+kj::Promise<void> R2DiskStore::sendFileRange(kj::Own<const kj::ReadableFile> file,
+    kj::Own<kj::AsyncOutputStream> out, uint64_t offset, uint64_t size) {
+  auto buffer = kj::heapArray<kj::byte>(kj::min(size, uint64_t(READ_CHUNK_SIZE)));
+  while (size > 0) {
+    auto n = file->read(offset, buffer.slice(0, kj::min(size, uint64_t(buffer.size()))));
+    KJ_REQUIRE(n > 0, "R2 object file was truncated while being served");
+    co_await out->write(buffer.begin(), n);
+    offset += n;
+    size -= n;
+  }
+}
+
+kj::Maybe<R2DiskStore::StoredObject> R2DiskStore::findObject(kj::StringPtr key) {
+  auto query = stmtGetObject.run(key);
+  if (query.isDone()) return nullptr;
+  return StoredObject { .version = kj::str(query.getText(0)), .metadata = kj::str(query.getText(1)) };
+}
+
+kj::Maybe<R2DiskStore::Upload> R2DiskStore::findUpload(kj::StringPtr uploadId, kj::StringPtr key) {
+  auto query = stmtGetUpload.run(uploadId);
+  if (query.isDone() || query.getText(0) != key) return nullptr;
+  return Upload { .key = kj::str(query.getText(0)), .metadata = kj::str(query.getText(1)) };
+}
+
+void R2DiskStore::removeQuietly(kj::PathPtr path) {
+  KJ_IF_MAYBE(e, kj::runCatchingExceptions([&]() { dir->tryRemove(path); })) {
+    KJ_LOG(ERROR, "failed to remove unreferenced R2 file", path, *e);
+  }
+}
+
+int64_t R2DiskStore::nowMs() {
+  return (clock.now() - kj::UNIX_EPOCH) / kj::MILLISECONDS;
+}
+
+}  // namespace workerd::server
@@ -0,0 +1,168 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <workerd/api/r2-api.capnp.h>
+#include <workerd/util/sqlite.h>
+#include <kj/compat/http.h>
+#include <kj/filesystem.h>
+
+namespace workerd::server {
+
+class R2DiskStore final: public kj::HttpService {
+  // An R2 bucket stored in a directory on disk, speaking the protocol that the R2 binding
+  // implementation (api/r2-rpc.c++) uses to talk to its service. Requests carry an
+  // `R2BindingRequest` (api/r2-api.capnp) encoded as JSON:
+  //
+  // - `GET`: head, get and list. The request is in the `CF-R2-Request` header. The response body
+  //   is the JSON-encoded response, whose size is given by `CF-R2-Metadata-Size`, followed by the
+  //   object's content for a get.
+  // - `PUT`: put, delete and the multipart operations. The request body starts with the JSON
+  //   request, whose size is given by `CF-R2-Metadata-Size`, followed by the object or part
+  //   content. The response body is the JSON-encoded response.
+  //
+  // Failures respond with an HTTP error status and a `CF-R2-Error` header holding an
+  // `R2ErrorResponse`, using the same v4 error codes as R2 itself.
+  //
+  // Object and part content lives in plain files, written to a temporary file and atomically
+  // moved into place once complete, under names that never change: each put gets a fresh version
+  // ID and is only made visible, by updating the metadata database (`r2.sqlite`), once its
+  // content is on disk. A reader that has opened a version keeps reading it even if the object is
+  // overwritten or deleted meanwhile. Range reads are served with positioned reads straight from
+  // the file, and multipart uploads are assembled with File::copy(), which lets the kernel copy
+  // the parts without them passing through user space where the filesystem supports it.
+  //
+  // Every object gets an MD5 checksum, which is also its ETag; any other checksums a put supplies
+  // are verified and stored. Multipart objects get an S3-style ETag instead: the MD5 of the
+  // parts' MD5s followed by `-<number of parts>`.
+
+public:
+  R2DiskStore(const kj::Clock& clock, kj::Own<const kj::Directory> dir,
+              kj::HttpHeaderTable::Builder& headerTableBuilder);
+  ~R2DiskStore() noexcept(false);
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override;
+
+private:
+  const kj::Clock& clock;
+  kj::Own<const kj::Directory> dir;
+  kj::HttpHeaderTable& headerTable;
+  kj::HttpHeaderId hR2Request;
+  kj::HttpHeaderId hR2MetadataSize;
+  kj::HttpHeaderId hR2Error;
+
+  kj::Own<SqliteDatabase::Vfs> vfs;
+  kj::Own<SqliteDatabase> db;
+
+  struct Failure {
+    uint httpStatus;
+    kj::StringPtr statusText;
+    uint v4code;
+    kj::String message;
+  };
+
+  struct StoredObject {
+    kj::String version;
+    kj::String metadata;
+    // JSON-encoded R2HeadResponse, sent as-is in response to a head.
+  };
+
+  struct Upload {
+    kj::String key;
+    kj::String metadata;
+    // JSON-encoded R2HeadResponse holding just the HTTP and custom metadata to give the object.
+  };
+
+  static constexpr size_t READ_CHUNK_SIZE = 256 * 1024;
+  // Object content is read from disk, and request bodies from the network, this much at a time.
+
+  static constexpr size_t MAX_METADATA_SIZE = 1024 * 1024;
+  // Upper bound on the JSON request at the start of a PUT body. Matches what the binding accepts
+  // for responses.
+
+  static constexpr uint MAX_LIST_LIMIT = 1000;
+
+  static void ensureInitialized(SqliteDatabase& db);
+
+  kj::Promise<void> head(api::public_beta::R2HeadRequest::Reader request,
+                         kj::HttpService::Response& response);
+  kj::Promise<void> get(api::public_beta::R2GetRequest::Reader request,
+                        kj::HttpService::Response& response);
+  kj::Promise<void> list(api::public_beta::R2ListRequest::Reader request,
+                         kj::HttpService::Response& response);
+  kj::Promise<void> put(api::public_beta::R2PutRequest::Reader request,
+                        kj::AsyncInputStream& body, kj::HttpService::Response& response);
+  kj::Promise<void> del(api::public_beta::R2DeleteRequest::Reader request,
+                        kj::HttpService::Response& response);
+  kj::Promise<void> createMultipartUpload(
+      api::public_beta::R2CreateMultipartUploadRequest::Reader request,
+      kj::HttpService::Response& response);
+  kj::Promise<void> uploadPart(api::public_beta::R2UploadPartRequest::Reader request,
+                               kj::AsyncInputStream& body, kj::HttpService::Response& response);
+  kj::Promise<void> completeMultipartUpload(
+      api::public_beta::R2CompleteMultipartUploadRequest::Reader request,
+      kj::HttpService::Response& response);
+  kj::Promise<void> abortMultipartUpload(
+      api::public_beta::R2AbortMultipartUploadRequest::Reader request,
+      kj::HttpService::Response& response);
+
+  kj::Promise<void> sendJson(kj::HttpService::Response& response, kj::String json);
+  // Sends `json` as both the metadata and the whole body of a successful response.
+
+  kj::Promise<void> sendFailure(kj::HttpService::Response& response, const Failure& failure,
+                                kj::Maybe<kj::String> metadata = nullptr);
+  // Sends an error response. `metadata`, if given, is sent as the body like a successful response
+  // would, which the binding expects for a failed get precondition.
+
+  static kj::Promise<void> sendFileRange(kj::Own<const kj::ReadableFile> file,
+      kj::Own<kj::AsyncOutputStream> out, uint64_t offset, uint64_t size);
+
+  kj::Maybe<StoredObject> findObject(kj::StringPtr key);
+
+  kj::Maybe<Upload> findUpload(kj::StringPtr uploadId, kj::StringPtr key);
+
+  void removeQuietly(kj::PathPtr path);
+  // Removes a file or directory that's no longer referenced, logging rather than throwing if
+  // that fails: the metadata change that unreferenced it has already been made.
+
+  int64_t nowMs();
+
+  SqliteDatabase::Statement stmtGetObject = db->prepare(R"(
+    SELECT version, metadata FROM objects WHERE key = ?
+  )");
+  SqliteDatabase::Statement stmtPutObject = db->prepare(R"(
+    INSERT INTO objects VALUES(?, ?, ?)
+      ON CONFLICT DO UPDATE SET version = excluded.version, metadata = excluded.metadata
+  )");
+  SqliteDatabase::Statement stmtDeleteObject = db->prepare(R"(
+    DELETE FROM objects WHERE key = ?
+  )");
+  SqliteDatabase::Statement stmtListObjects = db->prepare(R"(
+    SELECT key, metadata FROM objects WHERE key >= ? AND key > ? ORDER BY key
+  )");
+  SqliteDatabase::Statement stmtGetUpload = db->prepare(R"(
+    SELECT key, metadata FROM uploads WHERE upload_id = ?
+  )");
+  SqliteDatabase::Statement stmtPutUpload = db->prepare(R"(
+    INSERT INTO uploads VALUES(?, ?, ?)
+  )");
+  SqliteDatabase::Statement stmtDeleteUpload = db->prepare(R"(
+    DELETE FROM uploads WHERE upload_id = ?
+  )");
+  SqliteDatabase::Statement stmtGetPart = db->prepare(R"(
+    SELECT size, etag, md5 FROM parts WHERE upload_id = ? AND part = ?
+  )");
+  SqliteDatabase::Statement stmtPutPart = db->prepare(R"(
+    INSERT INTO parts VALUES(?, ?, ?, ?, ?)
+      ON CONFLICT DO UPDATE SET size = excluded.size, etag = excluded.etag, md5 = excluded.md5
+  )");
+  SqliteDatabase::Statement stmtDeleteParts = db->prepare(R"(
+    DELETE FROM parts WHERE upload_id = ?
+  )");
+};
+
+}  // namespace workerd::server
@@ -14,13 +14,28 @@
 #include <workerd/io/compatibility-date.h>
 #include <workerd/io/io-context.h>
 #include <workerd/io/worker.h>
+#include <workerd/jsg/setup.h>
 #include <time.h>
+#if __linux__
+#include <unistd.h>
+#endif
 #include <openssl/bio.h>
 #include <openssl/pem.h>
+#include <openssl/sha.h>
 #include <workerd/io/actor-cache.h>
 #include <workerd/io/actor-sqlite.h>
 #include <workerd/api/actor-state.h>
 #include "workerd-api.h"
+#include "module-code-cache.h"
+#include "lock-metrics.h"
+#include "actor-metrics.h"
+#include "worker-metrics.h"
+#include "span-exporter.h"
+#include "worker-limits.h"
+#include "http-cache.h"
+#include "kv-cache.h"
+#include "r2-disk.h"
+#include "connection-pool.h"
 #include <stdlib.h>
 
 namespace workerd::server {
@@ -81,33 +96,115 @@ static kj::String httpTime(kj::Date date) {
   return kj::heapString(buf, n);
 }
 
-static kj::Vector<char> escapeJsonString(kj::StringPtr text) {
-  static const char HEXDIGITS[] = "0123456789abcdef";
-  kj::Vector<char> escaped(text.size() + 1);
+static kj::String fileETag(const kj::FsNode::Metadata& meta) {
+  // Returns a strong entity tag derived from the file's size and modification time, in the same
+  // spirit as the tags nginx generates for static files.
+
+  return kj::str('"', kj::hex(meta.size), '-',
+      kj::hex(uint64_t((meta.lastModified - kj::UNIX_EPOCH) / kj::NANOSECONDS)), '"');
+}
+
+static kj::ArrayPtr<const char> trimHttpWhitespace(kj::ArrayPtr<const char> text) {
+  while (text.size() > 0 && (text[0] == ' ' || text[0] == '\t')) {
+    text = text.slice(1, text.size());
+  }
+  while (text.size() > 0 && (text[text.size() - 1] == ' ' || text[text.size() - 1] == '\t')) {
+    text = text.slice(0, text.size() - 1);
+  }
+  return text;
+}
+
+static kj::Maybe<size_t> findHttpChar(kj::ArrayPtr<const char> text, char c) {
+  for (auto i: kj::indices(text)) {
+    if (text[i] == c) return i;
+  }
+  return nullptr;
+}
+
+static bool etagListMatches(kj::StringPtr list, kj::StringPtr etag) {
+  // Returns true if the If-None-Match header value `list` matches `etag`. The header is either
+  // "*" or a comma-separated list of entity tags, which are compared weakly (i.e. ignoring any
+  // "W/" prefix) as the spec requires for If-None-Match.
+
+  kj::ArrayPtr<const char> rest = list;
+  for (;;) {
+    kj::ArrayPtr<const char> item = rest;
+    KJ_IF_MAYBE(comma, findHttpChar(rest, ',')) {
+      item = rest.slice(0, *comma);
+      rest = rest.slice(*comma + 1, rest.size());
+    } else {
+      rest = nullptr;
+    }
+
+    item = trimHttpWhitespace(item);
+    if (item == "*"_kj.asArray()) return true;
+    if (item.size() >= 2 && item[0] == 'W' && item[1] == '/') {
+      item = item.slice(2, item.size());
+    }
+    if (item == etag.asArray()) return true;
 
+    if (rest == nullptr) return false;
+  }
+}
+
+static kj::Maybe<uint64_t> parseHttpDecimal(kj::ArrayPtr<const char> text) {
+  if (text.size() == 0) return nullptr;
+  uint64_t result = 0;
   for (char c: text) {
-    switch (c) {
-      case '\"': escaped.addAll(kj::StringPtr("\\\"")); break;
-      case '\\': escaped.addAll(kj::StringPtr("\\\\")); break;
-      case '\b': escaped.addAll(kj::StringPtr("\\b")); break;
-      case '\f': escaped.addAll(kj::StringPtr("\\f")); break;
-      case '\n': escaped.addAll(kj::StringPtr("\\n")); break;
-      case '\r': escaped.addAll(kj::StringPtr("\\r")); break;
-      case '\t': escaped.addAll(kj::StringPtr("\\t")); break;
-      default:
-        if (static_cast<uint8_t>(c) < 0x20) {
-          escaped.addAll(kj::StringPtr("\\u00"));
-          uint8_t c2 = c;
-          escaped.add(HEXDIGITS[c2 / 16]);
-          escaped.add(HEXDIGITS[c2 % 16]);
-        } else {
-          escaped.add(c);
-        }
-        break;
+    if (c < '0' || c > '9') return nullptr;
+    if (result > (uint64_t(kj::maxValue) - uint64_t(c - '0')) / 10) return nullptr;
+    result = result * 10 + (c - '0');
+  }
+  return result;
+}
+
+struct HttpByteRange {
+  // A request for bytes [start, end) of a file, parsed from a `Range` header.
+
+  uint64_t start = 0;
+  uint64_t end = 0;
+  bool satisfiable = true;
+  // False if the range lies entirely past the end of the file, in which case we respond 416.
+};
+
+static kj::Maybe<HttpByteRange> parseHttpRange(kj::StringPtr value, uint64_t size) {
+  // Parses a `Range` header for a file of the given size. Returns null if the header should be
+  // ignored -- because it's malformed, uses a unit other than bytes, or asks for multiple ranges,
+  // which we don't bother supporting -- in which case the whole file is served as usual.
+
+  if (!value.startsWith("bytes=")) return nullptr;
+  auto spec = trimHttpWhitespace(value.slice(strlen("bytes=")));
+  if (findHttpChar(spec, ',') != nullptr) return nullptr;
+
+  size_t dash = KJ_UNWRAP_OR(findHttpChar(spec, '-'), { return nullptr; });
+  auto first = trimHttpWhitespace(spec.slice(0, dash));
+  auto last = trimHttpWhitespace(spec.slice(dash + 1, spec.size()));
+
+  HttpByteRange result;
+  if (first.size() == 0) {
+    // Suffix range: the last N bytes.
+    uint64_t suffix = KJ_UNWRAP_OR(parseHttpDecimal(last), { return nullptr; });
+    if (suffix == 0 || size == 0) {
+      result.satisfiable = false;
+    } else {
+      result.start = size - kj::min(suffix, size);
+      result.end = size;
     }
+    return result;
   }
 
-  return escaped;
+  result.start = KJ_UNWRAP_OR(parseHttpDecimal(first), { return nullptr; });
+  result.end = size;
+  if (last.size() > 0) {
+    uint64_t lastByte = KJ_UNWRAP_OR(parseHttpDecimal(last), { return nullptr; });
+    if (lastByte < result.start) return nullptr;
+    if (lastByte < size) result.end = lastByte + 1;
+  }
+  if (result.start >= size) {
+    result.satisfiable = false;
+    result.end = result.start;
+  }
+  return result;
 }
 
 class EmptyReadOnlyActorStorageImpl final: public rpc::ActorStorage::Stage::Server {
@@ -166,7 +263,13 @@ Server::Server(kj::Filesystem& fs, kj::Timer& timer, kj::Network& network,
     : fs(fs), timer(timer), network(network), entropySource(entropySource),
       reportConfigError(kj::mv(reportConfigError)), tasks(*this) {}
 
-Server::~Server() noexcept(false) {}
+Server::~Server() noexcept(false) {
+  // Requests that are still winding down may hold references to the exporter, but it must stop
+  // using the services and the timer now.
+  KJ_IF_MAYBE(exporter, spanExporter) {
+    exporter->get()->detach();
+  }
+}
 
 struct Server::GlobalContext {
   jsg::V8System& v8System;
@@ -198,6 +301,15 @@ public:
 
   virtual bool hasHandler(kj::StringPtr handlerName) = 0;
   // Returns true if the service exports the given handler, e.g. `fetch`, `scheduled`, etc.
+
+  virtual bool isOverloaded() { return false; }
+  // Returns true if new requests from sockets should be shed (answered with 503) rather than
+  // started. Only consulted at ingress; subrequests from other services are always started.
+
+  virtual Service& forCaller(kj::StringPtr callerName) { return *this; }
+  // Returns the service that the Worker service named `callerName` should send its subrequests
+  // to. A service that keeps state on behalf of its callers, like a network service's connection
+  // pool, returns a view of itself that keeps that caller's state apart from other callers'.
 };
 
 // =======================================================================================
@@ -309,10 +421,27 @@ public:
     return cfBlobHeader != nullptr;
   }
 
-  bool needsRewriteRequest() {
-    return style == config::HttpOptions::Style::HOST
-        || cfBlobHeader != nullptr
-        || !requestInjector.empty();
+  bool needsRewriteOutgoingRequest(const kj::HttpHeaders& headers,
+                                   kj::Maybe<kj::StringPtr> cfBlobJson) {
+    // Checks whether rewriteOutgoingRequest() would change anything. In particular, a cf-blob
+    // header only needs handling if there's a blob to add or a stale header to remove, so that the
+    // common case of a request with no cf blob can skip copying its headers.
+
+    if (style == config::HttpOptions::Style::HOST || !requestInjector.empty()) return true;
+    KJ_IF_MAYBE(h, cfBlobHeader) {
+      return cfBlobJson != nullptr || headers.get(*h) != nullptr;
+    }
+    return false;
+  }
+
+  bool needsRewriteIncomingRequest(const kj::HttpHeaders& headers) {
+    // Like needsRewriteOutgoingRequest(), for rewriteIncomingRequest().
+
+    if (style == config::HttpOptions::Style::HOST || !requestInjector.empty()) return true;
+    KJ_IF_MAYBE(h, cfBlobHeader) {
+      return headers.get(*h) != nullptr;
+    }
+    return false;
   }
 
   struct Rewritten {
@@ -400,15 +529,30 @@ private:
   class HeaderInjector {
   public:
     HeaderInjector(capnp::List<config::HttpOptions::Header>::Reader headers,
-                  kj::HttpHeaderTable::Builder& headerTableBuilder)
-        : injectedHeaders(KJ_MAP(header, headers) {
-            InjectedHeader result;
-            result.id = headerTableBuilder.add(header.getName());
-            if (header.hasValue()) {
-              result.value = kj::str(header.getValue());
-            }
-            return result;
-          }) {}
+                  kj::HttpHeaderTable::Builder& headerTableBuilder) {
+      // Resolve the configured headers into a flat list of operations up front. If the same
+      // header is listed more than once, only the last entry has any effect, so only that one is
+      // kept.
+      kj::Vector<InjectedHeader> compiled(headers.size());
+      for (auto header: headers) {
+        InjectedHeader op;
+        op.id = headerTableBuilder.add(header.getName());
+        if (header.hasValue()) {
+          op.value = kj::str(header.getValue());
+        }
+
+        bool replaced = false;
+        for (auto& existing: compiled) {
+          if (existing.id == op.id) {
+            existing.value = kj::mv(op.value);
+            replaced = true;
+            break;
+          }
+        }
+        if (!replaced) compiled.add(kj::mv(op));
+      }
+      injectedHeaders = compiled.releaseAsArray();
+    }
 
     bool empty() { return injectedHeaders.size() == 0; }
 
@@ -511,14 +655,14 @@ class Server::ExternalHttpService final: public Service {
 public:
   ExternalHttpService(kj::Own<kj::NetworkAddress> addrParam,
                       kj::Own<HttpRewriter> rewriter, kj::HttpHeaderTable& headerTable,
-                      kj::Timer& timer, kj::EntropySource& entropySource)
+                      kj::Timer& timer, kj::EntropySource& entropySource,
+                      config::ExternalServer::Reader conf,
+                      kj::Maybe<kj::HttpHeaderId> traceparentHeader)
       : addr(kj::mv(addrParam)),
-        inner(kj::newHttpClient(timer, headerTable, *addr, {
-          .entropySource = entropySource,
-          .webSocketCompressionMode = kj::HttpClientSettings::MANUAL_COMPRESSION
-        })),
+        inner(makeClient(timer, headerTable, *addr, entropySource, conf)),
         serviceAdapter(kj::newHttpService(*inner)),
-        rewriter(kj::mv(rewriter)) {}
+        rewriter(kj::mv(rewriter)),
+        traceparentHeader(traceparentHeader) {}
 
   kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
     return kj::heap<WorkerInterfaceImpl>(*this, kj::mv(metadata));
@@ -536,6 +680,30 @@ private:
 
   kj::Own<HttpRewriter> rewriter;
 
+  kj::Maybe<kj::HttpHeaderId> traceparentHeader;
+  // Set if the config has a span exporter, in which case requests carrying a span get a W3C
+  // `traceparent` header naming it.
+
+  static kj::Own<kj::HttpClient> makeClient(
+      kj::Timer& timer, kj::HttpHeaderTable& headerTable, kj::NetworkAddress& addr,
+      kj::EntropySource& entropySource, config::ExternalServer::Reader conf) {
+    kj::HttpClientSettings settings;
+    settings.entropySource = entropySource;
+    settings.webSocketCompressionMode = kj::HttpClientSettings::MANUAL_COMPRESSION;
+    settings.idleTimeout = conf.getIdleTimeoutMs() * kj::MILLISECONDS;
+
+    // The client keeps a pool of idle connections to the server, which it reuses for later
+    // requests until they've been idle for `idleTimeout`.
+    auto client = kj::newHttpClient(timer, headerTable, addr, kj::mv(settings));
+
+    if (conf.getMaxConcurrentRequests() > 0) {
+      auto limited = kj::newConcurrencyLimitingHttpClient(
+          *client, conf.getMaxConcurrentRequests(), [](uint running, uint pending) {});
+      return limited.attach(kj::mv(client));
+    }
+    return client;
+  }
+
   class WorkerInterfaceImpl final: public WorkerInterface, private kj::HttpService::Response {
   public:
     WorkerInterfaceImpl(ExternalHttpService& parent, IoChannelFactory::SubrequestMetadata metadata)
@@ -546,12 +714,25 @@ private:
         kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
       KJ_REQUIRE(wrappedResponse == nullptr, "object should only receive one request");
       wrappedResponse = response;
-      if (parent.rewriter->needsRewriteRequest()) {
-        auto rewrite = parent.rewriter->rewriteOutgoingRequest(url, headers, metadata.cfBlobJson);
+
+      const kj::HttpHeaders* outgoing = &headers;
+      kj::Own<kj::HttpHeaders> tracedHeaders;
+      KJ_IF_MAYBE(id, parent.traceparentHeader) {
+        KJ_IF_MAYBE(traceparent, SpanExporter::getTraceparent(metadata.parentSpan)) {
+          tracedHeaders = kj::heap(headers.cloneShallow());
+          tracedHeaders->set(*id, kj::mv(*traceparent));
+          outgoing = tracedHeaders.get();
+        }
+      }
+
+      if (parent.rewriter->needsRewriteOutgoingRequest(*outgoing, metadata.cfBlobJson)) {
+        auto rewrite = parent.rewriter->rewriteOutgoingRequest(
+            url, *outgoing, metadata.cfBlobJson);
         return parent.serviceAdapter->request(method, url, *rewrite.headers, requestBody, *this)
-            .attach(kj::mv(rewrite));
+            .attach(kj::mv(rewrite), kj::mv(tracedHeaders));
       } else {
-        return parent.serviceAdapter->request(method, url, headers, requestBody, *this);
+        return parent.serviceAdapter->request(method, url, *outgoing, requestBody, *this)
+            .attach(kj::mv(tracedHeaders));
       }
     }
 
@@ -625,6 +806,10 @@ kj::Own<Server::Service> Server::makeExternalService(
     return makeInvalidConfigService();
   }
 
+  auto traceparentHeader = spanExporter.map([](kj::Own<SpanExporter>& exporter) {
+    return exporter->getTraceparentHeader();
+  });
+
   switch (conf.which()) {
     case config::ExternalServer::HTTP: {
       // We have to construct the rewriter upfront before waiting on any promises, since the
@@ -632,7 +817,8 @@ kj::Own<Server::Service> Server::makeExternalService(
       auto rewriter = kj::heap<HttpRewriter>(conf.getHttp(), headerTableBuilder);
       auto addr = kj::heap<PromisedNetworkAddress>(network.parseAddress(addrStr, 80));
       return kj::heap<ExternalHttpService>(
-          kj::mv(addr), kj::mv(rewriter), globalContext->headerTable, timer, entropySource);
+          kj::mv(addr), kj::mv(rewriter), globalContext->headerTable, timer, entropySource,
+          conf, traceparentHeader);
     }
     case config::ExternalServer::HTTPS: {
       auto httpsConf = conf.getHttps();
@@ -644,7 +830,8 @@ kj::Own<Server::Service> Server::makeExternalService(
       auto addr = kj::heap<PromisedNetworkAddress>(
           makeTlsNetworkAddress(httpsConf.getTlsOptions(), addrStr, certificateHost, 443));
       return kj::heap<ExternalHttpService>(
-          kj::mv(addr), kj::mv(rewriter), globalContext->headerTable, timer, entropySource);
+          kj::mv(addr), kj::mv(rewriter), globalContext->headerTable, timer, entropySource,
+          conf, traceparentHeader);
     }
   }
   reportConfigError(kj::str(
@@ -661,14 +848,18 @@ public:
                  kj::Timer& timer, kj::EntropySource& entropySource,
                  kj::Own<kj::Network> networkParam,
                  kj::Maybe<kj::Own<kj::Network>> tlsNetworkParam,
-                 kj::Maybe<kj::SecureNetworkWrapper&> tlsContext)
-      : network(kj::mv(networkParam)), tlsNetwork(kj::mv(tlsNetworkParam)),
+                 kj::Maybe<kj::SecureNetworkWrapper&> tlsContext,
+                 kj::Maybe<kj::Own<ConnectionPool>> pool,
+                 kj::HttpHeaderId hConnectionPool)
+      : headerTable(headerTable),
+        network(kj::mv(networkParam)), tlsNetwork(kj::mv(tlsNetworkParam)),
         inner(kj::newHttpClient(timer, headerTable, *network, tlsNetwork, {
           .entropySource = entropySource,
           .webSocketCompressionMode = kj::HttpClientSettings::MANUAL_COMPRESSION,
           .tlsContext = tlsContext
         })),
-        serviceAdapter(kj::newHttpService(*inner)) {}
+        serviceAdapter(kj::newHttpService(*inner)),
+        pool(kj::mv(pool)), hConnectionPool(hConnectionPool) {}
 
   kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
     return { this, kj::NullDisposer::instance };
@@ -678,11 +869,71 @@ public:
     return handlerName == "fetch"_kj || handlerName == "connect"_kj;
   }
 
+  Service& forCaller(kj::StringPtr callerName) override {
+    if (pool == nullptr) return *this;
+    return *callerScopes.findOrCreate(callerName, [&]() {
+      auto scope = kj::heap<CallerScope>(*this, callerName);
+      kj::StringPtr key = scope->callerName;
+      return decltype(callerScopes)::Entry { key, kj::mv(scope) };
+    });
+  }
+
 private:
+  class CallerScope final: public Service, private WorkerInterface {
+    // The network service as seen by one calling Worker. Its pooled connections are kept apart
+    // from every other caller's, so that no Worker can be handed a session another Worker set up.
+
+  public:
+    CallerScope(NetworkService& parent, kj::StringPtr callerName)
+        : parent(parent), callerName(kj::str(callerName)) {}
+
+    kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
+      return { this, kj::NullDisposer::instance };
+    }
+
+    bool hasHandler(kj::StringPtr handlerName) override {
+      return parent.hasHandler(handlerName);
+    }
+
+    NetworkService& parent;
+    kj::String callerName;
+
+  private:
+    kj::Promise<void> request(
+        kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+        kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+      return parent.request(method, url, headers, requestBody, response);
+    }
+
+    kj::Promise<void> connect(
+        kj::StringPtr host, const kj::HttpHeaders& headers, kj::AsyncIoStream& connection,
+        ConnectResponse& tunnel, kj::HttpConnectSettings settings) override {
+      return parent.connectFrom(callerName, host, headers, connection, tunnel, kj::mv(settings));
+    }
+
+    void prewarm(kj::StringPtr url) override {}
+    kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+      parent.throwUnsupported();
+    }
+    kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+      parent.throwUnsupported();
+    }
+    kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+      parent.throwUnsupported();
+    }
+  };
+
+  kj::HttpHeaderTable& headerTable;
   kj::Own<kj::Network> network;
   kj::Maybe<kj::Own<kj::Network>> tlsNetwork;
   kj::Own<kj::HttpClient> inner;
   kj::Own<kj::HttpService> serviceAdapter;
+  kj::Maybe<kj::Own<ConnectionPool>> pool;
+  kj::HttpHeaderId hConnectionPool;
+  // Set by the sockets API on `connect()`s that opted into pooling.
+
+  kj::HashMap<kj::StringPtr, kj::Own<CallerScope>> callerScopes;
+  // Returned by forCaller(), when pooling is enabled. Keyed by the calling Worker service's name.
 
   kj::Promise<void> request(
       kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
@@ -697,9 +948,61 @@ private:
     // It represents a proxy-less TCP connection, which means we can simply defer the handling of
     // the connection to the service adapter (likely NetworkHttpClient). Its behaviour will be to
     // connect directly to the host over TCP.
+    //
+    // Callers that didn't come through forCaller() aren't identified, so they never get pooled
+    // connections.
     return serviceAdapter->connect(host, headers, connection, tunnel, kj::mv(settings));
   }
 
+  kj::Promise<void> connectFrom(kj::StringPtr callerName,
+      kj::StringPtr host, const kj::HttpHeaders& headers, kj::AsyncIoStream& connection,
+      ConnectResponse& tunnel, kj::HttpConnectSettings settings) {
+    KJ_IF_MAYBE(p, pool) {
+      if (headers.get(hConnectionPool) != nullptr) {
+        auto key = kj::str(callerName, ' ', settings.useTls ? "tls" : "tcp", ' ', host);
+        return connectPooled(**p, kj::mv(key), host, settings.useTls, connection, tunnel);
+      }
+    }
+    return serviceAdapter->connect(host, headers, connection, tunnel, kj::mv(settings));
+  }
+
+  kj::Promise<void> connectPooled(ConnectionPool& pool, kj::String key, kj::StringPtr host,
+      bool useTls, kj::AsyncIoStream& connection, ConnectResponse& tunnel) {
+    // Pooled connections never use STARTTLS (the sockets API doesn't ask for pooling when it's
+    // enabled), so `settings.tlsStarter` can be ignored.
+
+    kj::Own<kj::AsyncIoStream> stream;
+    KJ_IF_MAYBE(s, pool.take(key)) {
+      stream = kj::mv(*s);
+    } else {
+      kj::Maybe<kj::Exception> failure;
+      try {
+        kj::Network* net = network.get();
+        if (useTls) {
+          KJ_IF_MAYBE(t, tlsNetwork) {
+            net = t->get();
+          } else {
+            KJ_FAIL_REQUIRE("this network service doesn't support TLS");
+          }
+        }
+        auto addr = co_await net->parseAddress(host);
+        stream = co_await addr->connect();
+      } catch (...) {
+        failure = kj::getCaughtExceptionAsKj();
+      }
+
+      KJ_IF_MAYBE(e, failure) {
+        KJ_LOG(INFO, "pooled connect() failed", host, *e);
+        tunnel.reject(502, "Bad Gateway", kj::HttpHeaders(headerTable), uint64_t(0));
+        co_return;
+      }
+      pool.configure(*stream);
+    }
+
+    tunnel.accept(200, "OK", kj::HttpHeaders(headerTable));
+    co_await pool.tunnel(kj::mv(key), kj::mv(stream), connection);
+  }
+
   void prewarm(kj::StringPtr url) override {}
   kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
     throwUnsupported();
@@ -716,7 +1019,8 @@ private:
   }
 };
 
-kj::Own<Server::Service> Server::makeNetworkService(config::Network::Reader conf) {
+kj::Own<Server::Service> Server::makeNetworkService(config::Network::Reader conf,
+    kj::HttpHeaderTable::Builder& headerTableBuilder) {
   auto restrictedNetwork = network.restrictPeers(
       KJ_MAP(a, conf.getAllow()) -> kj::StringPtr { return a; },
       KJ_MAP(a, conf.getDeny() ) -> kj::StringPtr { return a; });
@@ -729,8 +1033,19 @@ kj::Own<Server::Service> Server::makeNetworkService(config::Network::Reader conf
     tlsNetwork = ownedTlsContext->wrapNetwork(*restrictedNetwork).attach(kj::mv(ownedTlsContext));
   }
 
+  kj::Maybe<kj::Own<ConnectionPool>> pool;
+  auto poolConf = conf.getConnectionPool();
+  if (poolConf.getMaxIdlePerHost() > 0) {
+    pool = kj::heap<ConnectionPool>(timer, ConnectionPool::Options {
+      .maxIdlePerKey = poolConf.getMaxIdlePerHost(),
+      .idleTimeout = poolConf.getIdleTimeoutMs() * kj::MILLISECONDS,
+      .keepAlive = poolConf.getKeepAlive(),
+    });
+  }
+
   return kj::heap<NetworkService>(globalContext->headerTable, timer, entropySource,
-                                  kj::mv(restrictedNetwork), kj::mv(tlsNetwork), tlsContext);
+                                  kj::mv(restrictedNetwork), kj::mv(tlsNetwork), tlsContext,
+                                  kj::mv(pool), headerTableBuilder.add("CF-Connection-Pool"));
 }
 
 class Server::DiskDirectoryService final: public Service, private WorkerInterface {
@@ -742,13 +1057,30 @@ public:
                        kj::HttpHeaderTable::Builder& headerTableBuilder)
       : writable(*dir), readable(kj::mv(dir)), headerTable(headerTableBuilder.getFutureTable()),
         hLastModified(headerTableBuilder.add("Last-Modified")),
+        hETag(headerTableBuilder.add("ETag")),
+        hAcceptRanges(headerTableBuilder.add("Accept-Ranges")),
+        hContentRange(headerTableBuilder.add("Content-Range")),
+        hIfNoneMatch(headerTableBuilder.add("If-None-Match")),
+        hIfRange(headerTableBuilder.add("If-Range")),
+        hRange(headerTableBuilder.add("Range")),
         allowDotfiles(conf.getAllowDotfiles()) {}
   DiskDirectoryService(config::DiskDirectory::Reader conf,
                        kj::Own<const kj::ReadableDirectory> dir,
                        kj::HttpHeaderTable::Builder& headerTableBuilder)
       : readable(kj::mv(dir)), headerTable(headerTableBuilder.getFutureTable()),
         hLastModified(headerTableBuilder.add("Last-Modified")),
+        hETag(headerTableBuilder.add("ETag")),
+        hAcceptRanges(headerTableBuilder.add("Accept-Ranges")),
+        hContentRange(headerTableBuilder.add("Content-Range")),
+        hIfNoneMatch(headerTableBuilder.add("If-None-Match")),
+        hIfRange(headerTableBuilder.add("If-Range")),
+        hRange(headerTableBuilder.add("Range")),
         allowDotfiles(conf.getAllowDotfiles()) {}
+  ~DiskDirectoryService() noexcept(false) {
+    for (auto& entry: cache) {
+      cacheLru.remove(*entry.value);
+    }
+  }
 
   kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
     return { this, kj::NullDisposer::instance };
@@ -765,8 +1097,98 @@ private:
   kj::Own<const kj::ReadableDirectory> readable;
   kj::HttpHeaderTable& headerTable;
   kj::HttpHeaderId hLastModified;
+  kj::HttpHeaderId hETag;
+  kj::HttpHeaderId hAcceptRanges;
+  kj::HttpHeaderId hContentRange;
+  kj::HttpHeaderId hIfNoneMatch;
+  kj::HttpHeaderId hIfRange;
+  kj::HttpHeaderId hRange;
   bool allowDotfiles;
 
+  static constexpr uint64_t MAX_CACHED_FILE_SIZE = 64 * 1024;
+  static constexpr size_t MAX_CACHE_BYTES = 16 * 1024 * 1024;
+  // Files no larger than MAX_CACHED_FILE_SIZE are kept in memory, up to MAX_CACHE_BYTES in total.
+  // Static assets tend to be dominated by many small, hot files, for which the open() + stat()
+  // we do anyway is cheap but the read is not.
+
+  static constexpr size_t READ_CHUNK_SIZE = 256 * 1024;
+  // Larger files are streamed from disk in chunks of this size.
+
+  struct CachedFile: public kj::Refcounted {
+    kj::String key;
+    // The file's path within the directory.
+
+    kj::Array<const kj::byte> content;
+    kj::Date lastModified;
+    // An entry is only used while the file's size and modification time still match.
+
+    kj::ListLink<CachedFile> link;
+  };
+
+  kj::HashMap<kj::StringPtr, kj::Own<CachedFile>> cache;
+  // Keyed by `CachedFile::key`. Entries are refcounted so that a response which is still being
+  // written keeps its content alive if the entry is evicted in the meantime.
+
+  kj::List<CachedFile, &CachedFile::link> cacheLru;
+  // Least-recently-used first.
+
+  size_t cacheBytes = 0;
+
+  kj::Own<CachedFile> getCachedFile(kj::StringPtr key, const kj::ReadableFile& file,
+                                    const kj::FsNode::Metadata& meta) {
+    KJ_IF_MAYBE(entry, cache.find(key)) {
+      auto& cached = **entry;
+      if (cached.content.size() == meta.size && cached.lastModified == meta.lastModified) {
+        cacheLru.remove(cached);
+        cacheLru.add(cached);
+        return kj::addRef(cached);
+      }
+      evictCachedFile(cached);
+    }
+
+    auto content = kj::heapArray<kj::byte>(meta.size);
+    KJ_REQUIRE(file.read(0, content) == content.size(), "file was truncated while being served");
+
+    while (cacheBytes + content.size() > MAX_CACHE_BYTES && !cacheLru.empty()) {
+      evictCachedFile(cacheLru.front());
+    }
+
+    auto entry = kj::refcounted<CachedFile>();
+    entry->key = kj::str(key);
+    entry->lastModified = meta.lastModified;
+    entry->content = kj::mv(content);
+    cacheBytes += entry->content.size();
+    cacheLru.add(*entry);
+    auto result = kj::addRef(*entry);
+    kj::StringPtr entryKey = entry->key;
+    cache.insert(entryKey, kj::mv(entry));
+    return result;
+  }
+
+  void evictCachedFile(CachedFile& entry) {
+    cacheLru.remove(entry);
+    cacheBytes -= entry.content.size();
+    KJ_ASSERT(cache.erase(entry.key));
+  }
+
+  void invalidateCachedFile(kj::StringPtr key) {
+    KJ_IF_MAYBE(entry, cache.find(key)) {
+      evictCachedFile(**entry);
+    }
+  }
+
+  static kj::Promise<void> sendFileRange(kj::Own<const kj::ReadableFile> file,
+      kj::Own<kj::AsyncOutputStream> out, uint64_t offset, uint64_t size) {
+    auto buffer = kj::heapArray<kj::byte>(kj::min(size, uint64_t(READ_CHUNK_SIZE)));
+    while (size > 0) {
+      auto n = file->read(offset, buffer.slice(0, kj::min(size, uint64_t(buffer.size()))));
+      KJ_REQUIRE(n > 0, "file was truncated while being served");
+      co_await out->write(buffer.begin(), n);
+      offset += n;
+      size -= n;
+    }
+  }
+
   kj::Promise<void> request(
       kj::HttpMethod method, kj::StringPtr urlStr, const kj::HttpHeaders& headers,
       kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
@@ -803,9 +1225,56 @@ private:
 
       switch (meta.type) {
         case kj::FsNode::Type::FILE: {
-          kj::HttpHeaders headers(headerTable);
-          headers.set(kj::HttpHeaderId::CONTENT_TYPE, "application/octet-stream");
-          headers.set(hLastModified, httpTime(meta.lastModified));
+          auto etag = fileETag(meta);
+          auto lastModified = httpTime(meta.lastModified);
+
+          KJ_IF_MAYBE(ifNoneMatch, headers.get(hIfNoneMatch)) {
+            if (etagListMatches(*ifNoneMatch, etag)) {
+              kj::HttpHeaders responseHeaders(headerTable);
+              responseHeaders.set(hETag, kj::mv(etag));
+              response.send(304, "Not Modified", responseHeaders);
+              return kj::READY_NOW;
+            }
+          }
+
+          kj::HttpHeaders responseHeaders(headerTable);
+          responseHeaders.set(kj::HttpHeaderId::CONTENT_TYPE, "application/octet-stream");
+          responseHeaders.set(hLastModified, kj::str(lastModified));
+          responseHeaders.set(hETag, kj::str(etag));
+          responseHeaders.set(hAcceptRanges, "bytes");
+
+          uint statusCode = 200;
+          kj::StringPtr statusText = "OK";
+          uint64_t offset = 0;
+          uint64_t size = meta.size;
+
+          KJ_IF_MAYBE(rangeHeader, headers.get(hRange)) {
+            // A Range request is only honored if If-Range (when present) names the current
+            // version of the file; otherwise the client's partial copy is stale and gets the
+            // whole thing.
+            bool current = true;
+            KJ_IF_MAYBE(ifRange, headers.get(hIfRange)) {
+              current = *ifRange == etag || *ifRange == lastModified;
+            }
+
+            kj::Maybe<HttpByteRange> maybeRange;
+            if (current) maybeRange = parseHttpRange(*rangeHeader, meta.size);
+
+            KJ_IF_MAYBE(range, maybeRange) {
+              if (!range->satisfiable) {
+                kj::HttpHeaders errorHeaders(headerTable);
+                errorHeaders.set(hContentRange, kj::str("bytes */", meta.size));
+                return response.sendError(416, "Range Not Satisfiable", errorHeaders);
+              }
+
+              statusCode = 206;
+              statusText = "Partial Content";
+              offset = range->start;
+              size = range->end - range->start;
+              responseHeaders.set(hContentRange,
+                  kj::str("bytes ", range->start, '-', range->end - 1, '/', meta.size));
+            }
+          }
 
           // We explicitly set the Content-Length header because if we don't, and we were called
           // by a local Worker (without an actual HTTP connection in between), then the Worker
@@ -815,18 +1284,19 @@ private:
           //   if no `Content-Length` header is returned, but the body size is known via the KJ
           //   HTTP API, then the header shoud be filled in automatically. Unclear if this is safe
           //   to change without a compat flag.
-          headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(meta.size));
+          responseHeaders.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(size));
 
-          auto out = response.send(200, "OK", headers, meta.size);
+          auto out = response.send(statusCode, statusText, responseHeaders, size);
 
-          if (method == kj::HttpMethod::HEAD) {
+          if (method == kj::HttpMethod::HEAD || size == 0) {
             return kj::READY_NOW;
+          } else if (meta.size <= MAX_CACHED_FILE_SIZE) {
+            auto cached = getCachedFile(path.toString(), *file, meta);
+            auto content = cached->content.slice(offset, offset + size);
+            return out->write(content.begin(), content.size())
+                .attach(kj::mv(cached), kj::mv(out));
           } else {
-            auto in = kj::heap<kj::FileInputStream>(*file);
-
-            return in->pumpTo(*out, meta.size)
-                .ignoreResult()
-                .attach(kj::mv(in), kj::mv(out), kj::mv(file));
+            return sendFileRange(kj::mv(file), kj::mv(out), offset, size);
           }
         }
         case kj::FsNode::Type::DIRECTORY: {
@@ -887,6 +1357,8 @@ private:
         return response.sendError(403, "Unauthorized", headerTable);
       }
 
+      invalidateCachedFile(path.toString());
+
       auto replacer = w.replaceFile(path,
           kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
       auto stream = kj::heap<kj::FileOutputStream>(replacer->get());
@@ -964,6 +1436,254 @@ kj::Own<Server::Service> Server::makeDiskDirectoryService(
 
 // =======================================================================================
 
+class Server::MetricsService final: public Service, private WorkerInterface {
+  // Service used when the service is configured as a metrics service. Serves the contents of
+  // the server's LockMetrics, ActorCacheMetrics, and WorkerMetrics in the Prometheus text format.
+  //
+  // `GET /cpuprofile?seconds=N&worker=NAME` instead samples the named Worker's isolate for N
+  // seconds (default 10) and responds with the result as a Chrome DevTools `.cpuprofile`. Without
+  // `worker`, every Worker on the thread is sampled over the same window and the response is a
+  // JSON object mapping each Worker's name to its profile.
+
+public:
+  MetricsService(Server& server, const LockMetrics& metrics,
+                 const ActorCacheMetrics& actorCacheMetrics, const WorkerMetrics& workerMetrics,
+                 kj::HttpHeaderTable::Builder& headerTableBuilder)
+      : server(server), metrics(metrics), actorCacheMetrics(actorCacheMetrics),
+        workerMetrics(workerMetrics), headerTable(headerTableBuilder.getFutureTable()) {}
+
+  kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
+    return { this, kj::NullDisposer::instance };
+  }
+
+  bool hasHandler(kj::StringPtr handlerName) override {
+    return handlerName == "fetch"_kj;
+  }
+
+private:
+  Server& server;
+  const LockMetrics& metrics;
+  const ActorCacheMetrics& actorCacheMetrics;
+  const WorkerMetrics& workerMetrics;
+  kj::HttpHeaderTable& headerTable;
+
+  static constexpr uint DEFAULT_CPU_PROFILE_SECONDS = 10;
+  static constexpr uint MAX_CPU_PROFILE_SECONDS = 300;
+  static constexpr auto CPU_PROFILE_SAMPLING_INTERVAL = 1 * kj::MILLISECONDS;
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr urlStr, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+    if (method != kj::HttpMethod::GET && method != kj::HttpMethod::HEAD) {
+      return response.sendError(405, "Method Not Allowed", headerTable);
+    }
+
+    KJ_IF_MAYBE(url, kj::Url::tryParse(urlStr, kj::Url::HTTP_REQUEST)) {
+      if (url->path.size() == 1 && url->path[0] == "cpuprofile"_kj) {
+        return serveCpuProfile(method, *url, response);
+      }
+    }
+
+    auto body = kj::str(metrics.render(), actorCacheMetrics.render(), workerMetrics.render());
+    return sendBody(method, response, "text/plain; version=0.0.4", kj::mv(body));
+  }
+
+  kj::Promise<void> sendBody(kj::HttpMethod method, kj::HttpService::Response& response,
+                             kj::StringPtr contentType, kj::String body) {
+    kj::HttpHeaders responseHeaders(headerTable);
+    responseHeaders.set(kj::HttpHeaderId::CONTENT_TYPE, contentType);
+    responseHeaders.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(body.size()));
+    auto out = response.send(200, "OK", responseHeaders, body.size());
+
+    if (method == kj::HttpMethod::HEAD) {
+      return kj::READY_NOW;
+    } else {
+      auto promise = out->write(body.begin(), body.size());
+      return promise.attach(kj::mv(out), kj::mv(body));
+    }
+  }
+
+  kj::Promise<void> serveCpuProfile(
+      kj::HttpMethod method, const kj::Url& url, kj::HttpService::Response& response);
+  // Defined after WorkerService.
+
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, kj::HttpService::ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    throwUnsupported();
+  }
+  void prewarm(kj::StringPtr url) override {}
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    throwUnsupported();
+  }
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+    throwUnsupported();
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    throwUnsupported();
+  }
+
+  [[noreturn]] void throwUnsupported() {
+    JSG_FAIL_REQUIRE(Error, "Metrics services don't support this event type.");
+  }
+};
+
+kj::Own<Server::Service> Server::makeMetricsService(
+    kj::HttpHeaderTable::Builder& headerTableBuilder) {
+  // startServices() always creates `lockMetrics`, `actorCacheMetrics`, and `workerMetrics` before
+  // constructing services if any metrics service is configured.
+  auto& metrics = *KJ_ASSERT_NONNULL(lockMetrics);
+  auto& actorMetrics = *KJ_ASSERT_NONNULL(actorCacheMetrics);
+  auto& perWorkerMetrics = *KJ_ASSERT_NONNULL(workerMetrics);
+  return kj::heap<MetricsService>(
+      *this, metrics, actorMetrics, perWorkerMetrics, headerTableBuilder);
+}
+
+// =======================================================================================
+
+class Server::MemoryCacheService final: public Service, private WorkerInterface {
+  // Service used when the service is configured as a memory cache. All the logic lives in
+  // HttpCache; this just adapts it to the Service interface.
+
+public:
+  MemoryCacheService(kj::Timer& timer, kj::HttpHeaderTable::Builder& headerTableBuilder,
+                     HttpCache::Options options)
+      : cache(timer, headerTableBuilder, options) {}
+
+  kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
+    return { this, kj::NullDisposer::instance };
+  }
+
+  bool hasHandler(kj::StringPtr handlerName) override {
+    return handlerName == "fetch"_kj;
+  }
+
+private:
+  HttpCache cache;
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+    return cache.request(method, url, headers, requestBody, response);
+  }
+
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, kj::HttpService::ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    throwUnsupported();
+  }
+  void prewarm(kj::StringPtr url) override {}
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    throwUnsupported();
+  }
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+    throwUnsupported();
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    throwUnsupported();
+  }
+
+  [[noreturn]] void throwUnsupported() {
+    JSG_FAIL_REQUIRE(Error, "Memory cache services don't support this event type.");
+  }
+};
+
+kj::Own<Server::Service> Server::makeMemoryCacheService(
+    config::MemoryCache::Reader conf, kj::HttpHeaderTable::Builder& headerTableBuilder) {
+  HttpCache::Options options {
+    .maxTotalSize = size_t(conf.getMaxTotalSizeKib()) * 1024,
+    .maxEntrySize = size_t(conf.getMaxEntrySizeKib()) * 1024,
+  };
+  if (conf.getCollapsedForwardingTimeoutMs() > 0) {
+    options.collapsedForwardingTimeout = conf.getCollapsedForwardingTimeoutMs() * kj::MILLISECONDS;
+  }
+  return kj::heap<MemoryCacheService>(timer, headerTableBuilder, options);
+}
+
+// =======================================================================================
+
+class Server::R2DiskService final: public Service, private WorkerInterface {
+  // Service used when the service is configured as a local disk R2 bucket. All the logic lives in
+  // R2DiskStore; this just adapts it to the Service interface.
+
+public:
+  R2DiskService(kj::Own<const kj::Directory> dir,
+                kj::HttpHeaderTable::Builder& headerTableBuilder)
+      : store(kj::systemPreciseCalendarClock(), kj::mv(dir), headerTableBuilder) {}
+
+  kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
+    return { this, kj::NullDisposer::instance };
+  }
+
+  bool hasHandler(kj::StringPtr handlerName) override {
+    return handlerName == "fetch"_kj;
+  }
+
+private:
+  R2DiskStore store;
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+    return store.request(method, url, headers, requestBody, response);
+  }
+
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, kj::HttpService::ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    throwUnsupported();
+  }
+  void prewarm(kj::StringPtr url) override {}
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    throwUnsupported();
+  }
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+    throwUnsupported();
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    throwUnsupported();
+  }
+
+  [[noreturn]] void throwUnsupported() {
+    JSG_FAIL_REQUIRE(Error, "R2 disk services don't support this event type.");
+  }
+};
+
+kj::Own<Server::Service> Server::makeR2DiskService(
+    kj::StringPtr name, config::R2DiskBucket::Reader conf,
+    kj::HttpHeaderTable::Builder& headerTableBuilder) {
+  kj::StringPtr pathStr = nullptr;
+  kj::String ownPathStr;
+
+  KJ_IF_MAYBE(override, directoryOverrides.findEntry(name)) {
+    pathStr = ownPathStr = kj::mv(override->value);
+    directoryOverrides.erase(*override);
+  } else if (conf.hasPath()) {
+    pathStr = conf.getPath();
+  } else {
+    reportConfigError(kj::str(
+        "R2 bucket \"", name, "\" has no path in the config, so must be specified on the "
+        "command line with `--directory-path`."));
+    return makeInvalidConfigService();
+  }
+
+  auto path = fs.getCurrentPath().evalNative(pathStr);
+  kj::Maybe<kj::Own<Service>> result;
+  KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+    auto dir = fs.getRoot().openSubdir(kj::mv(path),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+    result = kj::heap<R2DiskService>(kj::mv(dir), headerTableBuilder);
+  })) {
+    reportConfigError(kj::str(
+        "Could not open R2 bucket directory \"", pathStr, "\" for service \"", name, "\": ",
+        exception->getDescription()));
+    return makeInvalidConfigService();
+  }
+  return KJ_ASSERT_NONNULL(kj::mv(result));
+}
+
+// =======================================================================================
+
 class Server::InspectorService final: public kj::HttpService, public kj::HttpServerErrorHandler {
   // Implements the interface for the devtools inspector protocol.
   //
@@ -1148,6 +1868,366 @@ kj::Own<Server::InspectorService> Server::makeInspectorService(
 
 // =======================================================================================
 
+class Server::ActorShards final: private kj::HttpService, private kj::HttpServerErrorHandler {
+  // Implements shardActors().
+  //
+  // A request for an actor owned by another shard is forwarded to that shard as an ordinary HTTP
+  // request (or CONNECT), with headers added that name the actor. The owner removes them again
+  // before delivering the request. Connections to a shard only ever come from the other shards
+  // in the same process, so these headers can be trusted.
+  //
+  // Requests made through one stub must reach the actor in the order they were made (E-order),
+  // so each stub forwards its requests through a Link of its own, which sends each one only once
+  // the previous one has been dispatched. Pooled connections could deliver them out of order.
+
+public:
+  class Link;
+  ActorShards(Server& server, uint index, kj::Array<kj::Own<kj::NetworkAddress>> addresses,
+              kj::Own<kj::ConnectionReceiver> incoming)
+      : server(server), index(index), addresses(kj::mv(addresses)),
+        incoming(kj::mv(incoming)) {}
+
+  void start(kj::HttpHeaderTable::Builder& headerTableBuilder) {
+    // Called early in startServices(), while headers can still be registered.
+    headerIds = HeaderIds {
+      .service = headerTableBuilder.add("Workerd-Actor-Service"),
+      .className = headerTableBuilder.add("Workerd-Actor-Class"),
+      .id = headerTableBuilder.add("Workerd-Actor-Id"),
+      .cfBlob = headerTableBuilder.add("Workerd-Actor-Cf-Blob"),
+    };
+
+    headerTable = headerTableBuilder.getFutureTable();
+  }
+
+  bool owns(kj::StringPtr actorId) {
+    return ownerOf(actorId) == index;
+  }
+
+  kj::Own<WorkerInterface> forward(kj::Maybe<kj::Own<Link>>& link, kj::StringPtr serviceName,
+                                   kj::StringPtr className, kj::StringPtr actorId,
+                                   IoChannelFactory::SubrequestMetadata metadata) {
+    // Starts a request to an actor owned by another shard, over `link`, which is created on first
+    // use. Every request made through the same stub must pass the same `link`.
+    if (link == nullptr) {
+      link = kj::refcounted<Link>(*this, *addresses[ownerOf(actorId)]);
+    }
+    return kj::heap<Forwarder>(*this, kj::addRef(*KJ_ASSERT_NONNULL(link)), serviceName,
+                               className, actorId, metadata.cfBlobJson);
+  }
+
+  kj::Promise<void> listen() {
+    // Serves the requests other shards forward to this one, until canceled. Once canceled, other
+    // shards can no longer open connections to this one; their attempts fail rather than hang.
+    auto receiver = kj::mv(KJ_ASSERT_NONNULL(incoming, "listen() already called"));
+    incoming = nullptr;
+    auto promise = acceptLoop(*receiver);
+    return promise.attach(kj::mv(receiver));
+  }
+
+private:
+  Server& server;
+  uint index;
+  kj::Array<kj::Own<kj::NetworkAddress>> addresses;
+  kj::Maybe<kj::Own<kj::ConnectionReceiver>> incoming;
+
+  struct HeaderIds {
+    kj::HttpHeaderId service;
+    kj::HttpHeaderId className;
+    kj::HttpHeaderId id;
+    kj::HttpHeaderId cfBlob;
+  };
+  kj::Maybe<HeaderIds> headerIds;
+
+  kj::Maybe<const kj::HttpHeaderTable&> headerTable;
+  // Set by start().
+
+  uint ownerOf(kj::StringPtr actorId) {
+    return kj::hashCode(actorId) % addresses.size();
+  }
+
+public:
+  class Link final: public kj::Refcounted {
+    // One stub's route to the shard that owns its actor. A request is sent once the previous one
+    // has been dispatched, that is, once its response (or WebSocket upgrade, or CONNECT reply)
+    // has started, or it has failed. By then the owner has delivered it to the actor, so the
+    // next request can't overtake it, but the two responses may stream at the same time.
+    //
+    // Each request in flight has a connection to itself. A connection that completes a request
+    // cleanly is kept for the stub's later requests. WebSocket upgrades and CONNECTs take their
+    // connection over, so they always get a new one, which is never reused.
+
+  public:
+    Link(ActorShards& shards, kj::NetworkAddress& address): shards(shards), address(address) {}
+
+    class Dispatch {
+      // Passed to a request being sent, which calls release() once it's been dispatched.
+      // Destroying it also releases the next request, so a request that fails or is canceled
+      // doesn't hold up the ones after it.
+
+    public:
+      explicit Dispatch(kj::Own<kj::PromiseFulfiller<void>> fulfiller)
+          : fulfiller(kj::mv(fulfiller)) {}
+      ~Dispatch() noexcept(false) { release(); }
+      KJ_DISALLOW_COPY_AND_MOVE(Dispatch);
+
+      void release() {
+        if (fulfiller->isWaiting()) fulfiller->fulfill();
+      }
+
+    private:
+      kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+    };
+
+    kj::Promise<void> send(kj::Function<kj::Promise<void>(kj::HttpService&, Dispatch&)> func,
+                           bool reusable) {
+      auto paf = kj::newPromiseAndFulfiller<void>();
+      auto previous = kj::mv(tail);
+      tail = kj::mv(paf.promise);
+      auto dispatch = kj::heap<Dispatch>(kj::mv(paf.fulfiller));
+
+      return previous.then([this, func = kj::mv(func), reusable, &dispatch = *dispatch]()
+          mutable {
+        kj::Own<Connection> connection;
+        if (reusable && idle.size() > 0) {
+          connection = kj::mv(idle.back());
+          idle.removeLast();
+        } else {
+          connection = connect();
+        }
+        auto promise = func(*connection->service, dispatch);
+        return promise.then([this, reusable, connection = kj::mv(connection)]() mutable {
+          if (reusable) idle.add(kj::mv(connection));
+        });
+      }).attach(kj::mv(dispatch));
+    }
+
+  private:
+    ActorShards& shards;
+    kj::NetworkAddress& address;
+
+    struct Connection {
+      kj::Own<kj::AsyncIoStream> stream;
+      kj::Own<kj::HttpClient> client;
+      kj::Own<kj::HttpService> service;
+    };
+    kj::Vector<kj::Own<Connection>> idle;
+
+    kj::Promise<void> tail = kj::READY_NOW;
+    // Resolves once the most recently sent request has been dispatched.
+
+    kj::Own<Connection> connect() {
+      kj::HttpClientSettings settings;
+      settings.entropySource = shards.server.entropySource;
+      settings.webSocketCompressionMode = kj::HttpClientSettings::MANUAL_COMPRESSION;
+      auto stream = kj::newPromisedStream(address.connect());
+      auto client = kj::newHttpClient(KJ_ASSERT_NONNULL(shards.headerTable), *stream,
+                                      kj::mv(settings));
+      auto service = kj::newHttpService(*client);
+      return kj::heap<Connection>(Connection {
+        kj::mv(stream), kj::mv(client), kj::mv(service) });
+    }
+  };
+
+private:
+  class Forwarder final: public WorkerInterface {
+  public:
+    Forwarder(ActorShards& shards, kj::Own<Link> link, kj::StringPtr serviceName,
+              kj::StringPtr className, kj::StringPtr actorId, kj::Maybe<kj::String>& cfBlobJson)
+        : shards(shards), link(kj::mv(link)), serviceName(serviceName), className(className),
+          // Actor IDs from `idFromName()`-style namespaces and cf blobs may contain characters
+          // that aren't allowed in header values.
+          actorId(kj::encodeUriComponent(actorId)),
+          cfBlobJson(cfBlobJson.map([](kj::String& json) {
+            return kj::encodeUriComponent(json);
+          })) {}
+
+    kj::Promise<void> request(
+        kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+        kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+      auto outgoing = addActorHeaders(headers);
+      // After a WebSocket upgrade, the connection belongs to the WebSocket.
+      bool reusable = !headers.isWebSocket();
+      return link->send([method, url, &outgoing = *outgoing, &requestBody, &response]
+                        (kj::HttpService& owner, Link::Dispatch& dispatch) {
+        auto wrapper = kj::heap<DispatchedResponse>(response, dispatch);
+        return owner.request(method, url, outgoing, requestBody, *wrapper)
+            .attach(kj::mv(wrapper));
+      }, reusable).attach(kj::mv(outgoing));
+    }
+
+    kj::Promise<void> connect(
+        kj::StringPtr host, const kj::HttpHeaders& headers, kj::AsyncIoStream& connection,
+        ConnectResponse& tunnel, kj::HttpConnectSettings settings) override {
+      auto outgoing = addActorHeaders(headers);
+      // After a CONNECT, the connection belongs to the tunnel.
+      return link->send([host, &outgoing = *outgoing, &connection, &tunnel,
+                         settings = kj::mv(settings)]
+                        (kj::HttpService& owner, Link::Dispatch& dispatch) mutable {
+        auto wrapper = kj::heap<DispatchedConnectResponse>(tunnel, dispatch);
+        return owner.connect(host, outgoing, connection, *wrapper, kj::mv(settings))
+            .attach(kj::mv(wrapper));
+      }, false).attach(kj::mv(outgoing));
+    }
+
+    // Alarms and hibernation events are always delivered by the shard that owns the actor, so
+    // only fetch and connect ever need forwarding.
+    void prewarm(kj::StringPtr url) override {}
+    kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+      throwUnsupported();
+    }
+    kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+      throwUnsupported();
+    }
+    kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+      throwUnsupported();
+    }
+
+  private:
+    class DispatchedResponse final: public kj::HttpService::Response {
+      // Lets the Link send the next request once the response has started.
+
+    public:
+      DispatchedResponse(kj::HttpService::Response& inner, Link::Dispatch& dispatch)
+          : inner(inner), dispatch(dispatch) {}
+
+      kj::Own<kj::AsyncOutputStream> send(
+          uint statusCode, kj::StringPtr statusText, const kj::HttpHeaders& headers,
+          kj::Maybe<uint64_t> expectedBodySize = nullptr) override {
+        dispatch.release();
+        return inner.send(statusCode, statusText, headers, expectedBodySize);
+      }
+
+      kj::Own<kj::WebSocket> acceptWebSocket(const kj::HttpHeaders& headers) override {
+        dispatch.release();
+        return inner.acceptWebSocket(headers);
+      }
+
+    private:
+      kj::HttpService::Response& inner;
+      Link::Dispatch& dispatch;
+    };
+
+    class DispatchedConnectResponse final: public ConnectResponse {
+      // Likewise, for a CONNECT.
+
+    public:
+      DispatchedConnectResponse(ConnectResponse& inner, Link::Dispatch& dispatch)
+          : inner(inner), dispatch(dispatch) {}
+
+      void accept(uint statusCode, kj::StringPtr statusText,
+                  const kj::HttpHeaders& headers) override {
+        dispatch.release();
+        inner.accept(statusCode, statusText, headers);
+      }
+
+      kj::Own<kj::AsyncOutputStream> reject(
+          uint statusCode, kj::StringPtr statusText, const kj::HttpHeaders& headers,
+          kj::Maybe<uint64_t> expectedBodySize = nullptr) override {
+        dispatch.release();
+        return inner.reject(statusCode, statusText, headers, expectedBodySize);
+      }
+
+    private:
+      ConnectResponse& inner;
+      Link::Dispatch& dispatch;
+    };
+
+    ActorShards& shards;
+    kj::Own<Link> link;
+    kj::StringPtr serviceName;
+    kj::StringPtr className;
+    kj::String actorId;
+    kj::Maybe<kj::String> cfBlobJson;
+
+    [[noreturn]] void throwUnsupported() {
+      JSG_FAIL_REQUIRE(Error,
+          "This event type can't be delivered to a Durable Object hosted on another thread.");
+    }
+
+    kj::Own<kj::HttpHeaders> addActorHeaders(const kj::HttpHeaders& headers) {
+      auto& ids = KJ_ASSERT_NONNULL(shards.headerIds);
+      auto result = kj::heap(headers.cloneShallow());
+      result->set(ids.service, serviceName);
+      result->set(ids.className, className);
+      result->set(ids.id, actorId);
+      KJ_IF_MAYBE(json, cfBlobJson) {
+        result->set(ids.cfBlob, *json);
+      } else {
+        result->unset(ids.cfBlob);
+      }
+      return result;
+    }
+  };
+
+  kj::Promise<void> acceptLoop(kj::ConnectionReceiver& receiver) {
+    return receiver.accept().then([this, &receiver](kj::Own<kj::AsyncIoStream> stream) {
+      auto conn = kj::heap<ListedHttpServer>(server, server.timer,
+          server.globalContext->headerTable, *this, kj::HttpServerSettings {
+        .errorHandler = *this,
+        .webSocketCompressionMode = kj::HttpServerSettings::MANUAL_COMPRESSION
+      });
+
+      auto promise = kj::evalNow([&]() {
+        return conn->httpServer.listenHttp(kj::mv(stream)).attach(kj::mv(conn));
+      });
+
+      // As in HttpListener, connections run in the server's task set, so that run() waits for
+      // them, but their errors aren't fatal.
+      server.tasks.add(promise.catch_([](kj::Exception&& exception) {
+        KJ_LOG(ERROR, exception);
+      }));
+
+      return acceptLoop(receiver);
+    });
+  }
+
+  kj::Own<WorkerInterface> startLocalRequest(kj::HttpHeaders& headers);
+  // Finds the actor named by a forwarded request's headers, removes those headers, and starts
+  // the request on the actor. Defined after WorkerService.
+
+  // ---------------------------------------------------------------------------
+  // implements kj::HttpService
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+    auto incomingHeaders = kj::heap(headers.cloneShallow());
+    auto worker = startLocalRequest(*incomingHeaders);
+    return worker->request(method, url, *incomingHeaders, requestBody, response)
+        .attach(kj::mv(worker), kj::mv(incomingHeaders));
+  }
+
+  kj::Promise<void> connect(
+      kj::StringPtr host, const kj::HttpHeaders& headers, kj::AsyncIoStream& connection,
+      ConnectResponse& tunnel, kj::HttpConnectSettings settings) override {
+    auto incomingHeaders = kj::heap(headers.cloneShallow());
+    auto worker = startLocalRequest(*incomingHeaders);
+    return worker->connect(host, *incomingHeaders, connection, tunnel, kj::mv(settings))
+        .attach(kj::mv(worker), kj::mv(incomingHeaders));
+  }
+
+  // ---------------------------------------------------------------------------
+  // implements kj::HttpServerErrorHandler
+
+  kj::Promise<void> handleApplicationError(
+      kj::Exception exception, kj::Maybe<kj::HttpService::Response&> response) override {
+    KJ_LOG(ERROR, kj::str("Uncaught exception: ", exception));
+    KJ_IF_MAYBE(r, response) {
+      return r->sendError(500, "Internal Server Error", server.globalContext->headerTable);
+    } else {
+      return kj::READY_NOW;
+    }
+  }
+};
+
+void Server::shardActors(uint index, kj::Array<kj::Own<kj::NetworkAddress>> shards,
+                         kj::Own<kj::ConnectionReceiver> incoming) {
+  KJ_REQUIRE(index < shards.size());
+  actorShards = kj::heap<ActorShards>(*this, index, kj::mv(shards), kj::mv(incoming));
+}
+
+// =======================================================================================
+
 class Server::WorkerService final: public Service, private kj::TaskSet::ErrorHandler,
                                    private IoChannelFactory, private TimerChannel,
                                    private LimitEnforcer {
@@ -1160,20 +2240,50 @@ public:
     kj::Array<kj::Maybe<ActorNamespace&>> actor;  // null = configuration error
     kj::Maybe<Service&> cache;
     kj::Maybe<kj::Own<SqliteDatabase::Vfs>> actorStorage;
+    kj::String actorStoragePragmas;
+    SqliteDatabase::Limits actorStorageLimits;
+    ActorSqlite::Options actorStorageOptions;
+    // Run / applied on each actor database opened in `actorStorage`, to apply the worker's
+    // `localDiskOptions`.
     AlarmScheduler& alarmScheduler;
+    kj::Maybe<ActorCacheMetrics&> actorCacheMetrics;
+    // Null unless the config defines a metrics service.
+    kj::Maybe<const kj::Directory&> spoolDirectory;
+    // See `Worker.spoolDirectory` in workerd.capnp.
+    kj::Maybe<ActorShards&> actorShards;
+    kj::StringPtr serviceName;
+    // Set if the server's actors are sharded (see Server::shardActors()), in which case requests
+    // for this service's actors that another shard owns are forwarded there, naming the service
+    // as `serviceName`.
   };
   using LinkCallback = kj::Function<LinkedIoChannels(WorkerService&)>;
 
+  struct AdmissionLimits {
+    // See `Worker.maxConcurrentRequests` and `Worker.maxQueuedLockWaiters` in workerd.capnp.
+    // Zero means no limit.
+
+    uint maxConcurrentRequests = 0;
+    uint maxQueuedLockWaiters = 0;
+  };
+
   WorkerService(ThreadContext& threadContext, kj::Own<const Worker> worker,
                 kj::Maybe<kj::HashSet<kj::String>> defaultEntrypointHandlers,
                 kj::HashMap<kj::String, kj::HashSet<kj::String>> namedEntrypointsParam,
                 const kj::HashMap<kj::String, ActorConfig>& actorClasses,
-                LinkCallback linkCallback)
+                LinkCallback linkCallback, bool runIdleTasks, AdmissionLimits admissionLimits,
+                kj::Maybe<kj::Own<const WorkerMetrics::WorkerStats>> workerStats,
+                kj::Maybe<kj::Own<SpanExporter>> spanExporter,
+                WorkerIsolateLimitEnforcer& isolateLimitEnforcer)
       : threadContext(threadContext),
         ioChannels(kj::mv(linkCallback)),
         worker(kj::mv(worker)),
         defaultEntrypointHandlers(kj::mv(defaultEntrypointHandlers)),
-        waitUntilTasks(*this) {
+        waitUntilTasks(*this),
+        runIdleTasks(runIdleTasks),
+        admissionLimits(admissionLimits),
+        workerStats(kj::mv(workerStats)),
+        spanExporter(kj::mv(spanExporter)),
+        isolateLimitEnforcer(isolateLimitEnforcer) {
     namedEntrypoints.reserve(namedEntrypointsParam.size());
     for (auto& ep: namedEntrypointsParam) {
       kj::StringPtr epPtr = ep.key;
@@ -1191,6 +2301,8 @@ public:
     return namedEntrypoints.find(name);
   }
 
+  const Worker& getWorker() { return *worker; }
+
   kj::Array<kj::StringPtr> getEntrypointNames() {
     return KJ_MAP(e, namedEntrypoints) -> kj::StringPtr { return e.key; };
   }
@@ -1226,33 +2338,68 @@ public:
     }
   }
 
+  bool isOverloaded() override {
+    if (admissionLimits.maxConcurrentRequests > 0 &&
+        inFlightRequests >= admissionLimits.maxConcurrentRequests) {
+      return true;
+    }
+    if (admissionLimits.maxQueuedLockWaiters > 0 &&
+        worker->getIsolate().getLockWaiterCount() >= admissionLimits.maxQueuedLockWaiters) {
+      return true;
+    }
+    return false;
+  }
+
+  kj::Promise<uint> relieveMemoryPressure() {
+    // Evicts idle actors, then asks V8 to free what it can now rather than when it next gets
+    // around to it. Returns the number of actors evicted.
+    uint evicted = 0;
+    for (auto& ns: actorNamespaces) {
+      evicted += ns.value->evictIdleActors();
+    }
+
+    auto asyncLock = co_await worker->takeAsyncLockWithoutRequest(nullptr);
+    Worker::Lock lock(*worker, asyncLock);
+    lock.getIsolate()->MemoryPressureNotification(v8::MemoryPressureLevel::kCritical);
+    co_return evicted;
+  }
+
   kj::Own<WorkerInterface> startRequest(
       IoChannelFactory::SubrequestMetadata metadata, kj::Maybe<kj::StringPtr> entrypointName,
       kj::Maybe<kj::Own<Worker::Actor>> actor = nullptr) {
+    scheduleIdleTasks();
+    ++inFlightRequests;
+    auto inFlight = kj::defer([this]() { --inFlightRequests; });
+    auto limitEnforcer = isolateLimitEnforcer.newRequestLimitEnforcer()
+        .orDefault(kj::Own<LimitEnforcer>(this, kj::NullDisposer::instance));
     return WorkerEntrypoint::construct(
         threadContext,
         kj::atomicAddRef(*worker),
         entrypointName,
         kj::mv(actor),
-        kj::Own<LimitEnforcer>(this, kj::NullDisposer::instance),
+        kj::mv(limitEnforcer),
         {},                        // ioContextDependency
         kj::Own<IoChannelFactory>(this, kj::NullDisposer::instance),
-        kj::refcounted<RequestObserver>(),  // default observer makes no observations
+        makeRequestObserver(kj::mv(metadata.parentSpan)),
         waitUntilTasks,
         true,                      // tunnelExceptions
         nullptr,                   // workerTracer
-        kj::mv(metadata.cfBlobJson));
+        kj::mv(metadata.cfBlobJson)).attach(kj::mv(inFlight));
   }
 
   class ActorNamespace final: private kj::TaskSet::ErrorHandler {
   public:
     ActorNamespace(WorkerService& service, kj::StringPtr className, const ActorConfig& config)
-        : service(service), className(className), config(config), onBrokenTasks(*this) {}
+        : service(service), className(className), config(config), onBrokenTasks(*this),
+          prewarmTasks(*this) {}
 
     const ActorConfig& getConfig() { return config; }
 
     kj::Own<WorkerInterface> getActor(Worker::Actor::Id id,
-        IoChannelFactory::SubrequestMetadata metadata) {
+        IoChannelFactory::SubrequestMetadata metadata,
+        kj::Maybe<kj::Own<ActorShards::Link>>& link) {
+      // `link` belongs to the stub making the request, and is used if the actor is hosted by
+      // another shard.
       kj::String idStr;
       KJ_SWITCH_ONEOF(id) {
         KJ_CASE_ONEOF(obj, kj::Own<ActorIdFactory::ActorId>) {
@@ -1265,11 +2412,25 @@ public:
         }
       }
 
-      return getActor(kj::mv(idStr), kj::mv(metadata));
+      return getActor(kj::mv(idStr), kj::mv(metadata), link);
     }
 
     kj::Own<WorkerInterface> getActor(kj::String id,
         IoChannelFactory::SubrequestMetadata metadata) {
+      kj::Maybe<kj::Own<ActorShards::Link>> link;
+      return getActor(kj::mv(id), kj::mv(metadata), link);
+    }
+
+    kj::Own<WorkerInterface> getActor(kj::String id,
+        IoChannelFactory::SubrequestMetadata metadata,
+        kj::Maybe<kj::Own<ActorShards::Link>>& link) {
+      auto& channels = KJ_ASSERT_NONNULL(service.ioChannels.tryGet<LinkedIoChannels>());
+      KJ_IF_MAYBE(shards, channels.actorShards) {
+        if (!shards->owns(id)) {
+          return shards->forward(link, channels.serviceName, className, id, kj::mv(metadata));
+        }
+      }
+
       auto promise = getActorImpl(kj::mv(id))
           .then([this, metadata = kj::mv(metadata)](kj::Own<Worker::Actor> actor) mutable {
         return service.startRequest(kj::mv(metadata), className, kj::mv(actor));
@@ -1279,18 +2440,198 @@ public:
     }
 
     kj::Own<IoChannelFactory::ActorChannel> getActorChannel(Worker::Actor::Id id) {
+      KJ_IF_MAYBE(obj, id.tryGet<kj::Own<ActorIdFactory::ActorId>>()) {
+        prewarm((*obj)->toString());
+      }
       return kj::heap<ActorChannelImpl>(*this, kj::mv(id));
     }
 
+    void prewarm(kj::String id) {
+      // If the namespace is configured with `prewarmActors`, starts creating the actor for `id`
+      // and opening its storage, so that they're ready when its first request arrives.
+      uint limit = config.tryGet<Durable>()
+          .map([](const Durable& d) { return d.prewarmActors; }).orDefault(0);
+      if (prewarmedActors >= limit || actors.find(id) != nullptr) return;
+
+      auto& channels = KJ_ASSERT_NONNULL(service.ioChannels.tryGet<LinkedIoChannels>());
+      KJ_IF_MAYBE(shards, channels.actorShards) {
+        if (!shards->owns(id)) return;
+      }
+
+      // Count the actor from now on, so that a burst of new stubs can't exceed the limit while
+      // waiting for the lock. Once the actor exists, its container counts it instead.
+      ++prewarmedActors;
+      prewarmTasks.add(service.worker->takeAsyncLockWithoutRequest(nullptr).then(
+          [this, id = kj::mv(id)](Worker::AsyncLock asyncLock) mutable {
+        // A request may have created the actor while we waited for the lock.
+        if (actors.find(id) != nullptr) return;
+        ensureActor(asyncLock, kj::mv(id)).markPrewarmed();
+      }).attach(kj::defer([this]() { --prewarmedActors; })));
+    }
+
+    uint evictIdleActors() {
+      // Evicts every actor that no request currently holds and that can be recreated without
+      // losing storage. Returns the number of actors evicted.
+      uint count = 0;
+      for (auto& entry: actors) {
+        if (entry.value->evictIfIdle()) ++count;
+      }
+      return count;
+    }
+
   private:
+    static constexpr kj::Duration HIBERNATION_EVICTION_DELAY = 10 * kj::SECONDS;
+    // With deep hibernation enabled, how long an actor holding hibernatable websockets must go
+    // without any requests before we evict it.
+
+    static constexpr kj::Duration PREWARM_EVICTION_DELAY = 30 * kj::SECONDS;
+    // How long an actor created by `prewarm()` waits for its first request before we evict it.
+
+    class ActorContainer final: public RequestTracker::Hooks {
+      // Holds one actor of the namespace. The actor itself may be evicted while its hibernatable
+      // websockets are still connected, in which case the container keeps only the actor's
+      // HibernationManager, which recreates the actor (via Loopback) when the next event arrives.
+    public:
+      ActorContainer(ActorNamespace& ns, kj::StringPtr id, bool deepHibernation, bool canEvict)
+          : ns(ns), id(id), deepHibernation(deepHibernation), canEvict(canEvict),
+            tracker(kj::refcounted<RequestTracker>(*this)) {}
+      ~ActorContainer() noexcept(false) {
+        // The actor may outlive us if a request still holds it, so stop it calling our hooks.
+        tracker->shutdown();
+        unmarkPrewarmed();
+      }
+      KJ_DISALLOW_COPY_AND_MOVE(ActorContainer);
+
+      void active() override {
+        idle = false;
+        unmarkPrewarmed();
+        // Cancels a pending eviction, if any.
+        evictionTask = nullptr;
+      }
+
+      void inactive() override {
+        idle = true;
+        if (!deepHibernation || !canEvict) return;
+        KJ_IF_MAYBE(a, actor) {
+          if ((*a)->getHibernationManager() == nullptr) return;
+          evictionTask = ns.service.threadContext.getUnsafeTimer()
+              .afterDelay(HIBERNATION_EVICTION_DELAY).then([this]() {
+            return ns.service.worker->takeAsyncLockWithoutRequest(nullptr);
+          }).then([this](Worker::AsyncLock asyncLock) {
+            auto& a = *KJ_ASSERT_NONNULL(actor);
+            Worker::Lock lock(*ns.service.worker, asyncLock);
+            KJ_ASSERT_NONNULL(a.getHibernationManager()).hibernateWebSockets(lock);
+          }).then([this]() {
+            // Now that no JS object refers to the sockets, drop everything else: the actor's
+            // IoContext, its ActorCache, and the Worker::Actor itself. This happens outside of the
+            // async lock since ~Actor() takes the isolate lock itself.
+            auto a = kj::mv(KJ_ASSERT_NONNULL(actor));
+            actor = nullptr;
+            onBrokenTask = nullptr;
+            hibernationManager = kj::addRef(KJ_ASSERT_NONNULL(a->getHibernationManager()));
+            a->shutdown(0);
+          }).eagerlyEvaluate([](kj::Exception&& e) {
+            KJ_LOG(ERROR, "failed to evict hibernated actor", e);
+          });
+        }
+      }
+
+      void markPrewarmed() {
+        // Called by `prewarm()` once it has created the actor. Nothing holds the actor yet, so it
+        // is idle, and if no request arrives in time, we evict it rather than let it count towards
+        // `ns.prewarmedActors` forever. The first request cancels the eviction, like any other.
+        prewarmed = true;
+        ++ns.prewarmedActors;
+        idle = true;
+        evictionTask = ns.service.threadContext.getUnsafeTimer()
+            .afterDelay(PREWARM_EVICTION_DELAY).then([this]() {
+          // The actor has never run a request, so it has nothing in storage to lose even if
+          // `canEvict` is false.
+          if (idle && prewarmed) evict();
+        }).eagerlyEvaluate([](kj::Exception&& e) {
+          KJ_LOG(ERROR, "failed to evict prewarmed actor", e);
+        });
+      }
+
+      bool evictIfIdle() {
+        // Drops the actor now if no request holds it and it can be recreated without losing
+        // storage, e.g. to relieve memory pressure. Returns true if the actor was evicted.
+        //
+        // Anything the actor was still doing in the background, such as timers, is canceled.
+        if (!idle || !canEvict) return false;
+        return evict();
+      }
+
+      ActorNamespace& ns;
+      kj::StringPtr id;
+      // Points into the key of `ns.actors`.
+
+      bool deepHibernation;
+      // True if the actor should be evicted once it has hibernated.
+
+      bool canEvict;
+      // True if evicting the actor won't lose storage.
+
+      bool idle = false;
+      // True while no request holds the actor.
+
+      kj::Own<RequestTracker> tracker;
+      // Counts the requests holding this actor. Those obtain their reference from
+      // `Worker::Actor::addRef()`, which is what ties them to the tracker.
+
+      kj::Maybe<kj::Own<Worker::Actor>> actor;
+      // Null if the actor has not been created yet or has been evicted.
+
+      kj::Maybe<kj::Own<Worker::Actor::HibernationManager>> hibernationManager;
+      // Set while the actor is evicted, and handed to the next actor we create.
+
+      bool prewarmed = false;
+      // True if the actor was created by `prewarm()` and hasn't received a request yet, in which
+      // case it counts towards `ns.prewarmedActors`.
+
+      kj::Maybe<kj::Promise<void>> onBrokenTask;
+      kj::Maybe<kj::Promise<void>> evictionTask;
+
+      void unmarkPrewarmed() {
+        if (prewarmed) {
+          prewarmed = false;
+          --ns.prewarmedActors;
+        }
+      }
+
+      bool evict() {
+        KJ_IF_MAYBE(a, actor) {
+          // Dropping an actor that holds hibernatable websockets would disconnect them. (With deep
+          // hibernation enabled, inactive() has already scheduled its eviction.)
+          if ((*a)->getHibernationManager() != nullptr) return false;
+
+          // As above, ~Actor() takes the isolate lock itself.
+          auto own = kj::mv(*a);
+          actor = nullptr;
+          onBrokenTask = nullptr;
+          unmarkPrewarmed();
+          own->shutdown(0);
+          return true;
+        } else {
+          return false;
+        }
+      }
+    };
+
     WorkerService& service;
     kj::StringPtr className;
     const ActorConfig& config;
-    kj::HashMap<kj::String, kj::Own<Worker::Actor>> actors;
+    uint prewarmedActors = 0;
+    // Number of actors that `prewarm()` is creating or has created that haven't received a
+    // request yet.
+
+    kj::HashMap<kj::String, kj::Own<ActorContainer>> actors;
     kj::TaskSet onBrokenTasks;
+    kj::TaskSet prewarmTasks;
 
     void taskFailed(kj::Exception&& exception) override {
-      // Error from `actors.erase()`?
+      // Error from `actors.erase()`, or from creating an actor in `prewarm()`. In the latter case,
+      // the first request to the actor will try again and report the error to the caller.
       KJ_LOG(ERROR, exception);
     }
 
@@ -1324,11 +2665,10 @@ public:
 
       kj::Promise<void> setAlarm(kj::Maybe<kj::Date> newAlarmTime) override {
         KJ_IF_MAYBE(scheduledTime, newAlarmTime) {
-          alarmScheduler.setAlarm(actor, *scheduledTime);
+          return alarmScheduler.setAlarm(actor, *scheduledTime);
         } else {
-          alarmScheduler.deleteAlarm(actor);
+          return alarmScheduler.deleteAlarm(actor);
         }
-        return kj::READY_NOW;
       }
 
       kj::Maybe<kj::Own<void>> armAlarmHandler(kj::Date, bool) override {
@@ -1356,70 +2696,121 @@ public:
       return service.worker->takeAsyncLockWithoutRequest(nullptr).then(
           [this, id = kj::mv(id)]
           (Worker::AsyncLock asyncLock) mutable -> kj::Own<Worker::Actor> {
-        auto actor = kj::addRef(*actors.findOrCreate(id, [&]() mutable {
-          auto& channels = KJ_ASSERT_NONNULL(service.ioChannels.tryGet<LinkedIoChannels>());
-
-          auto makeActorCache =
-              [&](const ActorCache::SharedLru& sharedLru, OutputGate& outputGate,
-                  ActorCache::Hooks& hooks) {
-            return config.tryGet<Durable>()
-                .map([&](const Durable& d) -> kj::Own<ActorCacheInterface> {
-              KJ_IF_MAYBE(as, channels.actorStorage) {
-                auto sqliteHooks = kj::heap<ActorSqliteHooks>(channels.alarmScheduler, ActorKey{
-                  .uniqueKey = d.uniqueKey, .actorId = id
-                });
+        // Use the actor's addRef() so that the request is counted by the container's tracker.
+        return KJ_ASSERT_NONNULL(ensureActor(asyncLock, kj::mv(id)).actor)->addRef();
+      });
+    }
 
-                auto db = kj::heap<SqliteDatabase>(**as,
-                    kj::Path({d.uniqueKey, kj::str(id, ".sqlite")}),
-                    kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
-                return kj::heap<ActorSqlite>(kj::mv(db), outputGate,
-                    []() -> kj::Promise<void> { return kj::READY_NOW; },
-                    *sqliteHooks).attach(kj::mv(sqliteHooks));
-              } else {
-                // Create an ActorCache backed by a fake, empty storage. Elsewhere, we configure
-                // ActorCache never to flush, so this effectively creates in-memory storage.
-                return kj::heap<ActorCache>(
-                    kj::heap<EmptyReadOnlyActorStorageImpl>(), sharedLru, outputGate, hooks);
-              }
-            });
-          };
+    ActorContainer& ensureActor(Worker::AsyncLock& asyncLock, kj::String id) {
+      // Returns the container for `id`, creating the container and/or the actor if necessary.
+      auto& channels = KJ_ASSERT_NONNULL(service.ioChannels.tryGet<LinkedIoChannels>());
+      auto& container = *actors.findOrCreate(id, [&]() {
+        bool deepHibernation = false;
+        bool canEvict = true;
+        KJ_SWITCH_ONEOF(config) {
+          KJ_CASE_ONEOF(d, Durable) {
+            deepHibernation = d.deepHibernation;
+            // Without on-disk storage, the ActorCache *is* the storage, so it must stay.
+            canEvict = channels.actorStorage != nullptr;
+          }
+          KJ_CASE_ONEOF(e, Ephemeral) {
+            deepHibernation = e.deepHibernation;
+          }
+        }
+        auto container = kj::heap<ActorContainer>(*this, id, deepHibernation, canEvict);
+        return kj::HashMap<kj::String, kj::Own<ActorContainer>>::Entry {
+          kj::mv(id), kj::mv(container)
+        };
+      });
 
-          auto makeStorage = [](jsg::Lock& js, const Worker::ApiIsolate& apiIsolate,
-                                ActorCacheInterface& actorCache)
-                            -> jsg::Ref<api::DurableObjectStorage> {
-            return jsg::alloc<api::DurableObjectStorage>(
-                IoContext::current().addObject(actorCache));
-          };
+      if (container.actor == nullptr) {
+        kj::StringPtr id = container.id;
+
+        auto makeActorCache =
+            [&](const ActorCache::SharedLru& sharedLru, OutputGate& outputGate,
+                ActorCache::Hooks& hooks) {
+          return config.tryGet<Durable>()
+              .map([&](const Durable& d) -> kj::Own<ActorCacheInterface> {
+            KJ_IF_MAYBE(as, channels.actorStorage) {
+              auto sqliteHooks = kj::heap<ActorSqliteHooks>(channels.alarmScheduler, ActorKey{
+                .uniqueKey = d.uniqueKey, .actorId = id
+              });
+
+              auto db = kj::heap<SqliteDatabase>(**as,
+                  kj::Path({d.uniqueKey, kj::str(id, ".sqlite")}),
+                  kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+              db->run(channels.actorStoragePragmas);
+              db->setLimits(channels.actorStorageLimits);
+              kj::Function<kj::Promise<void>()> commitCallback =
+                  []() -> kj::Promise<void> { return kj::READY_NOW; };
+              if (channels.actorStorageOptions.groupCommit) {
+                // Nothing replicates our commits, so a commit is complete as soon as SQLite
+                // returns. Consider it in flight for one more turn of the event loop, which is
+                // the window in which other events' writes are grouped into the next commit.
+                commitCallback = []() -> kj::Promise<void> { return kj::evalLater([]() {}); };
+              }
+              return kj::heap<ActorSqlite>(kj::mv(db), outputGate, kj::mv(commitCallback),
+                  *sqliteHooks, channels.actorStorageOptions).attach(kj::mv(sqliteHooks));
+            } else {
+              // Create an ActorCache backed by a fake, empty storage. Elsewhere, we configure
+              // ActorCache never to flush, so this effectively creates in-memory storage.
+              return kj::heap<ActorCache>(
+                  kj::heap<EmptyReadOnlyActorStorageImpl>(), sharedLru, outputGate, hooks);
+            }
+          });
+        };
+
+        uint32_t compressionThreshold = config.tryGet<Durable>()
+            .map([](const Durable& d) { return d.compressValuesLargerThan; }).orDefault(0);
+        bool compactValues = config.tryGet<Durable>()
+            .map([](const Durable& d) { return d.compactValues; }).orDefault(false);
+        auto makeStorage = [compressionThreshold, compactValues](
+                              jsg::Lock& js, const Worker::ApiIsolate& apiIsolate,
+                              ActorCacheInterface& actorCache)
+                          -> jsg::Ref<api::DurableObjectStorage> {
+          return jsg::alloc<api::DurableObjectStorage>(
+              IoContext::current().addObject(actorCache), compressionThreshold, compactValues);
+        };
+
+        TimerChannel& timerChannel = service;
+
+        kj::Own<ActorObserver> observer;
+        KJ_IF_MAYBE(m, channels.actorCacheMetrics) {
+          observer = m->makeActorObserver(className);
+        } else {
+          observer = kj::refcounted<ActorObserver>();
+        }
 
-          TimerChannel& timerChannel = service;
-
-          auto loopback = kj::refcounted<Loopback>(*this, kj::str(id));
-          Worker::Lock lock(*service.worker, asyncLock);
-          // We define this event ID in the internal codebase, but to have WebSocket Hibernation
-          // work for local development we need to pass an event type.
-          static constexpr uint16_t hibernationEventTypeId = 8;
-          auto newActor = kj::refcounted<Worker::Actor>(
-              *service.worker, nullptr, kj::str(id), true, kj::mv(makeActorCache),
-              className, kj::mv(makeStorage), lock, kj::mv(loopback),
-              timerChannel, kj::refcounted<ActorObserver>(), nullptr, hibernationEventTypeId);
-
-          // If the actor becomes broken, remove it from the map, so a new one will be created
-          // next time.
-          onBrokenTasks.add(newActor->onBroken()
-              .catch_([](kj::Exception&&) {})
-              .then([this, id = id.asPtr(), &actor = *newActor]() {
+        auto loopback = kj::refcounted<Loopback>(*this, kj::str(id));
+        Worker::Lock lock(*service.worker, asyncLock);
+        // We define this event ID in the internal codebase, but to have WebSocket Hibernation
+        // work for local development we need to pass an event type.
+        static constexpr uint16_t hibernationEventTypeId = 8;
+        // If we evicted this actor while it was hibernating, the new actor picks up its
+        // websockets.
+        auto manager = kj::mv(container.hibernationManager);
+        container.hibernationManager = nullptr;
+        auto newActor = kj::refcounted<Worker::Actor>(
+            *service.worker, *container.tracker, kj::str(id), true, kj::mv(makeActorCache),
+            className, kj::mv(makeStorage), lock, kj::mv(loopback),
+            timerChannel, kj::mv(observer), kj::mv(manager), hibernationEventTypeId);
+
+        // If the actor becomes broken, remove it from the map, so a new one will be created
+        // next time. The erase is deferred to `onBrokenTasks` since it destroys this promise.
+        container.onBrokenTask = newActor->onBroken()
+            .catch_([](kj::Exception&&) {})
+            .then([this, id]() {
+          onBrokenTasks.add(kj::evalLater([this, id = kj::str(id)]() {
             actors.erase(id);
           }));
+        }).eagerlyEvaluate(nullptr);
 
-          // TODO(sqlite): Now that actors are backed by real disk, we should shut them down after
-          //   a minute of inactivity...
-          return kj::HashMap<kj::String, kj::Own<Worker::Actor>>::Entry {
-            kj::mv(id), kj::mv(newActor)
-          };
-        }));
+        // TODO(sqlite): Now that actors are backed by real disk, we should shut them down after
+        //   a minute of inactivity, not just when they have hibernated...
+        container.actor = kj::mv(newActor);
+      }
 
-        return kj::mv(actor);
-      });
+      return container;
     }
   };
 
@@ -1439,6 +2830,10 @@ private:
       return handlers.contains(handlerName);
     }
 
+    bool isOverloaded() override {
+      return worker.isOverloaded();
+    }
+
   private:
     WorkerService& worker;
     kj::StringPtr entrypoint;
@@ -1456,6 +2851,53 @@ private:
   kj::HashMap<kj::StringPtr, kj::Own<ActorNamespace>> actorNamespaces;
   kj::TaskSet waitUntilTasks;
 
+  bool runIdleTasks;
+  bool idleTasksScheduled = false;
+
+  AdmissionLimits admissionLimits;
+  uint inFlightRequests = 0;
+  // Requests whose WorkerInterface is still alive, i.e. started and not yet fully completed.
+
+  kj::Maybe<kj::Own<const WorkerMetrics::WorkerStats>> workerStats;
+  // Null unless the config defines a metrics service or sets `spanExporter`.
+
+  kj::Maybe<kj::Own<SpanExporter>> spanExporter;
+  // Null unless the config sets `spanExporter`.
+
+  WorkerIsolateLimitEnforcer& isolateLimitEnforcer;
+  // Owned by the worker's isolate. Makes each request's LimitEnforcer.
+
+  kj::Own<RequestObserver> makeRequestObserver(SpanParent parentSpan) {
+    KJ_IF_MAYBE(s, workerStats) {
+      auto span = spanExporter.map([&](kj::Own<SpanExporter>& exporter) {
+        return exporter->makeRequestSpan(worker->getIsolate().getId(), kj::mv(parentSpan));
+      });
+      return s->get()->makeRequestObserver(kj::mv(span));
+    } else {
+      return kj::refcounted<RequestObserver>();  // default observer makes no observations
+    }
+  }
+
+  void scheduleIdleTasks() {
+    // Arrange to run V8 idle tasks (mostly GC) once this thread has nothing else to do. Called at
+    // the start of every request, since requests are what generate garbage; if a run is already
+    // scheduled, it will cover this request too.
+    if (!runIdleTasks || idleTasksScheduled) return;
+    idleTasksScheduled = true;
+
+    waitUntilTasks.add(Worker::AsyncLock::whenThreadIdle().then([this]() {
+      return worker->takeAsyncLockWithoutRequest(nullptr);
+    }).then([this](Worker::AsyncLock asyncLock) {
+      // Clear the flag first, so that requests which arrive while we run schedule another round.
+      idleTasksScheduled = false;
+      Worker::Lock lock(*worker, asyncLock);
+      jsg::IsolateBase::from(lock.getIsolate()).runIdleTasks();
+    }, [this](kj::Exception&& e) {
+      idleTasksScheduled = false;
+      kj::throwFatalException(kj::mv(e));
+    }));
+  }
+
   class ActorChannelImpl final: public IoChannelFactory::ActorChannel {
   public:
     ActorChannelImpl(ActorNamespace& ns, Worker::Actor::Id id)
@@ -1463,12 +2905,14 @@ private:
 
     kj::Own<WorkerInterface> startRequest(
         IoChannelFactory::SubrequestMetadata metadata) override {
-      return ns.getActor(Worker::Actor::cloneId(id), kj::mv(metadata));
+      return ns.getActor(Worker::Actor::cloneId(id), kj::mv(metadata), link);
     }
 
   private:
     ActorNamespace& ns;
     Worker::Actor::Id id;
+    kj::Maybe<kj::Own<ActorShards::Link>> link;
+    // This stub's connection to the shard hosting the actor, if that's another shard.
   };
 
   // ---------------------------------------------------------------------------
@@ -1568,6 +3012,14 @@ private:
     KJ_FAIL_REQUIRE("no logging channels");
   }
 
+  kj::Maybe<kj::Own<const kj::File>> newSpoolFile() override {
+    auto& channels = KJ_REQUIRE_NONNULL(ioChannels.tryGet<LinkedIoChannels>(),
+                                        "link() has not been called");
+    return channels.spoolDirectory.map([](const kj::Directory& dir) {
+      return dir.createTemporary();
+    });
+  }
+
   kj::Own<ActorChannel> getGlobalActor(uint channel, const ActorIdFactory::ActorId& id,
       kj::Maybe<kj::String> locationHint, ActorGetMode mode) override {
     JSG_REQUIRE(mode == ActorGetMode::GET_OR_CREATE, Error,
@@ -1629,8 +3081,43 @@ private:
   kj::Promise<void> onLimitsExceeded() override { return kj::NEVER_DONE; }
   void requireLimitsNotExceeded() override {}
   void reportMetrics(RequestObserver& requestMetrics) override {}
+  void chargeOffThreadCpu(kj::Duration cpuTime) override {}
 };
 
+kj::Own<WorkerInterface> Server::ActorShards::startLocalRequest(kj::HttpHeaders& headers) {
+  auto& ids = KJ_ASSERT_NONNULL(headerIds);
+
+  // Every shard runs the same config, so none of these lookups should fail.
+  auto serviceName = KJ_REQUIRE_NONNULL(headers.get(ids.service),
+      "forwarded actor request doesn't name a service");
+  auto className = KJ_REQUIRE_NONNULL(headers.get(ids.className),
+      "forwarded actor request doesn't name an actor class");
+  kj::String id = kj::decodeUriComponent(KJ_REQUIRE_NONNULL(headers.get(ids.id),
+      "forwarded actor request doesn't name an actor"));
+  KJ_REQUIRE(owns(id), "actor request forwarded to the wrong shard", id);
+
+  auto& service = KJ_REQUIRE_NONNULL(server.services.find(serviceName),
+      "forwarded actor request names an unknown service", serviceName);
+  auto workerService = dynamic_cast<WorkerService*>(service.get());
+  KJ_REQUIRE(workerService != nullptr,
+      "forwarded actor request names a service that isn't a Worker", serviceName);
+  auto& ns = KJ_REQUIRE_NONNULL(workerService->getActorNamespace(className),
+      "forwarded actor request names an unknown actor class", serviceName, className);
+
+  IoChannelFactory::SubrequestMetadata metadata;
+  metadata.cfBlobJson = headers.get(ids.cfBlob).map([](kj::StringPtr json) -> kj::String {
+    return kj::decodeUriComponent(json);
+  });
+
+  auto worker = ns.getActor(kj::mv(id), kj::mv(metadata));
+
+  headers.unset(ids.service);
+  headers.unset(ids.className);
+  headers.unset(ids.id);
+  headers.unset(ids.cfBlob);
+  return worker;
+}
+
 struct FutureSubrequestChannel {
   config::ServiceDesignator::Reader designator;
   kj::String errorContext;
@@ -1648,7 +3135,8 @@ static kj::Maybe<WorkerdApiIsolate::Global> createBinding(
     Worker::ValidationErrorReporter& errorReporter,
     kj::Vector<FutureSubrequestChannel>& subrequestChannels,
     kj::Vector<FutureActorChannel>& actorChannels,
-    kj::HashMap<kj::String, kj::HashMap<kj::String, Server::ActorConfig>>& actorConfigs) {
+    kj::HashMap<kj::String, kj::HashMap<kj::String, Server::ActorConfig>>& actorConfigs,
+    KvReadCache& kvReadCache) {
   // creates binding object or returns null and reports an error
   using Global = WorkerdApiIsolate::Global;
   kj::StringPtr bindingName = binding.getName();
@@ -1658,6 +3146,11 @@ static kj::Maybe<WorkerdApiIsolate::Global> createBinding(
 
   auto errorContext = kj::str("Worker \"", workerName , "\"'s binding \"", bindingName, "\"");
 
+  if (binding.getKvCacheTtlSeconds() > 0 && !binding.isKvNamespace()) {
+    errorReporter.addError(kj::str(
+        errorContext, " sets kvCacheTtlSeconds, but is not a kvNamespace binding."));
+  }
+
   switch (binding.which()) {
     case config::Worker::Binding::UNSPECIFIED:
       errorReporter.addError(kj::str(errorContext, " does not specify any binding value."));
@@ -1846,7 +3339,17 @@ static kj::Maybe<WorkerdApiIsolate::Global> createBinding(
         kj::mv(errorContext)
       });
 
-      return makeGlobal(Global::KvNamespace{.subrequestChannel = channel});
+      kj::Maybe<api::KvCache&> cache;
+      if (binding.getKvCacheTtlSeconds() > 0) {
+        auto designator = binding.getKvNamespace();
+        auto namespaceName = designator.hasEntrypoint()
+            ? kj::str(designator.getName(), ':', designator.getEntrypoint())
+            : kj::str(designator.getName());
+        cache = kvReadCache.getNamespace(namespaceName,
+                                         binding.getKvCacheTtlSeconds() * kj::SECONDS);
+      }
+
+      return makeGlobal(Global::KvNamespace{.subrequestChannel = channel, .cache = cache});
     }
 
     case config::Worker::Binding::R2_BUCKET: {
@@ -1882,7 +3385,7 @@ static kj::Maybe<WorkerdApiIsolate::Global> createBinding(
       kj::Vector<Global> innerGlobals;
       for (const auto& innerBinding: wrapped.getInnerBindings()) {
         KJ_IF_MAYBE(global, createBinding(workerName, conf, innerBinding,
-            errorReporter, subrequestChannels, actorChannels, actorConfigs)) {
+            errorReporter, subrequestChannels, actorChannels, actorConfigs, kvReadCache)) {
           innerGlobals.add(kj::mv(*global));
         } else {
           // we've already communicated the error
@@ -1914,6 +3417,59 @@ static kj::Maybe<WorkerdApiIsolate::Global> createBinding(
 }
 
 
+struct Server::SharedWorkerCode {
+  kj::Own<Worker::Isolate> isolate;
+  WorkerIsolateLimitEnforcer& limitEnforcer;
+  // Owned by `isolate`.
+
+  kj::Maybe<kj::Own<const Worker::Script>> script;
+  // Only for Service Worker syntax. A modular script's module instances belong to the context it
+  // was compiled in, which then becomes its Worker's global scope, so it can't be shared.
+};
+
+static kj::String hashWorkerCode(config::Worker::Reader conf,
+                                 CompatibilityFlags::Reader featureFlags) {
+  // Hashes everything that goes into creating a Worker's isolate and compiling its script -- but
+  // not its bindings -- for `Config.shareIdenticalWorkers`.
+
+  SHA256_CTX ctx;
+  SHA256_Init(&ctx);
+  auto add = [&](kj::ArrayPtr<const kj::byte> bytes) {
+    // Length-prefixed, so that adjacent fields can't run into each other.
+    uint64_t size = bytes.size();
+    SHA256_Update(&ctx, &size, sizeof(size));
+    SHA256_Update(&ctx, bytes.begin(), bytes.size());
+  };
+
+  add(capnp::canonicalize(featureFlags).asBytes());
+  add(capnp::canonicalize(conf.getLimits()).asBytes());
+  switch (conf.which()) {
+    case config::Worker::MODULES:
+      for (auto module: conf.getModules()) {
+        add(capnp::canonicalize(module).asBytes());
+      }
+      break;
+    case config::Worker::SERVICE_WORKER_SCRIPT:
+      add(conf.getServiceWorkerScript().asBytes());
+      // Wasm module bindings are compiled along with a Service Worker script, so they're part of
+      // its code.
+      for (auto binding: conf.getBindings()) {
+        if (binding.isWasmModule()) {
+          add(capnp::canonicalize(binding).asBytes());
+        }
+      }
+      break;
+    case config::Worker::INHERIT:
+      break;
+  }
+  uint16_t which = static_cast<uint16_t>(conf.which());
+  SHA256_Update(&ctx, &which, sizeof(which));
+
+  kj::byte digest[SHA256_DIGEST_LENGTH];
+  SHA256_Final(digest, &ctx);
+  return kj::encodeHex(kj::ArrayPtr<const kj::byte>(digest));
+}
+
 kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::Reader conf,
     capnp::List<config::Extension>::Reader extensions) {
   auto& localActorConfigs = KJ_ASSERT_NONNULL(actorConfigs.find(name));
@@ -1958,68 +3514,89 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
     errorReporter.addError(kj::str("Worker must specify compatibiltyDate."));
   }
 
-  class NullIsolateLimitEnforcer final: public IsolateLimitEnforcer {
-    // IsolateLimitEnforcer that enforces no limits.
-  public:
-    v8::Isolate::CreateParams getCreateParams() override { return {}; }
-    void customizeIsolate(v8::Isolate* isolate) override {}
-    ActorCacheSharedLruOptions getActorCacheLruOptions() override {
-      // TODO(someday): Make this configurable?
-      return {
-        .softLimit = 16 * (1ull << 20), // 16 MiB
-        .hardLimit = 128 * (1ull << 20), // 128 MiB
-        .staleTimeout = 30 * kj::SECONDS,
-        .dirtyListByteLimit = 8 * (1ull << 20), // 8 MiB
-        .maxKeysPerRpc = 128,
-
-        // For now, we use `neverFlush` to implement in-memory-only actors.
-        // See WorkerService::getActor().
-        .neverFlush = true
-      };
-    }
-    kj::Own<void> enterStartupJs(
-        jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const override {
-      return {};
-    }
-    kj::Own<void> enterDynamicImportJs(
-        jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const override {
-      return {};
-    }
-    kj::Own<void> enterLoggingJs(
-        jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const override {
-      return {};
-    }
-    kj::Own<void> enterInspectorJs(
-        jsg::Lock& loc, kj::Maybe<kj::Exception>& error) const override {
-      return {};
-    }
-    void completedRequest(kj::StringPtr id) const override {}
-    bool exitJs(jsg::Lock& lock) const override { return false; }
-    void reportMetrics(IsolateObserver& isolateMetrics) const override {}
-  };
+  kj::Maybe<kj::String> codeHash;
+  kj::Maybe<SharedWorkerCode&> shared;
+  if (shareIdenticalWorkers) {
+    auto& hash = codeHash.emplace(hashWorkerCode(conf, featureFlags.asReader()));
+    shared = sharedWorkerCode.find(hash).map([](kj::Own<SharedWorkerCode>& entry)
+        -> SharedWorkerCode& { return *entry; });
+  }
+
+  kj::Own<Worker::Isolate> isolate;
+  WorkerIsolateLimitEnforcer* limitEnforcerPtr;
+  KJ_IF_MAYBE(s, shared) {
+    isolate = kj::atomicAddRef(*s->isolate);
+    limitEnforcerPtr = &s->limitEnforcer;
+  } else {
+    kj::Own<IsolateObserver> isolateObserver;
+    KJ_IF_MAYBE(metrics, lockMetrics) {
+      isolateObserver = metrics->get()->makeIsolateObserver(name);
+    } else {
+      isolateObserver = kj::atomicRefcounted<IsolateObserver>();
+    }
+
+    auto limitsConf = conf.getLimits();
+    WorkerIsolateLimitEnforcer::Limits limits {
+      .heapLimitMb = limitsConf.getHeapLimitMb(),
+      .cpuLimitMs = limitsConf.getCpuLimitMs(),
+      .bufferingLimitMb = limitsConf.getBufferingLimitMb(),
+    };
+    kj::Maybe<CpuWatchdog&> watchdog;
+    if (limits.cpuLimitMs > 0) {
+      KJ_IF_MAYBE(w, cpuWatchdog) {
+        watchdog = **w;
+      } else {
+        watchdog = *cpuWatchdog.emplace(kj::heap<CpuWatchdog>());
+      }
+    }
+    auto limitEnforcer = kj::heap<WorkerIsolateLimitEnforcer>(limits, watchdog);
+    limitEnforcerPtr = limitEnforcer.get();
+    auto api = kj::heap<WorkerdApiIsolate>(globalContext->v8System,
+        featureFlags.asReader(), *limitEnforcer, *moduleCodeCache);
+    isolate = kj::atomicRefcounted<Worker::Isolate>(
+        kj::mv(api),
+        kj::mv(isolateObserver),
+        name,
+        kj::mv(limitEnforcer),
+        // For workerd, if the inspector is enabled, it is always fully trusted.
+        maybeInspectorService != nullptr ?
+            Worker::Isolate::InspectorPolicy::ALLOW_FULLY_TRUSTED :
+            Worker::Isolate::InspectorPolicy::DISALLOW);
+
+    // If we are using the inspector, we need to register the Worker::Isolate
+    // with the inspector service. A shared isolate is registered once, under the name of the
+    // first service using it, like its metrics.
+    KJ_IF_MAYBE(inspector, maybeInspectorService) {
+      (*inspector)->registerIsolate(name, isolate.get());
+    }
+  }
+  auto& limitEnforcerRef = *limitEnforcerPtr;
+
+  kj::Own<const Worker::Script> script;
+  KJ_IF_MAYBE(s, shared) {
+    KJ_IF_MAYBE(sharedScript, s->script) {
+      script = kj::atomicAddRef(**sharedScript);
+    }
+  }
+  if (script.get() == nullptr) {
+    script = isolate->newScript(
+        name, WorkerdApiIsolate::extractSource(name, conf, errorReporter, extensions),
+        IsolateObserver::StartType::COLD, false, errorReporter);
+  }
 
-  auto limitEnforcer = kj::heap<NullIsolateLimitEnforcer>();
-  auto api = kj::heap<WorkerdApiIsolate>(globalContext->v8System,
-      featureFlags.asReader(), *limitEnforcer);
-  auto isolate = kj::atomicRefcounted<Worker::Isolate>(
-      kj::mv(api),
-      kj::atomicRefcounted<IsolateObserver>(),
-      name,
-      kj::mv(limitEnforcer),
-      // For workerd, if the inspector is enabled, it is always fully trusted.
-      maybeInspectorService != nullptr ?
-          Worker::Isolate::InspectorPolicy::ALLOW_FULLY_TRUSTED :
-          Worker::Isolate::InspectorPolicy::DISALLOW);
-
-  // If we are using the inspector, we need to register the Worker::Isolate
-  // with the inspector service.
-  KJ_IF_MAYBE(inspector, maybeInspectorService) {
-    (*inspector)->registerIsolate(name, isolate.get());
-  }
-
-  auto script = isolate->newScript(
-      name, WorkerdApiIsolate::extractSource(name, conf, errorReporter, extensions),
-      IsolateObserver::StartType::COLD, false, errorReporter);
+  KJ_IF_MAYBE(hash, codeHash) {
+    if (shared == nullptr) {
+      kj::Maybe<kj::Own<const Worker::Script>> sharedScript;
+      if (!script->isModular()) {
+        sharedScript = kj::atomicAddRef(*script);
+      }
+      sharedWorkerCode.insert(kj::mv(*hash), kj::heap<SharedWorkerCode>(SharedWorkerCode {
+        .isolate = kj::atomicAddRef(*isolate),
+        .limitEnforcer = limitEnforcerRef,
+        .script = kj::mv(sharedScript),
+      }));
+    }
+  }
 
   kj::Vector<FutureSubrequestChannel> subrequestChannels;
   kj::Vector<FutureActorChannel> actorChannels;
@@ -2029,14 +3606,30 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
   kj::Vector<Global> globals(confBindings.size());
   for (auto binding: confBindings) {
     KJ_IF_MAYBE(global, createBinding(name, conf, binding, errorReporter,
-                                     subrequestChannels, actorChannels, actorConfigs)) {
+                                     subrequestChannels, actorChannels, actorConfigs,
+                                     *kvReadCache)) {
       globals.add(kj::mv(*global));
     }
   }
 
+  kj::Maybe<kj::Own<const WorkerMetrics::WorkerStats>> workerStats;
+  kj::Own<WorkerObserver> workerObserver;
+  KJ_IF_MAYBE(metrics, workerMetrics) {
+    auto stats = metrics->get()->addWorker(name);
+    workerObserver = stats->makeWorkerObserver();
+    workerStats = kj::mv(stats);
+  } else {
+    workerObserver = kj::atomicRefcounted<WorkerObserver>();
+    if (spanExporter != nullptr) {
+      // The metrics observer is what records each request's span, so the Worker gets stats even
+      // though there's nowhere to report them.
+      workerStats = kj::atomicRefcounted<WorkerMetrics::WorkerStats>(kj::str(name));
+    }
+  }
+
   auto worker = kj::atomicRefcounted<Worker>(
       kj::mv(script),
-      kj::atomicRefcounted<WorkerObserver>(),
+      kj::mv(workerObserver),
       [&](jsg::Lock& lock, const Worker::ApiIsolate& apiIsolate, v8::Local<v8::Object> target) {
         return kj::downcast<const WorkerdApiIsolate>(apiIsolate).compileGlobals(
             lock, globals, target, 1);
@@ -2055,6 +3648,13 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
       [this, name, conf, subrequestChannels = kj::mv(subrequestChannels),
        actorChannels = kj::mv(actorChannels)](WorkerService& workerService) mutable {
     WorkerService::LinkedIoChannels result{.alarmScheduler = *alarmScheduler};
+    KJ_IF_MAYBE(m, actorCacheMetrics) {
+      result.actorCacheMetrics = **m;
+    }
+    KJ_IF_MAYBE(shards, actorShards) {
+      result.actorShards = **shards;
+      result.serviceName = name;
+    }
 
     auto services = kj::heapArrayBuilder<Service*>(subrequestChannels.size() +
               IoContext::SPECIAL_SUBREQUEST_CHANNEL_COUNT);
@@ -2065,11 +3665,12 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
     // Bind both "next" and "null" to the global outbound. (The difference between these is a
     // legacy artifact that no one should be depending on.)
     static_assert(IoContext::SPECIAL_SUBREQUEST_CHANNEL_COUNT == 2);
-    services.add(&globalService);
-    services.add(&globalService);
+    services.add(&globalService.forCaller(name));
+    services.add(&globalService.forCaller(name));
 
     for (auto& channel: subrequestChannels) {
-      services.add(&lookupService(channel.designator, kj::mv(channel.errorContext)));
+      services.add(&lookupService(channel.designator, kj::mv(channel.errorContext))
+          .forCaller(name));
     }
 
     result.subrequest = services.finish();
@@ -2107,6 +3708,34 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
               "to the service \"", diskName, "\", but that service is not a local disk service."));
         } else KJ_IF_MAYBE(dir, diskSvc->getWritable()) {
           result.actorStorage = kj::heap<SqliteDatabase::Vfs>(*dir);
+
+          auto diskOptions = conf.getLocalDiskOptions();
+          kj::StringPtr synchronous = "FULL";
+          switch (diskOptions.getSynchronous()) {
+            case config::Worker::LocalDiskOptions::Synchronous::OFF:
+              synchronous = "OFF";
+              break;
+            case config::Worker::LocalDiskOptions::Synchronous::NORMAL:
+              synchronous = "NORMAL";
+              break;
+            case config::Worker::LocalDiskOptions::Synchronous::FULL:
+              break;
+          }
+          result.actorStoragePragmas = kj::str(
+              "PRAGMA synchronous=", synchronous, ";"
+              "PRAGMA mmap_size=", diskOptions.getMmapSize(), ";");
+
+          if (diskOptions.getMaxPageCount() > 0) {
+            result.actorStorageLimits.maxPageCount = diskOptions.getMaxPageCount();
+          }
+          if (diskOptions.getCacheSizeKib() > 0) {
+            // Negative cache sizes are in KiB.
+            result.actorStorageLimits.cacheSize = -int64_t(diskOptions.getCacheSizeKib());
+          }
+          if (diskOptions.getMaxVmStepsPerQuery() > 0) {
+            result.actorStorageLimits.vmStepLimit = diskOptions.getMaxVmStepsPerQuery();
+          }
+          result.actorStorageOptions.groupCommit = diskOptions.getGroupCommit();
         } else {
           reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
               "to the disk service \"", diskName, "\", but that service is defined read-only."));
@@ -2117,6 +3746,25 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
       }
     }
 
+    if (conf.hasSpoolDirectory()) {
+      kj::StringPtr diskName = conf.getSpoolDirectory();
+      KJ_IF_MAYBE(svc, this->services.find(diskName)) {
+        auto diskSvc = dynamic_cast<DiskDirectoryService*>(svc->get());
+        if (diskSvc == nullptr) {
+          reportConfigError(kj::str("service ", name, ": spoolDirectory refers to the service \"",
+              diskName, "\", but that service is not a local disk service."));
+        } else KJ_IF_MAYBE(dir, diskSvc->getWritable()) {
+          result.spoolDirectory = *dir;
+        } else {
+          reportConfigError(kj::str("service ", name, ": spoolDirectory refers to the disk "
+              "service \"", diskName, "\", but that service is defined read-only."));
+        }
+      } else {
+        reportConfigError(kj::str("service ", name, ": spoolDirectory refers to a service \"",
+            diskName, "\", but no such service is defined."));
+      }
+    }
+
     kj::HashMap<kj::StringPtr, WorkerService::ActorNamespace&> durableNamespacesByUniqueKey;
     for(auto& [className, ns] : workerService.getActorNamespaces()) {
       KJ_IF_MAYBE(config, ns->getConfig().tryGet<Server::Durable>()) {
@@ -2135,7 +3783,102 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
   return kj::heap<WorkerService>(globalContext->threadContext, kj::mv(worker),
                                  kj::mv(errorReporter.defaultEntrypoint),
                                  kj::mv(errorReporter.namedEntrypoints), localActorConfigs,
-                                 kj::mv(linkCallback));
+                                 kj::mv(linkCallback),
+                                 globalContext->v8System.areIdleTasksEnabled(),
+                                 WorkerService::AdmissionLimits {
+                                   .maxConcurrentRequests = conf.getMaxConcurrentRequests(),
+                                   .maxQueuedLockWaiters = conf.getMaxQueuedLockWaiters(),
+                                 },
+                                 kj::mv(workerStats),
+                                 spanExporter.map([](kj::Own<SpanExporter>& exporter) {
+                                   return kj::addRef(*exporter);
+                                 }),
+                                 limitEnforcerRef);
+}
+
+// =======================================================================================
+
+kj::Promise<void> Server::MetricsService::serveCpuProfile(
+    kj::HttpMethod method, const kj::Url& url, kj::HttpService::Response& response) {
+  uint seconds = DEFAULT_CPU_PROFILE_SECONDS;
+  kj::Maybe<kj::StringPtr> workerName;
+  for (auto& param: url.query) {
+    if (param.name == "seconds"_kj) {
+      KJ_IF_MAYBE(n, param.value.tryParseAs<uint>()) {
+        seconds = *n;
+      } else {
+        seconds = 0;  // rejected below
+      }
+    } else if (param.name == "worker"_kj) {
+      workerName = param.value;
+    }
+  }
+  if (seconds == 0 || seconds > MAX_CPU_PROFILE_SECONDS) {
+    co_await response.sendError(400, "Bad Request", headerTable);
+    co_return;
+  }
+
+  struct Target {
+    Target(kj::StringPtr name, kj::Own<const Worker> worker)
+        : name(name), worker(kj::mv(worker)) {}
+    KJ_DISALLOW_COPY_AND_MOVE(Target);
+
+    kj::StringPtr name;
+    kj::Own<const Worker> worker;
+    bool profiling = false;
+
+    ~Target() noexcept(false) {
+      // If the request is canceled before the profile is collected, stop profiling anyway so
+      // that the isolate doesn't keep sampling forever.
+      if (profiling) worker->getIsolate().stopCpuProfiling();
+    }
+  };
+
+  kj::Vector<kj::Own<Target>> targets;
+  for (auto& entry: server.services) {
+    auto service = dynamic_cast<WorkerService*>(entry.value.get());
+    if (service == nullptr) continue;
+    KJ_IF_MAYBE(n, workerName) {
+      if (entry.key != *n) continue;
+    }
+    targets.add(kj::heap<Target>(entry.key, kj::atomicAddRef(service->getWorker())));
+  }
+  if (workerName != nullptr && targets.empty()) {
+    co_await response.sendError(404, "Not Found", headerTable);
+    co_return;
+  }
+
+  for (auto& target: targets) {
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      target->worker->getIsolate().startCpuProfiling(CPU_PROFILE_SAMPLING_INTERVAL);
+    })) {
+      // Most likely another profile of the same isolate is already in progress.
+      co_await response.sendError(409, "Conflict", headerTable);
+      co_return;
+    }
+    target->profiling = true;
+  }
+
+  co_await server.timer.afterDelay(seconds * kj::SECONDS);
+
+  kj::Vector<kj::String> profiles;
+  for (auto& target: targets) {
+    target->profiling = false;
+    profiles.add(target->worker->getIsolate().stopCpuProfiling());
+  }
+
+  kj::String body;
+  if (workerName != nullptr) {
+    body = kj::mv(profiles[0]);
+  } else {
+    kj::Vector<kj::String> fields;
+    for (auto i: kj::indices(targets)) {
+      fields.add(kj::str('"', escapeJsonString(targets[i]->name), "\":", profiles[i]));
+    }
+    body = kj::str('{', kj::strArray(fields, ","), '}');
+  }
+
+  co_await sendBody(method, response, "application/json", kj::mv(body));
 }
 
 // =======================================================================================
@@ -2156,13 +3899,22 @@ kj::Own<Server::Service> Server::makeService(
       return makeExternalService(name, conf.getExternal(), headerTableBuilder);
 
     case config::Service::NETWORK:
-      return makeNetworkService(conf.getNetwork());
+      return makeNetworkService(conf.getNetwork(), headerTableBuilder);
 
     case config::Service::WORKER:
       return makeWorker(name, conf.getWorker(), extensions);
 
     case config::Service::DISK:
       return makeDiskDirectoryService(name, conf.getDisk(), headerTableBuilder);
+
+    case config::Service::METRICS:
+      return makeMetricsService(headerTableBuilder);
+
+    case config::Service::MEMORY_CACHE:
+      return makeMemoryCacheService(conf.getMemoryCache(), headerTableBuilder);
+
+    case config::Service::R2_DISK:
+      return makeR2DiskService(name, conf.getR2Disk(), headerTableBuilder);
   }
 
   reportConfigError(kj::str(
@@ -2214,11 +3966,14 @@ class Server::HttpListener final: public kj::Refcounted {
 public:
   HttpListener(Server& owner, kj::Own<kj::ConnectionReceiver> listener, Service& service,
                kj::StringPtr physicalProtocol, kj::Own<HttpRewriter> rewriter,
-               kj::HttpHeaderTable& headerTable, kj::Timer& timer)
+               kj::HttpHeaderTable& headerTable, kj::Timer& timer, AdmissionOptions admission)
       : owner(owner), listener(kj::mv(listener)), service(service),
         headerTable(headerTable), timer(timer),
         physicalProtocol(physicalProtocol),
-        rewriter(kj::mv(rewriter)) {}
+        rewriter(kj::mv(rewriter)),
+        maxConcurrentRequests(admission.maxConcurrentRequests),
+        retryAfter(kj::str(admission.retryAfterSeconds)),
+        retryAfterHeader(admission.retryAfterHeader) {}
 
   kj::Promise<void> run() {
     return listener->acceptAuthenticated()
@@ -2287,6 +4042,16 @@ private:
   kj::StringPtr physicalProtocol;
   kj::Own<HttpRewriter> rewriter;
 
+  uint maxConcurrentRequests;
+  uint inFlightRequests = 0;
+  kj::String retryAfter;
+  kj::HttpHeaderId retryAfterHeader;
+
+  bool shouldShed() {
+    return (maxConcurrentRequests > 0 && inFlightRequests >= maxConcurrentRequests) ||
+        service.isOverloaded();
+  }
+
   struct Connection final: public kj::HttpService, public kj::HttpServerErrorHandler {
     Connection(HttpListener& parent, kj::Maybe<kj::String> cfBlobJson)
         : parent(parent), cfBlobJson(kj::mv(cfBlobJson)),
@@ -2329,6 +4094,16 @@ private:
     kj::Promise<void> request(
         kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
         kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+      if (parent.shouldShed()) {
+        // Reject without touching the service, so that this stays cheap under overload.
+        kj::HttpHeaders responseHeaders(parent.headerTable);
+        responseHeaders.set(parent.retryAfterHeader, parent.retryAfter);
+        return response.sendError(503, "Service Unavailable", responseHeaders);
+      }
+
+      ++parent.inFlightRequests;
+      auto inFlight = kj::defer([&parent = parent]() { --parent.inFlightRequests; });
+
       IoChannelFactory::SubrequestMetadata metadata;
       metadata.cfBlobJson = cfBlobJson.map([](kj::StringPtr s) { return kj::str(s); });
 
@@ -2338,7 +4113,7 @@ private:
         wrappedResponse = ownResponse = kj::heap<ResponseWrapper>(response, *parent.rewriter);
       }
 
-      if (parent.rewriter->needsRewriteRequest() || cfBlobJson != nullptr) {
+      if (parent.rewriter->needsRewriteIncomingRequest(headers)) {
         auto rewrite = KJ_UNWRAP_OR(
             parent.rewriter->rewriteIncomingRequest(
                 url, parent.physicalProtocol, headers, metadata.cfBlobJson), {
@@ -2346,11 +4121,11 @@ private:
         });
         auto worker = parent.service.startRequest(kj::mv(metadata));
         return worker->request(method, url, *rewrite.headers, requestBody, *wrappedResponse)
-            .attach(kj::mv(rewrite), kj::mv(worker), kj::mv(ownResponse));
+            .attach(kj::mv(rewrite), kj::mv(worker), kj::mv(ownResponse), kj::mv(inFlight));
       } else {
         auto worker = parent.service.startRequest(kj::mv(metadata));
         return worker->request(method, url, headers, requestBody, *wrappedResponse)
-            .attach(kj::mv(worker), kj::mv(ownResponse));
+            .attach(kj::mv(worker), kj::mv(ownResponse), kj::mv(inFlight));
       }
     }
 
@@ -2371,10 +4146,11 @@ private:
 
 kj::Promise<void> Server::listenHttp(
     kj::Own<kj::ConnectionReceiver> listener, Service& service,
-    kj::StringPtr physicalProtocol, kj::Own<HttpRewriter> rewriter) {
+    kj::StringPtr physicalProtocol, kj::Own<HttpRewriter> rewriter,
+    AdmissionOptions admission) {
   auto obj = kj::refcounted<HttpListener>(*this, kj::mv(listener), service,
                                           physicalProtocol, kj::mv(rewriter),
-                                          globalContext->headerTable, timer);
+                                          globalContext->headerTable, timer, admission);
   return obj->run().attach(kj::mv(obj));
 }
 
@@ -2422,6 +4198,63 @@ void Server::startAlarmScheduler(config::Config::Reader config) {
       .attach(kj::mv(vfs));
 }
 
+kj::Maybe<uint64_t> Server::getResidentMemory() {
+#if __linux__
+  // The second field of /proc/self/statm is the resident set size, in pages.
+  KJ_IF_MAYBE(file, fs.getRoot().tryOpenFile(kj::Path({"proc"_kj, "self"_kj, "statm"_kj}))) {
+    auto text = file->get()->readAllText();
+    const char* pos = text.begin();
+    while (*pos != ' ' && *pos != '\0') ++pos;
+    char* end;
+    uint64_t pages = strtoull(pos, &end, 10);
+    if (end != pos) {
+      return pages * sysconf(_SC_PAGESIZE);
+    }
+  }
+#endif
+  return nullptr;
+}
+
+kj::Promise<void> Server::watchMemory(uint64_t limitBytes) {
+  bool overLimit = false;
+  kj::Duration delay = MEMORY_CHECK_INTERVAL;
+  for (;;) {
+    co_await timer.afterDelay(delay);
+
+    auto maybeResident = getResidentMemory();
+    KJ_IF_MAYBE(resident, maybeResident) {
+      if (*resident <= limitBytes) {
+        overLimit = false;
+        delay = MEMORY_CHECK_INTERVAL;
+        continue;
+      }
+
+      // Each round forces a full GC in every isolate, so if memory stays over the limit, back off
+      // rather than collecting every second.
+      delay = kj::min(delay * 2, MAX_MEMORY_CHECK_INTERVAL);
+
+      uint evicted = 0;
+      for (auto& service: services) {
+        if (WorkerService* worker = dynamic_cast<WorkerService*>(service.value.get())) {
+          try {
+            evicted += co_await worker->relieveMemoryPressure();
+          } catch (...) {
+            KJ_LOG(ERROR, "failed to relieve memory pressure", service.key,
+                kj::getCaughtExceptionAsKj());
+          }
+        }
+      }
+
+      if (!overLimit) {
+        // Log once per episode, not on every check.
+        overLimit = true;
+        KJ_LOG(WARNING, "resident memory is above memoryLimitMb; evicted idle Durable Objects",
+            *resident >> 20, limitBytes >> 20, evicted);
+      }
+    }
+  }
+}
+
 void Server::startServices(jsg::V8System& v8System, config::Config::Reader config,
                            kj::HttpHeaderTable::Builder& headerTableBuilder,
                            kj::ForkedPromise<void>& forkedDrainWhen) {
@@ -2448,6 +4281,61 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
     }).exclusiveJoin(forkedDrainWhen.addBranch()));
   }
 
+  // ---------------------------------------------------------------------------
+  // Configure module code cache.
+
+  kj::Maybe<kj::Own<const kj::Directory>> codeCacheDir;
+  if (config.hasModuleCodeCacheDirectory()) {
+    auto pathStr = config.getModuleCodeCacheDirectory();
+    auto path = fs.getCurrentPath().evalNative(pathStr);
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      codeCacheDir = fs.getRoot().openSubdir(kj::mv(path),
+          kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+    })) {
+      reportConfigError(kj::str(
+          "Could not open module code cache directory \"", pathStr, "\": ",
+          exception->getDescription()));
+    }
+  }
+  moduleCodeCache = kj::heap<ModuleCodeCacheImpl>(kj::mv(codeCacheDir));
+
+  shareIdenticalWorkers = config.getShareIdenticalWorkers();
+
+  KJ_IF_MAYBE(shards, actorShards) {
+    (*shards)->start(headerTableBuilder);
+  }
+
+  kvReadCache = kj::heap<KvReadCache>(timer, KvReadCache::Options {
+    // TODO(someday): Make this configurable?
+    .maxTotalSize = 64 * (1ull << 20),  // 64 MiB
+    .maxEntrySize = 1 * (1ull << 20),   // 1 MiB
+    .fillTimeout = 5 * kj::SECONDS,
+  });
+
+  for (auto serviceConf: config.getServices()) {
+    if (serviceConf.isMetrics()) {
+      lockMetrics = kj::heap<LockMetrics>();
+      actorCacheMetrics = kj::heap<ActorCacheMetrics>();
+      workerMetrics = kj::heap<WorkerMetrics>();
+      break;
+    }
+  }
+
+  if (config.hasSpanExporter()) {
+    auto exporterConf = config.getSpanExporter();
+    spanExporter = kj::refcounted<SpanExporter>(timer, entropySource, headerTableBuilder,
+        [this]() {
+          return KJ_ASSERT_NONNULL(spanExportService).startRequest({});
+        },
+        SpanExporter::Options {
+          .url = kj::str(exporterConf.getUrl()),
+          .serviceName = kj::str(exporterConf.getServiceName()),
+          .maxBatchSize = kj::max(exporterConf.getMaxBatchSize(), 1u),
+          .maxQueueSize = exporterConf.getMaxQueueSize(),
+          .flushInterval = exporterConf.getFlushIntervalMs() * kj::MILLISECONDS,
+        });
+  }
+
   // ---------------------------------------------------------------------------
   // Configure services
 
@@ -2460,11 +4348,23 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
       auto workerConf = serviceConf.getWorker();
       bool hadDurable = false;
       for (auto ns: workerConf.getDurableObjectNamespaces()) {
+        if (ns.getDeepHibernation() && !experimental) {
+          reportConfigError(kj::str(
+              "Durable Object class \"", ns.getClassName(), "\" in service \"", name, "\" sets "
+              "deepHibernation, which is an experimental feature which may change or go away in "
+              "the future. You must run workerd with `--experimental` to use this feature."));
+        }
         switch (ns.which()) {
           case config::Worker::DurableObjectNamespace::UNIQUE_KEY:
             hadDurable = true;
             serviceActorConfigs.insert(kj::str(ns.getClassName()),
-                Durable { kj::str(ns.getUniqueKey()) });
+                Durable {
+                  .uniqueKey = kj::str(ns.getUniqueKey()),
+                  .compressValuesLargerThan = ns.getCompressValuesLargerThan(),
+                  .deepHibernation = ns.getDeepHibernation(),
+                  .compactValues = ns.getCompactValues(),
+                  .prewarmActors = ns.getPrewarmActors(),
+                });
             continue;
           case config::Worker::DurableObjectNamespace::EPHEMERAL_LOCAL:
             if (!experimental) {
@@ -2473,7 +4373,10 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
                   "experimental feature which may change or go away in the future. You must run "
                   "workerd with `--experimental` to use this feature."));
             }
-            serviceActorConfigs.insert(kj::str(ns.getClassName()), Ephemeral {});
+            serviceActorConfigs.insert(kj::str(ns.getClassName()),
+                Ephemeral {
+                  .deepHibernation = ns.getDeepHibernation(),
+                });
             continue;
         }
         reportConfigError(kj::str(
@@ -2533,7 +4436,8 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
 
     auto service = kj::heap<NetworkService>(
         globalContext->headerTable, timer, entropySource,
-        kj::mv(publicNetwork), kj::mv(tlsNetwork), *tls).attach(kj::mv(tls));
+        kj::mv(publicNetwork), kj::mv(tlsNetwork), *tls,
+        nullptr, headerTableBuilder.add("CF-Connection-Pool")).attach(kj::mv(tls));
 
     return decltype(services)::Entry {
       kj::str("internet"_kj),
@@ -2541,6 +4445,11 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
     };
   });
 
+  if (config.hasSpanExporter()) {
+    spanExportService = lookupService(config.getSpanExporter().getService(),
+        kj::str("Span exporter"));
+  }
+
   // Start the alarm scheduler before linking services
   startAlarmScheduler(config);
 
@@ -2548,11 +4457,25 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
   for (auto& service: services) {
     service.value->link();
   }
+
+  if (config.getMemoryLimitMb() > 0) {
+#if __linux__
+    tasks.add(watchMemory(uint64_t(config.getMemoryLimitMb()) << 20));
+#else
+    reportConfigError(kj::str("memoryLimitMb is only supported on Linux."));
+#endif
+  }
 }
 
 kj::Promise<void> Server::listenOnSockets(config::Config::Reader config,
                                           kj::HttpHeaderTable::Builder& headerTableBuilder,
                                           kj::ForkedPromise<void>& forkedDrainWhen) {
+  KJ_IF_MAYBE(shards, actorShards) {
+    // Accept the requests other shards forward to our actors. Like the sockets, this stops once
+    // we start draining.
+    tasks.add((*shards)->listen().exclusiveJoin(forkedDrainWhen.addBranch()));
+  }
+
   // ---------------------------------------------------------------------------
   // Start sockets
 
@@ -2620,6 +4543,12 @@ kj::Promise<void> Server::listenOnSockets(config::Config::Reader config,
       });
     }
 
+    if (listenerHook != nullptr) {
+      listener = listener.then([this, name](kj::Own<kj::ConnectionReceiver> port) {
+        return KJ_ASSERT_NONNULL(listenerHook)(name, kj::mv(port));
+      });
+    }
+
     KJ_IF_MAYBE(t, tls) {
       listener = listener.then([tls = kj::mv(*t)](kj::Own<kj::ConnectionReceiver> port) mutable {
         return tls->wrapPort(kj::mv(port)).attach(kj::mv(tls));
@@ -2629,9 +4558,14 @@ kj::Promise<void> Server::listenOnSockets(config::Config::Reader config,
     // Need to create rewriter before waiting on anything since `headerTableBuilder` will no longer
     // be available later.
     auto rewriter = kj::heap<HttpRewriter>(httpOptions, headerTableBuilder);
+    AdmissionOptions admission {
+      .maxConcurrentRequests = sock.getMaxConcurrentRequests(),
+      .retryAfterSeconds = sock.getRetryAfterSeconds(),
+      .retryAfterHeader = headerTableBuilder.add("Retry-After"),
+    };
 
     tasks.add(listener
-        .then([this, &service, rewriter = kj::mv(rewriter), physicalProtocol, name]
+        .then([this, &service, rewriter = kj::mv(rewriter), physicalProtocol, name, admission]
               (kj::Own<kj::ConnectionReceiver> listener) mutable {
       KJ_IF_MAYBE(stream, controlOverride) {
         auto message = kj::str("{\"event\":\"listen\",\"socket\":\"", name, "\",\"port\":", listener->getPort(), "}\n");
@@ -2641,7 +4575,8 @@ kj::Promise<void> Server::listenOnSockets(config::Config::Reader config,
           KJ_LOG(ERROR, e);
         }
       }
-      return listenHttp(kj::mv(listener), service, physicalProtocol, kj::mv(rewriter));
+      return listenHttp(kj::mv(listener), service, physicalProtocol, kj::mv(rewriter),
+                        admission);
     }).exclusiveJoin(forkedDrainWhen.addBranch()));
   }
 
@@ -23,6 +23,14 @@ namespace workerd::jsg {
 
 namespace workerd::server {
 
+class ModuleCodeCacheImpl;
+class LockMetrics;
+class ActorCacheMetrics;
+class WorkerMetrics;
+class SpanExporter;
+class CpuWatchdog;
+class KvReadCache;
+
 class Server: private kj::TaskSet::ErrorHandler {
   // Implements the single-tenant Workers Runtime server / CLI.
   //
@@ -57,6 +65,24 @@ public:
     controlOverride = kj::heap<kj::FdOutputStream>(fd);
   }
 
+  using ListenerHook = kj::Own<kj::ConnectionReceiver>(
+      kj::StringPtr socketName, kj::Own<kj::ConnectionReceiver> listener);
+  void setListenerHook(kj::Function<ListenerHook> hook) {
+    listenerHook = kj::mv(hook);
+  }
+  // Intercepts each socket's listener as soon as it is bound (before TLS is applied, if any). The
+  // hook returns the receiver from which the server will actually accept connections. workerd
+  // uses this to share listeners between the event loops of multiple threads.
+
+  void shardActors(uint index, kj::Array<kj::Own<kj::NetworkAddress>> shards,
+                   kj::Own<kj::ConnectionReceiver> incoming);
+  // Makes this server one of `shards.size()` servers running the same config which split the
+  // actors of every Durable Object namespace between them, by hashing the actor ID. This server
+  // is shard number `index`: it only hosts the actors that hash to `index`, and forwards requests
+  // for any other actor to its owner over a connection to `shards[owner]`. `incoming` delivers
+  // the connections that the other shards open to this one. workerd uses this to spread actors
+  // across the event loops of multiple threads, while each actor stays on one thread.
+
   kj::Promise<void> run(jsg::V8System& v8System, config::Config::Reader conf,
                         kj::Promise<void> drainWhen = kj::NEVER_DONE);
   // Runs the server using the given config.
@@ -70,8 +96,16 @@ public:
   //
   // The returned promise resolves true if at least one test ran and no tests failed.
 
-  struct Durable { kj::String uniqueKey; };
-  struct Ephemeral {};
+  struct Durable {
+    kj::String uniqueKey;
+    uint32_t compressValuesLargerThan = 0;
+    bool deepHibernation = false;
+    bool compactValues = false;
+    uint32_t prewarmActors = 0;
+  };
+  struct Ephemeral {
+    bool deepHibernation = false;
+  };
   using ActorConfig = kj::OneOf<Durable, Ephemeral>;
 
 private:
@@ -93,6 +127,7 @@ private:
 
   kj::Maybe<kj::String> inspectorOverride;
   kj::Maybe<kj::Own<kj::FdOutputStream>> controlOverride;
+  kj::Maybe<kj::Function<ListenerHook>> listenerHook;
 
   struct GlobalContext;
   kj::Own<GlobalContext> globalContext;
@@ -106,6 +141,43 @@ private:
   // This needs to be populated in advance of constructing any services, in order to be able to
   // correctly construct dependent services.
 
+  kj::Maybe<kj::Own<LockMetrics>> lockMetrics;
+  // Collects isolate lock timing for all workers. Only initialized in startServices() if the
+  // config defines a `metrics` service, since otherwise nobody could read the data.
+
+  kj::Maybe<kj::Own<ActorCacheMetrics>> actorCacheMetrics;
+  // Collects Durable Object storage cache statistics, per class. Initialized alongside
+  // `lockMetrics`.
+
+  kj::Maybe<kj::Own<WorkerMetrics>> workerMetrics;
+  // Collects request and startup statistics, per worker. Initialized alongside `lockMetrics`.
+
+  kj::Maybe<kj::Own<SpanExporter>> spanExporter;
+  // Initialized in startServices() if the config sets `spanExporter`.
+
+  kj::Maybe<Service&> spanExportService;
+  // The service `spanExporter` sends batches to. Looked up once all services are built.
+
+  kj::Own<KvReadCache> kvReadCache;
+  // Backs `kvNamespace` bindings that set `kvCacheTtlSeconds`. Initialized in startServices().
+  // Declared before `services` so that it outlives every worker.
+
+  kj::Maybe<kj::Own<CpuWatchdog>> cpuWatchdog;
+  // Created by the first worker that has a CPU limit. Declared before `services` so that it
+  // outlives every worker.
+
+  bool shareIdenticalWorkers = false;
+  struct SharedWorkerCode;
+  kj::HashMap<kj::String, kj::Own<SharedWorkerCode>> sharedWorkerCode;
+  // With `Config.shareIdenticalWorkers`, the isolate (and, for Service Worker syntax, the script)
+  // built for each distinct Worker code, keyed by a hash of that code. Declared before `services`
+  // so that the entries are released after every worker using them.
+
+  class ActorShards;
+  kj::Maybe<kj::Own<ActorShards>> actorShards;
+  // Set by shardActors(). Declared before `services` since workers hold requests forwarded
+  // through it.
+
   kj::HashMap<kj::String, kj::Own<Service>> services;
 
   kj::Own<kj::PromiseFulfiller<void>> fatalFulfiller;
@@ -113,6 +185,10 @@ private:
   kj::Own<AlarmScheduler> alarmScheduler;
   // Initialized in startAlarmScheduler().
 
+  kj::Own<ModuleCodeCacheImpl> moduleCodeCache;
+  // Shared by all workers so that identical modules are compiled once. Initialized in
+  // startServices().
+
   struct ListedHttpServer {
     // An HttpServer object maintained in a linked list.
 
@@ -150,10 +226,17 @@ private:
   kj::Own<Service> makeExternalService(
       kj::StringPtr name, config::ExternalServer::Reader conf,
       kj::HttpHeaderTable::Builder& headerTableBuilder);
-  kj::Own<Service> makeNetworkService(config::Network::Reader conf);
+  kj::Own<Service> makeNetworkService(config::Network::Reader conf,
+                                      kj::HttpHeaderTable::Builder& headerTableBuilder);
   kj::Own<Service> makeDiskDirectoryService(
       kj::StringPtr name, config::DiskDirectory::Reader conf,
       kj::HttpHeaderTable::Builder& headerTableBuilder);
+  kj::Own<Service> makeMetricsService(kj::HttpHeaderTable::Builder& headerTableBuilder);
+  kj::Own<Service> makeMemoryCacheService(config::MemoryCache::Reader conf,
+      kj::HttpHeaderTable::Builder& headerTableBuilder);
+  kj::Own<Service> makeR2DiskService(
+      kj::StringPtr name, config::R2DiskBucket::Reader conf,
+      kj::HttpHeaderTable::Builder& headerTableBuilder);
   kj::Own<Service> makeWorker(kj::StringPtr name, config::Worker::Reader conf,
       capnp::List<config::Extension>::Reader extensions);
   kj::Own<Service> makeService(
@@ -164,13 +247,25 @@ private:
   Service& lookupService(config::ServiceDesignator::Reader designator, kj::String errorContext);
   // Can only be called in the link stage.
 
+  struct AdmissionOptions {
+    // Load-shedding settings for a socket. See `Socket` in workerd.capnp.
+
+    uint maxConcurrentRequests = 0;
+    uint retryAfterSeconds = 1;
+    kj::HttpHeaderId retryAfterHeader;
+  };
+
   kj::Promise<void> listenHttp(kj::Own<kj::ConnectionReceiver> listener, Service& service,
-                               kj::StringPtr physicalProtocol, kj::Own<HttpRewriter> rewriter);
+                               kj::StringPtr physicalProtocol, kj::Own<HttpRewriter> rewriter,
+                               AdmissionOptions admission);
 
   class InvalidConfigService;
   class ExternalHttpService;
   class NetworkService;
   class DiskDirectoryService;
+  class MetricsService;
+  class MemoryCacheService;
+  class R2DiskService;
   class WorkerService;
   class WorkerEntrypointService;
   class HttpListener;
@@ -187,6 +282,18 @@ private:
   void startAlarmScheduler(config::Config::Reader config);
   // Must be called after startServices!
 
+  static constexpr kj::Duration MEMORY_CHECK_INTERVAL = 1 * kj::SECONDS;
+  static constexpr kj::Duration MAX_MEMORY_CHECK_INTERVAL = 1 * kj::MINUTES;
+
+  kj::Promise<void> watchMemory(uint64_t limitBytes);
+  // Checks the process's resident memory every MEMORY_CHECK_INTERVAL, and while it exceeds
+  // `limitBytes`, evicts idle Durable Objects and tells V8 to free memory. While memory stays
+  // over the limit, the interval doubles after each round, up to MAX_MEMORY_CHECK_INTERVAL. See
+  // `Config.memoryLimitMb` in workerd.capnp.
+
+  kj::Maybe<uint64_t> getResidentMemory();
+  // Null if the platform doesn't tell us.
+
   kj::Promise<void> listenOnSockets(config::Config::Reader config,
                                     kj::HttpHeaderTable::Builder& headerTableBuilder,
                                     kj::ForkedPromise<void>& forkedDrainWhen);
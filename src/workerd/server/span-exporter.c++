@@ -0,0 +1,420 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "span-exporter.h"
+#include <kj/debug.h>
+#include <kj/time.h>
+#include <cmath>
+
+namespace workerd::server {
+
+kj::Vector<char> escapeJsonString(kj::StringPtr text) {
+  static const char HEXDIGITS[] = "0123456789abcdef";
+  kj::Vector<char> escaped(text.size() + 1);
+
+  for (char c: text) {
+    switch (c) {
+      case '\"': escaped.addAll(kj::StringPtr("\\\"")); break;
+      case '\\': escaped.addAll(kj::StringPtr("\\\\")); break;
+      case '\b': escaped.addAll(kj::StringPtr("\\b")); break;
+      case '\f': escaped.addAll(kj::StringPtr("\\f")); break;
+      case '\n': escaped.addAll(kj::StringPtr("\\n")); break;
+      case '\r': escaped.addAll(kj::StringPtr("\\r")); break;
+      case '\t': escaped.addAll(kj::StringPtr("\\t")); break;
+      default:
+        if (static_cast<uint8_t>(c) < 0x20) {
+          escaped.addAll(kj::StringPtr("\\u00"));
+          uint8_t c2 = c;
+          escaped.add(HEXDIGITS[c2 / 16]);
+          escaped.add(HEXDIGITS[c2 % 16]);
+        } else {
+          escaped.add(c);
+        }
+        break;
+    }
+  }
+
+  return escaped;
+}
+
+namespace {
+
+// OTLP `SpanKind` values.
+constexpr uint SPAN_KIND_INTERNAL = 1;
+constexpr uint SPAN_KIND_SERVER = 2;
+
+kj::String toHex(uint64_t value) {
+  // Zero-padded, unlike kj::hex().
+  static const char HEXDIGITS[] = "0123456789abcdef";
+  auto result = kj::heapString(16);
+  for (int i = 15; i >= 0; i--) {
+    result[i] = HEXDIGITS[value & 0xf];
+    value >>= 4;
+  }
+  return result;
+}
+
+kj::Maybe<uint64_t> parseHex(kj::ArrayPtr<const char> text) {
+  // Parses exactly 16 lowercase hex digits, as required by the W3C trace context spec.
+  if (text.size() != 16) return nullptr;
+  uint64_t result = 0;
+  for (char c: text) {
+    result <<= 4;
+    if ('0' <= c && c <= '9') {
+      result |= c - '0';
+    } else if ('a' <= c && c <= 'f') {
+      result |= c - 'a' + 10;
+    } else {
+      return nullptr;
+    }
+  }
+  return result;
+}
+
+kj::String unixNanos(kj::Date date) {
+  return kj::str((date - kj::UNIX_EPOCH) / kj::NANOSECONDS);
+}
+
+}  // namespace
+
+struct SpanExporter::QueuedSpan {
+  // A finished span, copied out of the `Span` so that it can be encoded later.
+
+  struct Attribute {
+    kj::String key;
+    Span::TagValue value;
+  };
+
+  struct Event {
+    kj::Date time;
+    Attribute attribute;
+  };
+
+  TraceId traceId;
+  uint64_t spanId;
+  uint64_t parentSpanId;  // zero for a root span
+  uint kind;
+  kj::String name;
+  kj::Date startTime;
+  kj::Date endTime;
+  kj::Vector<Attribute> attributes;
+  kj::Vector<Event> events;
+  uint droppedEvents;
+};
+
+class SpanExporter::Observer final: public SpanObserver {
+public:
+  Observer(kj::Own<SpanExporter> exporterParam, TraceId traceId, uint64_t parentSpanId, uint kind)
+      : exporter(kj::mv(exporterParam)), traceId(traceId), spanId(exporter->newId()),
+        parentSpanId(parentSpanId), kind(kind) {}
+
+  kj::Own<SpanObserver> newChild() override {
+    return kj::refcounted<Observer>(kj::addRef(*exporter), traceId, spanId, SPAN_KIND_INTERNAL);
+  }
+
+  void report(const Span& span) override {
+    exporter->enqueue(*this, span);
+  }
+
+  kj::Own<SpanExporter> exporter;
+  TraceId traceId;
+  uint64_t spanId;
+  uint64_t parentSpanId;
+  uint kind;
+};
+
+void SpanExporter::RequestSpan::startFetch(
+    kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers) {
+  start("fetch"_kjc, headers);
+  rootSpan.setTag("http.method"_kjc, kj::str(method));
+  rootSpan.setTag("http.url"_kjc, kj::str(url));
+}
+
+void SpanExporter::RequestSpan::startConnect(kj::StringPtr host, const kj::HttpHeaders& headers) {
+  start("connect"_kjc, headers);
+  rootSpan.setTag("net.peer.name"_kjc, kj::str(host));
+}
+
+void SpanExporter::RequestSpan::startScheduled(kj::StringPtr cron) {
+  start("scheduled"_kjc, nullptr);
+  rootSpan.setTag("cron"_kjc, kj::str(cron));
+}
+
+void SpanExporter::RequestSpan::startAlarm() {
+  start("alarm"_kjc, nullptr);
+}
+
+void SpanExporter::RequestSpan::startCustomEvent(uint type) {
+  start("custom_event"_kjc, nullptr);
+  rootSpan.setTag("event_type"_kjc, static_cast<int64_t>(type));
+}
+
+void SpanExporter::RequestSpan::start(
+    kj::ConstString operationName, kj::Maybe<const kj::HttpHeaders&> headers) {
+  TraceId traceId;
+  uint64_t parentSpanId = 0;
+
+  KJ_IF_MAYBE(parent, parentSpan.getObserver()) {
+    KJ_IF_MAYBE(observer, kj::dynamicDowncastIfAvailable<Observer>(*parent)) {
+      traceId = observer->traceId;
+      parentSpanId = observer->spanId;
+    }
+  }
+  if (parentSpanId == 0) {
+    KJ_IF_MAYBE(h, headers) {
+      KJ_IF_MAYBE(value, h->get(exporter->traceparentHeader)) {
+        // `version-traceid-parentid-flags`. Later versions may append fields, so only the
+        // length of the part we understand is checked.
+        auto text = value->asArray();
+        if (text.size() >= 55 && text[2] == '-' && text[35] == '-' && text[52] == '-' &&
+            (text.size() == 55 || text[55] == '-') && !(text[0] == 'f' && text[1] == 'f')) {
+          KJ_IF_MAYBE(high, parseHex(text.slice(3, 19))) {
+            KJ_IF_MAYBE(low, parseHex(text.slice(19, 35))) {
+              KJ_IF_MAYBE(id, parseHex(text.slice(36, 52))) {
+                if ((*high != 0 || *low != 0) && *id != 0) {
+                  traceId = { *high, *low };
+                  parentSpanId = *id;
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  if (parentSpanId == 0) {
+    traceId = { exporter->newId(), exporter->newId() };
+  }
+
+  rootSpan = SpanBuilder(
+      kj::refcounted<Observer>(kj::addRef(*exporter), traceId, parentSpanId, SPAN_KIND_SERVER),
+      kj::mv(operationName));
+  rootSpan.setTag("worker.name"_kjc, kj::str(workerName));
+}
+
+SpanExporter::SpanExporter(kj::Timer& timer, kj::EntropySource& entropySource,
+                           kj::HttpHeaderTable::Builder& headerTableBuilder, Channel channel,
+                           Options options)
+    : timer(timer), headerTable(headerTableBuilder.getFutureTable()),
+      traceparentHeader(headerTableBuilder.add("traceparent")),
+      channel(kj::mv(channel)), options(kj::mv(options)), tasks(*this) {
+  entropySource.generate(kj::arrayPtr(&rngState, 1).asBytes());
+}
+
+SpanExporter::~SpanExporter() noexcept(false) {}
+
+void SpanExporter::detach() {
+  channel = nullptr;
+  queue.clear();
+  canceler.cancel("span exporter shut down");
+}
+
+kj::Own<SpanExporter::RequestSpan> SpanExporter::makeRequestSpan(
+    kj::StringPtr workerName, SpanParent parentSpan) {
+  return kj::heap<RequestSpan>(kj::addRef(*this), workerName, kj::mv(parentSpan));
+}
+
+kj::Maybe<kj::String> SpanExporter::getTraceparent(SpanParent& span) {
+  KJ_IF_MAYBE(parent, span.getObserver()) {
+    KJ_IF_MAYBE(observer, kj::dynamicDowncastIfAvailable<Observer>(*parent)) {
+      return kj::str("00-", toHex(observer->traceId.high), toHex(observer->traceId.low), '-',
+                     toHex(observer->spanId), "-01");
+    }
+  }
+  return nullptr;
+}
+
+uint64_t SpanExporter::newId() {
+  // splitmix64. Zero means "no span" in OTLP and W3C trace context, so skip it.
+  for (;;) {
+    uint64_t z = (rngState += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    z = z ^ (z >> 31);
+    if (z != 0) return z;
+  }
+}
+
+void SpanExporter::enqueue(const Observer& observer, const Span& span) {
+  if (channel == nullptr) return;
+
+  if (queue.size() >= options.maxQueueSize) {
+    ++droppedSpans;
+    return;
+  }
+
+  auto copyValue = [](const Span::TagValue& value) -> Span::TagValue {
+    KJ_SWITCH_ONEOF(value) {
+      KJ_CASE_ONEOF(b, bool) { return b; }
+      KJ_CASE_ONEOF(i, int64_t) { return i; }
+      KJ_CASE_ONEOF(d, double) { return d; }
+      KJ_CASE_ONEOF(s, kj::String) { return kj::str(s); }
+    }
+    KJ_UNREACHABLE;
+  };
+
+  QueuedSpan queued {
+    .traceId = observer.traceId,
+    .spanId = observer.spanId,
+    .parentSpanId = observer.parentSpanId,
+    .kind = observer.kind,
+    .name = kj::str(span.operationName),
+    .startTime = span.startTime,
+    .endTime = span.endTime,
+    .attributes = kj::Vector<QueuedSpan::Attribute>(span.tags.size()),
+    .events = kj::Vector<QueuedSpan::Event>(span.logs.size()),
+    .droppedEvents = span.droppedLogs,
+  };
+  for (auto& tag: span.tags) {
+    queued.attributes.add(QueuedSpan::Attribute { kj::str(tag.key), copyValue(tag.value) });
+  }
+  for (auto& log: span.logs) {
+    queued.events.add(QueuedSpan::Event {
+      log.timestamp, { kj::str(log.tag.key), copyValue(log.tag.value) } });
+  }
+  queue.add(kj::mv(queued));
+
+  if (queue.size() >= options.maxBatchSize) {
+    flush();
+  } else {
+    scheduleFlush();
+  }
+}
+
+void SpanExporter::scheduleFlush() {
+  if (flushScheduled || sending) return;
+  flushScheduled = true;
+  tasks.add(canceler.wrap(timer.afterDelay(options.flushInterval).then([this]() {
+    flushScheduled = false;
+    flush();
+  })));
+}
+
+void SpanExporter::flush() {
+  if (sending || queue.empty()) return;
+
+  KJ_IF_MAYBE(c, channel) {
+    size_t n = kj::min(queue.size(), size_t(options.maxBatchSize));
+    auto body = encode(queue.slice(0, n));
+
+    kj::Vector<QueuedSpan> rest(kj::max(queue.size() - n, size_t(options.maxBatchSize)));
+    for (auto& span: queue.slice(n, queue.size())) {
+      rest.add(kj::mv(span));
+    }
+    queue = kj::mv(rest);
+
+    if (droppedSpans > 0) {
+      KJ_LOG(WARNING, "span export queue is full; dropped spans", droppedSpans);
+      droppedSpans = 0;
+    }
+
+    sending = true;
+    tasks.add(canceler.wrap(send(*c, kj::mv(body)).catch_([](kj::Exception&& e) {
+      KJ_LOG(WARNING, "failed to export spans", e);
+    }).then([this]() {
+      sending = false;
+      if (queue.size() >= options.maxBatchSize) {
+        flush();
+      } else if (!queue.empty()) {
+        scheduleFlush();
+      }
+    })));
+  }
+}
+
+kj::Promise<void> SpanExporter::send(Channel& channel, kj::String body) {
+  auto client = asHttpClient(channel());
+  kj::HttpHeaders headers(headerTable);
+  headers.set(kj::HttpHeaderId::CONTENT_TYPE, "application/json");
+
+  auto request = client->request(kj::HttpMethod::POST, options.url, headers, body.size());
+  co_await request.body->write(body.begin(), body.size());
+  request.body = nullptr;
+
+  auto response = co_await kj::mv(request.response);
+  if (response.statusCode < 200 || response.statusCode >= 300) {
+    KJ_LOG(WARNING, "span collector rejected a batch", response.statusCode, response.statusText);
+  }
+  co_await response.body->readAllBytes();
+}
+
+kj::String SpanExporter::encode(kj::ArrayPtr<QueuedSpan> spans) {
+  auto encodeValue = [](const Span::TagValue& value) -> kj::String {
+    // In OTLP's JSON encoding, 64-bit integers are strings.
+    KJ_SWITCH_ONEOF(value) {
+      KJ_CASE_ONEOF(b, bool) {
+        return kj::str("{\"boolValue\":", b ? "true" : "false", "}");
+      }
+      KJ_CASE_ONEOF(i, int64_t) {
+        return kj::str("{\"intValue\":\"", i, "\"}");
+      }
+      KJ_CASE_ONEOF(d, double) {
+        if (std::isfinite(d)) {
+          return kj::str("{\"doubleValue\":", d, "}");
+        } else {
+          return kj::str("{\"stringValue\":\"", d, "\"}");
+        }
+      }
+      KJ_CASE_ONEOF(s, kj::String) {
+        return kj::str("{\"stringValue\":\"", escapeJsonString(s), "\"}");
+      }
+    }
+    KJ_UNREACHABLE;
+  };
+
+  auto encodeAttribute = [&](const QueuedSpan::Attribute& attribute) {
+    return kj::str("{\"key\":\"", escapeJsonString(attribute.key), "\",\"value\":",
+                   encodeValue(attribute.value), "}");
+  };
+
+  kj::Vector<kj::String> encodedSpans(spans.size());
+  for (auto& span: spans) {
+    kj::Vector<kj::String> attributes(span.attributes.size());
+    for (auto& attribute: span.attributes) {
+      attributes.add(encodeAttribute(attribute));
+    }
+
+    kj::Vector<kj::String> events(span.events.size());
+    for (auto& event: span.events) {
+      events.add(kj::str(
+          "{\"timeUnixNano\":\"", unixNanos(event.time), "\","
+          "\"name\":\"", escapeJsonString(event.attribute.key), "\","
+          "\"attributes\":[", encodeAttribute(event.attribute), "]}"));
+    }
+
+    kj::String parent;
+    if (span.parentSpanId != 0) {
+      parent = kj::str("\"parentSpanId\":\"", toHex(span.parentSpanId), "\",");
+    }
+
+    encodedSpans.add(kj::str(
+        "{\"traceId\":\"", toHex(span.traceId.high), toHex(span.traceId.low), "\","
+        "\"spanId\":\"", toHex(span.spanId), "\",", parent,
+        "\"name\":\"", escapeJsonString(span.name), "\","
+        "\"kind\":", span.kind, ","
+        "\"startTimeUnixNano\":\"", unixNanos(span.startTime), "\","
+        "\"endTimeUnixNano\":\"", unixNanos(span.endTime), "\","
+        "\"attributes\":[", kj::strArray(attributes, ","), "],"
+        "\"events\":[", kj::strArray(events, ","), "],"
+        "\"droppedEventsCount\":", span.droppedEvents, "}"));
+  }
+
+  return kj::str(
+      "{\"resourceSpans\":[{"
+        "\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":\"",
+            escapeJsonString(options.serviceName), "\"}}]},"
+        "\"scopeSpans\":[{"
+          "\"scope\":{\"name\":\"workerd\"},"
+          "\"spans\":[", kj::strArray(encodedSpans, ","), "]"
+        "}]"
+      "}]}");
+}
+
+void SpanExporter::taskFailed(kj::Exception&& exception) {
+  // Expected when detach() cancels a pending flush.
+  if (channel == nullptr) return;
+  KJ_LOG(ERROR, exception);
+}
+
+}  // namespace workerd::server
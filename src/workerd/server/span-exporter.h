@@ -0,0 +1,146 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <workerd/io/observer.h>
+#include <workerd/io/worker-interface.h>
+#include <kj/compat/http.h>
+#include <kj/function.h>
+#include <kj/vector.h>
+
+namespace workerd::server {
+
+kj::Vector<char> escapeJsonString(kj::StringPtr text);
+// Escapes `text` for use inside a JSON string literal (without the surrounding quotes).
+
+class SpanExporter final: public kj::Refcounted, private kj::TaskSet::ErrorHandler {
+  // Exports the spans recorded through SpanBuilder to an OpenTelemetry collector, using OTLP over
+  // HTTP with the JSON encoding. One of these is created per Server when the config sets
+  // `spanExporter`.
+  //
+  // Finished spans are only copied into a queue when they're reported. They're encoded and sent
+  // in batches of up to `maxBatchSize`, either once a full batch is queued or `flushInterval`
+  // after the first span of a batch was queued, whichever comes first. While a batch is being
+  // sent, further spans keep queuing, up to `maxQueueSize`; beyond that they're dropped rather
+  // than letting a slow collector grow memory without bound.
+  //
+  // Like everything else in a Server, the exporter and its observers are used only from the
+  // Server's thread.
+  //
+  // Spans are only recorded for requests whose RequestObserver holds a RequestSpan from
+  // `makeRequestSpan()`; everywhere else SpanBuilder stays on its no-op path.
+
+public:
+  struct Options {
+    kj::String url;
+    // Where batches are POSTed.
+
+    kj::String serviceName;
+    // `service.name` resource attribute.
+
+    uint maxBatchSize;
+    uint maxQueueSize;
+    kj::Duration flushInterval;
+  };
+
+  using Channel = kj::Function<kj::Own<WorkerInterface>()>;
+  // Starts a request to the collector.
+
+  SpanExporter(kj::Timer& timer, kj::EntropySource& entropySource,
+               kj::HttpHeaderTable::Builder& headerTableBuilder, Channel channel,
+               Options options);
+  ~SpanExporter() noexcept(false);
+
+  kj::HttpHeaderId getTraceparentHeader() const { return traceparentHeader; }
+
+  void detach();
+  // Stop exporting, dropping anything that's queued. Must be called before the collector's
+  // channel, timer, or header table go away; observers may still hold references to the exporter.
+
+  class RequestSpan;
+
+  kj::Own<RequestSpan> makeRequestSpan(kj::StringPtr workerName, SpanParent parentSpan);
+  // Make the root span for a request, for its RequestObserver to start once it sees the event.
+  //
+  // `workerName` must outlive the returned object.
+
+  static kj::Maybe<kj::String> getTraceparent(SpanParent& span);
+  // If `span` is recorded by a SpanExporter, returns the W3C `traceparent` header value that
+  // makes a remote service's spans its children.
+
+private:
+  struct TraceId {
+    uint64_t high = 0;
+    uint64_t low = 0;
+  };
+
+  struct QueuedSpan;
+  class Observer;
+
+  kj::Timer& timer;
+  kj::HttpHeaderTable& headerTable;
+  kj::HttpHeaderId traceparentHeader;
+  kj::Maybe<Channel> channel;
+  // Null once detached.
+  Options options;
+
+  uint64_t rngState;
+  // splitmix64 state, seeded from the entropy source, for trace and span IDs. These only need to
+  // be unique, not unpredictable.
+
+  kj::Vector<QueuedSpan> queue;
+  bool flushScheduled = false;
+  bool sending = false;
+  // At most one batch is in flight at a time.
+  uint droppedSpans = 0;
+  kj::Canceler canceler;
+  kj::TaskSet tasks;
+
+  uint64_t newId();
+
+  void enqueue(const Observer& observer, const Span& span);
+  void scheduleFlush();
+  void flush();
+  kj::Promise<void> send(Channel& channel, kj::String body);
+  kj::String encode(kj::ArrayPtr<QueuedSpan> spans);
+
+  void taskFailed(kj::Exception&& exception) override;
+};
+
+class SpanExporter::RequestSpan {
+  // A request's root span, which becomes the parent of every span recorded while handling it. If
+  // `parentSpan` came from another SpanExporter-observed request (e.g. a service binding call),
+  // the root span is its child. Otherwise, a `traceparent` header on the incoming HTTP request,
+  // if valid, makes the root span a child of the remote span it names; failing that, the request
+  // starts a new trace.
+  //
+  // The span is started by one of the `start*()` methods when the event is delivered, and ended
+  // by `end()` or when this object is destroyed, whichever comes first.
+
+public:
+  RequestSpan(kj::Own<SpanExporter> exporter, kj::StringPtr workerName, SpanParent parentSpan)
+      : exporter(kj::mv(exporter)), workerName(workerName), parentSpan(kj::mv(parentSpan)) {}
+
+  void startFetch(kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers);
+  void startConnect(kj::StringPtr host, const kj::HttpHeaders& headers);
+  void startScheduled(kj::StringPtr cron);
+  void startAlarm();
+  void startCustomEvent(uint type);
+
+  void fail() { rootSpan.setTag("error"_kjc, true); }
+  void end() { rootSpan.end(); }
+
+  SpanParent getSpan() { return SpanParent(rootSpan); }
+
+private:
+  kj::Own<SpanExporter> exporter;
+  kj::StringPtr workerName;
+  SpanParent parentSpan;
+  SpanBuilder rootSpan = nullptr;
+
+  void start(kj::ConstString operationName, kj::Maybe<const kj::HttpHeaders&> headers);
+};
+
+}  // namespace workerd::server
@@ -0,0 +1,349 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "worker-limits.h"
+#include <workerd/io/actor-cache.h>
+#include <workerd/io/io-context.h>
+
+namespace workerd::server {
+
+namespace {
+
+kj::Exception makeLimitException(EventOutcome outcome) {
+  switch (outcome) {
+    case EventOutcome::EXCEEDED_CPU:
+      return KJ_EXCEPTION(OVERLOADED,
+          "broken.exceededCpu; jsg.Error: Worker exceeded CPU time limit.");
+    case EventOutcome::EXCEEDED_MEMORY:
+      return KJ_EXCEPTION(OVERLOADED,
+          "broken.exceededMemory; jsg.Error: Worker exceeded memory limit.");
+    default:
+      break;
+  }
+  KJ_UNREACHABLE;
+}
+
+}  // namespace
+
+// =======================================================================================
+
+CpuWatchdog::CpuWatchdog(): thread([this]() { threadMain(); }) {}
+
+CpuWatchdog::~CpuWatchdog() noexcept(false) {
+  state.lockExclusive()->shuttingDown = true;
+  // `thread` is joined when it's destroyed, right after this.
+}
+
+void CpuWatchdog::arm(Alarm& alarm) {
+  auto lock = state.lockExclusive();
+  lock->armed.add(&alarm);
+  ++lock->generation;
+}
+
+void CpuWatchdog::disarm(Alarm& alarm) {
+  auto lock = state.lockExclusive();
+  for (auto i: kj::indices(lock->armed)) {
+    if (lock->armed[i] == &alarm) {
+      lock->armed[i] = lock->armed.back();
+      lock->armed.removeLast();
+      return;
+    }
+  }
+}
+
+void CpuWatchdog::threadMain() {
+  auto lock = state.lockExclusive();
+  for (;;) {
+    if (lock->shuttingDown) return;
+
+    auto now = kj::systemPreciseMonotonicClock().now();
+    kj::Maybe<kj::TimePoint> nextDeadline;
+    for (auto alarm: lock->armed) {
+      if (alarm->fired) continue;
+      if (alarm->deadline <= now) {
+        // TerminateExecution() is the one isolate method that's safe to call from any thread.
+        alarm->isolate->TerminateExecution();
+        alarm->fired = true;
+      } else KJ_IF_MAYBE(next, nextDeadline) {
+        if (alarm->deadline < *next) *next = alarm->deadline;
+      } else {
+        nextDeadline = alarm->deadline;
+      }
+    }
+
+    uint generation = lock->generation;
+    auto changed = [generation](const State& s) {
+      return s.shuttingDown || s.generation != generation;
+    };
+    KJ_IF_MAYBE(next, nextDeadline) {
+      lock.wait(changed, *next - now);
+    } else {
+      lock.wait(changed);
+    }
+  }
+}
+
+// =======================================================================================
+
+class WorkerIsolateLimitEnforcer::RequestLimitEnforcer final: public LimitEnforcer {
+public:
+  RequestLimitEnforcer(WorkerIsolateLimitEnforcer& parent)
+      : parent(parent), cpuLimit(parent.limits.cpuLimitMs * kj::MILLISECONDS) {
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    limitsExceededPromise = paf.promise.fork();
+    limitsExceededFulfiller = kj::mv(paf.fulfiller);
+  }
+
+  kj::Own<void> enterJs(jsg::Lock& lock, IoContext& context) override {
+    if (parent.currentRequest != nullptr) {
+      // Already inside JavaScript for this request; the outer scope is doing the accounting.
+      return {};
+    }
+    return kj::heap<JsScope>(*this, lock.v8Isolate);
+  }
+
+  void topUpActor() override {
+    // Each event delivered to an actor gets a fresh CPU budget, like a new request would.
+    if (exceeded == nullptr) cpuUsed = 0 * kj::SECONDS;
+  }
+
+  void newSubrequest(bool isInHouse) override {}
+  void newKvRequest(KvOpType op) override {}
+  void newAnalyticsEngineRequest() override {}
+  kj::Promise<void> limitDrain() override { return kj::NEVER_DONE; }
+  kj::Promise<void> limitScheduled() override { return kj::NEVER_DONE; }
+
+  size_t getBufferingLimit() override {
+    if (parent.limits.bufferingLimitMb == 0) return kj::maxValue;
+    return size_t(parent.limits.bufferingLimitMb) << 20;
+  }
+
+  kj::Maybe<EventOutcome> getLimitsExceeded() override { return exceeded; }
+
+  kj::Promise<void> onLimitsExceeded() override { return limitsExceededPromise.addBranch(); }
+
+  void requireLimitsNotExceeded() override {
+    KJ_IF_MAYBE(outcome, exceeded) {
+      kj::throwFatalException(makeLimitException(*outcome));
+    }
+  }
+
+  void reportMetrics(RequestObserver& requestMetrics) override {}
+
+  void chargeOffThreadCpu(kj::Duration cpuTime) override {
+    cpuUsed += cpuTime;
+    checkCpu();
+  }
+
+  void exceed(EventOutcome outcome) {
+    if (exceeded != nullptr) return;
+    exceeded = outcome;
+    limitsExceededFulfiller->reject(makeLimitException(outcome));
+  }
+
+private:
+  class JsScope {
+  public:
+    JsScope(RequestLimitEnforcer& request, v8::Isolate* isolate)
+        : request(request), start(kj::systemPreciseMonotonicClock().now()) {
+      request.parent.currentRequest = request;
+      if (request.cpuLimit > 0 * kj::SECONDS) {
+        auto remaining = request.cpuUsed < request.cpuLimit
+            ? request.cpuLimit - request.cpuUsed : 0 * kj::SECONDS;
+        auto& a = alarm.emplace(CpuWatchdog::Alarm { isolate, start + remaining });
+        KJ_ASSERT_NONNULL(request.parent.watchdog).arm(a);
+      }
+    }
+
+    ~JsScope() noexcept(false) {
+      request.parent.currentRequest = nullptr;
+      request.cpuUsed += kj::systemPreciseMonotonicClock().now() - start;
+      KJ_IF_MAYBE(a, alarm) {
+        KJ_ASSERT_NONNULL(request.parent.watchdog).disarm(*a);
+        if (a->fired) {
+          // If the watchdog fired just as JavaScript finished, the termination is still pending
+          // and would hit whatever runs next.
+          a->isolate->CancelTerminateExecution();
+          request.exceed(EventOutcome::EXCEEDED_CPU);
+        }
+      }
+      request.checkCpu();
+    }
+
+    KJ_DISALLOW_COPY_AND_MOVE(JsScope);
+
+  private:
+    RequestLimitEnforcer& request;
+    kj::TimePoint start;
+    kj::Maybe<CpuWatchdog::Alarm> alarm;
+  };
+
+  WorkerIsolateLimitEnforcer& parent;
+  kj::Duration cpuLimit;
+  kj::Duration cpuUsed = 0 * kj::SECONDS;
+  kj::Maybe<EventOutcome> exceeded;
+  kj::ForkedPromise<void> limitsExceededPromise = nullptr;
+  kj::Own<kj::PromiseFulfiller<void>> limitsExceededFulfiller;
+
+  void checkCpu() {
+    if (cpuLimit > 0 * kj::SECONDS && cpuUsed >= cpuLimit) {
+      exceed(EventOutcome::EXCEEDED_CPU);
+    }
+  }
+};
+
+class WorkerIsolateLimitEnforcer::StartupScope {
+  // Limits script startup and dynamic imports to one CPU budget each, and reports running out of
+  // heap during them through `error`.
+
+public:
+  StartupScope(const WorkerIsolateLimitEnforcer& parent, v8::Isolate* isolate,
+               kj::Maybe<kj::Exception>& error)
+      : parent(parent), error(error) {
+    parent.currentStartupError = error;
+    if (parent.limits.cpuLimitMs > 0) {
+      auto deadline = kj::systemPreciseMonotonicClock().now() +
+          parent.limits.cpuLimitMs * kj::MILLISECONDS;
+      auto& a = alarm.emplace(CpuWatchdog::Alarm { isolate, deadline });
+      KJ_ASSERT_NONNULL(parent.watchdog).arm(a);
+    }
+  }
+
+  ~StartupScope() noexcept(false) {
+    parent.currentStartupError = nullptr;
+    KJ_IF_MAYBE(a, alarm) {
+      KJ_ASSERT_NONNULL(parent.watchdog).disarm(*a);
+      if (a->fired) {
+        a->isolate->CancelTerminateExecution();
+        if (error == nullptr) {
+          error = KJ_EXCEPTION(OVERLOADED,
+              "broken.exceededCpu; jsg.Error: Script startup exceeded CPU time limit.");
+        }
+      }
+    }
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(StartupScope);
+
+private:
+  const WorkerIsolateLimitEnforcer& parent;
+  kj::Maybe<kj::Exception>& error;
+  kj::Maybe<CpuWatchdog::Alarm> alarm;
+};
+
+// =======================================================================================
+
+WorkerIsolateLimitEnforcer::WorkerIsolateLimitEnforcer(
+    Limits limits, kj::Maybe<CpuWatchdog&> watchdog)
+    : limits(limits), watchdog(watchdog) {
+  KJ_REQUIRE(limits.cpuLimitMs == 0 || watchdog != nullptr);
+}
+
+kj::Maybe<kj::Own<LimitEnforcer>> WorkerIsolateLimitEnforcer::newRequestLimitEnforcer() {
+  if (limits.heapLimitMb == 0 && limits.cpuLimitMs == 0 && limits.bufferingLimitMb == 0) {
+    return nullptr;
+  }
+  return kj::Own<LimitEnforcer>(kj::heap<RequestLimitEnforcer>(*this));
+}
+
+v8::Isolate::CreateParams WorkerIsolateLimitEnforcer::getCreateParams() {
+  v8::Isolate::CreateParams params;
+  if (limits.heapLimitMb > 0) {
+    params.constraints.ConfigureDefaultsFromHeapSize(0, size_t(limits.heapLimitMb) << 20);
+  }
+  return params;
+}
+
+void WorkerIsolateLimitEnforcer::customizeIsolate(v8::Isolate* isolate) {
+  this->isolate = isolate;
+  if (limits.heapLimitMb > 0) {
+    isolate->AddNearHeapLimitCallback(&nearHeapLimit, this);
+    // Go back to the configured limit once the heap has shrunk well below it, so that the
+    // headroom granted by nearHeapLimit() is available again the next time.
+    isolate->AutomaticallyRestoreInitialHeapLimit(0.5);
+  }
+}
+
+size_t WorkerIsolateLimitEnforcer::nearHeapLimit(
+    void* data, size_t currentHeapLimit, size_t initialHeapLimit) {
+  // V8 calls this during a GC that failed to free enough memory. We can't run JavaScript or
+  // collect garbage from here, so instead we terminate whatever JavaScript is running and give
+  // it enough headroom to unwind.
+  auto& self = *reinterpret_cast<WorkerIsolateLimitEnforcer*>(data);
+
+  if (currentHeapLimit > initialHeapLimit) {
+    // We already granted headroom, and it filled up before the heap could shrink. Declining to
+    // raise the limit again lets V8 fail with an out-of-memory error.
+    KJ_LOG(ERROR, "isolate exceeded its heap limit while unwinding from exceeding it",
+        currentHeapLimit);
+    return currentHeapLimit;
+  }
+
+  self.heapLimitReached = true;
+  bool blamed = false;
+  KJ_IF_MAYBE(request, self.currentRequest) {
+    request->exceed(EventOutcome::EXCEEDED_MEMORY);
+    blamed = true;
+  }
+  KJ_IF_MAYBE(error, self.currentStartupError) {
+    if (*error == nullptr) {
+      *error = KJ_EXCEPTION(OVERLOADED,
+          "broken.exceededMemory; jsg.Error: Script startup exceeded memory limit.");
+    }
+    blamed = true;
+  }
+  if (blamed) {
+    self.isolate->TerminateExecution();
+  }
+
+  return currentHeapLimit + initialHeapLimit / 2;
+}
+
+ActorCacheSharedLruOptions WorkerIsolateLimitEnforcer::getActorCacheLruOptions() {
+  // TODO(someday): Make this configurable?
+  return {
+    .softLimit = 16 * (1ull << 20), // 16 MiB
+    .hardLimit = 128 * (1ull << 20), // 128 MiB
+    .staleTimeout = 30 * kj::SECONDS,
+    .dirtyListByteLimit = 8 * (1ull << 20), // 8 MiB
+    .maxKeysPerRpc = 128,
+
+    // For now, we use `neverFlush` to implement in-memory-only actors.
+    // See WorkerService::getActor().
+    .neverFlush = true
+  };
+}
+
+kj::Own<void> WorkerIsolateLimitEnforcer::enterStartupJs(
+    jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const {
+  return kj::heap<StartupScope>(*this, lock.v8Isolate, error);
+}
+
+kj::Own<void> WorkerIsolateLimitEnforcer::enterDynamicImportJs(
+    jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const {
+  return kj::heap<StartupScope>(*this, lock.v8Isolate, error);
+}
+
+kj::Own<void> WorkerIsolateLimitEnforcer::enterLoggingJs(
+    jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const {
+  return {};
+}
+
+kj::Own<void> WorkerIsolateLimitEnforcer::enterInspectorJs(
+    jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const {
+  return {};
+}
+
+bool WorkerIsolateLimitEnforcer::exitJs(jsg::Lock& lock) const {
+  if (heapLimitReached) {
+    // The JavaScript that ran out of heap has been terminated; free what it was holding now, so
+    // that the isolate gets back under its limit before the headroom runs out.
+    heapLimitReached = false;
+    lock.v8Isolate->LowMemoryNotification();
+  }
+  // workerd has no way to replace an isolate, so it's never condemned.
+  return false;
+}
+
+}  // namespace workerd::server
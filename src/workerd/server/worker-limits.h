@@ -0,0 +1,121 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <workerd/io/limit-enforcer.h>
+#include <kj/mutex.h>
+#include <kj/thread.h>
+#include <kj/time.h>
+#include <kj/vector.h>
+
+namespace workerd::server {
+
+using kj::uint;
+
+class CpuWatchdog {
+  // A thread that terminates JavaScript execution which runs past its deadline. One of these is
+  // shared by every worker in a Server that has a CPU limit.
+
+public:
+  CpuWatchdog();
+  ~CpuWatchdog() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(CpuWatchdog);
+
+  struct Alarm {
+    v8::Isolate* isolate;
+    kj::TimePoint deadline;
+    bool fired = false;
+    // Set, under the watchdog's lock, when the watchdog calls TerminateExecution() on `isolate`.
+  };
+
+  void arm(Alarm& alarm);
+  // Start watching `alarm`. Must be called with `alarm.isolate` locked.
+
+  void disarm(Alarm& alarm);
+  // Stop watching `alarm`. Once this returns, the watchdog won't touch the isolate again and
+  // `alarm.fired` can be read without a lock. Must be called before the isolate is unlocked.
+
+private:
+  struct State {
+    kj::Vector<Alarm*> armed;
+    uint generation = 0;
+    // Bumped whenever an alarm is added, so that the thread recomputes its next deadline.
+    bool shuttingDown = false;
+  };
+
+  kj::MutexGuarded<State> state;
+  kj::Thread thread;
+
+  void threadMain();
+};
+
+class WorkerIsolateLimitEnforcer final: public IsolateLimitEnforcer {
+  // IsolateLimitEnforcer for a worker's `limits` config.
+  //
+  // With a heap limit, running out of heap terminates the JavaScript that was running, rather than
+  // crashing the process: V8 is given some headroom to unwind with, the offending request fails
+  // with `exceededMemory`, and the heap is collected as soon as JavaScript exits. Only if the
+  // isolate fills that headroom too before its heap shrinks does V8 abort.
+  //
+  // With a CPU limit, each event may spend that long executing JavaScript (including work it
+  // hands to other threads, such as crypto) before it is terminated and fails with `exceededCpu`.
+  // The same limit applies to script startup. Time is measured on a monotonic clock while
+  // JavaScript holds the isolate lock, which is close to CPU time since JavaScript only blocks
+  // when it's waiting for the isolate's own thread.
+
+public:
+  struct Limits {
+    // See `Worker.limits` in workerd.capnp. Zero means no limit.
+
+    uint heapLimitMb = 0;
+    uint cpuLimitMs = 0;
+    uint bufferingLimitMb = 0;
+  };
+
+  WorkerIsolateLimitEnforcer(Limits limits, kj::Maybe<CpuWatchdog&> watchdog);
+  // `watchdog` must be non-null if `limits.cpuLimitMs` is set, and must outlive the isolate.
+
+  kj::Maybe<kj::Own<LimitEnforcer>> newRequestLimitEnforcer();
+  // Returns a LimitEnforcer applying the per-request limits to one request, or null if no limits
+  // are configured. The enforcer must not outlive this object.
+
+  v8::Isolate::CreateParams getCreateParams() override;
+  void customizeIsolate(v8::Isolate* isolate) override;
+  ActorCacheSharedLruOptions getActorCacheLruOptions() override;
+  kj::Own<void> enterStartupJs(
+      jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const override;
+  kj::Own<void> enterDynamicImportJs(
+      jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const override;
+  kj::Own<void> enterLoggingJs(
+      jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const override;
+  kj::Own<void> enterInspectorJs(
+      jsg::Lock& lock, kj::Maybe<kj::Exception>& error) const override;
+  void completedRequest(kj::StringPtr id) const override {}
+  bool exitJs(jsg::Lock& lock) const override;
+  void reportMetrics(IsolateObserver& isolateMetrics) const override {}
+
+private:
+  class RequestLimitEnforcer;
+  class StartupScope;
+
+  Limits limits;
+  kj::Maybe<CpuWatchdog&> watchdog;
+  v8::Isolate* isolate = nullptr;
+  // Set by customizeIsolate().
+
+  // The rest is only touched with the isolate locked; it's mutable because the enter*Js() methods
+  // are const.
+
+  mutable kj::Maybe<RequestLimitEnforcer&> currentRequest;
+  mutable kj::Maybe<kj::Maybe<kj::Exception>&> currentStartupError;
+  // Whatever is running JavaScript right now, to blame if the heap limit is reached.
+
+  mutable bool heapLimitReached = false;
+  // Set by the near-heap-limit callback, so that exitJs() collects garbage.
+
+  static size_t nearHeapLimit(void* data, size_t currentHeapLimit, size_t initialHeapLimit);
+};
+
+}  // namespace workerd::server
@@ -0,0 +1,221 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "worker-metrics.h"
+#include <workerd/io/worker-interface.h>
+#include <kj/time.h>
+
+namespace workerd::server {
+
+class WorkerMetrics::WorkerStats::RequestObserverImpl final
+    : public RequestObserver, private WorkerInterface {
+public:
+  RequestObserverImpl(kj::Own<const WorkerStats> stats,
+                      kj::Maybe<kj::Own<SpanExporter::RequestSpan>> span)
+      : stats(kj::mv(stats)), span(kj::mv(span)) {}
+
+  ~RequestObserverImpl() noexcept(false) {
+    // A request that is canceled after delivery may never reach jsDone().
+    finish();
+  }
+
+  void delivered() override {
+    stats->requests.fetch_add(1, std::memory_order_relaxed);
+    deliveredAt = kj::systemPreciseMonotonicClock().now();
+  }
+
+  void jsDone() override {
+    finish();
+    KJ_IF_MAYBE(s, span) {
+      s->get()->end();
+    }
+  }
+
+  void reportFailure(const kj::Exception& e) override {
+    KJ_IF_MAYBE(s, span) {
+      s->get()->fail();
+    }
+    if (!failed) {
+      failed = true;
+      stats->failures.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  WorkerInterface& wrapWorkerInterface(WorkerInterface& worker) override {
+    // Exceptions thrown by the handler are usually tunneled back to the caller rather than
+    // turned into an error response, in which case reportFailure() is never called, so we watch
+    // for them here.
+    KJ_REQUIRE(inner == nullptr, "wrapWorkerInterface() can only be called once");
+    inner = worker;
+    return *this;
+  }
+
+  kj::Own<WorkerInterface> wrapSubrequestClient(kj::Own<WorkerInterface> client) override {
+    stats->subrequests.fetch_add(1, std::memory_order_relaxed);
+    return kj::mv(client);
+  }
+
+  SpanParent getSpan() override {
+    KJ_IF_MAYBE(s, span) {
+      return s->get()->getSpan();
+    }
+    return nullptr;
+  }
+
+private:
+  kj::Own<const WorkerStats> stats;
+  kj::Maybe<kj::Own<SpanExporter::RequestSpan>> span;
+  kj::Maybe<WorkerInterface&> inner;
+  kj::Maybe<kj::TimePoint> deliveredAt;
+  bool failed = false;
+
+  WorkerInterface& getInner() {
+    return KJ_ASSERT_NONNULL(inner);
+  }
+
+  template <typename T>
+  kj::Promise<T> watch(kj::Promise<T> promise) {
+    return promise.catch_([this](kj::Exception&& e) -> kj::Promise<T> {
+      reportFailure(e);
+      return kj::mv(e);
+    });
+  }
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+    KJ_IF_MAYBE(s, span) {
+      s->get()->startFetch(method, url, headers);
+    }
+    return watch(getInner().request(method, url, headers, requestBody, response));
+  }
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    KJ_IF_MAYBE(s, span) {
+      s->get()->startConnect(host, headers);
+    }
+    return watch(getInner().connect(host, headers, connection, response, settings));
+  }
+  void prewarm(kj::StringPtr url) override {
+    getInner().prewarm(url);
+  }
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    KJ_IF_MAYBE(s, span) {
+      s->get()->startScheduled(cron);
+    }
+    return watch(getInner().runScheduled(scheduledTime, cron));
+  }
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+    KJ_IF_MAYBE(s, span) {
+      s->get()->startAlarm();
+    }
+    return watch(getInner().runAlarm(scheduledTime));
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    KJ_IF_MAYBE(s, span) {
+      s->get()->startCustomEvent(event->getType());
+    }
+    return watch(getInner().customEvent(kj::mv(event)));
+  }
+
+  void finish() {
+    KJ_IF_MAYBE(d, deliveredAt) {
+      auto now = kj::systemPreciseMonotonicClock().now();
+      stats->requestMicros.record((now - *d) / kj::MICROSECONDS);
+      deliveredAt = nullptr;
+    }
+  }
+};
+
+class WorkerMetrics::WorkerStats::WorkerObserverImpl final: public WorkerObserver {
+public:
+  explicit WorkerObserverImpl(kj::Own<const WorkerStats> stats): stats(kj::mv(stats)) {}
+
+  kj::Own<Startup> startup(IsolateObserver::StartType startType) const override {
+    return kj::heap<StartupImpl>(*stats);
+  }
+
+private:
+  kj::Own<const WorkerStats> stats;
+
+  class StartupImpl final: public Startup {
+  public:
+    explicit StartupImpl(const WorkerStats& stats)
+        : stats(stats), startedAt(kj::systemPreciseMonotonicClock().now()) {}
+
+    void done() override {
+      auto now = kj::systemPreciseMonotonicClock().now();
+      stats.startupMicros.record((now - startedAt) / kj::MICROSECONDS);
+    }
+
+  private:
+    const WorkerStats& stats;
+    // Owned by the WorkerObserver, which the Worker keeps alive for longer than its startup.
+
+    kj::TimePoint startedAt;
+  };
+};
+
+kj::Own<WorkerObserver> WorkerMetrics::WorkerStats::makeWorkerObserver() const {
+  return kj::atomicRefcounted<WorkerObserverImpl>(kj::atomicAddRef(*this));
+}
+
+kj::Own<RequestObserver> WorkerMetrics::WorkerStats::makeRequestObserver(
+    kj::Maybe<kj::Own<SpanExporter::RequestSpan>> span) const {
+  return kj::refcounted<RequestObserverImpl>(kj::atomicAddRef(*this), kj::mv(span));
+}
+
+kj::Own<const WorkerMetrics::WorkerStats> WorkerMetrics::addWorker(kj::StringPtr workerName) {
+  auto stats = kj::atomicRefcounted<WorkerStats>(kj::str(workerName));
+  workers.lockExclusive()->add(kj::atomicAddRef(*stats));
+  return kj::mv(stats);
+}
+
+kj::String WorkerMetrics::render() const {
+  auto lock = workers.lockShared();
+
+  kj::Vector<kj::String> out;
+  auto header = [&](kj::StringPtr metric, kj::StringPtr type, kj::StringPtr help) {
+    out.add(kj::str("# HELP ", metric, ' ', help, '\n'));
+    out.add(kj::str("# TYPE ", metric, ' ', type, '\n'));
+  };
+  auto forEachWorker = [&](auto&& func) {
+    for (auto& worker: *lock) {
+      auto labels = kj::str("worker=\"", escapePrometheusLabel(worker->name), '"');
+      func(labels, *worker);
+    }
+  };
+  auto counter = [&](kj::StringPtr metric, kj::StringPtr help,
+                     std::atomic<uint64_t> WorkerStats::* field) {
+    header(metric, "counter", help);
+    forEachWorker([&](kj::StringPtr labels, const WorkerStats& stats) {
+      out.add(kj::str(metric, '{', labels, "} ",
+          (stats.*field).load(std::memory_order_relaxed), '\n'));
+    });
+  };
+  auto histogram = [&](kj::StringPtr metric, kj::StringPtr help,
+                       const LockHistogram WorkerStats::* field) {
+    header(metric, "histogram", help);
+    forEachWorker([&](kj::StringPtr labels, const WorkerStats& stats) {
+      (stats.*field).render(out, metric, labels);
+    });
+  };
+
+  counter("workerd_worker_requests_total",
+      "Requests delivered to the Worker.", &WorkerStats::requests);
+  counter("workerd_worker_request_failures_total",
+      "Requests that failed with an exception.", &WorkerStats::failures);
+  histogram("workerd_worker_request_duration_microseconds",
+      "Time from delivery of a request until no more JavaScript runs on its behalf.",
+      &WorkerStats::requestMicros);
+  counter("workerd_worker_subrequests_total",
+      "Outgoing subrequests made by the Worker.", &WorkerStats::subrequests);
+  histogram("workerd_worker_startup_microseconds",
+      "Time spent evaluating the Worker's global scope at startup.",
+      &WorkerStats::startupMicros);
+  return kj::strArray(out, "");
+}
+
+}  // namespace workerd::server
@@ -0,0 +1,63 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include "lock-metrics.h"
+#include "span-exporter.h"
+#include <atomic>
+
+namespace workerd::server {
+
+class WorkerMetrics {
+  // Collects per-Worker request and startup statistics and renders them in the Prometheus text
+  // exposition format, alongside LockMetrics and ActorCacheMetrics. Created per Server when the
+  // config defines a `metrics` service; each Worker then gets a WorkerStats from `addWorker()`,
+  // which hands out the Worker's WorkerObserver and a RequestObserver for every request.
+  //
+  // For each Worker we keep:
+  // - Requests delivered, and requests that failed.
+  // - Request duration (microseconds), from delivery until no more JavaScript will run for the
+  //   request. Time spent in waitUntil() tasks and deferred proxying is not included.
+  // - Subrequests made.
+  // - Startup time (microseconds), i.e. time spent evaluating the script's global scope.
+
+public:
+  class WorkerStats;
+
+  kj::Own<const WorkerStats> addWorker(kj::StringPtr workerName);
+  // Register a Worker. The returned stats (and the observers they create) may outlive the
+  // WorkerMetrics.
+
+  kj::String render() const;
+  // Render all metrics in the Prometheus text exposition format.
+
+private:
+  kj::MutexGuarded<kj::Vector<kj::Own<const WorkerStats>>> workers;
+};
+
+class WorkerMetrics::WorkerStats final: public kj::AtomicRefcounted {
+public:
+  explicit WorkerStats(kj::String name): name(kj::mv(name)) {}
+
+  kj::Own<WorkerObserver> makeWorkerObserver() const;
+  kj::Own<RequestObserver> makeRequestObserver(
+      kj::Maybe<kj::Own<SpanExporter::RequestSpan>> span = nullptr) const;
+  // If `span` is given, the observer also starts and ends it around the request, and exposes it
+  // as the request's span.
+
+  kj::String name;
+
+  mutable std::atomic<uint64_t> requests = 0;
+  mutable std::atomic<uint64_t> failures = 0;
+  mutable std::atomic<uint64_t> subrequests = 0;
+  LockHistogram requestMicros;
+  LockHistogram startupMicros;
+
+private:
+  class RequestObserverImpl;
+  class WorkerObserverImpl;
+};
+
+}  // namespace workerd::server
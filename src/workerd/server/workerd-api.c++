@@ -90,6 +90,7 @@ JSG_DECLARE_ISOLATE_TYPE(JsgWorkerdIsolate,
 struct WorkerdApiIsolate::Impl {
   kj::Own<CompatibilityFlags::Reader> features;
   JsgWorkerdIsolate jsgIsolate;
+  kj::Maybe<const jsg::ModuleCodeCache&> moduleCodeCache;
 
   class Configuration {
   public:
@@ -108,9 +109,11 @@ struct WorkerdApiIsolate::Impl {
 
   Impl(jsg::V8System& v8System,
        CompatibilityFlags::Reader featuresParam,
-       IsolateLimitEnforcer& limitEnforcer)
+       IsolateLimitEnforcer& limitEnforcer,
+       kj::Maybe<const jsg::ModuleCodeCache&> moduleCodeCache)
       : features(capnp::clone(featuresParam)),
-        jsgIsolate(v8System, Configuration(*this), limitEnforcer.getCreateParams()) {}
+        jsgIsolate(v8System, Configuration(*this), limitEnforcer.getCreateParams()),
+        moduleCodeCache(moduleCodeCache) {}
 
   static v8::Local<v8::String> compileTextGlobal(JsgWorkerdIsolate::Lock& lock,
       capnp::Text::Reader reader) {
@@ -148,8 +151,9 @@ struct WorkerdApiIsolate::Impl {
 
 WorkerdApiIsolate::WorkerdApiIsolate(jsg::V8System& v8System,
     CompatibilityFlags::Reader features,
-    IsolateLimitEnforcer& limitEnforcer)
-    : impl(kj::heap<Impl>(v8System, features, limitEnforcer)) {}
+    IsolateLimitEnforcer& limitEnforcer,
+    kj::Maybe<const jsg::ModuleCodeCache&> moduleCodeCache)
+    : impl(kj::heap<Impl>(v8System, features, limitEnforcer, moduleCodeCache)) {}
 WorkerdApiIsolate::~WorkerdApiIsolate() noexcept(false) {}
 
 kj::Own<jsg::Lock> WorkerdApiIsolate::lock(jsg::V8StackScope& stackScope) const {
@@ -277,92 +281,104 @@ kj::Own<jsg::ModuleRegistry> WorkerdApiIsolate::compileModules(
   auto modules = kj::heap<jsg::ModuleRegistryImpl<JsgWorkerdIsolate_TypeWrapper>>(
       kj::addRef(*observer));
 
+  // Bundle modules are compiled the first time they're resolved, not here: a bundle may list
+  // many modules that the entry graph never reaches, and those should cost nothing beyond their
+  // source bytes, which stay in the config. `module` and `conf` point into the config, which
+  // outlives every isolate built from it.
   for (auto module: conf.getModules()) {
     auto path = kj::Path::parse(module.getName());
 
     switch (module.which()) {
       case config::Worker::Module::TEXT: {
-        modules->add(
-            path,
-            jsg::ModuleRegistry::ModuleInfo(
-                lock,
-                module.getName(),
-                nullptr,
-                jsg::ModuleRegistry::TextModuleInfo(lock,
-                    Impl::compileTextGlobal(lock, module.getText()))));
+        modules->add(path, [module](jsg::Lock& js) {
+          auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(js);
+          return jsg::ModuleRegistry::ModuleInfo(
+              lock,
+              module.getName(),
+              nullptr,
+              jsg::ModuleRegistry::TextModuleInfo(lock,
+                  Impl::compileTextGlobal(lock, module.getText())));
+        });
         break;
       }
       case config::Worker::Module::DATA: {
-        modules->add(
-            path,
-            jsg::ModuleRegistry::ModuleInfo(
-                lock,
-                module.getName(),
-                nullptr,
-                jsg::ModuleRegistry::DataModuleInfo(
-                    lock,
-                    Impl::compileDataGlobal(lock, module.getData()).As<v8::ArrayBuffer>())));
+        modules->add(path, [module](jsg::Lock& js) {
+          auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(js);
+          return jsg::ModuleRegistry::ModuleInfo(
+              lock,
+              module.getName(),
+              nullptr,
+              jsg::ModuleRegistry::DataModuleInfo(
+                  lock,
+                  Impl::compileDataGlobal(lock, module.getData()).As<v8::ArrayBuffer>()));
+        });
         break;
       }
       case config::Worker::Module::WASM: {
-        modules->add(
-            path,
-            jsg::ModuleRegistry::ModuleInfo(
-                lock,
-                module.getName(),
-                nullptr,
-                jsg::ModuleRegistry::WasmModuleInfo(lock,
-                    Impl::compileWasmGlobal(lock, module.getWasm(), *observer))));
+        modules->add(path, [module, observer = kj::addRef(*observer)](jsg::Lock& js) {
+          auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(js);
+          return jsg::ModuleRegistry::ModuleInfo(
+              lock,
+              module.getName(),
+              nullptr,
+              jsg::ModuleRegistry::WasmModuleInfo(lock,
+                  Impl::compileWasmGlobal(lock, module.getWasm(), *observer)));
+        });
         break;
       }
       case config::Worker::Module::JSON: {
-        modules->add(
-            path,
-            jsg::ModuleRegistry::ModuleInfo(
-                lock,
-                module.getName(),
-                nullptr,
-                jsg::ModuleRegistry::JsonModuleInfo(lock,
-                    Impl::compileJsonGlobal(lock, module.getJson()))));
+        modules->add(path, [module](jsg::Lock& js) {
+          auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(js);
+          return jsg::ModuleRegistry::ModuleInfo(
+              lock,
+              module.getName(),
+              nullptr,
+              jsg::ModuleRegistry::JsonModuleInfo(lock,
+                  Impl::compileJsonGlobal(lock, module.getJson())));
+        });
         break;
       }
       case config::Worker::Module::ES_MODULE: {
-        modules->add(
-            path,
-            jsg::ModuleRegistry::ModuleInfo(
-                lock,
-                module.getName(),
-                module.getEsModule(),
-                jsg::ModuleInfoCompileOption::BUNDLE,
-                *observer));
+        modules->add(path, [module, observer = kj::addRef(*observer),
+                            codeCache = impl->moduleCodeCache](jsg::Lock& js) {
+          return jsg::ModuleRegistry::ModuleInfo(
+              js,
+              module.getName(),
+              module.getEsModule(),
+              jsg::ModuleInfoCompileOption::BUNDLE,
+              *observer,
+              codeCache);
+        });
         break;
       }
       case config::Worker::Module::COMMON_JS_MODULE: {
-        modules->add(
-            path,
-            jsg::ModuleRegistry::ModuleInfo(
-                lock,
-                module.getName(),
-                nullptr,
-                jsg::ModuleRegistry::CommonJsModuleInfo(
-                    lock,
-                    module.getName(),
-                    module.getCommonJsModule())));
+        modules->add(path, [module](jsg::Lock& js) {
+          auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(js);
+          return jsg::ModuleRegistry::ModuleInfo(
+              lock,
+              module.getName(),
+              nullptr,
+              jsg::ModuleRegistry::CommonJsModuleInfo(
+                  lock,
+                  module.getName(),
+                  module.getCommonJsModule()));
+        });
         break;
       }
       case config::Worker::Module::NODE_JS_COMPAT_MODULE: {
         KJ_REQUIRE(getFeatureFlags().getNodeJsCompat(),
             "The nodejs_compat compatibility flag is required to use the nodeJsCompatModule type.");
-        modules->add(
-            path,
-            jsg::ModuleRegistry::ModuleInfo(
-                lock,
-                module.getName(),
-                nullptr,
-                jsg::ModuleRegistry::NodeJsModuleInfo(
-                    lock,
-                    module.getName(),
-                    module.getNodeJsCompatModule())));
+        modules->add(path, [module](jsg::Lock& js) {
+          auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(js);
+          return jsg::ModuleRegistry::ModuleInfo(
+              lock,
+              module.getName(),
+              nullptr,
+              jsg::ModuleRegistry::NodeJsModuleInfo(
+                  lock,
+                  module.getName(),
+                  module.getNodeJsCompatModule()));
+        });
         break;
       }
       default: {
@@ -524,7 +540,7 @@ static v8::Local<v8::Value> createBindingValue(
 
     KJ_CASE_ONEOF(ns, Global::KvNamespace) {
       value = lock.wrap(context, jsg::alloc<api::KvNamespace>(
-          kj::Array<api::KvNamespace::AdditionalHeader>{}, ns.subrequestChannel));
+          kj::Array<api::KvNamespace::AdditionalHeader>{}, ns.subrequestChannel, ns.cache));
     }
 
     KJ_CASE_ONEOF(r2, Global::R2Bucket) {
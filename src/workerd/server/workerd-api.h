@@ -5,8 +5,10 @@
 #pragma once
 
 #include <workerd/io/worker.h>
+#include <workerd/jsg/modules.h>
 #include <workerd/server/workerd.capnp.h>
 
+namespace workerd::api { class KvCache; }
 namespace workerd::server {
 
 class WorkerdApiIsolate final: public Worker::ApiIsolate {
@@ -14,7 +16,8 @@ class WorkerdApiIsolate final: public Worker::ApiIsolate {
 public:
   WorkerdApiIsolate(jsg::V8System& v8System,
       CompatibilityFlags::Reader features,
-      IsolateLimitEnforcer& limitEnforcer);
+      IsolateLimitEnforcer& limitEnforcer,
+      kj::Maybe<const jsg::ModuleCodeCache&> moduleCodeCache = nullptr);
   ~WorkerdApiIsolate() noexcept(false);
 
   kj::Own<jsg::Lock> lock(jsg::V8StackScope& stackScope) const override;
@@ -56,6 +59,7 @@ public:
     };
     struct KvNamespace {
       uint subrequestChannel;
+      kj::Maybe<api::KvCache&> cache;
 
       KvNamespace clone() const {
         return *this;
@@ -6,6 +6,8 @@
 #include <kj/encoding.h>
 #include <kj/filesystem.h>
 #include <kj/map.h>
+#include <kj/mutex.h>
+#include <kj/thread.h>
 #include <capnp/message.h>
 #include <capnp/serialize.h>
 #include <capnp/schema-parser.h>
@@ -16,9 +18,12 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include "server.h"
+#include "listener-switch.h"
 #include <workerd/jsg/setup.h>
-#include <openssl/rand.h>
+#include <workerd/util/random.h>
 #include <workerd/io/compatibility-date.capnp.h>
+#include <atomic>
+#include <deque>
 
 #if _WIN32
 #include <iostream>
@@ -66,7 +71,9 @@ static kj::StringPtr getVersionString() {
 class EntropySourceImpl: public kj::EntropySource {
 public:
   void generate(kj::ArrayPtr<kj::byte> buffer) override {
-    KJ_ASSERT(RAND_bytes(buffer.begin(), buffer.size()) == 1);
+    // Backs crypto.getRandomValues() and crypto.randomUUID(), which mostly ask for a few bytes at
+    // a time.
+    getBufferedRandomBytes(buffer);
   }
 };
 
@@ -488,12 +495,271 @@ kj::Maybe<kj::Own<capnp::SchemaFile>> tryImportBulitin(kj::StringPtr name) {
 
 // =======================================================================================
 
+#if !_WIN32
+class ConnectionHandoff {
+  // Shares one listening socket among the event loops of several threads. The thread that owns
+  // the real listener runs the accept loop and hands each accepted connection, as a file
+  // descriptor, to the next registered thread in round-robin order. Each thread accepts from its
+  // own Receiver, which wraps the descriptors it is handed in its own event loop.
+
+public:
+  class Receiver;
+
+  kj::Own<kj::ConnectionReceiver> addThread(kj::LowLevelAsyncIoProvider& provider);
+  // Returns a receiver from which the calling thread can accept its share of the connections.
+  // The receiver must only be used from the calling thread.
+
+  kj::Promise<void> run(kj::Own<kj::ConnectionReceiver> listener);
+  // Runs the accept loop for `listener` on the calling thread.
+
+  uint getPort() const { return port.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint> port = 0;
+
+  struct State {
+    kj::Vector<Receiver*> receivers;
+    uint next = 0;
+  };
+  kj::MutexGuarded<State> state;
+
+  kj::Promise<void> acceptLoop(kj::ConnectionReceiver& listener);
+  void dispatch(int fd);
+};
+
+class ConnectionHandoff::Receiver final: public kj::ConnectionReceiver {
+public:
+  Receiver(ConnectionHandoff& handoff, kj::LowLevelAsyncIoProvider& provider)
+      : handoff(handoff), provider(provider) {
+    handoff.state.lockExclusive()->receivers.add(this);
+  }
+
+  ~Receiver() noexcept(false) {
+    {
+      auto lock = handoff.state.lockExclusive();
+      auto& receivers = lock->receivers;
+      for (auto i: kj::indices(receivers)) {
+        if (receivers[i] == this) {
+          receivers[i] = receivers.back();
+          receivers.removeLast();
+          break;
+        }
+      }
+    }
+
+    // Nothing can push to us anymore; close anything that was never accepted.
+    for (int fd: queue.getWithoutLock().fds) {
+      close(fd);
+    }
+  }
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> accept() override {
+    auto lock = queue.lockExclusive();
+    if (!lock->fds.empty()) {
+      int fd = lock->fds.front();
+      lock->fds.pop_front();
+      return provider.wrapSocketFd(fd, kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP);
+    }
+
+    auto paf = kj::newPromiseAndCrossThreadFulfiller<void>();
+    lock->waiter = kj::mv(paf.fulfiller);
+    return paf.promise.then([this]() { return accept(); });
+  }
+
+  uint getPort() override { return handoff.getPort(); }
+
+  void push(int fd) {
+    // Called from the accepting thread while it holds the handoff's state lock.
+    auto lock = queue.lockExclusive();
+    lock->fds.push_back(fd);
+    KJ_IF_MAYBE(waiter, lock->waiter) {
+      (*waiter)->fulfill();
+      lock->waiter = nullptr;
+    }
+  }
+
+private:
+  ConnectionHandoff& handoff;
+  kj::LowLevelAsyncIoProvider& provider;
+
+  struct Queue {
+    std::deque<int> fds;
+    kj::Maybe<kj::Own<kj::CrossThreadPromiseFulfiller<void>>> waiter;
+  };
+  kj::MutexGuarded<Queue> queue;
+};
+
+kj::Own<kj::ConnectionReceiver> ConnectionHandoff::addThread(
+    kj::LowLevelAsyncIoProvider& provider) {
+  return kj::heap<Receiver>(*this, provider);
+}
+
+kj::Promise<void> ConnectionHandoff::run(kj::Own<kj::ConnectionReceiver> listener) {
+  port.store(listener->getPort(), std::memory_order_relaxed);
+  auto promise = acceptLoop(*listener);
+  return promise.attach(kj::mv(listener));
+}
+
+kj::Promise<void> ConnectionHandoff::acceptLoop(kj::ConnectionReceiver& listener) {
+  return listener.accept().then([this, &listener](kj::Own<kj::AsyncIoStream> connection) {
+    KJ_IF_MAYBE(fd, connection->getFd()) {
+      // The connection closes its own descriptor when dropped, so hand off a duplicate.
+      int ownFd;
+      KJ_SYSCALL(ownFd = fcntl(*fd, F_DUPFD_CLOEXEC, 0));
+      dispatch(ownFd);
+    } else {
+      KJ_LOG(ERROR, "accepted connection has no file descriptor; dropping it");
+    }
+    return acceptLoop(listener);
+  });
+}
+
+void ConnectionHandoff::dispatch(int fd) {
+  auto lock = state.lockExclusive();
+  if (lock->receivers.empty()) {
+    close(fd);
+    return;
+  }
+  lock->receivers[lock->next++ % lock->receivers.size()]->push(fd);
+}
+
+class ActorShardLinks {
+  // Lets the Server on each serving thread open connections to the Servers on the other threads,
+  // over which it forwards requests for the Durable Objects they host (see Server::shardActors()).
+  // Each connection is a socketpair: the connecting thread keeps one end and queues the other, as
+  // a file descriptor, for the target thread to accept.
+
+public:
+  explicit ActorShardLinks(uint count);
+
+  kj::Array<kj::Own<kj::NetworkAddress>> getAddresses(kj::LowLevelAsyncIoProvider& provider);
+  // Returns an address for each shard, to be connected to from the calling thread.
+
+  kj::Own<kj::ConnectionReceiver> listen(uint index, kj::LowLevelAsyncIoProvider& provider);
+  // Returns the receiver from which shard `index` accepts the connections opened to it. Must be
+  // called once per shard, on the thread serving it. Once the receiver is destroyed, connections
+  // to the shard are closed as soon as they are opened.
+
+private:
+  class Address;
+  class Receiver;
+
+  struct Queue {
+    std::deque<int> fds;
+    kj::Maybe<kj::Own<kj::CrossThreadPromiseFulfiller<void>>> waiter;
+    bool closed = false;
+  };
+  kj::Array<kj::MutexGuarded<Queue>> queues;
+  // Indexed by shard.
+
+  void push(uint index, int fd);
+};
+
+class ActorShardLinks::Address final: public kj::NetworkAddress {
+public:
+  Address(ActorShardLinks& links, uint index, kj::LowLevelAsyncIoProvider& provider)
+      : links(links), index(index), provider(provider) {}
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> connect() override {
+    int fds[2];
+    KJ_SYSCALL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    auto stream = provider.wrapSocketFd(fds[0], kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP);
+    links.push(index, fds[1]);
+    return kj::mv(stream);
+  }
+
+  kj::Own<kj::ConnectionReceiver> listen() override {
+    // Each shard's receiver comes from ActorShardLinks::listen() instead, on the thread serving
+    // that shard.
+    KJ_FAIL_REQUIRE("can't listen on an actor shard's address; use ActorShardLinks::listen()",
+                    index);
+  }
+  kj::Own<kj::NetworkAddress> clone() override {
+    return kj::heap<Address>(links, index, provider);
+  }
+  kj::String toString() override {
+    return kj::str("actor-shard:", index);
+  }
+
+private:
+  ActorShardLinks& links;
+  uint index;
+  kj::LowLevelAsyncIoProvider& provider;
+};
+
+class ActorShardLinks::Receiver final: public kj::ConnectionReceiver {
+public:
+  Receiver(kj::MutexGuarded<Queue>& queue, kj::LowLevelAsyncIoProvider& provider)
+      : queue(queue), provider(provider) {}
+
+  ~Receiver() noexcept(false) {
+    auto lock = queue.lockExclusive();
+    lock->closed = true;
+    lock->waiter = nullptr;
+    for (int fd: lock->fds) {
+      close(fd);
+    }
+    lock->fds.clear();
+  }
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> accept() override {
+    auto lock = queue.lockExclusive();
+    if (!lock->fds.empty()) {
+      int fd = lock->fds.front();
+      lock->fds.pop_front();
+      return provider.wrapSocketFd(fd, kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP);
+    }
+
+    auto paf = kj::newPromiseAndCrossThreadFulfiller<void>();
+    lock->waiter = kj::mv(paf.fulfiller);
+    return paf.promise.then([this]() { return accept(); });
+  }
+
+  uint getPort() override { return 0; }
+
+private:
+  kj::MutexGuarded<Queue>& queue;
+  kj::LowLevelAsyncIoProvider& provider;
+};
+
+ActorShardLinks::ActorShardLinks(uint count)
+    : queues(kj::heapArray<kj::MutexGuarded<Queue>>(count)) {}
+
+kj::Array<kj::Own<kj::NetworkAddress>> ActorShardLinks::getAddresses(
+    kj::LowLevelAsyncIoProvider& provider) {
+  return KJ_MAP(i, kj::indices(queues)) -> kj::Own<kj::NetworkAddress> {
+    return kj::heap<Address>(*this, i, provider);
+  };
+}
+
+kj::Own<kj::ConnectionReceiver> ActorShardLinks::listen(
+    uint index, kj::LowLevelAsyncIoProvider& provider) {
+  return kj::heap<Receiver>(queues[index], provider);
+}
+
+void ActorShardLinks::push(uint index, int fd) {
+  auto lock = queues[index].lockExclusive();
+  if (lock->closed) {
+    // The connecting side reads EOF.
+    close(fd);
+    return;
+  }
+  lock->fds.push_back(fd);
+  KJ_IF_MAYBE(waiter, lock->waiter) {
+    (*waiter)->fulfill();
+    lock->waiter = nullptr;
+  }
+}
+#endif  // !_WIN32
+
+// =======================================================================================
+
 class CliMain: public SchemaFileImpl::ErrorReporter {
 public:
   CliMain(kj::ProcessContext& context, char** argv)
       : context(context), argv(argv),
-        server(*fs, io.provider->getTimer(), io.provider->getNetwork(), entropySource,
-            [&](kj::String error) {
+        server(kj::heap<Server>(*fs, io.provider->getTimer(), io.provider->getNetwork(),
+            entropySource, [&](kj::String error) {
           if (watcher == nullptr) {
             // TODO(someday): Don't just fail on the first error, keep going in order to report
             //   additional errors. The tricky part is we don't currently have any signal of when
@@ -507,7 +773,7 @@ public:
             hadErrors = true;
             context.error(error);
           }
-        }) {
+        })) {
     KJ_IF_MAYBE(e, exeInfo) {
       auto& exe = *e->file;
       auto size = exe.stat().size;
@@ -540,7 +806,7 @@ public:
 
     // We don't want to force people to specify top-level file IDs in `workerd` config files, as
     // those IDs would be totally irrelevant.
-    schemaParser.setFileIdsRequired(false);
+    schemaParser->setFileIdsRequired(false);
   }
 
   kj::MainFunc getMain() {
@@ -598,7 +864,11 @@ public:
         .addOption({'w', "watch"}, CLI_METHOD(watch),
                    "Watch configuration files (and server binary) and reload if they change. "
                    "Useful for development, but not recommended in production.")
-        .addOption({"experimental"}, [this]() { server.allowExperimental(); return true; },
+        .addOption({"experimental"}, [this]() {
+                     server->allowExperimental();
+                     experimental = true;
+                     return true;
+                   },
                    "Permit the use of experimental features which may break backwards "
                    "compatibility in a future release.");
   }
@@ -614,6 +884,17 @@ public:
         .addOptionWithArg({"control-fd"}, CLI_METHOD(enableControl), "<fd>",
                           "Enable sending of control messages on descriptor <fd>. Currently this "
                           "only reports the port each socket is listening on when ready.")
+        .addOption({"reload-on-sighup"}, CLI_METHOD(enableReloadOnSighup),
+                   "On SIGHUP, reload the config file without dropping connections: the new "
+                   "config's services are started (running each Worker's startup code) while "
+                   "the old ones keep serving, then all sockets switch to the new services at "
+                   "once, and the old ones drain their in-flight requests. If the new config has "
+                   "errors, the old one keeps serving. Sockets keep listening across reloads; "
+                   "`v8Flags`, `v8IdleTaskBudgetMs` and socket addresses are only read at "
+                   "startup. A config that stores Durable Objects or R2 buckets on disk can "
+                   "only be loaded once no such config is running or draining, so that two sets "
+                   "of services never open the same files; restart instead. Cannot be combined "
+                   "with --inspector-addr or `threads` > 1.")
         .callAfterParsing(CLI_METHOD(serve))
         .build();
   }
@@ -700,7 +981,7 @@ public:
 
   void overrideSocketAddr(kj::StringPtr param) {
     auto [ name, value ] = parseOverride(param);
-    server.overrideSocket(kj::mv(name), kj::str(value));
+    server->overrideSocket(kj::mv(name), kj::str(value));
   }
 
 #if _WIN32
@@ -756,28 +1037,42 @@ public:
     validateSocketFd(fd, name);
 
     inheritedFds.add(fd);
-    server.overrideSocket(kj::mv(name), io.lowLevelProvider->wrapListenSocketFd(
+    server->overrideSocket(kj::mv(name), io.lowLevelProvider->wrapListenSocketFd(
         fd, kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP));
   }
 
   void overrideDirectory(kj::StringPtr param) {
     auto [ name, value ] = parseOverride(param);
-    server.overrideDirectory(kj::mv(name), kj::str(value));
+    directoryOverrides.add(StoredOverride { kj::str(name), kj::str(value) });
+    server->overrideDirectory(kj::mv(name), kj::str(value));
   }
 
   void overrideExternal(kj::StringPtr param) {
     auto [ name, value ] = parseOverride(param);
-    server.overrideExternal(kj::mv(name), kj::str(value));
+    externalOverrides.add(StoredOverride { kj::str(name), kj::str(value) });
+    server->overrideExternal(kj::mv(name), kj::str(value));
   }
 
   void enableInspector(kj::StringPtr param) {
-    server.enableInspector(kj::str(param));
+    server->enableInspector(kj::str(param));
+    inspectorEnabled = true;
   }
 
   void enableControl(kj::StringPtr param) {
     int fd = KJ_UNWRAP_OR(param.tryParseAs<uint>(),
         CLI_ERROR("Output value must be a file descriptor (non-negative integer)."));
-    server.enableControl(fd);
+    server->enableControl(fd);
+    controlFd = fd;
+  }
+
+  void enableReloadOnSighup() {
+#if _WIN32
+    CLI_ERROR("--reload-on-sighup is not supported on Windows.");
+#else
+    // Must happen before any threads are started, which is why we don't wait until serve().
+    kj::UnixEventPort::captureSignal(SIGHUP);
+    reloadOnSighup = true;
+#endif
   }
 
   void watch() {
@@ -798,6 +1093,10 @@ public:
   }
 
   void parseConfigFile(kj::StringPtr pathStr) {
+    if (pathStr != "-") {
+      configPath = kj::str(pathStr);
+    }
+
     if (pathStr == "-") {
       // Read from stdin.
 
@@ -831,9 +1130,9 @@ public:
         configOwner = kj::mv(reader);
       } else {
         // Interpret as schema file.
-        schemaParser.loadCompiledTypeAndDependencies<config::Config>();
+        schemaParser->loadCompiledTypeAndDependencies<config::Config>();
 
-        parsedSchema = schemaParser.parseFile(
+        parsedSchema = schemaParser->parseFile(
             kj::heap<SchemaFileImpl>(fs->getRoot(), fs->getCurrentPath(),
                 kj::mv(path), nullptr, importPath, kj::mv(file), watcher, *this));
 
@@ -854,6 +1153,7 @@ public:
   }
 
   void setConstName(kj::StringPtr name) {
+    constName = kj::str(name);
     auto parent = parsedSchema;
 
     for (;;) {
@@ -1027,10 +1327,14 @@ public:
       }
     } else {
       auto config = getConfig();
-      auto platform = jsg::defaultPlatform(0);
+      auto idleTaskBudgetMs = config.getV8IdleTaskBudgetMs();
+      auto platform = jsg::defaultPlatform(0, idleTaskBudgetMs > 0);
       WorkerdPlatform v8Platform(*platform);
       jsg::V8System v8System(v8Platform,
           KJ_MAP(flag, config.getV8Flags()) -> kj::StringPtr { return flag; });
+      if (idleTaskBudgetMs > 0) {
+        v8System.enableIdleTasks(*platform, idleTaskBudgetMs * kj::MILLISECONDS);
+      }
       auto promise = func(v8System, config);
       KJ_IF_MAYBE(w, watcher) {
         promise = promise.exclusiveJoin(waitForChanges(*w).then([this]() {
@@ -1046,22 +1350,429 @@ public:
   [[noreturn]] void serve() noexcept {
     serveImpl([&](jsg::V8System& v8System, config::Config::Reader config) {
 #if _WIN32
-      return server.run(v8System, config);
+      if (config.getThreads() > 1) {
+        context.exitError("The `threads` config option is not supported on Windows.");
+      }
+      return server->run(v8System, config);
 #else
-      return server.run(v8System, config,
+      if (reloadOnSighup) {
+        if (config.getThreads() > 1) {
+          context.exitError(
+              "--reload-on-sighup cannot be used when `threads` is greater than 1.");
+        }
+        if (inspectorEnabled) {
+          context.exitError("--reload-on-sighup cannot be combined with --inspector-addr.");
+        }
+        if (configPath == nullptr) {
+          context.exitError(
+              "--reload-on-sighup requires the config to be read from a file, not stdin.");
+        }
+        return serveWithReloads(v8System, config);
+      }
+
+      kj::Promise<void> drainWhen = io.unixEventPort.onSignal(SIGTERM).ignoreResult();
+      if (config.getThreads() > 1) {
+        startServingThreads(v8System, config);
+        drainWhen = drainWhen.then([this]() {
+          for (auto& thread: servingThreads) {
+            thread->drain();
+          }
+        });
+      }
+
+      auto promise = server->run(v8System, config,
           // Gracefully drain when SIGTERM is received.
-          io.unixEventPort.onSignal(SIGTERM).ignoreResult());
+          kj::mv(drainWhen));
+      if (servingThreads.size() > 0) {
+        // This thread's Server finishing only means this thread has drained; don't exit until
+        // every other thread's Server has finished draining too.
+        promise = promise.then([this]() {
+          return kj::joinPromises(KJ_MAP(thread, servingThreads) { return thread->whenDone(); });
+        });
+      }
+      return promise;
 #endif
     });
   }
 
+#if !_WIN32
+  struct ServingGeneration {
+    // A Server started from one version of the config, while it serves and then drains. Used with
+    // --reload-on-sighup.
+
+    kj::Own<void> diskStorageHold;
+    // Counts this generation in `diskStorageGenerations` until it's destroyed, if its config
+    // stores data on disk. Declared first so that it's released after the Server is destroyed.
+
+    kj::Vector<kj::Own<void>> configState;
+    // Keeps the config this generation was started from alive after the config file has been
+    // parsed again for a newer generation. Declared before `server`, whose services point into
+    // it, so that it outlives the Server.
+
+    kj::Own<Server> server;
+    // The first generation takes over `CliMain::server`.
+
+    kj::Own<kj::PromiseFulfiller<void>> drainFulfiller;
+    kj::ForkedPromise<void> done = nullptr;
+
+    kj::Vector<kj::String> newSockets;
+    // Sockets whose ListenerSwitch was created for this generation, while it wasn't live yet.
+
+    bool live = false;
+    bool failed = false;
+  };
+
+  static kj::Maybe<kj::String> findDiskStorage(config::Config::Reader config) {
+    // Describes the first service in the config that keeps its data in files on disk, which two
+    // Servers must not have open at once.
+
+    for (auto service: config.getServices()) {
+      if (service.isR2Disk()) {
+        return kj::str("service \"", service.getName(), "\" is an R2 disk bucket");
+      }
+      if (service.isWorker() && service.getWorker().getDurableObjectStorage().isLocalDisk()) {
+        return kj::str("service \"", service.getName(), "\" stores Durable Objects on disk");
+      }
+    }
+    return nullptr;
+  }
+
+  kj::Function<Server::ListenerHook> makeListenerHook(ServingGeneration& generation) {
+    return [this, &generation](kj::StringPtr name, kj::Own<kj::ConnectionReceiver> listener)
+        -> kj::Own<kj::ConnectionReceiver> {
+      if (listenerSwitches.find(name) != nullptr || generation.failed) {
+        // Either this is the receiver reload() passed in as an override, or the Server is about
+        // to be thrown away.
+        return kj::mv(listener);
+      }
+
+      // A socket we weren't listening on before.
+      auto listenerSwitch = kj::refcounted<ListenerSwitch>(kj::mv(listener));
+      auto receiver = listenerSwitch->newReceiver();
+      if (generation.live) {
+        listenerSwitch->activate();
+      } else {
+        generation.newSockets.add(kj::str(name));
+      }
+      listenerSwitches.insert(kj::str(name), kj::mv(listenerSwitch));
+      return receiver;
+    };
+  }
+
+  void startGeneration(ServingGeneration& generation, jsg::V8System& v8System,
+                       config::Config::Reader config) {
+    if (findDiskStorage(config) != nullptr) {
+      ++diskStorageGenerations;
+      generation.diskStorageHold = kj::heap(kj::defer([this]() { --diskStorageGenerations; }));
+    }
+    auto& server = *generation.server;
+    server.setListenerHook(makeListenerHook(generation));
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    generation.drainFulfiller = kj::mv(paf.fulfiller);
+    // Server::run() starts every service, running each Worker's startup code, before returning.
+    generation.done = server.run(v8System, config, kj::mv(paf.promise)).fork();
+  }
+
+  void retireGeneration(kj::Own<ServingGeneration> generation) {
+    generation->drainFulfiller->fulfill();
+    auto promise = generation->done.addBranch();
+    retiredGenerations.add(promise.attach(kj::mv(generation)));
+  }
+
+  kj::Promise<void> serveWithReloads(jsg::V8System& v8System, config::Config::Reader config) {
+    auto& first = *currentGeneration.emplace(kj::heap<ServingGeneration>());
+    first.server = kj::mv(server);
+    first.live = true;
+    startGeneration(first, v8System, config);
+
+    for (;;) {
+      auto& current = *KJ_ASSERT_NONNULL(currentGeneration);
+      int signum = co_await io.unixEventPort.onSignal(SIGHUP)
+          .then([](siginfo_t) { return SIGHUP; })
+          .exclusiveJoin(io.unixEventPort.onSignal(SIGTERM)
+              .then([](siginfo_t) { return SIGTERM; }))
+          .exclusiveJoin(current.done.addBranch().then([]() { return 0; }));
+
+      if (signum == SIGHUP) {
+        reload(v8System);
+        continue;
+      }
+
+      if (signum == SIGTERM) {
+        // Gracefully drain.
+        current.drainFulfiller->fulfill();
+        co_await current.done.addBranch();
+      }
+      co_await retiredGenerations.onEmpty();
+      co_return;
+    }
+  }
+
+  void reload(jsg::V8System& v8System) {
+    context.warning("Reloading config...");
+
+    // The current generation's config points into these.
+    auto previousParser = kj::mv(schemaParser);
+    auto previousConfigOwner = kj::mv(configOwner);
+    auto restorePrevious = [&]() {
+      schemaParser = kj::mv(previousParser);
+      configOwner = kj::mv(previousConfigOwner);
+      context.warning("Config reload failed; still serving the previous config.");
+    };
+
+    auto maybeConfig = reparseConfig();
+    auto config = KJ_UNWRAP_OR(maybeConfig, {
+      restorePrevious();
+      return;
+    });
+    if (config.getThreads() > 1) {
+      context.warning("`threads` cannot be greater than 1 with --reload-on-sighup.");
+      restorePrevious();
+      return;
+    }
+    KJ_IF_MAYBE(storage, findDiskStorage(config)) {
+      if (diskStorageGenerations > 0) {
+        // The new Server would open the same SQLite databases and R2 files while the old one still
+        // has them open, and both would write to them.
+        context.warning(kj::str("Can't reload because ", *storage, ", and a config that stores "
+            "data on disk is still running. Restart workerd to apply the new config."));
+        restorePrevious();
+        return;
+      }
+    }
+
+    auto generation = kj::heap<ServingGeneration>();
+    auto& generationRef = *generation;
+    generation->server = kj::heap<Server>(*fs, io.provider->getTimer(),
+        io.provider->getNetwork(), entropySource, [this, &generationRef](kj::String error) {
+      generationRef.failed = true;
+      context.warning(error);
+    });
+    auto& newServer = *generation->server;
+    if (experimental) {
+      newServer.allowExperimental();
+    }
+    for (auto& override: directoryOverrides) {
+      newServer.overrideDirectory(kj::str(override.name), kj::str(override.value));
+    }
+    for (auto& override: externalOverrides) {
+      newServer.overrideExternal(kj::str(override.name), kj::str(override.value));
+    }
+    KJ_IF_MAYBE(fd, controlFd) {
+      newServer.enableControl(*fd);
+    }
+    for (auto sock: config.getSockets()) {
+      KJ_IF_MAYBE(listenerSwitch, listenerSwitches.find(kj::StringPtr(sock.getName()))) {
+        newServer.overrideSocket(kj::str(sock.getName()), (*listenerSwitch)->newReceiver());
+      }
+    }
+
+    startGeneration(*generation, v8System, config);
+
+    if (generation->failed) {
+      for (auto& entry: listenerSwitches) {
+        entry.value->abandonNext();
+      }
+      for (auto& name: generation->newSockets) {
+        KJ_IF_MAYBE(listenerSwitch, listenerSwitches.find(name)) {
+          (*listenerSwitch)->retire();
+        }
+        listenerSwitches.erase(name);
+      }
+      generation->configState.add(kj::mv(schemaParser));
+      generation->configState.add(kj::mv(configOwner));
+      retireGeneration(kj::mv(generation));
+      restorePrevious();
+      return;
+    }
+
+    // Go live: from here on, every new connection goes to the new services.
+    generation->live = true;
+    kj::Vector<kj::String> removedSockets;
+    for (auto& entry: listenerSwitches) {
+      if (entry.value->hasNext()) {
+        entry.value->activate();
+      } else {
+        entry.value->retire();
+        removedSockets.add(kj::str(entry.key));
+      }
+    }
+    for (auto& name: removedSockets) {
+      listenerSwitches.erase(name);
+    }
+
+    auto& current = *KJ_ASSERT_NONNULL(currentGeneration);
+    current.configState.add(kj::mv(previousParser));
+    current.configState.add(kj::mv(previousConfigOwner));
+    retireGeneration(kj::mv(KJ_ASSERT_NONNULL(currentGeneration)));
+    currentGeneration = kj::mv(generation);
+    context.warning("Config reloaded; draining requests on the previous config.");
+  }
+
+  kj::Maybe<config::Config::Reader> reparseConfig() {
+    // Parses the config file again from scratch, reporting any errors as warnings. The previous
+    // parser state must have been moved elsewhere.
+
+    schemaParser = kj::heap<capnp::SchemaParser>();
+    schemaParser->setFileIdsRequired(false);
+    parsedSchema = {};
+    topLevelConfigConstants.clear();
+    config = nullptr;
+
+    reloading = true;
+    KJ_DEFER(reloading = false);
+    hadErrors = false;
+
+    try {
+      parseConfigFile(kj::str(KJ_ASSERT_NONNULL(configPath)));
+      KJ_IF_MAYBE(name, constName) {
+        setConstName(kj::str(*name));
+      }
+    } catch (CliError& e) {
+      context.warning(e.description);
+      return nullptr;
+    } catch (kj::Exception& e) {
+      context.warning(e.getDescription());
+      return nullptr;
+    }
+    if (hadErrors) {
+      return nullptr;
+    }
+
+    KJ_IF_MAYBE(c, config) {
+      return *c;
+    } else if (topLevelConfigConstants.size() == 1) {
+      return config.emplace(topLevelConfigConstants[0].as<config::Config>());
+    } else {
+      context.warning("The config file must define exactly one top-level constant of type "
+                      "'Config', or the constant to use must be given on the command line.");
+      return nullptr;
+    }
+  }
+
+  void startServingThreads(jsg::V8System& v8System, config::Config::Reader config) {
+    // Starts `config.threads - 1` additional threads, each running its own Server with the same
+    // config, and arranges for all threads (including this one) to share every socket's listener
+    // and to split the actors of every Durable Object namespace between them.
+
+    for (auto service: config.getServices()) {
+      if (service.isR2Disk()) {
+        context.exitError(kj::str(
+            "Service \"", service.getName(), "\" is an R2 disk bucket, which cannot currently be "
+            "used when `threads` is greater than 1."));
+      }
+    }
+
+    for (auto sock: config.getSockets()) {
+      handoffs.insert(kj::str(sock.getName()), kj::heap<ConnectionHandoff>());
+    }
+
+    // This thread serves shard 0; each additional thread serves the shard numbered after it.
+    auto& links = *actorShardLinks.emplace(kj::heap<ActorShardLinks>(config.getThreads()));
+    server->shardActors(0, links.getAddresses(*io.lowLevelProvider),
+                        links.listen(0, *io.lowLevelProvider));
+
+    server->setListenerHook([this](kj::StringPtr name, kj::Own<kj::ConnectionReceiver> listener) {
+      auto& handoff = *KJ_ASSERT_NONNULL(handoffs.find(name));
+      auto acceptLoop = handoff.run(kj::mv(listener)).eagerlyEvaluate([](kj::Exception&& e) {
+        KJ_LOG(ERROR, "accept loop failed", e);
+      });
+      return handoff.addThread(*io.lowLevelProvider).attach(kj::mv(acceptLoop));
+    });
+
+    auto threads = kj::heapArrayBuilder<kj::Own<ServingThread>>(config.getThreads() - 1);
+    for (auto i: kj::range(1u, config.getThreads())) {
+      threads.add(kj::heap<ServingThread>(*this, v8System, config, i));
+    }
+    servingThreads = threads.finish();
+  }
+
+  class ServingThread {
+    // An additional thread serving the same config as the main thread. See the `threads` option
+    // in workerd.capnp.
+  public:
+    ServingThread(CliMain& main, jsg::V8System& v8System, config::Config::Reader config,
+                  uint index)
+        : thread([this, &main, &v8System, config, index]() {
+      KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+        run(main, v8System, config, index);
+      })) {
+        KJ_LOG(FATAL, "serving thread failed", *exception);
+        abort();
+      }
+      done.fulfiller->fulfill();
+    }) {}
+
+    kj::Promise<void> whenDone() {
+      // Resolves (on the main thread) once this thread's Server has finished draining. May only be
+      // called once.
+      return kj::mv(done.promise);
+    }
+
+    void drain() {
+      auto lock = drainFulfiller.lockExclusive();
+      KJ_IF_MAYBE(fulfiller, *lock) {
+        (*fulfiller)->fulfill();
+      }
+      draining = true;
+    }
+
+  private:
+    kj::MutexGuarded<kj::Maybe<kj::Own<kj::CrossThreadPromiseFulfiller<void>>>> drainFulfiller;
+    bool draining = false;  // protected by drainFulfiller's lock
+    kj::PromiseCrossThreadFulfillerPair<void> done = kj::newPromiseAndCrossThreadFulfiller<void>();
+    kj::Thread thread;  // must be last, so that the thread is joined before the rest is destroyed
+
+    void run(CliMain& main, jsg::V8System& v8System, config::Config::Reader config,
+             uint index) {
+      auto io = kj::setupAsyncIo();
+      auto fs = kj::newDiskFilesystem();
+      EntropySourceImpl entropySource;
+
+      Server server(*fs, io.provider->getTimer(), io.provider->getNetwork(), entropySource,
+          [](kj::String error) {
+        // The main thread loads the same config and will report (and exit on) the same errors.
+        KJ_LOG(ERROR, error);
+      });
+
+      if (main.experimental) {
+        server.allowExperimental();
+      }
+      for (auto& override: main.directoryOverrides) {
+        server.overrideDirectory(kj::str(override.name), kj::str(override.value));
+      }
+      for (auto& override: main.externalOverrides) {
+        server.overrideExternal(kj::str(override.name), kj::str(override.value));
+      }
+      for (auto& handoff: main.handoffs) {
+        server.overrideSocket(kj::str(handoff.key), handoff.value->addThread(*io.lowLevelProvider));
+      }
+      auto& links = *KJ_ASSERT_NONNULL(main.actorShardLinks);
+      server.shardActors(index, links.getAddresses(*io.lowLevelProvider),
+                         links.listen(index, *io.lowLevelProvider));
+
+      auto paf = kj::newPromiseAndCrossThreadFulfiller<void>();
+      {
+        auto lock = drainFulfiller.lockExclusive();
+        if (draining) {
+          paf.fulfiller->fulfill();
+        } else {
+          *lock = kj::mv(paf.fulfiller);
+        }
+      }
+
+      server.run(v8System, config, kj::mv(paf.promise)).wait(io.waitScope);
+    }
+  };
+#endif  // !_WIN32
+
   [[noreturn]] void test() noexcept {
     // Always turn on info logging when running tests so that uncaught exceptions are displayed.
     // TODO(beta): This can be removed once we improve our error logging story.
     kj::_::Debug::setLogLevel(kj::LogSeverity::INFO);
 
     serveImpl([&](jsg::V8System& v8System, config::Config::Reader config) {
-      return server.test(v8System, config,
+      return server->test(v8System, config,
           testServicePattern.map([](auto& s) -> kj::StringPtr { return s; }).orDefault("*"_kj),
           testEntrypointPattern.map([](auto& s) -> kj::StringPtr { return s; }).orDefault("*"_kj))
           .then([this](bool result) -> kj::Promise<void> {
@@ -1126,7 +1837,7 @@ private:
   EntropySourceImpl entropySource;
 
   kj::Vector<kj::Path> importPath;
-  capnp::SchemaParser schemaParser;
+  kj::Own<capnp::SchemaParser> schemaParser = kj::heap<capnp::SchemaParser>();
   capnp::ParsedSchema parsedSchema;
   kj::Vector<capnp::ConstSchema> topLevelConfigConstants;
 
@@ -1135,10 +1846,56 @@ private:
 
   kj::Vector<int> inheritedFds;
 
+  struct StoredOverride {
+    kj::String name;
+    kj::String value;
+  };
+  bool experimental = false;
+  kj::Vector<StoredOverride> directoryOverrides;
+  kj::Vector<StoredOverride> externalOverrides;
+  // Copies of command-line settings which must also be applied to the Servers of additional
+  // serving threads.
+
+#if !_WIN32
+  kj::HashMap<kj::String, kj::Own<ConnectionHandoff>> handoffs;
+  kj::Maybe<kj::Own<ActorShardLinks>> actorShardLinks;
+  kj::Array<kj::Own<ServingThread>> servingThreads;
+  // Used when the config's `threads` is greater than 1. `handoffs` is keyed by socket name.
+#endif
+
   kj::Maybe<kj::String> testServicePattern;
   kj::Maybe<kj::String> testEntrypointPattern;
 
-  Server server;
+  kj::Maybe<kj::String> configPath;
+  kj::Maybe<kj::String> constName;
+  // As given on the command line, so that the config can be parsed again on reload. `configPath`
+  // is null if the config was read from stdin or compiled in.
+
+  bool reloadOnSighup = false;
+  bool reloading = false;
+  bool inspectorEnabled = false;
+  kj::Maybe<uint> controlFd;
+
+  kj::Own<Server> server;
+  // With --reload-on-sighup, handed over to the first ServingGeneration once serving starts.
+
+#if !_WIN32
+  struct LogRetiredGenerationErrors final: public kj::TaskSet::ErrorHandler {
+    void taskFailed(kj::Exception&& exception) override {
+      KJ_LOG(ERROR, "previous config failed while draining", exception);
+    }
+  };
+  LogRetiredGenerationErrors retiredGenerationErrorHandler;
+  kj::TaskSet retiredGenerations { retiredGenerationErrorHandler };
+  // Generations replaced by a reload, until they finish draining.
+
+  kj::Maybe<kj::Own<ServingGeneration>> currentGeneration;
+  kj::HashMap<kj::String, kj::Own<ListenerSwitch>> listenerSwitches;
+  uint diskStorageGenerations = 0;
+  // Used with --reload-on-sighup. `listenerSwitches` is keyed by socket name.
+  // `diskStorageGenerations` counts the running or draining generations whose config stores data
+  // on disk.
+#endif
 
   static constexpr uint64_t COMPILED_MAGIC_SUFFIX[2] = {
     // This is a randomly-generated 128-bit number that identifies when a binary has been compiled
@@ -1248,12 +2005,20 @@ private:
   void reportParsingError(kj::StringPtr file,
       capnp::SchemaFile::SourcePos start, capnp::SchemaFile::SourcePos end,
       kj::StringPtr message) override {
+    kj::String error;
     if (start.line == end.line && start.column < end.column) {
-      context.error(kj::str(
-          file, ":", start.line+1, ":", start.column+1, "-", end.column+1,  ": ", message));
+      error = kj::str(
+          file, ":", start.line+1, ":", start.column+1, "-", end.column+1,  ": ", message);
+    } else {
+      error = kj::str(
+          file, ":", start.line+1, ":", start.column+1, ": ", message);
+    }
+
+    if (reloading) {
+      // A bad reload shouldn't make the process exit with an error status later.
+      context.warning(error);
     } else {
-      context.error(kj::str(
-          file, ":", start.line+1, ":", start.column+1, ": ", message));
+      context.error(error);
     }
 
     hadErrors = true;
@@ -0,0 +1,59 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+// Measures the cost of taking and releasing `Worker::AsyncLock` with and without cross-thread
+// contention on the isolate's wait queue.
+
+#include <kj/thread.h>
+#include <kj/vector.h>
+#include "bench.h"
+#include "test-fixture.h"
+
+namespace workerd {
+namespace {
+
+void takeLocks(const Worker& worker, uint64_t count) {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  for (auto i KJ_UNUSED: kj::zeroTo(count)) {
+    auto lock = worker.takeAsyncLockWithoutRequest(nullptr).wait(waitScope);
+  }
+}
+
+void runContended(bench::State& state, uint threadCount) {
+  state.pauseTiming();
+  TestFixture fixture;
+  auto& worker = fixture.getWorker();
+  auto perThread = kj::max(state.iterations() / threadCount, uint64_t(1));
+  state.resumeTiming();
+
+  // Note that thread startup is included in the measurement; it's amortized away as the harness
+  // scales up the iteration count.
+  kj::Vector<kj::Own<kj::Thread>> threads(threadCount);
+  for (auto i KJ_UNUSED: kj::zeroTo(threadCount)) {
+    threads.add(kj::heap<kj::Thread>([&worker, perThread]() { takeLocks(worker, perThread); }));
+  }
+  threads.clear();  // joins
+
+  state.pauseTiming();
+}
+
+WD_BENCHMARK("AsyncLock/uncontended") {
+  state.pauseTiming();
+  TestFixture fixture;
+  auto& worker = fixture.getWorker();
+  state.resumeTiming();
+
+  takeLocks(worker, state.iterations());
+
+  state.pauseTiming();
+}
+
+WD_BENCHMARK("AsyncLock/contended/2") { runContended(state, 2); }
+WD_BENCHMARK("AsyncLock/contended/4") { runContended(state, 4); }
+WD_BENCHMARK("AsyncLock/contended/8") { runContended(state, 8); }
+WD_BENCHMARK("AsyncLock/contended/16") { runContended(state, 16); }
+
+}  // namespace
+}  // namespace workerd
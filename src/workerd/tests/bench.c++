@@ -0,0 +1,157 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "bench.h"
+#include <kj/debug.h>
+#include <kj/io.h>
+#include <kj/main.h>
+#include <kj/miniposix.h>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+namespace workerd::bench {
+namespace {
+
+std::atomic<uint64_t> allocationCount { 0 };
+// Incremented by our replacement operator new, below.
+
+uint64_t getAllocationCount() {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+Benchmark* Benchmark::head = nullptr;
+
+Benchmark::Benchmark(const char* name, const char* file, uint line)
+    : name(name), file(file), line(line), next(head) {
+  head = this;
+}
+
+void State::pauseTiming() {
+  KJ_IF_MAYBE(since, runningSince) {
+    elapsed += kj::systemPreciseMonotonicClock().now() - *since;
+    allocations += getAllocationCount() - allocationsSince;
+    runningSince = nullptr;
+  }
+}
+
+void State::resumeTiming() {
+  if (runningSince == nullptr) {
+    allocationsSince = getAllocationCount();
+    runningSince = kj::systemPreciseMonotonicClock().now();
+  }
+}
+
+class BenchmarkMain {
+public:
+  explicit BenchmarkMain(kj::ProcessContext& context): context(context) {}
+
+  kj::MainFunc getMain() {
+    return kj::MainBuilder(context, "workerd benchmark", "Runs micro-benchmarks.")
+        .addOptionWithArg({'f', "filter"}, KJ_BIND_METHOD(*this, setFilter), "<text>",
+            "Only run benchmarks whose name contains <text>.")
+        .addOptionWithArg({'t', "min-time"}, KJ_BIND_METHOD(*this, setMinTime), "<ms>",
+            "Scale iterations until each benchmark runs for at least <ms> milliseconds. "
+            "Default: 500")
+        .callAfterParsing(KJ_BIND_METHOD(*this, run))
+        .build();
+  }
+
+  kj::MainBuilder::Validity setFilter(kj::StringPtr value) {
+    filter = kj::str(value);
+    return true;
+  }
+
+  kj::MainBuilder::Validity setMinTime(kj::StringPtr value) {
+    char* end;
+    auto ms = strtoul(value.cStr(), &end, 10);
+    if (value.size() == 0 || *end != '\0' || ms == 0) {
+      return "min-time must be a positive integer";
+    }
+    minTime = ms * kj::MILLISECONDS;
+    return true;
+  }
+
+  kj::MainBuilder::Validity run() {
+    for (auto b = Benchmark::head; b != nullptr; b = b->next) {
+      if (strstr(b->name, filter.cStr()) == nullptr) continue;
+      runOne(*b);
+    }
+    return true;
+  }
+
+private:
+  kj::ProcessContext& context;
+  kj::String filter = kj::str();
+  kj::Duration minTime = 500 * kj::MILLISECONDS;
+
+  void runOne(Benchmark& benchmark) {
+    uint64_t iterations = 1;
+    for (;;) {
+      State state(iterations);
+      state.resumeTiming();
+      benchmark.run(state);
+      state.pauseTiming();
+
+      if (state.elapsed >= minTime || iterations >= (uint64_t(1) << 40)) {
+        report(benchmark, state);
+        return;
+      }
+
+      // Estimate how many iterations we need, overshooting a bit, but at most 10x per round.
+      double ns = state.elapsed / kj::NANOSECONDS;
+      double target = minTime / kj::NANOSECONDS;
+      uint64_t next = ns <= 0 ? iterations * 10 : uint64_t(iterations * target * 1.2 / ns);
+      iterations = kj::max(iterations + 1, kj::min(next, iterations * 10));
+    }
+  }
+
+  void report(Benchmark& benchmark, State& state) {
+    double ns = state.elapsed / kj::NANOSECONDS;
+    auto nsPerOp = ns / state.iterations_;
+    kj::String throughput;
+    if (state.bytesProcessed > 0) {
+      throughput = kj::str(", \"bytesPerSecond\": ", uint64_t(state.bytesProcessed * 1e9 / ns));
+    }
+    kj::String allocations;
+    if (state.itemsProcessed > 0) {
+      allocations = kj::str(
+          ", \"itemsPerSecond\": ", uint64_t(state.itemsProcessed * 1e9 / ns),
+          ", \"allocsPerItem\": ", double(state.allocations) / state.itemsProcessed);
+    } else {
+      allocations = kj::str(
+          ", \"allocsPerOp\": ", double(state.allocations) / state.iterations_);
+    }
+    auto line = kj::str(
+        "{\"name\": \"", benchmark.name,
+        "\", \"iterations\": ", state.iterations_,
+        ", \"nsPerOp\": ", nsPerOp, throughput, allocations, "}\n");
+    kj::FdOutputStream(STDOUT_FILENO).write(line.begin(), line.size());
+  }
+};
+
+}  // namespace workerd::bench
+
+// Replacement global allocation functions, so that benchmarks can report allocation counts. The
+// array, nothrow and sized variants all forward to these by default.
+
+void* operator new(size_t size) {
+  workerd::bench::allocationCount.fetch_add(1, std::memory_order_relaxed);
+  void* result = malloc(size == 0 ? 1 : size);
+  if (result == nullptr) throw std::bad_alloc();
+  return result;
+}
+
+void operator delete(void* pointer) noexcept {
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+  free(pointer);
+}
+
+KJ_MAIN(workerd::bench::BenchmarkMain);
@@ -0,0 +1,92 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+// Minimal micro-benchmark harness.
+//
+// Benchmarks are declared much like KJ_TEST()s:
+//
+//     WD_BENCHMARK("frobnicate") {
+//       for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+//         frobnicate();
+//       }
+//     }
+//
+// and built using `wd_cc_benchmark()` from `build/wd_cc_benchmark.bzl`, which links in a main()
+// that runs every benchmark (or those matching `--filter`), scaling the iteration count until each
+// run takes at least `--min-time` milliseconds. Results are written to stdout one JSON object per
+// line so that they are easy to compare across builds.
+//
+// The harness replaces the global operator new, so every result also reports how many heap
+// allocations the timed part of the benchmark made. (Allocations made by V8 on its own heap are not
+// counted.)
+
+#include <kj/common.h>
+#include <kj/string.h>
+#include <kj/time.h>
+
+namespace workerd::bench {
+
+class State {
+public:
+  explicit State(uint64_t iterations): iterations_(iterations) {}
+
+  uint64_t iterations() const { return iterations_; }
+  // Number of times the benchmark body should perform the operation being measured.
+
+  void setBytesProcessed(uint64_t bytes) { bytesProcessed = bytes; }
+  // Report the total number of bytes processed across all iterations, to get a throughput figure.
+
+  void setItemsProcessed(uint64_t items) { itemsProcessed = items; }
+  // Report the total number of items (e.g. stream chunks) processed across all iterations, to get
+  // an items-per-second figure and allocations per item rather than per iteration.
+
+  void pauseTiming();
+  void resumeTiming();
+  // Exclude setup or teardown within the benchmark body from the measurement.
+
+  kj::Duration getElapsed() const { return elapsed; }
+  uint64_t getBytesProcessed() const { return bytesProcessed; }
+  uint64_t getItemsProcessed() const { return itemsProcessed; }
+  uint64_t getAllocations() const { return allocations; }
+
+private:
+  uint64_t iterations_;
+  uint64_t bytesProcessed = 0;
+  uint64_t itemsProcessed = 0;
+  uint64_t allocations = 0;
+  kj::Duration elapsed = 0 * kj::NANOSECONDS;
+  kj::Maybe<kj::TimePoint> runningSince;
+  uint64_t allocationsSince = 0;
+
+  friend class BenchmarkMain;
+};
+
+class Benchmark {
+public:
+  Benchmark(const char* name, const char* file, uint line);
+
+  virtual void run(State& state) = 0;
+
+private:
+  const char* name;
+  const char* file;
+  uint line;
+  Benchmark* next;
+
+  static Benchmark* head;
+  friend class BenchmarkMain;
+};
+
+}  // namespace workerd::bench
+
+#define WD_BENCHMARK(name) \
+  class KJ_UNIQUE_NAME(Benchmark): public ::workerd::bench::Benchmark { \
+  public: \
+    KJ_UNIQUE_NAME(Benchmark)(): ::workerd::bench::Benchmark(name, __FILE__, __LINE__) {} \
+    void run(::workerd::bench::State& state) override; \
+  }; \
+  KJ_UNIQUE_NAME(Benchmark) KJ_UNIQUE_NAME(benchmark_); \
+  void KJ_UNIQUE_NAME(Benchmark)::run(::workerd::bench::State& state)
+// Declares a benchmark. The body receives a `workerd::bench::State& state`.
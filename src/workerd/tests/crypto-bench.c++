@@ -0,0 +1,284 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+// Measures the Web Crypto and node:crypto implementations: digests, HMAC, AES-GCM, ECDSA, Ed25519,
+// RSA, PBKDF2 and HKDF. Each iteration performs one operation, so `itemsPerSecond` is operations
+// per second; benchmarks over a fixed-size input also report `bytesPerSecond`.
+//
+// The Web Crypto workloads are written in JavaScript and run as a single request in a fresh
+// TestFixture, so they include the cost of the bindings and of settling each promise. The
+// node:crypto benchmarks call the CryptoImpl entry points directly, since the node:crypto modules
+// can't be loaded into the fixture's script, and the JavaScript layer on top of them is thin.
+
+#include "bench.h"
+#include "test-fixture.h"
+#include <workerd/api/node/crypto.h>
+
+namespace workerd {
+namespace {
+
+constexpr auto PRELUDE = R"(
+  function data(size) {
+    const bytes = new Uint8Array(size);
+    for (let i = 0; i < size; i++) bytes[i] = i * 31 + 7;
+    return bytes;
+  }
+
+  async function repeat(n, op) {
+    for (let i = 0; i < n; i++) await op();
+  }
+)"_kj;
+// Helpers available to every workload.
+
+void runCryptoBenchmark(bench::State& state, kj::StringPtr workload, size_t inputSize) {
+  // `workload` is the source of an async JS function taking (count, inputSize), which must perform
+  // `count` operations on inputs of `inputSize` bytes. Setup such as key generation is included in
+  // the measurement, but is amortized away as the harness scales up the iteration count.
+
+  state.pauseTiming();
+  TestFixture fixture;
+  auto script = kj::str(PRELUDE, "(", workload, ")(", state.iterations(), ", ", inputSize, ");");
+  state.resumeTiming();
+
+  fixture.runInIoContext([&](const TestFixture::Environment& env) {
+    auto result = env.compileAndRunScript(script);
+    KJ_REQUIRE(result->IsPromise(), "workload must be an async function");
+    auto promise = env.js.toPromise(result.As<v8::Promise>())
+        .then(env.js, [](jsg::Lock&, jsg::Value) {});
+    return env.context.awaitJs(kj::mv(promise));
+  });
+
+  state.pauseTiming();
+  state.setItemsProcessed(state.iterations());
+  state.setBytesProcessed(state.iterations() * inputSize);
+}
+
+WD_BENCHMARK("crypto/subtle/digest/SHA-256/64B") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const input = data(size);
+    await repeat(n, () => crypto.subtle.digest('SHA-256', input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/digest/SHA-256/64KiB") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const input = data(size);
+    await repeat(n, () => crypto.subtle.digest('SHA-256', input));
+  })", 65536);
+}
+
+WD_BENCHMARK("crypto/DigestStream/SHA-256/64KiB") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const stream = new crypto.DigestStream('SHA-256');
+    const writer = stream.getWriter();
+    const input = data(size);
+    await repeat(n, () => writer.write(input));
+    await writer.close();
+    await stream.digest;
+  })", 65536);
+}
+
+WD_BENCHMARK("crypto/subtle/sign/HMAC-SHA-256/64B") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const key = await crypto.subtle.importKey('raw', data(32),
+        { name: 'HMAC', hash: 'SHA-256' }, false, ['sign']);
+    const input = data(size);
+    await repeat(n, () => crypto.subtle.sign('HMAC', key, input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/encrypt/AES-GCM/1KiB") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const key = await crypto.subtle.importKey('raw', data(16), 'AES-GCM', false, ['encrypt']);
+    const iv = data(12);
+    const input = data(size);
+    await repeat(n, () => crypto.subtle.encrypt({ name: 'AES-GCM', iv }, key, input));
+  })", 1024);
+}
+
+WD_BENCHMARK("crypto/subtle/encrypt/AES-GCM/64KiB") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const key = await crypto.subtle.importKey('raw', data(16), 'AES-GCM', false, ['encrypt']);
+    const iv = data(12);
+    const input = data(size);
+    await repeat(n, () => crypto.subtle.encrypt({ name: 'AES-GCM', iv }, key, input));
+  })", 65536);
+}
+
+WD_BENCHMARK("crypto/subtle/sign/ECDSA-P-256") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const { privateKey } = await crypto.subtle.generateKey(
+        { name: 'ECDSA', namedCurve: 'P-256' }, false, ['sign', 'verify']);
+    const input = data(size);
+    const params = { name: 'ECDSA', hash: 'SHA-256' };
+    await repeat(n, () => crypto.subtle.sign(params, privateKey, input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/verify/ECDSA-P-256") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const { privateKey, publicKey } = await crypto.subtle.generateKey(
+        { name: 'ECDSA', namedCurve: 'P-256' }, false, ['sign', 'verify']);
+    const input = data(size);
+    const params = { name: 'ECDSA', hash: 'SHA-256' };
+    const signature = await crypto.subtle.sign(params, privateKey, input);
+    await repeat(n, () => crypto.subtle.verify(params, publicKey, signature, input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/sign/Ed25519") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const { privateKey } = await crypto.subtle.generateKey('Ed25519', false, ['sign', 'verify']);
+    const input = data(size);
+    await repeat(n, () => crypto.subtle.sign('Ed25519', privateKey, input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/verify/Ed25519") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const { privateKey, publicKey } =
+        await crypto.subtle.generateKey('Ed25519', false, ['sign', 'verify']);
+    const input = data(size);
+    const signature = await crypto.subtle.sign('Ed25519', privateKey, input);
+    await repeat(n, () => crypto.subtle.verify('Ed25519', publicKey, signature, input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/sign/RSA-PSS-2048") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const { privateKey } = await crypto.subtle.generateKey(
+        { name: 'RSA-PSS', modulusLength: 2048, publicExponent: new Uint8Array([1, 0, 1]),
+          hash: 'SHA-256' }, false, ['sign', 'verify']);
+    const input = data(size);
+    const params = { name: 'RSA-PSS', saltLength: 32 };
+    await repeat(n, () => crypto.subtle.sign(params, privateKey, input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/verify/RSA-PSS-2048") {
+  runCryptoBenchmark(state, R"(async (n, size) => {
+    const { privateKey, publicKey } = await crypto.subtle.generateKey(
+        { name: 'RSA-PSS', modulusLength: 2048, publicExponent: new Uint8Array([1, 0, 1]),
+          hash: 'SHA-256' }, false, ['sign', 'verify']);
+    const input = data(size);
+    const params = { name: 'RSA-PSS', saltLength: 32 };
+    const signature = await crypto.subtle.sign(params, privateKey, input);
+    await repeat(n, () => crypto.subtle.verify(params, publicKey, signature, input));
+  })", 64);
+}
+
+WD_BENCHMARK("crypto/subtle/generateKey/RSA-2048") {
+  // Runs on the crypto thread pool; see also the concurrent variant below.
+  runCryptoBenchmark(state, R"(async (n) => {
+    const params = { name: 'RSA-PSS', modulusLength: 2048,
+                     publicExponent: new Uint8Array([1, 0, 1]), hash: 'SHA-256' };
+    await repeat(n, () => crypto.subtle.generateKey(params, false, ['sign', 'verify']));
+  })", 0);
+}
+
+WD_BENCHMARK("crypto/subtle/generateKey/RSA-2048/concurrent") {
+  runCryptoBenchmark(state, R"(async (n) => {
+    const params = { name: 'RSA-PSS', modulusLength: 2048,
+                     publicExponent: new Uint8Array([1, 0, 1]), hash: 'SHA-256' };
+    const ops = [];
+    for (let i = 0; i < n; i++) ops.push(crypto.subtle.generateKey(params, false, ['sign']));
+    await Promise.all(ops);
+  })", 0);
+}
+
+constexpr auto PBKDF2_WORKLOAD = R"(async (n) => {
+  const key = await crypto.subtle.importKey('raw', data(16), 'PBKDF2', false, ['deriveBits']);
+  const params = { name: 'PBKDF2', hash: 'SHA-256', salt: data(16), iterations: 10000 };
+  await repeat(n, () => crypto.subtle.deriveBits(params, key, 256));
+})"_kj;
+
+WD_BENCHMARK("crypto/subtle/deriveBits/PBKDF2-SHA-256/10000") {
+  runCryptoBenchmark(state, PBKDF2_WORKLOAD, 0);
+}
+
+WD_BENCHMARK("crypto/subtle/deriveBits/PBKDF2-SHA-256/10000/concurrent") {
+  runCryptoBenchmark(state, R"(async (n) => {
+    const key = await crypto.subtle.importKey('raw', data(16), 'PBKDF2', false, ['deriveBits']);
+    const params = { name: 'PBKDF2', hash: 'SHA-256', salt: data(16), iterations: 10000 };
+    const ops = [];
+    for (let i = 0; i < n; i++) ops.push(crypto.subtle.deriveBits(params, key, 256));
+    await Promise.all(ops);
+  })", 0);
+}
+
+WD_BENCHMARK("crypto/subtle/deriveBits/HKDF-SHA-256") {
+  runCryptoBenchmark(state, R"(async (n) => {
+    const key = await crypto.subtle.importKey('raw', data(32), 'HKDF', false, ['deriveBits']);
+    const params = { name: 'HKDF', hash: 'SHA-256', salt: data(16), info: data(16) };
+    await repeat(n, () => crypto.subtle.deriveBits(params, key, 256));
+  })", 0);
+}
+
+// -----------------------------------------------------------------------------
+// node:crypto
+
+kj::Array<kj::byte> borrow(kj::ArrayPtr<kj::byte> bytes) {
+  // The bindings take buffer arguments as kj::Array<kj::byte>s that share the caller's memory, so
+  // don't copy them here either.
+  return kj::Array<kj::byte>(bytes.begin(), bytes.size(), kj::NullArrayDisposer::instance);
+}
+
+template <typename Func>
+void runNodeCryptoBenchmark(bench::State& state, size_t inputSize, Func&& func) {
+  // Calls `func(js, cryptoImpl, input)` once per iteration inside a request.
+
+  state.pauseTiming();
+  TestFixture fixture;
+  fixture.runInIoContext([&](const TestFixture::Environment& env) {
+    auto cryptoImpl = jsg::alloc<api::node::CryptoImpl>();
+    auto input = kj::heapArray<kj::byte>(inputSize);
+    for (auto i: kj::indices(input)) input[i] = i * 31 + 7;
+
+    state.resumeTiming();
+    for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+      func(env.js, *cryptoImpl, input.asPtr());
+    }
+    state.pauseTiming();
+  });
+
+  state.setItemsProcessed(state.iterations());
+  state.setBytesProcessed(state.iterations() * inputSize);
+}
+
+WD_BENCHMARK("crypto/node/hash/sha256/64B") {
+  runNodeCryptoBenchmark(state, 64,
+      [](jsg::Lock&, api::node::CryptoImpl& impl, kj::ArrayPtr<kj::byte> input) {
+    impl.oneShotHash(kj::str("sha256"), borrow(input));
+  });
+}
+
+WD_BENCHMARK("crypto/node/createHash/sha256/64B") {
+  runNodeCryptoBenchmark(state, 64,
+      [](jsg::Lock& js, api::node::CryptoImpl&, kj::ArrayPtr<kj::byte> input) {
+    auto handle = api::node::CryptoImpl::HashHandle::constructor(js, kj::str("sha256"), nullptr);
+    handle->update(js, borrow(input));
+    handle->digest(js);
+  });
+}
+
+WD_BENCHMARK("crypto/node/createHash/sha256/64KiB") {
+  runNodeCryptoBenchmark(state, 65536,
+      [](jsg::Lock& js, api::node::CryptoImpl&, kj::ArrayPtr<kj::byte> input) {
+    auto handle = api::node::CryptoImpl::HashHandle::constructor(js, kj::str("sha256"), nullptr);
+    handle->update(js, borrow(input));
+    handle->digest(js);
+  });
+}
+
+WD_BENCHMARK("crypto/node/pbkdf2Sync/sha256/10000") {
+  runNodeCryptoBenchmark(state, 0,
+      [](jsg::Lock&, api::node::CryptoImpl& impl, kj::ArrayPtr<kj::byte>) {
+    kj::byte password[16] = { 1, 2, 3, 4 };
+    kj::byte salt[16] = { 5, 6, 7, 8 };
+    impl.getPbkdf(borrow(password), borrow(salt), 10000, 32, kj::str("sha256"));
+  });
+}
+
+}  // namespace
+}  // namespace workerd
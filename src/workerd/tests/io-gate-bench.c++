@@ -0,0 +1,68 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+// Measures the cost of the input and output gate operations that an actor performs for each
+// storage call and event delivery, when there is no contention.
+
+#include <workerd/io/io-gate.h>
+#include "bench.h"
+
+namespace workerd {
+namespace {
+
+WD_BENCHMARK("InputGate/wait") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  InputGate gate;
+
+  for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+    auto lock = gate.wait().wait(ws);
+  }
+}
+
+WD_BENCHMARK("InputGate/tryLock") {
+  InputGate gate;
+
+  for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+    auto lock = KJ_ASSERT_NONNULL(gate.tryLock());
+  }
+}
+
+WD_BENCHMARK("OutputGate/wait") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  OutputGate gate;
+
+  for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+    gate.wait().wait(ws);
+  }
+}
+
+WD_BENCHMARK("OutputGate/lockWhile") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  OutputGate gate;
+
+  for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+    gate.lockWhile(kj::Promise<void>(kj::READY_NOW)).wait(ws);
+  }
+}
+
+WD_BENCHMARK("OutputGate/lockWhile+wait") {
+  // A write followed by an outgoing message that must wait for it, as when a request stores a
+  // value and then returns a response.
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  OutputGate gate;
+
+  for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+    auto blocker = gate.lockWhile(kj::Promise<void>(kj::READY_NOW));
+    auto waiter = gate.wait();
+    blocker.wait(ws);
+    waiter.wait(ws);
+  }
+}
+
+}  // namespace
+}  // namespace workerd
@@ -0,0 +1,110 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+// Compares jsg::Serializer's compact format with V8's serialization format on the kind of values
+// typically written to Durable Object storage: small records of strings and numbers, and arrays of
+// them. Each iteration serializes or deserializes one value, so `itemsPerSecond` is values per
+// second and `bytesPerSecond` is based on the serialized size.
+
+#include "bench.h"
+#include "test-fixture.h"
+#include <workerd/jsg/ser.h>
+
+namespace workerd {
+namespace {
+
+constexpr auto RECORD = R"(({
+  id: 12345,
+  name: "widget",
+  price: 9.99,
+  tags: ["blue", "large"],
+  active: true,
+  owner: { id: 678, email: "someone@example.com" },
+}))"_kj;
+
+constexpr auto RECORD_LIST = R"(Array.from({ length: 100 }, (_, i) => ({
+  id: i,
+  name: "widget " + i,
+  price: i * 1.25,
+  tags: ["blue", "large"],
+  active: i % 2 == 0,
+})))"_kj;
+
+constexpr auto UNICODE_RECORD = R"(({
+  id: 12345,
+  title: "Überraschung — ünïcödé ✓",
+  body: "日本語のテキスト",
+}))"_kj;
+
+kj::Array<kj::byte> serialize(v8::Isolate* isolate, v8::Local<v8::Value> value, bool compact) {
+  jsg::Serializer serializer(isolate, jsg::Serializer::Options { .compact = compact });
+  serializer.write(value);
+  return kj::mv(serializer.release().data);
+}
+
+void runSerializeBenchmark(bench::State& state, kj::StringPtr expression, bool compact) {
+  state.pauseTiming();
+  TestFixture fixture;
+  fixture.runInIoContext([&](const TestFixture::Environment& env) {
+    auto* isolate = env.js.v8Isolate;
+    auto value = env.compileAndRunScript(expression);
+    auto size = serialize(isolate, value, compact).size();
+
+    state.resumeTiming();
+    for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+      v8::HandleScope scope(isolate);
+      serialize(isolate, value, compact);
+    }
+    state.pauseTiming();
+
+    state.setBytesProcessed(state.iterations() * size);
+  });
+  state.setItemsProcessed(state.iterations());
+}
+
+void runDeserializeBenchmark(bench::State& state, kj::StringPtr expression, bool compact) {
+  state.pauseTiming();
+  TestFixture fixture;
+  fixture.runInIoContext([&](const TestFixture::Environment& env) {
+    auto* isolate = env.js.v8Isolate;
+    auto data = serialize(isolate, env.compileAndRunScript(expression), compact);
+
+    state.resumeTiming();
+    for (auto i KJ_UNUSED: kj::zeroTo(state.iterations())) {
+      v8::HandleScope scope(isolate);
+      jsg::Deserializer deserializer(isolate, data.asPtr());
+      deserializer.readValue();
+    }
+    state.pauseTiming();
+
+    state.setBytesProcessed(state.iterations() * data.size());
+  });
+  state.setItemsProcessed(state.iterations());
+}
+
+WD_BENCHMARK("ser/serialize/record/v8") { runSerializeBenchmark(state, RECORD, false); }
+WD_BENCHMARK("ser/serialize/record/compact") { runSerializeBenchmark(state, RECORD, true); }
+WD_BENCHMARK("ser/deserialize/record/v8") { runDeserializeBenchmark(state, RECORD, false); }
+WD_BENCHMARK("ser/deserialize/record/compact") { runDeserializeBenchmark(state, RECORD, true); }
+
+WD_BENCHMARK("ser/serialize/list/v8") { runSerializeBenchmark(state, RECORD_LIST, false); }
+WD_BENCHMARK("ser/serialize/list/compact") { runSerializeBenchmark(state, RECORD_LIST, true); }
+WD_BENCHMARK("ser/deserialize/list/v8") { runDeserializeBenchmark(state, RECORD_LIST, false); }
+WD_BENCHMARK("ser/deserialize/list/compact") {
+  runDeserializeBenchmark(state, RECORD_LIST, true);
+}
+
+WD_BENCHMARK("ser/serialize/unicode/v8") { runSerializeBenchmark(state, UNICODE_RECORD, false); }
+WD_BENCHMARK("ser/serialize/unicode/compact") {
+  runSerializeBenchmark(state, UNICODE_RECORD, true);
+}
+WD_BENCHMARK("ser/deserialize/unicode/v8") {
+  runDeserializeBenchmark(state, UNICODE_RECORD, false);
+}
+WD_BENCHMARK("ser/deserialize/unicode/compact") {
+  runDeserializeBenchmark(state, UNICODE_RECORD, true);
+}
+
+}  // namespace
+}  // namespace workerd
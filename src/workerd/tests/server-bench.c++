@@ -0,0 +1,642 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+// End-to-end benchmarks of the whole server. Each scenario starts a `Server` from a config, just
+// like `workerd serve` or a wd-test does, listening on a loopback socket, and drives it with a
+// closed-loop HTTP load generator running on a separate thread: each connection sends its next
+// request as soon as it has read the previous response.
+//
+// After a warmup period, each scenario reports one JSON object per line on stdout with:
+//
+// * `requestsPerSecond`: completed requests per second, across all connections.
+// * `latencyNs`: percentiles of the time from sending a request to reading the end of the response.
+// * `cpuNsPerRequest`: CPU time used by the process per request, excluding the load generator's
+//   thread. This includes V8's background threads.
+// * `rssBytes`: the process's resident set size at the end of the run (Linux only).
+//
+// Run with e.g. `bazel run -c opt //src/workerd/tests:server-bench -- --filter=hello`. Compare runs
+// on the same machine only, and preferably on an otherwise idle one.
+
+#include <workerd/server/server.h>
+#include <workerd/jsg/setup.h>
+#include <workerd/util/random.h>
+#include <capnp/message.h>
+#include <capnp/serialize-text.h>
+#include <kj/compat/http.h>
+#include <kj/debug.h>
+#include <kj/filesystem.h>
+#include <kj/io.h>
+#include <kj/main.h>
+#include <kj/thread.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace workerd::server {
+namespace {
+
+struct Scenario {
+  kj::StringPtr name;
+
+  kj::StringPtr config;
+  // A config::Config in capnp text format. It must define a socket named "main", whose address
+  // is replaced with a loopback port. If it defines a socket named "origin" and an external
+  // service named "origin", the service is pointed at the socket.
+
+  kj::HttpMethod method = kj::HttpMethod::GET;
+  kj::StringPtr path = "/"_kj;
+  size_t requestBodySize = 0;
+
+  uint webSocketListeners = 0;
+  kj::StringPtr webSocketPath = nullptr;
+  // WebSockets opened to `webSocketPath` before the run, which count the messages they receive.
+};
+
+const Scenario SCENARIOS[] = {
+  {
+    .name = "hello"_kj,
+    .config = R"((
+      services = [
+        ( name = "hello",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `export default {
+                  `  fetch(request) {
+                  `    return new Response("Hello World\n");
+                  `  }
+                  `}
+              )
+            ]
+          )
+        )
+      ],
+      sockets = [ ( name = "main", address = "127.0.0.1:0", service = "hello" ) ]
+    ))"_kj,
+  },
+  {
+    .name = "proxy/service-binding"_kj,
+    .config = R"((
+      services = [
+        ( name = "front",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `export default {
+                  `  fetch(request, env) {
+                  `    return env.backend.fetch(request);
+                  `  }
+                  `}
+              )
+            ],
+            bindings = [ ( name = "backend", service = "backend" ) ]
+          )
+        ),
+        ( name = "backend",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `const body = "x".repeat(1024);
+                  `export default {
+                  `  fetch(request) {
+                  `    return new Response(body);
+                  `  }
+                  `}
+              )
+            ]
+          )
+        )
+      ],
+      sockets = [ ( name = "main", address = "127.0.0.1:0", service = "front" ) ]
+    ))"_kj,
+  },
+  {
+    .name = "proxy/http"_kj,
+    .config = R"((
+      services = [
+        ( name = "front",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `export default {
+                  `  fetch(request, env) {
+                  `    return env.origin.fetch(request);
+                  `  }
+                  `}
+              )
+            ],
+            bindings = [ ( name = "origin", service = "origin" ) ]
+          )
+        ),
+        ( name = "origin", external = ( address = "127.0.0.1:0", http = () ) ),
+        ( name = "backend",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `const body = "x".repeat(1024);
+                  `export default {
+                  `  fetch(request) {
+                  `    return new Response(body);
+                  `  }
+                  `}
+              )
+            ]
+          )
+        )
+      ],
+      sockets = [
+        ( name = "main", address = "127.0.0.1:0", service = "front" ),
+        ( name = "origin", address = "127.0.0.1:0", service = "backend" )
+      ]
+    ))"_kj,
+  },
+  {
+    .name = "streaming"_kj,
+    .config = R"((
+      services = [
+        ( name = "streaming",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `const chunk = new Uint8Array(1024).fill(120);
+                  `export default {
+                  `  fetch(request) {
+                  `    let remaining = 64;
+                  `    return new Response(new ReadableStream({
+                  `      pull(controller) {
+                  `        controller.enqueue(chunk.slice());
+                  `        if (--remaining == 0) controller.close();
+                  `      }
+                  `    }));
+                  `  }
+                  `}
+              )
+            ]
+          )
+        )
+      ],
+      sockets = [ ( name = "main", address = "127.0.0.1:0", service = "streaming" ) ]
+    ))"_kj,
+  },
+  {
+    .name = "durable-object/storage"_kj,
+    .config = R"((
+      services = [
+        ( name = "storage",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `export default {
+                  `  fetch(request, env) {
+                  `    let id = env.ns.idFromName("counter-" + Math.floor(Math.random() * 16));
+                  `    return env.ns.get(id).fetch(request);
+                  `  }
+                  `}
+                  `export class Counter {
+                  `  constructor(state) {
+                  `    this.storage = state.storage;
+                  `  }
+                  `  async fetch(request) {
+                  `    let count = (await this.storage.get("count")) || 0;
+                  `    this.storage.put("count", count + 1);
+                  `    this.storage.put("last", { count, time: Date.now(), url: request.url });
+                  `    return new Response(String(count));
+                  `  }
+                  `}
+              )
+            ],
+            bindings = [ ( name = "ns", durableObjectNamespace = "Counter" ) ],
+            durableObjectNamespaces = [ ( className = "Counter", uniqueKey = "bench" ) ],
+            durableObjectStorage = ( inMemory = void )
+          )
+        )
+      ],
+      sockets = [ ( name = "main", address = "127.0.0.1:0", service = "storage" ) ]
+    ))"_kj,
+  },
+  {
+    .name = "durable-object/websocket-fanout"_kj,
+    .config = R"((
+      services = [
+        ( name = "fanout",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `export default {
+                  `  fetch(request, env) {
+                  `    return env.ns.get(env.ns.idFromName("room")).fetch(request);
+                  `  }
+                  `}
+                  `export class Room {
+                  `  constructor(state) {
+                  `    this.sockets = new Set();
+                  `  }
+                  `  async fetch(request) {
+                  `    if (request.headers.get("Upgrade") == "websocket") {
+                  `      let [client, server] = Object.values(new WebSocketPair());
+                  `      server.accept();
+                  `      this.sockets.add(server);
+                  `      server.addEventListener("close", () => this.sockets.delete(server));
+                  `      return new Response(null, { status: 101, webSocket: client });
+                  `    }
+                  `    let message = await request.text();
+                  `    for (let socket of this.sockets) socket.send(message);
+                  `    return new Response("sent to " + this.sockets.size);
+                  `  }
+                  `}
+              )
+            ],
+            bindings = [ ( name = "ns", durableObjectNamespace = "Room" ) ],
+            durableObjectNamespaces = [ ( className = "Room", uniqueKey = "bench" ) ],
+            durableObjectStorage = ( inMemory = void )
+          )
+        )
+      ],
+      sockets = [ ( name = "main", address = "127.0.0.1:0", service = "fanout" ) ]
+    ))"_kj,
+    .method = kj::HttpMethod::POST,
+    .path = "/broadcast"_kj,
+    .requestBodySize = 64,
+    .webSocketListeners = 32,
+    .webSocketPath = "/listen"_kj,
+  },
+  {
+    .name = "html-rewriter"_kj,
+    .config = R"((
+      services = [
+        ( name = "rewriter",
+          worker = (
+            compatibilityDate = "2023-01-15",
+            modules = [
+              ( name = "main.js",
+                esModule =
+                  `const html = "<!DOCTYPE html><html><head><title>Benchmark</title></head><body>" +
+                  `    "<p>Some text with <a href='/page'>a link</a> in it.</p>".repeat(200) +
+                  `    "</body></html>";
+                  `export default {
+                  `  fetch(request) {
+                  `    let response = new Response(html, { headers: { "Content-Type": "text/html" } });
+                  `    return new HTMLRewriter()
+                  `        .on("a", {
+                  `          element(element) {
+                  `            element.setAttribute("href",
+                  `                "https://example.com" + element.getAttribute("href"));
+                  `          }
+                  `        })
+                  `        .transform(response);
+                  `  }
+                  `}
+              )
+            ]
+          )
+        )
+      ],
+      sockets = [ ( name = "main", address = "127.0.0.1:0", service = "rewriter" ) ]
+    ))"_kj,
+  },
+};
+
+struct Options {
+  kj::Duration warmup = 1 * kj::SECONDS;
+  kj::Duration duration = 5 * kj::SECONDS;
+  uint connections = 16;
+};
+
+struct Results {
+  uint64_t requests = 0;
+  uint64_t errors = 0;
+  // Responses with a status other than 200 (or 101, for WebSockets).
+
+  uint64_t webSocketMessages = 0;
+  kj::Vector<uint64_t> latencies;
+  // In nanoseconds, for requests completed while measuring.
+
+  uint64_t processCpuNs = 0;
+  uint64_t generatorCpuNs = 0;
+  // CPU time used while measuring, by the whole process and by the load generator's thread.
+
+  uint64_t rssBytes = 0;
+};
+
+uint64_t cpuTimeNs(clockid_t clock) {
+  struct timespec ts;
+  KJ_SYSCALL(clock_gettime(clock, &ts));
+  return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+uint64_t getRssBytes() {
+  // The second field of /proc/self/statm is the resident set size in pages.
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) return 0;
+  KJ_DEFER(fclose(file));
+  unsigned long size, resident;
+  if (fscanf(file, "%lu %lu", &size, &resident) != 2) return 0;
+  return uint64_t(resident) * sysconf(_SC_PAGESIZE);
+}
+
+class LoadGenerator {
+  // Runs on its own thread and event loop, so that the server's event loop only runs the server.
+public:
+  LoadGenerator(kj::AsyncIoContext& io, kj::StringPtr address, const Scenario& scenario,
+                const Options& options)
+      : io(io), address(address), scenario(scenario), options(options),
+        requestBody(kj::heapArray<kj::byte>(scenario.requestBodySize)) {
+    memset(requestBody.begin(), 'x', requestBody.size());
+  }
+
+  Results run() {
+    auto listeners = kj::heapArrayBuilder<kj::Promise<void>>(scenario.webSocketListeners);
+    for (auto i KJ_UNUSED: kj::zeroTo(scenario.webSocketListeners)) {
+      listeners.add(listen());
+    }
+    auto& timer = io.provider->getTimer();
+    auto allListeners = kj::joinPromises(listeners.finish()).then([]() {
+      KJ_FAIL_REQUIRE("WebSocket listener finished early");
+    }).eagerlyEvaluate(nullptr);
+
+    // Wait for the listeners to connect before sending any load, so that every request has the
+    // same amount of work to do.
+    while (connectedListeners < scenario.webSocketListeners) {
+      if (allListeners.poll(io.waitScope)) allListeners.wait(io.waitScope);
+      timer.afterDelay(10 * kj::MILLISECONDS).wait(io.waitScope);
+    }
+
+    auto loops = kj::heapArrayBuilder<kj::Promise<void>>(options.connections + 1);
+    for (auto i KJ_UNUSED: kj::zeroTo(options.connections)) {
+      loops.add(sendRequests());
+    }
+
+    auto measurement = timer.afterDelay(options.warmup).then([&]() {
+      measuring = true;
+      results.processCpuNs = cpuTimeNs(CLOCK_PROCESS_CPUTIME_ID);
+      results.generatorCpuNs = cpuTimeNs(CLOCK_THREAD_CPUTIME_ID);
+      return timer.afterDelay(options.duration);
+    }).then([&]() {
+      measuring = false;
+      done = true;
+      results.processCpuNs = cpuTimeNs(CLOCK_PROCESS_CPUTIME_ID) - results.processCpuNs;
+      results.generatorCpuNs = cpuTimeNs(CLOCK_THREAD_CPUTIME_ID) - results.generatorCpuNs;
+    }).eagerlyEvaluate(nullptr);
+
+    // Once measurement ends, each connection stops after its current request.
+    loops.add(kj::mv(measurement));
+    kj::joinPromises(loops.finish())
+        .exclusiveJoin(kj::mv(allListeners))
+        .wait(io.waitScope);
+
+    return kj::mv(results);
+  }
+
+private:
+  kj::AsyncIoContext& io;
+  kj::StringPtr address;
+  const Scenario& scenario;
+  const Options& options;
+  kj::HttpHeaderTable headerTable;
+  kj::Array<kj::byte> requestBody;
+
+  bool measuring = false;
+  bool done = false;
+  uint connectedListeners = 0;
+  Results results;
+
+  kj::Promise<kj::Own<kj::HttpClient>> connect(kj::Own<kj::AsyncIoStream>& stream) {
+    auto addr = co_await io.provider->getNetwork().parseAddress(address);
+    stream = co_await addr->connect();
+    co_return kj::newHttpClient(headerTable, *stream);
+  }
+
+  kj::Promise<void> sendRequests() {
+    kj::Own<kj::AsyncIoStream> stream;
+    auto client = co_await connect(stream);
+    auto& clock = kj::systemPreciseMonotonicClock();
+
+    while (!done) {
+      auto start = clock.now();
+      kj::HttpHeaders headers(headerTable);
+      headers.set(kj::HttpHeaderId::HOST, "bench");
+      auto request = client->request(scenario.method, scenario.path, headers,
+                                     uint64_t(requestBody.size()));
+      if (requestBody.size() > 0) {
+        co_await request.body->write(requestBody.begin(), requestBody.size());
+      }
+      request.body = nullptr;
+
+      auto response = co_await kj::mv(request.response);
+      co_await response.body->readAllBytes();
+      auto end = clock.now();
+
+      if (measuring) {
+        ++results.requests;
+        if (response.statusCode == 200) {
+          results.latencies.add((end - start) / kj::NANOSECONDS);
+        } else {
+          ++results.errors;
+        }
+      }
+    }
+  }
+
+  kj::Promise<void> listen() {
+    kj::Own<kj::AsyncIoStream> stream;
+    auto client = co_await connect(stream);
+
+    kj::HttpHeaders headers(headerTable);
+    headers.set(kj::HttpHeaderId::HOST, "bench");
+    auto response = co_await client->openWebSocket(scenario.webSocketPath, headers);
+    KJ_REQUIRE(response.statusCode == 101, "WebSocket upgrade failed", response.statusCode);
+    auto webSocket = kj::mv(response.webSocketOrBody.get<kj::Own<kj::WebSocket>>());
+    ++connectedListeners;
+
+    for (;;) {
+      auto message = co_await webSocket->receive();
+      KJ_REQUIRE(message.is<kj::String>() || message.is<kj::Array<kj::byte>>(),
+                 "WebSocket closed unexpectedly");
+      if (measuring) ++results.webSocketMessages;
+    }
+  }
+};
+
+class EntropySourceImpl: public kj::EntropySource {
+public:
+  void generate(kj::ArrayPtr<kj::byte> buffer) override {
+    getBufferedRandomBytes(buffer);
+  }
+};
+
+Results runScenario(jsg::V8System& v8System, const Scenario& scenario, const Options& options) {
+  auto io = kj::setupAsyncIo();
+  auto& network = io.provider->getNetwork();
+  auto fs = kj::newDiskFilesystem();
+  EntropySourceImpl entropySource;
+
+  capnp::MallocMessageBuilder message;
+  auto config = message.initRoot<config::Config>();
+  capnp::TextCodec().decode(scenario.config, config);
+
+  kj::Vector<kj::String> errors;
+  Server server(*fs, io.provider->getTimer(), network, entropySource,
+      [&](kj::String error) { errors.add(kj::mv(error)); });
+
+  auto bind = [&](kj::StringPtr socketName) {
+    auto listener = network.parseAddress("127.0.0.1", 0).wait(io.waitScope)->listen();
+    auto address = kj::str("127.0.0.1:", listener->getPort());
+    server.overrideSocket(kj::str(socketName), kj::mv(listener));
+    return address;
+  };
+  auto address = bind("main");
+  for (auto socket: config.getSockets()) {
+    if (socket.getName() == "origin") {
+      server.overrideExternal(kj::str("origin"), bind("origin"));
+    }
+  }
+
+  auto serverTask = server.run(v8System, config.asReader())
+      .eagerlyEvaluate([](kj::Exception&& e) {
+    KJ_LOG(ERROR, "server failed", e);
+  });
+  serverTask.poll(io.waitScope);
+  KJ_REQUIRE(errors.empty(), "invalid config", scenario.name, kj::strArray(errors, "\n"));
+
+  auto paf = kj::newPromiseAndCrossThreadFulfiller<Results>();
+  kj::Thread thread([&]() {
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() {
+      auto generatorIo = kj::setupAsyncIo();
+      paf.fulfiller->fulfill(LoadGenerator(generatorIo, address, scenario, options).run());
+    })) {
+      paf.fulfiller->reject(kj::mv(*exception));
+    }
+  });
+
+  auto results = paf.promise.wait(io.waitScope);
+  results.rssBytes = getRssBytes();
+  return results;
+}
+
+void report(const Scenario& scenario, const Options& options, Results& results) {
+  auto seconds = double(options.duration / kj::NANOSECONDS) / 1e9;
+  auto& latencies = results.latencies;
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](uint p) -> uint64_t {
+    if (latencies.empty()) return 0;
+    return latencies[kj::min(latencies.size() - 1, latencies.size() * p / 100)];
+  };
+
+  kj::String cpu;
+  if (results.requests > 0) {
+    cpu = kj::str(", \"cpuNsPerRequest\": ",
+        (results.processCpuNs - results.generatorCpuNs) / results.requests);
+  }
+  kj::String webSocket;
+  if (scenario.webSocketListeners > 0) {
+    webSocket = kj::str(", \"webSocketMessagesPerSecond\": ",
+        uint64_t(results.webSocketMessages / seconds));
+  }
+
+  auto line = kj::str(
+      "{\"name\": \"", scenario.name,
+      "\", \"connections\": ", options.connections,
+      ", \"requests\": ", results.requests,
+      ", \"errors\": ", results.errors,
+      ", \"requestsPerSecond\": ", uint64_t(results.requests / seconds),
+      ", \"latencyNs\": {\"p50\": ", percentile(50), ", \"p90\": ", percentile(90),
+      ", \"p99\": ", percentile(99), ", \"max\": ", latencies.empty() ? 0 : latencies.back(), "}",
+      cpu, webSocket,
+      ", \"rssBytes\": ", results.rssBytes, "}\n");
+  kj::FdOutputStream(STDOUT_FILENO).write(line.begin(), line.size());
+}
+
+class ServerBenchMain {
+public:
+  explicit ServerBenchMain(kj::ProcessContext& context): context(context) {}
+
+  kj::MainFunc getMain() {
+    return kj::MainBuilder(context, "workerd server benchmark",
+            "Runs end-to-end benchmarks of workerd under HTTP load.")
+        .addOptionWithArg({'f', "filter"}, KJ_BIND_METHOD(*this, setFilter), "<text>",
+            "Only run scenarios whose name contains <text>.")
+        .addOptionWithArg({'c', "connections"}, KJ_BIND_METHOD(*this, setConnections), "<n>",
+            "Number of concurrent connections sending requests. Default: 16")
+        .addOptionWithArg({'d', "duration"}, KJ_BIND_METHOD(*this, setDuration), "<ms>",
+            "How long to measure each scenario for, in milliseconds. Default: 5000")
+        .addOptionWithArg({'w', "warmup"}, KJ_BIND_METHOD(*this, setWarmup), "<ms>",
+            "How long to send load before measuring, in milliseconds. Default: 1000")
+        .callAfterParsing(KJ_BIND_METHOD(*this, run))
+        .build();
+  }
+
+  kj::MainBuilder::Validity setFilter(kj::StringPtr value) {
+    filter = kj::str(value);
+    return true;
+  }
+
+  kj::MainBuilder::Validity setConnections(kj::StringPtr value) {
+    KJ_IF_MAYBE(n, parsePositive(value)) {
+      options.connections = *n;
+      return true;
+    }
+    return "connections must be a positive integer";
+  }
+
+  kj::MainBuilder::Validity setDuration(kj::StringPtr value) {
+    KJ_IF_MAYBE(n, parsePositive(value)) {
+      options.duration = *n * kj::MILLISECONDS;
+      return true;
+    }
+    return "duration must be a positive integer";
+  }
+
+  kj::MainBuilder::Validity setWarmup(kj::StringPtr value) {
+    KJ_IF_MAYBE(n, parsePositive(value)) {
+      options.warmup = *n * kj::MILLISECONDS;
+      return true;
+    }
+    return "warmup must be a positive integer";
+  }
+
+  kj::MainBuilder::Validity run() {
+    jsg::V8System v8System;
+    for (auto& scenario: SCENARIOS) {
+      if (strstr(scenario.name.cStr(), filter.cStr()) == nullptr) continue;
+      auto results = runScenario(v8System, scenario, options);
+      report(scenario, options, results);
+    }
+    return true;
+  }
+
+private:
+  kj::ProcessContext& context;
+  kj::String filter = kj::str();
+  Options options;
+
+  static kj::Maybe<uint> parsePositive(kj::StringPtr value) {
+    char* end;
+    auto n = strtoul(value.cStr(), &end, 10);
+    if (value.size() == 0 || *end != '\0' || n == 0) return nullptr;
+    return uint(n);
+  }
+};
+
+}  // namespace
+}  // namespace workerd::server
+
+KJ_MAIN(workerd::server::ServerBenchMain);
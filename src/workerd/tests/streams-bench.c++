@@ -0,0 +1,133 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+// Measures the streams implementation on representative workloads: moving chunks through the
+// JS-backed value and byte queues, pipeTo() between JS-backed and internal streams, tee() of both
+// kinds, and the compression streams. Each iteration moves one chunk, so `itemsPerSecond` is
+// chunks per second and `allocsPerItem` is native allocations per chunk.
+//
+// The workloads are written in JavaScript, since that's how streams are driven in practice, and
+// each run executes as a single request in a fresh TestFixture.
+
+#include "bench.h"
+#include "test-fixture.h"
+
+namespace workerd {
+namespace {
+
+constexpr auto PRELUDE = R"(
+  function valueSource(n) {
+    let i = 0;
+    return new ReadableStream({
+      pull(c) { if (i++ < n) c.enqueue(i); else c.close(); }
+    });
+  }
+
+  function byteSource(n, size) {
+    // Text-like content, so that the compression benchmarks have something to compress.
+    const template = new TextEncoder().encode(
+        '<li class="item">Lorem ipsum dolor sit amet.</li>\n'.repeat(Math.ceil(size / 48)));
+    let i = 0;
+    return new ReadableStream({
+      type: 'bytes',
+      pull(c) { if (i++ < n) c.enqueue(template.slice(0, size)); else c.close(); }
+    });
+  }
+
+  async function drain(rs) {
+    const reader = rs.getReader();
+    while (!(await reader.read()).done) {}
+  }
+)"_kj;
+// Helpers available to every workload.
+
+void runStreamsBenchmark(bench::State& state, kj::StringPtr workload, size_t chunkSize) {
+  // `workload` is the source of an async JS function taking (chunkCount, chunkSize), which must
+  // move `chunkCount` chunks of `chunkSize` bytes through the streams under test.
+
+  state.pauseTiming();
+  TestFixture fixture;
+  auto script = kj::str(PRELUDE, "(", workload, ")(", state.iterations(), ", ", chunkSize, ");");
+  state.resumeTiming();
+
+  fixture.runInIoContext([&](const TestFixture::Environment& env) {
+    auto result = env.compileAndRunScript(script);
+    KJ_REQUIRE(result->IsPromise(), "workload must be an async function");
+    auto promise = env.js.toPromise(result.As<v8::Promise>())
+        .then(env.js, [](jsg::Lock&, jsg::Value) {});
+    return env.context.awaitJs(kj::mv(promise));
+  });
+
+  state.pauseTiming();
+  state.setItemsProcessed(state.iterations());
+  state.setBytesProcessed(state.iterations() * chunkSize);
+}
+
+WD_BENCHMARK("streams/ValueQueue/read") {
+  runStreamsBenchmark(state, "async (n) => drain(valueSource(n))", 0);
+}
+
+WD_BENCHMARK("streams/ByteQueue/read/4KiB") {
+  runStreamsBenchmark(state, "async (n, size) => drain(byteSource(n, size))", 4096);
+}
+
+WD_BENCHMARK("streams/ByteQueue/readAtLeast/64B") {
+  // Many tiny chunks gathered into larger BYOB reads.
+  runStreamsBenchmark(state, R"(async (n, size) => {
+    const reader = byteSource(n, size).getReader({ mode: 'byob' });
+    let buffer = new ArrayBuffer(4096);
+    for (;;) {
+      const { value, done } = await reader.readAtLeast(1024, new Uint8Array(buffer));
+      if (done) break;
+      buffer = value.buffer;
+    }
+  })", 64);
+}
+
+WD_BENCHMARK("streams/pipeTo/js-to-js") {
+  runStreamsBenchmark(state, R"(async (n) => {
+    await valueSource(n).pipeTo(new WritableStream({ write() {} }));
+  })", 0);
+}
+
+WD_BENCHMARK("streams/pipeTo/js-to-internal/4KiB") {
+  runStreamsBenchmark(state, R"(async (n, size) => {
+    const { readable, writable } = new IdentityTransformStream();
+    await Promise.all([byteSource(n, size).pipeTo(writable), new Response(readable).arrayBuffer()]);
+  })", 4096);
+}
+
+WD_BENCHMARK("streams/tee/js/4KiB") {
+  runStreamsBenchmark(state, R"(async (n, size) => {
+    const [a, b] = byteSource(n, size).tee();
+    await Promise.all([drain(a), drain(b)]);
+  })", 4096);
+}
+
+WD_BENCHMARK("streams/tee/internal/4KiB") {
+  runStreamsBenchmark(state, R"(async (n, size) => {
+    const { readable, writable } = new IdentityTransformStream();
+    const [a, b] = readable.tee();
+    await Promise.all([
+      byteSource(n, size).pipeTo(writable),
+      new Response(a).arrayBuffer(),
+      new Response(b).arrayBuffer(),
+    ]);
+  })", 4096);
+}
+
+WD_BENCHMARK("streams/CompressionStream/gzip/16KiB") {
+  runStreamsBenchmark(state, R"(async (n, size) => {
+    await drain(byteSource(n, size).pipeThrough(new CompressionStream('gzip')));
+  })", 16384);
+}
+
+WD_BENCHMARK("streams/CompressionStream/brotli/16KiB") {
+  runStreamsBenchmark(state, R"(async (n, size) => {
+    await drain(byteSource(n, size).pipeThrough(new CompressionStream('brotli')));
+  })", 16384);
+}
+
+}  // namespace
+}  // namespace workerd
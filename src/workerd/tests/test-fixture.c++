@@ -52,7 +52,8 @@ struct MockTimerChannel final: public TimerChannel {
 };
 
 struct DummyIoChannelFactory final: public IoChannelFactory {
-  DummyIoChannelFactory(TimerChannel& timer): timer(timer) {}
+  DummyIoChannelFactory(TimerChannel& timer, kj::Vector<uint>& logfwdrBatches)
+      : timer(timer), logfwdrBatches(logfwdrBatches) {}
 
   kj::Own<WorkerInterface> startSubrequest(uint channel, SubrequestMetadata metadata) override {
     KJ_FAIL_ASSERT("no subrequests");
@@ -70,7 +71,20 @@ struct DummyIoChannelFactory final: public IoChannelFactory {
 
   kj::Promise<void> writeLogfwdr(uint channel,
       kj::FunctionParam<void(capnp::AnyPointer::Builder)> buildMessage) override {
-    KJ_FAIL_ASSERT("no log channels");
+    capnp::MallocMessageBuilder message;
+    buildMessage(message.getRoot<capnp::AnyPointer>());
+    logfwdrBatches.add(1);
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> writeLogfwdrBatch(uint channel, uint count,
+      kj::FunctionParam<void(uint, capnp::AnyPointer::Builder)> buildMessage) override {
+    for (auto i: kj::zeroTo(count)) {
+      capnp::MallocMessageBuilder message;
+      buildMessage(i, message.getRoot<capnp::AnyPointer>());
+    }
+    logfwdrBatches.add(count);
+    return kj::READY_NOW;
   }
 
   kj::Own<ActorChannel> getGlobalActor(uint channel, const ActorIdFactory::ActorId& id,
@@ -83,6 +97,7 @@ struct DummyIoChannelFactory final: public IoChannelFactory {
   }
 
   TimerChannel& timer;
+  kj::Vector<uint>& logfwdrBatches;
 };
 
 static constexpr kj::StringPtr mainModuleSource = R"SCRIPT(
@@ -127,7 +142,7 @@ struct MockLimitEnforcer final: public LimitEnforcer {
   kj::Promise<void> onLimitsExceeded() override { return kj::NEVER_DONE; }
   void requireLimitsNotExceeded() override {}
   void reportMetrics(RequestObserver& requestMetrics) override {}
-
+  void chargeOffThreadCpu(kj::Duration cpuTime) override {}
 };
 
 struct MockIsolateLimitEnforcer final: public IsolateLimitEnforcer {
@@ -269,7 +284,8 @@ TestFixture::TestFixture(SetupParams params)
       scriptId,
       server::WorkerdApiIsolate::extractSource(mainModuleName, config, *errorReporter,
           capnp::List<server::config::Extension>::Reader{}),
-      IsolateObserver::StartType::COLD, false, nullptr)),
+      IsolateObserver::StartType::COLD, false, nullptr,
+      Worker::LockType(Worker::Lock::TakeSynchronously(nullptr)))),
     worker(kj::atomicRefcounted<Worker>(
       kj::atomicAddRef(*workerScript),
       kj::atomicRefcounted<WorkerObserver>(),
@@ -319,7 +335,7 @@ kj::Own<IoContext::IncomingRequest> TestFixture::createIncomingRequest() {
   auto context = kj::refcounted<IoContext>(
       threadContext, kj::atomicAddRef(*worker), nullptr, kj::heap<MockLimitEnforcer>());
   auto incomingRequest = kj::heap<IoContext::IncomingRequest>(
-      kj::addRef(*context), kj::heap<DummyIoChannelFactory>(*timerChannel),
+      kj::addRef(*context), kj::heap<DummyIoChannelFactory>(*timerChannel, logfwdrBatches),
       kj::refcounted<RequestObserver>(), nullptr);
   incomingRequest->delivered();
   return incomingRequest;
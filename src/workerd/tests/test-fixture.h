@@ -51,7 +51,8 @@ struct TestFixture {
     // Setup the incoming request and run given callback in worker's IO context.
     // callback should accept const Environment& parameter and return Promise<T>|void.
     // For void callbacks run waits for their completion, for promises waits for their resolution
-    // and returns the result.
+    // and returns the result. Like a real request, it then waits for the request's `waitUntil()`
+    // tasks to finish before returning.
 
     auto request = createIncomingRequest();
     kj::WaitScope* waitScope;
@@ -62,13 +63,22 @@ struct TestFixture {
     }
 
     auto& context = request->getContext();
-    return context.run([&](Worker::Lock& lock) {
+    auto promise = context.run([&](Worker::Lock& lock) {
       // auto features = workerBundle.getFeatureFlags();
       auto& js = jsg::Lock::from(lock.getIsolate());
       Environment env = {{.isolate=lock.getIsolate()}, context, lock, js};
       KJ_ASSERT(env.isolate == v8::Isolate::TryGetCurrent());
       return callback(env);
-    }).wait(*waitScope);
+    });
+
+    if constexpr (kj::isSameType<decltype(promise), kj::Promise<void>>()) {
+      promise.wait(*waitScope);
+      request->drain().wait(*waitScope);
+    } else {
+      auto result = promise.wait(*waitScope);
+      request->drain().wait(*waitScope);
+      return result;
+    }
   }
 
   void runInIoContext(
@@ -84,6 +94,14 @@ struct TestFixture {
   Response runRequest(kj::HttpMethod method, kj::StringPtr url, kj::StringPtr body);
   // Performs HTTP request on the default module handler, and waits for full response.
 
+  const Worker& getWorker() const { return *worker; }
+  // The worker under test. Its `const` methods may be used from other threads, e.g. to exercise
+  // async lock contention.
+
+  kj::Vector<uint> logfwdrBatches;
+  // The number of messages in each batch written to logfwdr, in order. A single message written
+  // with `writeLogfwdr()` counts as a batch of one.
+
 private:
   SetupParams params;
   capnp::MallocMessageBuilder configArena;
@@ -0,0 +1,71 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "http-date.h"
+#include <kj/test.h>
+
+namespace workerd {
+namespace {
+
+constexpr kj::Date SAMPLE = kj::UNIX_EPOCH + 784111777 * kj::SECONDS;
+// Sun, 06 Nov 1994 08:49:37 GMT, the example date RFC 9110 uses.
+
+KJ_TEST("parseHttpDate accepts every HTTP date format") {
+  KJ_EXPECT(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT") == SAMPLE);
+  KJ_EXPECT(parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT") == SAMPLE);
+  KJ_EXPECT(parseHttpDate("Sun Nov  6 08:49:37 1994") == SAMPLE);
+  KJ_EXPECT(parseHttpDate("Thu, 01 Jan 1970 00:00:00 GMT") == kj::UNIX_EPOCH);
+
+  // RFC 850 two-digit years below 50 are in the 2000s.
+  KJ_EXPECT(parseHttpDate("Friday, 01-Jan-49 00:00:00 GMT") ==
+      kj::UNIX_EPOCH + 2493072000 * kj::SECONDS);
+}
+
+KJ_TEST("parseHttpDate accepts RFC 3339 timestamps") {
+  KJ_EXPECT(parseHttpDate("1994-11-06T08:49:37Z") == SAMPLE);
+  KJ_EXPECT(parseHttpDate("1994-11-06T08:49:37.123Z") == SAMPLE + 123 * kj::MILLISECONDS);
+  KJ_EXPECT(parseHttpDate("1994-11-06T08:49:37.123456Z") == SAMPLE + 123 * kj::MILLISECONDS);
+  KJ_EXPECT(parseHttpDate("1994-11-06T08:49:37.5Z") == SAMPLE + 500 * kj::MILLISECONDS);
+  KJ_EXPECT(parseHttpDate("1994-11-06T09:49:37+01:00") == SAMPLE);
+  KJ_EXPECT(parseHttpDate("1994-11-06T03:19:37-05:30") == SAMPLE);
+  KJ_EXPECT(parseHttpDate("1969-12-31T23:59:59Z") == kj::UNIX_EPOCH - 1 * kj::SECONDS);
+  KJ_EXPECT(parseHttpDate("2000-02-29T00:00:00Z") == kj::UNIX_EPOCH + 951782400 * kj::SECONDS);
+}
+
+KJ_TEST("parseHttpDate rejects malformed dates") {
+  KJ_EXPECT(parseHttpDate("") == nullptr);
+  KJ_EXPECT(parseHttpDate("Sun, 06 Nov 1994 08:49:37") == nullptr);
+  KJ_EXPECT(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT ") == nullptr);
+  KJ_EXPECT(parseHttpDate("Sun, 6 Nov 1994 08:49:37 GMT") == nullptr);
+  KJ_EXPECT(parseHttpDate("Foo, 06 Nov 1994 08:49:37 GMT") == nullptr);
+  KJ_EXPECT(parseHttpDate("Sun, 06 Foo 1994 08:49:37 GMT") == nullptr);
+  KJ_EXPECT(parseHttpDate("Sun, 06 Nov 1994 24:00:00 GMT") == nullptr);
+  KJ_EXPECT(parseHttpDate("Sun, 31 Nov 1994 08:49:37 GMT") == nullptr);
+  KJ_EXPECT(parseHttpDate("1900-02-29T00:00:00Z") == nullptr);
+  KJ_EXPECT(parseHttpDate("1994-11-06T08:49:37") == nullptr);
+  KJ_EXPECT(parseHttpDate("1994-11-06T08:49:37.Z") == nullptr);
+  KJ_EXPECT(parseHttpDate("1994-11-06") == nullptr);
+}
+
+KJ_TEST("formatHttpDate") {
+  KJ_EXPECT(KJ_ASSERT_NONNULL(formatHttpDate(SAMPLE)) == "Sun, 06 Nov 1994 08:49:37 GMT");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(formatHttpDate(SAMPLE + 999 * kj::MILLISECONDS)) ==
+      "Sun, 06 Nov 1994 08:49:37 GMT");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(formatHttpDate(kj::UNIX_EPOCH)) ==
+      "Thu, 01 Jan 1970 00:00:00 GMT");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(formatHttpDate(kj::UNIX_EPOCH - 1 * kj::MILLISECONDS)) ==
+      "Wed, 31 Dec 1969 23:59:59 GMT");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(formatHttpDate(kj::UNIX_EPOCH + 951782400 * kj::SECONDS)) ==
+      "Tue, 29 Feb 2000 00:00:00 GMT");
+  KJ_EXPECT(formatHttpDate(kj::UNIX_EPOCH + 253402300800 * kj::SECONDS) == nullptr);
+
+  // Formatting round-trips through parsing.
+  for (int64_t seconds: { -62167219200ll, -1ll, 0ll, 784111777ll, 1665737377ll, 253402300799ll }) {
+    auto date = kj::UNIX_EPOCH + seconds * kj::SECONDS;
+    KJ_EXPECT(parseHttpDate(KJ_ASSERT_NONNULL(formatHttpDate(date))) == date, seconds);
+  }
+}
+
+}  // namespace
+}  // namespace workerd
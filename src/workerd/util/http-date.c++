@@ -0,0 +1,245 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "http-date.h"
+#include <kj/debug.h>
+#include <string.h>
+
+namespace workerd {
+
+using kj::uint;
+
+namespace {
+
+constexpr kj::StringPtr DAY_NAMES[] = {
+  "Sun"_kj, "Mon"_kj, "Tue"_kj, "Wed"_kj, "Thu"_kj, "Fri"_kj, "Sat"_kj
+};
+constexpr kj::StringPtr LONG_DAY_NAMES[] = {
+  "Sunday"_kj, "Monday"_kj, "Tuesday"_kj, "Wednesday"_kj, "Thursday"_kj, "Friday"_kj,
+  "Saturday"_kj
+};
+constexpr kj::StringPtr MONTH_NAMES[] = {
+  "Jan"_kj, "Feb"_kj, "Mar"_kj, "Apr"_kj, "May"_kj, "Jun"_kj,
+  "Jul"_kj, "Aug"_kj, "Sep"_kj, "Oct"_kj, "Nov"_kj, "Dec"_kj
+};
+
+int64_t daysFromCivil(int64_t year, uint month, uint day) {
+  // Days since 1970-01-01 of the given proleptic Gregorian date. See
+  // http://howardhinnant.github.io/date_algorithms.html#days_from_civil.
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  uint yearOfEra = year - era * 400;
+  uint dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  uint dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + int64_t(dayOfEra) - 719468;
+}
+
+struct CivilDate {
+  int64_t year;
+  uint month;
+  uint day;
+};
+
+CivilDate civilFromDays(int64_t days) {
+  // The inverse of daysFromCivil().
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  uint dayOfEra = days - era * 146097;
+  uint yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  uint dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  uint shiftedMonth = (5 * dayOfYear + 2) / 153;
+  uint day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+  uint month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+  return { era * 400 + yearOfEra + (month <= 2), month, day };
+}
+
+bool isValidDay(int64_t year, uint month, uint day) {
+  static constexpr uint DAYS_IN_MONTH[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  if (month < 1 || month > 12 || day < 1) return false;
+  bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+  return day <= DAYS_IN_MONTH[month - 1] + (month == 2 && leap);
+}
+
+class Parser {
+  // Consumes `text` from the front. Each method returns false, possibly having consumed some
+  // input, if the next thing in `text` isn't what was asked for.
+
+public:
+  explicit Parser(kj::StringPtr text): pos(text.begin()), end(text.end()) {}
+
+  bool atEnd() const { return pos == end; }
+
+  bool literal(kj::StringPtr expected) {
+    if (size_t(end - pos) < expected.size() ||
+        memcmp(pos, expected.begin(), expected.size()) != 0) {
+      return false;
+    }
+    pos += expected.size();
+    return true;
+  }
+
+  template <size_t n>
+  bool oneOf(const kj::StringPtr (&names)[n], uint& index) {
+    for (uint i = 0; i < n; i++) {
+      if (literal(names[i])) {
+        index = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool digits(uint count, uint& value) {
+    // Exactly `count` decimal digits.
+    if (size_t(end - pos) < count) return false;
+    value = 0;
+    for (uint i = 0; i < count; i++) {
+      if (*pos < '0' || *pos > '9') return false;
+      value = value * 10 + (*pos++ - '0');
+    }
+    return true;
+  }
+
+  bool time(uint& hour, uint& minute, uint& second) {
+    // HH:MM:SS
+    return digits(2, hour) && literal(":") && digits(2, minute) && literal(":") &&
+        digits(2, second) && hour < 24 && minute < 60 && second < 60;
+  }
+
+  bool milliseconds(uint& millis) {
+    // Optional fraction of a second, truncated to milliseconds like JavaScript does.
+    millis = 0;
+    if (!literal(".")) return true;
+    uint count = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+      if (count < 3) millis = millis * 10 + (*pos - '0');
+      ++pos;
+      ++count;
+    }
+    for (uint i = count; i < 3; i++) millis *= 10;
+    return count > 0;
+  }
+
+private:
+  const char* pos;
+  const char* end;
+};
+
+kj::Maybe<kj::Date> makeDate(int64_t year, uint month, uint day, uint hour, uint minute,
+                             uint second, uint millis = 0, int offsetMinutes = 0) {
+  if (!isValidDay(year, month, day)) return nullptr;
+  int64_t seconds = daysFromCivil(year, month, day) * 86400 +
+      hour * 3600 + minute * 60 + second - offsetMinutes * 60;
+  return kj::UNIX_EPOCH + seconds * kj::SECONDS + millis * kj::MILLISECONDS;
+}
+
+kj::Maybe<kj::Date> parseImfFixdate(kj::StringPtr text) {
+  // Sun, 06 Nov 1994 08:49:37 GMT
+  Parser p(text);
+  uint weekday, day, month, year, hour, minute, second;
+  if (p.oneOf(DAY_NAMES, weekday) && p.literal(", ") && p.digits(2, day) && p.literal(" ") &&
+      p.oneOf(MONTH_NAMES, month) && p.literal(" ") && p.digits(4, year) && p.literal(" ") &&
+      p.time(hour, minute, second) && p.literal(" GMT") && p.atEnd()) {
+    return makeDate(year, month + 1, day, hour, minute, second);
+  }
+  return nullptr;
+}
+
+kj::Maybe<kj::Date> parseRfc850(kj::StringPtr text) {
+  // Sunday, 06-Nov-94 08:49:37 GMT
+  Parser p(text);
+  uint weekday, day, month, year, hour, minute, second;
+  if (p.oneOf(LONG_DAY_NAMES, weekday) && p.literal(", ") && p.digits(2, day) &&
+      p.literal("-") && p.oneOf(MONTH_NAMES, month) && p.literal("-") && p.digits(2, year) &&
+      p.literal(" ") && p.time(hour, minute, second) && p.literal(" GMT") && p.atEnd()) {
+    // Two-digit years are read the way V8 reads them.
+    return makeDate(year < 50 ? 2000 + year : 1900 + year, month + 1, day, hour, minute, second);
+  }
+  return nullptr;
+}
+
+kj::Maybe<kj::Date> parseAsctime(kj::StringPtr text) {
+  // Sun Nov  6 08:49:37 1994
+  Parser p(text);
+  uint weekday, day, month, year, hour, minute, second;
+  if (p.oneOf(DAY_NAMES, weekday) && p.literal(" ") && p.oneOf(MONTH_NAMES, month) &&
+      p.literal(" ") && (p.literal(" ") ? p.digits(1, day) : p.digits(2, day)) &&
+      p.literal(" ") && p.time(hour, minute, second) && p.literal(" ") && p.digits(4, year) &&
+      p.atEnd()) {
+    return makeDate(year, month + 1, day, hour, minute, second);
+  }
+  return nullptr;
+}
+
+kj::Maybe<kj::Date> parseRfc3339(kj::StringPtr text) {
+  // 1994-11-06T08:49:37.123Z, or with an offset like +01:00 instead of Z.
+  Parser p(text);
+  uint year, month, day, hour, minute, second, millis;
+  if (!(p.digits(4, year) && p.literal("-") && p.digits(2, month) && p.literal("-") &&
+        p.digits(2, day) && p.literal("T") && p.time(hour, minute, second) &&
+        p.milliseconds(millis))) {
+    return nullptr;
+  }
+
+  int offsetMinutes = 0;
+  if (!p.literal("Z")) {
+    int sign;
+    if (p.literal("+")) {
+      sign = 1;
+    } else if (p.literal("-")) {
+      sign = -1;
+    } else {
+      return nullptr;
+    }
+    uint offsetHours, offsetMins;
+    if (!(p.digits(2, offsetHours) && p.literal(":") && p.digits(2, offsetMins)) ||
+        offsetHours >= 24 || offsetMins >= 60) {
+      return nullptr;
+    }
+    offsetMinutes = sign * int(offsetHours * 60 + offsetMins);
+  }
+  if (!p.atEnd()) return nullptr;
+
+  return makeDate(year, month, day, hour, minute, second, millis, offsetMinutes);
+}
+
+}  // namespace
+
+kj::Maybe<kj::Date> parseHttpDate(kj::StringPtr text) {
+  // The formats are distinguishable by their first few characters, but trying each in turn is
+  // simpler and each attempt gives up quickly.
+  for (auto parse: { parseImfFixdate, parseRfc3339, parseRfc850, parseAsctime }) {
+    auto result = parse(text);
+    if (result != nullptr) return result;
+  }
+  return nullptr;
+}
+
+kj::Maybe<kj::String> formatHttpDate(kj::Date date) {
+  int64_t millis = (date - kj::UNIX_EPOCH) / kj::MILLISECONDS;
+  int64_t seconds = millis / 1000 - (millis % 1000 < 0);
+  int64_t days = seconds / 86400 - (seconds % 86400 < 0);
+  int64_t secondOfDay = seconds - days * 86400;
+
+  auto civil = civilFromDays(days);
+  if (civil.year < 0 || civil.year > 9999) return nullptr;
+
+  uint weekday = ((days % 7) + 11) % 7;  // 1970-01-01 was a Thursday.
+
+  auto pad = [](uint64_t value, uint width) {
+    // Zero-padded to exactly `width` digits, which `value` is known to fit in.
+    auto result = kj::heapString(width);
+    for (uint i = width; i > 0; i--) {
+      result[i - 1] = '0' + value % 10;
+      value /= 10;
+    }
+    return result;
+  };
+
+  return kj::str(DAY_NAMES[weekday], ", ", pad(civil.day, 2), ' ', MONTH_NAMES[civil.month - 1],
+      ' ', pad(civil.year, 4), ' ', pad(secondOfDay / 3600, 2), ':',
+      pad(secondOfDay / 60 % 60, 2), ':', pad(secondOfDay % 60, 2), " GMT");
+}
+
+}  // namespace workerd
@@ -0,0 +1,27 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/string.h>
+#include <kj/time.h>
+
+namespace workerd {
+
+kj::Maybe<kj::Date> parseHttpDate(kj::StringPtr text);
+// Parses a date in any of the formats HTTP allows (RFC 9110 section 5.6.7: IMF-fixdate, RFC 850
+// and asctime), or an RFC 3339 timestamp with an explicit offset, such as
+// "2022-10-14T08:49:37.123Z". Returns null if `text` isn't one of those, or names a day that
+// doesn't exist.
+//
+// This accepts the same strings JavaScript's Date parser would for these formats, without
+// needing an isolate, but it's stricter: callers that must accept whatever `new Date(text)` does
+// should fall back to that when this returns null.
+
+kj::Maybe<kj::String> formatHttpDate(kj::Date date);
+// Formats `date` as an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT", which is also what
+// JavaScript's Date.prototype.toUTCString() produces. Sub-second precision is truncated. Returns
+// null for dates outside the years 0 to 9999, which IMF-fixdate can't represent.
+
+}  // namespace workerd
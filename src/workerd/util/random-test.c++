@@ -0,0 +1,69 @@
+// Copyright (c) 2017-2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "random.h"
+#include "uuid.h"
+#include <kj/test.h>
+#include <kj/thread.h>
+
+namespace workerd {
+namespace {
+
+bool isAllZero(kj::ArrayPtr<const kj::byte> bytes) {
+  for (auto b: bytes) {
+    if (b != 0) return false;
+  }
+  return true;
+}
+
+KJ_TEST("getBufferedRandomBytes never repeats output") {
+  // Draw enough small requests to cross several block refills, with odd sizes so that requests
+  // straddle block boundaries.
+  kj::Vector<kj::Array<kj::byte>> outputs;
+  for (uint i = 0; i < 1000; i++) {
+    auto out = kj::heapArray<kj::byte>(17 + i % 31);
+    memset(out.begin(), 0, out.size());
+    getBufferedRandomBytes(out);
+    KJ_EXPECT(!isAllZero(out));
+    outputs.add(kj::mv(out));
+  }
+  for (uint i = 1; i < outputs.size(); i++) {
+    auto n = kj::min(outputs[i - 1].size(), outputs[i].size());
+    KJ_EXPECT(outputs[i - 1].slice(0, n) != outputs[i].slice(0, n));
+  }
+}
+
+KJ_TEST("getBufferedRandomBytes handles large and empty requests") {
+  auto large = kj::heapArray<kj::byte>(MAX_BUFFERED_RANDOM_REQUEST * 10);
+  memset(large.begin(), 0, large.size());
+  getBufferedRandomBytes(large);
+  KJ_EXPECT(!isAllZero(large));
+
+  getBufferedRandomBytes(nullptr);
+}
+
+KJ_TEST("getBufferedRandomBytes gives threads distinct streams") {
+  kj::byte a[32], b[32];
+  {
+    kj::Thread thread([&]() { getBufferedRandomBytes(a); });
+  }
+  {
+    kj::Thread thread([&]() { getBufferedRandomBytes(b); });
+  }
+  KJ_EXPECT(kj::arrayPtr(a) != kj::arrayPtr(b));
+}
+
+KJ_TEST("randomUUID format") {
+  auto uuid = randomUUID(nullptr);
+  KJ_ASSERT(uuid.size() == 36);
+  for (uint i: { 8, 13, 18, 23 }) {
+    KJ_EXPECT(uuid[i] == '-', uuid);
+  }
+  KJ_EXPECT(uuid[14] == '4', uuid);
+  KJ_EXPECT(uuid[19] == '8' || uuid[19] == '9' || uuid[19] == 'a' || uuid[19] == 'b', uuid);
+  KJ_EXPECT(randomUUID(nullptr) != uuid);
+}
+
+}  // namespace
+}  // namespace workerd
@@ -0,0 +1,77 @@
+// Copyright (c) 2017-2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "random.h"
+
+#include <openssl/mem.h>
+#include <openssl/rand.h>
+#include <kj/debug.h>
+#include <atomic>
+#include <cstring>
+
+#if !_WIN32
+#include <pthread.h>
+#endif
+
+namespace workerd {
+
+namespace {
+
+std::atomic<uint> forkGeneration { 0 };
+// Incremented in the child after every fork(), invalidating all buffered blocks (of which the
+// child only has the forking thread's, but that one matters: it's shared with the parent).
+
+struct RandomBlock {
+  static constexpr size_t SIZE = 4096;
+
+  kj::byte bytes[SIZE];
+  size_t used = SIZE;
+  // Bytes before `used` have been handed out and wiped.
+
+  uint generation = 0;
+
+  RandomBlock() {
+#if !_WIN32
+    static bool registered KJ_UNUSED = []() {
+      KJ_ASSERT(pthread_atfork(nullptr, nullptr, []() { ++forkGeneration; }) == 0);
+      return true;
+    }();
+#endif
+  }
+  ~RandomBlock() noexcept(false) {
+    OPENSSL_cleanse(bytes, sizeof(bytes));
+  }
+
+  void refill() {
+    KJ_ASSERT(RAND_bytes(bytes, sizeof(bytes)) == 1);
+    used = 0;
+    generation = forkGeneration.load(std::memory_order_relaxed);
+  }
+
+  void take(kj::ArrayPtr<kj::byte> buffer) {
+    if (SIZE - used < buffer.size() ||
+        generation != forkGeneration.load(std::memory_order_relaxed)) {
+      refill();
+    }
+    memcpy(buffer.begin(), bytes + used, buffer.size());
+    OPENSSL_cleanse(bytes + used, buffer.size());
+    used += buffer.size();
+  }
+};
+
+static_assert(MAX_BUFFERED_RANDOM_REQUEST <= RandomBlock::SIZE);
+
+thread_local RandomBlock randomBlock;
+
+}  // namespace
+
+void getBufferedRandomBytes(kj::ArrayPtr<kj::byte> buffer) {
+  if (buffer.size() > MAX_BUFFERED_RANDOM_REQUEST) {
+    KJ_ASSERT(RAND_bytes(buffer.begin(), buffer.size()) == 1);
+  } else if (buffer.size() > 0) {
+    randomBlock.take(buffer);
+  }
+}
+
+}  // namespace workerd
@@ -0,0 +1,22 @@
+// Copyright (c) 2017-2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/common.h>
+
+namespace workerd {
+
+void getBufferedRandomBytes(kj::ArrayPtr<kj::byte> buffer);
+// Fills `buffer` with cryptographically secure random bytes, like RAND_bytes().
+//
+// Small requests (up to MAX_BUFFERED_RANDOM_REQUEST bytes), such as UUIDs and IDs, are served out
+// of a per-thread block of RAND_bytes() output, which is refilled once used up. This saves a trip
+// through BoringSSL's DRBG for every few bytes. Bytes are wiped from the block as soon as they are
+// handed out, and the block is discarded in a child process after fork(), so no two callers ever
+// see the same bytes. Larger requests go straight to RAND_bytes().
+
+constexpr size_t MAX_BUFFERED_RANDOM_REQUEST = 256;
+
+}  // namespace workerd
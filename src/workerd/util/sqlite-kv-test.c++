@@ -4,6 +4,7 @@
 
 #include "sqlite-kv.h"
 #include <kj/test.h>
+#include <algorithm>
 
 namespace workerd {
 namespace {
@@ -91,5 +92,75 @@ KJ_TEST("SQLite-KV") {
   KJ_EXPECT(list(nullptr, nullptr, nullptr, F) == "");
 }
 
+KJ_TEST("SQLite-KV multi-key operations") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  SqliteKv kv(db);
+
+  // Enough keys to need more than one batch of the largest size, plus a remainder, so that the
+  // largest statements (which bind as many parameters as SQLite allows) are prepared and run.
+  constexpr uint COUNT = SqliteKv::MAX_MULTI_BATCH * 2 + 3;
+  static_assert(COUNT > SqliteKv::MAX_MULTI_PUT_BATCH * 2);
+  auto keys = KJ_MAP(i, kj::zeroTo(COUNT)) { return kj::str("key", i); };
+  auto values = KJ_MAP(i, kj::zeroTo(COUNT)) { return kj::str("value", i); };
+  auto pairs = KJ_MAP(i, kj::zeroTo(COUNT)) -> SqliteKv::KeyValuePtrPair {
+    return { keys[i], values[i].asBytes() };
+  };
+  kv.putMultiple(pairs);
+
+  auto getAll = [&](kj::ArrayPtr<const SqliteKv::KeyPtr> keys) {
+    kj::Vector<kj::String> results;
+    kv.getMultiple(keys, [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) {
+      results.add(kj::str(key, "=", value.asChars()));
+    });
+    std::sort(results.begin(), results.end());
+    return kj::strArray(results, ", ");
+  };
+
+  // A small batch, with a missing key and a duplicate (which is reported once).
+  {
+    kj::StringPtr small[] = { "key5"_kj, "corge"_kj, "key1"_kj, "key5"_kj };
+    auto result = getAll(small);
+    KJ_EXPECT(result == "key1=value1, key5=value5", result);
+  }
+
+  // Every key, spanning several batches.
+  {
+    auto keyPtrs = KJ_MAP(k, keys) -> kj::StringPtr { return k; };
+    uint count = 0;
+    kv.getMultiple(keyPtrs, [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) {
+      KJ_EXPECT(kj::str("value", key.slice(3)) == kj::str(value.asChars()));
+      ++count;
+    });
+    KJ_EXPECT(count == COUNT);
+  }
+
+  // Later pairs win within a batch, including over padding.
+  {
+    SqliteKv::KeyValuePtrPair overwrite[] = {
+      { "key1"_kj, "first"_kj.asBytes() },
+      { "new"_kj, "x"_kj.asBytes() },
+      { "key1"_kj, "second"_kj.asBytes() },
+    };
+    kv.putMultiple(overwrite);
+    kj::StringPtr check[] = { "key1"_kj, "new"_kj };
+    KJ_EXPECT(getAll(check) == "key1=second, new=x");
+  }
+
+  // Deletes count only matched keys, once each.
+  {
+    kj::StringPtr toDelete[] = { "key1"_kj, "key1"_kj, "corge"_kj, "new"_kj };
+    KJ_EXPECT(kv.deleteMultiple(toDelete) == 2);
+    KJ_EXPECT(getAll(toDelete) == "");
+  }
+  {
+    auto keyPtrs = KJ_MAP(k, keys) -> kj::StringPtr { return k; };
+    KJ_EXPECT(kv.deleteMultiple(keyPtrs) == COUNT - 1);
+  }
+  KJ_EXPECT(kv.list(nullptr, nullptr, nullptr, SqliteKv::FORWARD,
+      [](kj::StringPtr, kj::ArrayPtr<const byte>) {}) == 0);
+}
+
 }  // namespace
 }  // namespace workerd
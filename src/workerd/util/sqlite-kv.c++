@@ -36,4 +36,84 @@ uint SqliteKv::deleteAll() {
   return query.changeCount();
 }
 
+void SqliteKv::putMultiple(kj::ArrayPtr<const KeyValuePtrPair> pairs) {
+  SqliteDatabase::Query::ValuePtr bindings[MAX_MULTI_PUT_BATCH * 2];
+
+  while (pairs.size() > 0) {
+    uint tier = multiTier(MULTI_PUT, pairs.size());
+    uint batchSize = multiBatchSize(MULTI_PUT, tier);
+    size_t n = kj::min(pairs.size(), size_t(batchSize));
+    for (uint i = 0; i < batchSize; i++) {
+      auto& pair = pairs[kj::min(size_t(i), n - 1)];
+      bindings[i * 2] = pair.key;
+      bindings[i * 2 + 1] = pair.value;
+    }
+
+    getMultiStatement(MULTI_PUT, tier)
+        .run(kj::ArrayPtr<const SqliteDatabase::Query::ValuePtr>(bindings, batchSize * 2));
+
+    pairs = pairs.slice(n, pairs.size());
+  }
+}
+
+uint SqliteKv::deleteMultiple(kj::ArrayPtr<const KeyPtr> keys) {
+  SqliteDatabase::Query::ValuePtr bindings[MAX_MULTI_BATCH];
+  uint count = 0;
+
+  while (keys.size() > 0) {
+    uint tier = multiTier(MULTI_DELETE, keys.size());
+    uint batchSize = multiBatchSize(MULTI_DELETE, tier);
+    size_t n = kj::min(keys.size(), size_t(batchSize));
+    for (uint i = 0; i < batchSize; i++) {
+      bindings[i] = keys[kj::min(size_t(i), n - 1)];
+    }
+
+    auto query = getMultiStatement(MULTI_DELETE, tier)
+        .run(kj::ArrayPtr<const SqliteDatabase::Query::ValuePtr>(bindings, batchSize));
+    count += query.changeCount();
+
+    keys = keys.slice(n, keys.size());
+  }
+
+  return count;
+}
+
+uint SqliteKv::multiTier(MultiOp op, size_t count) {
+  for (uint i = 0; i < MULTI_TIER_COUNT; i++) {
+    if (count <= multiBatchSize(op, i)) return i;
+  }
+  return MULTI_TIER_COUNT - 1;
+}
+
+SqliteDatabase::Statement& SqliteKv::getMultiStatement(MultiOp op, uint tier) {
+  auto& slot = multiStatements[op][tier];
+  KJ_IF_MAYBE(s, slot) {
+    return *s;
+  }
+
+  uint size = multiBatchSize(op, tier);
+  kj::Vector<kj::StringPtr> params(size);
+  kj::String sql;
+  switch (op) {
+    case MULTI_GET:
+      for (uint i = 0; i < size; i++) params.add("?");
+      sql = kj::str("SELECT key, value FROM _cf_KV WHERE key IN (",
+          kj::strArray(params, ", "), ")");
+      break;
+    case MULTI_PUT:
+      for (uint i = 0; i < size; i++) params.add("(?, ?)");
+      sql = kj::str("INSERT INTO _cf_KV VALUES ", kj::strArray(params, ", "),
+          " ON CONFLICT DO UPDATE SET value = excluded.value");
+      break;
+    case MULTI_DELETE:
+      for (uint i = 0; i < size; i++) params.add("?");
+      sql = kj::str("DELETE FROM _cf_KV WHERE key IN (", kj::strArray(params, ", "), ")");
+      break;
+    case MULTI_OP_COUNT:
+      KJ_UNREACHABLE;
+  }
+
+  return slot.emplace(db.prepare(SqliteDatabase::TRUSTED, sql));
+}
+
 }  // namespace workerd
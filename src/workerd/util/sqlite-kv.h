@@ -49,10 +49,39 @@ public:
 
   uint deleteAll();
 
-  // TODO(perf): Should we provide multi-get, multi-put, and multi-delete? It's a bit tricky to
-  //   implement them as single SQL queries, while still using prepared statements. The c-array
-  //   extension might help here, though it can only support arrays of NUL-terminated strings, not
-  //   byte blobs or strings containing NUL bytes.
+  template <typename Func>
+  void getMultiple(kj::ArrayPtr<const KeyPtr> keys, Func&& callback);
+  // Look up many keys at once, calling the callback (with KeyPtr and ValuePtr parameters) for each
+  // one found. Results are delivered in no particular order, and a key that appears multiple times
+  // in `keys` may be reported multiple times.
+
+  struct KeyValuePtrPair {
+    KeyPtr key;
+    ValuePtr value;
+  };
+
+  void putMultiple(kj::ArrayPtr<const KeyValuePtrPair> pairs);
+  // Store many values. If a key appears multiple times, the last occurrence wins.
+
+  uint deleteMultiple(kj::ArrayPtr<const KeyPtr> keys);
+  // Delete many keys and return how many of them were matched.
+
+  // The multi-key operations above bind keys into prepared statements with fixed-size IN (or
+  // VALUES) lists, so that a batch of keys is a single statement execution. (The carray extension
+  // can't be used here since it only supports NUL-terminated strings, and keys may contain NUL
+  // bytes.) A batch that doesn't exactly fill a statement's list is padded by repeating its last
+  // key, which collapses to a no-op: SQL IN ignores duplicates, and repeating the last pair of an
+  // upsert rewrites the same value.
+
+  static constexpr uint MULTI_PARAM_COUNTS[] = { 8, 32, SqliteDatabase::MAX_BOUND_PARAMETERS };
+  // Number of parameters bound by each size of statement. A batch uses the smallest one that
+  // fits, so a handful of keys doesn't bind the maximum. The largest is the most SQLite accepts
+  // in one statement. A get or delete binds one parameter per key and a put binds two, so their
+  // batches hold `MULTI_PARAM_COUNTS[i]` keys and half as many pairs, respectively.
+
+  static constexpr uint MAX_MULTI_BATCH = SqliteDatabase::MAX_BOUND_PARAMETERS;
+  static constexpr uint MAX_MULTI_PUT_BATCH = SqliteDatabase::MAX_BOUND_PARAMETERS / 2;
+  // Larger requests are split into batches of this many keys, or pairs for putMultiple().
 
 private:
   SqliteDatabase& db;
@@ -115,6 +144,28 @@ private:
     DELETE FROM _cf_KV
   )");
 
+  enum MultiOp {
+    MULTI_GET,
+    MULTI_PUT,
+    MULTI_DELETE,
+    MULTI_OP_COUNT
+  };
+
+  static constexpr uint MULTI_TIER_COUNT = kj::size(MULTI_PARAM_COUNTS);
+
+  kj::Maybe<SqliteDatabase::Statement> multiStatements[MULTI_OP_COUNT][MULTI_TIER_COUNT];
+  // Prepared lazily, since most actors only ever use a few batch sizes, if any.
+
+  static constexpr uint multiBatchSize(MultiOp op, uint tier) {
+    return op == MULTI_PUT ? MULTI_PARAM_COUNTS[tier] / 2 : MULTI_PARAM_COUNTS[tier];
+  }
+
+  static uint multiTier(MultiOp op, size_t count);
+  // Index into MULTI_PARAM_COUNTS of the statement to use for the next batch of `count` remaining
+  // keys or pairs.
+
+  SqliteDatabase::Statement& getMultiStatement(MultiOp op, uint tier);
+
   SqliteDatabase& ensureInitialized(SqliteDatabase& db);
   // Make sure the KV table is created, then return the same object.
 
@@ -140,6 +191,29 @@ bool SqliteKv::get(KeyPtr key, Func&& callback) {
   }
 }
 
+template <typename Func>
+void SqliteKv::getMultiple(kj::ArrayPtr<const KeyPtr> keys, Func&& callback) {
+  SqliteDatabase::Query::ValuePtr bindings[MAX_MULTI_BATCH];
+
+  while (keys.size() > 0) {
+    uint tier = multiTier(MULTI_GET, keys.size());
+    uint batchSize = multiBatchSize(MULTI_GET, tier);
+    size_t n = kj::min(keys.size(), size_t(batchSize));
+    for (uint i = 0; i < batchSize; i++) {
+      bindings[i] = keys[kj::min(size_t(i), n - 1)];
+    }
+
+    auto query = getMultiStatement(MULTI_GET, tier)
+        .run(kj::ArrayPtr<const SqliteDatabase::Query::ValuePtr>(bindings, batchSize));
+    while (!query.isDone()) {
+      callback(query.getText(0), query.getBlob(1));
+      query.nextRow();
+    }
+
+    keys = keys.slice(n, keys.size());
+  }
+}
+
 template <typename Func>
 uint SqliteKv::list(KeyPtr begin, kj::Maybe<KeyPtr> end, kj::Maybe<uint> limit, Order order,
                     Func&& callback) {
@@ -19,6 +19,40 @@
 namespace workerd {
 namespace {
 
+KJ_TEST("SQLite shared page cache budget") {
+  // The shared cache is only installed if a budget is set before SQLite initializes, so this test
+  // must come before any other test opens a database. Start with a budget too large to matter.
+  SqliteDatabase::setPageCacheLimit(kj::maxValue);
+  KJ_DEFER(SqliteDatabase::setPageCacheLimit(0));
+
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db1(vfs, kj::Path({"db1"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  SqliteDatabase db2(vfs, kj::Path({"db2"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+
+  auto fill = [](SqliteDatabase& db) {
+    db.run("CREATE TABLE blobs(value BLOB)");
+    for (auto i KJ_UNUSED: kj::zeroTo(200)) {
+      db.run("INSERT INTO blobs VALUES (zeroblob(4096))");
+    }
+  };
+
+  fill(db1);
+  fill(db2);
+  size_t unlimited = SqliteDatabase::getPageCacheSize();
+
+  constexpr size_t LIMIT = 256 * 1024;
+  KJ_ASSERT(unlimited > LIMIT * 2);
+
+  SqliteDatabase::setPageCacheLimit(LIMIT);
+  KJ_EXPECT(SqliteDatabase::getPageCacheSize() <= LIMIT);
+
+  // Reading everything back still works, and the cache stays bounded across both databases.
+  KJ_EXPECT(db1.run("SELECT SUM(LENGTH(value)) FROM blobs").getInt64(0) == 200 * 4096);
+  KJ_EXPECT(db2.run("SELECT SUM(LENGTH(value)) FROM blobs").getInt64(0) == 200 * 4096);
+  KJ_EXPECT(SqliteDatabase::getPageCacheSize() <= LIMIT);
+}
+
 void setupSql(SqliteDatabase& db) {
   // Initialize the database with some data.
 
@@ -341,6 +375,115 @@ KJ_TEST("SQLite Regulator") {
       KJ_EXPECT(getBar.run().getInt(0) == 456));
 }
 
+KJ_TEST("SQLite StatementCache") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  SqliteDatabase::Regulator regulator;
+
+  db.run("CREATE TABLE things(value INTEGER)");
+  db.run("INSERT INTO things VALUES (1), (2), (3)");
+
+  auto& cache = db.getStatementCache(regulator, 2);
+  constexpr kj::StringPtr COUNT = "SELECT COUNT(*) FROM things"_kj;
+
+  SqliteDatabase::Statement* first;
+  {
+    auto stmt = KJ_ASSERT_NONNULL(cache.find(COUNT));
+    first = stmt.get();
+    KJ_EXPECT(stmt->run().getInt(0) == 3);
+    KJ_EXPECT(cache.getMissCount() == 1);
+    KJ_EXPECT(cache.getHitCount() == 0);
+  }
+
+  // Same SQL finds the same statement.
+  {
+    auto stmt = KJ_ASSERT_NONNULL(cache.find(COUNT));
+    KJ_EXPECT(stmt.get() == first);
+    KJ_EXPECT(cache.getMissCount() == 1);
+    KJ_EXPECT(cache.getHitCount() == 1);
+
+    // While a query is stepping through the cached statement, the same SQL gets a fresh one, and
+    // each query sees all of its own rows.
+    constexpr kj::StringPtr VALUES = "SELECT value FROM things ORDER BY value"_kj;
+    auto outerStmt = KJ_ASSERT_NONNULL(cache.find(VALUES));
+    auto outer = outerStmt->run();
+    KJ_EXPECT(outer.getInt(0) == 1);
+
+    auto innerStmt = KJ_ASSERT_NONNULL(cache.find(VALUES));
+    KJ_EXPECT(innerStmt.get() != outerStmt.get());
+    {
+      auto inner = innerStmt->run();
+      uint count = 0;
+      for (; !inner.isDone(); inner.nextRow()) ++count;
+      KJ_EXPECT(count == 3);
+    }
+
+    outer.nextRow();
+    KJ_EXPECT(outer.getInt(0) == 2);
+    outer.nextRow();
+    KJ_EXPECT(outer.getInt(0) == 3);
+  }
+
+  // Once released, the cached statement is handed out again.
+  KJ_EXPECT(KJ_ASSERT_NONNULL(cache.find(COUNT)).get() == first);
+
+  // Schema changes don't invalidate cached statements.
+  db.run("ALTER TABLE things ADD COLUMN other INTEGER");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(cache.find(COUNT))->run().getInt(0) == 3);
+
+  // Multi-statement code isn't cacheable.
+  KJ_EXPECT(cache.find("SELECT 1; SELECT 2") == nullptr);
+  KJ_EXPECT(cache.size() == 2);
+
+  // Adding a third entry evicts the least-recently-used one, which is the multi-statement code.
+  KJ_EXPECT(cache.find(COUNT) != nullptr);
+  KJ_EXPECT(cache.find("SELECT value FROM things") != nullptr);
+  KJ_EXPECT(cache.size() == 2);
+  auto misses = cache.getMissCount();
+  KJ_EXPECT(cache.find(COUNT) != nullptr);
+  KJ_EXPECT(cache.getMissCount() == misses);
+  KJ_EXPECT(cache.find("SELECT 1; SELECT 2") == nullptr);
+  KJ_EXPECT(cache.getMissCount() == misses + 1);
+
+  // The cache insists on a single regulator.
+  SqliteDatabase::Regulator otherRegulator;
+  KJ_EXPECT_THROW_MESSAGE("must share one Regulator", db.getStatementCache(otherRegulator, 2));
+}
+
+KJ_TEST("SQLite resource limits") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+
+  class LimitedRegulator: public SqliteDatabase::Regulator {
+  public:
+    bool enforceVmStepLimit() override { return true; }
+  };
+  LimitedRegulator limited;
+
+  SqliteDatabase::Limits limits;
+  limits.maxValueLength = 1000;
+  limits.vmStepLimit = 100000;
+  db.setLimits(limits);
+
+  constexpr kj::StringPtr HEAVY =
+      "WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt WHERE x < 1000000) "
+      "SELECT COUNT(*) FROM cnt"_kj;
+  constexpr kj::StringPtr LIGHT =
+      "WITH RECURSIVE cnt(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM cnt WHERE x < 100) "
+      "SELECT COUNT(*) FROM cnt"_kj;
+
+  KJ_EXPECT(db.run(limited, LIGHT).getInt(0) == 100);
+  KJ_EXPECT_THROW_MESSAGE("exceeded its execution limit", db.run(limited, HEAVY));
+
+  // The database is still usable afterwards, and trusted queries aren't limited.
+  KJ_EXPECT(db.run(limited, LIGHT).getInt(0) == 100);
+  KJ_EXPECT(db.run(SqliteDatabase::TRUSTED, HEAVY).getInt(0) == 1000000);
+
+  KJ_EXPECT_THROW_MESSAGE("too big", db.run("SELECT zeroblob(2000)"));
+}
+
 KJ_TEST("SQLite onWrite callback") {
   auto dir = kj::newInMemoryDirectory(kj::nullClock());
   SqliteDatabase::Vfs vfs(*dir);
@@ -366,5 +509,40 @@ KJ_TEST("SQLite onWrite callback") {
   KJ_EXPECT(sawWrite);
 }
 
+KJ_TEST("SQLite query stats count rows written") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+
+  db.run("CREATE TABLE things(value INTEGER)");
+
+  // One statement writing several rows.
+  KJ_EXPECT(db.run("INSERT INTO things VALUES (1), (2), (3)").getStats().rowsWritten == 3);
+
+  // A statement that writes nothing doesn't pick up the count left over from the last one.
+  KJ_EXPECT(db.run("CREATE TABLE others(value INTEGER)").getStats().rowsWritten == 0);
+  KJ_EXPECT(db.run("SELECT COUNT(*) FROM things").getStats().rowsWritten == 0);
+
+  // Leading statements of multi-statement code count too.
+  KJ_EXPECT(db.run(
+      "INSERT INTO others VALUES (1), (2); UPDATE things SET value = value + 1")
+      .getStats().rowsWritten == 5);
+
+  // Rows returned one at a time are all counted once the statement completes, and writes made by
+  // another query between steps aren't.
+  {
+    auto query = db.run("UPDATE things SET value = value * 10 RETURNING value");
+    uint returned = 0;
+    for (; !query.isDone(); query.nextRow()) {
+      ++returned;
+      if (returned == 1) {
+        db.run("INSERT INTO others VALUES (3)");
+      }
+    }
+    KJ_EXPECT(returned == 3);
+    KJ_EXPECT(query.getStats().rowsWritten == 3);
+  }
+}
+
 }  // namespace
 }  // namespace workerd
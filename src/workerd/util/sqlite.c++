@@ -343,6 +343,9 @@ SqliteDatabase::SqliteDatabase(const Vfs& vfs, kj::PathPtr path, kj::WriteMode m
 }
 
 SqliteDatabase::~SqliteDatabase() noexcept(false) {
+  // Finalize cached statements first, or else the close would be blocked on them.
+  statementCache = nullptr;
+
   auto err = sqlite3_close(db);
   if (err == SQLITE_BUSY) {
     KJ_LOG(ERROR, "sqlite database destroyed while dependent objects still exist");
@@ -392,6 +395,12 @@ kj::Own<sqlite3_stmt> SqliteDatabase::prepareSql(
             "A prepared SQL statement must contain only one statement.", tail);
         break;
 
+      case TRY_SINGLE:
+        if (tail != sqlCode.end()) {
+          return nullptr;
+        }
+        break;
+
       case MULTI:
         if (tail != sqlCode.end()) {
           // There are more statements after this one, so execute this statement now.
@@ -412,7 +421,7 @@ kj::Own<sqlite3_stmt> SqliteDatabase::prepareSql(
           }
 
           // This isn't the last statement in the code. Execute it immediately.
-          int err = sqlite3_step(result);
+          int err = step(regulator, result);
           if (err == SQLITE_DONE) {
             // good
           } else if (err == SQLITE_ROW) {
@@ -686,11 +695,12 @@ void SqliteDatabase::setupSecurity() {
   // Enforces limits on UNION/UNION ALL/INTERSECT/etc
   // https://www.sqlite.org/limits.html#max_compound_select
   sqlite3_limit(db, SQLITE_LIMIT_COMPOUND_SELECT, 5);
+  // Note: SQLITE_LIMIT_VDBE_OP is ignored by modern SQLite; see Limits::vmStepLimit instead.
   sqlite3_limit(db, SQLITE_LIMIT_VDBE_OP, 25000);
   sqlite3_limit(db, SQLITE_LIMIT_FUNCTION_ARG, 32);
   sqlite3_limit(db, SQLITE_LIMIT_ATTACHED, 0);
   sqlite3_limit(db, SQLITE_LIMIT_LIKE_PATTERN_LENGTH, 50);
-  sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, 100);
+  sqlite3_limit(db, SQLITE_LIMIT_VARIABLE_NUMBER, MAX_BOUND_PARAMETERS);
   sqlite3_limit(db, SQLITE_LIMIT_TRIGGER_DEPTH, 10);
   sqlite3_limit(db, SQLITE_LIMIT_WORKER_THREADS, 0);
 
@@ -712,7 +722,8 @@ void SqliteDatabase::setupSecurity() {
   }, this));
 
   // 4. Set a progress handler or use interrupt() to limit CPU time.
-  // This happens inside LimitEnforcer.
+  // Overall CPU time is enforced by LimitEnforcer. A per-query budget can additionally be set with
+  // setLimits(), which installs a progress handler.
 
   // 5. Limit heap size.
   // Annoyingly, this sets a process-wide limit. We'll set 128MB "soft" limit (to try to control
@@ -720,7 +731,7 @@ void SqliteDatabase::setupSecurity() {
   // down the whole system).
   // TODO(perf): Revisit as popularity grows. Maybe make configurable? Maybe patch SQLite to allow
   //   these to be controlled per-database? Is page caching even all that important when the kernel
-  //   does its own page caching?
+  //   does its own page caching? (Per-database cache size can now be set using setLimits().)
   static bool doOnce KJ_UNUSED = []() {
     sqlite3_soft_heap_limit64(128u << 20);
     sqlite3_hard_heap_limit64(512u << 20);
@@ -744,15 +755,126 @@ SqliteDatabase::Statement SqliteDatabase::prepare(Regulator& regulator, kj::Stri
       prepareSql(regulator, sqlCode, SQLITE_PREPARE_PERSISTENT, SINGLE));
 }
 
+void SqliteDatabase::setLimits(const Limits& limits) {
+  KJ_IF_MAYBE(n, limits.maxValueLength) {
+    sqlite3_limit(db, SQLITE_LIMIT_LENGTH, *n);
+  }
+  KJ_IF_MAYBE(n, limits.maxPageCount) {
+    run(TRUSTED, kj::str("PRAGMA max_page_count = ", *n, ";"));
+  }
+  KJ_IF_MAYBE(n, limits.cacheSize) {
+    run(TRUSTED, kj::str("PRAGMA cache_size = ", *n, ";"));
+  }
+  KJ_IF_MAYBE(n, limits.vmStepLimit) {
+    vmStepLimit = *n;
+    sqlite3_progress_handler(db, Limits::VM_STEP_CHECK_INTERVAL, [](void* userdata) -> int {
+      auto& self = *reinterpret_cast<SqliteDatabase*>(userdata);
+      KJ_IF_MAYBE(budget, self.vmStepBudget) {
+        self.vmStepsUsed += Limits::VM_STEP_CHECK_INTERVAL;
+        if (self.vmStepsUsed > *budget) {
+          // Returning non-zero interrupts the statement with SQLITE_INTERRUPT.
+          self.vmStepBudgetExceeded = true;
+          return 1;
+        }
+      }
+      return 0;
+    }, this);
+  }
+}
+
+int SqliteDatabase::step(Regulator& regulator, sqlite3_stmt* statement) {
+  vmStepBudget = nullptr;
+  KJ_IF_MAYBE(limit, vmStepLimit) {
+    if (regulator.enforceVmStepLimit() && sqlite3_stmt_readonly(statement)) {
+      vmStepBudget = *limit;
+    }
+  }
+  vmStepsUsed = 0;
+  vmStepBudgetExceeded = false;
+  KJ_DEFER(vmStepBudget = nullptr);
+
+  int err = sqlite3_step(statement);
+  if (err == SQLITE_INTERRUPT && vmStepBudgetExceeded) {
+    SQLITE_REQUIRE(false, "SQL query exceeded its execution limit and was interrupted.");
+  }
+  return err;
+}
+
+SqliteDatabase::StatementCache& SqliteDatabase::getStatementCache(
+    Regulator& regulator, uint maxSize) {
+  KJ_IF_MAYBE(c, statementCache) {
+    KJ_REQUIRE(&c->get()->getRegulator() == &regulator,
+        "all users of the statement cache must share one Regulator");
+    return **c;
+  } else {
+    return *statementCache.emplace(kj::heap<StatementCache>(*this, regulator, maxSize));
+  }
+}
+
+SqliteDatabase::StatementCache::~StatementCache() noexcept(false) {
+  for (auto& entry: entries) {
+    lru.remove(*entry.value);
+  }
+}
+
+kj::Maybe<kj::Own<SqliteDatabase::Statement>>
+    SqliteDatabase::StatementCache::find(kj::StringPtr sqlCode) {
+  KJ_IF_MAYBE(e, entries.find(sqlCode)) {
+    auto& entry = **e;
+    ++hitCount;
+    lru.remove(entry);
+    lru.add(entry);
+
+    KJ_IF_MAYBE(s, entry.statement) {
+      if ((*s)->isShared()) {
+        // Another query is still running on this statement, so it can't be reset and rebound
+        // under it. Prepare a one-off copy instead.
+        return kj::heap(Statement(db, regulator,
+            db.prepareSql(regulator, sqlCode, 0, SINGLE)));
+      }
+      return (*s)->addWrappedRef();
+    } else {
+      return nullptr;
+    }
+  }
+
+  ++missCount;
+
+  auto entry = kj::heap<Entry>();
+  entry->sqlCode = kj::str(sqlCode);
+  auto ownStmt = db.prepareSql(regulator, sqlCode, SQLITE_PREPARE_PERSISTENT, TRY_SINGLE);
+  if (ownStmt.get() != nullptr) {
+    entry->statement = kj::refcountedWrapper<Statement>(
+        Statement(db, regulator, kj::mv(ownStmt)));
+  }
+
+  if (entries.size() >= maxSize) {
+    // Evict the least-recently-used entry. If it's still in use, its query keeps it alive.
+    auto& victim = lru.front();
+    lru.remove(victim);
+    KJ_ASSERT(entries.erase(victim.sqlCode));
+  }
+
+  auto& result = *entry;
+  lru.add(result);
+  entries.insert(result.sqlCode, kj::mv(entry));
+
+  KJ_IF_MAYBE(s, result.statement) {
+    return (*s)->addWrappedRef();
+  } else {
+    return nullptr;
+  }
+}
+
 SqliteDatabase::Query::Query(SqliteDatabase& db, Regulator& regulator, Statement& statement,
                              kj::ArrayPtr<const ValuePtr> bindings)
-    : db(db), regulator(regulator), statement(statement) {
+    : db(db), regulator(regulator), changesAtStart(totalChanges(db)), statement(statement) {
   init(bindings);
 }
 
 SqliteDatabase::Query::Query(SqliteDatabase& db, Regulator& regulator, kj::StringPtr sqlCode,
                              kj::ArrayPtr<const ValuePtr> bindings)
-    : db(db), regulator(regulator),
+    : db(db), regulator(regulator), changesAtStart(totalChanges(db)),
       ownStatement(db.prepareSql(regulator, sqlCode, 0, MULTI)),
       statement(ownStatement) {
   init(bindings);
@@ -778,6 +900,10 @@ void SqliteDatabase::Query::checkRequirements(size_t size) {
   SQLITE_REQUIRE(size == sqlite3_bind_parameter_count(statement),
       "Wrong number of parameter bindings for SQL query.");
 
+  // Prepared statements accumulate counters across executions, so reset them for getStats().
+  sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_VM_STEP, true);
+  sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_FULLSCAN_STEP, true);
+
   KJ_IF_MAYBE(cb, db.onWriteCallback) {
     if (!sqlite3_stmt_readonly(statement)) {
       (*cb)();
@@ -845,14 +971,42 @@ void SqliteDatabase::Query::nextRow() {
   KJ_DEFER(db.currentRegulator = nullptr);
   db.currentRegulator = regulator;
 
-  int err = sqlite3_step(statement);
+  auto start = kj::systemPreciseMonotonicClock().now();
+  auto changesBefore = totalChanges(db);
+  int err = db.step(regulator, statement);
+  stepTime += kj::systemPreciseMonotonicClock().now() - start;
+  wroteDuringStep = wroteDuringStep || totalChanges(db) != changesBefore;
+
   if (err == SQLITE_DONE) {
     done = true;
-  } else if (err != SQLITE_ROW) {
+    // sqlite3_changes() counts every row the statement inserted, updated, or deleted, but it's
+    // only set once the statement completes, and is left over from an earlier statement if this
+    // one changed no rows. Changes made by other queries between our steps aren't counted.
+    if (wroteDuringStep) {
+      rowsWritten += sqlite3_changes64(db);
+    }
+  } else if (err == SQLITE_ROW) {
+    ++rowsReturned;
+  } else {
     SQLITE_CALL_FAILED("sqlite3_step()", err);
   }
 }
 
+SqliteDatabase::Query::Stats SqliteDatabase::Query::getStats() {
+  uint64_t fullScanSteps = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_FULLSCAN_STEP, false);
+  return {
+    .rowsRead = kj::max(rowsReturned, fullScanSteps),
+    .rowsWritten = rowsWritten,
+    .vmSteps = static_cast<uint64_t>(
+        sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_VM_STEP, false)),
+    .duration = stepTime,
+  };
+}
+
+int64_t SqliteDatabase::Query::totalChanges(SqliteDatabase& db) {
+  return sqlite3_total_changes64(db);
+}
+
 uint SqliteDatabase::Query::changeCount() {
   KJ_REQUIRE(done);
   KJ_DREQUIRE(columnCount() == 0,
@@ -905,6 +1059,281 @@ bool SqliteDatabase::Query::isNull(uint column) {
   return sqlite3_column_type(statement, column) == SQLITE_NULL;
 }
 
+// =======================================================================================
+// Shared page cache
+//
+// SQLite's default page cache (pcache1) gives each database connection its own cache, bounded by
+// its `cache_size`. With many databases open -- e.g. one per Durable Object -- that means page
+// cache memory scales with the number of open databases. We replace it with an implementation
+// in which all caches also share one process-wide byte budget and one LRU list, so that under
+// memory pressure whichever pages were least recently used anywhere are evicted first.
+
+namespace {
+
+struct PageCache;
+
+struct CachedPage {
+  sqlite3_pcache_page base;
+  // What SQLite sees. Must be first, as we cast between the two.
+
+  PageCache& cache;
+  unsigned key;
+  bool pinned = true;
+
+  kj::ListLink<CachedPage> globalLink;
+  kj::ListLink<CachedPage> cacheLink;
+  // Links in the global and per-cache LRU lists. A page is in both lists if it is unpinned and its
+  // cache is purgeable, otherwise it is in neither.
+
+  kj::Array<kj::byte> buffer;
+  // Page content followed by SQLite's per-page "extra" space.
+
+  CachedPage(PageCache& cache, unsigned key, size_t pageSize, size_t extraSize)
+      : cache(cache), key(key), buffer(kj::heapArray<kj::byte>(pageSize + extraSize)) {
+    base.pBuf = buffer.begin();
+    base.pExtra = buffer.begin() + pageSize;
+
+    // SQLite relies on the extra space starting out zeroed so that it can recognize new pages.
+    memset(base.pExtra, 0, extraSize);
+  }
+};
+
+struct PageCache {
+  size_t pageSize;
+  size_t extraSize;
+  bool purgeable;
+
+  uint maxPages = 100;
+  // Set by SQLite via xCachesize() (i.e. `PRAGMA cache_size`).
+
+  uint pinnedCount = 0;
+
+  kj::HashMap<unsigned, kj::Own<CachedPage>> pages;
+  kj::List<CachedPage, &CachedPage::cacheLink> lru;
+
+  PageCache(size_t pageSize, size_t extraSize, bool purgeable)
+      : pageSize(pageSize), extraSize(extraSize), purgeable(purgeable) {}
+
+  size_t bytesPerPage() { return sizeof(CachedPage) + pageSize + extraSize; }
+};
+
+struct PageCacheGlobals {
+  size_t limit = 0;
+  size_t used = 0;
+
+  kj::List<CachedPage, &CachedPage::globalLink> lru;
+  // Unpinned pages of all purgeable caches, least-recently-used first.
+
+  bool overLimit(size_t extra = 0) { return limit > 0 && used + extra > limit; }
+
+  void freePage(CachedPage& page) {
+    auto& cache = page.cache;
+    if (page.globalLink.isLinked()) {
+      lru.remove(page);
+      cache.lru.remove(page);
+    }
+    if (page.pinned) {
+      --cache.pinnedCount;
+    }
+    used -= cache.bytesPerPage();
+    unsigned key = page.key;  // `page` is destroyed by erase()
+    KJ_ASSERT(cache.pages.erase(key));
+  }
+
+  void evictWhileOverLimit() {
+    while (overLimit() && !lru.empty()) {
+      freePage(lru.front());
+    }
+  }
+};
+
+kj::MutexGuarded<PageCacheGlobals>& getPageCacheGlobals() {
+  // Leaked intentionally: SQLite may still hold caches during static destruction.
+  static auto& globals = *new kj::MutexGuarded<PageCacheGlobals>();
+  return globals;
+}
+
+PageCache& castCache(sqlite3_pcache* cache) {
+  return *reinterpret_cast<PageCache*>(cache);
+}
+
+CachedPage& castPage(sqlite3_pcache_page* page) {
+  return *reinterpret_cast<CachedPage*>(page);
+}
+
+// All of these may be called concurrently for different databases, so they all take the global
+// lock. None of them allocate outside of kj::heap(), so the only exceptions they could encounter
+// are bugs, which would crash anyway since these are `noexcept`.
+
+const sqlite3_pcache_methods2 PAGE_CACHE_METHODS = {
+  .iVersion = 1,
+  .pArg = nullptr,
+  .xInit = [](void*) noexcept -> int { return SQLITE_OK; },
+  .xShutdown = [](void*) noexcept -> void {},
+
+  .xCreate = [](int szPage, int szExtra, int bPurgeable) noexcept -> sqlite3_pcache* {
+    return reinterpret_cast<sqlite3_pcache*>(new PageCache(szPage, szExtra, bPurgeable));
+  },
+
+  .xCachesize = [](sqlite3_pcache* c, int nCachesize) noexcept -> void {
+    auto lock = getPageCacheGlobals().lockExclusive();
+    castCache(c).maxPages = kj::max(nCachesize, 1);
+  },
+
+  .xPagecount = [](sqlite3_pcache* c) noexcept -> int {
+    auto lock = getPageCacheGlobals().lockExclusive();
+    return castCache(c).pages.size();
+  },
+
+  .xFetch = [](sqlite3_pcache* c, unsigned key, int createFlag) noexcept -> sqlite3_pcache_page* {
+    auto& cache = castCache(c);
+    auto lock = getPageCacheGlobals().lockExclusive();
+
+    KJ_IF_MAYBE(existing, cache.pages.find(key)) {
+      auto& page = **existing;
+      if (!page.pinned) {
+        if (page.globalLink.isLinked()) {
+          lock->lru.remove(page);
+          cache.lru.remove(page);
+        }
+        page.pinned = true;
+        ++cache.pinnedCount;
+      }
+      return &page.base;
+    }
+
+    if (createFlag == 0) return nullptr;
+
+    size_t newBytes = cache.bytesPerPage();
+    if (createFlag == 1) {
+      // SQLite is asking us to allocate only if it's easy. If this cache is mostly pinned or we're
+      // over budget, returning null makes SQLite spill dirty pages and ask again with
+      // createFlag = 2.
+      if (cache.pinnedCount >= cache.maxPages - cache.maxPages / 10 ||
+          (lock->overLimit(newBytes) && lock->lru.empty())) {
+        return nullptr;
+      }
+    }
+
+    // Make room, first under the global budget, then under this cache's own size limit.
+    while (lock->overLimit(newBytes) && !lock->lru.empty()) {
+      lock->freePage(lock->lru.front());
+    }
+    while (cache.pages.size() >= cache.maxPages && !cache.lru.empty()) {
+      lock->freePage(cache.lru.front());
+    }
+
+    auto page = kj::heap<CachedPage>(cache, key, cache.pageSize, cache.extraSize);
+    auto& result = page->base;
+    ++cache.pinnedCount;
+    lock->used += newBytes;
+    cache.pages.insert(key, kj::mv(page));
+    return &result;
+  },
+
+  .xUnpin = [](sqlite3_pcache* c, sqlite3_pcache_page* p, int discard) noexcept -> void {
+    auto& cache = castCache(c);
+    auto& page = castPage(p);
+    auto lock = getPageCacheGlobals().lockExclusive();
+
+    KJ_ASSERT(page.pinned);
+    if (discard || (cache.purgeable && lock->overLimit())) {
+      lock->freePage(page);
+      return;
+    }
+
+    page.pinned = false;
+    --cache.pinnedCount;
+    if (cache.purgeable) {
+      lock->lru.add(page);
+      cache.lru.add(page);
+    }
+  },
+
+  .xRekey = [](sqlite3_pcache* c, sqlite3_pcache_page* p,
+               unsigned oldKey, unsigned newKey) noexcept -> void {
+    auto& cache = castCache(c);
+    auto lock = getPageCacheGlobals().lockExclusive();
+
+    // Any page already at `newKey` is unpinned and must be discarded.
+    KJ_IF_MAYBE(existing, cache.pages.find(newKey)) {
+      lock->freePage(**existing);
+    }
+
+    auto own = kj::mv(KJ_ASSERT_NONNULL(cache.pages.find(oldKey)));
+    KJ_ASSERT(own.get() == &castPage(p));
+    cache.pages.erase(oldKey);
+    own->key = newKey;
+    cache.pages.insert(newKey, kj::mv(own));
+  },
+
+  .xTruncate = [](sqlite3_pcache* c, unsigned iLimit) noexcept -> void {
+    auto& cache = castCache(c);
+    auto lock = getPageCacheGlobals().lockExclusive();
+
+    // Pages at or above the limit are discarded, even if pinned.
+    kj::Vector<CachedPage*> doomed;
+    for (auto& entry: cache.pages) {
+      if (entry.key >= iLimit) doomed.add(entry.value.get());
+    }
+    for (auto page: doomed) {
+      lock->freePage(*page);
+    }
+  },
+
+  .xDestroy = [](sqlite3_pcache* c) noexcept -> void {
+    auto& cache = castCache(c);
+    {
+      auto lock = getPageCacheGlobals().lockExclusive();
+      while (cache.pages.size() > 0) {
+        lock->freePage(*cache.pages.begin()->value);
+      }
+    }
+    delete &cache;
+  },
+
+  .xShrink = [](sqlite3_pcache* c) noexcept -> void {
+    auto& cache = castCache(c);
+    auto lock = getPageCacheGlobals().lockExclusive();
+    while (!cache.lru.empty()) {
+      lock->freePage(cache.lru.front());
+    }
+  },
+};
+
+bool installPageCache() {
+  // Installs our page cache, the first time only. This must happen before SQLite initializes
+  // itself, which the first call to sqlite3_vfs_find() does, i.e. before the first
+  // SqliteDatabase::Vfs is created. Returns false if it's too late.
+  static bool installed = ([]() {
+    int err = sqlite3_config(SQLITE_CONFIG_PCACHE2, &PAGE_CACHE_METHODS);
+    if (err != SQLITE_OK) {
+      // SQLite is already initialized. Keep SQLite's default cache.
+      KJ_LOG(WARNING, "couldn't install shared SQLite page cache; set its budget before "
+             "opening any database", sqlite3_errstr(err));
+      return false;
+    }
+    return true;
+  })();
+  return installed;
+}
+
+}  // namespace
+
+void SqliteDatabase::setPageCacheLimit(size_t bytes) {
+  // Without a budget SQLite's own cache does just as well, so only pay for the global lock on
+  // every page fetch once someone asks for one.
+  if (bytes > 0 && !installPageCache()) return;
+
+  auto lock = getPageCacheGlobals().lockExclusive();
+  lock->limit = bytes;
+  lock->evictWhileOverLimit();
+}
+
+size_t SqliteDatabase::getPageCacheSize() {
+  return getPageCacheGlobals().lockShared()->used;
+}
+
 // =======================================================================================
 // VFS
 
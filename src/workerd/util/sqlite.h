@@ -6,6 +6,10 @@
 
 #include <kj/filesystem.h>
 #include <kj/one-of.h>
+#include <kj/map.h>
+#include <kj/list.h>
+#include <kj/refcount.h>
+#include <kj/time.h>
 #include <utility>
 
 struct sqlite3;
@@ -35,7 +39,9 @@ public:
   class Lock;
   class LockManager;
   class Regulator;
+  class StatementCache;
   struct VfsOptions;
+  struct Limits;
 
   SqliteDatabase(const Vfs& vfs, kj::PathPtr path);
   SqliteDatabase(const Vfs& vfs, kj::PathPtr path, kj::WriteMode mode);
@@ -50,6 +56,24 @@ public:
   // Use as the `Regulator&` for queries that are fully trusted. As a general rule, this should
   // be used if and only if the SQL query is a string literal.
 
+  static constexpr uint MAX_BOUND_PARAMETERS = 100;
+  // Most parameters any one statement may bind (SQLITE_LIMIT_VARIABLE_NUMBER). Preparing a
+  // statement with more fails, even for trusted queries.
+
+  static void setPageCacheLimit(size_t bytes);
+  // Set a byte budget for the page cache shared by every database in the process. When the
+  // budget is exceeded, the least-recently-used unpinned pages are evicted, regardless of which
+  // database they belong to, so the page cache's memory tracks the working set rather than the
+  // number of open databases. Zero (the default) means no global budget; each database's cache is
+  // then bounded only by its own `PRAGMA cache_size`, as usual.
+  //
+  // The shared cache replaces SQLite's own only once a non-zero budget is set, which must happen
+  // before the first database is opened. Set later, the budget has no effect.
+
+  static size_t getPageCacheSize();
+  // Total bytes currently held by the shared page cache, for all databases. Always zero if no
+  // budget was ever set.
+
   Statement prepare(Regulator& regulator, kj::StringPtr sqlCode);
   // Prepares the given SQL code as a persistent statement that can be used across several queries.
   // Don't use this for one-off queries; pass the code to the Query constructor.
@@ -90,9 +114,21 @@ public:
   // any literal values that might contain sensitive information. This is intended to be safe for
   // debug logs.
 
+  void setLimits(const Limits& limits);
+  // Apply resource limits to this database. Fields of `limits` that are null are left as they
+  // were.
+
+  StatementCache& getStatementCache(Regulator& regulator, uint maxSize);
+  // Get this database's cache of prepared statements for dynamic SQL, creating it on first use.
+  // Every call must pass the same `regulator`, which must outlive the database, since cached
+  // statements may be re-prepared under it whenever the schema changes.
+
 private:
   sqlite3* db;
 
+  kj::Maybe<kj::Own<StatementCache>> statementCache;
+  // Destroyed before the database is closed.
+
   kj::Maybe<Regulator&> currentRegulator;
   // Set while a query is compiling.
 
@@ -101,9 +137,21 @@ private:
 
   kj::Maybe<kj::Function<void()>> onWriteCallback;
 
+  kj::Maybe<uint64_t> vmStepLimit;
+  // From setLimits().
+
+  kj::Maybe<uint64_t> vmStepBudget;
+  uint64_t vmStepsUsed = 0;
+  bool vmStepBudgetExceeded = false;
+  // State of the progress handler during one step(), if `vmStepLimit` applies to it.
+
   void close();
 
-  enum Multi { SINGLE, MULTI };
+  int step(Regulator& regulator, sqlite3_stmt* statement);
+  // Calls sqlite3_step(), enforcing `vmStepLimit` if it applies. Returns the result code, except
+  // that if the step limit was exceeded, it throws.
+
+  enum Multi { SINGLE, MULTI, TRY_SINGLE };
 
   kj::Own<sqlite3_stmt> prepareSql(
       Regulator& regulator, kj::StringPtr sqlCode, uint prepFlags, Multi multi);
@@ -113,6 +161,9 @@ private:
   //
   // In MULTI mode, if `sqlCode` contains multiple statements, each statement before the last one
   // is executed immediately. The returned object represents the last statement.
+  //
+  // TRY_SINGLE mode is like SINGLE, but returns null rather than throwing if `sqlCode` contains
+  // multiple statements.
 
   bool isAuthorized(int actionCode,
       kj::Maybe<kj::StringPtr> param1, kj::Maybe<kj::StringPtr> param2,
@@ -161,6 +212,11 @@ public:
   // undefined behavior. Such bugs are always in C++ code; JavaScript application code must be
   // prohibited from causing such errors in the first place.
 
+  virtual bool enforceVmStepLimit() { return false; }
+  // Should the database's `Limits::vmStepLimit` apply to queries under this regulator? Typically
+  // true for application queries and false for trusted ones, which need to be able to finish
+  // housekeeping work however large it is.
+
   virtual bool allowTransactions() { return true; }
   // Are BEGIN TRANSACTION and SAVEPOINT statements allowed? Note that if allowed, SAVEPOINT will
   // also be subject to `isAllowedName()` for the savepoint name. If denied, the application will
@@ -200,6 +256,7 @@ private:
       : db(db), regulator(regulator), stmt(kj::mv(stmt)) {}
 
   friend class SqliteDatabase;
+  friend class SqliteDatabase::StatementCache;
 };
 
 class SqliteDatabase::Query {
@@ -227,6 +284,26 @@ public:
   void nextRow();
   // Advance to the next row.
 
+  struct Stats {
+    uint64_t rowsRead;
+    // Approximate number of table rows read: the number of rows returned, or, if greater, the
+    // number of rows stepped over by full table scans. The latter makes accidental full scans
+    // stand out even when they return little.
+
+    uint64_t rowsWritten;
+    // Rows inserted, updated, or deleted.
+
+    uint64_t vmSteps;
+    // SQLite virtual machine operations executed, a rough measure of CPU cost.
+
+    kj::Duration duration;
+    // Wall time spent executing the statement, i.e. inside sqlite3_step().
+  };
+
+  Stats getStats();
+  // Statistics about the query's execution so far. For multi-statement code, only the last
+  // statement is counted, except that `rowsWritten` includes rows written by all of them.
+
   uint columnCount();
   // How many columns does each row of the result have?
 
@@ -266,10 +343,22 @@ public:
 private:
   SqliteDatabase& db;
   Regulator& regulator;
+
+  int64_t changesAtStart;
+  // The database's total change count before the query started. Declared before `ownStatement`
+  // so that it's captured before any leading statements of multi-statement code are executed.
+
   kj::Own<sqlite3_stmt> ownStatement;   // for one-off queries
   sqlite3_stmt* statement;
   bool done = false;
 
+  uint64_t rowsReturned = 0;
+  uint64_t rowsWritten = totalChanges(db) - changesAtStart;
+  bool wroteDuringStep = false;
+  kj::Duration stepTime = 0 * kj::NANOSECONDS;
+  // For getStats(). `rowsWritten` starts out counting the rows written by any leading statements
+  // of multi-statement code, which have all run by the time it's initialized.
+
   friend class SqliteDatabase;
 
   Query(SqliteDatabase& db, Regulator& regulator, Statement& statement,
@@ -278,12 +367,12 @@ private:
         kj::ArrayPtr<const ValuePtr> bindings);
   template <typename... Params>
   Query(SqliteDatabase& db, Regulator& regulator, Statement& statement, Params&&... bindings)
-      : db(db), regulator(regulator), statement(statement) {
+      : db(db), regulator(regulator), changesAtStart(totalChanges(db)), statement(statement) {
     bindAll(std::index_sequence_for<Params...>(), kj::fwd<Params>(bindings)...);
   }
   template <typename... Params>
   Query(SqliteDatabase& db, Regulator& regulator, kj::StringPtr sqlCode, Params&&... bindings)
-      : db(db), regulator(regulator),
+      : db(db), regulator(regulator), changesAtStart(totalChanges(db)),
         ownStatement(db.prepareSql(regulator, sqlCode, 0, MULTI)),
         statement(ownStatement) {
     bindAll(std::index_sequence_for<Params...>(), kj::fwd<Params>(bindings)...);
@@ -291,6 +380,8 @@ private:
 
   void checkRequirements(size_t size);
 
+  static int64_t totalChanges(SqliteDatabase& db);
+
   void init(kj::ArrayPtr<const ValuePtr> bindings);
 
   void bind(uint column, ValuePtr value);
@@ -314,6 +405,86 @@ private:
   }
 };
 
+class SqliteDatabase::StatementCache {
+  // An LRU cache of prepared statements, keyed by SQL text. This lets callers that repeatedly
+  // run the same dynamic SQL -- e.g. `SqlStorage::exec()` called with a fixed set of query
+  // strings -- skip re-preparing it every time.
+  //
+  // Statements don't need to be dropped when the schema changes: SQLite transparently
+  // re-prepares them on their next execution (under the cache's Regulator, see Query::nextRow()).
+
+public:
+  StatementCache(SqliteDatabase& db, Regulator& regulator, uint maxSize)
+      : db(db), regulator(regulator), maxSize(maxSize) {}
+  ~StatementCache() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(StatementCache);
+
+  Regulator& getRegulator() { return regulator; }
+
+  kj::Maybe<kj::Own<Statement>> find(kj::StringPtr sqlCode);
+  // Returns a prepared statement for `sqlCode`, preparing and caching it if needed. The statement
+  // is in use for as long as the caller holds the returned reference, which must outlive any
+  // Query run on it. Meanwhile, finding the same code again returns a freshly-prepared statement
+  // that isn't cached, so two queries never step the same statement.
+  //
+  // Returns null if `sqlCode` contains multiple statements, which can't be prepared for reuse;
+  // the caller should run it as a one-off query instead.
+
+  uint getHitCount() { return hitCount; }
+  uint getMissCount() { return missCount; }
+  size_t size() { return entries.size(); }
+
+private:
+  struct Entry {
+    kj::String sqlCode;
+    kj::Maybe<kj::Own<kj::RefcountedWrapper<Statement>>> statement;
+    // Null if `sqlCode` contains multiple statements. The statement is in use while anyone other
+    // than the cache holds a reference to it.
+
+    kj::ListLink<Entry> link;
+  };
+
+  SqliteDatabase& db;
+  Regulator& regulator;
+  uint maxSize;
+
+  kj::HashMap<kj::StringPtr, kj::Own<Entry>> entries;
+  // Keyed by `Entry::sqlCode`.
+
+  kj::List<Entry, &Entry::link> lru;
+  // Least-recently-used first.
+
+  uint hitCount = 0;
+  uint missCount = 0;
+};
+
+struct SqliteDatabase::Limits {
+  // Per-database resource limits. See SqliteDatabase::setLimits().
+
+  kj::Maybe<uint> maxValueLength;
+  // Largest string or blob, in bytes (SQLITE_LIMIT_LENGTH). By default this is 1,000,000.
+
+  kj::Maybe<uint64_t> maxPageCount;
+  // Largest the database may grow, in pages (`PRAGMA max_page_count`).
+
+  kj::Maybe<int64_t> cacheSize;
+  // Size of this database's page cache (`PRAGMA cache_size`): in pages if positive, or in KiB if
+  // negative. See also SqliteDatabase::setPageCacheLimit(), which bounds all databases together.
+
+  kj::Maybe<uint64_t> vmStepLimit;
+  // Most SQLite virtual machine instructions that one step of a read-only statement -- producing
+  // one row, or running to completion if it returns none -- may execute before it is
+  // interrupted with an error. Since SQLite runs synchronously, this bounds how long one query
+  // can block the thread. Enforced only for regulators that ask for it via
+  // `Regulator::enforceVmStepLimit()`, and checked every `VM_STEP_CHECK_INTERVAL` instructions.
+  //
+  // Statements that write are never interrupted: SQLite rolls back the entire enclosing
+  // transaction when interrupting a write, which would silently discard earlier writes that the
+  // application thinks succeeded.
+
+  static constexpr uint VM_STEP_CHECK_INTERVAL = 1000;
+};
+
 struct SqliteDatabase::VfsOptions {
   // Options affecting SqliteDatabase::Vfs constructor.
 
@@ -0,0 +1,96 @@
+// Copyright (c) 2017-2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "thread-pool.h"
+#include <kj/test.h>
+
+namespace workerd {
+namespace {
+
+KJ_TEST("ThreadPool runs jobs") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  ThreadPool pool(2, 16);
+  KJ_EXPECT(pool.getThreadCount() == 2);
+
+  kj::Vector<kj::Promise<ThreadPool::Result<uint>>> promises;
+  for (uint i = 0; i < 10; i++) {
+    promises.add(pool.run([i]() {
+      uint sum = 0;
+      for (uint j = 0; j <= i * 1000; j++) sum += j;
+      return sum;
+    }));
+  }
+
+  for (uint i = 0; i < 10; i++) {
+    auto result = promises[i].wait(ws);
+    uint n = i * 1000;
+    KJ_EXPECT(result.value == n * (n + 1) / 2);
+    KJ_EXPECT(result.cpuTime >= 0 * kj::NANOSECONDS);
+  }
+}
+
+KJ_TEST("ThreadPool propagates exceptions") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  ThreadPool pool(1, 16);
+  auto promise = pool.run([]() -> int { KJ_FAIL_REQUIRE("job failed"); });
+  KJ_EXPECT_THROW_MESSAGE("job failed", promise.wait(ws));
+
+  // The thread survives a failed job.
+  KJ_EXPECT(pool.run([]() { return 42; }).wait(ws).value == 42);
+}
+
+KJ_TEST("ThreadPool survives abandoned jobs") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  ThreadPool pool(1, 16);
+  kj::MutexGuarded<bool> release(false);
+  {
+    auto blocked = pool.run([&]() {
+      release.when([](bool b) { return b; }, [](bool) {});
+      return 1;
+    });
+    auto queued = pool.run([]() { return 2; });
+    // Both promises are dropped here, one while running and one while still queued.
+  }
+  *release.lockExclusive() = true;
+  KJ_EXPECT(pool.run([]() { return 3; }).wait(ws).value == 3);
+}
+
+KJ_TEST("ThreadPool runs jobs inline once the queue is full") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  ThreadPool pool(1, 1);
+  kj::MutexGuarded<bool> started(false);
+  kj::MutexGuarded<bool> release(false);
+  auto blocked = pool.run([&]() {
+    *started.lockExclusive() = true;
+    release.when([](bool b) { return b; }, [](bool) {});
+    return 1;
+  });
+  started.when([](bool b) { return b; }, [](bool) {});
+
+  // The only thread is busy, so this job takes the one queue slot...
+  auto queued = pool.run([]() { return 2; });
+
+  // ...and this one has to run right here, before run() returns.
+  bool ran = false;
+  auto inlined = pool.run([&]() { ran = true; return 3; });
+  KJ_EXPECT(ran);
+
+  *release.lockExclusive() = true;
+  KJ_EXPECT(blocked.wait(ws).value == 1);
+  KJ_EXPECT(queued.wait(ws).value == 2);
+  auto result = inlined.wait(ws);
+  KJ_EXPECT(result.value == 3);
+  KJ_EXPECT(result.cpuTime == 0 * kj::NANOSECONDS);
+}
+
+}  // namespace
+}  // namespace workerd
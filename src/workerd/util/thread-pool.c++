@@ -0,0 +1,81 @@
+// Copyright (c) 2017-2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "thread-pool.h"
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace workerd {
+
+ThreadPool::ThreadPool(uint threadCount, uint maxQueued): maxQueued(maxQueued) {
+  KJ_REQUIRE(threadCount > 0);
+  threads.reserve(threadCount);
+  for (uint i = 0; i < threadCount; i++) {
+    threads.add(kj::heap<kj::Thread>([this]() { threadMain(); }));
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept(false) {
+  std::deque<kj::Function<void()>> dropped;
+  {
+    auto lock = queue.lockExclusive();
+    lock->shuttingDown = true;
+    dropped = kj::mv(lock->jobs);
+  }
+  // Joins each thread once it finishes its current job.
+  threads.clear();
+  // Destroying the dropped jobs destroys their fulfillers, which rejects the promises.
+}
+
+bool ThreadPool::tryReserve() {
+  auto lock = queue.lockExclusive();
+  KJ_REQUIRE(!lock->shuttingDown, "thread pool is shutting down");
+  if (lock->reserved >= maxQueued) return false;
+  ++lock->reserved;
+  return true;
+}
+
+void ThreadPool::enqueue(kj::Function<void()> job) {
+  auto lock = queue.lockExclusive();
+  KJ_REQUIRE(!lock->shuttingDown, "thread pool is shutting down");
+  lock->jobs.push_back(kj::mv(job));
+}
+
+void ThreadPool::threadMain() {
+  for (;;) {
+    kj::Function<void()> job;
+    {
+      auto lock = queue.lockExclusive();
+      lock.wait([](const Queue& q) { return q.shuttingDown || !q.jobs.empty(); });
+      if (lock->shuttingDown) return;
+      job = kj::mv(lock->jobs.front());
+      lock->jobs.pop_front();
+      --lock->reserved;
+    }
+    job();
+  }
+}
+
+kj::Duration ThreadPool::getThreadCpuTime() {
+#if _WIN32
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return 0 * kj::NANOSECONDS;
+  }
+  auto to100ns = [](const FILETIME& t) {
+    return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+  };
+  return (to100ns(kernel) + to100ns(user)) * 100 * kj::NANOSECONDS;
+#else
+  struct timespec ts;
+  KJ_SYSCALL(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts));
+  return ts.tv_sec * kj::SECONDS + ts.tv_nsec * kj::NANOSECONDS;
+#endif
+}
+
+}  // namespace workerd
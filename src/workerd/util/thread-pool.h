@@ -0,0 +1,102 @@
+// Copyright (c) 2017-2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/async.h>
+#include <kj/function.h>
+#include <kj/mutex.h>
+#include <kj/thread.h>
+#include <kj/time.h>
+#include <kj/vector.h>
+#include <deque>
+
+namespace workerd {
+
+using kj::uint;
+
+class ThreadPool {
+  // A fixed number of threads that run self-contained CPU-bound jobs, such as key derivation, on
+  // behalf of threads that shouldn't block on them (e.g. because they hold an isolate lock).
+  //
+  // Jobs must not touch anything owned by the submitting thread: they run concurrently with it,
+  // and may still be running after the submitter has lost interest in the result.
+  //
+  // At most `maxQueued` jobs wait for a thread. Beyond that, run() executes the job on the calling
+  // thread instead, so a submitter that outpaces the pool is slowed down to the pool's pace rather
+  // than piling up work (and memory) without bound.
+
+public:
+  ThreadPool(uint threadCount, uint maxQueued);
+  ~ThreadPool() noexcept(false);
+  // Destroying the pool waits for the running jobs to finish. Queued jobs are dropped, rejecting
+  // their promises.
+
+  KJ_DISALLOW_COPY_AND_MOVE(ThreadPool);
+
+  template <typename T>
+  struct Result {
+    T value;
+    kj::Duration cpuTime;
+    // CPU time the job spent on its pool thread. Zero if the job ran on the calling thread because
+    // the queue was full, since that time is already the caller's own.
+  };
+
+  template <typename Func>
+  auto run(Func&& func) -> kj::Promise<Result<decltype(func())>>;
+  // Queues `func` to run on one of the pool's threads. The returned promise must be awaited on a
+  // thread with a KJ event loop; it resolves to `func`'s result, or rejects with whatever it threw.
+  // Dropping the promise doesn't interrupt a job that has started. If the queue is full, `func`
+  // runs before run() returns.
+
+  uint getThreadCount() const { return threads.size(); }
+
+private:
+  struct Queue {
+    std::deque<kj::Function<void()>> jobs;
+    uint reserved = 0;
+    // Number of jobs in `jobs` plus those run() has made room for but not yet enqueued.
+    bool shuttingDown = false;
+  };
+
+  uint maxQueued;
+  kj::MutexGuarded<Queue> queue;
+  kj::Vector<kj::Own<kj::Thread>> threads;
+
+  bool tryReserve();
+  // Makes room in the queue for one job. Returns false if the queue is full.
+
+  void enqueue(kj::Function<void()> job);
+  // Adds a job to the queue, using room made by tryReserve().
+  void threadMain();
+
+  static kj::Duration getThreadCpuTime();
+};
+
+template <typename Func>
+auto ThreadPool::run(Func&& func) -> kj::Promise<Result<decltype(func())>> {
+  using T = decltype(func());
+  if (!tryReserve()) {
+    return kj::evalNow([&]() {
+      return Result<T> { .value = func(), .cpuTime = 0 * kj::NANOSECONDS };
+    });
+  }
+
+  auto paf = kj::newPromiseAndCrossThreadFulfiller<Result<T>>();
+  enqueue([func = kj::fwd<Func>(func), fulfiller = kj::mv(paf.fulfiller)]() mutable {
+    auto start = getThreadCpuTime();
+    kj::Maybe<T> value;
+    KJ_IF_MAYBE(exception, kj::runCatchingExceptions([&]() { value = func(); })) {
+      fulfiller->reject(kj::mv(*exception));
+    } else {
+      fulfiller->fulfill(Result<T> {
+        .value = kj::mv(KJ_ASSERT_NONNULL(value)),
+        .cpuTime = getThreadCpuTime() - start,
+      });
+    }
+  });
+  return kj::mv(paf.promise);
+}
+
+}  // namespace workerd
@@ -3,8 +3,8 @@
 //     https://opensource.org/licenses/Apache-2.0
 
 #include "uuid.h"
+#include "random.h"
 
-#include <openssl/rand.h>
 #include <kj/debug.h>
 
 namespace workerd {
@@ -15,18 +15,9 @@ kj::String randomUUID(kj::Maybe<kj::EntropySource&> optionalEntropySource) {
   KJ_IF_MAYBE(entropySource, optionalEntropySource) {
     entropySource->generate(buffer);
   } else {
-    KJ_ASSERT(RAND_bytes(buffer, sizeof(buffer)) == 1);
+    getBufferedRandomBytes(buffer);
   }
 
-  kj::Vector<char> result(37);
-
-  constexpr auto HEX_DIGITS = "0123456789abcdef";
-
-  auto add = [&](kj::byte b) {
-    result.add(HEX_DIGITS[(b >> 4) & 0xf]);
-    result.add(HEX_DIGITS[b & 0xf]);
-  };
-
   // The format for Random UUID's is established in
   // https://www.rfc-editor.org/rfc/rfc4122.txt
   // xxxxxxxx-xxxx-Axxx-Bxxx-xxxxxxxxxxxx
@@ -43,37 +34,21 @@ kj::String randomUUID(kj::Maybe<kj::EntropySource&> optionalEntropySource) {
   // of the third grouping is always a 4, and the first
   // character of the fourth grouping is always either
   // an a, b, 8, or 9.
+  buffer[6] = (buffer[6] & 0x0f) | 0x40;
+  buffer[8] = (buffer[8] & 0x3f) | 0x80;
 
-  add(buffer[0]);
-  add(buffer[1]);
-  add(buffer[2]);
-  add(buffer[3]);
-  result.add('-');
-
-  add(buffer[4]);
-  add(buffer[5]);
-
-  result.add('-');
-
-  add(kj::byte((buffer[6] & 0x0f) | 0x40));
-  add(buffer[7]);
-
-  result.add('-');
-
-  add(kj::byte((buffer[8] & 0x3f) | 0x80));
-  add(buffer[9]);
-
-  result.add('-');
-
-  add(buffer[10]);
-  add(buffer[11]);
-  add(buffer[12]);
-  add(buffer[13]);
-  add(buffer[14]);
-  add(buffer[15]);
+  constexpr auto HEX_DIGITS = "0123456789abcdef";
 
-  result.add('\0');
-  return kj::String(result.releaseAsArray());
+  auto result = kj::heapString(36);
+  char* out = result.begin();
+  for (uint i = 0; i < sizeof(buffer); i++) {
+    if (i == 4 || i == 6 || i == 8 || i == 10) {
+      *out++ = '-';
+    }
+    *out++ = HEX_DIGITS[buffer[i] >> 4];
+    *out++ = HEX_DIGITS[buffer[i] & 0xf];
+  }
+  KJ_DASSERT(out == result.end());
+  return result;
 }
-
 }